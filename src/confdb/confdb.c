@@ -58,6 +58,30 @@ static char *prepend_cn(char *str, int *slen, const char *comp, int clen)
     return ret;
 }
 
+/* The snapshot no longer matches once this process modified the confdb.
+ * The file is removed as well so that processes started later do not even
+ * try it, running processes notice the change in confdb_refresh_snapshot().
+ */
+static void confdb_drop_snapshot(struct confdb_ctx *cdb)
+{
+    errno_t ret;
+
+    if (cdb->snapshot != NULL) {
+        DEBUG(SSSDBG_TRACE_INTERNAL, "Dropping the confdb snapshot\n");
+        talloc_zfree(cdb->snapshot);
+    }
+
+    if (cdb->snapshot_path != NULL) {
+        ret = unlink(cdb->snapshot_path);
+        if (ret != 0 && errno != ENOENT) {
+            ret = errno;
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "Cannot remove [%s]: [%d][%s].\n",
+                  cdb->snapshot_path, ret, sss_strerror(ret));
+        }
+    }
+}
+
 int parse_section(TALLOC_CTX *mem_ctx, const char *section,
                   char **sec_dn, const char **rdn_name)
 {
@@ -120,6 +144,8 @@ int confdb_add_param(struct confdb_ctx *cdb,
     const char *rdn_name;
     int ret, i;
 
+    confdb_drop_snapshot(cdb);
+
     tmp_ctx = talloc_new(NULL);
     if (!tmp_ctx) {
         ret = ENOMEM;
@@ -230,6 +256,7 @@ int confdb_get_param(struct confdb_ctx *cdb,
     struct ldb_result *res;
     struct ldb_dn *dn;
     char *secdn;
+    const char *casefold;
     const char *attrs[] = { attribute, NULL };
     char **vals;
     struct ldb_message_element *el;
@@ -250,6 +277,24 @@ int confdb_get_param(struct confdb_ctx *cdb,
         goto done;
     }
 
+    if (cdb->snapshot != NULL) {
+        casefold = ldb_dn_get_casefold(dn);
+        if (casefold == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        ret = confdb_snapshot_get_param(cdb->snapshot, mem_ctx, casefold,
+                                        attribute, values);
+        if (ret != EINVAL) {
+            goto done;
+        }
+
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "The confdb snapshot is damaged, using the confdb\n");
+        confdb_drop_snapshot(cdb);
+    }
+
     ret = ldb_search(cdb->ldb, tmp_ctx, &res,
                      dn, LDB_SCOPE_BASE, attrs, NULL);
     if (ret != LDB_SUCCESS) {
@@ -308,6 +353,8 @@ int confdb_set_string(struct confdb_ctx *cdb,
     struct ldb_message *msg;
     int ret, lret;
 
+    confdb_drop_snapshot(cdb);
+
     tmp_ctx = talloc_new(NULL);
     if (!tmp_ctx) {
         return ENOMEM;
@@ -621,11 +668,53 @@ done:
     return ret;
 }
 
+void confdb_refresh_snapshot(struct confdb_ctx *cdb)
+{
+    uint64_t seqnum;
+    errno_t ret;
+    int lret;
+
+    if (cdb->snapshot_path == NULL) {
+        return;
+    }
+
+    lret = ldb_sequence_number(cdb->ldb, LDB_SEQ_HIGHEST_SEQ, &seqnum);
+    if (lret != LDB_SUCCESS) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Cannot read the confdb sequence number [%d]: %s\n",
+              lret, ldb_strerror(lret));
+        talloc_zfree(cdb->snapshot);
+        return;
+    }
+
+    if (cdb->snapshot != NULL) {
+        if (confdb_snapshot_seqnum(cdb->snapshot) == seqnum) {
+            return;
+        }
+
+        DEBUG(SSSDBG_TRACE_FUNC, "The confdb was modified\n");
+        talloc_zfree(cdb->snapshot);
+    }
+
+    /* The monitor might have written a new one in the meantime */
+    ret = confdb_snapshot_load(cdb, cdb->snapshot_path, seqnum,
+                               &cdb->snapshot);
+    if (ret == EOK) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Using the confdb snapshot [%s]\n",
+              cdb->snapshot_path);
+    } else if (ret != ENOENT) {
+        DEBUG(SSSDBG_TRACE_FUNC,
+              "Not using the confdb snapshot [%s] [%d]: %s\n",
+              cdb->snapshot_path, ret, sss_strerror(ret));
+    }
+}
+
 int confdb_init(TALLOC_CTX *mem_ctx,
                 struct confdb_ctx **cdb_ctx,
                 const char *confdb_location)
 {
     struct confdb_ctx *cdb;
+    const char *sep;
     int ret = EOK;
     mode_t old_umask;
 
@@ -670,6 +759,21 @@ int confdb_init(TALLOC_CTX *mem_ctx,
         return EIO;
     }
 
+    /* Not fatal, the confdb is searched directly without it */
+    sep = strrchr(confdb_location, '/');
+    if (sep != NULL) {
+        cdb->snapshot_path = talloc_asprintf(cdb, "%.*s/%s",
+                                             (int) (sep - confdb_location),
+                                             confdb_location,
+                                             CONFDB_SNAPSHOT_FILE);
+        if (cdb->snapshot_path == NULL) {
+            talloc_free(cdb);
+            return ENOMEM;
+        }
+
+        confdb_refresh_snapshot(cdb);
+    }
+
     *cdb_ctx = cdb;
 
     return EOK;
@@ -813,6 +917,55 @@ done:
     return ret;
 }
 
+/* Returns the section in the same form as a base search of the confdb */
+static errno_t confdb_get_snapshot_section(TALLOC_CTX *mem_ctx,
+                                           struct confdb_ctx *cdb,
+                                           struct ldb_dn *dn,
+                                           struct ldb_result **_res)
+{
+    struct ldb_result *res;
+    const char *casefold;
+    errno_t ret;
+
+    casefold = ldb_dn_get_casefold(dn);
+    if (casefold == NULL) {
+        return ENOMEM;
+    }
+
+    res = talloc_zero(mem_ctx, struct ldb_result);
+    if (res == NULL) {
+        return ENOMEM;
+    }
+
+    res->msgs = talloc_zero_array(res, struct ldb_message *, 2);
+    if (res->msgs == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = confdb_snapshot_get_section(cdb->snapshot, res->msgs, casefold,
+                                      &res->msgs[0]);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    res->msgs[0]->dn = ldb_dn_copy(res->msgs[0], dn);
+    if (res->msgs[0]->dn == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+    res->count = 1;
+
+    *_res = res;
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        talloc_free(res);
+    }
+    return ret;
+}
+
 static int confdb_get_domain_section(TALLOC_CTX *mem_ctx,
                                      struct confdb_ctx *cdb,
                                      const char *section,
@@ -835,6 +988,20 @@ static int confdb_get_domain_section(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
+    if (cdb->snapshot != NULL) {
+        ret = confdb_get_snapshot_section(tmp_ctx, cdb, dn, &res);
+        if (ret == EOK) {
+            *_res = talloc_steal(mem_ctx, res);
+            goto done;
+        } else if (ret != EINVAL) {
+            goto done;
+        }
+
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "The confdb snapshot is damaged, using the confdb\n");
+        confdb_drop_snapshot(cdb);
+    }
+
     ret = ldb_search(cdb->ldb, tmp_ctx, &res, dn,
                      LDB_SCOPE_BASE, NULL, NULL);
     if (ret != LDB_SUCCESS) {
@@ -1234,6 +1401,28 @@ static int confdb_get_domain_internal(struct confdb_ctx *cdb,
               domain->refresh_expired_interval);
     }
 
+    ret = get_entry_as_uint32(res->msgs[0],
+                              &domain->refresh_expired_idle_timeout,
+                              CONFDB_DOMAIN_REFRESH_EXPIRED_IDLE_TIMEOUT,
+                              0);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE,
+              "Invalid value for [%s]\n",
+              CONFDB_DOMAIN_REFRESH_EXPIRED_IDLE_TIMEOUT);
+        goto done;
+    }
+
+    ret = get_entry_as_uint32(res->msgs[0],
+                              &domain->refresh_expired_max_rate,
+                              CONFDB_DOMAIN_REFRESH_EXPIRED_MAX_RATE,
+                              0);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE,
+              "Invalid value for [%s]\n",
+              CONFDB_DOMAIN_REFRESH_EXPIRED_MAX_RATE);
+        goto done;
+    }
+
     /* Set the PAM warning time, if specified. If not specified, pass on
      * the "not set" value of "-1" which means "use provider default". The
      * value 0 means "always display the warning if server sends one" */
@@ -1981,6 +2170,7 @@ static int confdb_merge_parent_domain(const char *name,
             ldb_msg_remove_element(replace_msg, el);
         }
 
+        confdb_drop_snapshot(cdb);
         ret = ldb_modify(cdb->ldb, replace_msg);
         if (ret != LDB_SUCCESS) {
             ret = sysdb_error_to_errno(ret);
@@ -2036,6 +2226,7 @@ static int confdb_merge_parent_domain(const char *name,
      * distinguishedName from the app_section to the application
      * message would throw EEXIST
      */
+    confdb_drop_snapshot(cdb);
     ret = sss_ldb_modify_permissive(cdb->ldb, app_msg);
     if (ret != LDB_SUCCESS) {
         ret = sysdb_error_to_errno(ret);
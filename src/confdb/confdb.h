@@ -40,6 +40,7 @@
 
 #define CONFDB_DEFAULT_CFG_FILE_VER 2
 #define CONFDB_FILE "config.ldb"
+#define CONFDB_SNAPSHOT_FILE "config.snapshot"
 #define SSSD_CONFIG_FILE SSSD_CONF_DIR"/sssd.conf"
 #define CONFDB_DEFAULT_CONFIG_DIR SSSD_CONF_DIR"/conf.d"
 #define SSSD_MIN_ID 1
@@ -57,6 +58,8 @@
 #define CONFDB_SERVICE_DEBUG_TIMESTAMPS "debug_timestamps"
 #define CONFDB_SERVICE_DEBUG_MICROSECONDS "debug_microseconds"
 #define CONFDB_SERVICE_DEBUG_TO_FILES "debug_to_files"
+#define CONFDB_SERVICE_DEBUG_FLUSH_INTERVAL "debug_flush_interval"
+#define CONFDB_SERVICE_DEBUG_RECORDER_SIZE "debug_flight_recorder_size"
 #define CONFDB_SERVICE_RECON_RETRIES "reconnection_retries"
 #define CONFDB_SERVICE_FD_LIMIT "fd_limit"
 #define CONFDB_SERVICE_ALLOWED_UIDS "allowed_uids"
@@ -90,6 +93,8 @@
 #define CONFDB_RESPONDER_IDLE_TIMEOUT "responder_idle_timeout"
 #define CONFDB_RESPONDER_IDLE_DEFAULT_TIMEOUT 300
 #define CONFDB_RESPONDER_CACHE_FIRST "cache_first"
+#define CONFDB_RESPONDER_DOMAIN_LOOKUP_CONCURRENCY "domain_lookup_concurrency"
+#define CONFDB_RESPONDER_DOMAIN_LOOKUP_CONCURRENCY_DEFAULT 1
 
 /* NSS */
 #define CONFDB_NSS_CONF_ENTRY "config/nss"
@@ -208,6 +213,10 @@
 #define CONFDB_DOMAIN_SSH_HOST_CACHE_TIMEOUT "entry_cache_ssh_host_timeout"
 #define CONFDB_DOMAIN_PWD_EXPIRATION_WARNING "pwd_expiration_warning"
 #define CONFDB_DOMAIN_REFRESH_EXPIRED_INTERVAL "refresh_expired_interval"
+#define CONFDB_DOMAIN_REFRESH_EXPIRED_IDLE_TIMEOUT "refresh_expired_idle_timeout"
+#define CONFDB_DOMAIN_REFRESH_EXPIRED_MAX_RATE "refresh_expired_max_rate"
+#define CONFDB_DOMAIN_DP_MAX_ACTIVE_REQUESTS "dp_max_active_requests"
+#define CONFDB_DOMAIN_DP_MAX_QUEUED_REQUESTS "dp_max_queued_requests"
 #define CONFDB_DOMAIN_OFFLINE_TIMEOUT "offline_timeout"
 #define CONFDB_DOMAIN_SUBDOMAIN_INHERIT "subdomain_inherit"
 #define CONFDB_DOMAIN_CACHED_AUTH_TIMEOUT "cached_auth_timeout"
@@ -231,17 +240,24 @@
 #define CONFDB_PROXY_PAM_TARGET "proxy_pam_target"
 #define CONFDB_PROXY_FAST_ALIAS "proxy_fast_alias"
 #define CONFDB_PROXY_MAX_CHILDREN "proxy_max_children"
+#define CONFDB_PROXY_MAX_THREADS "proxy_max_threads"
 
 /* Secrets Service */
 #define CONFDB_SEC_CONF_ENTRY "config/secrets"
 #define CONFDB_SEC_CONTAINERS_NEST_LEVEL "containers_nest_level"
 #define CONFDB_SEC_MAX_SECRETS "max_secrets"
+#define CONFDB_SEC_MAX_UID_SECRETS "max_uid_secrets"
 #define CONFDB_SEC_MAX_PAYLOAD_SIZE "max_payload_size"
 
 /* KCM Service */
 #define CONFDB_KCM_CONF_ENTRY "config/kcm"
 #define CONFDB_KCM_SOCKET "socket_path"
-#define CONFDB_KCM_DB "ccache_storage" /* Undocumented on purpose */
+#define CONFDB_KCM_DB "ccache_storage"
+#define CONFDB_KCM_CACHE_TIMEOUT "ccache_cache_timeout"
+#define CONFDB_KCM_WRITEBACK_DELAY "ccache_writeback_delay"
+#define CONFDB_KCM_MAX_UID_CCACHES "max_uid_ccaches"
+#define CONFDB_KCM_MAX_UID_CREDENTIALS "max_uid_credentials"
+#define CONFDB_KCM_MAX_PAYLOAD_SIZE "max_payload_size"
 
 struct confdb_ctx;
 struct config_file_ctx;
@@ -320,6 +336,8 @@ struct sss_domain_info {
     uint32_t ssh_host_timeout;
 
     uint32_t refresh_expired_interval;
+    uint32_t refresh_expired_idle_timeout;
+    uint32_t refresh_expired_max_rate;
     uint32_t subdomain_refresh_interval;
     uint32_t cached_auth_timeout;
 
@@ -405,6 +423,35 @@ int confdb_get_domain(struct confdb_ctx *cdb,
 int confdb_get_domains(struct confdb_ctx *cdb,
                        struct sss_domain_info **domains);
 
+/**
+ * Write a compiled, read-only copy of the configuration database
+ *
+ * Processes that open the ConfDB later read their options from this file
+ * instead of searching the ConfDB, as long as the ConfDB was not modified
+ * in the meantime.
+ *
+ * @param[in] cdb The connection object to the confdb
+ * @param[in] path The absolute path of the snapshot file, it should be
+ *                 CONFDB_SNAPSHOT_FILE next to the ConfDB file
+ *
+ * @return 0 - The snapshot was written
+ * @return ENOMEM - There was insufficient memory to complete the operation
+ * @return EIO - There was an I/O error reading the ConfDB
+ */
+int confdb_snapshot_write(struct confdb_ctx *cdb, const char *path);
+
+/**
+ * Check whether the ConfDB was modified by another process
+ *
+ * The snapshot is only compared with the ConfDB when it is opened. This
+ * function drops it if the ConfDB was modified since then and maps the
+ * current snapshot instead, if there is one. It should be called whenever
+ * the configuration is re-read at runtime, e.g. on SIGHUP.
+ *
+ * @param[in] cdb The connection object to the confdb
+ */
+void confdb_refresh_snapshot(struct confdb_ctx *cdb);
+
 int confdb_ensure_files_domain(struct confdb_ctx *cdb,
                                const char *implicit_files_dom_name);
 
@@ -22,14 +22,47 @@
 #ifndef CONFDB_PRIVATE_H_
 #define CONFDB_PRIVATE_H_
 
+struct confdb_snapshot;
+
 struct confdb_ctx {
     struct tevent_context *pev;
     struct ldb_context *ldb;
 
     struct sss_domain_info *doms;
+
+    /* compiled copy of config.ldb, NULL if not available or out of date */
+    struct confdb_snapshot *snapshot;
+    char *snapshot_path;
 };
 
 int parse_section(TALLOC_CTX *mem_ctx, const char *section,
                   char **sec_dn, const char **rdn_name);
 
+/* from confdb_snapshot.c */
+
+/* Returns ESTALE if the snapshot does not match seqnum */
+errno_t confdb_snapshot_load(TALLOC_CTX *mem_ctx,
+                             const char *path,
+                             uint64_t seqnum,
+                             struct confdb_snapshot **_snapshot);
+
+/* Sequence number of config.ldb the snapshot was created from */
+uint64_t confdb_snapshot_seqnum(struct confdb_snapshot *snapshot);
+
+/* section is the case folded DN of the section. Returns an empty list if
+ * the attribute is not set and EINVAL if the snapshot is damaged. */
+errno_t confdb_snapshot_get_param(struct confdb_snapshot *snapshot,
+                                  TALLOC_CTX *mem_ctx,
+                                  const char *section,
+                                  const char *attribute,
+                                  char ***_values);
+
+/* Returns all attributes of a section as a message without a DN. section
+ * is the case folded DN, ENOENT is returned if the section does not exist
+ * and EINVAL if the snapshot is damaged. */
+errno_t confdb_snapshot_get_section(struct confdb_snapshot *snapshot,
+                                    TALLOC_CTX *mem_ctx,
+                                    const char *section,
+                                    struct ldb_message **_msg);
+
 #endif /* CONFDB_PRIVATE_H_ */
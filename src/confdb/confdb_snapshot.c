@@ -0,0 +1,778 @@
+/*
+   SSSD
+
+   Compiled snapshot of the configuration database
+
+   Copyright (C) 2017 Red Hat
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "util/util.h"
+#include "util/murmurhash3.h"
+#include "confdb/confdb.h"
+#include "confdb/confdb_private.h"
+#include "db/sysdb.h"
+
+/*
+ * The snapshot is written by the monitor once the configuration database is
+ * fully set up. Every other process maps it read-only and answers
+ * confdb_get_param() from it without searching config.ldb.
+ *
+ * The file holds the sequence number of config.ldb it was created from. It
+ * is compared with config.ldb when the confdb is opened and again whenever
+ * confdb_refresh_snapshot() is called, e.g. on SIGHUP. A process that
+ * modifies the confdb drops its snapshot and removes the file.
+ *
+ * Layout, all integers are in host byte order:
+ *
+ *   struct confdb_snapshot_header
+ *   uint32_t buckets[num_buckets + 1]     first entry of each bucket
+ *   struct confdb_snapshot_entry entries[num_entries], ordered by bucket
+ *   struct confdb_snapshot_value values[num_values]
+ *   char strings[strings_size]            NULL terminated strings
+ *
+ * An entry is one attribute of one section. The section is stored as the
+ * case folded DN and the attribute name in lower case, so lookups are
+ * case insensitive just like in ldb.
+ */
+
+#define CONFDB_SNAPSHOT_MAGIC 0x53534344 /* SSCD */
+#define CONFDB_SNAPSHOT_VERSION 1
+#define CONFDB_SNAPSHOT_SEED 0x87654321
+
+struct confdb_snapshot_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t seqnum;
+    uint32_t num_buckets;
+    uint32_t num_entries;
+    uint32_t num_values;
+    uint32_t strings_size;
+};
+
+struct confdb_snapshot_entry {
+    uint32_t hash;
+    uint32_t section;
+    uint32_t attribute;
+    uint32_t first_value;
+    uint32_t num_values;
+};
+
+struct confdb_snapshot_value {
+    uint32_t str;
+    uint32_t len;
+};
+
+struct confdb_snapshot {
+    void *map;
+    size_t size;
+
+    const struct confdb_snapshot_header *hdr;
+    const uint32_t *buckets;
+    const struct confdb_snapshot_entry *entries;
+    const struct confdb_snapshot_value *values;
+    const char *strings;
+};
+
+static uint32_t confdb_snapshot_hash(const char *section, size_t section_len,
+                                     const char *attribute, size_t attr_len)
+{
+    uint32_t hash;
+
+    hash = murmurhash3(section, section_len, CONFDB_SNAPSHOT_SEED);
+    return murmurhash3(attribute, attr_len, hash);
+}
+
+static char *confdb_snapshot_attr_key(TALLOC_CTX *mem_ctx,
+                                      const char *attribute)
+{
+    char *key;
+    size_t i;
+
+    key = talloc_strdup(mem_ctx, attribute);
+    if (key == NULL) {
+        return NULL;
+    }
+
+    for (i = 0; key[i] != '\0'; i++) {
+        key[i] = tolower((unsigned char) key[i]);
+    }
+
+    return key;
+}
+
+/* ==Writing the snapshot================================================= */
+
+struct confdb_snapshot_builder {
+    struct confdb_snapshot_entry *entries;
+    uint32_t num_entries;
+
+    struct confdb_snapshot_value *values;
+    uint32_t num_values;
+
+    char *strings;
+    uint32_t strings_size;
+};
+
+static errno_t confdb_snapshot_add_string(struct confdb_snapshot_builder *b,
+                                          const char *str, size_t len,
+                                          uint32_t *_offset)
+{
+    char *strings;
+
+    if (len >= UINT32_MAX - b->strings_size) {
+        return EFBIG;
+    }
+
+    strings = talloc_realloc(b, b->strings, char, b->strings_size + len + 1);
+    if (strings == NULL) {
+        return ENOMEM;
+    }
+
+    memcpy(strings + b->strings_size, str, len);
+    strings[b->strings_size + len] = '\0';
+
+    *_offset = b->strings_size;
+    b->strings = strings;
+    b->strings_size += len + 1;
+
+    return EOK;
+}
+
+static errno_t confdb_snapshot_add_element(struct confdb_snapshot_builder *b,
+                                           const char *section,
+                                           uint32_t section_offset,
+                                           struct ldb_message_element *el)
+{
+    struct confdb_snapshot_entry *entry;
+    struct confdb_snapshot_value *values;
+    char *attribute;
+    unsigned int i;
+    errno_t ret;
+
+    b->entries = talloc_realloc(b, b->entries, struct confdb_snapshot_entry,
+                                b->num_entries + 1);
+    if (b->entries == NULL) {
+        return ENOMEM;
+    }
+
+    values = talloc_realloc(b, b->values, struct confdb_snapshot_value,
+                            b->num_values + el->num_values);
+    if (values == NULL && el->num_values > 0) {
+        return ENOMEM;
+    }
+    b->values = values;
+
+    attribute = confdb_snapshot_attr_key(b, el->name);
+    if (attribute == NULL) {
+        return ENOMEM;
+    }
+
+    entry = &b->entries[b->num_entries];
+    entry->hash = confdb_snapshot_hash(section, strlen(section),
+                                       attribute, strlen(attribute));
+    entry->section = section_offset;
+    entry->first_value = b->num_values;
+    entry->num_values = el->num_values;
+
+    ret = confdb_snapshot_add_string(b, attribute, strlen(attribute),
+                                     &entry->attribute);
+    talloc_free(attribute);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    for (i = 0; i < el->num_values; i++) {
+        b->values[b->num_values].len = el->values[i].length;
+        ret = confdb_snapshot_add_string(b, (const char *) el->values[i].data,
+                                         el->values[i].length,
+                                         &b->values[b->num_values].str);
+        if (ret != EOK) {
+            return ret;
+        }
+        b->num_values++;
+    }
+
+    b->num_entries++;
+
+    return EOK;
+}
+
+static errno_t confdb_snapshot_write_file(const char *path,
+                                          const void *data,
+                                          size_t size)
+{
+    char *tmp_path;
+    ssize_t written;
+    errno_t ret;
+    int fd = -1;
+
+    tmp_path = talloc_asprintf(NULL, "%s.XXXXXX", path);
+    if (tmp_path == NULL) {
+        return ENOMEM;
+    }
+
+    fd = sss_unique_file(NULL, tmp_path, &ret);
+    if (fd == -1) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Cannot create [%s] [%d]: %s\n", tmp_path, ret, sss_strerror(ret));
+        goto done;
+    }
+
+    written = sss_atomic_write_s(fd, discard_const(data), size);
+    if (written != (ssize_t) size) {
+        ret = written == -1 ? errno : EIO;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Cannot write [%s] [%d]: %s\n", tmp_path, ret, sss_strerror(ret));
+        goto done;
+    }
+
+    ret = fchmod(fd, 0600);
+    if (ret == -1) {
+        ret = errno;
+        goto done;
+    }
+
+    ret = close(fd);
+    fd = -1;
+    if (ret == -1) {
+        ret = errno;
+        goto done;
+    }
+
+    /* A process that has the old file mapped keeps using it */
+    ret = rename(tmp_path, path);
+    if (ret == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Cannot rename [%s] [%d]: %s\n", tmp_path, ret, sss_strerror(ret));
+        goto done;
+    }
+
+    ret = EOK;
+
+done:
+    if (fd != -1) {
+        close(fd);
+    }
+    if (ret != EOK) {
+        unlink(tmp_path);
+    }
+    talloc_free(tmp_path);
+    return ret;
+}
+
+int confdb_snapshot_write(struct confdb_ctx *cdb, const char *path)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct confdb_snapshot_builder *b;
+    struct confdb_snapshot_header hdr;
+    struct confdb_snapshot_entry *sorted;
+    struct ldb_result *res;
+    struct ldb_dn *dn;
+    const char *section;
+    uint32_t section_offset;
+    uint32_t *buckets;
+    uint32_t *fill;
+    uint64_t seqnum;
+    uint8_t *data;
+    size_t size;
+    size_t pos;
+    unsigned int i;
+    unsigned int j;
+    bool in_transaction = false;
+    int lret;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    b = talloc_zero(tmp_ctx, struct confdb_snapshot_builder);
+    if (b == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    /* The sequence number must describe exactly the data we dump */
+    lret = ldb_transaction_start(cdb->ldb);
+    if (lret != LDB_SUCCESS) {
+        ret = sysdb_error_to_errno(lret);
+        goto done;
+    }
+    in_transaction = true;
+
+    lret = ldb_sequence_number(cdb->ldb, LDB_SEQ_HIGHEST_SEQ, &seqnum);
+    if (lret != LDB_SUCCESS) {
+        DEBUG(SSSDBG_OP_FAILURE, "Cannot read the confdb sequence number\n");
+        ret = sysdb_error_to_errno(lret);
+        goto done;
+    }
+
+    dn = ldb_dn_new(tmp_ctx, cdb->ldb, "cn=config");
+    if (dn == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    lret = ldb_search(cdb->ldb, tmp_ctx, &res, dn, LDB_SCOPE_SUBTREE,
+                      NULL, NULL);
+    if (lret != LDB_SUCCESS) {
+        ret = sysdb_error_to_errno(lret);
+        goto done;
+    }
+
+    for (i = 0; i < res->count; i++) {
+        section = ldb_dn_get_casefold(res->msgs[i]->dn);
+        if (section == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        ret = confdb_snapshot_add_string(b, section, strlen(section),
+                                         &section_offset);
+        if (ret != EOK) {
+            goto done;
+        }
+
+        for (j = 0; j < res->msgs[i]->num_elements; j++) {
+            ret = confdb_snapshot_add_element(b, section, section_offset,
+                                              &res->msgs[i]->elements[j]);
+            if (ret != EOK) {
+                goto done;
+            }
+        }
+    }
+
+    ldb_transaction_cancel(cdb->ldb);
+    in_transaction = false;
+
+    /* Order the entries by bucket */
+    hdr.num_buckets = b->num_entries + 1;
+    buckets = talloc_zero_array(tmp_ctx, uint32_t, hdr.num_buckets + 1);
+    fill = talloc_zero_array(tmp_ctx, uint32_t, hdr.num_buckets);
+    sorted = talloc_array(tmp_ctx, struct confdb_snapshot_entry,
+                          b->num_entries + 1);
+    if (buckets == NULL || fill == NULL || sorted == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    for (i = 0; i < b->num_entries; i++) {
+        buckets[b->entries[i].hash % hdr.num_buckets + 1]++;
+    }
+    for (i = 1; i <= hdr.num_buckets; i++) {
+        buckets[i] += buckets[i - 1];
+    }
+    for (i = 0; i < b->num_entries; i++) {
+        j = b->entries[i].hash % hdr.num_buckets;
+        sorted[buckets[j] + fill[j]] = b->entries[i];
+        fill[j]++;
+    }
+
+    hdr.magic = CONFDB_SNAPSHOT_MAGIC;
+    hdr.version = CONFDB_SNAPSHOT_VERSION;
+    hdr.seqnum = seqnum;
+    hdr.num_entries = b->num_entries;
+    hdr.num_values = b->num_values;
+    hdr.strings_size = b->strings_size;
+
+    size = sizeof(hdr)
+           + (hdr.num_buckets + 1) * sizeof(uint32_t)
+           + hdr.num_entries * sizeof(struct confdb_snapshot_entry)
+           + hdr.num_values * sizeof(struct confdb_snapshot_value)
+           + hdr.strings_size;
+
+    data = talloc_size(tmp_ctx, size);
+    if (data == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    pos = 0;
+    safealign_memcpy(&data[pos], &hdr, sizeof(hdr), &pos);
+    safealign_memcpy(&data[pos], buckets,
+                     (hdr.num_buckets + 1) * sizeof(uint32_t), &pos);
+    safealign_memcpy(&data[pos], sorted,
+                     hdr.num_entries * sizeof(struct confdb_snapshot_entry),
+                     &pos);
+    safealign_memcpy(&data[pos], b->values,
+                     hdr.num_values * sizeof(struct confdb_snapshot_value),
+                     &pos);
+    safealign_memcpy(&data[pos], b->strings, hdr.strings_size, &pos);
+
+    ret = confdb_snapshot_write_file(path, data, size);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          "Wrote confdb snapshot [%s] with %u entries at sequence %"PRIu64"\n",
+          path, hdr.num_entries, seqnum);
+
+done:
+    if (in_transaction) {
+        ldb_transaction_cancel(cdb->ldb);
+    }
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+/* ==Reading the snapshot================================================= */
+
+static int confdb_snapshot_destructor(struct confdb_snapshot *snapshot)
+{
+    if (snapshot->map != NULL) {
+        munmap(snapshot->map, snapshot->size);
+    }
+
+    return 0;
+}
+
+static errno_t confdb_snapshot_map(struct confdb_snapshot *snapshot)
+{
+    const struct confdb_snapshot_header *hdr;
+    const uint8_t *data = snapshot->map;
+    uint64_t size;
+
+    if (snapshot->size < sizeof(*hdr)) {
+        return EINVAL;
+    }
+
+    hdr = snapshot->map;
+    if (hdr->magic != CONFDB_SNAPSHOT_MAGIC
+            || hdr->version != CONFDB_SNAPSHOT_VERSION
+            || hdr->num_buckets == 0) {
+        return EINVAL;
+    }
+
+    size = sizeof(*hdr)
+           + ((uint64_t) hdr->num_buckets + 1) * sizeof(uint32_t)
+           + (uint64_t) hdr->num_entries * sizeof(struct confdb_snapshot_entry)
+           + (uint64_t) hdr->num_values * sizeof(struct confdb_snapshot_value)
+           + hdr->strings_size;
+    if (size != snapshot->size) {
+        return EINVAL;
+    }
+
+    /* every string must be terminated inside the string table */
+    if (hdr->strings_size == 0 || data[snapshot->size - 1] != '\0') {
+        return EINVAL;
+    }
+
+    snapshot->hdr = hdr;
+    data += sizeof(*hdr);
+    snapshot->buckets = (const uint32_t *) data;
+    data += (hdr->num_buckets + 1) * sizeof(uint32_t);
+    snapshot->entries = (const struct confdb_snapshot_entry *) data;
+    data += hdr->num_entries * sizeof(struct confdb_snapshot_entry);
+    snapshot->values = (const struct confdb_snapshot_value *) data;
+    data += hdr->num_values * sizeof(struct confdb_snapshot_value);
+    snapshot->strings = (const char *) data;
+
+    if (snapshot->buckets[hdr->num_buckets] != hdr->num_entries) {
+        return EINVAL;
+    }
+
+    return EOK;
+}
+
+errno_t confdb_snapshot_load(TALLOC_CTX *mem_ctx,
+                             const char *path,
+                             uint64_t seqnum,
+                             struct confdb_snapshot **_snapshot)
+{
+    struct confdb_snapshot *snapshot;
+    struct stat stat_buf;
+    errno_t ret;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return errno;
+    }
+
+    snapshot = talloc_zero(mem_ctx, struct confdb_snapshot);
+    if (snapshot == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+    talloc_set_destructor(snapshot, confdb_snapshot_destructor);
+
+    ret = fstat(fd, &stat_buf);
+    if (ret == -1) {
+        ret = errno;
+        goto done;
+    }
+
+    if (stat_buf.st_size <= 0 || stat_buf.st_size > UINT32_MAX) {
+        ret = EINVAL;
+        goto done;
+    }
+
+    snapshot->size = stat_buf.st_size;
+    snapshot->map = mmap(NULL, snapshot->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (snapshot->map == MAP_FAILED) {
+        ret = errno;
+        snapshot->map = NULL;
+        goto done;
+    }
+
+    ret = confdb_snapshot_map(snapshot);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Invalid confdb snapshot [%s]\n", path);
+        goto done;
+    }
+
+    if (snapshot->hdr->seqnum != seqnum) {
+        DEBUG(SSSDBG_TRACE_FUNC, "The confdb snapshot is out of date\n");
+        ret = ESTALE;
+        goto done;
+    }
+
+    *_snapshot = snapshot;
+    ret = EOK;
+
+done:
+    close(fd);
+    if (ret != EOK) {
+        talloc_free(snapshot);
+    }
+    return ret;
+}
+
+static const char *confdb_snapshot_string(struct confdb_snapshot *snapshot,
+                                          uint32_t offset)
+{
+    if (offset >= snapshot->hdr->strings_size) {
+        return NULL;
+    }
+
+    return snapshot->strings + offset;
+}
+
+uint64_t confdb_snapshot_seqnum(struct confdb_snapshot *snapshot)
+{
+    return snapshot->hdr->seqnum;
+}
+
+errno_t confdb_snapshot_get_param(struct confdb_snapshot *snapshot,
+                                  TALLOC_CTX *mem_ctx,
+                                  const char *section,
+                                  const char *attribute,
+                                  char ***_values)
+{
+    TALLOC_CTX *tmp_ctx;
+    const struct confdb_snapshot_entry *entry = NULL;
+    const struct confdb_snapshot_value *value;
+    const char *str;
+    char *attr_key;
+    char **vals;
+    uint32_t hash;
+    uint32_t bucket;
+    uint32_t i;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    attr_key = confdb_snapshot_attr_key(tmp_ctx, attribute);
+    if (attr_key == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    hash = confdb_snapshot_hash(section, strlen(section),
+                                attr_key, strlen(attr_key));
+    bucket = hash % snapshot->hdr->num_buckets;
+
+    if (snapshot->buckets[bucket] > snapshot->buckets[bucket + 1]
+            || snapshot->buckets[bucket + 1] > snapshot->hdr->num_entries) {
+        ret = EINVAL;
+        goto done;
+    }
+
+    for (i = snapshot->buckets[bucket]; i < snapshot->buckets[bucket + 1]; i++) {
+        if (snapshot->entries[i].hash != hash) {
+            continue;
+        }
+
+        str = confdb_snapshot_string(snapshot, snapshot->entries[i].section);
+        if (str == NULL) {
+            ret = EINVAL;
+            goto done;
+        }
+        if (strcmp(str, section) != 0) {
+            continue;
+        }
+
+        str = confdb_snapshot_string(snapshot, snapshot->entries[i].attribute);
+        if (str == NULL) {
+            ret = EINVAL;
+            goto done;
+        }
+        if (strcmp(str, attr_key) != 0) {
+            continue;
+        }
+
+        entry = &snapshot->entries[i];
+        break;
+    }
+
+    /* The snapshot is complete, a missing entry means the attribute is not
+     * set at all */
+    if (entry == NULL) {
+        vals = talloc_zero(mem_ctx, char *);
+        if (vals == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        *_values = vals;
+        ret = EOK;
+        goto done;
+    }
+
+    if (entry->first_value > snapshot->hdr->num_values
+            || entry->num_values > snapshot->hdr->num_values - entry->first_value) {
+        ret = EINVAL;
+        goto done;
+    }
+
+    vals = talloc_zero_array(tmp_ctx, char *, entry->num_values + 1);
+    if (vals == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    for (i = 0; i < entry->num_values; i++) {
+        value = &snapshot->values[entry->first_value + i];
+        str = confdb_snapshot_string(snapshot, value->str);
+        if (str == NULL
+                || value->len >= snapshot->hdr->strings_size - value->str) {
+            ret = EINVAL;
+            goto done;
+        }
+
+        vals[i] = talloc_strndup(vals, str, value->len);
+        if (vals[i] == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+    }
+
+    *_values = talloc_steal(mem_ctx, vals);
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+errno_t confdb_snapshot_get_section(struct confdb_snapshot *snapshot,
+                                    TALLOC_CTX *mem_ctx,
+                                    const char *section,
+                                    struct ldb_message **_msg)
+{
+    const struct confdb_snapshot_entry *entry;
+    const struct confdb_snapshot_value *value;
+    struct ldb_message *msg;
+    const char *attribute;
+    const char *str;
+    char *val;
+    uint32_t section_offset = UINT32_MAX;
+    uint32_t i;
+    uint32_t j;
+    errno_t ret;
+    int lret;
+
+    msg = ldb_msg_new(mem_ctx);
+    if (msg == NULL) {
+        return ENOMEM;
+    }
+
+    /* The entries are ordered by hash, not by section, but all entries of
+     * a section share the same string */
+    for (i = 0; i < snapshot->hdr->num_entries; i++) {
+        entry = &snapshot->entries[i];
+
+        if (entry->section != section_offset) {
+            str = confdb_snapshot_string(snapshot, entry->section);
+            if (str == NULL) {
+                ret = EINVAL;
+                goto done;
+            }
+            if (strcmp(str, section) != 0) {
+                continue;
+            }
+            section_offset = entry->section;
+        }
+
+        attribute = confdb_snapshot_string(snapshot, entry->attribute);
+        if (attribute == NULL
+                || entry->first_value > snapshot->hdr->num_values
+                || entry->num_values
+                        > snapshot->hdr->num_values - entry->first_value) {
+            ret = EINVAL;
+            goto done;
+        }
+
+        for (j = 0; j < entry->num_values; j++) {
+            value = &snapshot->values[entry->first_value + j];
+            str = confdb_snapshot_string(snapshot, value->str);
+            if (str == NULL
+                    || value->len >= snapshot->hdr->strings_size - value->str) {
+                ret = EINVAL;
+                goto done;
+            }
+
+            val = talloc_strndup(msg, str, value->len);
+            if (val == NULL) {
+                ret = ENOMEM;
+                goto done;
+            }
+
+            lret = ldb_msg_add_steal_string(msg, attribute, val);
+            if (lret != LDB_SUCCESS) {
+                ret = ENOMEM;
+                goto done;
+            }
+        }
+    }
+
+    if (msg->num_elements == 0) {
+        ret = ENOENT;
+        goto done;
+    }
+
+    *_msg = msg;
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        talloc_free(msg);
+    }
+    return ret;
+}
@@ -359,6 +359,8 @@ class SSSDConfigTestSSSDService(unittest.TestCase):
             'debug_level',
             'debug_timestamps',
             'debug_microseconds',
+            'debug_flush_interval',
+            'debug_flight_recorder_size',
             'debug_to_files',
             'command',
             'reconnection_retries',
@@ -366,6 +368,7 @@ class SSSDConfigTestSSSDService(unittest.TestCase):
             'client_idle_timeout',
             'responder_idle_timeout',
             'cache_first',
+            'domain_lookup_concurrency',
             'description',
             'certificate_verification',
             'override_space',
@@ -586,9 +589,18 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
             'entry_cache_sudo_timeout',
             'entry_cache_ssh_host_timeout',
             'refresh_expired_interval',
+            'refresh_expired_idle_timeout',
+            'refresh_expired_max_rate',
+            'dp_max_active_requests',
+            'dp_max_queued_requests',
             'lookup_family_order',
             'account_cache_expiration',
             'dns_resolver_timeout',
+            'dns_resolver_use_cache',
+            'dns_resolver_negative_ttl',
+            'dns_resolver_stale_time',
+            'failover_race_servers',
+            'failover_race_delay',
             'dns_discovery_domain',
             'dyndns_update',
             'dyndns_ttl',
@@ -956,9 +968,18 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
             'entry_cache_sudo_timeout',
             'entry_cache_ssh_host_timeout',
             'refresh_expired_interval',
+            'refresh_expired_idle_timeout',
+            'refresh_expired_max_rate',
+            'dp_max_active_requests',
+            'dp_max_queued_requests',
             'account_cache_expiration',
             'lookup_family_order',
             'dns_resolver_timeout',
+            'dns_resolver_use_cache',
+            'dns_resolver_negative_ttl',
+            'dns_resolver_stale_time',
+            'failover_race_servers',
+            'failover_race_delay',
             'dns_discovery_domain',
             'dyndns_update',
             'dyndns_ttl',
@@ -27,6 +27,7 @@
 #include "db/sysdb_private.h"
 #include "confdb/confdb.h"
 #include "util/probes.h"
+#include "util/sss_stats.h"
 #include <time.h>
 
 errno_t sysdb_dn_sanitize(TALLOC_CTX *mem_ctx, const char *input,
@@ -905,6 +906,9 @@ int sysdb_transaction_start(struct sysdb_ctx *sysdb)
     ret = ldb_transaction_start(sysdb->ldb);
     if (ret == LDB_SUCCESS) {
         PROBE(SYSDB_TRANSACTION_START, sysdb->transaction_nesting);
+        if (sysdb->transaction_nesting == 0) {
+            sysdb->transaction_start = sss_stats_now();
+        }
         sysdb->transaction_nesting++;
     } else {
         DEBUG(SSSDBG_CRIT_FAILURE,
@@ -925,6 +929,10 @@ int sysdb_transaction_commit(struct sysdb_ctx *sysdb)
     if (ret == LDB_SUCCESS) {
         sysdb->transaction_nesting--;
         PROBE(SYSDB_TRANSACTION_COMMIT_AFTER, sysdb->transaction_nesting);
+        if (sysdb->transaction_nesting == 0) {
+            sss_stats_record(SSS_STATS_SYSDB_TRANSACTION,
+                             sysdb->transaction_start, false);
+        }
     } else {
         DEBUG(SSSDBG_CRIT_FAILURE,
               "Failed to commit ldb transaction! (%d)\n", ret);
@@ -940,6 +948,10 @@ int sysdb_transaction_cancel(struct sysdb_ctx *sysdb)
     if (ret == LDB_SUCCESS) {
         sysdb->transaction_nesting--;
         PROBE(SYSDB_TRANSACTION_CANCEL, sysdb->transaction_nesting);
+        if (sysdb->transaction_nesting == 0) {
+            sss_stats_record(SSS_STATS_SYSDB_TRANSACTION,
+                             sysdb->transaction_start, true);
+        }
     } else {
         DEBUG(SSSDBG_CRIT_FAILURE,
               "Failed to cancel ldb transaction! (%d)\n", ret);
@@ -98,6 +98,8 @@
 #define SYSDB_LAST_UPDATE "lastUpdate"
 #define SYSDB_CACHE_EXPIRE "dataExpireTimestamp"
 #define SYSDB_INITGR_EXPIRE "initgrExpireTimestamp"
+#define SYSDB_LAST_ACCESS "lastAccessTimestamp"
+#define SYSDB_ACCESS_COUNT "accessCount"
 #define SYSDB_IFP_CACHED "ifpCached"
 
 #define SYSDB_AUTHORIZED_SERVICE "authorizedService"
@@ -185,6 +187,7 @@
 #define SYSDB_OVERRIDE_GROUP_CLASS "groupOverride"
 #define SYSDB_OVERRIDE_DN "overrideDN"
 #define SYSDB_OVERRIDE_OBJECT_DN "overrideObjectDN"
+#define SYSDB_OVERRIDE_MERGED_DN "overrideMergedDN"
 #define SYSDB_USE_DOMAIN_RESOLUTION_ORDER "useDomainResolutionOrder"
 #define SYSDB_DOMAIN_RESOLUTION_ORDER "domainResolutionOrder"
 
@@ -227,6 +230,18 @@
                             SYSDB_INITGR_EXPIRE, \
                             SYSDB_OBJECTCLASS
 
+/* The override attributes stored with the original object by
+ * sysdb_store_override() */
+#define SYSDB_MERGED_OVERRIDE_ATTRS SYSDB_OVERRIDE_MERGED_DN, \
+                                    OVERRIDE_PREFIX SYSDB_UIDNUM, \
+                                    OVERRIDE_PREFIX SYSDB_GIDNUM, \
+                                    OVERRIDE_PREFIX SYSDB_GECOS, \
+                                    OVERRIDE_PREFIX SYSDB_HOMEDIR, \
+                                    OVERRIDE_PREFIX SYSDB_SHELL, \
+                                    OVERRIDE_PREFIX SYSDB_NAME, \
+                                    OVERRIDE_PREFIX SYSDB_SSH_PUBKEY, \
+                                    OVERRIDE_PREFIX SYSDB_USER_CERT
+
 #define SYSDB_PW_ATTRS {SYSDB_NAME, SYSDB_UIDNUM, \
                         SYSDB_GIDNUM, SYSDB_GECOS, \
                         SYSDB_HOMEDIR, SYSDB_SHELL, \
@@ -239,6 +254,7 @@
                         SYSDB_OVERRIDE_DN, \
                         SYSDB_OVERRIDE_OBJECT_DN, \
                         SYSDB_DEFAULT_OVERRIDE_NAME, \
+                        SYSDB_MERGED_OVERRIDE_ATTRS, \
                         SYSDB_UUID, \
                         SYSDB_ORIG_DN, \
                         NULL}
@@ -252,6 +268,7 @@
                            SYSDB_OVERRIDE_DN, \
                            SYSDB_OVERRIDE_OBJECT_DN, \
                            SYSDB_DEFAULT_OVERRIDE_NAME, \
+                           SYSDB_MERGED_OVERRIDE_ATTRS, \
                            SYSDB_UUID, \
                            NULL}
 
@@ -267,6 +284,7 @@
                             SYSDB_SID_STR, \
                             SYSDB_NAME, \
                             SYSDB_OVERRIDE_DN, \
+                            SYSDB_MERGED_OVERRIDE_ATTRS, \
                             NULL}
 
 #define SYSDB_TMPL_USER SYSDB_NAME"=%s,"SYSDB_TMPL_USER_BASE
@@ -569,6 +587,14 @@ errno_t sysdb_delete_view_tree(struct sysdb_ctx *sysdb, const char *view_name);
 
 errno_t sysdb_invalidate_overrides(struct sysdb_ctx *sysdb);
 
+/* Adds replace operations for the override attributes stored with the
+ * original object to the modify message msg. If override_attrs is NULL
+ * the stored attributes are removed, this must be done whenever the
+ * overrideDN attribute of the object is removed. */
+errno_t sysdb_add_merged_overrides(struct ldb_message *msg,
+                                   const char *override_dn_str,
+                                   struct sysdb_attrs *override_attrs);
+
 errno_t sysdb_apply_default_override(struct sss_domain_info *domain,
                                      struct sysdb_attrs *override_attrs,
                                      struct ldb_dn *obj_dn);
@@ -930,6 +956,24 @@ int sysdb_set_entry_attr(struct sysdb_ctx *sysdb,
                          struct sysdb_attrs *attrs,
                          int mod_op);
 
+/* The access count of an entry is halved for every SYSDB_ACCESS_HALF_LIFE
+ * seconds without an access, so that the count says how heavily the entry
+ * is used now rather than since it was cached. */
+#define SYSDB_ACCESS_HALF_LIFE (24 * 60 * 60)
+
+/* Add @count lookups of the entry, the last one at @last_access, to its
+ * access statistics. Used by the responders so that the background refresh
+ * can tell entries in use from entries nobody asks for anymore. */
+errno_t sysdb_add_entry_access(struct sysdb_ctx *sysdb,
+                               struct ldb_dn *entry_dn,
+                               uint32_t count,
+                               time_t last_access);
+
+/* The access count decayed from @last_access to @now */
+uint32_t sysdb_decay_access_count(uint32_t count,
+                                  time_t last_access,
+                                  time_t now);
+
 /* User/group invalidation of cache by direct writing to persistent cache
  * WARNING: This function can cause performance issue!!
  * is_user = true --> user invalidation
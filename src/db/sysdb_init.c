@@ -41,6 +41,8 @@ const char *sysdb_ts_cache_attrs[] = {
     SYSDB_ORIG_MODSTAMP,
     SYSDB_INITGR_EXPIRE,
     SYSDB_USN,
+    SYSDB_LAST_ACCESS,
+    SYSDB_ACCESS_COUNT,
 
     NULL,
 };
@@ -1355,6 +1355,92 @@ done:
     return ret;
 }
 
+/* =Record-Entry-Access=================================================== */
+
+uint32_t sysdb_decay_access_count(uint32_t count,
+                                  time_t last_access,
+                                  time_t now)
+{
+    time_t half_lives;
+
+    if (now <= last_access) {
+        return count;
+    }
+
+    half_lives = (now - last_access) / SYSDB_ACCESS_HALF_LIFE;
+    if (half_lives >= 32) {
+        return 0;
+    }
+
+    return count >> half_lives;
+}
+
+errno_t sysdb_add_entry_access(struct sysdb_ctx *sysdb,
+                               struct ldb_dn *entry_dn,
+                               uint32_t count,
+                               time_t last_access)
+{
+    TALLOC_CTX *tmp_ctx;
+    const char *attrs[] = { SYSDB_LAST_ACCESS, SYSDB_ACCESS_COUNT, NULL };
+    struct ldb_message **msgs;
+    struct sysdb_attrs *new_attrs;
+    struct ldb_context *ldb;
+    uint64_t total;
+    time_t old_last;
+    size_t msgs_count;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    ret = sysdb_search_entry(tmp_ctx, sysdb, entry_dn, LDB_SCOPE_BASE, NULL,
+                             attrs, &msgs_count, &msgs);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    old_last = ldb_msg_find_attr_as_uint64(msgs[0], SYSDB_LAST_ACCESS, 0);
+    total = ldb_msg_find_attr_as_uint(msgs[0], SYSDB_ACCESS_COUNT, 0);
+    total = sysdb_decay_access_count(total, old_last, last_access);
+    total += count;
+    if (total > UINT32_MAX) {
+        total = UINT32_MAX;
+    }
+
+    new_attrs = sysdb_new_attrs(tmp_ctx);
+    if (new_attrs == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = sysdb_attrs_add_time_t(new_attrs, SYSDB_LAST_ACCESS,
+                                 MAX(old_last, last_access));
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = sysdb_attrs_add_uint32(new_attrs, SYSDB_ACCESS_COUNT, total);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    /* The access statistics change with almost every lookup, keep them
+     * out of the persistent cache whenever there is a timestamp cache. */
+    if (sysdb->ldb_ts != NULL && is_ts_ldb_dn(entry_dn)) {
+        ldb = sysdb->ldb_ts;
+    } else {
+        ldb = sysdb->ldb;
+    }
+
+    ret = sysdb_set_cache_entry_attr(ldb, entry_dn, new_attrs, SYSDB_MOD_REP);
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
 /* =Replace-Attributes-On-User============================================ */
 
 int sysdb_set_user_attr(struct sss_domain_info *domain,
@@ -115,6 +115,7 @@ struct sysdb_ctx {
     char *ldb_ts_file;
 
     int transaction_nesting;
+    uint64_t transaction_start;
 };
 
 /* Internal utility functions */
@@ -279,6 +279,97 @@ done:
     return ret;
 }
 
+/* Maps the override attributes to the names they get in the original
+ * object */
+static const struct override_attr_map {
+    const char *attr;
+    const char *new_attr;
+} override_attr_map[] = {
+    {SYSDB_UIDNUM, OVERRIDE_PREFIX SYSDB_UIDNUM},
+    {SYSDB_GIDNUM, OVERRIDE_PREFIX SYSDB_GIDNUM},
+    {SYSDB_GECOS, OVERRIDE_PREFIX SYSDB_GECOS},
+    {SYSDB_HOMEDIR, OVERRIDE_PREFIX SYSDB_HOMEDIR},
+    {SYSDB_SHELL, OVERRIDE_PREFIX SYSDB_SHELL},
+    {SYSDB_NAME, OVERRIDE_PREFIX SYSDB_NAME},
+    {SYSDB_SSH_PUBKEY, OVERRIDE_PREFIX SYSDB_SSH_PUBKEY},
+    {SYSDB_USER_CERT, OVERRIDE_PREFIX SYSDB_USER_CERT},
+    {NULL, NULL}
+};
+
+/* The override attributes are stored with the original object together
+ * with the DN of the override they were taken from, so that lookups with
+ * views do not have to read and merge the override object each time. This
+ * adds replace operations for all of them to the modify message msg,
+ * if override_attrs is NULL the stored attributes are removed. */
+errno_t sysdb_add_merged_overrides(struct ldb_message *msg,
+                                   const char *override_dn_str,
+                                   struct sysdb_attrs *override_attrs)
+{
+    struct ldb_message_element *el;
+    struct ldb_message_element *override_el;
+    size_t c;
+    size_t d;
+    int ret;
+
+    for (c = 0; override_attr_map[c].attr != NULL; c++) {
+        ret = ldb_msg_add_empty(msg, override_attr_map[c].new_attr,
+                                LDB_FLAG_MOD_REPLACE, &el);
+        if (ret != LDB_SUCCESS) {
+            return sysdb_error_to_errno(ret);
+        }
+
+        if (override_attrs == NULL) {
+            continue;
+        }
+
+        ret = sysdb_attrs_get_el_ext(override_attrs, override_attr_map[c].attr,
+                                     false, &override_el);
+        if (ret == ENOENT) {
+            continue;
+        } else if (ret != EOK) {
+            return ret;
+        }
+
+        el->values = talloc_array(msg->elements, struct ldb_val,
+                                  override_el->num_values);
+        if (el->values == NULL) {
+            return ENOMEM;
+        }
+
+        for (d = 0; d < override_el->num_values; d++) {
+            el->values[d] = override_el->values[d];
+        }
+        el->num_values = override_el->num_values;
+    }
+
+    ret = ldb_msg_add_empty(msg, SYSDB_OVERRIDE_MERGED_DN,
+                            LDB_FLAG_MOD_REPLACE, NULL);
+    if (ret != LDB_SUCCESS) {
+        return sysdb_error_to_errno(ret);
+    }
+
+    if (override_attrs != NULL) {
+        ret = ldb_msg_add_string(msg, SYSDB_OVERRIDE_MERGED_DN,
+                                 override_dn_str);
+        if (ret != LDB_SUCCESS) {
+            return sysdb_error_to_errno(ret);
+        }
+    }
+
+    return EOK;
+}
+
+/* Removes the stored override attributes from a search result */
+static void sysdb_drop_merged_overrides(struct ldb_message *obj)
+{
+    size_t c;
+
+    for (c = 0; override_attr_map[c].attr != NULL; c++) {
+        ldb_msg_remove_attr(obj, override_attr_map[c].new_attr);
+    }
+    ldb_msg_remove_attr(obj, SYSDB_OVERRIDE_MERGED_DN);
+}
+
 errno_t sysdb_invalidate_overrides(struct sysdb_ctx *sysdb)
 {
     int ret;
@@ -331,6 +422,12 @@ errno_t sysdb_invalidate_overrides(struct sysdb_ctx *sysdb)
         goto done;
     }
 
+    ret = sysdb_add_merged_overrides(msg, NULL, NULL);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "sysdb_add_merged_overrides failed.\n");
+        goto done;
+    }
+
     ret = sysdb_transaction_start(sysdb);
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE, "sysdb_transaction_start failed.\n");
@@ -644,16 +741,16 @@ errno_t sysdb_store_override(struct sss_domain_info *domain,
         }
     }
 
-    if (add_ref) {
-        talloc_free(msg);
-        msg = ldb_msg_new(tmp_ctx);
-        if (msg == NULL) {
-            ret = ENOMEM;
-            goto done;
-        }
+    talloc_free(msg);
+    msg = ldb_msg_new(tmp_ctx);
+    if (msg == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
 
-        msg->dn = obj_dn;
+    msg->dn = obj_dn;
 
+    if (add_ref) {
         ret = ldb_msg_add_empty(msg, SYSDB_OVERRIDE_DN,
                                 obj_override_dn == NULL ? LDB_FLAG_MOD_ADD
                                                         : LDB_FLAG_MOD_REPLACE,
@@ -669,15 +766,24 @@ errno_t sysdb_store_override(struct sss_domain_info *domain,
             ret = sysdb_error_to_errno(ret);
             goto done;
         }
+    }
 
-        ret = ldb_modify(domain->sysdb->ldb, msg);
-        if (ret != LDB_SUCCESS) {
-            DEBUG(SSSDBG_CRIT_FAILURE,
-                  "Failed to store override DN: %s(%d)[%s]\n",
-                  ldb_strerror(ret), ret, ldb_errstring(domain->sysdb->ldb));
-            ret = sysdb_error_to_errno(ret);
-            goto done;
-        }
+    /* The override attributes are refreshed even if the reference did
+     * not change because the content of the override might have */
+    ret = sysdb_add_merged_overrides(msg, override_dn_str,
+                                     has_override ? attrs : NULL);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "sysdb_add_merged_overrides failed.\n");
+        goto done;
+    }
+
+    ret = ldb_modify(domain->sysdb->ldb, msg);
+    if (ret != LDB_SUCCESS) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Failed to store override DN: %s(%d)[%s]\n",
+              ldb_strerror(ret), ret, ldb_errstring(domain->sysdb->ldb));
+        ret = sysdb_error_to_errno(ret);
+        goto done;
     }
 
     ret = EOK;
@@ -1318,6 +1424,10 @@ errno_t sysdb_search_group_override_by_gid(TALLOC_CTX *mem_ctx,
  * @param[in] req_attrs List of attributes to be requested, if not set a
  *                      default list dependig on the object type will be used
  *
+ * If the override attributes were already stored with the original object
+ * by sysdb_store_override() and were read together with it, the override
+ * object is neither searched nor merged.
+ *
  * @return EOK - Override data was added successfully
  * @return ENOMEM - There was insufficient memory to complete the operation
  * @return ENOENT - The original object did not have the SYSDB_OVERRIDE_DN
@@ -1340,20 +1450,7 @@ errno_t sysdb_add_overrides_to_object(struct sss_domain_info *domain,
     static const char *user_attrs[] = SYSDB_PW_ATTRS;
     static const char *group_attrs[] = SYSDB_GRSRC_ATTRS;
     const char **attrs;
-    struct attr_map {
-        const char *attr;
-        const char *new_attr;
-    } attr_map[] = {
-        {SYSDB_UIDNUM, OVERRIDE_PREFIX SYSDB_UIDNUM},
-        {SYSDB_GIDNUM, OVERRIDE_PREFIX SYSDB_GIDNUM},
-        {SYSDB_GECOS, OVERRIDE_PREFIX SYSDB_GECOS},
-        {SYSDB_HOMEDIR, OVERRIDE_PREFIX SYSDB_HOMEDIR},
-        {SYSDB_SHELL, OVERRIDE_PREFIX SYSDB_SHELL},
-        {SYSDB_NAME, OVERRIDE_PREFIX SYSDB_NAME},
-        {SYSDB_SSH_PUBKEY, OVERRIDE_PREFIX SYSDB_SSH_PUBKEY},
-        {SYSDB_USER_CERT, OVERRIDE_PREFIX SYSDB_USER_CERT},
-        {NULL, NULL}
-    };
+    const char *merged_dn_str;
     size_t c;
     size_t d;
     struct ldb_message_element *tmp_el;
@@ -1364,10 +1461,16 @@ errno_t sysdb_add_overrides_to_object(struct sss_domain_info *domain,
         return ENOMEM;
     }
 
+    merged_dn_str = ldb_msg_find_attr_as_string(obj, SYSDB_OVERRIDE_MERGED_DN,
+                                                NULL);
+
     if (override_obj == NULL) {
         override_dn_str = ldb_msg_find_attr_as_string(obj,
                                                       SYSDB_OVERRIDE_DN, NULL);
         if (override_dn_str == NULL) {
+            /* Stored override data without an override is out of date */
+            sysdb_drop_merged_overrides(obj);
+
             if (is_local_view(domain->view_name)) {
                 /* LOCAL view doesn't have to have overrideDN specified. */
                 ret = EOK;
@@ -1392,6 +1495,16 @@ errno_t sysdb_add_overrides_to_object(struct sss_domain_info *domain,
         if (ldb_dn_compare(obj->dn, override_dn) == 0) {
             DEBUG(SSSDBG_TRACE_ALL, "Object [%s] has no overrides.\n",
                                     ldb_dn_get_linearized(obj->dn));
+            sysdb_drop_merged_overrides(obj);
+            ret = EOK;
+            goto done;
+        }
+
+        if (merged_dn_str != NULL
+                && strcmp(merged_dn_str, override_dn_str) == 0) {
+            DEBUG(SSSDBG_TRACE_ALL,
+                  "Object [%s] already contains the override data.\n",
+                  ldb_dn_get_linearized(obj->dn));
             ret = EOK;
             goto done;
         }
@@ -1430,13 +1543,27 @@ errno_t sysdb_add_overrides_to_object(struct sss_domain_info *domain,
         }
     } else {
         override = override_obj;
+
+        if (merged_dn_str != NULL && override->dn != NULL
+                && strcmp(merged_dn_str,
+                          ldb_dn_get_linearized(override->dn)) == 0) {
+            DEBUG(SSSDBG_TRACE_ALL,
+                  "Object [%s] already contains the override data.\n",
+                  ldb_dn_get_linearized(obj->dn));
+            ret = EOK;
+            goto done;
+        }
     }
 
-    for (c = 0; attr_map[c].attr != NULL; c++) {
-        tmp_el = ldb_msg_find_element(override, attr_map[c].attr);
+    /* Drop stored override attributes that are out of date */
+    sysdb_drop_merged_overrides(obj);
+
+    for (c = 0; override_attr_map[c].attr != NULL; c++) {
+        tmp_el = ldb_msg_find_element(override, override_attr_map[c].attr);
         if (tmp_el != NULL) {
             for (d = 0; d < tmp_el->num_values; d++) {
-                ret = ldb_msg_add_steal_value(obj, attr_map[c].new_attr,
+                ret = ldb_msg_add_steal_value(obj,
+                                              override_attr_map[c].new_attr,
                                               &tmp_el->values[d]);
                 if (ret != LDB_SUCCESS) {
                     DEBUG(SSSDBG_OP_FAILURE, "ldb_msg_add_value failed.\n");
@@ -25,9 +25,11 @@
 #include "config.h"
 
 #include <ctype.h>
+#include <limits.h>
 
 #include "util/util.h"
 #include "util/cert.h"
+#include "util/murmurhash3.h"
 #include "util/crypto/sss_crypto.h"
 #include "lib/certmap/sss_certmap.h"
 #include "lib/certmap/sss_certmap_int.h"
@@ -147,6 +149,119 @@ done:
     return ret;
 }
 
+#define REGEX_SPECIAL_CHARS ".[]()*+?{}|^$\\"
+
+/* Returns the string an extended regular expression matches if it only
+ * matches a single exact string, e.g. "^CN=CA,O=EXAMPLE\.ORG$", and NULL
+ * otherwise. */
+static char *regex_exact_string(TALLOC_CTX *mem_ctx, const char *regex)
+{
+    size_t len;
+    size_t c;
+    size_t o = 0;
+    char *str;
+
+    len = strlen(regex);
+    if (len < 2 || regex[0] != '^' || regex[len - 1] != '$') {
+        return NULL;
+    }
+
+    str = talloc_array(mem_ctx, char, len);
+    if (str == NULL) {
+        return NULL;
+    }
+
+    for (c = 1; c < len - 1; c++) {
+        if (regex[c] == '\\') {
+            /* only escaped special characters are literals */
+            c++;
+            if (c == len - 1
+                    || strchr(REGEX_SPECIAL_CHARS, regex[c]) == NULL) {
+                talloc_free(str);
+                return NULL;
+            }
+        } else if (strchr(REGEX_SPECIAL_CHARS, regex[c]) != NULL) {
+            talloc_free(str);
+            return NULL;
+        }
+
+        str[o++] = regex[c];
+    }
+    str[o] = '\0';
+
+    return str;
+}
+
+static int compile_prefilter(struct match_map_rule *rule)
+{
+    struct component_list *comp;
+    size_t count = 0;
+    size_t c;
+
+    rule->required_ku = 0;
+    rule->required_eku = NULL;
+    rule->required_issuer = NULL;
+    rule->required_issuer_hash = 0;
+
+    /* With an OR relation any single component can match, no component can
+     * be used to discard the rule early. */
+    if (rule->parsed_match_rule == NULL
+            || rule->parsed_match_rule->r != relation_and) {
+        return 0;
+    }
+
+    for (comp = rule->parsed_match_rule->ku; comp != NULL; comp = comp->next) {
+        rule->required_ku |= comp->ku;
+    }
+
+    /* Any exact issuer will do, all of them have to match. Rules with a
+     * real regular expression are left to do_match(). */
+    for (comp = rule->parsed_match_rule->issuer;
+         comp != NULL && rule->required_issuer == NULL;
+         comp = comp->next) {
+        rule->required_issuer = regex_exact_string(rule, comp->val);
+    }
+    if (rule->required_issuer != NULL) {
+        rule->required_issuer_hash = murmurhash3(rule->required_issuer,
+                                                 strlen(rule->required_issuer),
+                                                 0);
+    }
+
+    for (comp = rule->parsed_match_rule->eku; comp != NULL; comp = comp->next) {
+        for (c = 0; comp->eku_oid_list[c] != NULL; c++) {
+            count++;
+        }
+    }
+
+    if (count == 0) {
+        return 0;
+    }
+
+    rule->required_eku = talloc_zero_array(rule, const char *, count + 1);
+    if (rule->required_eku == NULL) {
+        return ENOMEM;
+    }
+
+    count = 0;
+    for (comp = rule->parsed_match_rule->eku; comp != NULL; comp = comp->next) {
+        for (c = 0; comp->eku_oid_list[c] != NULL; c++) {
+            rule->required_eku[count++] = comp->eku_oid_list[c];
+        }
+    }
+
+    return 0;
+}
+
+static void cert_cache_invalidate_matches(struct sss_certmap_ctx *ctx)
+{
+    size_t c;
+
+    for (c = 0; c < CERT_CONTENT_CACHE_SIZE; c++) {
+        ctx->cert_cache[c].match_valid = false;
+        ctx->cert_cache[c].match = NULL;
+    }
+}
+
 int sss_certmap_add_rule(struct sss_certmap_ctx *ctx,
                          uint32_t priority, const char *match_rule,
                          const char *map_rule, const char **domains)
@@ -191,6 +306,12 @@ int sss_certmap_add_rule(struct sss_certmap_ctx *ctx,
         goto done;
     }
 
+    ret = compile_prefilter(rule);
+    if (ret != 0) {
+        CM_DEBUG(ctx, "Failed to compile matching rule prefilter.");
+        goto done;
+    }
+
     if (map_rule == NULL) {
         map_rule = DEFAULT_MAP_RULE;
     }
@@ -261,6 +382,10 @@ int sss_certmap_add_rule(struct sss_certmap_ctx *ctx,
 
     talloc_steal(ctx, rule);
 
+    /* the new rule might match certificates which did not match before or
+     * take precedence over previous matches */
+    cert_cache_invalidate_matches(ctx);
+
     ret = EOK;
 
 done:
@@ -835,15 +960,145 @@ static int do_match(struct sss_certmap_ctx *ctx,
     return ENOENT;
 }
 
+static bool prefilter_match(struct match_map_rule *rule,
+                            struct cert_content_cache_entry *entry)
+{
+    struct sss_cert_content *cert_content = entry->content;
+    size_t c;
+
+    if ((cert_content->key_usage & rule->required_ku) != rule->required_ku) {
+        return false;
+    }
+
+    if (rule->required_issuer != NULL) {
+        if (cert_content->issuer_str == NULL
+                || entry->issuer_hash != rule->required_issuer_hash
+                || strcmp(cert_content->issuer_str,
+                          rule->required_issuer) != 0) {
+            return false;
+        }
+    }
+
+    if (rule->required_eku != NULL) {
+        if (cert_content->extended_key_usage_oids == NULL) {
+            return false;
+        }
+
+        for (c = 0; rule->required_eku[c] != NULL; c++) {
+            if (!string_in_list(rule->required_eku[c],
+                                discard_const(
+                                         cert_content->extended_key_usage_oids),
+                                true)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static int get_cached_cert_content(struct sss_certmap_ctx *ctx,
+                                   const uint8_t *der_cert, size_t der_size,
+                                   struct cert_content_cache_entry **_entry)
+{
+    struct cert_content_cache_entry *entry;
+    struct sss_cert_content *content;
+    uint32_t hash;
+    size_t c;
+    int ret;
+
+    if (der_cert == NULL || der_size == 0 || der_size > INT_MAX) {
+        return EINVAL;
+    }
+
+    hash = murmurhash3((const char *) der_cert, der_size, 0);
+
+    for (c = 0; c < CERT_CONTENT_CACHE_SIZE; c++) {
+        entry = &ctx->cert_cache[c];
+        if (entry->content != NULL
+                && entry->hash == hash
+                && entry->content->cert_der_size == der_size
+                && memcmp(entry->content->cert_der, der_cert, der_size) == 0) {
+            entry->last_used = ++ctx->cert_cache_tick;
+            *_entry = entry;
+            return 0;
+        }
+    }
+
+    ret = sss_cert_get_content(ctx, der_cert, der_size, &content);
+    if (ret != 0) {
+        return ret;
+    }
+
+    /* replace the least recently used entry */
+    entry = &ctx->cert_cache[0];
+    for (c = 1; c < CERT_CONTENT_CACHE_SIZE; c++) {
+        if (ctx->cert_cache[c].last_used < entry->last_used) {
+            entry = &ctx->cert_cache[c];
+        }
+    }
+
+    talloc_free(entry->content);
+    entry->content = content;
+    entry->hash = hash;
+    entry->last_used = ++ctx->cert_cache_tick;
+    entry->match_valid = false;
+    entry->match = NULL;
+    entry->issuer_hash = 0;
+    if (content->issuer_str != NULL) {
+        entry->issuer_hash = murmurhash3(content->issuer_str,
+                                         strlen(content->issuer_str), 0);
+    }
+
+    *_entry = entry;
+    return 0;
+}
+
+static int get_matching_rule(struct sss_certmap_ctx *ctx,
+                             struct cert_content_cache_entry *entry,
+                             struct match_map_rule **_rule)
+{
+    struct match_map_rule *r;
+    struct priority_list *p;
+    int ret;
+
+    if (!entry->match_valid) {
+        entry->match = NULL;
+
+        for (p = ctx->prio_list; p != NULL && entry->match == NULL;
+                                                                p = p->next) {
+            for (r = p->rule_list; r != NULL; r = r->next) {
+                if (!prefilter_match(r, entry)) {
+                    continue;
+                }
+
+                ret = do_match(ctx, r->parsed_match_rule, entry->content);
+                if (ret == 0) {
+                    entry->match = r;
+                    break;
+                }
+            }
+        }
+
+        entry->match_valid = true;
+    }
+
+    if (entry->match == NULL) {
+        return ENOENT;
+    }
+
+    *_rule = entry->match;
+    return 0;
+}
+
 int sss_certmap_match_cert(struct sss_certmap_ctx *ctx,
                            const uint8_t *der_cert, size_t der_size)
 {
     int ret;
     struct match_map_rule *r;
-    struct priority_list *p;
-    struct sss_cert_content *cert_content = NULL;
+    struct cert_content_cache_entry *entry;
 
-    ret = sss_cert_get_content(ctx, der_cert, der_size, &cert_content);
+    ret = get_cached_cert_content(ctx, der_cert, der_size, &entry);
     if (ret != 0) {
         CM_DEBUG(ctx, "Failed to get certificate content.");
         return ret;
@@ -851,25 +1106,10 @@ int sss_certmap_match_cert(struct sss_certmap_ctx *ctx,
 
     if (ctx->prio_list == NULL) {
         /* Match all certificates if there are no rules applied */
-        ret = 0;
-        goto done;
-    }
-
-    for (p = ctx->prio_list; p != NULL; p = p->next) {
-        for (r = p->rule_list; r != NULL; r = r->next) {
-            ret = do_match(ctx, r->parsed_match_rule, cert_content);
-            if (ret == 0) {
-                /* match */
-                goto done;
-            }
-        }
+        return 0;
     }
 
-    ret = ENOENT;
-done:
-    talloc_free(cert_content);
-
-    return ret;
+    return get_matching_rule(ctx, entry, &r);
 }
 
 int sss_certmap_get_search_filter(struct sss_certmap_ctx *ctx,
@@ -878,8 +1118,7 @@ int sss_certmap_get_search_filter(struct sss_certmap_ctx *ctx,
 {
     int ret;
     struct match_map_rule *r;
-    struct priority_list *p;
-    struct sss_cert_content *cert_content = NULL;
+    struct cert_content_cache_entry *entry;
     char *filter = NULL;
     char **domains = NULL;
     size_t c;
@@ -888,7 +1127,7 @@ int sss_certmap_get_search_filter(struct sss_certmap_ctx *ctx,
         return EINVAL;
     }
 
-    ret = sss_cert_get_content(ctx, der_cert, der_size, &cert_content);
+    ret = get_cached_cert_content(ctx, der_cert, der_size, &entry);
     if (ret != 0) {
         CM_DEBUG(ctx, "Failed to get certificate content [%d].", ret);
         return ret;
@@ -900,49 +1139,42 @@ int sss_certmap_get_search_filter(struct sss_certmap_ctx *ctx,
             return EINVAL;
         }
 
-        ret = get_filter(ctx, ctx->default_mapping_rule, cert_content, &filter);
+        ret = get_filter(ctx, ctx->default_mapping_rule, entry->content,
+                         &filter);
         goto done;
     }
 
-    for (p = ctx->prio_list; p != NULL; p = p->next) {
-        for (r = p->rule_list; r != NULL; r = r->next) {
-            ret = do_match(ctx, r->parsed_match_rule, cert_content);
-            if (ret == 0) {
-                /* match */
-                ret = get_filter(ctx, r->parsed_mapping_rule, cert_content,
-                                 &filter);
-                if (ret != 0) {
-                    CM_DEBUG(ctx, "Failed to get filter");
-                    goto done;
-                }
+    ret = get_matching_rule(ctx, entry, &r);
+    if (ret != 0) {
+        goto done;
+    }
 
-                if (r->domains != NULL) {
-                    for (c = 0; r->domains[c] != NULL; c++);
-                    domains = talloc_zero_array(ctx, char *, c + 1);
-                    if (domains == NULL) {
-                        ret = ENOMEM;
-                        goto done;
-                    }
-
-                    for (c = 0; r->domains[c] != NULL; c++) {
-                        domains[c] = talloc_strdup(domains, r->domains[c]);
-                        if (domains[c] == NULL) {
-                            ret = ENOMEM;
-                            goto done;
-                        }
-                    }
-                }
+    ret = get_filter(ctx, r->parsed_mapping_rule, entry->content, &filter);
+    if (ret != 0) {
+        CM_DEBUG(ctx, "Failed to get filter");
+        goto done;
+    }
 
-                ret = 0;
+    if (r->domains != NULL) {
+        for (c = 0; r->domains[c] != NULL; c++);
+        domains = talloc_zero_array(ctx, char *, c + 1);
+        if (domains == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        for (c = 0; r->domains[c] != NULL; c++) {
+            domains[c] = talloc_strdup(domains, r->domains[c]);
+            if (domains[c] == NULL) {
+                ret = ENOMEM;
                 goto done;
             }
         }
     }
 
-    ret = ENOENT;
+    ret = 0;
 
 done:
-    talloc_free(cert_content);
     if (ret == 0) {
         *_filter = filter;
         *_domains = domains;
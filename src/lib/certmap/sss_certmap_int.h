@@ -28,6 +28,7 @@
 #include <sys/types.h>
 #include <regex.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <talloc.h>
 
 #define CM_DEBUG(cm_ctx, format, ...) do { \
@@ -116,6 +117,15 @@ struct match_map_rule {
     uint32_t priority;
     char *match_rule;
     struct krb5_match_rule *parsed_match_rule;
+    /* Prefilter for rules where all components must match, the key usage
+     * bits, extended key usage OIDs and an issuer given as an exact string
+     * are cheap to check and are evaluated before any regular expression.
+     * Issuer expressions which are not a plain anchored string are only
+     * evaluated by the regular expression. */
+    uint32_t required_ku;
+    const char **required_eku;
+    char *required_issuer;
+    uint32_t required_issuer_hash;
     char *map_rule;
     struct ldap_mapping_rule *parsed_mapping_rule;
     char **domains;
@@ -130,11 +140,30 @@ struct priority_list {
     struct priority_list *next;
 };
 
+/* Number of decoded certificates kept in the certmap context. Smartcard
+ * logins typically look up the same few certificates repeatedly. */
+#define CERT_CONTENT_CACHE_SIZE 8
+
+struct cert_content_cache_entry {
+    uint32_t hash;
+    struct sss_cert_content *content;
+    uint64_t last_used;
+    /* hash of content->issuer_str for the issuer prefilter */
+    uint32_t issuer_hash;
+
+    /* Result of the last rule evaluation, reset when rules are added */
+    bool match_valid;
+    struct match_map_rule *match;
+};
+
 struct sss_certmap_ctx {
     struct priority_list *prio_list;
     sss_certmap_ext_debug *debug;
     void *debug_priv;
     struct ldap_mapping_rule *default_mapping_rule;
+
+    struct cert_content_cache_entry cert_cache[CERT_CONTENT_CACHE_SIZE];
+    uint64_t cert_cache_tick;
 };
 
 struct san_list {
@@ -1434,6 +1434,40 @@ static int add_new_provider(struct mt_ctx *ctx,
     return ret;
 }
 
+/* Services read their options from the snapshot, it is not fatal if it
+ * cannot be written because they fall back to the confdb */
+static void monitor_write_snapshot(struct mt_ctx *ctx)
+{
+    char *snapshot_file;
+    errno_t ret;
+
+    snapshot_file = talloc_asprintf(ctx, "%s/%s", DB_PATH,
+                                    CONFDB_SNAPSHOT_FILE);
+    if (snapshot_file == NULL) {
+        return;
+    }
+
+    ret = confdb_snapshot_write(ctx->cdb, snapshot_file);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Cannot write the confdb snapshot [%d]: %s\n",
+              ret, sss_strerror(ret));
+        goto done;
+    }
+
+    ret = chown(snapshot_file, ctx->uid, ctx->gid);
+    if (ret != 0) {
+        ret = errno;
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "chown failed for [%s]: [%d][%s].\n",
+              snapshot_file, ret, sss_strerror(ret));
+        unlink(snapshot_file);
+    }
+
+done:
+    talloc_free(snapshot_file);
+}
+
 static void monitor_hup(struct tevent_context *ev,
                         struct tevent_signal *se,
                         int signum,
@@ -1446,6 +1480,10 @@ static void monitor_hup(struct tevent_context *ev,
 
     DEBUG(SSSDBG_CRIT_FAILURE, "Received SIGHUP.\n");
 
+    /* sss_debuglevel modifies the confdb and removes the snapshot before
+     * sending SIGHUP, the services pick up the new one when rotating */
+    monitor_write_snapshot(ctx);
+
     /* Send D-Bus message to other services to rotate their logs.
      * NSS service receives also message to clear memory caches. */
     for(cur_svc = ctx->svc_list; cur_svc; cur_svc = cur_svc->next) {
@@ -1692,6 +1730,7 @@ errno_t load_configuration(TALLOC_CTX *mem_ctx,
     errno_t ret;
     struct mt_ctx *ctx;
     char *cdb_file = NULL;
+    char *snapshot_file = NULL;
 
     ctx = talloc_zero(mem_ctx, struct mt_ctx);
     if(!ctx) {
@@ -1708,6 +1747,24 @@ errno_t load_configuration(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
+    snapshot_file = talloc_asprintf(ctx, "%s/%s", DB_PATH,
+                                    CONFDB_SNAPSHOT_FILE);
+    if (snapshot_file == NULL) {
+        DEBUG(SSSDBG_FATAL_FAILURE,"Out of memory, aborting!\n");
+        ret = ENOMEM;
+        goto done;
+    }
+
+    /* The confdb might be recreated from scratch, never let a snapshot of
+     * the previous one be used with it */
+    ret = unlink(snapshot_file);
+    if (ret != 0 && errno != ENOENT) {
+        ret = errno;
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Cannot remove [%s]: [%d][%s].\n",
+              snapshot_file, ret, sss_strerror(ret));
+    }
+
     ret = confdb_setup(ctx, cdb_file, config_file, config_dir, &ctx->cdb);
     if (ret != EOK) {
         DEBUG(SSSDBG_FATAL_FAILURE, "Unable to setup ConfDB [%d]: %s\n",
@@ -1733,12 +1790,15 @@ errno_t load_configuration(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
+    monitor_write_snapshot(ctx);
+
     *monitor = ctx;
 
     ret = EOK;
 
 done:
     talloc_free(cdb_file);
+    talloc_free(snapshot_file);
     if (ret != EOK) {
         talloc_free(ctx);
     }
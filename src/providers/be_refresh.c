@@ -18,6 +18,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <stdlib.h>
 #include <tevent.h>
 #include <talloc.h>
 #include <time.h>
@@ -29,21 +30,61 @@
 #include "util/util_errors.h"
 #include "db/sysdb.h"
 
-static errno_t be_refresh_get_values_ex(TALLOC_CTX *mem_ctx,
-                                        struct sss_domain_info *domain,
-                                        time_t period,
-                                        const char *objectclass,
-                                        struct ldb_dn *base_dn,
-                                        const char *attr,
-                                        char ***_values)
+/*
+ * Refreshing every expired entry at once produces a burst of requests to the
+ * server at the beginning of each interval and keeps refreshing entries that
+ * nobody has looked up for months. Instead, entries are ordered by how
+ * often the responders looked them up recently and refreshed in small
+ * batches spread evenly over the first three quarters of the interval, so
+ * that the last batch finishes before the task times out.
+ */
+#define BE_REFRESH_BATCH_INTERVAL 10
+
+struct be_refresh_item {
+    struct sss_domain_info *domain;
+    enum be_refresh_type type;
+    const char *name;
+    uint32_t score;
+    bool sent;
+};
+
+static int be_refresh_item_cmp(const void *a, const void *b)
+{
+    const struct be_refresh_item *item_a = a;
+    const struct be_refresh_item *item_b = b;
+
+    /* most used entries first */
+    if (item_a->score > item_b->score) {
+        return -1;
+    } else if (item_a->score < item_b->score) {
+        return 1;
+    }
+
+    return 0;
+}
+
+static errno_t be_refresh_get_items_ex(TALLOC_CTX *mem_ctx,
+                                       struct sss_domain_info *domain,
+                                       enum be_refresh_type type,
+                                       time_t period,
+                                       uint32_t idle_timeout,
+                                       struct ldb_dn *base_dn,
+                                       struct be_refresh_item **_items,
+                                       size_t *_num_items)
 {
     TALLOC_CTX *tmp_ctx = NULL;
-    const char *attrs[] = {attr, NULL};
+    const char *attrs[] = { SYSDB_NAME, SYSDB_CREATE_TIME,
+                            SYSDB_LAST_ACCESS, SYSDB_ACCESS_COUNT, NULL };
     const char *filter = NULL;
-    char **values = NULL;
+    const char *name;
     struct ldb_message **msgs = NULL;
-    struct sysdb_attrs **records = NULL;
+    struct be_refresh_item *items;
+    size_t num_items = *_num_items;
+    size_t num_idle = 0;
     size_t count;
+    size_t i;
+    time_t last_access;
+    uint32_t access_count;
     time_t now = time(NULL);
     errno_t ret;
 
@@ -63,54 +104,92 @@ static errno_t be_refresh_get_values_ex(TALLOC_CTX *mem_ctx,
                              LDB_SCOPE_SUBTREE, filter, attrs,
                              &count, &msgs);
     if (ret == ENOENT) {
-        count = 0;
+        ret = EOK;
+        goto done;
     } else if (ret != EOK) {
         goto done;
     }
 
-    ret = sysdb_msg2attrs(tmp_ctx, count, msgs, &records);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE,
-              "Could not convert ldb message to sysdb_attrs\n");
+    items = talloc_realloc(mem_ctx, *_items, struct be_refresh_item,
+                           num_items + count);
+    if (items == NULL) {
+        ret = ENOMEM;
         goto done;
     }
+    *_items = items;
 
-    ret = sysdb_attrs_to_list(tmp_ctx, records, count, attr, &values);
-    if (ret != EOK) {
-        goto done;
+    for (i = 0; i < count; i++) {
+        name = ldb_msg_find_attr_as_string(msgs[i], SYSDB_NAME, NULL);
+        if (name == NULL) {
+            continue;
+        }
+
+        /* Entries cached before the responders recorded their lookups
+         * count as looked up when they were cached. */
+        last_access = ldb_msg_find_attr_as_uint64(msgs[i], SYSDB_LAST_ACCESS,
+                                                  0);
+        if (last_access == 0) {
+            last_access = ldb_msg_find_attr_as_uint64(msgs[i],
+                                                      SYSDB_CREATE_TIME, 0);
+        }
+
+        if (idle_timeout > 0 && last_access + idle_timeout < now) {
+            num_idle++;
+            continue;
+        }
+
+        access_count = ldb_msg_find_attr_as_uint(msgs[i], SYSDB_ACCESS_COUNT,
+                                                 0);
+
+        items[num_items].domain = domain;
+        items[num_items].type = type;
+        items[num_items].name = talloc_strdup(items, name);
+        items[num_items].score = sysdb_decay_access_count(access_count,
+                                                          last_access, now);
+        items[num_items].sent = false;
+        if (items[num_items].name == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+        num_items++;
+    }
+
+    if (num_idle > 0) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Skipping %zu entries that were not looked "
+              "up for %u seconds\n", num_idle, idle_timeout);
     }
 
-    *_values = talloc_steal(mem_ctx, values);
     ret = EOK;
 
 done:
+    if (ret == EOK) {
+        *_num_items = num_items;
+    }
     talloc_free(tmp_ctx);
 
     return ret;
 }
 
-static errno_t be_refresh_get_values(TALLOC_CTX *mem_ctx,
-                                     enum be_refresh_type type,
-                                     struct sss_domain_info *domain,
-                                     time_t period,
-                                     char ***_values)
+static errno_t be_refresh_get_items(TALLOC_CTX *mem_ctx,
+                                    enum be_refresh_type type,
+                                    struct sss_domain_info *domain,
+                                    time_t period,
+                                    uint32_t idle_timeout,
+                                    struct be_refresh_item **_items,
+                                    size_t *_num_items)
 {
     struct ldb_dn *base_dn = NULL;
-    const char *class = NULL;
     errno_t ret;
 
     switch (type) {
     case BE_REFRESH_TYPE_USERS:
         base_dn = sysdb_user_base_dn(mem_ctx, domain);
-        class = SYSDB_USER_CLASS;
         break;
     case BE_REFRESH_TYPE_GROUPS:
         base_dn = sysdb_group_base_dn(mem_ctx, domain);
-        class = SYSDB_GROUP_CLASS;
         break;
     case BE_REFRESH_TYPE_NETGROUPS:
         base_dn = sysdb_netgroup_base_dn(mem_ctx, domain);
-        class = SYSDB_NETGROUP_CLASS;
         break;
     case BE_REFRESH_TYPE_SENTINEL:
         return ERR_INTERNAL;
@@ -121,8 +200,8 @@ static errno_t be_refresh_get_values(TALLOC_CTX *mem_ctx,
         return ENOMEM;
     }
 
-    ret = be_refresh_get_values_ex(mem_ctx, domain, period, class,
-                                   base_dn, SYSDB_NAME, _values);
+    ret = be_refresh_get_items_ex(mem_ctx, domain, type, period,
+                                  idle_timeout, base_dn, _items, _num_items);
 
     talloc_free(base_dn);
     return ret;
@@ -185,12 +264,21 @@ struct be_refresh_state {
     struct be_refresh_ctx *ctx;
     struct be_refresh_cb *cb;
 
-    struct sss_domain_info *domain;
-    enum be_refresh_type index;
-    time_t period;
+    struct be_refresh_item *items;
+    size_t num_items;
+    size_t batch_size;
+    /* first item of the current batch */
+    size_t batch_start;
+    unsigned int batch;
+    time_t start;
 };
 
+static errno_t be_refresh_collect(struct be_refresh_state *state,
+                                  time_t period);
+static void be_refresh_schedule(struct be_refresh_state *state,
+                                time_t spread);
 static errno_t be_refresh_step(struct tevent_req *req);
+static void be_refresh_wakeup_done(struct tevent_req *subreq);
 static void be_refresh_done(struct tevent_req *subreq);
 
 struct tevent_req *be_refresh_send(TALLOC_CTX *mem_ctx,
@@ -201,6 +289,8 @@ struct tevent_req *be_refresh_send(TALLOC_CTX *mem_ctx,
 {
     struct be_refresh_state *state = NULL;
     struct tevent_req *req = NULL;
+    time_t period;
+    time_t timeout;
     errno_t ret;
 
     req = tevent_req_create(mem_ctx, &state,
@@ -212,14 +302,28 @@ struct tevent_req *be_refresh_send(TALLOC_CTX *mem_ctx,
 
     state->ev = ev;
     state->be_ctx = be_ctx;
-    state->domain = be_ctx->domain;
-    state->period = be_ptask_get_period(be_ptask);
+    state->start = time(NULL);
     state->ctx = talloc_get_type(pvt, struct be_refresh_ctx);
     if (state->ctx == NULL) {
         ret = EINVAL;
         goto immediately;
     }
 
+    period = be_ptask_get_period(be_ptask);
+    timeout = be_ptask_get_timeout(be_ptask);
+
+    ret = be_refresh_collect(state, period);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to obtain list of expired "
+              "entries [%d]: %s\n", ret, sss_strerror(ret));
+        goto immediately;
+    }
+
+    if (timeout > 0 && timeout < period) {
+        period = timeout;
+    }
+    be_refresh_schedule(state, period * 3 / 4);
+
     ret = be_refresh_step(req);
     if (ret == EOK) {
         goto immediately;
@@ -242,71 +346,211 @@ immediately:
     return req;
 }
 
-static errno_t be_refresh_step(struct tevent_req *req)
+static errno_t be_refresh_collect(struct be_refresh_state *state,
+                                  time_t period)
+{
+    struct sss_domain_info *domain;
+    struct be_refresh_cb *cb;
+    enum be_refresh_type type;
+    uint32_t idle_timeout;
+    errno_t ret;
+
+    idle_timeout = state->be_ctx->domain->refresh_expired_idle_timeout;
+
+    for (domain = state->be_ctx->domain;
+         domain != NULL;
+         domain = get_next_domain(domain, 0)) {
+        for (type = 0; type < BE_REFRESH_TYPE_SENTINEL; type++) {
+            cb = &state->ctx->callbacks[type];
+            if (!cb->enabled) {
+                continue;
+            }
+
+            if (cb->send_fn == NULL || cb->recv_fn == NULL) {
+                DEBUG(SSSDBG_CRIT_FAILURE, "Invalid parameters!\n");
+                return ERR_INTERNAL;
+            }
+
+            ret = be_refresh_get_items(state, type, domain, period,
+                                       idle_timeout, &state->items,
+                                       &state->num_items);
+            if (ret != EOK) {
+                return ret;
+            }
+        }
+    }
+
+    if (state->num_items > 0) {
+        qsort(state->items, state->num_items, sizeof(struct be_refresh_item),
+              be_refresh_item_cmp);
+    }
+
+    return EOK;
+}
+
+static void be_refresh_schedule(struct be_refresh_state *state,
+                                time_t spread)
+{
+    uint32_t max_rate;
+    size_t num_batches;
+    size_t limit;
+
+    num_batches = spread / BE_REFRESH_BATCH_INTERVAL;
+    if (num_batches == 0) {
+        num_batches = 1;
+    }
+
+    max_rate = state->be_ctx->domain->refresh_expired_max_rate;
+    if (max_rate > 0) {
+        limit = (size_t) max_rate * BE_REFRESH_BATCH_INTERVAL * num_batches;
+        if (state->num_items > limit) {
+            /* the least used entries are refreshed when they are looked up */
+            DEBUG(SSSDBG_CONF_SETTINGS, "%zu entries need to be refreshed but "
+                  "%s limits the refresh to %zu, skipping the least used "
+                  "ones\n", state->num_items,
+                  CONFDB_DOMAIN_REFRESH_EXPIRED_MAX_RATE, limit);
+            state->num_items = limit;
+        }
+    }
+
+    state->batch_size = (state->num_items + num_batches - 1) / num_batches;
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Refreshing %zu entries in batches of %zu "
+          "every %d seconds\n", state->num_items, state->batch_size,
+          BE_REFRESH_BATCH_INTERVAL);
+}
+
+static errno_t be_refresh_send_group(struct tevent_req *req,
+                                     size_t first,
+                                     size_t end)
 {
     struct be_refresh_state *state = NULL;
+    struct be_refresh_item *group = NULL;
     struct tevent_req *subreq = NULL;
     char **values = NULL;
-    errno_t ret;
+    size_t num_values = 0;
+    size_t i;
 
     state = tevent_req_data(req, struct be_refresh_state);
+    group = &state->items[first];
 
-    while (state->domain != NULL) {
-        /* find first enabled callback */
-        state->cb = &state->ctx->callbacks[state->index];
-        while (state->index != BE_REFRESH_TYPE_SENTINEL && !state->cb->enabled) {
-            state->index++;
-            state->cb = &state->ctx->callbacks[state->index];
-        }
+    values = talloc_zero_array(state, char *, end - first + 1);
+    if (values == NULL) {
+        return ENOMEM;
+    }
 
-        /* if not found than continue with next domain */
-        if (state->index == BE_REFRESH_TYPE_SENTINEL) {
-            state->domain = get_next_domain(state->domain, 0);
+    /* Send all entries of the batch that belong to the same domain and
+     * type as the first one that was not sent yet. */
+    for (i = first; i < end; i++) {
+        if (state->items[i].sent
+                || state->items[i].domain != group->domain
+                || state->items[i].type != group->type) {
             continue;
         }
 
-        if (state->cb->send_fn == NULL || state->cb->recv_fn == NULL) {
-            DEBUG(SSSDBG_CRIT_FAILURE, "Invalid parameters!\n");
-            ret = ERR_INTERNAL;
-            goto done;
+        values[num_values] = discard_const(state->items[i].name);
+        num_values++;
+        state->items[i].sent = true;
+    }
+
+    state->cb = &state->ctx->callbacks[group->type];
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Refreshing %zu %s in domain %s\n",
+          num_values, state->cb->name, group->domain->name);
+
+    subreq = state->cb->send_fn(state, state->ev, state->be_ctx,
+                                group->domain, values, state->cb->pvt);
+    if (subreq == NULL) {
+        talloc_free(values);
+        return ENOMEM;
+    }
+
+    /* make the list disappear with subreq */
+    talloc_steal(subreq, values);
+
+    tevent_req_set_callback(subreq, be_refresh_done, req);
+
+    return EOK;
+}
+
+static errno_t be_refresh_step(struct tevent_req *req)
+{
+    struct be_refresh_state *state = NULL;
+    struct tevent_req *subreq = NULL;
+    struct timeval tv;
+    time_t next;
+    size_t end;
+    size_t i;
+    errno_t ret;
+
+    state = tevent_req_data(req, struct be_refresh_state);
+
+    while (state->batch_start < state->num_items) {
+        end = MIN(state->batch_start + state->batch_size, state->num_items);
+
+        for (i = state->batch_start; i < end; i++) {
+            if (!state->items[i].sent) {
+                break;
+            }
         }
 
-        ret = be_refresh_get_values(state, state->index, state->domain,
-                                    state->period, &values);
-        if (ret != EOK) {
-            DEBUG(SSSDBG_CRIT_FAILURE, "Unable to obtain DN list [%d]: %s\n",
-                                        ret, sss_strerror(ret));
-            goto done;
+        if (i < end) {
+            ret = be_refresh_send_group(req, i, end);
+            if (ret != EOK) {
+                return ret;
+            }
+
+            return EAGAIN;
         }
 
-        DEBUG(SSSDBG_TRACE_FUNC, "Refreshing %s in domain %s\n",
-              state->cb->name, state->domain->name);
+        /* the batch is done, wait for the next one */
+        state->batch_start = end;
+        state->batch++;
+        if (state->batch_start >= state->num_items) {
+            break;
+        }
 
-        subreq = state->cb->send_fn(state, state->ev, state->be_ctx,
-                                    state->domain, values, state->cb->pvt);
-        if (subreq == NULL) {
-            ret = ENOMEM;
-            goto done;
+        next = state->start + state->batch * BE_REFRESH_BATCH_INTERVAL;
+        if (next > time(NULL)) {
+            tv = tevent_timeval_set(next, 0);
+            subreq = tevent_wakeup_send(state, state->ev, tv);
+            if (subreq == NULL) {
+                return ENOMEM;
+            }
+
+            tevent_req_set_callback(subreq, be_refresh_wakeup_done, req);
+            return EAGAIN;
         }
+    }
 
-        /* make the list disappear with subreq */
-        talloc_steal(subreq, values);
+    return EOK;
+}
 
-        tevent_req_set_callback(subreq, be_refresh_done, req);
+static void be_refresh_wakeup_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = NULL;
+    errno_t ret;
+    bool bret;
 
-        state->index++;
-        ret = EAGAIN;
-        goto done;
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+
+    bret = tevent_wakeup_recv(subreq);
+    talloc_zfree(subreq);
+    if (!bret) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "tevent_wakeup_recv() failed\n");
     }
 
-    ret = EOK;
+    ret = be_refresh_step(req);
+    if (ret == EAGAIN) {
+        return;
+    }
 
-done:
-    if (ret != EOK && ret != EAGAIN) {
-        talloc_free(values);
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
     }
 
-    return ret;
+    tevent_req_done(req);
 }
 
 static void be_refresh_done(struct tevent_req *subreq)
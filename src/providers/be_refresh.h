@@ -30,7 +30,8 @@
 struct be_ctx;
 
 /**
- * name_list contains SYSDB_NAME of all expired records.
+ * values contains SYSDB_NAME of a batch of expired records of one domain,
+ * the most used records first.
  */
 typedef struct tevent_req *
 (*be_refresh_send_t)(TALLOC_CTX *mem_ctx,
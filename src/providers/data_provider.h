@@ -329,6 +329,11 @@ enum dp_res_opts {
     DP_RES_OPT_RESOLVER_TIMEOUT,
     DP_RES_OPT_RESOLVER_OP_TIMEOUT,
     DP_RES_OPT_DNS_DOMAIN,
+    DP_RES_OPT_USE_CACHE,
+    DP_RES_OPT_NEGATIVE_TTL,
+    DP_RES_OPT_STALE_TIME,
+    DP_RES_OPT_RACE_SERVERS,
+    DP_RES_OPT_RACE_DELAY,
 
     DP_RES_OPTS /* attrs counter */
 };
@@ -67,6 +67,29 @@ static int dp_destructor(struct data_provider *provider)
     return 0;
 }
 
+static errno_t dp_get_limit(struct be_ctx *be_ctx,
+                            const char *option,
+                            uint32_t *_limit)
+{
+    int val;
+    errno_t ret;
+
+    ret = confdb_get_int(be_ctx->cdb, be_ctx->conf_path, option, 0, &val);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to read %s [%d]: %s\n",
+              option, ret, sss_strerror(ret));
+        return ret;
+    }
+
+    if (val < 0) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Invalid value of %s: %d\n", option, val);
+        return EINVAL;
+    }
+
+    *_limit = val;
+    return EOK;
+}
+
 errno_t dp_init(struct tevent_context *ev,
                 struct be_ctx *be_ctx,
                 uid_t uid,
@@ -94,6 +117,18 @@ errno_t dp_init(struct tevent_context *ev,
         goto done;
     }
 
+    ret = dp_get_limit(be_ctx, CONFDB_DOMAIN_DP_MAX_ACTIVE_REQUESTS,
+                       &provider->requests.sched.max_active);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = dp_get_limit(be_ctx, CONFDB_DOMAIN_DP_MAX_QUEUED_REQUESTS,
+                       &provider->requests.sched.max_queued);
+    if (ret != EOK) {
+        goto done;
+    }
+
     /* Initialize data provider bus. Data provider can receive client
      * registration and other D-Bus methods. However no data provider
      * request will be executed as long as the modules and targets
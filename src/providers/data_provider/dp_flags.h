@@ -26,4 +26,11 @@
  */
 #define DP_FAST_REPLY   0x0001
 
+/**
+ * The responder has the requested object in its cache and returns it if
+ * the request fails. The data provider may refuse the request with
+ * ERR_OFFLINE when it is overloaded.
+ */
+#define DP_CACHED       0x0002
+
 #endif /* _DP_FLAGS_H_ */
@@ -42,9 +42,38 @@ enum dp_clients {
     DP_CLIENT_SENTINEL
 };
 
+/* Requests are started in this order when they have to be queued. */
+enum dp_req_class {
+    DP_REQ_CLASS_AUTH,
+    DP_REQ_CLASS_ACCOUNT,
+    DP_REQ_CLASS_ID,
+    DP_REQ_CLASS_REFRESH,
+
+    DP_REQ_CLASS_SENTINEL
+};
+
 struct dp_req;
+struct dp_req_queue_item;
 struct dp_client;
 
+struct dp_req_sched {
+    /* Configured limits, zero means no limit. */
+    uint32_t max_active;
+    uint32_t max_queued;
+
+    uint32_t num_running;
+    uint32_t running[DP_REQ_CLASS_SENTINEL];
+    uint32_t queued[DP_REQ_CLASS_SENTINEL];
+
+    /* One queue per class and client, requests without a known client
+     * are queued at index DP_CLIENT_SENTINEL. */
+    struct dp_req_queue_item *queues[DP_REQ_CLASS_SENTINEL]
+                                    [DP_CLIENT_SENTINEL + 1];
+    unsigned int next_client[DP_REQ_CLASS_SENTINEL];
+
+    struct tevent_timer *dispatch;
+};
+
 struct dp_module {
     bool initialized;
     const char *name;
@@ -95,6 +124,9 @@ struct data_provider {
          * <tevent_req, list of sbus_request>
          */
         hash_table_t *reply_table;
+
+        /* Queues of requests that wait for execution. */
+        struct dp_req_sched sched;
     } requests;
 
     struct dp_module **modules;
@@ -27,6 +27,7 @@
 #include "providers/backend.h"
 #include "util/dlinklist.h"
 #include "util/util.h"
+#include "util/sss_stats.h"
 
 struct dp_req {
     struct data_provider *provider;
@@ -44,12 +45,29 @@ struct dp_req {
     struct tevent_req *req;
     struct tevent_req *handler_req;
     void *request_data;
+    struct dp_req_params *params;
+
+    /* Scheduling. */
+    enum dp_req_class req_class;
+    struct dp_req_queue_item *queued;
+    bool running;
+    uint64_t submitted;
 
     /* Active request list. */
     struct dp_req *prev;
     struct dp_req *next;
 };
 
+struct dp_req_queue_item {
+    struct dp_req *dp_req;
+    struct dp_req_queue_item **queue;
+
+    struct dp_req_queue_item *prev;
+    struct dp_req_queue_item *next;
+};
+
+static void dp_req_release(struct dp_req *dp_req);
+
 static bool check_data_type(const char *expected,
                             const char *description,
                             void *ptr)
@@ -84,6 +102,8 @@ static bool check_method_data(struct dp_method *method,
 
 static int dp_req_destructor(struct dp_req *dp_req)
 {
+    dp_req_release(dp_req);
+
     DLIST_REMOVE(dp_req->provider->requests.active, dp_req);
 
     if (dp_req->provider->requests.num_active == 0) {
@@ -128,6 +148,22 @@ static errno_t dp_attach_req(struct dp_req *dp_req,
     return EOK;
 }
 
+static enum dp_req_class dp_req_get_class(enum dp_targets target)
+{
+    switch (target) {
+    case DPT_AUTH:
+    case DPT_CHPASS:
+        return DP_REQ_CLASS_AUTH;
+    case DPT_ACCESS:
+    case DPT_SELINUX:
+        return DP_REQ_CLASS_ACCOUNT;
+    case DPT_SUBDOMAINS:
+        return DP_REQ_CLASS_REFRESH;
+    default:
+        return DP_REQ_CLASS_ID;
+    }
+}
+
 static errno_t
 dp_req_new(TALLOC_CTX *mem_ctx,
            struct data_provider *provider,
@@ -160,6 +196,7 @@ dp_req_new(TALLOC_CTX *mem_ctx,
     dp_req->method = method;
     dp_req->request_data = request_data;
     dp_req->req = req;
+    dp_req->req_class = dp_req_get_class(target);
 
     ret = dp_attach_req(dp_req, provider, name, dp_flags);
     if (ret != EOK) {
@@ -204,7 +241,6 @@ file_dp_request(TALLOC_CTX *mem_ctx,
                 struct dp_req **_dp_req)
 {
     struct dp_req_params *dp_params;
-    dp_req_send_fn send_fn;
     struct dp_req *dp_req;
     struct be_ctx *be_ctx;
     errno_t ret;
@@ -250,13 +286,8 @@ file_dp_request(TALLOC_CTX *mem_ctx,
     dp_params->target = dp_req->target;
     dp_params->method = dp_req->method;
 
-    send_fn = dp_req->execute->send_fn;
-    dp_req->handler_req = send_fn(dp_req, dp_req->execute->method_data,
-                                  dp_req->request_data, dp_params);
-    if (dp_req->handler_req == NULL) {
-        ret = ENOMEM;
-        goto done;
-    }
+    /* The request is executed by dp_sched_submit() */
+    dp_req->params = dp_params;
 
     *_dp_req = dp_req;
 
@@ -266,14 +297,263 @@ done:
     return ret;
 }
 
+/*
+ * Scheduling of requests.
+ *
+ * If max_active is set, only so many requests are executed at the same
+ * time and the others wait in a queue. Queued requests are started in the
+ * order of their class and requests of different clients of the same
+ * class are started in turns, so that e.g. a burst of lookups from the nss
+ * responder does not delay authentication in the pam responder. Identity
+ * lookups and lookups of trusted domains can use only a part of the
+ * requests to always leave room for authentication.
+ *
+ * If max_queued is set and a class already has that many queued requests,
+ * requests with DP_CACHED are answered with ERR_OFFLINE immediately. The
+ * responders send DP_CACHED only if they have the record in the cache,
+ * which they return in this case. Other requests are always queued.
+ */
+
+static uint32_t dp_sched_class_limit(struct dp_req_sched *sched,
+                                     enum dp_req_class req_class)
+{
+    switch (req_class) {
+    case DP_REQ_CLASS_ID:
+        return MAX(1, sched->max_active * 3 / 4);
+    case DP_REQ_CLASS_REFRESH:
+        return MAX(1, sched->max_active / 4);
+    default:
+        return sched->max_active;
+    }
+}
+
+static bool dp_sched_can_run(struct dp_req_sched *sched,
+                             enum dp_req_class req_class)
+{
+    if (sched->max_active == 0) {
+        return true;
+    }
+
+    if (sched->num_running >= sched->max_active) {
+        return false;
+    }
+
+    return sched->running[req_class] < dp_sched_class_limit(sched, req_class);
+}
+
+static unsigned int dp_sched_client_index(struct data_provider *provider,
+                                          struct dp_client *dp_cli)
+{
+    enum dp_clients client;
+
+    if (dp_cli != NULL) {
+        for (client = 0; client != DP_CLIENT_SENTINEL; client++) {
+            if (provider->clients[client] == dp_cli) {
+                return client;
+            }
+        }
+    }
+
+    return DP_CLIENT_SENTINEL;
+}
+
+static void dp_req_done(struct tevent_req *subreq);
+
+static errno_t dp_req_execute(struct dp_req *dp_req)
+{
+    struct dp_req_sched *sched;
+    dp_req_send_fn send_fn;
+
+    sched = &dp_req->provider->requests.sched;
+
+    send_fn = dp_req->execute->send_fn;
+    dp_req->handler_req = send_fn(dp_req, dp_req->execute->method_data,
+                                  dp_req->request_data, dp_req->params);
+    if (dp_req->handler_req == NULL) {
+        return ENOMEM;
+    }
+
+    tevent_req_set_callback(dp_req->handler_req, dp_req_done, dp_req->req);
+
+    dp_req->running = true;
+    sched->num_running++;
+    sched->running[dp_req->req_class]++;
+
+    sss_stats_record(SSS_STATS_DP_REQ_QUEUE, dp_req->submitted, false);
+
+    return EOK;
+}
+
+static int dp_req_queue_item_destructor(struct dp_req_queue_item *item)
+{
+    struct dp_req_sched *sched;
+
+    sched = &item->dp_req->provider->requests.sched;
+
+    DLIST_REMOVE(*item->queue, item);
+    sched->queued[item->dp_req->req_class]--;
+    item->dp_req->queued = NULL;
+
+    return 0;
+}
+
+static errno_t dp_sched_submit(struct dp_req *dp_req)
+{
+    struct data_provider *provider;
+    struct dp_req_queue_item *item;
+    struct dp_req_sched *sched;
+    enum dp_req_class req_class;
+    unsigned int client;
+
+    provider = dp_req->provider;
+    sched = &provider->requests.sched;
+    req_class = dp_req->req_class;
+
+    dp_req->submitted = sss_stats_now();
+
+    if (sched->queued[req_class] == 0 && dp_sched_can_run(sched, req_class)) {
+        return dp_req_execute(dp_req);
+    }
+
+    if (sched->max_queued != 0 && sched->queued[req_class] >= sched->max_queued
+            && dp_req->dp_flags & DP_CACHED) {
+        DP_REQ_DEBUG(SSSDBG_MINOR_FAILURE, dp_req->name,
+                     "Too many queued requests, replying offline.");
+        sss_stats_count(SSS_STATS_DP_REQ_SHED);
+        return ERR_OFFLINE;
+    }
+
+    item = talloc_zero(dp_req, struct dp_req_queue_item);
+    if (item == NULL) {
+        return ENOMEM;
+    }
+
+    client = dp_sched_client_index(provider, dp_req->client);
+
+    item->dp_req = dp_req;
+    item->queue = &sched->queues[req_class][client];
+    DLIST_ADD_END(*item->queue, item, struct dp_req_queue_item *);
+    sched->queued[req_class]++;
+    dp_req->queued = item;
+
+    talloc_set_destructor(item, dp_req_queue_item_destructor);
+
+    DP_REQ_DEBUG(SSSDBG_TRACE_FUNC, dp_req->name,
+                 "Request queued, %u requests of its class are waiting.",
+                 sched->queued[req_class]);
+
+    return EOK;
+}
+
+static struct dp_req *dp_sched_dequeue(struct dp_req_sched *sched,
+                                       enum dp_req_class req_class)
+{
+    struct dp_req_queue_item *item;
+    struct dp_req *dp_req;
+    unsigned int client;
+    unsigned int i;
+
+    for (i = 0; i <= DP_CLIENT_SENTINEL; i++) {
+        client = (sched->next_client[req_class] + i)
+                 % (DP_CLIENT_SENTINEL + 1);
+        item = sched->queues[req_class][client];
+        if (item == NULL) {
+            continue;
+        }
+
+        sched->next_client[req_class] = (client + 1) % (DP_CLIENT_SENTINEL + 1);
+
+        dp_req = item->dp_req;
+        talloc_free(item);
+
+        return dp_req;
+    }
+
+    return NULL;
+}
+
+static void dp_sched_dispatch(struct tevent_context *ev,
+                              struct tevent_timer *te,
+                              struct timeval tv,
+                              void *pvt)
+{
+    struct data_provider *provider;
+    struct dp_req_sched *sched;
+    enum dp_req_class req_class;
+    struct dp_req *dp_req;
+    errno_t ret;
+
+    provider = talloc_get_type(pvt, struct data_provider);
+    sched = &provider->requests.sched;
+    sched->dispatch = NULL;
+
+    for (req_class = 0; req_class != DP_REQ_CLASS_SENTINEL; req_class++) {
+        while (dp_sched_can_run(sched, req_class)) {
+            dp_req = dp_sched_dequeue(sched, req_class);
+            if (dp_req == NULL) {
+                break;
+            }
+
+            DP_REQ_DEBUG(SSSDBG_TRACE_FUNC, dp_req->name,
+                         "Executing queued request.");
+
+            ret = dp_req_execute(dp_req);
+            if (ret != EOK) {
+                tevent_req_error(dp_req->req, ret);
+            }
+        }
+    }
+}
+
+static void dp_req_release(struct dp_req *dp_req)
+{
+    struct data_provider *provider;
+    struct dp_req_sched *sched;
+    enum dp_req_class req_class;
+    struct timeval tv;
+
+    if (!dp_req->running) {
+        return;
+    }
+
+    provider = dp_req->provider;
+    sched = &provider->requests.sched;
+
+    dp_req->running = false;
+    sched->num_running--;
+    sched->running[dp_req->req_class]--;
+
+    if (provider->terminating || sched->dispatch != NULL) {
+        return;
+    }
+
+    for (req_class = 0; req_class != DP_REQ_CLASS_SENTINEL; req_class++) {
+        if (sched->queued[req_class] != 0) {
+            break;
+        }
+    }
+
+    if (req_class == DP_REQ_CLASS_SENTINEL) {
+        return;
+    }
+
+    /* Queued requests are started from the main loop so that the handler
+     * of a finished request is not executed recursively. */
+    tv = tevent_timeval_current();
+    sched->dispatch = tevent_add_timer(provider->ev, provider, tv,
+                                       dp_sched_dispatch, provider);
+    if (sched->dispatch == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to schedule queued requests!\n");
+    }
+}
+
 struct dp_req_state {
     struct dp_req *dp_req;
     dp_req_recv_fn recv_fn;
     void *output_data;
+    uint64_t stats_start;
 };
 
-static void dp_req_done(struct tevent_req *subreq);
-
 struct tevent_req *dp_req_send(TALLOC_CTX *mem_ctx,
                                struct data_provider *provider,
                                struct dp_client *dp_cli,
@@ -297,6 +577,8 @@ struct tevent_req *dp_req_send(TALLOC_CTX *mem_ctx,
         return NULL;
     }
 
+    state->stats_start = sss_stats_now();
+
     ret = file_dp_request(state, provider, dp_cli, domain, name, target,
                           method, dp_flags, request_data, req, &dp_req);
 
@@ -333,7 +615,10 @@ struct tevent_req *dp_req_send(TALLOC_CTX *mem_ctx,
 
     talloc_set_name_const(state->output_data, dp_req->execute->output_dtype);
 
-    tevent_req_set_callback(dp_req->handler_req, dp_req_done, req);
+    ret = dp_sched_submit(dp_req);
+    if (ret != EOK) {
+        goto immediately;
+    }
 
     return req;
 
@@ -362,6 +647,7 @@ static void dp_req_done(struct tevent_req *subreq)
     /* subreq is the same as dp_req->handler_req */
     talloc_zfree(subreq);
     state->dp_req->handler_req = NULL;
+    dp_req_release(state->dp_req);
 
     DP_REQ_DEBUG(SSSDBG_TRACE_FUNC, state->dp_req->name,
                  "Request handler finished [%d]: %s", ret, sss_strerror(ret));
@@ -380,9 +666,14 @@ errno_t _dp_req_recv(TALLOC_CTX *mem_ctx,
                      void **_output_data)
 {
     struct dp_req_state *state;
+    enum tevent_req_state tstate;
+    uint64_t err;
 
     state = tevent_req_data(req, struct dp_req_state);
 
+    sss_stats_record(SSS_STATS_DP_REQ, state->stats_start,
+                     tevent_req_is_error(req, &tstate, &err));
+
     if (state->dp_req != NULL) {
         DP_REQ_DEBUG(SSSDBG_TRACE_FUNC, state->dp_req->name,
                      "Receiving request data.");
@@ -405,6 +696,14 @@ errno_t _dp_req_recv(TALLOC_CTX *mem_ctx,
 
 static void dp_terminate_request(struct dp_req *dp_req)
 {
+    if (dp_req->queued != NULL) {
+        DP_REQ_DEBUG(SSSDBG_TRACE_ALL, dp_req->name, "Terminating.");
+
+        talloc_zfree(dp_req->queued);
+        tevent_req_error(dp_req->req, ERR_TERMINATED);
+        return;
+    }
+
     if (dp_req->handler_req == NULL) {
         /* This may occur when the handler already finished but the caller
          * of dp request did not yet recieved data/free dp_req. We just
@@ -417,6 +716,7 @@ static void dp_terminate_request(struct dp_req *dp_req)
     DP_REQ_DEBUG(SSSDBG_TRACE_ALL, dp_req->name, "Terminating.");
 
     talloc_zfree(dp_req->handler_req);
+    dp_req_release(dp_req);
     tevent_req_error(dp_req->req, ERR_TERMINATED);
 }
 
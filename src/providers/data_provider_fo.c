@@ -49,6 +49,10 @@ static int be_fo_get_options(struct be_ctx *ctx,
     opts->retry_timeout = 30;
     opts->srv_retry_neg_timeout = 15;
     opts->family_order = ctx->be_res->family_order;
+    opts->race_servers = dp_opt_get_int(ctx->be_res->opts,
+                                        DP_RES_OPT_RACE_SERVERS);
+    opts->race_delay = dp_opt_get_int(ctx->be_res->opts,
+                                      DP_RES_OPT_RACE_DELAY);
 
     return EOK;
 }
@@ -824,6 +828,11 @@ static struct dp_option dp_res_default_opts[] = {
     { "dns_resolver_timeout", DP_OPT_NUMBER, { .number = 6 }, NULL_NUMBER },
     { "dns_resolver_op_timeout", DP_OPT_NUMBER, { .number = 6 }, NULL_NUMBER },
     { "dns_discovery_domain", DP_OPT_STRING, NULL_STRING, NULL_STRING },
+    { "dns_resolver_use_cache", DP_OPT_BOOL, BOOL_TRUE, BOOL_TRUE },
+    { "dns_resolver_negative_ttl", DP_OPT_NUMBER, { .number = RESOLV_DEFAULT_NEGATIVE_TTL }, NULL_NUMBER },
+    { "dns_resolver_stale_time", DP_OPT_NUMBER, { .number = RESOLV_DEFAULT_STALE_TIME }, NULL_NUMBER },
+    { "failover_race_servers", DP_OPT_NUMBER, { .number = 2 }, NULL_NUMBER },
+    { "failover_race_delay", DP_OPT_NUMBER, { .number = 250 }, NULL_NUMBER },
     DP_OPTION_TERMINATOR
 };
 
@@ -890,5 +899,11 @@ errno_t be_res_init(struct be_ctx *ctx)
         return ret;
     }
 
+    resolv_set_cache(ctx->be_res->resolv,
+                     dp_opt_get_bool(ctx->be_res->opts, DP_RES_OPT_USE_CACHE),
+                     dp_opt_get_int(ctx->be_res->opts,
+                                    DP_RES_OPT_NEGATIVE_TTL),
+                     dp_opt_get_int(ctx->be_res->opts, DP_RES_OPT_STALE_TIME));
+
     return EOK;
 }
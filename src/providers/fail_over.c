@@ -35,6 +35,7 @@
 #include "util/util.h"
 #include "providers/fail_over.h"
 #include "resolv/async_resolv.h"
+#include "util/probes.h"
 
 #define STATUS_DIFF(p, now) ((now).tv_sec - (p)->last_status_change.tv_sec)
 #define SERVER_NAME(s) ((s)->common ? (s)->common->name : "(no name)")
@@ -43,6 +44,16 @@
 #define DEFAULT_SERVER_STATUS SERVER_NAME_NOT_RESOLVED
 #define DEFAULT_SRV_STATUS SRV_NEUTRAL
 
+/* Every failed connection adds this many milliseconds to the score of the
+ * server, scaled by the recent error rate */
+#define FO_LATENCY_ERROR_PENALTY_MS 5000
+/* Only switch to another server of the same tier when it is at least
+ * this much faster, in percent of the score of the original one */
+#define FO_LATENCY_SWITCH_PERCENT 75
+
+/* Maximum number of servers whose names are resolved concurrently */
+#define FO_RACE_MAX_SERVERS 4
+
 enum srv_lookup_status {
     SRV_NEUTRAL,        /* We didn't try this SRV lookup yet */
     SRV_RESOLVED,       /* This SRV lookup is resolved       */
@@ -85,6 +96,8 @@ struct fo_server {
     struct fo_server *next;
 
     bool primary;
+    /* SRV priority of servers expanded from a SRV query, 0 otherwise */
+    unsigned short priority;
     void *user_data;
     int port;
     enum port_status port_status;
@@ -93,6 +106,10 @@ struct fo_server {
     struct timeval last_status_change;
     struct server_common *common;
 
+    /* When the server was last handed out by fo_resolve_service_recv(),
+     * cleared once the caller reported whether it works */
+    struct timeval latency_start;
+
     TALLOC_CTX *fo_internal_owner;
 };
 
@@ -109,6 +126,12 @@ struct server_common {
     struct resolve_service_request *request_list;
     enum server_status server_status;
     struct timeval last_status_change;
+
+    /* Moving averages of the time it takes to get a working connection to
+     * the server in milliseconds and of the error rate in per mille */
+    uint32_t rtt_ewma;
+    uint32_t error_ewma;
+    bool rtt_valid;
 };
 
 struct srv_data {
@@ -159,6 +182,8 @@ fo_context_init(TALLOC_CTX *mem_ctx, struct fo_options *opts)
     ctx->opts->retry_timeout = opts->retry_timeout;
     ctx->opts->family_order  = opts->family_order;
     ctx->opts->service_resolv_timeout = opts->service_resolv_timeout;
+    ctx->opts->race_servers = opts->race_servers;
+    ctx->opts->race_delay = opts->race_delay;
 
     DEBUG(SSSDBG_TRACE_FUNC,
           "Created new fail over context, retry timeout is %ld\n",
@@ -539,6 +564,9 @@ create_server_common(TALLOC_CTX *mem_ctx, struct fo_ctx *ctx, const char *name)
     common->server_status = DEFAULT_SERVER_STATUS;
     common->last_status_change.tv_sec = 0;
     common->last_status_change.tv_usec = 0;
+    common->rtt_ewma = 0;
+    common->error_ewma = 0;
+    common->rtt_valid = false;
 
     talloc_set_destructor((TALLOC_CTX *) common, server_common_destructor);
     DLIST_ADD_END(ctx->server_common_list, common, struct server_common *);
@@ -570,6 +598,8 @@ fo_server_alloc(struct fo_service *service, int port,
     server->srv_data = NULL;
     server->last_status_change.tv_sec = 0;
     server->last_status_change.tv_usec = 0;
+    timerclear(&server->latency_start);
+    server->priority = 0;
 
     server->port = port;
     server->user_data = user_data;
@@ -817,6 +847,7 @@ static errno_t fo_add_server_list(struct fo_service *service,
         }
 
         server->srv_data = srv_data;
+        server->priority = servers[i].priority;
 
         ret = fo_add_server_to_list(&srv_list, service->server_list,
                                     server, service->name);
@@ -869,6 +900,118 @@ void fo_ref_server(TALLOC_CTX *ref_ctx,
     }
 }
 
+static bool
+fo_server_same_tier(struct fo_server *s1, struct fo_server *s2)
+{
+    return s1->primary == s2->primary
+            && s1->srv_data == s2->srv_data
+            && s1->priority == s2->priority;
+}
+
+static bool
+fo_server_is_meta(struct fo_server *server)
+{
+    return server->srv_data != NULL && server->srv_data->meta == server;
+}
+
+static uint32_t
+fo_server_score(struct server_common *common)
+{
+    return common->rtt_ewma
+            + common->error_ewma * FO_LATENCY_ERROR_PENALTY_MS / 1000;
+}
+
+/*
+ * Record how long it took the caller to get a working connection to the
+ * server or that it failed to do so.
+ */
+static void
+fo_server_record_latency(struct fo_server *server, bool success)
+{
+    struct server_common *common = server->common;
+    struct timeval now;
+    int64_t sample;
+
+    if (common == NULL || !timerisset(&server->latency_start)) {
+        return;
+    }
+
+    if (success) {
+        gettimeofday(&now, NULL);
+        sample = (now.tv_sec - server->latency_start.tv_sec) * 1000
+                 + (now.tv_usec - server->latency_start.tv_usec) / 1000;
+        sample = MAX(sample, 0);
+        sample = MIN(sample, UINT32_MAX / 8);
+
+        if (common->rtt_valid) {
+            common->rtt_ewma = (7 * (uint64_t) common->rtt_ewma + sample) / 8;
+        } else {
+            common->rtt_ewma = sample;
+            common->rtt_valid = true;
+        }
+        common->error_ewma = 3 * common->error_ewma / 4;
+    } else {
+        common->error_ewma = (3 * common->error_ewma + 1000) / 4;
+    }
+
+    timerclear(&server->latency_start);
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Server '%s' has average latency %"PRIu32" ms "
+          "and error rate %"PRIu32" per mille\n", common->name,
+          common->rtt_ewma, common->error_ewma);
+}
+
+/*
+ * If another working server from the same tier as the selected one is
+ * considerably faster, prefer it. Servers without any latency data keep
+ * the configured order so that they get a chance to be measured.
+ */
+static struct fo_server *
+fo_prefer_faster_server(struct fo_service *service, struct fo_server *server)
+{
+    struct fo_server *iter;
+    struct fo_server *best = NULL;
+    uint32_t best_score = 0;
+    uint32_t score;
+
+    if (server->common == NULL
+            || (!server->common->rtt_valid && server->common->error_ewma == 0)) {
+        return server;
+    }
+
+    DLIST_FOR_EACH(iter, service->server_list) {
+        if (iter == server || iter->common == NULL
+                || iter->common == server->common
+                || !iter->common->rtt_valid
+                || fo_server_is_meta(iter)
+                || !fo_server_same_tier(iter, server)
+                || !service_works(iter)) {
+            continue;
+        }
+
+        score = fo_server_score(iter->common);
+        if (best == NULL || score < best_score) {
+            best = iter;
+            best_score = score;
+        }
+    }
+
+    if (best == NULL) {
+        return server;
+    }
+
+    score = fo_server_score(server->common);
+    if ((uint64_t) best_score * 100 >= (uint64_t) score * FO_LATENCY_SWITCH_PERCENT) {
+        return server;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Preferring server '%s' [score %"PRIu32"] over "
+          "'%s' [score %"PRIu32"]\n", SERVER_NAME(best), best_score,
+          SERVER_NAME(server), score);
+
+    return best;
+}
+
 static int
 get_first_server_entity(struct fo_service *service, struct fo_server **_server)
 {
@@ -934,6 +1077,10 @@ get_first_server_entity(struct fo_service *service, struct fo_server **_server)
     return ENOENT;
 
 done:
+    if (server != service->active_server) {
+        server = fo_prefer_faster_server(service, server);
+    }
+
     service->last_tried_server = server;
     *_server = server;
     return EOK;
@@ -986,6 +1133,15 @@ struct resolve_service_state {
     struct tevent_context *ev;
     struct tevent_timer *timeout_handler;
     struct fo_ctx *fo_ctx;
+
+    /* Servers of the same tier whose names are resolved concurrently,
+     * the first one that is resolved is returned. */
+    struct tevent_req *race_reqs[FO_RACE_MAX_SERVERS];
+    struct fo_server *race_servers[FO_RACE_MAX_SERVERS];
+    int race_count;
+    int race_pending;
+    int race_ret;
+    struct tevent_timer *race_timer;
 };
 
 static errno_t fo_resolve_service_activate_timeout(struct tevent_req *req,
@@ -994,6 +1150,14 @@ static void fo_resolve_service_cont(struct tevent_req *subreq);
 static void fo_resolve_service_done(struct tevent_req *subreq);
 static bool fo_resolve_service_server(struct tevent_req *req);
 
+/* Forward declarations for resolving the server name */
+static struct tevent_req *
+resolve_server_name_send(TALLOC_CTX *mem_ctx, struct tevent_context *ev,
+                         struct resolv_ctx *resolv, struct fo_ctx *ctx,
+                         struct fo_server *server);
+static int
+resolve_server_name_recv(struct tevent_req *req);
+
 /* Forward declarations for SRV resolving */
 static struct tevent_req *
 resolve_srv_send(TALLOC_CTX *mem_ctx, struct tevent_context *ev,
@@ -1015,6 +1179,7 @@ fo_resolve_service_send(TALLOC_CTX *mem_ctx, struct tevent_context *ev,
 
     DEBUG(SSSDBG_CONF_SETTINGS,
           "Trying to resolve service '%s'\n", service->name);
+    PROBE(FO_RESOLVE_SERVICE_SEND, service->name);
     req = tevent_req_create(mem_ctx, &state, struct resolve_service_state);
     if (req == NULL)
         return NULL;
@@ -1128,34 +1293,211 @@ fo_resolve_service_cont(struct tevent_req *subreq)
     fo_resolve_service_server(req);
 }
 
+static int
+fo_resolve_service_race_limit(struct fo_ctx *fo_ctx)
+{
+    return MIN(fo_ctx->opts->race_servers, FO_RACE_MAX_SERVERS);
+}
+
+/*
+ * Find the next server of the same tier as the first raced one that is
+ * not being raced yet.
+ */
+static struct fo_server *
+fo_resolve_service_race_next(struct resolve_service_state *state)
+{
+    struct fo_server *first = state->race_servers[0];
+    struct fo_server *iter;
+    int i;
+
+    DLIST_FOR_EACH(iter, first->next) {
+        if (iter->common == NULL
+                || fo_server_is_meta(iter)
+                || !fo_server_same_tier(iter, first)
+                || !service_works(iter)) {
+            continue;
+        }
+
+        for (i = 0; i < state->race_count; i++) {
+            if (state->race_servers[i]->common == iter->common) {
+                break;
+            }
+        }
+
+        if (i == state->race_count) {
+            return iter;
+        }
+    }
+
+    return NULL;
+}
+
+static void
+fo_resolve_service_race_finish(struct tevent_req *req,
+                               struct fo_server *server)
+{
+    struct resolve_service_state *state = tevent_req_data(req,
+                                        struct resolve_service_state);
+    int i;
+
+    /* The name resolution of the other servers continues in the
+     * background, only stop waiting for it. */
+    talloc_zfree(state->race_timer);
+    for (i = 0; i < state->race_count; i++) {
+        talloc_zfree(state->race_reqs[i]);
+    }
+    state->race_pending = 0;
+
+    if (server != state->server) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Server '%s' was resolved first\n",
+              SERVER_NAME(server));
+        state->server = server;
+        server->service->last_tried_server = server;
+    }
+
+    tevent_req_done(req);
+}
+
+static void fo_resolve_service_race_done(struct tevent_req *subreq);
+static void fo_resolve_service_race_timeout(struct tevent_context *ev,
+                                            struct tevent_timer *te,
+                                            struct timeval tv, void *pvt);
+
+static errno_t
+fo_resolve_service_race_add(struct tevent_req *req, struct fo_server *server)
+{
+    struct resolve_service_state *state = tevent_req_data(req,
+                                        struct resolve_service_state);
+    struct tevent_req *subreq;
+    struct timeval tv;
+    int delay;
+
+    subreq = resolve_server_name_send(state, state->ev, state->resolv,
+                                      state->fo_ctx, server);
+    if (subreq == NULL) {
+        return ENOMEM;
+    }
+    tevent_req_set_callback(subreq, fo_resolve_service_race_done, req);
+
+    state->race_reqs[state->race_count] = subreq;
+    state->race_servers[state->race_count] = server;
+    state->race_count++;
+    state->race_pending++;
+
+    if (state->race_count >= fo_resolve_service_race_limit(state->fo_ctx)) {
+        return EOK;
+    }
+
+    /* Give the server a head start before also trying the next one */
+    delay = MAX(state->fo_ctx->opts->race_delay, 0);
+    tv = tevent_timeval_current_ofs(delay / 1000, (delay % 1000) * 1000);
+    state->race_timer = tevent_add_timer(state->ev, state, tv,
+                                         fo_resolve_service_race_timeout, req);
+    if (state->race_timer == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_add_timer failed.\n");
+        /* Just keep waiting for the servers already being resolved */
+    }
+
+    return EOK;
+}
+
+static void
+fo_resolve_service_race_timeout(struct tevent_context *ev,
+                                struct tevent_timer *te,
+                                struct timeval tv, void *pvt)
+{
+    struct tevent_req *req = talloc_get_type(pvt, struct tevent_req);
+    struct resolve_service_state *state = tevent_req_data(req,
+                                        struct resolve_service_state);
+    struct fo_server *next;
+    errno_t ret;
+
+    /* The timer is freed by tevent once it fires */
+    state->race_timer = NULL;
+
+    next = fo_resolve_service_race_next(state);
+    if (next == NULL) {
+        return;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Server '%s' is slow to resolve, "
+          "trying also '%s'\n", SERVER_NAME(state->race_servers[0]),
+          SERVER_NAME(next));
+
+    switch (get_server_status(next)) {
+    case SERVER_NAME_NOT_RESOLVED:
+    case SERVER_RESOLVING_NAME:
+        ret = fo_resolve_service_race_add(req, next);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, "Unable to resolve server '%s' [%d]: "
+                  "%s\n", SERVER_NAME(next), ret, sss_strerror(ret));
+        }
+        break;
+    default:
+        /* The name is already resolved, use this server right away */
+        fo_resolve_service_race_finish(req, next);
+        break;
+    }
+}
+
+static void
+fo_resolve_service_race_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct resolve_service_state *state = tevent_req_data(req,
+                                        struct resolve_service_state);
+    errno_t ret;
+    int i;
+
+    for (i = 0; i < state->race_count; i++) {
+        if (state->race_reqs[i] == subreq) {
+            break;
+        }
+    }
+
+    ret = resolve_server_name_recv(subreq);
+    talloc_zfree(subreq);
+
+    if (i == state->race_count || !tevent_req_is_in_progress(req)) {
+        return;
+    }
+
+    state->race_reqs[i] = NULL;
+    state->race_pending--;
+
+    if (ret == EOK) {
+        fo_resolve_service_race_finish(req, state->race_servers[i]);
+        return;
+    }
+
+    /* Report the error of the server that was requested in the first
+     * place, it is the one the caller will mark as not working. */
+    if (i == 0 || state->race_ret == EOK) {
+        state->race_ret = ret;
+    }
+
+    if (state->race_pending > 0) {
+        return;
+    }
+
+    talloc_zfree(state->race_timer);
+    tevent_req_error(req, state->race_ret);
+}
+
 static bool
 fo_resolve_service_server(struct tevent_req *req)
 {
     struct resolve_service_state *state = tevent_req_data(req,
                                         struct resolve_service_state);
-    struct tevent_req *subreq;
     int ret;
 
     switch (get_server_status(state->server)) {
-    case SERVER_NAME_NOT_RESOLVED: /* Request name resolution. */
-        subreq = resolv_gethostbyname_send(state->server->common,
-                                           state->ev, state->resolv,
-                                           state->server->common->name,
-                                           state->fo_ctx->opts->family_order,
-                                           default_host_dbs);
-        if (subreq == NULL) {
-            tevent_req_error(req, ENOMEM);
-            return true;
-        }
-        tevent_req_set_callback(subreq, fo_resolve_service_done,
-                                state->server->common);
-        fo_set_server_status(state->server, SERVER_RESOLVING_NAME);
-        /* FALLTHROUGH */
-        SSS_ATTRIBUTE_FALLTHROUGH;
+    case SERVER_NAME_NOT_RESOLVED:
     case SERVER_RESOLVING_NAME:
-        /* Name resolution is already under way. Just add ourselves into the
-         * waiting queue so we get notified after the operation is finished. */
-        ret = set_lookup_hook(state->ev, state->server, req);
+        /* Resolve the name, possibly racing other servers of the same
+         * tier if it takes too long. */
+        ret = fo_resolve_service_race_add(req, state->server);
         if (ret != EOK) {
             tevent_req_error(req, ret);
             return true;
@@ -1238,6 +1580,85 @@ fo_resolve_service_recv(struct tevent_req *req,
         *server = state->server;
     }
 
+    /* The time to a working connection is measured from here until the
+     * caller sets the port status, name resolution is not included */
+    if (state->server != NULL) {
+        gettimeofday(&state->server->latency_start, NULL);
+        PROBE(FO_RESOLVE_SERVICE_RECV, state->server->service->name,
+              SERVER_NAME(state->server), state->server->port);
+    }
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    return EOK;
+}
+
+/*******************************************************************
+ * Resolve the name of a server.                                   *
+ *******************************************************************/
+
+struct resolve_server_name_state {
+    struct fo_server *server;
+};
+
+static struct tevent_req *
+resolve_server_name_send(TALLOC_CTX *mem_ctx, struct tevent_context *ev,
+                         struct resolv_ctx *resolv, struct fo_ctx *ctx,
+                         struct fo_server *server)
+{
+    struct resolve_server_name_state *state;
+    struct tevent_req *req;
+    struct tevent_req *subreq;
+    int ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct resolve_server_name_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    state->server = server;
+
+    switch (get_server_status(server)) {
+    case SERVER_NAME_NOT_RESOLVED: /* Request name resolution. */
+        subreq = resolv_gethostbyname_send(server->common, ev, resolv,
+                                           server->common->name,
+                                           ctx->opts->family_order,
+                                           default_host_dbs);
+        if (subreq == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+        tevent_req_set_callback(subreq, fo_resolve_service_done,
+                                server->common);
+        fo_set_server_status(server, SERVER_RESOLVING_NAME);
+        /* FALLTHROUGH */
+        SSS_ATTRIBUTE_FALLTHROUGH;
+    case SERVER_RESOLVING_NAME:
+        /* Name resolution is already under way. Just add ourselves into the
+         * waiting queue so we get notified after the operation is finished. */
+        ret = set_lookup_hook(ev, server, req);
+        if (ret != EOK) {
+            goto done;
+        }
+        return req;
+    default: /* The name is already resolved. Return immediately. */
+        ret = EOK;
+        break;
+    }
+
+done:
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+    return req;
+}
+
+static int
+resolve_server_name_recv(struct tevent_req *req)
+{
     TEVENT_REQ_RETURN_ON_ERROR(req);
 
     return EOK;
@@ -1515,6 +1936,12 @@ fo_set_server_status(struct fo_server *server, enum server_status status)
         return;
     }
 
+    if (status == SERVER_NOT_WORKING) {
+        fo_server_record_latency(server, false);
+    }
+
+    PROBE(FO_SET_SERVER_STATUS, server->service->name,
+          SERVER_NAME(server), status);
     set_server_common_status(server->common, status);
 }
 
@@ -1527,6 +1954,12 @@ fo_set_port_status(struct fo_server *server, enum port_status status)
           "Marking port %d of server '%s' as '%s'\n", server->port,
               SERVER_NAME(server), str_port_status(status));
 
+    if (status != PORT_NEUTRAL) {
+        fo_server_record_latency(server, status == PORT_WORKING);
+    }
+
+    PROBE(FO_SET_PORT_STATUS, server->service->name,
+          SERVER_NAME(server), server->port, status);
     server->port_status = status;
     gettimeofday(&server->last_status_change, NULL);
     if (status == PORT_WORKING) {
@@ -1570,6 +2003,7 @@ void fo_try_next_server(struct fo_service *service)
         return;
     }
 
+    PROBE(FO_TRY_NEXT_SERVER, service->name, SERVER_NAME(server));
     service->active_server = 0;
 
     if (server->port_status == PORT_WORKING) {
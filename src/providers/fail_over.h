@@ -76,12 +76,19 @@ struct fo_server;
  *
  * The family_order member specifies the order of address families to
  * try when looking up the service.
+ *
+ * The 'race_servers' member specifies how many servers of the same
+ * priority may have their names resolved concurrently. Another server is
+ * tried every 'race_delay' milliseconds until one of them is resolved.
+ * Values lower than 2 disable racing.
  */
 struct fo_options {
     time_t srv_retry_neg_timeout;
     time_t retry_timeout;
     int service_resolv_timeout;
     enum restrict_family family_order;
+    int race_servers;
+    int race_delay;
 };
 
 /*
@@ -157,6 +157,10 @@ struct dp_option ipa_def_ldap_opts[] = {
     { "ldap_max_id", DP_OPT_NUMBER, NULL_NUMBER, NULL_NUMBER},
     { "ldap_pwdlockout_dn", DP_OPT_STRING, NULL_STRING, NULL_STRING },
     { "wildcard_limit", DP_OPT_NUMBER, { .number = 1000 }, NULL_NUMBER},
+    { "ldap_connection_pool_size", DP_OPT_NUMBER, { .number = 1 }, NULL_NUMBER },
+    { "ldap_connection_pool_standby", DP_OPT_NUMBER, { .number = 0 }, NULL_NUMBER },
+    { "ldap_auth_connection_pool_size", DP_OPT_NUMBER, { .number = 0 }, NULL_NUMBER },
+    { "ldap_auth_connection_idle_timeout", DP_OPT_NUMBER, { .number = 60 }, NULL_NUMBER },
     DP_OPTION_TERMINATOR
 };
 
@@ -605,6 +605,263 @@ done:
     return ret;
 }
 
+/* ==Authentication-Connection-Pool======================================= */
+
+struct sdap_auth_conn {
+    struct sdap_auth_conn *prev, *next;
+    struct sdap_auth_conn_pool *pool;
+
+    char *uri;
+    struct sdap_handle *sh;
+    struct tevent_timer *idle_timer;
+    /* the anonymous bind that resets the connection is in progress */
+    bool resetting;
+};
+
+struct sdap_auth_conn_pool {
+    struct tevent_context *ev;
+    int max_conns;
+    int idle_timeout;
+
+    int num_conns;
+    struct sdap_auth_conn *conns;
+};
+
+static int sdap_auth_conn_destructor(struct sdap_auth_conn *conn)
+{
+    DLIST_REMOVE(conn->pool->conns, conn);
+    conn->pool->num_conns--;
+    return 0;
+}
+
+static struct sdap_auth_conn_pool *
+sdap_auth_conn_pool_get_ctx(struct sdap_auth_ctx *ctx)
+{
+    int max_conns;
+
+    if (ctx->conn_pool != NULL) {
+        return ctx->conn_pool;
+    }
+
+    max_conns = dp_opt_get_int(ctx->opts->basic,
+                               SDAP_AUTH_CONNECTION_POOL_SIZE);
+    if (max_conns <= 0) {
+        return NULL;
+    }
+
+    ctx->conn_pool = talloc_zero(ctx, struct sdap_auth_conn_pool);
+    if (ctx->conn_pool == NULL) {
+        return NULL;
+    }
+
+    ctx->conn_pool->ev = ctx->be->ev;
+    ctx->conn_pool->max_conns = max_conns;
+    ctx->conn_pool->idle_timeout = dp_opt_get_int(ctx->opts->basic,
+                                            SDAP_AUTH_CONNECTION_IDLE_TIMEOUT);
+
+    return ctx->conn_pool;
+}
+
+/* Takes an idle connection to uri out of the pool, NULL if there is none */
+static struct sdap_handle *
+sdap_auth_conn_pool_take(TALLOC_CTX *mem_ctx,
+                         struct sdap_auth_ctx *ctx,
+                         const char *uri)
+{
+    struct sdap_auth_conn *conn;
+    struct sdap_auth_conn *next;
+    struct sdap_handle *sh;
+
+    if (ctx->conn_pool == NULL || uri == NULL) {
+        return NULL;
+    }
+
+    for (conn = ctx->conn_pool->conns; conn != NULL; conn = next) {
+        next = conn->next;
+
+        if (conn->resetting || strcmp(conn->uri, uri) != 0) {
+            continue;
+        }
+
+        if (conn->sh->connected == false || conn->sh->ldap == NULL) {
+            /* closed by the server while idle */
+            talloc_free(conn);
+            continue;
+        }
+
+        sh = talloc_steal(mem_ctx, conn->sh);
+        talloc_free(conn);
+        return sh;
+    }
+
+    return NULL;
+}
+
+/* Drops all idle connections to uri, e.g. when one of them failed */
+static void sdap_auth_conn_pool_flush(struct sdap_auth_ctx *ctx,
+                                      const char *uri)
+{
+    struct sdap_auth_conn *conn;
+    struct sdap_auth_conn *next;
+
+    if (ctx->conn_pool == NULL || uri == NULL) {
+        return;
+    }
+
+    for (conn = ctx->conn_pool->conns; conn != NULL; conn = next) {
+        next = conn->next;
+
+        if (strcmp(conn->uri, uri) == 0) {
+            talloc_free(conn);
+        }
+    }
+}
+
+static void sdap_auth_conn_idle_timeout(struct tevent_context *ev,
+                                        struct tevent_timer *te,
+                                        struct timeval tv, void *pvt)
+{
+    struct sdap_auth_conn *conn = talloc_get_type(pvt, struct sdap_auth_conn);
+
+    DEBUG(SSSDBG_TRACE_INTERNAL,
+          "Closing idle authentication connection to [%s]\n", conn->uri);
+    conn->idle_timer = NULL;
+    talloc_free(conn);
+}
+
+static void sdap_auth_conn_reset_done(struct tevent_req *subreq);
+
+/* Binds the connection with the identity the ID connections use: the
+ * SASL mechanism or the default bind DN and password, or anonymously if
+ * none of them is configured. */
+static errno_t sdap_auth_conn_reset(struct sdap_auth_ctx *ctx,
+                                    struct sdap_auth_conn *conn)
+{
+    struct dp_option *basic = ctx->opts->basic;
+    struct sss_auth_token *authtok = NULL;
+    struct dp_opt_blob authtok_blob;
+    struct tevent_req *subreq;
+    const char *authtok_type;
+    const char *sasl_mech;
+    const char *user_dn;
+    errno_t ret;
+
+    sasl_mech = dp_opt_get_string(basic, SDAP_SASL_MECH);
+    user_dn = dp_opt_get_string(basic, SDAP_DEFAULT_BIND_DN);
+
+    if (sasl_mech == NULL && user_dn != NULL) {
+        authtok_type = dp_opt_get_string(basic, SDAP_DEFAULT_AUTHTOK_TYPE);
+        if (authtok_type != NULL && strcasecmp(authtok_type, "password") != 0) {
+            DEBUG(SSSDBG_TRACE_LIBS, "Invalid authtoken type\n");
+            return EINVAL;
+        }
+
+        authtok = sss_authtok_new(conn);
+        if (authtok == NULL) {
+            return ENOMEM;
+        }
+
+        authtok_blob = dp_opt_get_blob(basic, SDAP_DEFAULT_AUTHTOK);
+        if (authtok_blob.data != NULL) {
+            ret = sss_authtok_set_password(authtok,
+                                           (const char *)authtok_blob.data,
+                                           authtok_blob.length);
+            if (ret != EOK) {
+                return ret;
+            }
+        }
+    }
+
+    subreq = sdap_auth_send(conn, conn->pool->ev, conn->sh, sasl_mech,
+                            dp_opt_get_string(basic, SDAP_SASL_AUTHID),
+                            user_dn, authtok,
+                            dp_opt_get_int(basic, SDAP_OPT_TIMEOUT));
+    if (subreq == NULL) {
+        return ENOMEM;
+    }
+
+    tevent_req_set_callback(subreq, sdap_auth_conn_reset_done, conn);
+    conn->resetting = true;
+    return EOK;
+}
+
+/* Keeps a connection the user was bound on for the next authentication.
+ * The connection is bound with the default identity again before it can
+ * be taken, so that no request runs with the identity of the previous
+ * user. A connection that cannot be reset is closed. */
+static void sdap_auth_conn_pool_release(struct sdap_auth_ctx *ctx,
+                                        const char *uri,
+                                        struct sdap_handle *sh)
+{
+    struct sdap_auth_conn_pool *pool;
+    struct sdap_auth_conn *conn;
+    struct timeval tv;
+    errno_t ret;
+
+    pool = sdap_auth_conn_pool_get_ctx(ctx);
+    if (pool == NULL || uri == NULL
+            || sh->connected == false || sh->ldap == NULL
+            || pool->num_conns >= pool->max_conns) {
+        talloc_free(sh);
+        return;
+    }
+
+    conn = talloc_zero(pool, struct sdap_auth_conn);
+    if (conn == NULL) {
+        talloc_free(sh);
+        return;
+    }
+
+    conn->uri = talloc_strdup(conn, uri);
+    if (conn->uri == NULL) {
+        talloc_free(conn);
+        talloc_free(sh);
+        return;
+    }
+
+    conn->pool = pool;
+    conn->sh = talloc_steal(conn, sh);
+    DLIST_ADD(pool->conns, conn);
+    pool->num_conns++;
+    talloc_set_destructor(conn, sdap_auth_conn_destructor);
+
+    tv = tevent_timeval_current_ofs(pool->idle_timeout, 0);
+    conn->idle_timer = tevent_add_timer(pool->ev, conn, tv,
+                                        sdap_auth_conn_idle_timeout, conn);
+    if (conn->idle_timer == NULL) {
+        talloc_free(conn);
+        return;
+    }
+
+    ret = sdap_auth_conn_reset(ctx, conn);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Cannot reset authentication connection to [%s], "
+              "closing it [%d]: %s\n", uri, ret, sss_strerror(ret));
+        talloc_free(conn);
+        return;
+    }
+}
+
+static void sdap_auth_conn_reset_done(struct tevent_req *subreq)
+{
+    struct sdap_auth_conn *conn = tevent_req_callback_data(subreq,
+                                                        struct sdap_auth_conn);
+    errno_t ret;
+
+    ret = sdap_auth_recv(subreq, NULL, NULL);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Cannot reset authentication connection to [%s], "
+              "closing it [%d]: %s\n", conn->uri, ret, sss_strerror(ret));
+        talloc_free(conn);
+        return;
+    }
+
+    conn->resetting = false;
+}
+
 /* ==Authenticate-User==================================================== */
 
 struct auth_state {
@@ -615,6 +872,12 @@ struct auth_state {
     struct sdap_service *sdap_service;
 
     struct sdap_handle *sh;
+    /* the server URI sh is connected to */
+    char *uri;
+    /* sh was taken from the connection pool */
+    bool pooled;
+    /* the bind got an answer, sh can be kept for another request */
+    bool reusable;
 
     char *dn;
     enum pwexpire pw_expire_type;
@@ -624,6 +887,7 @@ struct auth_state {
 };
 
 static struct tevent_req *auth_get_server(struct tevent_req *req);
+static void auth_find_user_dn(struct tevent_req *req);
 static void auth_get_dn_done(struct tevent_req *subreq);
 static void auth_do_bind(struct tevent_req *req);
 static void auth_resolve_done(struct tevent_req *subreq);
@@ -736,6 +1000,23 @@ static void auth_resolve_done(struct tevent_req *subreq)
         }
     }
 
+    talloc_zfree(state->uri);
+    state->uri = talloc_strdup(state, state->sdap_service->uri);
+    if (state->uri == NULL) {
+        tevent_req_error(req, ENOMEM);
+        return;
+    }
+
+    state->sh = sdap_auth_conn_pool_take(state, state->ctx, state->uri);
+    if (state->sh != NULL) {
+        DEBUG(SSSDBG_TRACE_FUNC,
+              "Reusing authentication connection to [%s]\n", state->uri);
+        state->pooled = true;
+        auth_find_user_dn(req);
+        return;
+    }
+    state->pooled = false;
+
     subreq = sdap_connect_send(state, state->ev, state->ctx->opts,
                                state->sdap_service->uri,
                                state->sdap_service->sockaddr, use_tls);
@@ -786,6 +1067,15 @@ static void auth_connect_done(struct tevent_req *subreq)
         }
     }
 
+    auth_find_user_dn(req);
+}
+
+static void auth_find_user_dn(struct tevent_req *req)
+{
+    struct auth_state *state = tevent_req_data(req, struct auth_state);
+    struct tevent_req *subreq;
+    errno_t ret;
+
     ret = get_user_dn(state, state->ctx->be->domain,
                       state->ctx->opts, state->username, &state->dn,
                       &state->pw_expire_type, &state->pw_expire_data);
@@ -820,7 +1110,14 @@ static void auth_get_dn_done(struct tevent_req *subreq)
 
     ret = get_user_dn_recv(state, subreq, &state->dn);
     talloc_zfree(subreq);
-    if (ret != EOK) {
+    if (ret != EOK && state->pooled && state->sh->connected == false) {
+        /* The pooled connection was closed by the server meanwhile */
+        sdap_auth_conn_pool_flush(state->ctx, state->uri);
+        if (auth_get_server(req) == NULL) {
+            tevent_req_error(req, ENOMEM);
+        }
+        return;
+    } else if (ret != EOK) {
         tevent_req_error(req, ERR_ACCOUNT_UNKNOWN);
         return;
     }
@@ -870,15 +1167,20 @@ static void auth_bind_user_done(struct tevent_req *subreq)
         break;
     case ETIMEDOUT:
     case ERR_NETWORK_IO:
+        if (state->pooled) {
+            sdap_auth_conn_pool_flush(state->ctx, state->uri);
+        }
         if (auth_get_server(req) == NULL) {
             tevent_req_error(req, ENOMEM);
         }
         return;
     default:
+        state->reusable = true;
         tevent_req_error(req, ret);
         return;
     }
 
+    state->reusable = true;
     tevent_req_done(req);
 }
 
@@ -891,6 +1193,9 @@ static errno_t auth_recv(struct tevent_req *req, TALLOC_CTX *memctx,
     if (sh != NULL) {
         *sh = talloc_steal(memctx, state->sh);
         if (*sh == NULL) return ENOMEM;
+    } else if (state->reusable) {
+        sdap_auth_conn_pool_release(state->ctx, state->uri, state->sh);
+        state->sh = NULL;
     }
 
     if (dn != NULL) {
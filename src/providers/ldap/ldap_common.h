@@ -71,11 +71,15 @@ struct sdap_id_ctx {
     struct sdap_server_opts *srv_opts;
 };
 
+struct sdap_auth_conn_pool;
+
 struct sdap_auth_ctx {
     struct be_ctx *be;
     struct sdap_options *opts;
     struct sdap_service *service;
     struct sdap_service *chpass_service;
+    /* idle authentication connections, created on first use */
+    struct sdap_auth_conn_pool *conn_pool;
 };
 
 struct tevent_req *
@@ -248,6 +252,15 @@ struct tevent_req *groups_get_send(TALLOC_CTX *memctx,
                                    bool no_members);
 int groups_get_recv(struct tevent_req *req, int *dp_error_out, int *sdap_ret);
 
+/* the result is received with groups_get_recv() */
+struct tevent_req *groups_get_sids_send(TALLOC_CTX *memctx,
+                                        struct tevent_context *ev,
+                                        struct sdap_id_ctx *ctx,
+                                        struct sdap_domain *sdom,
+                                        struct sdap_id_conn_ctx *conn,
+                                        const char **sids,
+                                        size_t num_sids);
+
 struct tevent_req *ldap_netgroup_get_send(TALLOC_CTX *memctx,
                                           struct tevent_context *ev,
                                           struct sdap_id_ctx *ctx,
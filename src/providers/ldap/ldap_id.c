@@ -686,12 +686,24 @@ struct groups_get_state {
     bool use_id_mapping;
     bool non_posix;
 
+    enum sdap_entry_lookup_type lookup_type;
+
     int dp_error;
     int sdap_ret;
     bool noexist_delete;
     bool no_members;
 };
 
+static errno_t groups_get_init_state(struct groups_get_state *state,
+                                     struct tevent_context *ev,
+                                     struct sdap_id_ctx *ctx,
+                                     struct sdap_domain *sdom,
+                                     struct sdap_id_conn_ctx *conn,
+                                     const char *filter_value,
+                                     int filter_type,
+                                     bool noexist_delete,
+                                     bool no_members);
+static errno_t groups_get_start(struct tevent_req *req, const char *match);
 static int groups_get_retry(struct tevent_req *req);
 static void groups_get_connect_done(struct tevent_req *subreq);
 static void groups_get_posix_check_done(struct tevent_req *subreq);
@@ -718,41 +730,18 @@ struct tevent_req *groups_get_send(TALLOC_CTX *memctx,
     gid_t gid;
     enum idmap_error_code err;
     char *sid;
-    const char *member_filter[2];
-    char *oc_list;
+    char *match;
 
     req = tevent_req_create(memctx, &state, struct groups_get_state);
     if (!req) return NULL;
 
-    state->ev = ev;
-    state->ctx = ctx;
-    state->sdom = sdom;
-    state->conn = conn;
-    state->dp_error = DP_ERR_FATAL;
-    state->noexist_delete = noexist_delete;
-    state->no_members = no_members;
-
-    state->op = sdap_id_op_create(state, state->conn->conn_cache);
-    if (!state->op) {
-        DEBUG(SSSDBG_OP_FAILURE, "sdap_id_op_create failed\n");
-        ret = ENOMEM;
+    ret = groups_get_init_state(state, ev, ctx, sdom, conn,
+                                filter_value, filter_type,
+                                noexist_delete, no_members);
+    if (ret != EOK) {
         goto done;
     }
 
-    state->domain = sdom->dom;
-    state->sysdb = sdom->dom->sysdb;
-    state->filter_value = filter_value;
-    state->filter_type = filter_type;
-
-    if (state->domain->type == DOM_TYPE_APPLICATION) {
-        state->non_posix = true;
-    }
-
-    state->use_id_mapping = sdap_idmap_domain_has_algorithmic_mapping(
-                                                          ctx->opts->idmap_ctx,
-                                                          sdom->dom->name,
-                                                          sdom->dom->domain_id);
-
     switch(filter_type) {
     case BE_FILTER_WILDCARD:
         attr_name = ctx->opts->group_map[SDAP_AT_GROUP_NAME].name;
@@ -859,38 +848,190 @@ struct tevent_req *groups_get_send(TALLOC_CTX *memctx,
         goto done;
     }
 
+    match = talloc_asprintf(state, "(%s=%s)", attr_name, clean_value);
+    talloc_zfree(clean_value);
+    if (match == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    if (filter_type == BE_FILTER_WILDCARD) {
+        state->lookup_type = SDAP_LOOKUP_WILDCARD;
+    } else {
+        state->lookup_type = SDAP_LOOKUP_SINGLE;
+    }
+
+    ret = groups_get_start(req, match);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    return req;
+
+done:
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+    } else {
+        tevent_req_done(req);
+    }
+    return tevent_req_post(req, ev);
+}
+
+/* Look up several groups by their SIDs with a single search per search
+ * base. Only the group objects are stored, without members, in the same
+ * way groups_get_send() does with no_members set. Missing groups are not
+ * an error, the request then returns ENOENT in sdap_ret. */
+struct tevent_req *groups_get_sids_send(TALLOC_CTX *memctx,
+                                        struct tevent_context *ev,
+                                        struct sdap_id_ctx *ctx,
+                                        struct sdap_domain *sdom,
+                                        struct sdap_id_conn_ctx *conn,
+                                        const char **sids,
+                                        size_t num_sids)
+{
+    struct tevent_req *req;
+    struct groups_get_state *state;
+    const char *attr_name;
+    char *clean_value;
+    char *match;
+    size_t i;
+    errno_t ret;
+
+    req = tevent_req_create(memctx, &state, struct groups_get_state);
+    if (!req) return NULL;
+
+    if (num_sids == 0) {
+        ret = EINVAL;
+        goto done;
+    }
+
+    ret = groups_get_init_state(state, ev, ctx, sdom, conn, sids[0],
+                                BE_FILTER_SECID, false, true);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    attr_name = ctx->opts->group_map[SDAP_AT_GROUP_OBJECTSID].name;
+    if (attr_name == NULL) {
+        DEBUG(SSSDBG_OP_FAILURE, "Missing search attribute name.\n");
+        ret = EINVAL;
+        goto done;
+    }
+
+    match = talloc_strdup(state, "(|");
+    for (i = 0; i < num_sids && match != NULL; i++) {
+        ret = sss_filter_sanitize(state, sids[i], &clean_value);
+        if (ret != EOK) {
+            goto done;
+        }
+
+        match = talloc_asprintf_append_buffer(match, "(%s=%s)",
+                                              attr_name, clean_value);
+        talloc_free(clean_value);
+    }
+    if (match != NULL) {
+        match = talloc_strdup_append_buffer(match, ")");
+    }
+    if (match == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    /* Results may come from any of the search bases. */
+    state->lookup_type = SDAP_LOOKUP_WILDCARD;
+
+    ret = groups_get_start(req, match);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    return req;
+
+done:
+    tevent_req_error(req, ret);
+    return tevent_req_post(req, ev);
+}
+
+static errno_t groups_get_init_state(struct groups_get_state *state,
+                                     struct tevent_context *ev,
+                                     struct sdap_id_ctx *ctx,
+                                     struct sdap_domain *sdom,
+                                     struct sdap_id_conn_ctx *conn,
+                                     const char *filter_value,
+                                     int filter_type,
+                                     bool noexist_delete,
+                                     bool no_members)
+{
+    state->ev = ev;
+    state->ctx = ctx;
+    state->sdom = sdom;
+    state->conn = conn;
+    state->dp_error = DP_ERR_FATAL;
+    state->noexist_delete = noexist_delete;
+    state->no_members = no_members;
+
+    state->op = sdap_id_op_create(state, state->conn->conn_cache);
+    if (!state->op) {
+        DEBUG(SSSDBG_OP_FAILURE, "sdap_id_op_create failed\n");
+        return ENOMEM;
+    }
+
+    state->domain = sdom->dom;
+    state->sysdb = sdom->dom->sysdb;
+    state->filter_value = filter_value;
+    state->filter_type = filter_type;
+
+    if (state->domain->type == DOM_TYPE_APPLICATION) {
+        state->non_posix = true;
+    }
+
+    state->use_id_mapping = sdap_idmap_domain_has_algorithmic_mapping(
+                                                          ctx->opts->idmap_ctx,
+                                                          sdom->dom->name,
+                                                          sdom->dom->domain_id);
+
+    return EOK;
+}
+
+/* match is the part of the filter selecting the requested group(s) */
+static errno_t groups_get_start(struct tevent_req *req, const char *match)
+{
+    struct groups_get_state *state = tevent_req_data(req,
+                                                    struct groups_get_state);
+    struct sdap_id_ctx *ctx = state->ctx;
+    const char *member_filter[2];
+    char *oc_list;
+    errno_t ret;
+
     oc_list = sdap_make_oc_list(state, ctx->opts->group_map);
     if (oc_list == NULL) {
         DEBUG(SSSDBG_CRIT_FAILURE, "Failed to create objectClass list.\n");
-        ret = ENOMEM;
-        goto done;
+        return ENOMEM;
     }
 
     if (state->non_posix
             || state->use_id_mapping
-            || filter_type == BE_FILTER_SECID) {
+            || state->filter_type == BE_FILTER_SECID) {
         /* When mapping IDs or looking for SIDs, or when in a non-POSIX domain,
          * we don't want to limit ourselves to groups with a GID value
          */
 
         state->filter = talloc_asprintf(state,
-                                        "(&(%s=%s)(%s)(%s=*))",
-                                        attr_name, clean_value, oc_list,
+                                        "(&%s(%s)(%s=*))",
+                                        match, oc_list,
                                         ctx->opts->group_map[SDAP_AT_GROUP_NAME].name);
     } else {
         state->filter = talloc_asprintf(state,
-                                        "(&(%s=%s)(%s)(%s=*)(&(%s=*)(!(%s=0))))",
-                                        attr_name, clean_value, oc_list,
+                                        "(&%s(%s)(%s=*)(&(%s=*)(!(%s=0))))",
+                                        match, oc_list,
                                         ctx->opts->group_map[SDAP_AT_GROUP_NAME].name,
                                         ctx->opts->group_map[SDAP_AT_GROUP_GID].name,
                                         ctx->opts->group_map[SDAP_AT_GROUP_GID].name);
     }
 
-    talloc_zfree(clean_value);
     if (!state->filter) {
         DEBUG(SSSDBG_OP_FAILURE, "Failed to build filter\n");
-        ret = ENOMEM;
-        goto done;
+        return ENOMEM;
     }
 
     member_filter[0] = (const char *)ctx->opts->group_map[SDAP_AT_GROUP_MEMBER].name;
@@ -902,22 +1043,11 @@ struct tevent_req *groups_get_send(TALLOC_CTX *memctx,
                                    (const char **)member_filter : NULL,
                                &state->attrs, NULL);
 
-    if (ret != EOK) goto done;
-
-    ret = groups_get_retry(req);
     if (ret != EOK) {
-        goto done;
+        return ret;
     }
 
-    return req;
-
-done:
-    if (ret != EOK) {
-        tevent_req_error(req, ret);
-    } else {
-        tevent_req_done(req);
-    }
-    return tevent_req_post(req, ev);
+    return groups_get_retry(req);
 }
 
 static int groups_get_retry(struct tevent_req *req)
@@ -1022,13 +1152,6 @@ static void groups_get_search(struct tevent_req *req)
     struct groups_get_state *state = tevent_req_data(req,
                                                      struct groups_get_state);
     struct tevent_req *subreq;
-    enum sdap_entry_lookup_type lookup_type;
-
-    if (state->filter_type == BE_FILTER_WILDCARD) {
-        lookup_type = SDAP_LOOKUP_WILDCARD;
-    } else {
-        lookup_type = SDAP_LOOKUP_SINGLE;
-    }
 
     subreq = sdap_get_groups_send(state, state->ev,
                                   state->sdom,
@@ -1037,7 +1160,7 @@ static void groups_get_search(struct tevent_req *req)
                                   state->attrs, state->filter,
                                   dp_opt_get_int(state->ctx->opts->basic,
                                                  SDAP_SEARCH_TIMEOUT),
-                                  lookup_type,
+                                  state->lookup_type,
                                   state->no_members);
     if (!subreq) {
         tevent_req_error(req, ENOMEM);
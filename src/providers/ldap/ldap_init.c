@@ -81,6 +81,7 @@ static errno_t ldap_init_auth_ctx(TALLOC_CTX *mem_ctx,
     auth_ctx->opts = options;
     auth_ctx->service = id_ctx->conn->service;
     auth_ctx->chpass_service = NULL;
+    auth_ctx->conn_pool = NULL;
 
     *_auth_ctx = auth_ctx;
 
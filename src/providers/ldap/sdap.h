@@ -234,6 +234,10 @@ enum sdap_basic_opt {
     SDAP_MAX_ID,
     SDAP_PWDLOCKOUT_DN,
     SDAP_WILDCARD_LIMIT,
+    SDAP_CONNECTION_POOL_SIZE,
+    SDAP_CONNECTION_POOL_STANDBY,
+    SDAP_AUTH_CONNECTION_POOL_SIZE,
+    SDAP_AUTH_CONNECTION_IDLE_TIMEOUT,
 
     SDAP_OPTS_BASIC /* opts counter */
 };
@@ -24,6 +24,7 @@
 #include "util/util.h"
 #include "util/strtonum.h"
 #include "util/probes.h"
+#include "util/sss_stats.h"
 #include "providers/ldap/sdap_async_private.h"
 
 #define REPLY_REALLOC_INCREMENT 10
@@ -1177,6 +1178,7 @@ struct sdap_get_generic_ext_state {
     void *cb_data;
 
     unsigned int flags;
+    uint64_t stats_start;
 };
 
 static errno_t sdap_get_generic_ext_step(struct tevent_req *req);
@@ -1238,6 +1240,7 @@ sdap_get_generic_ext_send(TALLOC_CTX *memctx,
     state->cb_data = cb_data;
     state->clientctrls = clientctrls;
     state->flags = flags;
+    state->stats_start = sss_stats_now();
 
     if (state->sh == NULL || state->sh->ldap == NULL) {
         DEBUG(SSSDBG_CRIT_FAILURE,
@@ -1636,10 +1639,15 @@ sdap_get_generic_ext_recv(struct tevent_req *req,
 {
     struct sdap_get_generic_ext_state *state =
             tevent_req_data(req, struct sdap_get_generic_ext_state);
+    enum tevent_req_state tstate;
+    uint64_t err;
 
     PROBE(SDAP_GET_GENERIC_EXT_RECV, state->search_base,
           state->scope, state->filter);
 
+    sss_stats_record(SSS_STATS_SDAP_SEARCH, state->stats_start,
+                     tevent_req_is_error(req, &tstate, &err));
+
     TEVENT_REQ_RETURN_ON_ERROR(req);
 
     if (ref_count) {
@@ -1310,16 +1310,22 @@ struct tevent_req *sdap_auth_send(TALLOC_CTX *memctx,
         size_t pwlen;
         errno_t ret;
 
-        ret = sss_authtok_get_password(authtok, &password, &pwlen);
-        if (ret != EOK) {
-            DEBUG(SSSDBG_CRIT_FAILURE, "Cannot parse authtok.\n");
-            tevent_req_error(req, ret);
-            return tevent_req_post(req, ev);
-        }
-        /* Treat a zero-length password as a failure */
-        if (*password == '\0') {
-            tevent_req_error(req, ENOENT);
-            return tevent_req_post(req, ev);
+        if (user_dn == NULL && authtok == NULL) {
+            /* Anonymous bind, drops any identity the handle was bound to */
+            password = "";
+            pwlen = 0;
+        } else {
+            ret = sss_authtok_get_password(authtok, &password, &pwlen);
+            if (ret != EOK) {
+                DEBUG(SSSDBG_CRIT_FAILURE, "Cannot parse authtok.\n");
+                tevent_req_error(req, ret);
+                return tevent_req_post(req, ev);
+            }
+            /* Treat a zero-length password as a failure */
+            if (*password == '\0') {
+                tevent_req_error(req, ENOENT);
+                return tevent_req_post(req, ev);
+            }
         }
         pw.bv_val = discard_const(password);
         pw.bv_len = pwlen;
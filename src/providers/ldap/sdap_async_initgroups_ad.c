@@ -531,6 +531,19 @@ done:
     return ret;
 }
 
+/* Number of SIDs looked up with a single LDAP search */
+#define SDAP_AD_RESOLVE_SIDS_BATCH_SIZE 50
+/* Number of searches running at the same time */
+#define SDAP_AD_RESOLVE_SIDS_PARALLEL 4
+
+struct sdap_ad_sids_batch {
+    struct sdap_domain *sdom;
+    const char **sids;
+    size_t num_sids;
+
+    struct tevent_req *subreq;
+};
+
 struct sdap_ad_resolve_sids_state {
     struct tevent_context *ev;
     struct sdap_id_ctx *id_ctx;
@@ -539,10 +552,14 @@ struct sdap_ad_resolve_sids_state {
     struct sss_domain_info *domain;
     char **sids;
 
-    const char *current_sid;
-    int index;
+    struct sdap_ad_sids_batch *batches;
+    size_t num_batches;
+    size_t next_batch;
+    size_t running;
 };
 
+static errno_t sdap_ad_resolve_sids_batches(struct sdap_ad_resolve_sids_state *state);
+static void sdap_ad_resolve_sids_cancel(struct sdap_ad_resolve_sids_state *state);
 static errno_t sdap_ad_resolve_sids_step(struct tevent_req *req);
 static void sdap_ad_resolve_sids_done(struct tevent_req *subreq);
 
@@ -572,13 +589,17 @@ sdap_ad_resolve_sids_send(TALLOC_CTX *mem_ctx,
     state->opts = opts;
     state->domain = get_domains_head(domain);
     state->sids = sids;
-    state->index = 0;
 
     if (state->sids == NULL || state->sids[0] == NULL) {
         ret = EOK;
         goto immediately;
     }
 
+    ret = sdap_ad_resolve_sids_batches(state);
+    if (ret != EOK) {
+        goto immediately;
+    }
+
     ret = sdap_ad_resolve_sids_step(req);
     if (ret != EAGAIN) {
         goto immediately;
@@ -590,6 +611,7 @@ immediately:
     if (ret == EOK) {
         tevent_req_done(req);
     } else {
+        sdap_ad_resolve_sids_cancel(state);
         tevent_req_error(req, ret);
     }
     tevent_req_post(req, ev);
@@ -597,47 +619,120 @@ immediately:
     return req;
 }
 
-static errno_t sdap_ad_resolve_sids_step(struct tevent_req *req)
+/* Split the SIDs into batches of SIDs from the same domain. */
+static errno_t sdap_ad_resolve_sids_batches(struct sdap_ad_resolve_sids_state *state)
 {
-    struct sdap_ad_resolve_sids_state *state = NULL;
-    struct tevent_req *subreq = NULL;
-    struct sdap_domain *sdap_domain = NULL;
-    struct sss_domain_info *domain = NULL;
+    struct sdap_ad_sids_batch *batch;
+    struct sdap_domain *sdap_domain;
+    struct sss_domain_info *domain;
+    size_t batch_size;
+    size_t num_sids;
+    int limit;
+    size_t i;
+    size_t j;
 
-    state = tevent_req_data(req, struct sdap_ad_resolve_sids_state);
+    /* each batch is a wildcard search, do not exceed its limit */
+    batch_size = SDAP_AD_RESOLVE_SIDS_BATCH_SIZE;
+    limit = dp_opt_get_int(state->opts->basic, SDAP_WILDCARD_LIMIT);
+    if (limit > 0 && limit < SDAP_AD_RESOLVE_SIDS_BATCH_SIZE) {
+        batch_size = limit;
+    }
 
-    do {
-        state->current_sid = state->sids[state->index];
-        if (state->current_sid == NULL) {
-            return EOK;
-        }
-        state->index++;
+    for (num_sids = 0; state->sids[num_sids] != NULL; num_sids++);
 
-        domain = sss_get_domain_by_sid_ldap_fallback(state->domain,
-                                                     state->current_sid);
+    /* at most one batch per SID */
+    state->batches = talloc_zero_array(state, struct sdap_ad_sids_batch,
+                                       num_sids);
+    if (state->batches == NULL) {
+        return ENOMEM;
+    }
 
+    for (i = 0; i < num_sids; i++) {
+        domain = sss_get_domain_by_sid_ldap_fallback(state->domain,
+                                                     state->sids[i]);
         if (domain == NULL) {
             DEBUG(SSSDBG_MINOR_FAILURE, "SID %s does not belong to any known "
-                                         "domain\n", state->current_sid);
+                                         "domain\n", state->sids[i]);
+            continue;
+        }
+
+        sdap_domain = sdap_domain_get(state->opts, domain);
+        if (sdap_domain == NULL) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "SDAP domain does not exist?\n");
+            return ERR_INTERNAL;
+        }
+
+        /* there are only a few domains, look for a batch that is not
+         * full yet starting from the most recent ones */
+        batch = NULL;
+        for (j = state->num_batches; j > 0; j--) {
+            if (state->batches[j - 1].sdom == sdap_domain
+                    && state->batches[j - 1].num_sids < batch_size) {
+                batch = &state->batches[j - 1];
+                break;
+            }
         }
-    } while (domain == NULL);
 
-    sdap_domain = sdap_domain_get(state->opts, domain);
-    if (sdap_domain == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "SDAP domain does not exist?\n");
-        return ERR_INTERNAL;
+        if (batch == NULL) {
+            batch = &state->batches[state->num_batches];
+            batch->sdom = sdap_domain;
+            batch->sids = talloc_zero_array(state->batches, const char *,
+                                            batch_size);
+            if (batch->sids == NULL) {
+                return ENOMEM;
+            }
+            state->num_batches++;
+        }
+
+        batch->sids[batch->num_sids] = state->sids[i];
+        batch->num_sids++;
     }
 
-    subreq = groups_get_send(state, state->ev, state->id_ctx, sdap_domain,
-                             state->conn, state->current_sid,
-                             BE_FILTER_SECID, false, true);
-    if (subreq == NULL) {
-        return ENOMEM;
+    DEBUG(SSSDBG_TRACE_FUNC, "Resolving %zu SIDs in %zu searches\n",
+          num_sids, state->num_batches);
+
+    return EOK;
+}
+
+/* Stop the searches that are still running */
+static void sdap_ad_resolve_sids_cancel(struct sdap_ad_resolve_sids_state *state)
+{
+    size_t i;
+
+    for (i = 0; i < state->next_batch; i++) {
+        talloc_zfree(state->batches[i].subreq);
     }
 
-    tevent_req_set_callback(subreq, sdap_ad_resolve_sids_done, req);
+    state->running = 0;
+}
+
+/* Start as many batches as allowed, returns EOK when everything is done */
+static errno_t sdap_ad_resolve_sids_step(struct tevent_req *req)
+{
+    struct sdap_ad_resolve_sids_state *state = NULL;
+    struct sdap_ad_sids_batch *batch;
+    struct tevent_req *subreq = NULL;
+
+    state = tevent_req_data(req, struct sdap_ad_resolve_sids_state);
+
+    while (state->next_batch < state->num_batches
+            && state->running < SDAP_AD_RESOLVE_SIDS_PARALLEL) {
+        batch = &state->batches[state->next_batch];
+        state->next_batch++;
+
+        subreq = groups_get_sids_send(state, state->ev, state->id_ctx,
+                                      batch->sdom, state->conn,
+                                      batch->sids, batch->num_sids);
+        if (subreq == NULL) {
+            return ENOMEM;
+        }
+
+        tevent_req_set_callback(subreq, sdap_ad_resolve_sids_done, req);
+        batch->subreq = subreq;
+        state->running++;
+    }
 
-    return EAGAIN;
+    return state->running > 0 ? EAGAIN : EOK;
 }
 
 static void sdap_ad_resolve_sids_done(struct tevent_req *subreq)
@@ -647,35 +742,48 @@ static void sdap_ad_resolve_sids_done(struct tevent_req *subreq)
     int dp_error;
     int sdap_error;
     errno_t ret;
+    size_t i;
 
     req = tevent_req_callback_data(subreq, struct tevent_req);
     state = tevent_req_data(req, struct sdap_ad_resolve_sids_state);
 
+    for (i = 0; i < state->next_batch; i++) {
+        if (state->batches[i].subreq == subreq) {
+            state->batches[i].subreq = NULL;
+            break;
+        }
+    }
+
     ret = groups_get_recv(subreq, &dp_error, &sdap_error);
     talloc_zfree(subreq);
+    state->running--;
 
     if (ret == EOK && sdap_error == ENOENT && dp_error == DP_ERR_OK) {
-        /* Group was not found, we will ignore the error and continue with
-         * next group. This may happen for example if the group is built-in,
-         * but a custom search base is provided. */
+        /* Groups were not found, we will ignore the error and continue with
+         * next groups. This may happen for example if the groups are
+         * built-in, but a custom search base is provided. */
         DEBUG(SSSDBG_CRIT_FAILURE,
-              "Unable to resolve SID %s - will try next sid.\n",
-              state->current_sid);
+              "Unable to resolve a batch of SIDs - will try next batch.\n");
     } else if (ret != EOK || sdap_error != EOK || dp_error != DP_ERR_OK) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to resolve SID %s [dp_error: %d, "
-              "sdap_error: %d, ret: %d]: %s\n", state->current_sid, dp_error,
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to resolve SIDs [dp_error: %d, "
+              "sdap_error: %d, ret: %d]: %s\n", dp_error,
               sdap_error, ret, strerror(ret));
+        if (ret == EOK) {
+            ret = sdap_error != EOK ? sdap_error : EIO;
+        }
         goto done;
     }
 
     ret = sdap_ad_resolve_sids_step(req);
     if (ret == EAGAIN) {
-        /* continue with next SID */
+        /* continue with next batch */
         return;
     }
 
 done:
     if (ret != EOK) {
+        /* the other batches would complete an already finished request */
+        sdap_ad_resolve_sids_cancel(state);
         tevent_req_error(req, ret);
         return;
     }
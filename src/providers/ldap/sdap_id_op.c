@@ -32,8 +32,9 @@ struct sdap_id_conn_cache {
 
     /* list of all open connections */
     struct sdap_id_conn_data *connections;
-    /* cached (current) connection */
-    struct sdap_id_conn_data *cached_connection;
+    /* number of pooled connections, new operations are dispatched
+     * to the pooled connection with the fewest operations */
+    int pool_count;
 };
 
 /* LDAP async operation tracker:
@@ -72,16 +73,33 @@ struct sdap_id_conn_data {
     int notify_lock;
     /* list of operations using connect */
     struct sdap_id_op *ops;
+    /* number of operations using connect */
+    int num_ops;
     /* A flag which is signalizing that this
      * connection will be disconnected and should
      * not be used any more */
     bool disconnecting;
+    /* the connection is part of the pool and may be
+     * used by new operations */
+    bool pooled;
+    /* the connection was opened in advance, not on
+     * behalf of an operation */
+    bool standby;
 };
 
 static void sdap_id_conn_cache_be_offline_cb(void *pvt);
 static void sdap_id_conn_cache_fo_reconnect_cb(void *pvt);
 
 static void sdap_id_release_conn_data(struct sdap_id_conn_data *conn_data);
+static void sdap_id_conn_cache_pool_add(struct sdap_id_conn_data *conn_data);
+static void sdap_id_conn_cache_pool_remove(struct sdap_id_conn_data *conn_data);
+static void sdap_id_conn_cache_pool_drop(struct sdap_id_conn_cache *conn_cache);
+static void sdap_id_conn_cache_pool_disconnect(struct sdap_id_conn_cache *conn_cache);
+static int sdap_id_conn_cache_pool_size(struct sdap_id_conn_cache *conn_cache);
+static void sdap_id_conn_cache_add_standby(struct sdap_id_conn_cache *conn_cache,
+                                           bool busy);
+static int sdap_id_conn_data_connect(struct sdap_id_conn_cache *conn_cache,
+                                     struct sdap_id_conn_data **_conn_data);
 static int sdap_id_conn_data_destroy(struct sdap_id_conn_data *conn_data);
 static bool sdap_is_connection_expired(struct sdap_id_conn_data *conn_data, int timeout);
 static bool sdap_can_reuse_connection(struct sdap_id_conn_data *conn_data);
@@ -144,24 +162,123 @@ fail:
 static void sdap_id_conn_cache_be_offline_cb(void *pvt)
 {
     struct sdap_id_conn_cache *conn_cache = talloc_get_type(pvt, struct sdap_id_conn_cache);
-    struct sdap_id_conn_data *cached_connection = conn_cache->cached_connection;
 
     /* Release any cached connection on going offline */
-    if (cached_connection != NULL) {
-        conn_cache->cached_connection = NULL;
-        sdap_id_release_conn_data(cached_connection);
-    }
+    sdap_id_conn_cache_pool_drop(conn_cache);
 }
 
 /* Callback for attempt to reconnect to primary server */
 static void sdap_id_conn_cache_fo_reconnect_cb(void *pvt)
 {
     struct sdap_id_conn_cache *conn_cache = talloc_get_type(pvt, struct sdap_id_conn_cache);
-    struct sdap_id_conn_data *cached_connection = conn_cache->cached_connection;
 
     /* Release any cached connection on going offline */
-    if (cached_connection != NULL) {
-        cached_connection->disconnecting = true;
+    sdap_id_conn_cache_pool_disconnect(conn_cache);
+}
+
+/* Maximum number of pooled connections */
+static int sdap_id_conn_cache_pool_size(struct sdap_id_conn_cache *conn_cache)
+{
+    int size;
+
+    size = dp_opt_get_int(conn_cache->id_conn->id_ctx->opts->basic,
+                          SDAP_CONNECTION_POOL_SIZE);
+
+    return size < 1 ? 1 : size;
+}
+
+/* Make the connection available to new operations */
+static void sdap_id_conn_cache_pool_add(struct sdap_id_conn_data *conn_data)
+{
+    if (conn_data->pooled) {
+        return;
+    }
+
+    conn_data->pooled = true;
+    conn_data->conn_cache->pool_count++;
+}
+
+/* Do not use the connection for new operations any more. The caller is
+ * responsible for releasing the connection. */
+static void sdap_id_conn_cache_pool_remove(struct sdap_id_conn_data *conn_data)
+{
+    if (!conn_data->pooled) {
+        return;
+    }
+
+    conn_data->pooled = false;
+    conn_data->conn_cache->pool_count--;
+}
+
+/* Do not reuse any pooled connection once its operations finish */
+static void sdap_id_conn_cache_pool_disconnect(struct sdap_id_conn_cache *conn_cache)
+{
+    struct sdap_id_conn_data *conn_data;
+
+    DLIST_FOR_EACH(conn_data, conn_cache->connections) {
+        if (conn_data->pooled) {
+            conn_data->disconnecting = true;
+        }
+    }
+}
+
+/* Remove all connections from the pool */
+static void sdap_id_conn_cache_pool_drop(struct sdap_id_conn_cache *conn_cache)
+{
+    struct sdap_id_conn_data *conn_data;
+    struct sdap_id_conn_data *next;
+
+    DLIST_FOR_EACH_SAFE(conn_data, next, conn_cache->connections) {
+        if (conn_data->pooled) {
+            sdap_id_conn_cache_pool_remove(conn_data);
+            sdap_id_release_conn_data(conn_data);
+        }
+    }
+}
+
+/* Open standby connections in advance so that operations do not have to
+ * share a connection with a slow operation or wait for a new connection
+ * to be established. If busy is true, one more connection is opened
+ * because all pooled connections are in use. */
+static void sdap_id_conn_cache_add_standby(struct sdap_id_conn_cache *conn_cache,
+                                           bool busy)
+{
+    struct sdap_id_conn_data *conn_data;
+    int idle = 0;
+    int wanted;
+    int ret;
+
+    if (be_is_offline(conn_cache->id_conn->id_ctx->be)) {
+        return;
+    }
+
+    wanted = dp_opt_get_int(conn_cache->id_conn->id_ctx->opts->basic,
+                            SDAP_CONNECTION_POOL_STANDBY);
+
+    DLIST_FOR_EACH(conn_data, conn_cache->connections) {
+        if (conn_data->pooled && conn_data->num_ops == 0) {
+            idle++;
+        }
+    }
+
+    if (busy && idle == 0 && wanted < 1) {
+        wanted = 1;
+    }
+
+    while (idle < wanted
+            && conn_cache->pool_count < sdap_id_conn_cache_pool_size(conn_cache)) {
+        DEBUG(SSSDBG_TRACE_ALL, "opening standby connection\n");
+
+        ret = sdap_id_conn_data_connect(conn_cache, &conn_data);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "Unable to open standby connection [%d]: %s\n",
+                  ret, sss_strerror(ret));
+            return;
+        }
+
+        conn_data->standby = true;
+        idle++;
     }
 }
 
@@ -175,7 +292,7 @@ static void sdap_id_release_conn_data(struct sdap_id_conn_data *conn_data)
     }
 
     conn_cache = conn_data->conn_cache;
-    if (conn_data == conn_cache->cached_connection) {
+    if (conn_data->pooled) {
         return;
     }
 
@@ -195,6 +312,9 @@ static int sdap_id_conn_data_destroy(struct sdap_id_conn_data *conn_data)
         op->conn_data = NULL;
         DLIST_REMOVE(conn_data->ops, op);
     }
+    conn_data->num_ops = 0;
+
+    sdap_id_conn_cache_pool_remove(conn_data);
 
     return 0;
 }
@@ -280,10 +400,13 @@ static void sdap_id_conn_data_expire_handler(struct tevent_context *ev,
     DEBUG(SSSDBG_MINOR_FAILURE,
           "connection is about to expire, releasing it\n");
 
-    if (conn_cache->cached_connection == conn_data) {
-        conn_cache->cached_connection = NULL;
+    if (conn_data->pooled) {
+        sdap_id_conn_cache_pool_remove(conn_data);
 
         sdap_id_release_conn_data(conn_data);
+
+        /* Replace it before an operation has to wait for it */
+        sdap_id_conn_cache_add_standby(conn_cache, false);
     }
 }
 
@@ -316,12 +439,14 @@ static void sdap_id_op_hook_conn_data(struct sdap_id_op *op, struct sdap_id_conn
 
     if (current) {
         DLIST_REMOVE(current->ops, op);
+        current->num_ops--;
     }
 
     op->conn_data = conn_data;
 
     if (conn_data) {
         DLIST_ADD_END(conn_data->ops, op, struct sdap_id_op*);
+        conn_data->num_ops++;
     }
 
     if (current) {
@@ -448,6 +573,43 @@ done:
     return req;
 }
 
+/* Start a new pooled connection */
+static int sdap_id_conn_data_connect(struct sdap_id_conn_cache *conn_cache,
+                                     struct sdap_id_conn_data **_conn_data)
+{
+    struct sdap_id_conn_ctx *id_conn = conn_cache->id_conn;
+    struct sdap_id_conn_data *conn_data;
+    struct tevent_req *subreq;
+
+    conn_data = talloc_zero(conn_cache, struct sdap_id_conn_data);
+    if (!conn_data) {
+        return ENOMEM;
+    }
+
+    talloc_set_destructor(conn_data, sdap_id_conn_data_destroy);
+
+    conn_data->conn_cache = conn_cache;
+    subreq = sdap_cli_connect_send(conn_data, id_conn->id_ctx->be->ev,
+                                   id_conn->id_ctx->opts,
+                                   id_conn->id_ctx->be,
+                                   id_conn->service, false,
+                                   CON_TLS_DFL, false);
+
+    if (!subreq) {
+        talloc_free(conn_data);
+        return ENOMEM;
+    }
+
+    tevent_req_set_callback(subreq, sdap_id_op_connect_done, conn_data);
+    conn_data->connect_req = subreq;
+
+    DLIST_ADD(conn_cache->connections, conn_data);
+    sdap_id_conn_cache_pool_add(conn_data);
+
+    *_conn_data = conn_data;
+    return EOK;
+}
+
 /* Begin a connection retry to LDAP server */
 static int sdap_id_op_connect_step(struct tevent_req *req)
 {
@@ -458,67 +620,64 @@ static int sdap_id_op_connect_step(struct tevent_req *req)
 
     int ret = EOK;
     struct sdap_id_conn_data *conn_data;
-    struct tevent_req *subreq = NULL;
+    struct sdap_id_conn_data *next;
+    struct sdap_id_conn_data *best = NULL;
+    struct sdap_id_conn_data *connecting = NULL;
+
+    /* Try to reuse the pooled connection with the fewest operations */
+    DLIST_FOR_EACH_SAFE(conn_data, next, conn_cache->connections) {
+        if (!conn_data->pooled) {
+            continue;
+        }
 
-    /* Try to reuse context cached connection */
-    conn_data = conn_cache->cached_connection;
-    if (conn_data) {
         if (conn_data->connect_req) {
-            DEBUG(SSSDBG_TRACE_ALL, "waiting for connection to complete\n");
-            sdap_id_op_hook_conn_data(op, conn_data);
-            goto done;
+            if (connecting == NULL || conn_data->num_ops < connecting->num_ops) {
+                connecting = conn_data;
+            }
+            continue;
         }
 
-        if (sdap_can_reuse_connection(conn_data)) {
-            DEBUG(SSSDBG_TRACE_ALL, "reusing cached connection\n");
-            sdap_id_op_hook_conn_data(op, conn_data);
-            goto done;
+        if (!sdap_can_reuse_connection(conn_data)) {
+            DEBUG(SSSDBG_TRACE_ALL, "releasing expired cached connection\n");
+            sdap_id_conn_cache_pool_remove(conn_data);
+            sdap_id_release_conn_data(conn_data);
+            continue;
         }
 
-        DEBUG(SSSDBG_TRACE_ALL, "releasing expired cached connection\n");
-        conn_cache->cached_connection = NULL;
-        sdap_id_release_conn_data(conn_data);
+        if (best == NULL || conn_data->num_ops < best->num_ops) {
+            best = conn_data;
+        }
     }
 
-    DEBUG(SSSDBG_TRACE_ALL, "beginning to connect\n");
+    if (best != NULL) {
+        DEBUG(SSSDBG_TRACE_ALL, "reusing cached connection with %d "
+              "operations\n", best->num_ops);
+        sdap_id_op_hook_conn_data(op, best);
 
-    conn_data = talloc_zero(conn_cache, struct sdap_id_conn_data);
-    if (!conn_data) {
-        ret = ENOMEM;
+        /* The operation shares the connection with others, make sure the
+         * next one does not have to */
+        if (best->num_ops > 1 && connecting == NULL) {
+            sdap_id_conn_cache_add_standby(conn_cache, true);
+        }
         goto done;
     }
 
-    talloc_set_destructor(conn_data, sdap_id_conn_data_destroy);
-
-    conn_data->conn_cache = conn_cache;
-    subreq = sdap_cli_connect_send(conn_data, state->ev,
-                                   state->id_conn->id_ctx->opts,
-                                   state->id_conn->id_ctx->be,
-                                   state->id_conn->service, false,
-                                   CON_TLS_DFL, false);
-
-    if (!subreq) {
-        ret = ENOMEM;
+    if (connecting != NULL) {
+        DEBUG(SSSDBG_TRACE_ALL, "waiting for connection to complete\n");
+        sdap_id_op_hook_conn_data(op, connecting);
         goto done;
     }
 
-    tevent_req_set_callback(subreq, sdap_id_op_connect_done, conn_data);
-    conn_data->connect_req = subreq;
+    DEBUG(SSSDBG_TRACE_ALL, "beginning to connect\n");
 
-    DLIST_ADD(conn_cache->connections, conn_data);
-    conn_cache->cached_connection = conn_data;
+    ret = sdap_id_conn_data_connect(conn_cache, &conn_data);
+    if (ret != EOK) {
+        goto done;
+    }
 
     sdap_id_op_hook_conn_data(op, conn_data);
 
 done:
-    if (ret != EOK && conn_data) {
-        sdap_id_release_conn_data(conn_data);
-    }
-
-    if (ret != EOK) {
-        talloc_zfree(subreq);
-    }
-
     return ret;
 }
 
@@ -556,6 +715,17 @@ static void sdap_id_op_connect_done(struct tevent_req *subreq)
         ret = EFAULT;
     }
 
+    if (ret != EOK && conn_data->standby && conn_data->ops == NULL) {
+        /* Nobody is waiting for the standby connection, the next operation
+         * will find out whether the server is reachable. */
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unable to open standby connection "
+              "[%d]: %s\n", ret, sss_strerror(ret));
+        conn_data->notify_lock--;
+        sdap_id_conn_cache_pool_remove(conn_data);
+        sdap_id_release_conn_data(conn_data);
+        return;
+    }
+
     if (ret != EOK && !can_retry) {
         if (conn_cache->id_conn->ignore_mark_offline) {
             DEBUG(SSSDBG_TRACE_FUNC,
@@ -644,9 +814,7 @@ static void sdap_id_op_connect_done(struct tevent_req *subreq)
             bool retry = false;
 
             /* drop connection from cache now */
-            if (conn_cache->cached_connection == conn_data) {
-                conn_cache->cached_connection = NULL;
-            }
+            sdap_id_conn_cache_pool_remove(conn_data);
 
             if (can_retry) {
                 /* determining whether retry is possible */
@@ -706,19 +874,22 @@ static void sdap_id_op_connect_done(struct tevent_req *subreq)
 
     if ((ret == EOK) &&
         conn_data->sh->connected &&
-        !be_is_offline(conn_cache->id_conn->id_ctx->be)) {
+        !be_is_offline(conn_cache->id_conn->id_ctx->be) &&
+        (conn_data->pooled
+            || conn_cache->pool_count < sdap_id_conn_cache_pool_size(conn_cache))) {
         DEBUG(SSSDBG_TRACE_ALL,
               "caching successful connection after %d notifies\n", notify_count);
-        conn_cache->cached_connection = conn_data;
+        sdap_id_conn_cache_pool_add(conn_data);
 
-        /* Run any post-connection routines */
-        be_run_unconditional_online_cb(conn_cache->id_conn->id_ctx->be);
-        be_run_online_cb(conn_cache->id_conn->id_ctx->be);
+        if (!conn_data->standby || notify_count > 0) {
+            /* Run any post-connection routines */
+            be_run_unconditional_online_cb(conn_cache->id_conn->id_ctx->be);
+            be_run_online_cb(conn_cache->id_conn->id_ctx->be);
 
-    } else {
-        if (conn_cache->cached_connection == conn_data) {
-            conn_cache->cached_connection = NULL;
+            sdap_id_conn_cache_add_standby(conn_cache, false);
         }
+    } else {
+        sdap_id_conn_cache_pool_remove(conn_data);
 
         sdap_id_release_conn_data(conn_data);
     }
@@ -820,10 +991,11 @@ int sdap_id_op_done(struct sdap_id_op *op, int retval, int *dp_err_out)
             break;
     }
 
-    if (communication_error && current_conn != 0
-            && current_conn == op->conn_cache->cached_connection) {
-        /* do not reuse failed connection */
-        op->conn_cache->cached_connection = NULL;
+    if (communication_error && current_conn != 0 && current_conn->pooled) {
+        /* do not reuse failed connection nor the other connections
+         * to the same server */
+        sdap_id_conn_cache_pool_remove(current_conn);
+        sdap_id_conn_cache_pool_disconnect(op->conn_cache);
 
         DEBUG(SSSDBG_FUNC_DATA,
               "communication error on cached connection, moving to next server\n");
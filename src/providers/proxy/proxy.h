@@ -42,8 +42,6 @@
 #include "sss_client/nss_compat.h"
 #include <dhash.h>
 
-#define PROXY_CHILD_PATH "/org/freedesktop/sssd/proxychild"
-
 struct proxy_nss_ops {
     enum nss_status (*getpwnam_r)(const char *name, struct passwd *result,
                                   char *buffer, size_t buflen, int *errnop);
@@ -96,52 +94,36 @@ struct authtok_conv {
     bool sent_old;
 };
 
+struct proxy_thread_pool;
+
 struct proxy_id_ctx {
     struct be_ctx *be;
     bool fast_alias;
     struct proxy_nss_ops ops;
     void *handle;
+    /* runs the blocking NSS calls */
+    struct proxy_thread_pool *threads;
 };
 
+struct proxy_child;
+struct proxy_child_state;
+
 struct proxy_auth_ctx {
     struct be_ctx *be;
     char *pam_target;
 
+    /* long-lived proxy_child processes that serve the PAM requests */
     uint32_t max_children;
-    uint32_t running;
-    uint32_t next_id;
-    hash_table_t *request_table;
-    struct sbus_connection *sbus_srv;
+    uint32_t num_children;
+    struct proxy_child *children;
+    /* requests waiting for a free child, oldest first */
+    struct proxy_child_state *queue;
     int timeout_ms;
 };
 
-struct proxy_child_ctx {
-    struct proxy_auth_ctx *auth_ctx;
-    struct be_req *be_req;
-    struct pam_data *pd;
+/* Largest message exchanged with proxy_child */
+#define PROXY_CHILD_MAX_FRAME (64 * 1024)
 
-    uint32_t id;
-    pid_t pid;
-    bool running;
-
-    struct sbus_connection *conn;
-    struct tevent_timer *timer;
-
-    struct tevent_req *init_req;
-};
-
-struct pc_init_ctx {
-    char *command;
-    pid_t pid;
-    struct tevent_timer *timeout;
-    struct tevent_signal *sige;
-    struct proxy_child_ctx *child_ctx;
-    struct sbus_connection *conn;
-};
-
-//int proxy_client_init(struct sbus_connection *conn, void *data);
-
-#define PROXY_CHILD_PIPE "private/proxy_child"
 #define DEFAULT_BUFSIZE 4096
 #define MAX_BUF_SIZE 1024*1024 /* max 1MiB */
 
@@ -156,6 +138,30 @@ errno_t proxy_account_info_handler_recv(TALLOC_CTX *mem_ctx,
                                        struct tevent_req *req,
                                        struct dp_reply_std *data);
 
+/* From proxy_threads.c */
+
+/* Runs in a worker thread. It must only call into the NSS module and must
+ * not use talloc, DEBUG or any other part of SSSD. */
+typedef void (*proxy_thread_fn)(void *pvt);
+
+/* If max_threads is 0 the jobs run in the main thread */
+errno_t proxy_thread_pool_init(TALLOC_CTX *mem_ctx,
+                               struct tevent_context *ev,
+                               int max_threads,
+                               struct proxy_thread_pool **_pool);
+
+/* pvt is talloc memory, it is owned by the job until it is returned by
+ * proxy_thread_job_recv() */
+struct tevent_req *proxy_thread_job_send(TALLOC_CTX *mem_ctx,
+                                         struct tevent_context *ev,
+                                         struct proxy_thread_pool *pool,
+                                         proxy_thread_fn fn,
+                                         void *pvt);
+
+errno_t proxy_thread_job_recv(TALLOC_CTX *mem_ctx,
+                              struct tevent_req *req,
+                              void **_pvt);
+
 /* From proxy_auth.c */
 struct tevent_req *
 proxy_pam_handler_send(TALLOC_CTX *mem_ctx,
@@ -168,6 +174,28 @@ proxy_pam_handler_recv(TALLOC_CTX *mem_ctx,
                       struct tevent_req *req,
                       struct pam_data **_data);
 
+/* From proxy_child_proto.c */
+struct io_buffer;
+
+/* The returned buffers hold a complete frame, including the length */
+errno_t proxy_child_pack_request(TALLOC_CTX *mem_ctx,
+                                 struct pam_data *pd,
+                                 struct io_buffer **_buf);
+
+errno_t proxy_child_unpack_request(TALLOC_CTX *mem_ctx,
+                                   uint8_t *data,
+                                   size_t size,
+                                   struct pam_data **_pd);
+
+errno_t proxy_child_pack_response(TALLOC_CTX *mem_ctx,
+                                  struct pam_data *pd,
+                                  struct io_buffer **_buf);
+
+/* data and size describe the payload of the frame only */
+errno_t proxy_child_unpack_response(uint8_t *data,
+                                    size_t size,
+                                    struct pam_data *pd);
+
 /* From proxy_netgroup.c */
 errno_t get_netgroup(struct proxy_id_ctx *ctx,
                      struct sss_domain_info *dom,
@@ -188,6 +216,4 @@ errno_t enum_services(struct proxy_id_ctx *ctx,
                       struct sysdb_ctx *sysdb,
                       struct sss_domain_info *dom);
 
-int proxy_client_init(struct sbus_connection *conn, void *data);
-
 #endif /* __PROXY_H__ */
@@ -23,692 +23,616 @@
 */
 
 #include <signal.h>
+#include <fcntl.h>
+#include <sys/socket.h>
 
+#include "util/child_common.h"
 #include "providers/proxy/proxy.h"
-#include "providers/proxy/proxy_iface_generated.h"
 
-struct pc_init_ctx;
+/*
+ * PAM requests are served by a pool of long-lived proxy_child processes.
+ * Each child is connected to the back end with a socketpair and handles one
+ * request at a time. A new child is started only if all children are busy
+ * and there are fewer than proxy_max_children of them, otherwise the request
+ * waits in a queue until a child becomes free. A child that has been idle
+ * for PROXY_CHILD_IDLE_TIMEOUT seconds is terminated.
+ */
 
-static int proxy_child_destructor(TALLOC_CTX *ctx)
-{
-    struct proxy_child_ctx *child_ctx =
-            talloc_get_type(ctx, struct proxy_child_ctx);
-    hash_key_t key;
-    int hret;
+#define PROXY_CHILD_IDLE_TIMEOUT 60
 
-    DEBUG(SSSDBG_TRACE_INTERNAL,
-          "Removing proxy child id [%d]\n", child_ctx->id);
-    key.type = HASH_KEY_ULONG;
-    key.ul = child_ctx->id;
-    hret = hash_delete(child_ctx->auth_ctx->request_table, &key);
-    if (!(hret == HASH_SUCCESS ||
-          hret == HASH_ERROR_KEY_NOT_FOUND)) {
-        DEBUG(SSSDBG_CRIT_FAILURE,
-              "Hash error [%d][%s]\n", hret, hash_error_string(hret));
-        /* Nothing we can do about this, so just continue */
-    }
-    return 0;
-}
+struct proxy_child_state;
 
-static struct tevent_req *proxy_child_init_send(TALLOC_CTX *mem_ctx,
-                                              struct proxy_child_ctx *child_ctx,
-                                              struct proxy_auth_ctx *auth_ctx);
-static void proxy_child_init_done(struct tevent_req *subreq);
-static struct tevent_req *proxy_child_send(TALLOC_CTX *mem_ctx,
-                                           struct proxy_auth_ctx *auth_ctx,
-                                           struct pam_data *pd)
-{
-    struct tevent_req *req;
-    struct tevent_req *subreq;
-    struct proxy_child_ctx *state;
-    int hret;
-    hash_key_t key;
-    hash_value_t value;
-    uint32_t first;
+struct proxy_child {
+    struct proxy_child *prev;
+    struct proxy_child *next;
 
-    req = tevent_req_create(mem_ctx, &state, struct proxy_child_ctx);
-    if (req == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Could not send PAM request to child\n");
-        return NULL;
-    }
+    struct proxy_auth_ctx *auth_ctx;
+    pid_t pid;
+    int fd;
+    struct tevent_fd *fde;
+    struct sss_child_ctx_old *sigchld;
 
-    state->auth_ctx = auth_ctx;
-    state->pd = pd;
+    /* request timeout while busy, idle timeout otherwise */
+    struct tevent_timer *timer;
 
-    /* Find an available key */
-    key.type = HASH_KEY_ULONG;
-    key.ul = auth_ctx->next_id;
-
-    first = auth_ctx->next_id;
-    while (auth_ctx->next_id == 0 ||
-            hash_has_key(auth_ctx->request_table, &key)) {
-        /* Handle overflow, zero is a reserved value
-         * Also handle the unlikely case where the next ID
-         * is still awaiting being run
-         */
-        auth_ctx->next_id++;
-        key.ul = auth_ctx->next_id;
-
-        if (auth_ctx->next_id == first) {
-            /* We've looped through all possible integers! */
-            DEBUG(SSSDBG_FATAL_FAILURE, "Serious error: queue is too long!\n");
-            talloc_zfree(req);
-            return NULL;
-        }
-    }
+    bool busy;
+    /* NULL if the request was cancelled while the child was working on it */
+    struct proxy_child_state *state;
 
-    state->id = auth_ctx->next_id;
-    auth_ctx->next_id++;
+    struct io_buffer *out;
+    size_t out_done;
 
-    value.type = HASH_VALUE_PTR;
-    value.ptr = req;
-    DEBUG(SSSDBG_TRACE_INTERNAL, "Queueing request [%lu]\n", key.ul);
-    hret = hash_enter(auth_ctx->request_table,
-                      &key, &value);
-    if (hret != HASH_SUCCESS) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Could not add request to the queue\n");
-        talloc_zfree(req);
-        return NULL;
-    }
+    uint8_t in_hdr[sizeof(uint32_t)];
+    uint8_t *in;
+    uint32_t in_len;
+    size_t in_done;
+};
 
-    talloc_set_destructor((TALLOC_CTX *) state,
-                          proxy_child_destructor);
+struct proxy_child_state {
+    struct proxy_child_state *prev;
+    struct proxy_child_state *next;
+
+    struct tevent_req *req;
+    struct proxy_auth_ctx *auth_ctx;
+    struct pam_data *pd;
 
-    if (auth_ctx->running < auth_ctx->max_children) {
-        /* There's an available slot; start a child
-         * to handle the request
-         */
+    bool queued;
+    struct proxy_child *child;
+};
 
-        auth_ctx->running++;
-        subreq = proxy_child_init_send(auth_ctx, state, auth_ctx);
-        if (!subreq) {
-            DEBUG(SSSDBG_CRIT_FAILURE, "Could not fork child process\n");
-            auth_ctx->running--;
-            talloc_zfree(req);
-            return NULL;
-        }
-        tevent_req_set_callback(subreq, proxy_child_init_done, req);
+static void proxy_child_schedule(struct proxy_auth_ctx *auth_ctx);
 
-        state->running = true;
-    }
-    else {
-        /* If there was no available slot, it will be queued
-         * until a slot is available
-         */
-        DEBUG(SSSDBG_TRACE_INTERNAL,
-              "All available child slots are full, queuing request\n");
+static void proxy_child_buffers_free(struct proxy_child *child)
+{
+    if (child->out != NULL) {
+        safezero(child->out->data, child->out->size);
+        talloc_zfree(child->out);
     }
-    return req;
+    child->out_done = 0;
+
+    talloc_zfree(child->in);
+    child->in_len = 0;
+    child->in_done = 0;
 }
 
-static int pc_init_destructor (TALLOC_CTX *ctx)
+static int proxy_child_destructor(struct proxy_child *child)
 {
-    struct pc_init_ctx *init_ctx =
-            talloc_get_type(ctx, struct pc_init_ctx);
+    DEBUG(SSSDBG_TRACE_INTERNAL,
+          "Removing proxy child [%d]\n", child->pid);
+
+    if (child->state != NULL) {
+        child->state->child = NULL;
+        child->state = NULL;
+    }
+
+    proxy_child_buffers_free(child);
+    talloc_zfree(child->fde);
+    if (child->fd != -1) {
+        close(child->fd);
+        child->fd = -1;
+    }
+
+    /* Kills the child. The SIGCHLD handler is kept to reap it but does not
+     * call back into this structure anymore. */
+    if (child->sigchld != NULL) {
+        child_handler_destroy(child->sigchld);
+        child->sigchld = NULL;
+    }
+
+    DLIST_REMOVE(child->auth_ctx->children, child);
+    child->auth_ctx->num_children--;
 
-    /* If the init request has died, forcibly kill the child */
-    kill(init_ctx->pid, SIGKILL);
     return 0;
 }
 
-static void pc_init_sig_handler(struct tevent_context *ev,
-                           struct tevent_signal *sige, int signum,
-                           int count, void *__siginfo, void *pvt);
-static void pc_init_timeout(struct tevent_context *ev,
-                            struct tevent_timer *te,
-                            struct timeval t, void *ptr);
-static struct tevent_req *proxy_child_init_send(TALLOC_CTX *mem_ctx,
-                                              struct proxy_child_ctx *child_ctx,
-                                              struct proxy_auth_ctx *auth_ctx)
+/* Stops the child and fails the request it was working on, if any */
+static void proxy_child_terminate(struct proxy_child *child, errno_t error)
 {
-    struct tevent_req *req;
-    struct pc_init_ctx *state;
-    char **proxy_child_args;
-    struct timeval tv;
-    errno_t ret;
-    pid_t pid;
+    struct proxy_auth_ctx *auth_ctx = child->auth_ctx;
+    struct proxy_child_state *state = child->state;
 
-    req = tevent_req_create(mem_ctx, &state, struct pc_init_ctx);
-    if (req == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Could not create tevent_req\n");
-        return NULL;
+    if (state != NULL) {
+        state->child = NULL;
+        child->state = NULL;
     }
 
-    state->child_ctx = child_ctx;
+    talloc_free(child);
 
-    state->command = talloc_asprintf(req,
-            "%s/proxy_child -d %#.4x --debug-timestamps=%d "
-            "--debug-microseconds=%d%s --domain %s --id %d",
-            SSSD_LIBEXEC_PATH, debug_level, debug_timestamps,
-            debug_microseconds, (debug_to_file ? " --debug-to-files" : ""),
-            auth_ctx->be->domain->name,
-            child_ctx->id);
-    if (state->command == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "talloc_asprintf failed.\n");
-        return NULL;
+    if (state != NULL) {
+        state->pd->pam_status = PAM_SYSTEM_ERR;
+        tevent_req_error(state->req, error);
     }
 
-    DEBUG(SSSDBG_TRACE_LIBS,
-          "Starting proxy child with args [%s]\n", state->command);
+    proxy_child_schedule(auth_ctx);
+}
 
-    pid = fork();
-    if (pid < 0) {
-        ret = errno;
-        DEBUG(SSSDBG_CRIT_FAILURE,
-              "fork failed [%d][%s].\n", ret, strerror(ret));
-        talloc_zfree(req);
-        return NULL;
-    }
+static void proxy_child_exited(int child_status,
+                               struct tevent_signal *sige,
+                               void *pvt)
+{
+    struct proxy_child *child = talloc_get_type(pvt, struct proxy_child);
 
-    if (pid == 0) { /* child */
-        proxy_child_args = parse_args(state->command);
-        execvp(proxy_child_args[0], proxy_child_args);
+    DEBUG(SSSDBG_CONF_SETTINGS, "Proxy child [%d] exited\n", child->pid);
 
-        ret = errno;
-        DEBUG(SSSDBG_FATAL_FAILURE,
-              "Could not start proxy child [%s]: [%d][%s].\n",
-                  state->command, ret, strerror(ret));
+    /* The handler frees itself once we return */
+    child->sigchld = NULL;
+    proxy_child_terminate(child, EIO);
+}
 
-        _exit(1);
+static void proxy_child_timeout(struct tevent_context *ev,
+                                struct tevent_timer *te,
+                                struct timeval tv,
+                                void *pvt)
+{
+    struct proxy_child *child = talloc_get_type(pvt, struct proxy_child);
+
+    child->timer = NULL;
+
+    if (child->busy) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Proxy child [%d] did not answer in time, terminating it\n",
+              child->pid);
+        proxy_child_terminate(child, ETIMEDOUT);
+        return;
     }
 
-    else { /* parent */
-        state->pid = pid;
-        /* Make sure to kill the child process if we abort */
-        talloc_set_destructor((TALLOC_CTX *)state, pc_init_destructor);
+    DEBUG(SSSDBG_TRACE_FUNC,
+          "Proxy child [%d] has been idle for too long\n", child->pid);
+    talloc_free(child);
+}
 
-        state->sige = tevent_add_signal(auth_ctx->be->ev, req,
-                                        SIGCHLD, 0,
-                                        pc_init_sig_handler, req);
-        if (state->sige == NULL) {
-            DEBUG(SSSDBG_CRIT_FAILURE, "tevent_add_signal failed.\n");
-            talloc_zfree(req);
-            return NULL;
-        }
+static errno_t proxy_child_set_timer(struct proxy_child *child,
+                                     struct timeval tv)
+{
+    talloc_zfree(child->timer);
 
-        /* Save the init request to the child context.
-         * This is technically a layering violation,
-         * but it's the only sane way to be able to
-         * identify which client is which when it
-         * connects to the backend in
-         * client_registration()
-         */
-        child_ctx->init_req = req;
-
-        /* Wait six seconds for the child to connect
-         * This is because the connection handler will add
-         * its own five-second timeout, and we don't want to
-         * be faster here.
-         */
-        tv = tevent_timeval_current_ofs(6, 0);
-        state->timeout = tevent_add_timer(auth_ctx->be->ev, req,
-                                          tv, pc_init_timeout, req);
-
-        /* processing will continue once the connection is received
-         * in proxy_client_init()
-         */
-        return req;
+    child->timer = tevent_add_timer(child->auth_ctx->be->ev, child, tv,
+                                    proxy_child_timeout, child);
+    if (child->timer == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_add_timer failed.\n");
+        return ENOMEM;
     }
+
+    return EOK;
 }
 
-static void pc_init_sig_handler(struct tevent_context *ev,
-                                struct tevent_signal *sige, int signum,
-                                int count, void *__siginfo, void *pvt)
+static void proxy_child_reply(struct proxy_child *child)
 {
-    int ret;
-    int child_status;
-    struct tevent_req *req;
-    struct pc_init_ctx *init_ctx;
+    struct proxy_auth_ctx *auth_ctx = child->auth_ctx;
+    struct proxy_child_state *state = child->state;
+    errno_t ret;
 
-    if (count <= 0) {
-        DEBUG(SSSDBG_FATAL_FAILURE,
-              "SIGCHLD handler called with invalid child count\n");
-        return;
+    child->busy = false;
+    child->state = NULL;
+    talloc_zfree(child->out);
+
+    ret = proxy_child_set_timer(child,
+                    tevent_timeval_current_ofs(PROXY_CHILD_IDLE_TIMEOUT, 0));
+    if (ret != EOK) {
+        /* without a timer the child would never go away */
+        talloc_free(child);
+        child = NULL;
     }
 
-    req = talloc_get_type(pvt, struct tevent_req);
-    init_ctx = tevent_req_data(req, struct pc_init_ctx);
+    if (state == NULL) {
+        DEBUG(SSSDBG_TRACE_INTERNAL,
+              "Request was cancelled, discarding the reply\n");
+    } else {
+        state->child = NULL;
 
-    DEBUG(SSSDBG_TRACE_LIBS, "Waiting for child [%d].\n", init_ctx->pid);
+        ret = ENOMEM;
+        if (child != NULL) {
+            ret = proxy_child_unpack_response(child->in, child->in_len,
+                                              state->pd);
+        }
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Failed to parse reply.\n");
+            state->pd->pam_status = PAM_SYSTEM_ERR;
+            tevent_req_error(state->req, ret);
+        } else {
+            DEBUG(SSSDBG_CONF_SETTINGS, "received: [%d][%s]\n",
+                  state->pd->pam_status, state->pd->domain);
+            tevent_req_done(state->req);
+        }
+    }
+
+    /* the request callback might have assigned a new request already */
+    if (child != NULL && !child->busy) {
+        proxy_child_buffers_free(child);
+    }
+
+    proxy_child_schedule(auth_ctx);
+}
 
-    errno = 0;
-    ret = waitpid(init_ctx->pid, &child_status, WNOHANG);
+static errno_t proxy_child_read(struct proxy_child *child)
+{
+    uint32_t len;
+    ssize_t ret;
 
+    if (child->in == NULL) {
+        ret = read(child->fd, child->in_hdr + child->in_done,
+                   sizeof(child->in_hdr) - child->in_done);
+    } else {
+        ret = read(child->fd, child->in + child->in_done,
+                   child->in_len - child->in_done);
+    }
     if (ret == -1) {
         ret = errno;
-        DEBUG(SSSDBG_CRIT_FAILURE,
-              "waitpid failed [%d][%s].\n", ret, strerror(ret));
+        if (ret == EAGAIN || ret == EINTR) {
+            return EAGAIN;
+        }
+        DEBUG(SSSDBG_CRIT_FAILURE, "read failed [%zd]: %s\n",
+              ret, sss_strerror(ret));
+        return ret;
     } else if (ret == 0) {
         DEBUG(SSSDBG_CRIT_FAILURE,
-              "waitpid did not find a child with changed status.\n");
-    } else {
-        if (WIFEXITED(child_status)) {
-            DEBUG(SSSDBG_CONF_SETTINGS,
-                  "child [%d] exited with status [%d].\n", ret,
-                      WEXITSTATUS(child_status));
-            tevent_req_error(req, EIO);
-        } else if (WIFSIGNALED(child_status)) {
-            DEBUG(SSSDBG_CONF_SETTINGS,
-                  "child [%d] was terminate by signal [%d].\n", ret,
-                      WTERMSIG(child_status));
-            tevent_req_error(req, EIO);
-        } else {
-            if (WIFSTOPPED(child_status)) {
-                DEBUG(SSSDBG_CRIT_FAILURE,
-                      "child [%d] was stopped by signal [%d].\n", ret,
-                          WSTOPSIG(child_status));
-            }
-            if (WIFCONTINUED(child_status) == true) {
-                DEBUG(SSSDBG_CRIT_FAILURE,
-                      "child [%d] was resumed by delivery of SIGCONT.\n",
-                          ret);
-            }
-            DEBUG(SSSDBG_CRIT_FAILURE,
-                  "Child is still running, no new child is started.\n");
-            return;
+              "Proxy child [%d] closed the connection\n", child->pid);
+        return EPIPE;
+    }
+
+    if (!child->busy) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Unexpected data from proxy child [%d]\n", child->pid);
+        return EBADMSG;
+    }
+
+    child->in_done += ret;
+
+    if (child->in == NULL) {
+        if (child->in_done < sizeof(child->in_hdr)) {
+            return EAGAIN;
+        }
+
+        SAFEALIGN_COPY_UINT32(&len, child->in_hdr, NULL);
+        if (len > PROXY_CHILD_MAX_FRAME) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Reply is too large [%u]\n", len);
+            return EBADMSG;
         }
+
+        /* keep the buffer non-NULL for an empty payload */
+        child->in = talloc_size(child, len == 0 ? 1 : len);
+        if (child->in == NULL) {
+            return ENOMEM;
+        }
+        child->in_len = len;
+        child->in_done = 0;
     }
-}
 
-static void pc_init_timeout(struct tevent_context *ev,
-                            struct tevent_timer *te,
-                            struct timeval t, void *ptr)
-{
-    struct tevent_req *req;
+    if (child->in_done < child->in_len) {
+        return EAGAIN;
+    }
 
-    DEBUG(SSSDBG_OP_FAILURE, "Client timed out before Identification!\n");
-    req = talloc_get_type(ptr, struct tevent_req);
-    tevent_req_error(req, ETIMEDOUT);
+    return EOK;
 }
 
-static errno_t proxy_child_init_recv(struct tevent_req *req,
-                                   pid_t *pid,
-                                   struct sbus_connection **conn)
+static errno_t proxy_child_write(struct proxy_child *child)
 {
-    struct pc_init_ctx *state;
-
-    TEVENT_REQ_RETURN_ON_ERROR(req);
+    ssize_t ret;
 
-    state = tevent_req_data(req, struct pc_init_ctx);
+    ret = write(child->fd, child->out->data + child->out_done,
+                child->out->size - child->out_done);
+    if (ret == -1) {
+        ret = errno;
+        if (ret == EAGAIN || ret == EINTR) {
+            return EAGAIN;
+        }
+        DEBUG(SSSDBG_CRIT_FAILURE, "write failed [%zd]: %s\n",
+              ret, sss_strerror(ret));
+        return ret;
+    }
 
-    /* Unset the destructor since we initialized successfully.
-     * We don't want to kill the child now that it's properly
-     * set up.
-     */
-    talloc_set_destructor((TALLOC_CTX *)state, NULL);
+    child->out_done += ret;
+    if (child->out_done < child->out->size) {
+        return EAGAIN;
+    }
 
-    *pid = state->pid;
-    *conn = state->conn;
+    /* the request contains the authentication tokens */
+    safezero(child->out->data, child->out->size);
+    talloc_zfree(child->out);
+    child->out_done = 0;
 
     return EOK;
 }
 
-struct proxy_child_sig_ctx {
-    struct proxy_auth_ctx *auth_ctx;
-    pid_t pid;
-};
-static void proxy_child_sig_handler(struct tevent_context *ev,
-                                    struct tevent_signal *sige, int signum,
-                                    int count, void *__siginfo, void *pvt);
-static struct tevent_req *proxy_pam_conv_send(TALLOC_CTX *mem_ctx,
-                                              struct proxy_auth_ctx *auth_ctx,
-                                              struct sbus_connection *conn,
-                                              struct pam_data *pd,
-                                              pid_t pid);
-static void proxy_pam_conv_done(struct tevent_req *subreq);
-static void proxy_child_init_done(struct tevent_req *subreq) {
-    int ret;
-    struct tevent_signal *sige;
-    struct tevent_req *req =
-            tevent_req_callback_data(subreq, struct tevent_req);
-    struct proxy_child_ctx *child_ctx =
-            tevent_req_data(req, struct proxy_child_ctx);
-    struct proxy_child_sig_ctx *sig_ctx;
-
-    ret = proxy_child_init_recv(subreq, &child_ctx->pid, &child_ctx->conn);
-    talloc_zfree(subreq);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_TRACE_FUNC, "Proxy child init failed [%d]\n", ret);
-        tevent_req_error(req, ret);
-        return;
-    }
+static void proxy_child_fd_handler(struct tevent_context *ev,
+                                   struct tevent_fd *fde,
+                                   uint16_t flags,
+                                   void *pvt)
+{
+    struct proxy_child *child = talloc_get_type(pvt, struct proxy_child);
+    errno_t ret;
 
-    /* An initialized child is available, awaiting the PAM command */
-    subreq = proxy_pam_conv_send(req, child_ctx->auth_ctx,
-                                 child_ctx->conn, child_ctx->pd,
-                                 child_ctx->pid);
-    if (!subreq) {
-        DEBUG(SSSDBG_CRIT_FAILURE,"Could not start PAM conversation\n");
-        tevent_req_error(req, EIO);
-        return;
+    if ((flags & TEVENT_FD_WRITE) && child->out != NULL) {
+        ret = proxy_child_write(child);
+        if (ret == EOK) {
+            TEVENT_FD_NOT_WRITEABLE(child->fde);
+        } else if (ret != EAGAIN) {
+            proxy_child_terminate(child, ret);
+            return;
+        }
     }
-    tevent_req_set_callback(subreq, proxy_pam_conv_done, req);
 
-    /* Add a signal handler for the child under the auth_ctx,
-     * that way if the child exits after completion of the
-     * request, it will still be handled.
-     */
-    sig_ctx = talloc_zero(child_ctx->auth_ctx, struct proxy_child_sig_ctx);
-    if(sig_ctx == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_add_signal failed.\n");
-        tevent_req_error(req, ENOMEM);
-        return;
-    }
-    sig_ctx->auth_ctx = child_ctx->auth_ctx;
-    sig_ctx->pid = child_ctx->pid;
-
-    sige = tevent_add_signal(child_ctx->auth_ctx->be->ev,
-                             child_ctx->auth_ctx,
-                             SIGCHLD, 0,
-                             proxy_child_sig_handler,
-                             sig_ctx);
-    if (sige == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_add_signal failed.\n");
-        tevent_req_error(req, ENOMEM);
-        return;
+    if (flags & TEVENT_FD_READ) {
+        ret = proxy_child_read(child);
+        if (ret == EOK) {
+            proxy_child_reply(child);
+        } else if (ret != EAGAIN) {
+            proxy_child_terminate(child, ret);
+        }
     }
-
-    /* Steal the signal context onto the signal event
-     * so that when the signal is freed, the context
-     * will go with it.
-     */
-    talloc_steal(sige, sig_ctx);
 }
 
-static void remove_sige(struct tevent_context *ev,
-                        struct tevent_immediate *imm,
-                        void *pvt);
-static void run_proxy_child_queue(struct tevent_context *ev,
-                                  struct tevent_immediate *imm,
-                                  void *pvt);
-static void proxy_child_sig_handler(struct tevent_context *ev,
-                                    struct tevent_signal *sige, int signum,
-                                    int count, void *__siginfo, void *pvt)
+static errno_t proxy_child_spawn(struct proxy_auth_ctx *auth_ctx,
+                                 struct proxy_child **_child)
 {
-    int ret;
-    int child_status;
-    struct proxy_child_sig_ctx *sig_ctx;
-    struct tevent_immediate *imm;
-    struct tevent_immediate *imm2;
+    struct proxy_child *child;
+    char **proxy_child_args;
+    char *command;
+    int sv[2];
+    errno_t ret;
+    pid_t pid;
 
-    if (count <= 0) {
-        DEBUG(SSSDBG_FATAL_FAILURE,
-              "SIGCHLD handler called with invalid child count\n");
-        return;
+    command = talloc_asprintf(auth_ctx,
+            "%s/proxy_child -d %#.4x --debug-timestamps=%d "
+            "--debug-microseconds=%d%s --domain %s",
+            SSSD_LIBEXEC_PATH, debug_level, debug_timestamps,
+            debug_microseconds, (debug_to_file ? " --debug-to-files" : ""),
+            auth_ctx->be->domain->name);
+    if (command == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "talloc_asprintf failed.\n");
+        return ENOMEM;
     }
 
-    sig_ctx = talloc_get_type(pvt, struct proxy_child_sig_ctx);
-    DEBUG(SSSDBG_TRACE_LIBS, "Waiting for child [%d].\n", sig_ctx->pid);
+    ret = socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    if (ret != 0) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "socketpair failed [%d][%s].\n", ret, strerror(ret));
+        talloc_free(command);
+        return ret;
+    }
 
-    errno = 0;
-    ret = waitpid(sig_ctx->pid, &child_status, WNOHANG);
+    /* other children of the back end must not inherit the sockets */
+    fcntl(sv[0], F_SETFD, FD_CLOEXEC);
+    fcntl(sv[1], F_SETFD, FD_CLOEXEC);
 
-    if (ret == -1) {
+    DEBUG(SSSDBG_TRACE_LIBS,
+          "Starting proxy child with args [%s]\n", command);
+
+    pid = fork();
+    if (pid < 0) {
         ret = errno;
         DEBUG(SSSDBG_CRIT_FAILURE,
-              "waitpid failed [%d][%s].\n", ret, strerror(ret));
-    } else if (ret == 0) {
-        DEBUG(SSSDBG_CRIT_FAILURE,
-              "waitpid did not found a child with changed status.\n");
-    } else {
-        if (WIFEXITED(child_status)) {
-            DEBUG(SSSDBG_CONF_SETTINGS,
-                  "child [%d] exited with status [%d].\n", ret,
-                      WEXITSTATUS(child_status));
-        } else if (WIFSIGNALED(child_status) == true) {
-            DEBUG(SSSDBG_CONF_SETTINGS,
-                  "child [%d] was terminated by signal [%d].\n", ret,
-                      WTERMSIG(child_status));
-        } else {
-            if (WIFSTOPPED(child_status)) {
-                DEBUG(SSSDBG_CRIT_FAILURE,
-                      "child [%d] was stopped by signal [%d].\n", ret,
-                          WSTOPSIG(child_status));
-            }
-            if (WIFCONTINUED(child_status) == true) {
-                DEBUG(SSSDBG_CRIT_FAILURE,
-                      "child [%d] was resumed by delivery of SIGCONT.\n",
-                          ret);
-            }
-            DEBUG(SSSDBG_CRIT_FAILURE,
-                  "Child is still running, no new child is started.\n");
-            return;
-        }
+              "fork failed [%d][%s].\n", ret, strerror(ret));
+        close(sv[0]);
+        close(sv[1]);
+        talloc_free(command);
+        return ret;
+    }
 
-        imm = tevent_create_immediate(ev);
-        if (imm == NULL) {
-            DEBUG(SSSDBG_CRIT_FAILURE, "tevent_create_immediate failed.\n");
-            return;
+    if (pid == 0) { /* child */
+        close(sv[0]);
+        if (dup2(sv[1], STDIN_FILENO) == -1) {
+            ret = errno;
+            DEBUG(SSSDBG_FATAL_FAILURE,
+                  "dup2 failed [%d][%s].\n", ret, strerror(ret));
+            _exit(1);
         }
 
-        tevent_schedule_immediate(imm, ev, run_proxy_child_queue,
-                                  sig_ctx->auth_ctx);
+        proxy_child_args = parse_args(command);
+        execvp(proxy_child_args[0], proxy_child_args);
 
-        /* schedule another immediate timer to delete the sigchld handler */
-        imm2 = tevent_create_immediate(ev);
-        if (imm2 == NULL) {
-            DEBUG(SSSDBG_CRIT_FAILURE, "tevent_create_immediate failed.\n");
-            return;
-        }
+        ret = errno;
+        DEBUG(SSSDBG_FATAL_FAILURE,
+              "Could not start proxy child [%s]: [%d][%s].\n",
+                  command, ret, strerror(ret));
 
-        tevent_schedule_immediate(imm2, ev, remove_sige, sige);
+        _exit(1);
     }
 
-    return;
-}
+    /* parent */
+    close(sv[1]);
+    talloc_free(command);
 
-static void remove_sige(struct tevent_context *ev,
-                        struct tevent_immediate *imm,
-                        void *pvt)
-{
-    talloc_free(pvt);
-}
+    child = talloc_zero(auth_ctx, struct proxy_child);
+    if (child == NULL) {
+        close(sv[0]);
+        kill(pid, SIGKILL);
+        return ENOMEM;
+    }
 
-struct proxy_conv_ctx {
-    struct proxy_auth_ctx *auth_ctx;
-    struct sbus_connection *conn;
-    struct pam_data *pd;
-    pid_t pid;
-};
-static void proxy_pam_conv_reply(DBusPendingCall *pending, void *ptr);
-static struct tevent_req *proxy_pam_conv_send(TALLOC_CTX *mem_ctx,
-                                              struct proxy_auth_ctx *auth_ctx,
-                                              struct sbus_connection *conn,
-                                              struct pam_data *pd,
-                                              pid_t pid)
-{
-    errno_t ret;
-    bool dp_ret;
-    DBusMessage *msg;
-    struct tevent_req *req;
-    struct proxy_conv_ctx *state;
+    child->auth_ctx = auth_ctx;
+    child->pid = pid;
+    child->fd = sv[0];
+    DLIST_ADD(auth_ctx->children, child);
+    auth_ctx->num_children++;
+    talloc_set_destructor(child, proxy_child_destructor);
 
-    req = tevent_req_create(mem_ctx, &state, struct proxy_conv_ctx);
-    if (req == NULL) {
-        return NULL;
+    ret = child_handler_setup(auth_ctx->be->ev, pid, proxy_child_exited,
+                              child, &child->sigchld);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Could not set up child signal handler\n");
+        kill(pid, SIGKILL);
+        goto done;
     }
 
-    state->auth_ctx = auth_ctx;
-    state->conn = conn;
-    state->pd = pd;
-    state->pid = pid;
-
-    msg = dbus_message_new_method_call(NULL,
-                                       PROXY_CHILD_PATH,
-                                       IFACE_PROXY_AUTH,
-                                       IFACE_PROXY_AUTH_PAM);
-    if (msg == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "dbus_message_new_method_call failed.\n");
-        talloc_zfree(req);
-        return NULL;
+    ret = sss_fd_nonblocking(child->fd);
+    if (ret != EOK) {
+        goto done;
     }
 
-    DEBUG(SSSDBG_CONF_SETTINGS, "Sending request with the following data:\n");
-    DEBUG_PAM_DATA(SSSDBG_CONF_SETTINGS, pd);
-
-    dp_ret = dp_pack_pam_request(msg, pd);
-    if (!dp_ret) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to build message\n");
-        dbus_message_unref(msg);
-        talloc_zfree(req);
-        return NULL;
+    child->fde = tevent_add_fd(auth_ctx->be->ev, child, child->fd,
+                               TEVENT_FD_READ, proxy_child_fd_handler, child);
+    if (child->fde == NULL) {
+        ret = ENOMEM;
+        goto done;
     }
 
-    ret = sbus_conn_send(state->conn, msg, state->auth_ctx->timeout_ms,
-                         proxy_pam_conv_reply, req, NULL);
+    DEBUG(SSSDBG_TRACE_FUNC, "Started proxy child [%d], %u running\n",
+          pid, auth_ctx->num_children);
+
+    *_child = child;
+    ret = EOK;
+
+done:
     if (ret != EOK) {
-        dbus_message_unref(msg);
-        talloc_zfree(req);
-        return NULL;
+        talloc_free(child);
     }
-
-    dbus_message_unref(msg);
-    return req;
+    return ret;
 }
 
-static void proxy_pam_conv_reply(DBusPendingCall *pending, void *ptr)
+static errno_t proxy_child_start_request(struct proxy_child *child,
+                                         struct proxy_child_state *state)
 {
-    struct tevent_req *req;
-    struct proxy_conv_ctx *state;
-    DBusError dbus_error;
-    DBusMessage *reply;
-    int type;
-    int ret;
+    errno_t ret;
 
-    DEBUG(SSSDBG_TRACE_INTERNAL, "Handling pam conversation reply\n");
+    DEBUG(SSSDBG_CONF_SETTINGS,
+          "Sending request to proxy child [%d] with the following data:\n",
+          child->pid);
+    DEBUG_PAM_DATA(SSSDBG_CONF_SETTINGS, state->pd);
 
-    req = talloc_get_type(ptr, struct tevent_req);
-    state = tevent_req_data(req, struct proxy_conv_ctx);
+    proxy_child_buffers_free(child);
 
-    dbus_error_init(&dbus_error);
+    ret = proxy_child_pack_request(child, state->pd, &child->out);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to build message\n");
+        return ret;
+    }
 
-    reply = dbus_pending_call_steal_reply(pending);
-    dbus_pending_call_unref(pending);
-    if (reply == NULL) {
-        DEBUG(SSSDBG_FATAL_FAILURE,
-              "Severe error. A reply callback was called but no reply was"
-                  "received and no timeout occurred\n");
-        state->pd->pam_status = PAM_SYSTEM_ERR;
-        tevent_req_error(req, EIO);
-    }
-
-    type = dbus_message_get_type(reply);
-    switch (type) {
-        case DBUS_MESSAGE_TYPE_METHOD_RETURN:
-            ret = dp_unpack_pam_response(reply, state->pd, &dbus_error);
-            if (!ret) {
-                DEBUG(SSSDBG_FATAL_FAILURE, "Failed to parse reply.\n");
-                state->pd->pam_status = PAM_SYSTEM_ERR;
-                dbus_message_unref(reply);
-                tevent_req_error(req, EIO);
-                return;
-            }
-            DEBUG(SSSDBG_CONF_SETTINGS, "received: [%d][%s]\n",
-                      state->pd->pam_status,
-                      state->pd->domain);
-            break;
-        case DBUS_MESSAGE_TYPE_ERROR:
-            DEBUG(SSSDBG_FATAL_FAILURE, "Reply error [%s].\n",
-                    dbus_message_get_error_name(reply));
-            state->pd->pam_status = PAM_SYSTEM_ERR;
-            break;
-        default:
-            DEBUG(SSSDBG_FATAL_FAILURE, "Default... what now?.\n");
-            state->pd->pam_status = PAM_SYSTEM_ERR;
+    ret = proxy_child_set_timer(child,
+                tevent_timeval_current_ofs(child->auth_ctx->timeout_ms / 1000,
+                                     (child->auth_ctx->timeout_ms % 1000) * 1000));
+    if (ret != EOK) {
+        proxy_child_buffers_free(child);
+        return ret;
     }
-    dbus_message_unref(reply);
 
-    /* Kill the child */
-    kill(state->pid, SIGKILL);
+    child->busy = true;
+    child->state = state;
+    state->child = child;
+    TEVENT_FD_WRITEABLE(child->fde);
 
-    /* Conversation is finished */
-    tevent_req_done(req);
+    return EOK;
 }
 
-static errno_t proxy_pam_conv_recv(struct tevent_req *req)
+static struct proxy_child *
+proxy_child_get_idle(struct proxy_auth_ctx *auth_ctx)
 {
-    TEVENT_REQ_RETURN_ON_ERROR(req);
+    struct proxy_child *child;
 
-    return EOK;
+    DLIST_FOR_EACH(child, auth_ctx->children) {
+        if (!child->busy) {
+            return child;
+        }
+    }
+
+    return NULL;
 }
 
-static void proxy_pam_conv_done(struct tevent_req *subreq)
+static void proxy_child_schedule(struct proxy_auth_ctx *auth_ctx)
 {
-    struct tevent_req *req;
-    int ret;
+    struct proxy_child_state *state;
+    struct proxy_child *child;
+    errno_t ret = EOK;
 
-    req = tevent_req_callback_data(subreq, struct tevent_req);
+    while (auth_ctx->queue != NULL) {
+        state = auth_ctx->queue;
 
-    ret = proxy_pam_conv_recv(subreq);
-    talloc_zfree(subreq);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_TRACE_FUNC, "Proxy PAM conversation failed [%d]\n", ret);
-        tevent_req_error(req, ret);
-        return;
-    }
+        child = proxy_child_get_idle(auth_ctx);
+        if (child == NULL) {
+            if (auth_ctx->num_children >= auth_ctx->max_children) {
+                /* wait until a child becomes free */
+                return;
+            }
 
-    tevent_req_done(req);
+            ret = proxy_child_spawn(auth_ctx, &child);
+            if (ret != EOK) {
+                DEBUG(SSSDBG_CRIT_FAILURE, "Could not start proxy child\n");
+                if (auth_ctx->num_children > 0) {
+                    /* try again when a running child is free */
+                    return;
+                }
+                child = NULL;
+            }
+        }
+
+        DLIST_REMOVE(auth_ctx->queue, state);
+        state->queued = false;
+
+        if (child != NULL) {
+            ret = proxy_child_start_request(child, state);
+        }
+        if (ret != EOK) {
+            state->pd->pam_status = PAM_SYSTEM_ERR;
+            tevent_req_error(state->req, ret);
+        }
+    }
 }
 
-static int proxy_child_recv(struct tevent_req *req,
-                          TALLOC_CTX *mem_ctx,
-                          struct pam_data **pd)
+static int proxy_child_state_destructor(struct proxy_child_state *state)
 {
-    struct proxy_child_ctx *ctx;
-
-    TEVENT_REQ_RETURN_ON_ERROR(req);
+    if (state->queued) {
+        DLIST_REMOVE(state->auth_ctx->queue, state);
+        state->queued = false;
+    }
 
-    ctx = tevent_req_data(req, struct proxy_child_ctx);
-    *pd = talloc_steal(mem_ctx, ctx->pd);
+    /* The child finishes the request on its own, the reply is dropped */
+    if (state->child != NULL) {
+        state->child->state = NULL;
+        state->child = NULL;
+    }
 
-    return EOK;
+    return 0;
 }
 
-static void run_proxy_child_queue(struct tevent_context *ev,
-                                  struct tevent_immediate *imm,
-                                  void *pvt)
+static struct tevent_req *proxy_child_send(TALLOC_CTX *mem_ctx,
+                                           struct proxy_auth_ctx *auth_ctx,
+                                           struct pam_data *pd)
 {
-    struct proxy_auth_ctx *auth_ctx;
-    struct hash_iter_context_t *iter;
-    struct hash_entry_t *entry;
+    struct proxy_child_state *state;
     struct tevent_req *req;
-    struct tevent_req *subreq;
-    struct proxy_child_ctx *state;
 
-    auth_ctx = talloc_get_type(pvt, struct proxy_auth_ctx);
+    req = tevent_req_create(mem_ctx, &state, struct proxy_child_state);
+    if (req == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Could not send PAM request to child\n");
+        return NULL;
+    }
 
-    /* Launch next queued request */
-    iter = new_hash_iter_context(auth_ctx->request_table);
-    while ((entry = iter->next(iter)) != NULL) {
-        req = talloc_get_type(entry->value.ptr, struct tevent_req);
-        state = tevent_req_data(req, struct proxy_child_ctx);
-        if (!state->running) {
-            break;
-        }
+    state->req = req;
+    state->auth_ctx = auth_ctx;
+    state->pd = pd;
+
+    talloc_set_destructor(state, proxy_child_state_destructor);
+
+    DLIST_ADD_END(auth_ctx->queue, state, struct proxy_child_state *);
+    state->queued = true;
+
+    if (auth_ctx->num_children >= auth_ctx->max_children
+            && proxy_child_get_idle(auth_ctx) == NULL) {
+        DEBUG(SSSDBG_TRACE_INTERNAL,
+              "All available child slots are full, queuing request\n");
     }
-    free(iter);
 
-    if (!entry) {
-        /* Nothing pending on the queue */
-        return;
+    proxy_child_schedule(auth_ctx);
+    if (!tevent_req_is_in_progress(req)) {
+        tevent_req_post(req, auth_ctx->be->ev);
     }
 
-    if (auth_ctx->running < auth_ctx->max_children) {
-        /* There's an available slot; start a child
-         * to handle the request
-         */
-        auth_ctx->running++;
-        subreq = proxy_child_init_send(auth_ctx, state, auth_ctx);
-        if (!subreq) {
-            DEBUG(SSSDBG_CRIT_FAILURE, "Could not fork child process\n");
-            auth_ctx->running--;
-            talloc_zfree(req);
-            return;
-        }
-        tevent_req_set_callback(subreq, proxy_child_init_done, req);
+    return req;
+}
 
-        state->running = true;
-    }
+static int proxy_child_recv(struct tevent_req *req,
+                            TALLOC_CTX *mem_ctx,
+                            struct pam_data **pd)
+{
+    struct proxy_child_state *state;
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    state = tevent_req_data(req, struct proxy_child_state);
+    *pd = talloc_steal(mem_ctx, state->pd);
+
+    return EOK;
 }
 
 struct proxy_pam_handler_state {
@@ -784,7 +708,6 @@ immediately:
 static void proxy_pam_handler_done(struct tevent_req *subreq)
 {
     struct proxy_pam_handler_state *state;
-    struct tevent_immediate *imm;
     struct tevent_req *req;
     const char *password;
     errno_t ret;
@@ -799,24 +722,6 @@ static void proxy_pam_handler_done(struct tevent_req *subreq)
         goto done;
     }
 
-    /* Start the next auth in the queue, if any */
-    state->auth_ctx->running--;
-    imm = tevent_create_immediate(state->be_ctx->ev);
-    if (imm == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_create_immediate failed.\n");
-        /* We'll still finish the current request, but we're
-         * likely to have problems if there are queued events
-         * if we've gotten into this state.
-         * Hopefully this is impossible, since freeing req
-         * above should guarantee that we have enough memory
-         * to create this immediate event.
-         */
-    } else {
-        tevent_schedule_immediate(imm, state->be_ctx->ev,
-                                  run_proxy_child_queue,
-                                  state->auth_ctx);
-    }
-
     /* Check if we need to save the cached credentials */
     if ((state->pd->cmd == SSS_PAM_AUTHENTICATE || state->pd->cmd == SSS_PAM_CHAUTHTOK)
             && (state->pd->pam_status == PAM_SUCCESS) && state->be_ctx->domain->cache_credentials) {
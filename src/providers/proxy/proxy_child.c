@@ -24,6 +24,7 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/types.h>
@@ -35,16 +36,14 @@
 #include <errno.h>
 #include <dlfcn.h>
 #include <popt.h>
-#include <dbus/dbus.h>
 
 #include <security/pam_appl.h>
 #include <security/pam_modules.h>
 
 #include "util/util.h"
 #include "confdb/confdb.h"
-#include "sbus/sssd_dbus.h"
+#include "util/child_common.h"
 #include "providers/proxy/proxy.h"
-#include "providers/proxy/proxy_iface_generated.h"
 
 #include "providers/backend.h"
 
@@ -54,10 +53,11 @@ struct pc_ctx {
     struct sss_domain_info *domain;
     const char *identity;
     const char *conf_path;
-    struct sbus_connection *mon_conn;
-    struct sbus_connection *conn;
     const char *pam_target;
-    uint32_t id;
+
+    /* connection to the back end */
+    int fd;
+    struct tevent_fd *fde;
 };
 
 static int proxy_internal_conv(int num_msg, const struct pam_message **msgm,
@@ -298,41 +298,85 @@ fail:
     return ret;
 }
 
-static int pc_pam_handler(struct sbus_request *dbus_req, void *user_data)
+static errno_t pc_read_request(TALLOC_CTX *mem_ctx, int fd,
+                               uint8_t **_data, size_t *_size)
 {
-    DBusError dbus_error;
-    DBusMessage *reply;
-    struct pc_ctx *pc_ctx;
+    uint8_t hdr[sizeof(uint32_t)];
+    uint8_t *data;
+    uint32_t len;
+    ssize_t n;
     errno_t ret;
-    struct pam_data *pd = NULL;
 
-    pc_ctx = talloc_get_type(user_data, struct pc_ctx);
-    if (!pc_ctx) {
-        ret = EINVAL;
-        goto done;
+    n = sss_atomic_read_s(fd, hdr, sizeof(hdr));
+    if (n == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, "read failed [%d]: %s\n",
+              ret, sss_strerror(ret));
+        return ret;
+    } else if (n == 0) {
+        /* the back end closed the connection */
+        return ENOENT;
+    } else if (n != sizeof(hdr)) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Truncated request\n");
+        return EIO;
     }
 
-    reply = dbus_message_new_method_return(dbus_req->message);
-    if (!reply) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "dbus_message_new_method_return failed, "
-                  "cannot send reply.\n");
-        ret = ENOMEM;
-        goto done;
+    SAFEALIGN_COPY_UINT32(&len, hdr, NULL);
+    if (len > PROXY_CHILD_MAX_FRAME) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Request is too large [%u]\n", len);
+        return EMSGSIZE;
+    }
+
+    data = talloc_size(mem_ctx, len == 0 ? 1 : len);
+    if (data == NULL) {
+        return ENOMEM;
+    }
+
+    n = sss_atomic_read_s(fd, data, len);
+    if (n != (ssize_t) len) {
+        ret = n == -1 ? errno : EIO;
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to read request [%d]: %s\n",
+              ret, sss_strerror(ret));
+        talloc_free(data);
+        return ret;
+    }
+
+    *_data = data;
+    *_size = len;
+    return EOK;
+}
+
+static errno_t pc_handle_request(struct pc_ctx *pc_ctx)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct io_buffer *buf;
+    struct pam_data *pd;
+    uint8_t *data = NULL;
+    size_t size = 0;
+    ssize_t n;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
     }
 
-    dbus_error_init(&dbus_error);
+    ret = pc_read_request(tmp_ctx, pc_ctx->fd, &data, &size);
+    if (ret != EOK) {
+        goto done;
+    }
 
-    ret = dp_unpack_pam_request(dbus_req->message, pc_ctx, &pd, &dbus_error);
-    if (!ret) {
-        DEBUG(SSSDBG_CRIT_FAILURE,"Failed, to parse message!\n");
-        ret = EIO;
+    ret = proxy_child_unpack_request(tmp_ctx, data, size, &pd);
+    safezero(data, size);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to parse request!\n");
         goto done;
     }
 
     pd->pam_status = PAM_SYSTEM_ERR;
+    talloc_free(pd->domain);
     pd->domain = talloc_strdup(pd, pc_ctx->domain->name);
     if (pd->domain == NULL) {
-        talloc_free(pd);
         ret = ENOMEM;
         goto done;
     }
@@ -348,123 +392,63 @@ static int pc_pam_handler(struct sbus_request *dbus_req, void *user_data)
     DEBUG(SSSDBG_CONF_SETTINGS, "Sending result [%d][%s]\n",
               pd->pam_status, pd->domain);
 
-    ret = dp_pack_pam_response(reply, pd);
-    if (!ret) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to generate dbus reply\n");
-        talloc_free(pd);
-        dbus_message_unref(reply);
-        ret = EIO;
-        goto done;
-    }
-
-    ret = sbus_request_finish(dbus_req, reply);
-    dbus_message_unref(reply);
-    talloc_free(pd);
-
-    /* We'll return the message and let the
-     * parent process kill us.
-     */
-    return ret;
-
-done:
-    exit(ret);
-}
-
-static void proxy_child_id_callback(DBusPendingCall *pending, void *ptr)
-{
-    DBusMessage *reply;
-    errno_t ret;
-
-    reply = dbus_pending_call_steal_reply(pending);
-    if (reply == NULL) {
-        /* reply should never be null. This function shouldn't be called
-         * until reply is valid or timeout has occurred. If reply is NULL
-         * here, something is seriously wrong and we should bail out.
-         */
-        DEBUG(SSSDBG_FATAL_FAILURE, "Severe error. A reply callback was "
-              "called but no reply was received and no timeout occurred\n");
+    ret = proxy_child_pack_response(tmp_ctx, pd, &buf);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to generate reply\n");
         goto done;
     }
 
-    ret = sbus_parse_reply(reply);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to get ID ack [%d]: %s\n",
+    n = sss_atomic_write_s(pc_ctx->fd, buf->data, buf->size);
+    if (n != (ssize_t) buf->size) {
+        ret = n == -1 ? errno : EIO;
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to send reply [%d]: %s\n",
               ret, sss_strerror(ret));
+        goto done;
     }
 
-    DEBUG(SSSDBG_TRACE_FUNC, "Got id ack from proxy child\n");
+    ret = EOK;
 
 done:
-    dbus_pending_call_unref(pending);
-    dbus_message_unref(reply);
+    talloc_free(tmp_ctx);
+    return ret;
 }
 
-static errno_t proxy_child_send_id(struct sbus_connection *conn, uint32_t id)
+static void pc_fd_handler(struct tevent_context *ev,
+                          struct tevent_fd *fde,
+                          uint16_t flags,
+                          void *pvt)
 {
-    DBusMessage *msg;
+    struct pc_ctx *pc_ctx = talloc_get_type(pvt, struct pc_ctx);
     errno_t ret;
 
-    msg = sbus_create_message(NULL, NULL, PROXY_CHILD_PATH, IFACE_PROXY_CLIENT,
-                              IFACE_PROXY_CLIENT_REGISTER,
-                              DBUS_TYPE_UINT32, &id);
-    if (msg == NULL) {
-        DEBUG(SSSDBG_FATAL_FAILURE, "Out of memory?!\n");
-        return ENOMEM;
+    ret = pc_handle_request(pc_ctx);
+    if (ret == ENOENT) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Back end closed the connection, exiting\n");
+        exit(0);
+    } else if (ret != EOK) {
+        /* The back end cannot tell where the next message starts */
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Failed to handle request [%d]: %s, exiting\n",
+              ret, sss_strerror(ret));
+        exit(ret);
     }
-
-    DEBUG(SSSDBG_TRACE_FUNC, "Sending ID to Proxy Backend: (%"PRIu32")\n", id);
-
-    ret = sbus_conn_send(conn, msg, 30000, proxy_child_id_callback, NULL, NULL);
-
-    dbus_message_unref(msg);
-
-    return ret;
 }
 
-static int proxy_cli_init(struct pc_ctx *ctx)
+static errno_t proxy_cli_init(struct pc_ctx *ctx)
 {
-    char *sbus_address;
-    int ret;
-
-    static struct iface_proxy_auth iface_proxy_auth = {
-        { &iface_proxy_auth_meta, 0 },
-
-        .PAM = pc_pam_handler,
-    };
-
-    sbus_address = talloc_asprintf(ctx, "unix:path=%s/%s_%s",
-                                   PIPE_PATH, PROXY_CHILD_PIPE,
-                                   ctx->domain->name);
-    if (sbus_address == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "talloc_asprintf failed.\n");
+    ctx->fde = tevent_add_fd(ctx->ev, ctx, ctx->fd, TEVENT_FD_READ,
+                             pc_fd_handler, ctx);
+    if (ctx->fde == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_add_fd failed.\n");
         return ENOMEM;
     }
 
-    ret = sbus_client_init(ctx, ctx->ev, sbus_address, NULL, &ctx->conn);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "sbus_client_init failed.\n");
-        return ret;
-    }
-
-    ret = sbus_conn_register_iface(ctx->conn, &iface_proxy_auth.vtable,
-                                   PROXY_CHILD_PATH, ctx);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_FATAL_FAILURE, "Failed to export proxy.\n");
-        return ret;
-    }
-
-    ret = proxy_child_send_id(ctx->conn, ctx->id);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_FATAL_FAILURE, "dp_common_send_id failed.\n");
-        return ret;
-    }
-
     return EOK;
 }
 
 int proxy_child_process_init(TALLOC_CTX *mem_ctx, const char *domain,
                              struct tevent_context *ev, struct confdb_ctx *cdb,
-                             const char *pam_target, uint32_t id)
+                             const char *pam_target, int fd)
 {
     struct pc_ctx *ctx;
     int ret;
@@ -477,7 +461,7 @@ int proxy_child_process_init(TALLOC_CTX *mem_ctx, const char *domain,
     ctx->ev = ev;
     ctx->cdb = cdb;
     ctx->pam_target = talloc_steal(ctx, pam_target);
-    ctx->id = id;
+    ctx->fd = fd;
     ctx->conf_path = talloc_asprintf(ctx, CONFDB_DOMAIN_PATH_TMPL, domain);
     if (!ctx->conf_path) {
         DEBUG(SSSDBG_FATAL_FAILURE, "Out of memory!?\n");
@@ -493,7 +477,8 @@ int proxy_child_process_init(TALLOC_CTX *mem_ctx, const char *domain,
 
     ret = proxy_cli_init(ctx);
     if (ret != EOK) {
-        DEBUG(SSSDBG_FATAL_FAILURE, "fatal error setting up server bus\n");
+        DEBUG(SSSDBG_FATAL_FAILURE,
+              "fatal error setting up the connection to the back end\n");
         return ret;
     }
 
@@ -509,7 +494,7 @@ int main(int argc, const char *argv[])
     char *conf_entry = NULL;
     struct main_context *main_ctx;
     int ret;
-    long id;
+    int fd;
     char *pam_target = NULL;
     uid_t uid;
     gid_t gid;
@@ -520,8 +505,6 @@ int main(int argc, const char *argv[])
         SSSD_SERVER_OPTS(uid, gid)
         {"domain", 0, POPT_ARG_STRING, &domain, 0,
          _("Domain of the information provider (mandatory)"), NULL },
-        {"id", 0, POPT_ARG_LONG, &id, 0,
-         _("Child identifier (mandatory)"), NULL },
         POPT_TABLEEND
     };
 
@@ -546,15 +529,23 @@ int main(int argc, const char *argv[])
             return 1;
     }
 
-    if (id == 0) {
-        fprintf(stderr, "\nMissing option, "
-                        "--id is a mandatory option.\n\n");
-            poptPrintUsage(pc, stderr, 0);
-            return 1;
-    }
-
     poptFreeContext(pc);
 
+    /* The back end talks to us through the socket it passed as stdin. Move
+     * it out of the way so that neither server_setup() nor a PAM module
+     * reading from stdin gets hold of it. */
+    fd = dup(STDIN_FILENO);
+    if (fd == -1) {
+        fprintf(stderr, "\nCannot duplicate the connection to the back end\n");
+        return 2;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    ret = open("/dev/null", O_RDONLY);
+    if (ret != -1 && ret != STDIN_FILENO) {
+        dup2(ret, STDIN_FILENO);
+        close(ret);
+    }
+
     DEBUG_INIT(debug_level);
 
     /* set up things like debug , signals, daemonization, etc... */
@@ -599,8 +590,7 @@ int main(int argc, const char *argv[])
     }
 
     ret = proxy_child_process_init(main_ctx, domain, main_ctx->event_ctx,
-                                   main_ctx->confdb_ctx, pam_target,
-                                   (uint32_t)id);
+                                   main_ctx->confdb_ctx, pam_target, fd);
     if (ret != EOK) {
         DEBUG(SSSDBG_FATAL_FAILURE,
               "Could not initialize proxy child [%d].\n", ret);
@@ -0,0 +1,383 @@
+/*
+    SSSD
+
+    proxy_child_proto.c - messages exchanged with the proxy_child process
+
+    Copyright (C) 2017 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "util/util.h"
+#include "util/child_common.h"
+#include "providers/proxy/proxy.h"
+
+/*
+ * Every message is a frame that starts with the length of the payload as
+ * uint32_t. Both ends run on the same host so the host byte order is used.
+ *
+ * Request:  int32 cmd, string user, string domain, string service,
+ *           string tty, string ruser, string rhost, authtok authtok,
+ *           authtok newauthtok, int32 priv, uint32 cli_pid
+ *
+ * Response: uint32 pam_status, uint32 account_locked, uint32 num_resp,
+ *           num_resp * (uint32 type, blob data)
+ *
+ * A string or a blob is its length as uint32_t followed by the data, a
+ * string is not NULL terminated. An authtok is its type as uint32_t
+ * followed by a blob.
+ */
+
+static size_t proxy_child_str_size(const char *str)
+{
+    return sizeof(uint32_t) + (str == NULL ? 0 : strlen(str));
+}
+
+static void proxy_child_pack_blob(uint8_t *data, size_t *rp,
+                                  const uint8_t *blob, size_t len)
+{
+    SAFEALIGN_SET_UINT32(&data[*rp], len, rp);
+    if (len > 0) {
+        safealign_memcpy(&data[*rp], blob, len, rp);
+    }
+}
+
+static void proxy_child_pack_str(uint8_t *data, size_t *rp, const char *str)
+{
+    proxy_child_pack_blob(data, rp, (const uint8_t *) str,
+                          str == NULL ? 0 : strlen(str));
+}
+
+static void proxy_child_pack_authtok(uint8_t *data, size_t *rp,
+                                     struct sss_auth_token *tok)
+{
+    SAFEALIGN_SET_UINT32(&data[*rp], sss_authtok_get_type(tok), rp);
+    proxy_child_pack_blob(data, rp, sss_authtok_get_data(tok),
+                          sss_authtok_get_size(tok));
+}
+
+static errno_t proxy_child_unpack_blob(uint8_t *data, size_t size, size_t *rp,
+                                       uint8_t **_blob, uint32_t *_len)
+{
+    uint32_t len;
+
+    SAFEALIGN_COPY_UINT32_CHECK(&len, &data[*rp], size, rp);
+    if (len > size - *rp) {
+        return EINVAL;
+    }
+
+    *_blob = &data[*rp];
+    *_len = len;
+    *rp += len;
+
+    return EOK;
+}
+
+static errno_t proxy_child_unpack_str(TALLOC_CTX *mem_ctx,
+                                      uint8_t *data, size_t size, size_t *rp,
+                                      char **_str)
+{
+    uint8_t *blob;
+    uint32_t len;
+    errno_t ret;
+
+    ret = proxy_child_unpack_blob(data, size, rp, &blob, &len);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    *_str = talloc_strndup(mem_ctx, (const char *) blob, len);
+    if (*_str == NULL) {
+        return ENOMEM;
+    }
+
+    return EOK;
+}
+
+static errno_t proxy_child_unpack_authtok(uint8_t *data, size_t size,
+                                          size_t *rp,
+                                          struct sss_auth_token *tok)
+{
+    uint32_t type;
+    uint8_t *blob;
+    uint32_t len;
+    errno_t ret;
+
+    SAFEALIGN_COPY_UINT32_CHECK(&type, &data[*rp], size, rp);
+
+    ret = proxy_child_unpack_blob(data, size, rp, &blob, &len);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    return sss_authtok_set(tok, type, blob, len);
+}
+
+static errno_t proxy_child_frame_new(TALLOC_CTX *mem_ctx,
+                                     size_t payload_size,
+                                     struct io_buffer **_buf,
+                                     size_t *_rp)
+{
+    struct io_buffer *buf;
+    size_t rp = 0;
+
+    if (payload_size > PROXY_CHILD_MAX_FRAME) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Message is too large [%zu]\n",
+              payload_size);
+        return EMSGSIZE;
+    }
+
+    buf = talloc(mem_ctx, struct io_buffer);
+    if (buf == NULL) {
+        return ENOMEM;
+    }
+
+    buf->size = sizeof(uint32_t) + payload_size;
+    buf->data = talloc_size(buf, buf->size);
+    if (buf->data == NULL) {
+        talloc_free(buf);
+        return ENOMEM;
+    }
+
+    SAFEALIGN_SET_UINT32(&buf->data[rp], payload_size, &rp);
+
+    *_buf = buf;
+    *_rp = rp;
+    return EOK;
+}
+
+errno_t proxy_child_pack_request(TALLOC_CTX *mem_ctx,
+                                 struct pam_data *pd,
+                                 struct io_buffer **_buf)
+{
+    struct io_buffer *buf;
+    size_t size;
+    size_t rp;
+    errno_t ret;
+
+    if (pd->user == NULL) {
+        return EINVAL;
+    }
+
+    size = 2 * sizeof(int32_t) + sizeof(uint32_t)
+           + proxy_child_str_size(pd->user)
+           + proxy_child_str_size(pd->domain)
+           + proxy_child_str_size(pd->service)
+           + proxy_child_str_size(pd->tty)
+           + proxy_child_str_size(pd->ruser)
+           + proxy_child_str_size(pd->rhost)
+           + 2 * sizeof(uint32_t) + sss_authtok_get_size(pd->authtok)
+           + 2 * sizeof(uint32_t) + sss_authtok_get_size(pd->newauthtok);
+
+    ret = proxy_child_frame_new(mem_ctx, size, &buf, &rp);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    SAFEALIGN_SET_INT32(&buf->data[rp], pd->cmd, &rp);
+    proxy_child_pack_str(buf->data, &rp, pd->user);
+    proxy_child_pack_str(buf->data, &rp, pd->domain);
+    proxy_child_pack_str(buf->data, &rp, pd->service);
+    proxy_child_pack_str(buf->data, &rp, pd->tty);
+    proxy_child_pack_str(buf->data, &rp, pd->ruser);
+    proxy_child_pack_str(buf->data, &rp, pd->rhost);
+    proxy_child_pack_authtok(buf->data, &rp, pd->authtok);
+    proxy_child_pack_authtok(buf->data, &rp, pd->newauthtok);
+    SAFEALIGN_SET_INT32(&buf->data[rp], pd->priv, &rp);
+    SAFEALIGN_SET_UINT32(&buf->data[rp], pd->cli_pid, &rp);
+
+    *_buf = buf;
+    return EOK;
+}
+
+/* The SAFEALIGN_*_CHECK macros return on a truncated message, so the
+ * caller frees pd */
+static errno_t proxy_child_unpack_pd(uint8_t *data,
+                                     size_t size,
+                                     struct pam_data *pd)
+{
+    int32_t cmd;
+    size_t rp = 0;
+    errno_t ret;
+
+    SAFEALIGN_COPY_INT32_CHECK(&cmd, &data[rp], size, &rp);
+    pd->cmd = cmd;
+
+    ret = proxy_child_unpack_str(pd, data, size, &rp, &pd->user);
+    if (ret == EOK) {
+        ret = proxy_child_unpack_str(pd, data, size, &rp, &pd->domain);
+    }
+    if (ret == EOK) {
+        ret = proxy_child_unpack_str(pd, data, size, &rp, &pd->service);
+    }
+    if (ret == EOK) {
+        ret = proxy_child_unpack_str(pd, data, size, &rp, &pd->tty);
+    }
+    if (ret == EOK) {
+        ret = proxy_child_unpack_str(pd, data, size, &rp, &pd->ruser);
+    }
+    if (ret == EOK) {
+        ret = proxy_child_unpack_str(pd, data, size, &rp, &pd->rhost);
+    }
+    if (ret == EOK) {
+        ret = proxy_child_unpack_authtok(data, size, &rp, pd->authtok);
+    }
+    if (ret == EOK) {
+        ret = proxy_child_unpack_authtok(data, size, &rp, pd->newauthtok);
+    }
+    if (ret != EOK) {
+        return ret;
+    }
+
+    SAFEALIGN_COPY_INT32_CHECK(&pd->priv, &data[rp], size, &rp);
+    SAFEALIGN_COPY_UINT32_CHECK(&pd->cli_pid, &data[rp], size, &rp);
+
+    return EOK;
+}
+
+errno_t proxy_child_unpack_request(TALLOC_CTX *mem_ctx,
+                                   uint8_t *data,
+                                   size_t size,
+                                   struct pam_data **_pd)
+{
+    struct pam_data *pd;
+    errno_t ret;
+
+    pd = create_pam_data(mem_ctx);
+    if (pd == NULL) {
+        return ENOMEM;
+    }
+
+    ret = proxy_child_unpack_pd(data, size, pd);
+    if (ret != EOK) {
+        talloc_free(pd);
+        return ret;
+    }
+
+    *_pd = pd;
+    return EOK;
+}
+
+errno_t proxy_child_pack_response(TALLOC_CTX *mem_ctx,
+                                  struct pam_data *pd,
+                                  struct io_buffer **_buf)
+{
+    struct response_data *resp;
+    struct io_buffer *buf;
+    uint32_t num_resp = 0;
+    size_t size;
+    size_t rp;
+    errno_t ret;
+
+    size = 3 * sizeof(uint32_t);
+    for (resp = pd->resp_list; resp != NULL; resp = resp->next) {
+        size += 2 * sizeof(uint32_t) + resp->len;
+        num_resp++;
+    }
+
+    ret = proxy_child_frame_new(mem_ctx, size, &buf, &rp);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    SAFEALIGN_SET_UINT32(&buf->data[rp], pd->pam_status, &rp);
+    SAFEALIGN_SET_UINT32(&buf->data[rp], pd->account_locked, &rp);
+    SAFEALIGN_SET_UINT32(&buf->data[rp], num_resp, &rp);
+    for (resp = pd->resp_list; resp != NULL; resp = resp->next) {
+        SAFEALIGN_SET_UINT32(&buf->data[rp], resp->type, &rp);
+        proxy_child_pack_blob(buf->data, &rp, resp->data, resp->len);
+    }
+
+    *_buf = buf;
+    return EOK;
+}
+
+/* Prepends the responses to pd->resp_list in reverse order */
+static errno_t proxy_child_unpack_resp_list(uint8_t *data,
+                                            size_t size,
+                                            size_t *_rp,
+                                            uint32_t num_resp,
+                                            struct pam_data *pd)
+{
+    uint32_t type;
+    uint8_t *blob;
+    uint32_t len;
+    uint32_t i;
+    size_t rp = *_rp;
+    errno_t ret;
+
+    for (i = 0; i < num_resp; i++) {
+        SAFEALIGN_COPY_UINT32_CHECK(&type, &data[rp], size, &rp);
+
+        ret = proxy_child_unpack_blob(data, size, &rp, &blob, &len);
+        if (ret != EOK) {
+            return ret;
+        }
+
+        ret = pam_add_response(pd, type, len, blob);
+        if (ret != EOK) {
+            return ret;
+        }
+    }
+
+    *_rp = rp;
+    return EOK;
+}
+
+errno_t proxy_child_unpack_response(uint8_t *data,
+                                    size_t size,
+                                    struct pam_data *pd)
+{
+    uint32_t pam_status;
+    uint32_t account_locked;
+    uint32_t num_resp;
+    struct response_data *old;
+    struct response_data *prev;
+    struct response_data *cur;
+    struct response_data *next;
+    size_t rp = 0;
+    errno_t ret;
+
+    old = pd->resp_list;
+
+    SAFEALIGN_COPY_UINT32_CHECK(&pam_status, &data[rp], size, &rp);
+    SAFEALIGN_COPY_UINT32_CHECK(&account_locked, &data[rp], size, &rp);
+    SAFEALIGN_COPY_UINT32_CHECK(&num_resp, &data[rp], size, &rp);
+
+    ret = proxy_child_unpack_resp_list(data, size, &rp, num_resp, pd);
+    if (ret != EOK) {
+        /* do not pass a partially parsed response on */
+        for (cur = pd->resp_list; cur != old; cur = next) {
+            next = cur->next;
+            talloc_free(cur->data);
+            talloc_free(cur);
+        }
+        pd->resp_list = old;
+        return ret;
+    }
+
+    /* pam_add_response() prepends, restore the order of the child */
+    prev = old;
+    for (cur = pd->resp_list; cur != old; cur = next) {
+        next = cur->next;
+        cur->next = prev;
+        prev = cur;
+    }
+    pd->resp_list = prev;
+
+    pd->pam_status = pam_status;
+    pd->account_locked = account_locked;
+
+    return EOK;
+}
@@ -23,12 +23,429 @@
 */
 
 #include <dhash.h>
+#include <pthread.h>
 #include "config.h"
 
 #include "util/sss_format.h"
 #include "util/strtonum.h"
 #include "providers/proxy/proxy.h"
 
+/* =NSS-calls-in-worker-threads===========================================*/
+
+/* The NSS modules keep the position of an enumeration in a global state */
+static pthread_mutex_t proxy_nss_ent_lock = PTHREAD_MUTEX_INITIALIZER;
+
+enum proxy_nss_call {
+    PROXY_NSS_GETPWNAM,
+    PROXY_NSS_GETPWUID,
+    PROXY_NSS_GETPWENT,
+    PROXY_NSS_GETGRNAM,
+    PROXY_NSS_GETGRGID,
+    PROXY_NSS_GETGRENT,
+    PROXY_NSS_INITGROUPS,
+};
+
+/* The strings of the entry point into buffer */
+struct proxy_nss_entry {
+    struct passwd pwd;
+    struct group grp;
+    char *buffer;
+};
+
+/* The input is only read by the worker thread. The output is allocated
+ * with malloc() by the worker thread and released by the destructor.
+ * Lookups fill in result, enumerations fill in entries. */
+struct proxy_nss_job {
+    struct proxy_nss_ops *ops;
+    enum proxy_nss_call call;
+    const char *name;
+    uint32_t id;
+
+    enum nss_status status;
+    int err;
+    struct proxy_nss_entry result;
+    struct proxy_nss_entry *entries;
+    size_t num_entries;
+    gid_t *gids;
+    long int num_gids;
+};
+
+static int proxy_nss_job_destructor(struct proxy_nss_job *job)
+{
+    size_t i;
+
+    free(job->result.buffer);
+    for (i = 0; i < job->num_entries; i++) {
+        free(job->entries[i].buffer);
+    }
+    free(job->entries);
+    free(job->gids);
+
+    return 0;
+}
+
+static enum nss_status proxy_nss_call_once(struct proxy_nss_job *job,
+                                           struct proxy_nss_entry *entry,
+                                           char *buffer, size_t buflen)
+{
+    struct proxy_nss_ops *ops = job->ops;
+
+    memset(&entry->pwd, 0, sizeof(struct passwd));
+    memset(&entry->grp, 0, sizeof(struct group));
+
+    switch (job->call) {
+    case PROXY_NSS_GETPWNAM:
+        return ops->getpwnam_r(job->name, &entry->pwd, buffer, buflen,
+                               &job->err);
+    case PROXY_NSS_GETPWUID:
+        return ops->getpwuid_r(job->id, &entry->pwd, buffer, buflen,
+                               &job->err);
+    case PROXY_NSS_GETPWENT:
+        return ops->getpwent_r(&entry->pwd, buffer, buflen, &job->err);
+    case PROXY_NSS_GETGRNAM:
+        return ops->getgrnam_r(job->name, &entry->grp, buffer, buflen,
+                               &job->err);
+    case PROXY_NSS_GETGRGID:
+        return ops->getgrgid_r(job->id, &entry->grp, buffer, buflen,
+                               &job->err);
+    case PROXY_NSS_GETGRENT:
+        return ops->getgrent_r(&entry->grp, buffer, buflen, &job->err);
+    case PROXY_NSS_INITGROUPS:
+        break;
+    }
+
+    job->err = EINVAL;
+    return NSS_STATUS_RETURN;
+}
+
+/* Calls the NSS module, the buffer grows while it is too small */
+static enum nss_status proxy_nss_call_buffer(struct proxy_nss_job *job,
+                                             struct proxy_nss_entry *entry,
+                                             char **_buffer,
+                                             size_t *_buflen)
+{
+    enum nss_status status;
+    char *buffer = *_buffer;
+    size_t buflen = *_buflen;
+
+    while (true) {
+        if (buffer == NULL) {
+            buffer = malloc(buflen);
+            if (buffer == NULL) {
+                job->err = ENOMEM;
+                status = NSS_STATUS_TRYAGAIN;
+                break;
+            }
+        }
+
+        status = proxy_nss_call_once(job, entry, buffer, buflen);
+        if (status != NSS_STATUS_TRYAGAIN || buflen >= MAX_BUF_SIZE) {
+            break;
+        }
+
+        /* buffer too small ? */
+        free(buffer);
+        buffer = NULL;
+        buflen *= 2;
+        if (buflen > MAX_BUF_SIZE) {
+            buflen = MAX_BUF_SIZE;
+        }
+    }
+
+    *_buffer = buffer;
+    *_buflen = buflen;
+    return status;
+}
+
+static void proxy_nss_lookup(struct proxy_nss_job *job)
+{
+    size_t buflen = DEFAULT_BUFSIZE;
+    char *buffer = NULL;
+
+    job->status = proxy_nss_call_buffer(job, &job->result, &buffer, &buflen);
+    job->result.buffer = buffer;
+}
+
+static size_t proxy_nss_strsize(const char *str)
+{
+    return str == NULL ? 0 : strlen(str) + 1;
+}
+
+static char *proxy_nss_strcopy(char **_pos, const char *str)
+{
+    char *copy = *_pos;
+    size_t len;
+
+    if (str == NULL) {
+        return NULL;
+    }
+
+    len = strlen(str) + 1;
+    memcpy(copy, str, len);
+    *_pos += len;
+
+    return copy;
+}
+
+/* Copies the entry into a buffer of the size it really needs */
+static errno_t proxy_nss_copy_pwd(struct proxy_nss_entry *dst,
+                                  const struct passwd *src)
+{
+    size_t size;
+    char *pos;
+
+    size = proxy_nss_strsize(src->pw_name)
+           + proxy_nss_strsize(src->pw_passwd)
+           + proxy_nss_strsize(src->pw_gecos)
+           + proxy_nss_strsize(src->pw_dir)
+           + proxy_nss_strsize(src->pw_shell);
+
+    dst->buffer = malloc(size + 1);
+    if (dst->buffer == NULL) {
+        return ENOMEM;
+    }
+    pos = dst->buffer;
+
+    dst->pwd = *src;
+    dst->pwd.pw_name = proxy_nss_strcopy(&pos, src->pw_name);
+    dst->pwd.pw_passwd = proxy_nss_strcopy(&pos, src->pw_passwd);
+    dst->pwd.pw_gecos = proxy_nss_strcopy(&pos, src->pw_gecos);
+    dst->pwd.pw_dir = proxy_nss_strcopy(&pos, src->pw_dir);
+    dst->pwd.pw_shell = proxy_nss_strcopy(&pos, src->pw_shell);
+
+    return EOK;
+}
+
+static errno_t proxy_nss_copy_grp(struct proxy_nss_entry *dst,
+                                  const struct group *src)
+{
+    size_t num_members = 0;
+    size_t size;
+    size_t i;
+    char **members;
+    char *pos;
+
+    size = proxy_nss_strsize(src->gr_name) + proxy_nss_strsize(src->gr_passwd);
+    if (src->gr_mem != NULL) {
+        for (; src->gr_mem[num_members] != NULL; num_members++) {
+            size += proxy_nss_strsize(src->gr_mem[num_members]);
+        }
+    }
+
+    /* The member array goes first to keep it aligned */
+    dst->buffer = malloc((num_members + 1) * sizeof(char *) + size);
+    if (dst->buffer == NULL) {
+        return ENOMEM;
+    }
+    members = (char **) dst->buffer;
+    pos = dst->buffer + (num_members + 1) * sizeof(char *);
+
+    dst->grp = *src;
+    dst->grp.gr_name = proxy_nss_strcopy(&pos, src->gr_name);
+    dst->grp.gr_passwd = proxy_nss_strcopy(&pos, src->gr_passwd);
+    for (i = 0; i < num_members; i++) {
+        members[i] = proxy_nss_strcopy(&pos, src->gr_mem[i]);
+    }
+    members[num_members] = NULL;
+    dst->grp.gr_mem = members;
+
+    return EOK;
+}
+
+static void proxy_nss_enumerate(struct proxy_nss_job *job)
+{
+    struct proxy_nss_entry *entries;
+    struct proxy_nss_entry entry;
+    size_t allocated = 0;
+    size_t buflen = DEFAULT_BUFSIZE;
+    char *buffer = NULL;
+    bool users = (job->call == PROXY_NSS_GETPWENT);
+    errno_t ret;
+
+    pthread_mutex_lock(&proxy_nss_ent_lock);
+
+    job->status = users ? job->ops->setpwent() : job->ops->setgrent();
+    if (job->status != NSS_STATUS_SUCCESS) {
+        goto done;
+    }
+
+    while (true) {
+        job->status = proxy_nss_call_buffer(job, &entry, &buffer, &buflen);
+        if (job->status != NSS_STATUS_SUCCESS) {
+            break;
+        }
+
+        if (job->num_entries == allocated) {
+            allocated = allocated == 0 ? 64 : allocated * 2;
+            entries = realloc(job->entries,
+                              allocated * sizeof(struct proxy_nss_entry));
+            if (entries == NULL) {
+                job->err = ENOMEM;
+                job->status = NSS_STATUS_TRYAGAIN;
+                break;
+            }
+            job->entries = entries;
+        }
+
+        /* The buffer is reused for the next entry */
+        if (users) {
+            ret = proxy_nss_copy_pwd(&job->entries[job->num_entries],
+                                     &entry.pwd);
+        } else {
+            ret = proxy_nss_copy_grp(&job->entries[job->num_entries],
+                                     &entry.grp);
+        }
+        if (ret != EOK) {
+            job->err = ret;
+            job->status = NSS_STATUS_TRYAGAIN;
+            break;
+        }
+        job->num_entries++;
+    }
+
+done:
+    if (users) {
+        job->ops->endpwent();
+    } else {
+        job->ops->endgrent();
+    }
+
+    pthread_mutex_unlock(&proxy_nss_ent_lock);
+
+    free(buffer);
+}
+
+static void proxy_nss_initgroups(struct proxy_nss_job *job)
+{
+    long int limit;
+    long int size;
+    long int num;
+    gid_t *gids;
+
+    limit = 4096;
+    num = 4096;
+    size = num*sizeof(gid_t);
+    job->gids = malloc(size);
+    if (job->gids == NULL) {
+        job->err = ENOMEM;
+        job->status = NSS_STATUS_TRYAGAIN;
+        return;
+    }
+
+    /* nss modules may skip the primary group when we pass it in so always add
+     * it in advance */
+    job->gids[0] = job->id;
+    job->num_gids = 1;
+
+    do {
+        job->status = job->ops->initgroups_dyn(job->name, job->id,
+                                               &job->num_gids, &num,
+                                               &job->gids, limit, &job->err);
+
+        if (job->status == NSS_STATUS_TRYAGAIN) {
+            /* buffer too small ? */
+            if (size >= MAX_BUF_SIZE) {
+                break;
+            }
+            num *= 2;
+            size = num*sizeof(gid_t);
+            if (size > MAX_BUF_SIZE) {
+                size = MAX_BUF_SIZE;
+                num = size/sizeof(gid_t);
+            }
+            limit = num;
+            gids = realloc(job->gids, size);
+            if (gids == NULL) {
+                job->err = ENOMEM;
+                break;
+            }
+            job->gids = gids;
+        }
+    } while (job->status == NSS_STATUS_TRYAGAIN);
+}
+
+/* Runs in a worker thread */
+static void proxy_nss_job_run(void *pvt)
+{
+    struct proxy_nss_job *job = pvt;
+
+    switch (job->call) {
+    case PROXY_NSS_GETPWNAM:
+    case PROXY_NSS_GETPWUID:
+    case PROXY_NSS_GETGRNAM:
+    case PROXY_NSS_GETGRGID:
+        proxy_nss_lookup(job);
+        break;
+    case PROXY_NSS_GETPWENT:
+    case PROXY_NSS_GETGRENT:
+        proxy_nss_enumerate(job);
+        break;
+    case PROXY_NSS_INITGROUPS:
+        proxy_nss_initgroups(job);
+        break;
+    }
+}
+
+static struct tevent_req *proxy_nss_send(TALLOC_CTX *mem_ctx,
+                                         struct proxy_id_ctx *ctx,
+                                         enum proxy_nss_call call,
+                                         const char *name,
+                                         uint32_t id)
+{
+    struct proxy_nss_job *job;
+    struct tevent_req *req;
+
+    job = talloc_zero(mem_ctx, struct proxy_nss_job);
+    if (job == NULL) {
+        return NULL;
+    }
+
+    job->ops = &ctx->ops;
+    job->call = call;
+    job->id = id;
+    if (name != NULL) {
+        job->name = talloc_strdup(job, name);
+        if (job->name == NULL) {
+            talloc_free(job);
+            return NULL;
+        }
+    }
+    talloc_set_destructor(job, proxy_nss_job_destructor);
+
+    req = proxy_thread_job_send(mem_ctx, ctx->be->ev, ctx->threads,
+                                proxy_nss_job_run, job);
+    if (req == NULL) {
+        talloc_free(job);
+        return NULL;
+    }
+
+    return req;
+}
+
+static errno_t proxy_nss_recv(TALLOC_CTX *mem_ctx,
+                              struct tevent_req *req,
+                              struct proxy_nss_job **_job)
+{
+    void *pvt;
+    errno_t ret;
+
+    ret = proxy_thread_job_recv(mem_ctx, req, &pvt);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    *_job = talloc_get_type(pvt, struct proxy_nss_job);
+    return EOK;
+}
+
+/* All lookups below only report an error code */
+static errno_t proxy_id_op_recv(struct tevent_req *req)
+{
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    return EOK;
+}
+
 /* =Getpwnam-wrapper======================================================*/
 
 static int save_user(struct sss_domain_info *domain,
@@ -43,51 +460,128 @@ static int
 delete_user(struct sss_domain_info *domain,
             const char *name, uid_t uid);
 
-static int get_pw_name(struct proxy_id_ctx *ctx,
-                       struct sss_domain_info *dom,
-                       const char *i_name)
-{
-    TALLOC_CTX *tmpctx;
-    struct passwd *pwd;
-    enum nss_status status;
-    char *buffer;
-    size_t buflen;
-    int ret;
+struct get_pw_name_state {
+    struct proxy_id_ctx *ctx;
+    struct sss_domain_info *dom;
+    const char *i_name;
     uid_t uid;
-    bool del_user;
-    struct ldb_result *cached_pwd = NULL;
-    const char *real_name = NULL;
+
+    /* NULL if the user was deleted */
+    const char *name;
+    gid_t gid;
+};
+
+static void get_pw_name_getpwnam_done(struct tevent_req *subreq);
+static void get_pw_name_getpwuid_done(struct tevent_req *subreq);
+
+static struct tevent_req *get_pw_name_send(TALLOC_CTX *mem_ctx,
+                                           struct proxy_id_ctx *ctx,
+                                           struct sss_domain_info *dom,
+                                           const char *i_name)
+{
+    struct get_pw_name_state *state;
+    struct tevent_req *subreq;
+    struct tevent_req *req;
     char *shortname_or_alias;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct get_pw_name_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    state->ctx = ctx;
+    state->dom = dom;
 
     DEBUG(SSSDBG_TRACE_FUNC, "Searching user by name (%s)\n", i_name);
 
-    tmpctx = talloc_new(NULL);
-    if (!tmpctx) {
-        return ENOMEM;
+    state->i_name = talloc_strdup(state, i_name);
+    if (state->i_name == NULL) {
+        ret = ENOMEM;
+        goto immediately;
     }
 
-    ret = sss_parse_internal_fqname(tmpctx, i_name, &shortname_or_alias, NULL);
+    ret = sss_parse_internal_fqname(state, i_name, &shortname_or_alias, NULL);
     if (ret != EOK) {
-        goto done;
+        goto immediately;
     }
 
-    pwd = talloc_zero(tmpctx, struct passwd);
-    if (!pwd) {
+    subreq = proxy_nss_send(state, ctx, PROXY_NSS_GETPWNAM,
+                            shortname_or_alias, 0);
+    if (subreq == NULL) {
         ret = ENOMEM;
-        goto done;
+        goto immediately;
     }
 
-    buflen = DEFAULT_BUFSIZE;
-    buffer = talloc_size(tmpctx, buflen);
-    if (!buffer) {
-        ret = ENOMEM;
+    tevent_req_set_callback(subreq, get_pw_name_getpwnam_done, req);
+
+    return req;
+
+immediately:
+    tevent_req_error(req, ret);
+    tevent_req_post(req, ctx->be->ev);
+    return req;
+}
+
+static errno_t get_pw_name_save(struct get_pw_name_state *state,
+                                struct passwd *pwd,
+                                const char *real_name)
+{
+    errno_t ret;
+
+    /* Both lookups went fine, we can save the user now */
+    ret = save_user(state->dom, pwd, real_name, state->i_name);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    state->name = talloc_strdup(state, pwd->pw_name);
+    if (state->name == NULL) {
+        return ENOMEM;
+    }
+    state->gid = pwd->pw_gid;
+
+    return EOK;
+}
+
+static void get_pw_name_done(struct tevent_req *req, errno_t ret)
+{
+    struct get_pw_name_state *state;
+
+    state = tevent_req_data(req, struct get_pw_name_state);
+
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "proxy -> getpwnam_r failed for '%s' <%d>: %s\n",
+               state->i_name, ret, strerror(ret));
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
+static void get_pw_name_getpwnam_done(struct tevent_req *subreq)
+{
+    struct get_pw_name_state *state;
+    struct tevent_req *req;
+    struct proxy_nss_job *job = NULL;
+    struct ldb_result *cached_pwd = NULL;
+    const char *real_name = NULL;
+    bool del_user;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct get_pw_name_state);
+
+    ret = proxy_nss_recv(state, subreq, &job);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
         goto done;
     }
 
-    /* FIXME: should we move this call outside the transaction to keep the
-     * transaction as short as possible ? */
-    status = ctx->ops.getpwnam_r(shortname_or_alias, pwd, buffer, buflen, &ret);
-    ret = handle_getpw_result(status, pwd, dom, &del_user);
+    ret = handle_getpw_result(job->status, &job->result.pwd, state->dom,
+                              &del_user);
     if (ret) {
         DEBUG(SSSDBG_OP_FAILURE,
               "getpwnam failed [%d]: %s\n", ret, strerror(ret));
@@ -95,16 +589,16 @@ static int get_pw_name(struct proxy_id_ctx *ctx,
     }
 
     if (del_user) {
-        ret = delete_user(dom, i_name, 0);
+        ret = delete_user(state->dom, state->i_name, 0);
         goto done;
     }
 
-    uid = pwd->pw_uid;
+    state->uid = job->result.pwd.pw_uid;
 
     /* Canonicalize the username in case it was actually an alias */
 
-    if (ctx->fast_alias == true) {
-        ret = sysdb_getpwuid(tmpctx, dom, uid, &cached_pwd);
+    if (state->ctx->fast_alias == true) {
+        ret = sysdb_getpwuid(job, state->dom, state->uid, &cached_pwd);
         if (ret != EOK) {
             /* Non-fatal, attempt to canonicalize online */
             DEBUG(SSSDBG_TRACE_FUNC, "Request to cache failed [%d]: %s\n",
@@ -121,39 +615,87 @@ static int get_pw_name(struct proxy_id_ctx *ctx,
     }
 
     if (real_name == NULL) {
-        memset(buffer, 0, buflen);
-
-        status = ctx->ops.getpwuid_r(uid, pwd, buffer, buflen, &ret);
-        ret = handle_getpw_result(status, pwd, dom, &del_user);
-        if (ret) {
-            DEBUG(SSSDBG_OP_FAILURE,
-                "getpwuid failed [%d]: %s\n", ret, strerror(ret));
-            goto done;
-        }
-
-        real_name = sss_create_internal_fqname(tmpctx, pwd->pw_name, dom->name);
-        if (real_name == NULL) {
+        subreq = proxy_nss_send(state, state->ctx, PROXY_NSS_GETPWUID,
+                                NULL, state->uid);
+        if (subreq == NULL) {
             ret = ENOMEM;
             goto done;
         }
-    }
 
-    if (del_user) {
-        ret = delete_user(dom, i_name, uid);
-        goto done;
+        tevent_req_set_callback(subreq, get_pw_name_getpwuid_done, req);
+        talloc_free(job);
+        return;
     }
 
-    /* Both lookups went fine, we can save the user now */
-    ret = save_user(dom, pwd, real_name, i_name);
+    ret = get_pw_name_save(state, &job->result.pwd, real_name);
 
 done:
-    talloc_zfree(tmpctx);
+    talloc_free(job);
+    get_pw_name_done(req, ret);
+}
+
+static void get_pw_name_getpwuid_done(struct tevent_req *subreq)
+{
+    struct get_pw_name_state *state;
+    struct tevent_req *req;
+    struct proxy_nss_job *job = NULL;
+    const char *real_name;
+    bool del_user;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct get_pw_name_state);
+
+    ret = proxy_nss_recv(state, subreq, &job);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = handle_getpw_result(job->status, &job->result.pwd, state->dom,
+                              &del_user);
     if (ret) {
         DEBUG(SSSDBG_OP_FAILURE,
-              "proxy -> getpwnam_r failed for '%s' <%d>: %s\n",
-               i_name, ret, strerror(ret));
+            "getpwuid failed [%d]: %s\n", ret, strerror(ret));
+        goto done;
     }
-    return ret;
+
+    if (del_user) {
+        ret = delete_user(state->dom, state->i_name, state->uid);
+        goto done;
+    }
+
+    real_name = sss_create_internal_fqname(job, job->result.pwd.pw_name,
+                                           state->dom->name);
+    if (real_name == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = get_pw_name_save(state, &job->result.pwd, real_name);
+
+done:
+    talloc_free(job);
+    get_pw_name_done(req, ret);
+}
+
+/* The name is the one the NSS module uses, _name is NULL if the user
+ * was deleted from the cache */
+static errno_t get_pw_name_recv(TALLOC_CTX *mem_ctx,
+                                struct tevent_req *req,
+                                const char **_name,
+                                gid_t *_gid)
+{
+    struct get_pw_name_state *state;
+
+    state = tevent_req_data(req, struct get_pw_name_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    *_name = talloc_steal(mem_ctx, state->name);
+    *_gid = state->gid;
+
+    return EOK;
 }
 
 static int
@@ -338,41 +880,65 @@ done:
 
 /* =Getpwuid-wrapper======================================================*/
 
-static int get_pw_uid(struct proxy_id_ctx *ctx,
-                      struct sss_domain_info *dom,
-                      uid_t uid)
+struct get_pw_uid_state {
+    struct sss_domain_info *dom;
+    uid_t uid;
+};
+
+static void get_pw_uid_done(struct tevent_req *subreq);
+
+static struct tevent_req *get_pw_uid_send(TALLOC_CTX *mem_ctx,
+                                          struct proxy_id_ctx *ctx,
+                                          struct sss_domain_info *dom,
+                                          uid_t uid)
 {
-    TALLOC_CTX *tmpctx;
-    struct passwd *pwd;
-    enum nss_status status;
-    char *buffer;
-    size_t buflen;
-    bool del_user = false;
-    int ret;
-    char *name;
+    struct get_pw_uid_state *state;
+    struct tevent_req *subreq;
+    struct tevent_req *req;
+
+    req = tevent_req_create(mem_ctx, &state, struct get_pw_uid_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    state->dom = dom;
+    state->uid = uid;
 
     DEBUG(SSSDBG_TRACE_FUNC, "Searching user by uid (%"SPRIuid")\n", uid);
 
-    tmpctx = talloc_new(NULL);
-    if (!tmpctx) {
-        return ENOMEM;
+    subreq = proxy_nss_send(state, ctx, PROXY_NSS_GETPWUID, NULL, uid);
+    if (subreq == NULL) {
+        tevent_req_error(req, ENOMEM);
+        tevent_req_post(req, ctx->be->ev);
+        return req;
     }
 
-    pwd = talloc_zero(tmpctx, struct passwd);
-    if (!pwd) {
-        ret = ENOMEM;
-        goto done;
-    }
+    tevent_req_set_callback(subreq, get_pw_uid_done, req);
 
-    buflen = DEFAULT_BUFSIZE;
-    buffer = talloc_size(tmpctx, buflen);
-    if (!buffer) {
-        ret = ENOMEM;
+    return req;
+}
+
+static void get_pw_uid_done(struct tevent_req *subreq)
+{
+    struct get_pw_uid_state *state;
+    struct tevent_req *req;
+    struct proxy_nss_job *job = NULL;
+    struct passwd *pwd;
+    bool del_user = false;
+    char *name;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct get_pw_uid_state);
+
+    ret = proxy_nss_recv(state, subreq, &job);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
         goto done;
     }
 
-    status = ctx->ops.getpwuid_r(uid, pwd, buffer, buflen, &ret);
-    ret = handle_getpw_result(status, pwd, dom, &del_user);
+    pwd = &job->result.pwd;
+    ret = handle_getpw_result(job->status, pwd, state->dom, &del_user);
     if (ret) {
         DEBUG(SSSDBG_OP_FAILURE,
               "getpwuid failed [%d]: %s\n", ret, strerror(ret));
@@ -380,179 +946,178 @@ static int get_pw_uid(struct proxy_id_ctx *ctx,
     }
 
     if (del_user) {
-        ret = delete_user(dom, NULL, uid);
+        ret = delete_user(state->dom, NULL, state->uid);
         goto done;
     }
 
-    name = sss_create_internal_fqname(tmpctx, pwd->pw_name, dom->name);
+    name = sss_create_internal_fqname(job, pwd->pw_name, state->dom->name);
     if (name == NULL) {
         DEBUG(SSSDBG_OP_FAILURE, "failed to qualify name '%s'\n",
               pwd->pw_name);
+        ret = ENOMEM;
         goto done;
     }
-    ret = save_user(dom, pwd, name, NULL);
+    ret = save_user(state->dom, pwd, name, NULL);
 
 done:
-    talloc_zfree(tmpctx);
+    talloc_free(job);
     if (ret) {
         DEBUG(SSSDBG_CRIT_FAILURE,
               "proxy -> getpwuid_r failed for '%"SPRIuid"' <%d>: %s\n",
-               uid, ret, strerror(ret));
+               state->uid, ret, strerror(ret));
+        tevent_req_error(req, ret);
+        return;
     }
-    return ret;
+
+    tevent_req_done(req);
 }
 
 /* =Getpwent-wrapper======================================================*/
 
-static int enum_users(TALLOC_CTX *mem_ctx,
-                      struct proxy_id_ctx *ctx,
-                      struct sysdb_ctx *sysdb,
-                      struct sss_domain_info *dom)
+struct enum_users_state {
+    struct sysdb_ctx *sysdb;
+    struct sss_domain_info *dom;
+};
+
+static void enum_users_done(struct tevent_req *subreq);
+
+static struct tevent_req *enum_users_send(TALLOC_CTX *mem_ctx,
+                                          struct proxy_id_ctx *ctx,
+                                          struct sysdb_ctx *sysdb,
+                                          struct sss_domain_info *dom)
 {
-    TALLOC_CTX *tmpctx;
+    struct enum_users_state *state;
+    struct tevent_req *subreq;
+    struct tevent_req *req;
+
+    req = tevent_req_create(mem_ctx, &state, struct enum_users_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    state->sysdb = sysdb;
+    state->dom = dom;
+
+    DEBUG(SSSDBG_TRACE_LIBS, "Enumerating users\n");
+
+    subreq = proxy_nss_send(state, ctx, PROXY_NSS_GETPWENT, NULL, 0);
+    if (subreq == NULL) {
+        tevent_req_error(req, ENOMEM);
+        tevent_req_post(req, ctx->be->ev);
+        return req;
+    }
+
+    tevent_req_set_callback(subreq, enum_users_done, req);
+
+    return req;
+}
+
+static void enum_users_done(struct tevent_req *subreq)
+{
+    struct enum_users_state *state;
+    struct tevent_req *req;
+    struct proxy_nss_job *job = NULL;
+    struct sss_domain_info *dom;
     bool in_transaction = false;
     struct passwd *pwd;
-    enum nss_status status;
-    size_t buflen;
-    char *buffer;
-    char *newbuf;
-    int ret;
-    errno_t sret;
-    bool again;
     char *name;
+    size_t i;
+    errno_t ret;
+    errno_t sret;
 
-    DEBUG(SSSDBG_TRACE_LIBS, "Enumerating users\n");
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct enum_users_state);
+    dom = state->dom;
 
-    tmpctx = talloc_new(mem_ctx);
-    if (!tmpctx) {
-        return ENOMEM;
+    ret = proxy_nss_recv(state, subreq, &job);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        goto done;
     }
 
-    pwd = talloc_zero(tmpctx, struct passwd);
-    if (!pwd) {
-        ret = ENOMEM;
+    switch (job->status) {
+    case NSS_STATUS_NOTFOUND:
+        /* we are done here */
+        DEBUG(SSSDBG_TRACE_LIBS, "Enumeration completed.\n");
+        break;
+
+    case NSS_STATUS_UNAVAIL:
+        /* "remote" backend unavailable. Enter offline mode */
+        ret = ENXIO;
         goto done;
-    }
 
-    buflen = DEFAULT_BUFSIZE;
-    buffer = talloc_size(tmpctx, buflen);
-    if (!buffer) {
-        ret = ENOMEM;
+    default:
+        ret = EIO;
+        DEBUG(SSSDBG_OP_FAILURE, "proxy -> getpwent_r failed (%d)[%s]"
+                    "\n", job->err, strerror(job->err));
         goto done;
     }
 
-    ret = sysdb_transaction_start(sysdb);
+    ret = sysdb_transaction_start(state->sysdb);
     if (ret) {
         DEBUG(SSSDBG_CRIT_FAILURE, "Failed to start transaction\n");
         goto done;
     }
     in_transaction = true;
 
-    status = ctx->ops.setpwent();
-    if (status != NSS_STATUS_SUCCESS) {
-        ret = EIO;
-        goto done;
-    }
-
-    do {
-        again = false;
-
-        /* always zero out the pwd structure */
-        memset(pwd, 0, sizeof(struct passwd));
-
-        /* get entry */
-        status = ctx->ops.getpwent_r(pwd, buffer, buflen, &ret);
-
-        switch (status) {
-            case NSS_STATUS_TRYAGAIN:
-                /* buffer too small ? */
-                if (buflen < MAX_BUF_SIZE) {
-                    buflen *= 2;
-                }
-                if (buflen > MAX_BUF_SIZE) {
-                    buflen = MAX_BUF_SIZE;
-                }
-                newbuf = talloc_realloc_size(tmpctx, buffer, buflen);
-                if (!newbuf) {
-                    ret = ENOMEM;
-                    goto done;
-                }
-                buffer = newbuf;
-                again = true;
-                break;
-
-            case NSS_STATUS_NOTFOUND:
+    for (i = 0; i < job->num_entries; i++) {
+        pwd = &job->entries[i].pwd;
 
-                /* we are done here */
-                DEBUG(SSSDBG_TRACE_LIBS, "Enumeration completed.\n");
-
-                ret = sysdb_transaction_commit(sysdb);
-                if (ret != EOK) {
-                    DEBUG(SSSDBG_CRIT_FAILURE, "Failed to commit transaction\n");
-                    goto done;
-                }
-                in_transaction = false;
-                break;
+        DEBUG(SSSDBG_TRACE_LIBS,
+              "User found (%s, %"SPRIuid", %"SPRIgid")\n",
+               pwd->pw_name, pwd->pw_uid, pwd->pw_gid);
 
-            case NSS_STATUS_SUCCESS:
-
-                DEBUG(SSSDBG_TRACE_LIBS,
-                      "User found (%s, %"SPRIuid", %"SPRIgid")\n",
-                       pwd->pw_name, pwd->pw_uid, pwd->pw_gid);
-
-                /* uid=0 or gid=0 are invalid values */
-                /* also check that the id is in the valid range for this domain
-                 */
-                if (OUT_OF_ID_RANGE(pwd->pw_uid, dom->id_min, dom->id_max) ||
-                    OUT_OF_ID_RANGE(pwd->pw_gid, dom->id_min, dom->id_max)) {
-
-                    DEBUG(SSSDBG_OP_FAILURE, "User [%s] filtered out! (id out"
-                        " of range)\n", pwd->pw_name);
-
-                    again = true;
-                    break;
-                }
-
-                name = sss_create_internal_fqname(tmpctx, pwd->pw_name, dom->name);
-                if (name == NULL) {
-                    DEBUG(SSSDBG_OP_FAILURE,
-                          "failed to create internal name '%s'\n",
-                          pwd->pw_name);
-                    goto done;
-                }
-                ret = save_user(dom, pwd, name, NULL);
-                if (ret) {
-                    /* Do not fail completely on errors.
-                     * Just report the failure to save and go on */
-                    DEBUG(SSSDBG_OP_FAILURE, "Failed to store user %s."
-                                " Ignoring.\n", pwd->pw_name);
-                }
-                again = true;
-                break;
+        /* uid=0 or gid=0 are invalid values */
+        /* also check that the id is in the valid range for this domain
+         */
+        if (OUT_OF_ID_RANGE(pwd->pw_uid, dom->id_min, dom->id_max) ||
+            OUT_OF_ID_RANGE(pwd->pw_gid, dom->id_min, dom->id_max)) {
 
-            case NSS_STATUS_UNAVAIL:
-                /* "remote" backend unavailable. Enter offline mode */
-                ret = ENXIO;
-                break;
+            DEBUG(SSSDBG_OP_FAILURE, "User [%s] filtered out! (id out"
+                " of range)\n", pwd->pw_name);
+            continue;
+        }
 
-            default:
-                ret = EIO;
-                DEBUG(SSSDBG_OP_FAILURE, "proxy -> getpwent_r failed (%d)[%s]"
-                            "\n", ret, strerror(ret));
-                break;
+        name = sss_create_internal_fqname(job, pwd->pw_name, dom->name);
+        if (name == NULL) {
+            DEBUG(SSSDBG_OP_FAILURE,
+                  "failed to create internal name '%s'\n",
+                  pwd->pw_name);
+            ret = ENOMEM;
+            goto done;
+        }
+        ret = save_user(dom, pwd, name, NULL);
+        if (ret) {
+            /* Do not fail completely on errors.
+             * Just report the failure to save and go on */
+            DEBUG(SSSDBG_OP_FAILURE, "Failed to store user %s."
+                        " Ignoring.\n", pwd->pw_name);
         }
-    } while (again);
+        talloc_free(name);
+    }
+
+    ret = sysdb_transaction_commit(state->sysdb);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to commit transaction\n");
+        goto done;
+    }
+    in_transaction = false;
 
 done:
-    talloc_zfree(tmpctx);
+    talloc_free(job);
     if (in_transaction) {
-        sret = sysdb_transaction_cancel(sysdb);
+        sret = sysdb_transaction_cancel(state->sysdb);
         if (sret != EOK) {
             DEBUG(SSSDBG_CRIT_FAILURE, "Failed to cancel transaction\n");
         }
     }
-    ctx->ops.endpwent();
-    return ret;
+
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    tevent_req_done(req);
 }
 
 /* =Save-group-utilities=================================================*/
@@ -876,41 +1441,12 @@ done:
 }
 
 /* =Getgrnam-wrapper======================================================*/
-static char *
-grow_group_buffer(TALLOC_CTX *mem_ctx,
-                  char **buffer, size_t *buflen)
-{
-    char *newbuf;
-
-    if (*buflen == 0) {
-        *buflen = DEFAULT_BUFSIZE;
-    }
-    if (*buflen < MAX_BUF_SIZE) {
-        *buflen *= 2;
-    }
-    if (*buflen > MAX_BUF_SIZE) {
-        *buflen = MAX_BUF_SIZE;
-    }
-
-    newbuf = talloc_realloc_size(mem_ctx, *buffer, *buflen);
-    if (!newbuf) {
-        return NULL;
-    }
-    *buffer = newbuf;
-
-    return *buffer;
-}
-
 static errno_t
 handle_getgr_result(enum nss_status status, struct group *grp,
                     struct sss_domain_info *dom,
                     bool *delete_group)
 {
     switch (status) {
-    case NSS_STATUS_TRYAGAIN:
-        DEBUG(SSSDBG_MINOR_FAILURE, "Buffer too small\n");
-        return EAGAIN;
-
     case NSS_STATUS_NOTFOUND:
         DEBUG(SSSDBG_MINOR_FAILURE, "Group not found.\n");
         *delete_group = true;
@@ -943,81 +1479,146 @@ handle_getgr_result(enum nss_status status, struct group *grp,
     return EOK;
 }
 
-static int get_gr_name(struct proxy_id_ctx *ctx,
-                       struct sysdb_ctx *sysdb,
-                       struct sss_domain_info *dom,
-                       const char *i_name)
+static int
+delete_group(struct sss_domain_info *domain,
+             const char *name, gid_t gid)
 {
-    TALLOC_CTX *tmpctx;
-    struct group *grp;
-    enum nss_status status;
-    char *buffer = 0;
-    size_t buflen = 0;
-    bool delete_group = false;
     int ret;
+
+    if (name != NULL) {
+        DEBUG(SSSDBG_TRACE_FUNC,
+              "Group %s does not exist (or is invalid) on remote server,"
+               " deleting!\n", name);
+    } else {
+        DEBUG(SSSDBG_TRACE_FUNC,
+              "Group %"SPRIgid" does not exist (or is invalid) on remote "
+               "server, deleting!\n", gid);
+    }
+
+    ret = sysdb_delete_group(domain, name, gid);
+    if (ret == ENOENT) {
+        ret = EOK;
+    }
+
+    return ret;
+}
+
+struct get_gr_name_state {
+    struct proxy_id_ctx *ctx;
+    struct sysdb_ctx *sysdb;
+    struct sss_domain_info *dom;
+    const char *i_name;
     gid_t gid;
-    struct ldb_result *cached_grp = NULL;
-    const char *real_name = NULL;
+};
+
+static void get_gr_name_getgrnam_done(struct tevent_req *subreq);
+static void get_gr_name_getgrgid_done(struct tevent_req *subreq);
+
+static struct tevent_req *get_gr_name_send(TALLOC_CTX *mem_ctx,
+                                           struct proxy_id_ctx *ctx,
+                                           struct sysdb_ctx *sysdb,
+                                           struct sss_domain_info *dom,
+                                           const char *i_name)
+{
+    struct get_gr_name_state *state;
+    struct tevent_req *subreq;
+    struct tevent_req *req;
     char *shortname_or_alias;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct get_gr_name_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    state->ctx = ctx;
+    state->sysdb = sysdb;
+    state->dom = dom;
 
     DEBUG(SSSDBG_FUNC_DATA, "Searching group by name (%s)\n", i_name);
 
-    tmpctx = talloc_new(NULL);
-    if (!tmpctx) {
-        return ENOMEM;
+    state->i_name = talloc_strdup(state, i_name);
+    if (state->i_name == NULL) {
+        ret = ENOMEM;
+        goto immediately;
     }
 
-    ret = sss_parse_internal_fqname(tmpctx, i_name, &shortname_or_alias, NULL);
+    ret = sss_parse_internal_fqname(state, i_name, &shortname_or_alias, NULL);
     if (ret != EOK) {
-        goto done;
+        goto immediately;
     }
 
-    grp = talloc(tmpctx, struct group);
-    if (!grp) {
+    subreq = proxy_nss_send(state, ctx, PROXY_NSS_GETGRNAM,
+                            shortname_or_alias, 0);
+    if (subreq == NULL) {
         ret = ENOMEM;
-        DEBUG(SSSDBG_CRIT_FAILURE,
-              "proxy -> getgrnam_r failed for '%s': [%d] %s\n",
-              i_name, ret, strerror(ret));
-        goto done;
+        goto immediately;
     }
 
-    do {
-        /* always zero out the grp structure */
-        memset(grp, 0, sizeof(struct group));
-        buffer = grow_group_buffer(tmpctx, &buffer, &buflen);
-        if (!buffer) {
-            ret = ENOMEM;
-            goto done;
-        }
+    tevent_req_set_callback(subreq, get_gr_name_getgrnam_done, req);
 
-        status = ctx->ops.getgrnam_r(shortname_or_alias, grp, buffer,
-                                     buflen, &ret);
-        ret = handle_getgr_result(status, grp, dom, &delete_group);
-    } while (ret == EAGAIN);
+    return req;
+
+immediately:
+    tevent_req_error(req, ret);
+    tevent_req_post(req, ctx->be->ev);
+    return req;
+}
+
+static void get_gr_name_done(struct tevent_req *req, errno_t ret)
+{
+    struct get_gr_name_state *state;
+
+    state = tevent_req_data(req, struct get_gr_name_state);
+
+    if (ret) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "proxy -> getgrnam_r failed for '%s' <%d>: %s\n",
+              state->i_name, ret, strerror(ret));
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
+static void get_gr_name_getgrnam_done(struct tevent_req *subreq)
+{
+    struct get_gr_name_state *state;
+    struct tevent_req *req;
+    struct proxy_nss_job *job = NULL;
+    struct ldb_result *cached_grp = NULL;
+    const char *real_name = NULL;
+    bool del_group = false;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct get_gr_name_state);
+
+    ret = proxy_nss_recv(state, subreq, &job);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        goto done;
+    }
 
+    ret = handle_getgr_result(job->status, &job->result.grp, state->dom,
+                              &del_group);
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE,
               "getgrnam failed [%d]: %s\n", ret, strerror(ret));
         goto done;
     }
 
-    if (delete_group) {
-        DEBUG(SSSDBG_TRACE_FUNC,
-              "Group %s does not exist (or is invalid) on remote server,"
-               " deleting!\n", i_name);
-
-        ret = sysdb_delete_group(dom, i_name, 0);
-        if (ret == ENOENT) {
-            ret = EOK;
-        }
+    if (del_group) {
+        ret = delete_group(state->dom, state->i_name, 0);
         goto done;
     }
 
-    gid = grp->gr_gid;
+    state->gid = job->result.grp.gr_gid;
 
     /* Canonicalize the group name in case it was actually an alias */
-    if (ctx->fast_alias == true) {
-        ret = sysdb_getgrgid(tmpctx, dom, gid, &cached_grp);
+    if (state->ctx->fast_alias == true) {
+        ret = sysdb_getgrgid(job, state->dom, state->gid, &cached_grp);
         if (ret != EOK) {
             /* Non-fatal, attempt to canonicalize online */
             DEBUG(SSSDBG_TRACE_FUNC, "Request to cache failed [%d]: %s\n",
@@ -1034,50 +1635,20 @@ static int get_gr_name(struct proxy_id_ctx *ctx,
     }
 
     if (real_name == NULL) {
-        talloc_zfree(buffer);
-        buflen = 0;
-
-        do {
-            memset(grp, 0, sizeof(struct group));
-            buffer = grow_group_buffer(tmpctx, &buffer, &buflen);
-            if (!buffer) {
-                ret = ENOMEM;
-                goto done;
-            }
-
-            status = ctx->ops.getgrgid_r(gid, grp, buffer, buflen, &ret);
-
-            ret = handle_getgr_result(status, grp, dom, &delete_group);
-        } while (ret == EAGAIN);
-
-        if (ret != EOK) {
-            DEBUG(SSSDBG_OP_FAILURE,
-                "getgrgid failed [%d]: %s\n", ret, strerror(ret));
-            goto done;
-        }
-
-        real_name = sss_create_internal_fqname(tmpctx, grp->gr_name, dom->name);
-        if (real_name == NULL) {
-            DEBUG(SSSDBG_OP_FAILURE, "Failed to create fqdn '%s'\n",
-                  grp->gr_name);
+        subreq = proxy_nss_send(state, state->ctx, PROXY_NSS_GETGRGID,
+                                NULL, state->gid);
+        if (subreq == NULL) {
             ret = ENOMEM;
             goto done;
         }
-    }
-
-    if (delete_group) {
-        DEBUG(SSSDBG_TRACE_FUNC,
-              "Group %s does not exist (or is invalid) on remote server,"
-               " deleting!\n", i_name);
 
-        ret = sysdb_delete_group(dom, i_name, gid);
-        if (ret == ENOENT) {
-            ret = EOK;
-        }
-        goto done;
+        tevent_req_set_callback(subreq, get_gr_name_getgrgid_done, req);
+        talloc_free(job);
+        return;
     }
 
-    ret = save_group(sysdb, dom, grp, real_name, i_name);
+    ret = save_group(state->sysdb, state->dom, &job->result.grp,
+                     real_name, state->i_name);
     if (ret) {
         DEBUG(SSSDBG_OP_FAILURE,
               "Cannot save group [%d]: %s\n", ret, strerror(ret));
@@ -1085,92 +1656,101 @@ static int get_gr_name(struct proxy_id_ctx *ctx,
     }
 
 done:
-    talloc_zfree(tmpctx);
-    if (ret) {
-        DEBUG(SSSDBG_OP_FAILURE,
-              "proxy -> getgrnam_r failed for '%s' <%d>: %s\n",
-              i_name, ret, strerror(ret));
-    }
-    return ret;
+    talloc_free(job);
+    get_gr_name_done(req, ret);
 }
 
-/* =Getgrgid-wrapper======================================================*/
-static int get_gr_gid(TALLOC_CTX *mem_ctx,
-                      struct proxy_id_ctx *ctx,
-                      struct sysdb_ctx *sysdb,
-                      struct sss_domain_info *dom,
-                      gid_t gid,
-                      time_t now)
+static void get_gr_name_getgrgid_done(struct tevent_req *subreq)
 {
-    TALLOC_CTX *tmpctx;
-    struct group *grp;
-    enum nss_status status;
-    char *buffer = NULL;
-    size_t buflen = 0;
-    bool delete_group = false;
-    int ret;
-    char *name;
+    struct get_gr_name_state *state;
+    struct tevent_req *req;
+    struct proxy_nss_job *job = NULL;
+    const char *real_name;
+    bool del_group = false;
+    errno_t ret;
 
-    DEBUG(SSSDBG_TRACE_FUNC, "Searching group by gid (%"SPRIgid")\n", gid);
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct get_gr_name_state);
 
-    tmpctx = talloc_new(mem_ctx);
-    if (!tmpctx) {
-        return ENOMEM;
+    ret = proxy_nss_recv(state, subreq, &job);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = handle_getgr_result(job->status, &job->result.grp, state->dom,
+                              &del_group);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+            "getgrgid failed [%d]: %s\n", ret, strerror(ret));
+        goto done;
+    }
+
+    if (del_group) {
+        ret = delete_group(state->dom, state->i_name, state->gid);
+        goto done;
     }
 
-    grp = talloc(tmpctx, struct group);
-    if (!grp) {
+    real_name = sss_create_internal_fqname(job, job->result.grp.gr_name,
+                                           state->dom->name);
+    if (real_name == NULL) {
+        DEBUG(SSSDBG_OP_FAILURE, "Failed to create fqdn '%s'\n",
+              job->result.grp.gr_name);
         ret = ENOMEM;
         goto done;
     }
 
-    do {
-        /* always zero out the grp structure */
-        memset(grp, 0, sizeof(struct group));
-        buffer = grow_group_buffer(tmpctx, &buffer, &buflen);
-        if (!buffer) {
-            ret = ENOMEM;
-            goto done;
-        }
+    ret = save_group(state->sysdb, state->dom, &job->result.grp,
+                     real_name, state->i_name);
+    if (ret) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Cannot save group [%d]: %s\n", ret, strerror(ret));
+        goto done;
+    }
 
-        status = ctx->ops.getgrgid_r(gid, grp, buffer, buflen, &ret);
+done:
+    talloc_free(job);
+    get_gr_name_done(req, ret);
+}
 
-        ret = handle_getgr_result(status, grp, dom, &delete_group);
-    } while (ret == EAGAIN);
+/* =Getgrgid-wrapper======================================================*/
+static errno_t process_gr_gid(struct sysdb_ctx *sysdb,
+                              struct sss_domain_info *dom,
+                              struct proxy_nss_job *job)
+{
+    struct group *grp = &job->result.grp;
+    bool del_group = false;
+    gid_t gid = job->id;
+    char *name;
+    errno_t ret;
 
+    ret = handle_getgr_result(job->status, grp, dom, &del_group);
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE,
               "getgrgid failed [%d]: %s\n", ret, strerror(ret));
         goto done;
     }
 
-    if (delete_group) {
-        DEBUG(SSSDBG_TRACE_FUNC,
-              "Group %"SPRIgid" does not exist (or is invalid) on remote "
-               "server, deleting!\n", gid);
-
-        ret = sysdb_delete_group(dom, NULL, gid);
-        if (ret == ENOENT) {
-            ret = EOK;
-        }
+    if (del_group) {
+        ret = delete_group(dom, NULL, gid);
         goto done;
     }
 
-    name = sss_create_internal_fqname(tmpctx, grp->gr_name, dom->name);
+    name = sss_create_internal_fqname(job, grp->gr_name, dom->name);
     if (name == NULL) {
         ret = ENOMEM;
         goto done;
     }
 
     ret = save_group(sysdb, dom, grp, name, NULL);
+    talloc_free(name);
     if (ret) {
         DEBUG(SSSDBG_OP_FAILURE,
-              "Cannot save user [%d]: %s\n", ret, strerror(ret));
+              "Cannot save group [%d]: %s\n", ret, strerror(ret));
         goto done;
     }
 
 done:
-    talloc_zfree(tmpctx);
     if (ret) {
         DEBUG(SSSDBG_OP_FAILURE,
               "proxy -> getgrgid_r failed for '%"SPRIgid"' <%d>: %s\n",
@@ -1179,308 +1759,401 @@ done:
     return ret;
 }
 
+struct get_gr_gid_state {
+    struct sysdb_ctx *sysdb;
+    struct sss_domain_info *dom;
+};
+
+static void get_gr_gid_done(struct tevent_req *subreq);
+
+static struct tevent_req *get_gr_gid_send(TALLOC_CTX *mem_ctx,
+                                          struct proxy_id_ctx *ctx,
+                                          struct sysdb_ctx *sysdb,
+                                          struct sss_domain_info *dom,
+                                          gid_t gid)
+{
+    struct get_gr_gid_state *state;
+    struct tevent_req *subreq;
+    struct tevent_req *req;
+
+    req = tevent_req_create(mem_ctx, &state, struct get_gr_gid_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    state->sysdb = sysdb;
+    state->dom = dom;
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Searching group by gid (%"SPRIgid")\n", gid);
+
+    subreq = proxy_nss_send(state, ctx, PROXY_NSS_GETGRGID, NULL, gid);
+    if (subreq == NULL) {
+        tevent_req_error(req, ENOMEM);
+        tevent_req_post(req, ctx->be->ev);
+        return req;
+    }
+
+    tevent_req_set_callback(subreq, get_gr_gid_done, req);
+
+    return req;
+}
+
+static void get_gr_gid_done(struct tevent_req *subreq)
+{
+    struct get_gr_gid_state *state;
+    struct tevent_req *req;
+    struct proxy_nss_job *job;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct get_gr_gid_state);
+
+    ret = proxy_nss_recv(state, subreq, &job);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    ret = process_gr_gid(state->sysdb, state->dom, job);
+    talloc_free(job);
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
 /* =Getgrent-wrapper======================================================*/
 
-static int enum_groups(TALLOC_CTX *mem_ctx,
-                       struct proxy_id_ctx *ctx,
-                       struct sysdb_ctx *sysdb,
-                       struct sss_domain_info *dom)
+struct enum_groups_state {
+    struct sysdb_ctx *sysdb;
+    struct sss_domain_info *dom;
+};
+
+static void enum_groups_done(struct tevent_req *subreq);
+
+static struct tevent_req *enum_groups_send(TALLOC_CTX *mem_ctx,
+                                           struct proxy_id_ctx *ctx,
+                                           struct sysdb_ctx *sysdb,
+                                           struct sss_domain_info *dom)
+{
+    struct enum_groups_state *state;
+    struct tevent_req *subreq;
+    struct tevent_req *req;
+
+    req = tevent_req_create(mem_ctx, &state, struct enum_groups_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    state->sysdb = sysdb;
+    state->dom = dom;
+
+    DEBUG(SSSDBG_TRACE_LIBS, "Enumerating groups\n");
+
+    subreq = proxy_nss_send(state, ctx, PROXY_NSS_GETGRENT, NULL, 0);
+    if (subreq == NULL) {
+        tevent_req_error(req, ENOMEM);
+        tevent_req_post(req, ctx->be->ev);
+        return req;
+    }
+
+    tevent_req_set_callback(subreq, enum_groups_done, req);
+
+    return req;
+}
+
+static void enum_groups_done(struct tevent_req *subreq)
 {
-    TALLOC_CTX *tmpctx;
+    struct enum_groups_state *state;
+    struct tevent_req *req;
+    struct proxy_nss_job *job = NULL;
+    struct sss_domain_info *dom;
     bool in_transaction = false;
     struct group *grp;
-    enum nss_status status;
-    size_t buflen;
-    char *buffer;
-    char *newbuf;
-    int ret;
-    errno_t sret;
-    bool again;
     char *name;
+    size_t i;
+    errno_t ret;
+    errno_t sret;
 
-    DEBUG(SSSDBG_TRACE_LIBS, "Enumerating groups\n");
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct enum_groups_state);
+    dom = state->dom;
 
-    tmpctx = talloc_new(mem_ctx);
-    if (!tmpctx) {
-        return ENOMEM;
+    ret = proxy_nss_recv(state, subreq, &job);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        goto done;
     }
 
-    grp = talloc(tmpctx, struct group);
-    if (!grp) {
-        ret = ENOMEM;
+    switch (job->status) {
+    case NSS_STATUS_NOTFOUND:
+        /* we are done here */
+        DEBUG(SSSDBG_TRACE_LIBS, "Enumeration completed.\n");
+        break;
+
+    case NSS_STATUS_UNAVAIL:
+        /* "remote" backend unavailable. Enter offline mode */
+        ret = ENXIO;
         goto done;
-    }
 
-    buflen = DEFAULT_BUFSIZE;
-    buffer = talloc_size(tmpctx, buflen);
-    if (!buffer) {
-        ret = ENOMEM;
+    default:
+        ret = EIO;
+        DEBUG(SSSDBG_OP_FAILURE, "proxy -> getgrent_r failed (%d)[%s]"
+                    "\n", job->err, strerror(job->err));
         goto done;
     }
 
-    ret = sysdb_transaction_start(sysdb);
+    ret = sysdb_transaction_start(state->sysdb);
     if (ret) {
         DEBUG(SSSDBG_CRIT_FAILURE, "Failed to start transaction\n");
         goto done;
     }
     in_transaction = true;
 
-    status = ctx->ops.setgrent();
-    if (status != NSS_STATUS_SUCCESS) {
-        ret = EIO;
-        goto done;
-    }
-
-    do {
-        again = false;
-
-        /* always zero out the grp structure */
-        memset(grp, 0, sizeof(struct group));
-
-        /* get entry */
-        status = ctx->ops.getgrent_r(grp, buffer, buflen, &ret);
-
-        switch (status) {
-            case NSS_STATUS_TRYAGAIN:
-                /* buffer too small ? */
-                if (buflen < MAX_BUF_SIZE) {
-                    buflen *= 2;
-                }
-                if (buflen > MAX_BUF_SIZE) {
-                    buflen = MAX_BUF_SIZE;
-                }
-                newbuf = talloc_realloc_size(tmpctx, buffer, buflen);
-                if (!newbuf) {
-                    ret = ENOMEM;
-                    goto done;
-                }
-                buffer = newbuf;
-                again = true;
-                break;
-
-            case NSS_STATUS_NOTFOUND:
-
-                /* we are done here */
-                DEBUG(SSSDBG_TRACE_LIBS, "Enumeration completed.\n");
+    for (i = 0; i < job->num_entries; i++) {
+        grp = &job->entries[i].grp;
 
-                ret = sysdb_transaction_commit(sysdb);
-                if (ret != EOK) {
-                    DEBUG(SSSDBG_CRIT_FAILURE, "Failed to commit transaction\n");
-                    goto done;
-                }
-                in_transaction = false;
-                break;
+        DEBUG(SSSDBG_OP_FAILURE, "Group found (%s, %"SPRIgid")\n",
+                    grp->gr_name, grp->gr_gid);
 
-            case NSS_STATUS_SUCCESS:
-
-                DEBUG(SSSDBG_OP_FAILURE, "Group found (%s, %"SPRIgid")\n",
-                            grp->gr_name, grp->gr_gid);
-
-                /* gid=0 is an invalid value */
-                /* also check that the id is in the valid range for this domain
-                 */
-                if (OUT_OF_ID_RANGE(grp->gr_gid, dom->id_min, dom->id_max)) {
-
-                    DEBUG(SSSDBG_OP_FAILURE, "Group [%s] filtered out! (id"
-                        "out of range)\n", grp->gr_name);
-
-                    again = true;
-                    break;
-                }
-
-                name = sss_create_internal_fqname(tmpctx, grp->gr_name,
-                                                  dom->name);
-                if (name == NULL) {
-                    DEBUG(SSSDBG_OP_FAILURE, "Failed to create internal fqname "
-                          "Ignoring\n");
-                    ret = ENOMEM;
-                }
-                ret = save_group(sysdb, dom, grp, name, NULL);
-                if (ret) {
-                    /* Do not fail completely on errors.
-                     * Just report the failure to save and go on */
-                    DEBUG(SSSDBG_OP_FAILURE, "Failed to store group."
-                                "Ignoring\n");
-                }
-                again = true;
-                break;
+        /* gid=0 is an invalid value */
+        /* also check that the id is in the valid range for this domain
+         */
+        if (OUT_OF_ID_RANGE(grp->gr_gid, dom->id_min, dom->id_max)) {
 
-            case NSS_STATUS_UNAVAIL:
-                /* "remote" backend unavailable. Enter offline mode */
-                ret = ENXIO;
-                break;
+            DEBUG(SSSDBG_OP_FAILURE, "Group [%s] filtered out! (id"
+                "out of range)\n", grp->gr_name);
+            continue;
+        }
 
-            default:
-                ret = EIO;
-                DEBUG(SSSDBG_OP_FAILURE, "proxy -> getgrent_r failed (%d)[%s]"
-                            "\n", ret, strerror(ret));
-                break;
+        name = sss_create_internal_fqname(job, grp->gr_name, dom->name);
+        if (name == NULL) {
+            DEBUG(SSSDBG_OP_FAILURE, "Failed to create internal fqname "
+                  "Ignoring\n");
+            continue;
+        }
+        ret = save_group(state->sysdb, dom, grp, name, NULL);
+        if (ret) {
+            /* Do not fail completely on errors.
+             * Just report the failure to save and go on */
+            DEBUG(SSSDBG_OP_FAILURE, "Failed to store group."
+                        "Ignoring\n");
         }
-    } while (again);
+        talloc_free(name);
+    }
+
+    ret = sysdb_transaction_commit(state->sysdb);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to commit transaction\n");
+        goto done;
+    }
+    in_transaction = false;
 
 done:
-    talloc_zfree(tmpctx);
+    talloc_free(job);
     if (in_transaction) {
-        sret = sysdb_transaction_cancel(sysdb);
+        sret = sysdb_transaction_cancel(state->sysdb);
         if (sret != EOK) {
             DEBUG(SSSDBG_CRIT_FAILURE, "Failed to cancel transaction\n");
         }
     }
-    ctx->ops.endgrent();
-    return ret;
-}
 
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    tevent_req_done(req);
+}
 
 /* =Initgroups-wrapper====================================================*/
 
-static int get_initgr_groups_process(TALLOC_CTX *memctx,
-                                     struct proxy_id_ctx *ctx,
-                                     struct sysdb_ctx *sysdb,
-                                     struct sss_domain_info *dom,
-                                     struct passwd *pwd);
-
-static int get_initgr(TALLOC_CTX *mem_ctx,
-                      struct proxy_id_ctx *ctx,
-                      struct sysdb_ctx *sysdb,
-                      struct sss_domain_info *dom,
-                      const char *i_name)
+struct get_initgr_state {
+    struct proxy_id_ctx *ctx;
+    struct sysdb_ctx *sysdb;
+    struct sss_domain_info *dom;
+    const char *name;
+
+    struct proxy_nss_job **groups;
+    long int num_gids;
+    long int num_groups;
+};
+
+static void get_initgr_user_done(struct tevent_req *subreq);
+static void get_initgr_groups_done(struct tevent_req *subreq);
+static void get_initgr_group_done(struct tevent_req *subreq);
+
+static struct tevent_req *get_initgr_send(TALLOC_CTX *mem_ctx,
+                                          struct proxy_id_ctx *ctx,
+                                          struct sysdb_ctx *sysdb,
+                                          struct sss_domain_info *dom,
+                                          const char *i_name)
 {
-    TALLOC_CTX *tmpctx;
-    bool in_transaction = false;
-    struct passwd *pwd;
-    enum nss_status status;
-    char *buffer;
-    size_t buflen;
-    int ret;
-    errno_t sret;
-    bool del_user;
-    uid_t uid;
-    struct ldb_result *cached_pwd = NULL;
-    const char *real_name = NULL;
-    char *shortname_or_alias;
+    struct get_initgr_state *state;
+    struct tevent_req *subreq;
+    struct tevent_req *req;
 
-    tmpctx = talloc_new(mem_ctx);
-    if (!tmpctx) {
-        return ENOMEM;
+    req = tevent_req_create(mem_ctx, &state, struct get_initgr_state);
+    if (req == NULL) {
+        return NULL;
     }
 
-    ret = sss_parse_internal_fqname(tmpctx, i_name, &shortname_or_alias, NULL);
-    if (ret != EOK) {
-        goto done;
-    }
+    state->ctx = ctx;
+    state->sysdb = sysdb;
+    state->dom = dom;
 
-    pwd = talloc_zero(tmpctx, struct passwd);
-    if (!pwd) {
-        ret = ENOMEM;
-        goto fail;
+    subreq = get_pw_name_send(state, ctx, dom, i_name);
+    if (subreq == NULL) {
+        tevent_req_error(req, ENOMEM);
+        tevent_req_post(req, ctx->be->ev);
+        return req;
     }
 
-    buflen = DEFAULT_BUFSIZE;
-    buffer = talloc_size(tmpctx, buflen);
-    if (!buffer) {
-        ret = ENOMEM;
-        goto fail;
-    }
+    tevent_req_set_callback(subreq, get_initgr_user_done, req);
 
-    ret = sysdb_transaction_start(sysdb);
-    if (ret) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to start transaction\n");
-        goto fail;
+    return req;
+}
+
+static void get_initgr_user_done(struct tevent_req *subreq)
+{
+    struct get_initgr_state *state;
+    struct tevent_req *req;
+    gid_t gid;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct get_initgr_state);
+
+    ret = get_pw_name_recv(state, subreq, &state->name, &gid);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Could not save user\n");
+        tevent_req_error(req, ret);
+        return;
     }
-    in_transaction = true;
 
-    /* FIXME: should we move this call outside the transaction to keep the
-     * transaction as short as possible ? */
-    status = ctx->ops.getpwnam_r(shortname_or_alias, pwd,
-                                 buffer, buflen, &ret);
-    ret = handle_getpw_result(status, pwd, dom, &del_user);
-    if (ret) {
-        DEBUG(SSSDBG_OP_FAILURE,
-              "getpwnam failed [%d]: %s\n", ret, strerror(ret));
-        goto fail;
+    if (state->name == NULL) {
+        /* the user was deleted, there is nothing to do */
+        tevent_req_done(req);
+        return;
     }
 
-    if (del_user) {
-        ret = delete_user(dom, i_name, 0);
-        if (ret) {
-            DEBUG(SSSDBG_OP_FAILURE, "Could not delete user\n");
-            goto fail;
-        }
-        goto done;
+    subreq = proxy_nss_send(state, state->ctx, PROXY_NSS_INITGROUPS,
+                            state->name, gid);
+    if (subreq == NULL) {
+        tevent_req_error(req, ENOMEM);
+        return;
     }
 
-    uid = pwd->pw_uid;
-    memset(buffer, 0, buflen);
+    tevent_req_set_callback(subreq, get_initgr_groups_done, req);
+}
 
-    /* Canonicalize the username in case it was actually an alias */
-    if (ctx->fast_alias == true) {
-        ret = sysdb_getpwuid(tmpctx, dom, uid, &cached_pwd);
-        if (ret != EOK) {
-            /* Non-fatal, attempt to canonicalize online */
-            DEBUG(SSSDBG_TRACE_FUNC, "Request to cache failed [%d]: %s\n",
-                  ret, strerror(ret));
-        }
+static void get_initgr_groups_done(struct tevent_req *subreq)
+{
+    struct get_initgr_state *state;
+    struct tevent_req *req;
+    struct proxy_nss_job *job = NULL;
+    long int i;
+    errno_t ret;
 
-        if (ret == EOK && cached_pwd->count == 1) {
-            real_name = ldb_msg_find_attr_as_string(cached_pwd->msgs[0],
-                                                    SYSDB_NAME, NULL);
-            if (!real_name) {
-                DEBUG(SSSDBG_MINOR_FAILURE, "Cached user has no name?\n");
-            }
-        }
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct get_initgr_state);
+
+    ret = proxy_nss_recv(state, subreq, &job);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        goto done;
     }
 
-    if (real_name == NULL) {
-        memset(buffer, 0, buflen);
+    switch (job->status) {
+    case NSS_STATUS_NOTFOUND:
+        DEBUG(SSSDBG_FUNC_DATA, "The initgroups call returned 'NOTFOUND'. "
+                                 "Assume the user is only member of its "
+                                 "primary group (%"SPRIgid")\n", job->id);
+        /* fall through */
+        SSS_ATTRIBUTE_FALLTHROUGH;
+    case NSS_STATUS_SUCCESS:
+        DEBUG(SSSDBG_CONF_SETTINGS, "User [%s] appears to be member of %lu "
+              "groups\n", state->name, job->num_gids);
+        break;
 
-        status = ctx->ops.getpwuid_r(uid, pwd, buffer, buflen, &ret);
-        ret = handle_getpw_result(status, pwd, dom, &del_user);
-        if (ret) {
-            DEBUG(SSSDBG_OP_FAILURE,
-                "getpwuid failed [%d]: %s\n", ret, strerror(ret));
-            goto done;
-        }
+    default:
+        DEBUG(SSSDBG_OP_FAILURE, "proxy -> initgroups_dyn failed (%d)[%s]\n",
+                  job->err, strerror(job->err));
+        ret = EIO;
+        goto done;
+    }
+
+    state->num_gids = job->num_gids;
+    state->groups = talloc_zero_array(state, struct proxy_nss_job *,
+                                      state->num_gids);
+    if (state->groups == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
 
-        real_name = sss_create_internal_fqname(tmpctx, pwd->pw_name, dom->name);
-        if (real_name == NULL) {
+    /* The groups are looked up in parallel and stored together once all
+     * of them are known */
+    for (i = 0; i < state->num_gids; i++) {
+        subreq = proxy_nss_send(state, state->ctx, PROXY_NSS_GETGRGID,
+                                NULL, job->gids[i]);
+        if (subreq == NULL) {
             ret = ENOMEM;
             goto done;
         }
+
+        tevent_req_set_callback(subreq, get_initgr_group_done, req);
     }
 
-    if (del_user) {
-        ret = delete_user(dom, i_name, uid);
-        if (ret) {
-            DEBUG(SSSDBG_OP_FAILURE, "Could not delete user\n");
-            goto fail;
-        }
-        goto done;
+    ret = EOK;
+
+done:
+    talloc_free(job);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Could not process initgroups\n");
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    if (state->num_gids == 0) {
+        tevent_req_done(req);
     }
+}
+
+static errno_t get_initgr_save(struct get_initgr_state *state)
+{
+    bool in_transaction = false;
+    long int i;
+    errno_t ret;
+    errno_t sret;
 
-    ret = save_user(dom, pwd, real_name, i_name);
+    ret = sysdb_transaction_start(state->sysdb);
     if (ret) {
-        DEBUG(SSSDBG_OP_FAILURE, "Could not save user\n");
-        goto fail;
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to start transaction\n");
+        goto done;
     }
+    in_transaction = true;
 
-    ret = get_initgr_groups_process(tmpctx, ctx, sysdb, dom, pwd);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE, "Could not process initgroups\n");
-        goto fail;
+    for (i = 0; i < state->num_groups; i++) {
+        ret = process_gr_gid(state->sysdb, state->dom, state->groups[i]);
+        if (ret != EOK) {
+            goto done;
+        }
     }
 
-done:
-    ret = sysdb_transaction_commit(sysdb);
+    ret = sysdb_transaction_commit(state->sysdb);
     if (ret) {
         DEBUG(SSSDBG_OP_FAILURE, "Failed to commit transaction\n");
-        goto fail;
+        goto done;
     }
     in_transaction = false;
 
-fail:
-    talloc_zfree(tmpctx);
+done:
     if (in_transaction) {
-        sret = sysdb_transaction_cancel(sysdb);
+        sret = sysdb_transaction_cancel(state->sysdb);
         if (sret != EOK) {
             DEBUG(SSSDBG_CRIT_FAILURE, "Failed to cancel transaction\n");
         }
@@ -1488,102 +2161,71 @@ fail:
     return ret;
 }
 
-static int get_initgr_groups_process(TALLOC_CTX *memctx,
-                                     struct proxy_id_ctx *ctx,
-                                     struct sysdb_ctx *sysdb,
-                                     struct sss_domain_info *dom,
-                                     struct passwd *pwd)
+static void get_initgr_group_done(struct tevent_req *subreq)
 {
-    enum nss_status status;
-    long int limit;
-    long int size;
-    long int num;
-    long int num_gids;
-    gid_t *gids;
-    int ret;
-    int i;
-    time_t now;
+    struct get_initgr_state *state;
+    struct tevent_req *req;
+    errno_t ret;
 
-    num_gids = 0;
-    limit = 4096;
-    num = 4096;
-    size = num*sizeof(gid_t);
-    gids = talloc_size(memctx, size);
-    if (!gids) {
-        return ENOMEM;
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct get_initgr_state);
+
+    ret = proxy_nss_recv(state->groups, subreq,
+                         &state->groups[state->num_groups]);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
     }
 
-    /* nss modules may skip the primary group when we pass it in so always add
-     * it in advance */
-    gids[0] = pwd->pw_gid;
-    num_gids++;
+    state->num_groups++;
+    if (state->num_groups < state->num_gids) {
+        return;
+    }
 
-    /* FIXME: should we move this call outside the transaction to keep the
-     * transaction as short as possible ? */
-    do {
-        status = ctx->ops.initgroups_dyn(pwd->pw_name, pwd->pw_gid, &num_gids,
-                &num, &gids, limit, &ret);
+    ret = get_initgr_save(state);
+    talloc_zfree(state->groups);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Could not process initgroups\n");
+        tevent_req_error(req, ret);
+        return;
+    }
 
-        if (status == NSS_STATUS_TRYAGAIN) {
-            /* buffer too small ? */
-            if (size < MAX_BUF_SIZE) {
-                num *= 2;
-                size = num*sizeof(gid_t);
-            }
-            if (size > MAX_BUF_SIZE) {
-                size = MAX_BUF_SIZE;
-                num = size/sizeof(gid_t);
-            }
-            limit = num;
-            gids = talloc_realloc_size(memctx, gids, size);
-            if (!gids) {
-                return ENOMEM;
-            }
-        }
-    } while(status == NSS_STATUS_TRYAGAIN);
+    tevent_req_done(req);
+}
 
-    switch (status) {
-    case NSS_STATUS_NOTFOUND:
-        DEBUG(SSSDBG_FUNC_DATA, "The initgroups call returned 'NOTFOUND'. "
-                                 "Assume the user is only member of its "
-                                 "primary group (%"SPRIgid")\n", pwd->pw_gid);
-        /* fall through */
-        SSS_ATTRIBUTE_FALLTHROUGH;
-    case NSS_STATUS_SUCCESS:
-        DEBUG(SSSDBG_CONF_SETTINGS, "User [%s] appears to be member of %lu "
-              "groups\n", pwd->pw_name, num_gids);
+/* =Proxy_Id-Functions====================================================*/
 
-        now = time(NULL);
-        for (i = 0; i < num_gids; i++) {
-            ret = get_gr_gid(memctx, ctx, sysdb, dom, gids[i], now);
-            if (ret) {
-                return ret;
-            }
+static void proxy_account_info_reply(struct dp_reply_std *reply,
+                                     struct be_ctx *be_ctx,
+                                     errno_t ret)
+{
+    if (ret) {
+        if (ret == ENXIO) {
+            DEBUG(SSSDBG_OP_FAILURE,
+                  "proxy returned UNAVAIL error, going offline!\n");
+            be_mark_offline(be_ctx);
         }
-        ret = EOK;
-
-        break;
 
-    default:
-        DEBUG(SSSDBG_OP_FAILURE, "proxy -> initgroups_dyn failed (%d)[%s]\n",
-                  ret, strerror(ret));
-        ret = EIO;
-        break;
+        dp_reply_std_set(reply, DP_ERR_FATAL, ret, NULL);
+        return;
     }
 
-    return ret;
+    dp_reply_std_set(reply, DP_ERR_OK, EOK, NULL);
 }
 
-/* =Proxy_Id-Functions====================================================*/
-
-static struct dp_reply_std
+/* Returns EAGAIN and the lookup in _subreq if the NSS module is called
+ * from a worker thread, otherwise the reply is set right away. */
+static errno_t
 proxy_account_info(TALLOC_CTX *mem_ctx,
                    struct proxy_id_ctx *ctx,
                    struct dp_id_data *data,
                    struct be_ctx *be_ctx,
-                   struct sss_domain_info *domain)
+                   struct sss_domain_info *domain,
+                   struct dp_reply_std *_reply,
+                   struct tevent_req **_subreq)
 {
-    struct dp_reply_std reply;
+    struct tevent_req *subreq = NULL;
     struct sysdb_ctx *sysdb;
     uid_t uid;
     gid_t gid;
@@ -1594,87 +2236,97 @@ proxy_account_info(TALLOC_CTX *mem_ctx,
 
     /* Proxy provider does not support security ID lookups. */
     if (data->filter_type == BE_FILTER_SECID) {
-        dp_reply_std_set(&reply, DP_ERR_FATAL, ENOSYS,
+        dp_reply_std_set(_reply, DP_ERR_FATAL, ENOSYS,
                          "Security lookups are not supported");
-        return reply;
+        return EOK;
     }
 
     switch (data->entry_type & BE_REQ_TYPE_MASK) {
     case BE_REQ_USER: /* user */
         switch (data->filter_type) {
         case BE_FILTER_ENUM:
-            ret = enum_users(mem_ctx, ctx, sysdb, domain);
+            subreq = enum_users_send(mem_ctx, ctx, sysdb, domain);
+            ret = EAGAIN;
             break;
 
         case BE_FILTER_NAME:
-            ret = get_pw_name(ctx, domain, data->filter_value);
+            subreq = get_pw_name_send(mem_ctx, ctx, domain,
+                                      data->filter_value);
+            ret = EAGAIN;
             break;
 
         case BE_FILTER_IDNUM:
             uid = (uid_t) strtouint32(data->filter_value, &endptr, 10);
             if (errno || *endptr || (data->filter_value == endptr)) {
-                dp_reply_std_set(&reply, DP_ERR_FATAL, EINVAL,
+                dp_reply_std_set(_reply, DP_ERR_FATAL, EINVAL,
                                  "Invalid attr type");
-                return reply;
+                return EOK;
             }
-            ret = get_pw_uid(ctx, domain, uid);
+            subreq = get_pw_uid_send(mem_ctx, ctx, domain, uid);
+            ret = EAGAIN;
             break;
         default:
-            dp_reply_std_set(&reply, DP_ERR_FATAL, EINVAL,
+            dp_reply_std_set(_reply, DP_ERR_FATAL, EINVAL,
                              "Invalid filter type");
-            return reply;
+            return EOK;
         }
         break;
 
     case BE_REQ_GROUP: /* group */
         switch (data->filter_type) {
         case BE_FILTER_ENUM:
-            ret = enum_groups(mem_ctx, ctx, sysdb, domain);
+            subreq = enum_groups_send(mem_ctx, ctx, sysdb, domain);
+            ret = EAGAIN;
             break;
         case BE_FILTER_NAME:
-            ret = get_gr_name(ctx, sysdb, domain, data->filter_value);
+            subreq = get_gr_name_send(mem_ctx, ctx, sysdb, domain,
+                                      data->filter_value);
+            ret = EAGAIN;
             break;
         case BE_FILTER_IDNUM:
             gid = (gid_t) strtouint32(data->filter_value, &endptr, 10);
             if (errno || *endptr || (data->filter_value == endptr)) {
-                dp_reply_std_set(&reply, DP_ERR_FATAL, EINVAL,
+                dp_reply_std_set(_reply, DP_ERR_FATAL, EINVAL,
                                  "Invalid attr type");
-                return reply;
+                return EOK;
             }
-            ret = get_gr_gid(mem_ctx, ctx, sysdb, domain, gid, 0);
+            subreq = get_gr_gid_send(mem_ctx, ctx, sysdb, domain, gid);
+            ret = EAGAIN;
             break;
         default:
-            dp_reply_std_set(&reply, DP_ERR_FATAL, EINVAL,
+            dp_reply_std_set(_reply, DP_ERR_FATAL, EINVAL,
                              "Invalid filter type");
-            return reply;
+            return EOK;
         }
         break;
 
     case BE_REQ_INITGROUPS: /* init groups for user */
         if (data->filter_type != BE_FILTER_NAME) {
-            dp_reply_std_set(&reply, DP_ERR_FATAL, EINVAL,
+            dp_reply_std_set(_reply, DP_ERR_FATAL, EINVAL,
                              "Invalid filter type");
-            return reply;
+            return EOK;
         }
         if (ctx->ops.initgroups_dyn == NULL) {
-            dp_reply_std_set(&reply, DP_ERR_FATAL, ENODEV,
+            dp_reply_std_set(_reply, DP_ERR_FATAL, ENODEV,
                              "Initgroups call not supported");
-            return reply;
+            return EOK;
         }
-        ret = get_initgr(mem_ctx, ctx, sysdb, domain, data->filter_value);
+        subreq = get_initgr_send(mem_ctx, ctx, sysdb, domain,
+                                 data->filter_value);
+        ret = EAGAIN;
         break;
 
     case BE_REQ_NETGROUP:
         if (data->filter_type != BE_FILTER_NAME) {
-            dp_reply_std_set(&reply, DP_ERR_FATAL, EINVAL,
+            dp_reply_std_set(_reply, DP_ERR_FATAL, EINVAL,
                              "Invalid filter type");
-            return reply;
+            return EOK;
         }
         if (ctx->ops.setnetgrent == NULL || ctx->ops.getnetgrent_r == NULL ||
             ctx->ops.endnetgrent == NULL) {
-            dp_reply_std_set(&reply, DP_ERR_FATAL, ENODEV,
+            dp_reply_std_set(_reply, DP_ERR_FATAL, ENODEV,
                              "Netgroups are not supported");
-            return reply;
+            return EOK;
         }
 
         ret = get_netgroup(ctx, domain, data->filter_value);
@@ -1684,9 +2336,9 @@ proxy_account_info(TALLOC_CTX *mem_ctx,
         switch (data->filter_type) {
         case BE_FILTER_NAME:
             if (ctx->ops.getservbyname_r == NULL) {
-                dp_reply_std_set(&reply, DP_ERR_FATAL, ENODEV,
+                dp_reply_std_set(_reply, DP_ERR_FATAL, ENODEV,
                                  "Services are not supported");
-                return reply;
+                return EOK;
             }
             ret = get_serv_byname(ctx, domain,
                                   data->filter_value,
@@ -1694,9 +2346,9 @@ proxy_account_info(TALLOC_CTX *mem_ctx,
             break;
         case BE_FILTER_IDNUM:
             if (ctx->ops.getservbyport_r == NULL) {
-                dp_reply_std_set(&reply, DP_ERR_FATAL, ENODEV,
+                dp_reply_std_set(_reply, DP_ERR_FATAL, ENODEV,
                                  "Services are not supported");
-                return reply;
+                return EOK;
             }
             ret = get_serv_byport(ctx, domain,
                                   data->filter_value,
@@ -1706,44 +2358,45 @@ proxy_account_info(TALLOC_CTX *mem_ctx,
             if (!ctx->ops.setservent
                     || !ctx->ops.getservent_r
                     || !ctx->ops.endservent) {
-                dp_reply_std_set(&reply, DP_ERR_FATAL, ENODEV,
+                dp_reply_std_set(_reply, DP_ERR_FATAL, ENODEV,
                                  "Services are not supported");
-                return reply;
+                return EOK;
             }
             ret = enum_services(ctx, sysdb, domain);
             break;
         default:
-            dp_reply_std_set(&reply, DP_ERR_FATAL, EINVAL,
+            dp_reply_std_set(_reply, DP_ERR_FATAL, EINVAL,
                              "Invalid filter type");
-            return reply;
+            return EOK;
         }
         break;
 
     default: /*fail*/
-        dp_reply_std_set(&reply, DP_ERR_FATAL, EINVAL,
+        dp_reply_std_set(_reply, DP_ERR_FATAL, EINVAL,
                          "Invalid filter type");
-        return reply;
+        return EOK;
     }
 
-    if (ret) {
-        if (ret == ENXIO) {
-            DEBUG(SSSDBG_OP_FAILURE,
-                  "proxy returned UNAVAIL error, going offline!\n");
-            be_mark_offline(be_ctx);
+    if (ret == EAGAIN) {
+        if (subreq == NULL) {
+            ret = ENOMEM;
+        } else {
+            *_subreq = subreq;
+            return EAGAIN;
         }
-
-        dp_reply_std_set(&reply, DP_ERR_FATAL, ret, NULL);
-        return reply;
     }
 
-    dp_reply_std_set(&reply, DP_ERR_OK, EOK, NULL);
-    return reply;
+    proxy_account_info_reply(_reply, be_ctx, ret);
+    return EOK;
 }
 
 struct proxy_account_info_handler_state {
     struct dp_reply_std reply;
+    struct be_ctx *be_ctx;
 };
 
+static void proxy_account_info_handler_done(struct tevent_req *subreq);
+
 struct tevent_req *
 proxy_account_info_handler_send(TALLOC_CTX *mem_ctx,
                                struct proxy_id_ctx *id_ctx,
@@ -1751,7 +2404,9 @@ proxy_account_info_handler_send(TALLOC_CTX *mem_ctx,
                                struct dp_req_params *params)
 {
     struct proxy_account_info_handler_state *state;
+    struct tevent_req *subreq = NULL;
     struct tevent_req *req;
+    errno_t ret;
 
     req = tevent_req_create(mem_ctx, &state,
                             struct proxy_account_info_handler_state);
@@ -1760,8 +2415,14 @@ proxy_account_info_handler_send(TALLOC_CTX *mem_ctx,
         return NULL;
     }
 
-    state->reply = proxy_account_info(state, id_ctx, data, params->be_ctx,
-                                      params->be_ctx->domain);
+    state->be_ctx = params->be_ctx;
+
+    ret = proxy_account_info(state, id_ctx, data, params->be_ctx,
+                             params->be_ctx->domain, &state->reply, &subreq);
+    if (ret == EAGAIN) {
+        tevent_req_set_callback(subreq, proxy_account_info_handler_done, req);
+        return req;
+    }
 
     /* TODO For backward compatibility we always return EOK to DP now. */
     tevent_req_done(req);
@@ -1770,6 +2431,24 @@ proxy_account_info_handler_send(TALLOC_CTX *mem_ctx,
     return req;
 }
 
+static void proxy_account_info_handler_done(struct tevent_req *subreq)
+{
+    struct proxy_account_info_handler_state *state;
+    struct tevent_req *req;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct proxy_account_info_handler_state);
+
+    ret = proxy_id_op_recv(subreq);
+    talloc_zfree(subreq);
+
+    proxy_account_info_reply(&state->reply, state->be_ctx, ret);
+
+    /* TODO For backward compatibility we always return EOK to DP now. */
+    tevent_req_done(req);
+}
+
 errno_t proxy_account_info_handler_recv(TALLOC_CTX *mem_ctx,
                                        struct tevent_req *req,
                                        struct dp_reply_std *data)
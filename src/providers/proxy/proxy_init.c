@@ -30,6 +30,7 @@
 #define NSS_FN_NAME "_nss_%s_%s"
 
 #define OPT_MAX_CHILDREN_DEFAULT 10
+#define OPT_MAX_THREADS_DEFAULT 0
 
 #define ERROR_INITGR "The '%s' library does not provides the " \
                          "_nss_XXX_initgroups_dyn function!\n" \
@@ -60,12 +61,14 @@ static errno_t proxy_id_conf(TALLOC_CTX *mem_ctx,
                              struct be_ctx *be_ctx,
                              char **_libname,
                              char **_libpath,
-                             bool *_fast_alias)
+                             bool *_fast_alias,
+                             int *_max_threads)
 {
     TALLOC_CTX *tmp_ctx;
     char *libname;
     char *libpath;
     bool fast_alias;
+    int max_threads;
     errno_t ret;
 
     tmp_ctx = talloc_new(NULL);
@@ -94,6 +97,22 @@ static errno_t proxy_id_conf(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
+    ret = confdb_get_int(be_ctx->cdb, be_ctx->conf_path,
+                         CONFDB_PROXY_MAX_THREADS, OPT_MAX_THREADS_DEFAULT,
+                         &max_threads);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to read confdb [%d]: %s\n",
+              ret, sss_strerror(ret));
+        goto done;
+    }
+
+    if (max_threads < 0) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Option " CONFDB_PROXY_MAX_THREADS " must not be negative\n");
+        ret = EINVAL;
+        goto done;
+    }
+
     libpath = talloc_asprintf(tmp_ctx, "libnss_%s.so.2", libname);
     if (libpath == NULL) {
         DEBUG(SSSDBG_CRIT_FAILURE, "talloc_asprintf() failed\n");
@@ -104,6 +123,7 @@ static errno_t proxy_id_conf(TALLOC_CTX *mem_ctx,
     *_libname = talloc_steal(mem_ctx, libname);
     *_libpath = talloc_steal(mem_ctx, libpath);
     *_fast_alias = fast_alias;
+    *_max_threads = max_threads;
 
     ret = EOK;
 
@@ -164,31 +184,6 @@ static errno_t proxy_id_load_symbols(struct proxy_nss_ops *ops,
     return EOK;
 }
 
-static errno_t proxy_setup_sbus(TALLOC_CTX *mem_ctx,
-                                struct proxy_auth_ctx *ctx,
-                                struct be_ctx *be_ctx)
-{
-    char *sbus_address;
-    errno_t ret;
-
-    sbus_address = talloc_asprintf(mem_ctx, "unix:path=%s/%s_%s", PIPE_PATH,
-                                   PROXY_CHILD_PIPE, be_ctx->domain->name);
-    if (sbus_address == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "talloc_asprintf() failed.\n");
-        return ENOMEM;
-    }
-
-    ret = sbus_new_server(mem_ctx, be_ctx->ev, sbus_address, 0, be_ctx->gid,
-                          false, &ctx->sbus_srv, proxy_client_init, ctx, NULL);
-    talloc_free(sbus_address);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_FATAL_FAILURE, "Could not set up sbus server.\n");
-        return ret;
-    }
-
-    return EOK;
-}
-
 static errno_t proxy_auth_conf(TALLOC_CTX *mem_ctx,
                                struct be_ctx *be_ctx,
                                char **_pam_target)
@@ -221,7 +216,6 @@ static errno_t proxy_init_auth_ctx(TALLOC_CTX *mem_ctx,
 {
     struct proxy_auth_ctx *auth_ctx;
     errno_t ret;
-    int hret;
     int max_children;
 
     auth_ctx = talloc_zero(mem_ctx, struct proxy_auth_ctx);
@@ -231,19 +225,12 @@ static errno_t proxy_init_auth_ctx(TALLOC_CTX *mem_ctx,
 
     auth_ctx->be = be_ctx;
     auth_ctx->timeout_ms = SSS_CLI_SOCKET_TIMEOUT / 4;
-    auth_ctx->next_id = 1;
 
     ret = proxy_auth_conf(auth_ctx, be_ctx, &auth_ctx->pam_target);
     if (ret != EOK) {
         goto done;
     }
 
-    ret = proxy_setup_sbus(auth_ctx, auth_ctx, be_ctx);
-    if (ret != EOK) {
-        goto done;
-    }
-
-    /* Set up request hash table */
     ret = confdb_get_int(be_ctx->cdb, be_ctx->conf_path,
                          CONFDB_PROXY_MAX_CHILDREN,
                          OPT_MAX_CHILDREN_DEFAULT,
@@ -262,14 +249,6 @@ static errno_t proxy_init_auth_ctx(TALLOC_CTX *mem_ctx,
     }
     auth_ctx->max_children = max_children;
 
-    hret = hash_create(auth_ctx->max_children * 2, &auth_ctx->request_table,
-                       NULL, NULL);
-    if (hret != HASH_SUCCESS) {
-        DEBUG(SSSDBG_FATAL_FAILURE, "Could not initialize request table\n");
-        ret = EIO;
-        goto done;
-    }
-
     *_auth_ctx = auth_ctx;
 
     ret = EOK;
@@ -318,6 +297,7 @@ errno_t sssm_proxy_id_init(TALLOC_CTX *mem_ctx,
     struct proxy_id_ctx *ctx;
     char *libname;
     char *libpath;
+    int max_threads;
     errno_t ret;
 
     ctx = talloc_zero(mem_ctx, struct proxy_id_ctx);
@@ -327,7 +307,8 @@ errno_t sssm_proxy_id_init(TALLOC_CTX *mem_ctx,
 
     ctx->be = be_ctx;
 
-    ret = proxy_id_conf(ctx, be_ctx, &libname, &libpath, &ctx->fast_alias);
+    ret = proxy_id_conf(ctx, be_ctx, &libname, &libpath, &ctx->fast_alias,
+                        &max_threads);
     if (ret != EOK) {
         goto done;
     }
@@ -347,6 +328,13 @@ errno_t sssm_proxy_id_init(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
+    ret = proxy_thread_pool_init(ctx, be_ctx->ev, max_threads, &ctx->threads);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE, "Unable to set up worker threads "
+              "[%d]: %s\n", ret, sss_strerror(ret));
+        goto done;
+    }
+
     dp_set_method(dp_methods, DPM_ACCOUNT_HANDLER,
                   proxy_account_info_handler_send, proxy_account_info_handler_recv, ctx,
                   struct proxy_id_ctx, struct dp_id_data, struct dp_reply_std);
@@ -0,0 +1,508 @@
+/*
+    SSSD
+
+    proxy_threads.c - worker threads for blocking NSS calls
+
+    Copyright (C) 2017 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "providers/proxy/proxy.h"
+
+/*
+ * The wrapped NSS module is called from a small pool of worker threads so
+ * that a slow lookup does not block the event loop of the back end. Only
+ * the job function runs in a worker thread. Everything else, including the
+ * tevent request that waits for the job, lives in the main thread.
+ *
+ * Finished jobs are handed back through a pipe that is watched by the
+ * event loop. The lock protects the two job lists and the thread counters.
+ *
+ * The state the workers use is kept apart from the pool. A worker that is
+ * stuck in the NSS module when the pool is freed keeps using it, so it is
+ * left allocated in that case instead of blocking the shutdown.
+ *
+ * With max_threads set to 0 no thread is started and the job function
+ * is called directly from proxy_thread_job_send().
+ */
+
+/* Seconds an idle worker waits for a new job before it exits */
+#define PROXY_THREAD_IDLE_TIMEOUT 60
+
+/* Seconds the pool waits for the running jobs when it is freed */
+#define PROXY_THREAD_SHUTDOWN_TIMEOUT 5
+
+struct proxy_thread_job {
+    struct proxy_thread_job *prev, *next;
+
+    proxy_thread_fn fn;
+    void *pvt;
+
+    /* NULL if the caller is no longer interested in the result */
+    struct tevent_req *req;
+};
+
+/* Allocated on the NULL context, the jobs are its children */
+struct proxy_thread_shared {
+    int notify_fd[2];
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+
+    int max_threads;
+    int num_threads;
+    int idle_threads;
+    int queued_jobs;
+    bool shutdown;
+
+    /* jobs waiting for a worker, oldest first */
+    struct proxy_thread_job *queue;
+    struct proxy_thread_job *queue_tail;
+
+    /* jobs the workers are finished with */
+    struct proxy_thread_job *finished;
+};
+
+struct proxy_thread_pool {
+    struct tevent_context *ev;
+    struct tevent_fd *fde;
+    int max_threads;
+
+    /* NULL if the jobs are run in-line */
+    struct proxy_thread_shared *shared;
+};
+
+struct proxy_thread_job_state {
+    struct proxy_thread_job *job;
+    void *pvt;
+};
+
+static void proxy_thread_deadline(struct timespec *ts, int seconds)
+{
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += seconds;
+}
+
+static void *proxy_thread_main(void *arg)
+{
+    struct proxy_thread_shared *shared = arg;
+    struct proxy_thread_job *job;
+    struct timespec deadline;
+    ssize_t len;
+    int ret;
+
+    pthread_mutex_lock(&shared->lock);
+
+    while (true) {
+        proxy_thread_deadline(&deadline, PROXY_THREAD_IDLE_TIMEOUT);
+        ret = 0;
+        while (shared->queue == NULL && !shared->shutdown && ret == 0) {
+            shared->idle_threads++;
+            ret = pthread_cond_timedwait(&shared->cond, &shared->lock,
+                                         &deadline);
+            shared->idle_threads--;
+        }
+
+        if (shared->shutdown || shared->queue == NULL) {
+            /* shut down or idle for too long */
+            break;
+        }
+
+        job = shared->queue;
+        shared->queue = job->next;
+        if (shared->queue == NULL) {
+            shared->queue_tail = NULL;
+        }
+        shared->queued_jobs--;
+
+        pthread_mutex_unlock(&shared->lock);
+
+        job->fn(job->pvt);
+
+        pthread_mutex_lock(&shared->lock);
+
+        DLIST_ADD(shared->finished, job);
+
+        /* A full pipe already guarantees a wakeup */
+        do {
+            len = write(shared->notify_fd[1], "", 1);
+        } while (len == -1 && errno == EINTR);
+    }
+
+    shared->num_threads--;
+    pthread_cond_broadcast(&shared->cond);
+    pthread_mutex_unlock(&shared->lock);
+
+    return NULL;
+}
+
+/* Must be called with the lock held */
+static errno_t proxy_thread_spawn(struct proxy_thread_shared *shared)
+{
+    pthread_attr_t attr;
+    pthread_t thread;
+    sigset_t all;
+    sigset_t orig;
+    int ret;
+
+    ret = pthread_attr_init(&attr);
+    if (ret != 0) {
+        return ret;
+    }
+
+    ret = pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (ret != 0) {
+        pthread_attr_destroy(&attr);
+        return ret;
+    }
+
+    /* Signals are handled by tevent in the main thread only, the new
+     * thread inherits the blocked mask */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &orig);
+    ret = pthread_create(&thread, &attr, proxy_thread_main, shared);
+    pthread_sigmask(SIG_SETMASK, &orig, NULL);
+    pthread_attr_destroy(&attr);
+    if (ret != 0) {
+        return ret;
+    }
+
+    shared->num_threads++;
+    return EOK;
+}
+
+static void proxy_thread_job_finish(struct proxy_thread_job *job);
+
+static void proxy_thread_pool_notify(struct tevent_context *ev,
+                                     struct tevent_fd *fde,
+                                     uint16_t flags,
+                                     void *pvt)
+{
+    struct proxy_thread_shared *shared;
+    struct proxy_thread_job *finished;
+    struct proxy_thread_job *job;
+    struct proxy_thread_job *next;
+    char buf[64];
+    ssize_t len;
+
+    shared = talloc_get_type(pvt, struct proxy_thread_shared);
+
+    do {
+        len = read(shared->notify_fd[0], buf, sizeof(buf));
+    } while (len > 0 || (len == -1 && errno == EINTR));
+
+    pthread_mutex_lock(&shared->lock);
+    finished = shared->finished;
+    shared->finished = NULL;
+    pthread_mutex_unlock(&shared->lock);
+
+    DLIST_FOR_EACH_SAFE(job, next, finished) {
+        proxy_thread_job_finish(job);
+    }
+}
+
+static int proxy_thread_pool_destructor(struct proxy_thread_pool *pool)
+{
+    struct proxy_thread_shared *shared = pool->shared;
+    struct proxy_thread_job_state *state;
+    struct proxy_thread_job *finished;
+    struct proxy_thread_job *queue;
+    struct proxy_thread_job *job;
+    struct proxy_thread_job *next;
+    struct timespec deadline;
+    int num_threads;
+    int ret = 0;
+
+    talloc_zfree(pool->fde);
+
+    pthread_mutex_lock(&shared->lock);
+
+    shared->shutdown = true;
+    pthread_cond_broadcast(&shared->cond);
+
+    /* Jobs that were not picked up yet are cancelled */
+    queue = shared->queue;
+    shared->queue = NULL;
+    shared->queue_tail = NULL;
+    shared->queued_jobs = 0;
+
+    /* Wait for the jobs that are running at the moment, but do not let
+     * a hanging NSS module block the shutdown */
+    proxy_thread_deadline(&deadline, PROXY_THREAD_SHUTDOWN_TIMEOUT);
+    while (shared->num_threads > 0 && ret == 0) {
+        ret = pthread_cond_timedwait(&shared->cond, &shared->lock, &deadline);
+    }
+
+    num_threads = shared->num_threads;
+    finished = shared->finished;
+    shared->finished = NULL;
+
+    pthread_mutex_unlock(&shared->lock);
+
+    DLIST_FOR_EACH_SAFE(job, next, finished) {
+        proxy_thread_job_finish(job);
+    }
+
+    while (queue != NULL) {
+        job = queue;
+        queue = job->next;
+        if (job->req != NULL) {
+            state = tevent_req_data(job->req, struct proxy_thread_job_state);
+            state->job = NULL;
+            tevent_req_error(job->req, ECANCELED);
+        }
+        talloc_free(job);
+    }
+
+    if (num_threads > 0) {
+        /* The workers still use the shared state and the jobs they run */
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "%d worker thread(s) did not finish in %d seconds, "
+              "leaving them behind\n",
+              num_threads, PROXY_THREAD_SHUTDOWN_TIMEOUT);
+        return 0;
+    }
+
+    close(shared->notify_fd[0]);
+    close(shared->notify_fd[1]);
+    pthread_cond_destroy(&shared->cond);
+    pthread_mutex_destroy(&shared->lock);
+    talloc_free(shared);
+
+    return 0;
+}
+
+errno_t proxy_thread_pool_init(TALLOC_CTX *mem_ctx,
+                               struct tevent_context *ev,
+                               int max_threads,
+                               struct proxy_thread_pool **_pool)
+{
+    struct proxy_thread_shared *shared;
+    struct proxy_thread_pool *pool;
+    int ret;
+
+    if (max_threads < 0) {
+        return EINVAL;
+    }
+
+    pool = talloc_zero(mem_ctx, struct proxy_thread_pool);
+    if (pool == NULL) {
+        return ENOMEM;
+    }
+
+    pool->ev = ev;
+    pool->max_threads = max_threads;
+
+    if (max_threads == 0) {
+        *_pool = pool;
+        return EOK;
+    }
+
+    shared = talloc_zero(NULL, struct proxy_thread_shared);
+    if (shared == NULL) {
+        talloc_free(pool);
+        return ENOMEM;
+    }
+
+    shared->max_threads = max_threads;
+
+    ret = pipe(shared->notify_fd);
+    if (ret != 0) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, "pipe failed [%d]: %s\n",
+              ret, sss_strerror(ret));
+        talloc_free(shared);
+        talloc_free(pool);
+        return ret;
+    }
+
+    ret = pthread_mutex_init(&shared->lock, NULL);
+    if (ret != 0) {
+        close(shared->notify_fd[0]);
+        close(shared->notify_fd[1]);
+        talloc_free(shared);
+        talloc_free(pool);
+        return ret;
+    }
+
+    ret = pthread_cond_init(&shared->cond, NULL);
+    if (ret != 0) {
+        pthread_mutex_destroy(&shared->lock);
+        close(shared->notify_fd[0]);
+        close(shared->notify_fd[1]);
+        talloc_free(shared);
+        talloc_free(pool);
+        return ret;
+    }
+
+    pool->shared = shared;
+    talloc_set_destructor(pool, proxy_thread_pool_destructor);
+
+    ret = sss_fd_nonblocking(shared->notify_fd[0]);
+    if (ret == EOK) {
+        ret = sss_fd_nonblocking(shared->notify_fd[1]);
+    }
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Cannot set up the notify pipe\n");
+        goto done;
+    }
+
+    /* children forked by the back end must not inherit the pipe */
+    fcntl(shared->notify_fd[0], F_SETFD, FD_CLOEXEC);
+    fcntl(shared->notify_fd[1], F_SETFD, FD_CLOEXEC);
+
+    pool->fde = tevent_add_fd(ev, pool, shared->notify_fd[0], TEVENT_FD_READ,
+                              proxy_thread_pool_notify, shared);
+    if (pool->fde == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    *_pool = pool;
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        talloc_free(pool);
+    }
+    return ret;
+}
+
+static int proxy_thread_job_state_destructor(struct proxy_thread_job_state *state)
+{
+    /* The job is owned by the pool, it will be freed once the worker
+     * is done with it */
+    if (state->job != NULL) {
+        state->job->req = NULL;
+    }
+
+    return 0;
+}
+
+struct tevent_req *proxy_thread_job_send(TALLOC_CTX *mem_ctx,
+                                         struct tevent_context *ev,
+                                         struct proxy_thread_pool *pool,
+                                         proxy_thread_fn fn,
+                                         void *pvt)
+{
+    struct proxy_thread_job_state *state;
+    struct proxy_thread_shared *shared;
+    struct proxy_thread_job *job;
+    struct tevent_req *req;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct proxy_thread_job_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    if (pool->shared == NULL) {
+        /* No worker threads, the NSS module is called in-line */
+        fn(pvt);
+        state->pvt = talloc_steal(state, pvt);
+        tevent_req_done(req);
+        tevent_req_post(req, ev);
+        return req;
+    }
+    shared = pool->shared;
+
+    job = talloc_zero(shared, struct proxy_thread_job);
+    if (job == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    job->fn = fn;
+    job->req = req;
+    /* The data must not go away while a worker is using it */
+    job->pvt = talloc_steal(job, pvt);
+
+    pthread_mutex_lock(&shared->lock);
+
+    if (shared->idle_threads <= shared->queued_jobs
+            && shared->num_threads < shared->max_threads) {
+        ret = proxy_thread_spawn(shared);
+        if (ret != EOK && shared->num_threads == 0) {
+            pthread_mutex_unlock(&shared->lock);
+            DEBUG(SSSDBG_CRIT_FAILURE, "Cannot create worker thread "
+                  "[%d]: %s\n", ret, sss_strerror(ret));
+            talloc_steal(state, pvt);
+            talloc_free(job);
+            goto immediately;
+        }
+    }
+
+    if (shared->queue_tail == NULL) {
+        shared->queue = job;
+    } else {
+        shared->queue_tail->next = job;
+    }
+    shared->queue_tail = job;
+    shared->queued_jobs++;
+
+    pthread_cond_signal(&shared->cond);
+    pthread_mutex_unlock(&shared->lock);
+
+    state->job = job;
+    talloc_set_destructor(state, proxy_thread_job_state_destructor);
+
+    return req;
+
+immediately:
+    tevent_req_error(req, ret);
+    tevent_req_post(req, ev);
+    return req;
+}
+
+static void proxy_thread_job_finish(struct proxy_thread_job *job)
+{
+    struct proxy_thread_job_state *state;
+    struct tevent_req *req = job->req;
+
+    if (req == NULL) {
+        talloc_free(job);
+        return;
+    }
+
+    state = tevent_req_data(req, struct proxy_thread_job_state);
+    state->job = NULL;
+    state->pvt = talloc_steal(state, job->pvt);
+    talloc_free(job);
+
+    tevent_req_done(req);
+}
+
+errno_t proxy_thread_job_recv(TALLOC_CTX *mem_ctx,
+                              struct tevent_req *req,
+                              void **_pvt)
+{
+    struct proxy_thread_job_state *state;
+
+    state = tevent_req_data(req, struct proxy_thread_job_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    *_pvt = talloc_steal(mem_ctx, state->pvt);
+
+    return EOK;
+}
@@ -62,6 +62,9 @@
 
 #define RESOLV_TIMEOUTMS  2000
 
+/* Maximum number of names kept in the DNS answer cache */
+#define RESOLV_CACHE_MAX_ENTRIES 256
+
 enum host_database default_host_dbs[] = { DB_FILES, DB_DNS, DB_SENTINEL };
 
 struct fd_watch {
@@ -87,6 +90,37 @@ struct resolv_ctx {
      * if our pending requests didn't timeout. */
     int pending_requests;
     struct tevent_timer *timeout_watcher;
+
+    /* Cache of DNS answers, most recently used entries first */
+    bool cache_enabled;
+    int cache_negative_ttl;
+    int cache_stale_time;
+    struct resolv_cache_entry *cache;
+    size_t cache_count;
+};
+
+enum resolv_cache_type {
+    RESOLV_CACHE_A,
+    RESOLV_CACHE_AAAA,
+    RESOLV_CACHE_SRV
+};
+
+struct resolv_cache_entry {
+    struct resolv_cache_entry *prev;
+    struct resolv_cache_entry *next;
+
+    struct resolv_ctx *ctx;
+    enum resolv_cache_type type;
+    char *name;
+
+    /* ARES_SUCCESS for positive answers, ARES_ENOTFOUND or ARES_ENODATA
+     * for negative ones */
+    int status;
+    time_t expire;
+    bool refreshing;
+
+    struct resolv_hostent *rhostent;
+    struct ares_srv_reply *srv_list;
 };
 
 struct request_watch {
@@ -483,10 +517,15 @@ done:
     return ret;
 }
 
+static void resolv_cache_flush(struct resolv_ctx *ctx);
+
 void
 resolv_reread_configuration(struct resolv_ctx *ctx)
 {
     recreate_ares_channel(ctx);
+
+    /* The answers might come from servers which are no longer configured */
+    resolv_cache_flush(ctx);
 }
 
 static errno_t
@@ -661,6 +700,523 @@ fail:
     return NULL;
 }
 
+/* =================== DNS answer cache ===================================*/
+
+static struct tevent_req *
+resolv_gethostbyname_dns_send(TALLOC_CTX *mem_ctx, struct tevent_context *ev,
+                              struct resolv_ctx *ctx, const char *name,
+                              int family);
+static void
+resolv_gethostbyname_dns_bypass_cache(struct tevent_req *req);
+static void
+resolv_getsrv_bypass_cache(struct tevent_req *req);
+
+static int
+resolv_cache_entry_destructor(struct resolv_cache_entry *entry)
+{
+    DLIST_REMOVE(entry->ctx->cache, entry);
+    entry->ctx->cache_count--;
+
+    return 0;
+}
+
+static void
+resolv_cache_flush(struct resolv_ctx *ctx)
+{
+    while (ctx->cache != NULL) {
+        talloc_free(ctx->cache);
+    }
+}
+
+void
+resolv_set_cache(struct resolv_ctx *ctx, bool enabled,
+                 int negative_ttl, int stale_time)
+{
+    ctx->cache_enabled = enabled;
+    ctx->cache_negative_ttl = negative_ttl < 0 ? 0 : negative_ttl;
+    ctx->cache_stale_time = stale_time < 0 ? 0 : stale_time;
+
+    DEBUG(SSSDBG_CONF_SETTINGS, "DNS answer cache is %s, negative TTL %d, "
+          "stale time %d\n", enabled ? "enabled" : "disabled",
+          ctx->cache_negative_ttl, ctx->cache_stale_time);
+
+    if (!enabled) {
+        resolv_cache_flush(ctx);
+    }
+}
+
+static enum resolv_cache_type
+resolv_cache_family_type(int family)
+{
+    return family == AF_INET6 ? RESOLV_CACHE_AAAA : RESOLV_CACHE_A;
+}
+
+static struct resolv_cache_entry *
+resolv_cache_find(struct resolv_ctx *ctx, enum resolv_cache_type type,
+                  const char *name)
+{
+    struct resolv_cache_entry *entry;
+
+    DLIST_FOR_EACH(entry, ctx->cache) {
+        if (entry->type == type && strcasecmp(entry->name, name) == 0) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+static struct resolv_cache_entry *
+resolv_cache_get_entry(struct resolv_ctx *ctx, enum resolv_cache_type type,
+                       const char *name)
+{
+    struct resolv_cache_entry *entry;
+
+    entry = resolv_cache_find(ctx, type, name);
+    if (entry != NULL) {
+        return entry;
+    }
+
+    /* Evict the least recently used entries. An entry that is being
+     * refreshed owns the request that might be storing this answer, it is
+     * skipped and the cache may exceed the limit until a later eviction. */
+    while (ctx->cache_count >= RESOLV_CACHE_MAX_ENTRIES) {
+        for (entry = ctx->cache; entry->next != NULL; entry = entry->next);
+        while (entry != NULL && entry->refreshing) {
+            entry = entry->prev;
+        }
+
+        if (entry == NULL) {
+            break;
+        }
+        talloc_free(entry);
+    }
+
+    entry = talloc_zero(ctx, struct resolv_cache_entry);
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    entry->name = talloc_strdup(entry, name);
+    if (entry->name == NULL) {
+        talloc_free(entry);
+        return NULL;
+    }
+
+    entry->ctx = ctx;
+    entry->type = type;
+    DLIST_ADD(ctx->cache, entry);
+    ctx->cache_count++;
+    talloc_set_destructor(entry, resolv_cache_entry_destructor);
+
+    return entry;
+}
+
+/* Makes the entry unusable without freeing it, it is reused by the next
+ * answer for the same name or evicted. */
+static void
+resolv_cache_invalidate(struct resolv_cache_entry *entry)
+{
+    entry->expire = 0;
+    talloc_zfree(entry->rhostent);
+    talloc_zfree(entry->srv_list);
+}
+
+static bool
+resolv_cache_is_negative_status(int status)
+{
+    return status == ARES_ENOTFOUND || status == ARES_ENODATA;
+}
+
+/* Returns the entry if it can be used to answer a query. The remaining
+ * TTL is zero if the entry is stale and is being refreshed. */
+static struct resolv_cache_entry *
+resolv_cache_lookup(struct resolv_ctx *ctx, enum resolv_cache_type type,
+                    const char *name, uint32_t *_remaining_ttl,
+                    bool *_stale)
+{
+    struct resolv_cache_entry *entry;
+    time_t now;
+
+    if (!ctx->cache_enabled) {
+        return NULL;
+    }
+
+    entry = resolv_cache_find(ctx, type, name);
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    now = time(NULL);
+    if (now < entry->expire) {
+        *_remaining_ttl = entry->expire - now;
+        *_stale = false;
+    } else if (entry->status == ARES_SUCCESS
+                   && now < entry->expire + ctx->cache_stale_time) {
+        *_remaining_ttl = 0;
+        *_stale = true;
+    } else {
+        return NULL;
+    }
+
+    /* Keep the most recently used entries at the head of the list */
+    DLIST_PROMOTE(ctx->cache, entry);
+
+    return entry;
+}
+
+static struct resolv_hostent *
+resolv_cache_copy_hostent(TALLOC_CTX *mem_ctx, struct resolv_hostent *src,
+                          uint32_t ttl)
+{
+    struct resolv_hostent *ret;
+    size_t addr_len;
+    size_t len;
+    size_t i;
+
+    ret = talloc_zero(mem_ctx, struct resolv_hostent);
+    if (ret == NULL) {
+        return NULL;
+    }
+
+    ret->family = src->family;
+    addr_len = src->family == AF_INET6 ? sizeof(struct in6_addr)
+                                       : sizeof(struct in_addr);
+
+    if (src->name != NULL) {
+        ret->name = talloc_strdup(ret, src->name);
+        if (ret->name == NULL) {
+            goto fail;
+        }
+    }
+
+    if (src->aliases != NULL) {
+        for (len = 0; src->aliases[len] != NULL; len++);
+
+        ret->aliases = talloc_zero_array(ret, char *, len + 1);
+        if (ret->aliases == NULL) {
+            goto fail;
+        }
+
+        for (i = 0; i < len; i++) {
+            ret->aliases[i] = talloc_strdup(ret->aliases, src->aliases[i]);
+            if (ret->aliases[i] == NULL) {
+                goto fail;
+            }
+        }
+    }
+
+    if (src->addr_list != NULL) {
+        for (len = 0; src->addr_list[len] != NULL; len++);
+
+        ret->addr_list = talloc_zero_array(ret, struct resolv_addr *, len + 1);
+        if (ret->addr_list == NULL) {
+            goto fail;
+        }
+
+        for (i = 0; i < len; i++) {
+            ret->addr_list[i] = talloc_zero(ret->addr_list,
+                                            struct resolv_addr);
+            if (ret->addr_list[i] == NULL) {
+                goto fail;
+            }
+
+            ret->addr_list[i]->ipaddr = talloc_memdup(ret->addr_list[i],
+                                                src->addr_list[i]->ipaddr,
+                                                addr_len);
+            if (ret->addr_list[i]->ipaddr == NULL) {
+                goto fail;
+            }
+
+            ret->addr_list[i]->ttl = ttl;
+        }
+    }
+
+    return ret;
+
+fail:
+    talloc_free(ret);
+    return NULL;
+}
+
+static struct ares_srv_reply *
+resolv_cache_copy_srv_list(TALLOC_CTX *mem_ctx, struct ares_srv_reply *src)
+{
+    struct ares_srv_reply *new_list = NULL;
+    struct ares_srv_reply *ptr = NULL;
+    struct ares_srv_reply *item;
+
+    for (; src != NULL; src = src->next) {
+        item = talloc_zero(new_list == NULL ? mem_ctx : (void *) new_list,
+                           struct ares_srv_reply);
+        if (item == NULL) {
+            talloc_free(new_list);
+            return NULL;
+        }
+
+        item->weight = src->weight;
+        item->priority = src->priority;
+        item->port = src->port;
+        item->host = talloc_strdup(item, src->host);
+        if (item->host == NULL) {
+            talloc_free(item);
+            talloc_free(new_list);
+            return NULL;
+        }
+
+        if (new_list == NULL) {
+            new_list = item;
+        } else {
+            ptr->next = item;
+        }
+        ptr = item;
+    }
+
+    return new_list;
+}
+
+static void
+resolv_cache_store_host(struct resolv_ctx *ctx, const char *name, int family,
+                        int status, struct resolv_hostent *rhostent)
+{
+    struct resolv_cache_entry *entry;
+    struct resolv_hostent *copy = NULL;
+    uint32_t ttl;
+    size_t i;
+
+    if (!ctx->cache_enabled) {
+        return;
+    }
+
+    if (status == ARES_SUCCESS) {
+        if (rhostent == NULL || rhostent->addr_list == NULL
+                || rhostent->addr_list[0] == NULL) {
+            return;
+        }
+
+        ttl = rhostent->addr_list[0]->ttl;
+        for (i = 1; rhostent->addr_list[i] != NULL; i++) {
+            ttl = MIN(ttl, rhostent->addr_list[i]->ttl);
+        }
+    } else if (resolv_cache_is_negative_status(status)) {
+        ttl = ctx->cache_negative_ttl;
+    } else {
+        /* Do not replace a usable answer with a transient failure */
+        return;
+    }
+
+    if (ttl == 0) {
+        return;
+    }
+
+    entry = resolv_cache_get_entry(ctx, resolv_cache_family_type(family),
+                                   name);
+    if (entry == NULL) {
+        return;
+    }
+
+    if (status == ARES_SUCCESS) {
+        copy = resolv_cache_copy_hostent(entry, rhostent, ttl);
+        if (copy == NULL) {
+            /* This might be called by the refresh request of the entry */
+            resolv_cache_invalidate(entry);
+            return;
+        }
+    }
+
+    talloc_zfree(entry->rhostent);
+    entry->rhostent = copy;
+    entry->status = status;
+    entry->expire = time(NULL) + ttl;
+
+    DEBUG(SSSDBG_TRACE_INTERNAL, "Cached %s answer for '%s' for %"PRIu32
+          " seconds\n", status == ARES_SUCCESS ? "positive" : "negative",
+          name, ttl);
+}
+
+static void
+resolv_cache_store_srv(struct resolv_ctx *ctx, const char *name,
+                       int status, struct ares_srv_reply *reply_list,
+                       uint32_t ttl)
+{
+    struct resolv_cache_entry *entry;
+    struct ares_srv_reply *copy = NULL;
+
+    if (!ctx->cache_enabled) {
+        return;
+    }
+
+    if (status == ARES_SUCCESS) {
+        if (reply_list == NULL) {
+            return;
+        }
+    } else if (resolv_cache_is_negative_status(status)) {
+        ttl = ctx->cache_negative_ttl;
+    } else {
+        /* Do not replace a usable answer with a transient failure */
+        return;
+    }
+
+    if (ttl == 0) {
+        return;
+    }
+
+    entry = resolv_cache_get_entry(ctx, RESOLV_CACHE_SRV, name);
+    if (entry == NULL) {
+        return;
+    }
+
+    if (status == ARES_SUCCESS) {
+        copy = resolv_cache_copy_srv_list(entry, reply_list);
+        if (copy == NULL) {
+            /* This might be called by the refresh request of the entry */
+            resolv_cache_invalidate(entry);
+            return;
+        }
+    }
+
+    talloc_zfree(entry->srv_list);
+    entry->srv_list = copy;
+    entry->status = status;
+    entry->expire = time(NULL) + ttl;
+
+    DEBUG(SSSDBG_TRACE_INTERNAL, "Cached %s SRV answer for '%s' for %"PRIu32
+          " seconds\n", status == ARES_SUCCESS ? "positive" : "negative",
+          name, ttl);
+}
+
+static void resolv_cache_refresh_done(struct tevent_req *subreq);
+
+/* Resolves the name of a stale entry again in the background, the answer
+ * is stored by the query itself. */
+static void
+resolv_cache_refresh(struct resolv_cache_entry *entry)
+{
+    struct tevent_req *subreq;
+
+    if (entry->refreshing || entry->ctx->channel == NULL) {
+        return;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Refreshing stale DNS answer for '%s'\n",
+          entry->name);
+
+    switch (entry->type) {
+    case RESOLV_CACHE_A:
+    case RESOLV_CACHE_AAAA:
+        subreq = resolv_gethostbyname_dns_send(entry, entry->ctx->ev_ctx,
+                                               entry->ctx, entry->name,
+                                               entry->type == RESOLV_CACHE_A
+                                                        ? AF_INET : AF_INET6);
+        if (subreq != NULL) {
+            resolv_gethostbyname_dns_bypass_cache(subreq);
+        }
+        break;
+    case RESOLV_CACHE_SRV:
+        subreq = resolv_getsrv_send(entry, entry->ctx->ev_ctx, entry->ctx,
+                                    entry->name);
+        if (subreq != NULL) {
+            resolv_getsrv_bypass_cache(subreq);
+        }
+        break;
+    default:
+        return;
+    }
+
+    if (subreq == NULL) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unable to refresh '%s'\n", entry->name);
+        return;
+    }
+
+    entry->refreshing = true;
+    tevent_req_set_callback(subreq, resolv_cache_refresh_done, entry);
+}
+
+static void
+resolv_cache_refresh_done(struct tevent_req *subreq)
+{
+    struct resolv_cache_entry *entry;
+
+    entry = tevent_req_callback_data(subreq, struct resolv_cache_entry);
+
+    /* The result was already stored, if the refresh failed the stale entry
+     * is kept until its stale time runs out. */
+    talloc_free(subreq);
+    entry->refreshing = false;
+}
+
+static bool
+resolv_cache_get_host(TALLOC_CTX *mem_ctx, struct resolv_ctx *ctx,
+                      const char *name, int family,
+                      struct resolv_hostent **_rhostent, int *_status)
+{
+    struct resolv_cache_entry *entry;
+    struct resolv_hostent *rhostent = NULL;
+    uint32_t ttl;
+    bool stale;
+
+    entry = resolv_cache_lookup(ctx, resolv_cache_family_type(family), name,
+                                &ttl, &stale);
+    if (entry == NULL) {
+        return false;
+    }
+
+    if (entry->status == ARES_SUCCESS) {
+        rhostent = resolv_cache_copy_hostent(mem_ctx, entry->rhostent, ttl);
+        if (rhostent == NULL) {
+            return false;
+        }
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Using %s%s cached answer for '%s'\n",
+          stale ? "stale " : "",
+          entry->status == ARES_SUCCESS ? "positive" : "negative", name);
+
+    if (stale) {
+        resolv_cache_refresh(entry);
+    }
+
+    *_rhostent = rhostent;
+    *_status = entry->status;
+    return true;
+}
+
+static bool
+resolv_cache_get_srv(TALLOC_CTX *mem_ctx, struct resolv_ctx *ctx,
+                     const char *name, struct ares_srv_reply **_reply_list,
+                     uint32_t *_ttl, int *_status)
+{
+    struct resolv_cache_entry *entry;
+    struct ares_srv_reply *reply_list = NULL;
+    uint32_t ttl;
+    bool stale;
+
+    entry = resolv_cache_lookup(ctx, RESOLV_CACHE_SRV, name, &ttl, &stale);
+    if (entry == NULL) {
+        return false;
+    }
+
+    if (entry->status == ARES_SUCCESS) {
+        reply_list = resolv_cache_copy_srv_list(mem_ctx, entry->srv_list);
+        if (reply_list == NULL) {
+            return false;
+        }
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Using %s%s cached SRV answer for '%s'\n",
+          stale ? "stale " : "",
+          entry->status == ARES_SUCCESS ? "positive" : "negative", name);
+
+    if (stale) {
+        resolv_cache_refresh(entry);
+    }
+
+    *_reply_list = reply_list;
+    *_ttl = ttl;
+    *_status = entry->status;
+    return true;
+}
+
 /* =================== Resolve host name in files =========================*/
 struct gethostbyname_files_state {
     struct resolv_ctx *resolv_ctx;
@@ -769,6 +1325,8 @@ struct gethostbyname_dns_state {
     int status;
     int timeouts;
     int retrying;
+
+    bool bypass_cache;
 };
 
 static void
@@ -848,9 +1406,30 @@ resolv_gethostbyname_dns_wakeup(struct tevent_req *subreq)
         return;
     }
 
+    if (!state->bypass_cache
+            && resolv_cache_get_host(state, state->resolv_ctx, state->name,
+                                     state->family, &state->rhostent,
+                                     &state->status)) {
+        if (state->status == ARES_SUCCESS) {
+            tevent_req_done(req);
+        } else {
+            tevent_req_error(req, ENOENT);
+        }
+        return;
+    }
+
     resolv_gethostbyname_dns_query(req, state);
 }
 
+static void
+resolv_gethostbyname_dns_bypass_cache(struct tevent_req *req)
+{
+    struct gethostbyname_dns_state *state = tevent_req_data(req,
+                                        struct gethostbyname_dns_state);
+
+    state->bypass_cache = true;
+}
+
 static void
 resolv_gethostbyname_dns_query(struct tevent_req *req,
                                struct gethostbyname_dns_state *state)
@@ -908,6 +1487,9 @@ resolv_gethostbyname_dns_query_done(void *arg, int status, int timeouts,
     }
 
     if (status == ARES_ENOTFOUND || status == ARES_ENODATA) {
+        resolv_cache_store_host(state->resolv_ctx, state->name,
+                                state->family, status, NULL);
+
         /* Just say we didn't find anything and let the caller decide
          * about retrying */
         tevent_req_error(req, ENOENT);
@@ -928,6 +1510,9 @@ resolv_gethostbyname_dns_query_done(void *arg, int status, int timeouts,
         return;
     }
 
+    resolv_cache_store_host(state->resolv_ctx, state->name, state->family,
+                            ARES_SUCCESS, state->rhostent);
+
     tevent_req_done(req);
 }
 
@@ -1566,6 +2151,8 @@ struct getsrv_state {
     int status;
     int timeouts;
     int retrying;
+
+    bool bypass_cache;
 };
 
 static void
@@ -1734,6 +2321,8 @@ resolv_getsrv_done(void *arg, int status, int timeouts, unsigned char *abuf, int
     state->timeouts = timeouts;
 
     if (status != ARES_SUCCESS) {
+        resolv_cache_store_srv(state->resolv_ctx, state->query, status,
+                               NULL, 0);
         ret = return_code(status);
         goto fail;
     }
@@ -1757,6 +2346,9 @@ resolv_getsrv_done(void *arg, int status, int timeouts, unsigned char *abuf, int
     }
     DEBUG(SSSDBG_TRACE_LIBS, "Using TTL [%"PRIu32"]\n", state->ttl);
 
+    resolv_cache_store_srv(state->resolv_ctx, state->query, ARES_SUCCESS,
+                           state->reply_list, state->ttl);
+
     tevent_req_done(req);
     return;
 
@@ -1807,9 +2399,29 @@ ares_getsrv_wakeup(struct tevent_req *subreq)
         return;
     }
 
+    if (!state->bypass_cache
+            && resolv_cache_get_srv(state, state->resolv_ctx, state->query,
+                                    &state->reply_list, &state->ttl,
+                                    &state->status)) {
+        if (state->status == ARES_SUCCESS) {
+            tevent_req_done(req);
+        } else {
+            tevent_req_error(req, return_code(state->status));
+        }
+        return;
+    }
+
     return resolv_getsrv_query(req, state);
 }
 
+static void
+resolv_getsrv_bypass_cache(struct tevent_req *req)
+{
+    struct getsrv_state *state = tevent_req_data(req, struct getsrv_state);
+
+    state->bypass_cache = true;
+}
+
 static void
 resolv_getsrv_query(struct tevent_req *req,
                     struct getsrv_state *state)
@@ -40,6 +40,14 @@
 #define RESOLV_DEFAULT_SRV_TTL 14400
 #endif  /* RESOLV_DEFAULT_SRV_TTL */
 
+#ifndef RESOLV_DEFAULT_NEGATIVE_TTL
+#define RESOLV_DEFAULT_NEGATIVE_TTL 15
+#endif  /* RESOLV_DEFAULT_NEGATIVE_TTL */
+
+#ifndef RESOLV_DEFAULT_STALE_TIME
+#define RESOLV_DEFAULT_STALE_TIME 60
+#endif  /* RESOLV_DEFAULT_STALE_TIME */
+
 #include "util/util.h"
 
 /*
@@ -56,6 +64,15 @@ int resolv_init(TALLOC_CTX *mem_ctx, struct tevent_context *ev_ctx,
 
 void resolv_reread_configuration(struct resolv_ctx *ctx);
 
+/*
+ * Enable or disable the cache of A, AAAA and SRV answers. Positive answers
+ * are kept for their TTL and served for up to stale_time more seconds while
+ * they are refreshed in the background. Negative answers are kept for
+ * negative_ttl seconds. The cache is disabled by default.
+ */
+void resolv_set_cache(struct resolv_ctx *ctx, bool enabled,
+                      int negative_ttl, int stale_time);
+
 const char *resolv_strerror(int ares_code);
 
 struct resolv_hostent *
@@ -24,6 +24,8 @@
 #include <errno.h>
 
 #include "util/util.h"
+#include "util/sss_stats.h"
+#include "util/probes.h"
 #include "responder/common/responder.h"
 #include "responder/common/cache_req/cache_req_private.h"
 #include "responder/common/cache_req/cache_req_plugin.h"
@@ -377,6 +379,49 @@ cache_req_assume_upn(struct cache_req *cr)
     return true;
 }
 
+static struct cache_req *
+cache_req_copy_for_domain(TALLOC_CTX *mem_ctx,
+                          struct cache_req *cr)
+{
+    struct cache_req *copy;
+    struct cache_req_data *data;
+
+    copy = talloc_memdup(mem_ctx, cr, sizeof(struct cache_req));
+    if (copy == NULL) {
+        return NULL;
+    }
+
+    data = talloc_memdup(copy, cr->data, sizeof(struct cache_req_data));
+    if (data == NULL) {
+        talloc_free(copy);
+        return NULL;
+    }
+
+    /* The per-domain values are allocated by the plug-ins on the original
+     * request data and must not be freed through the copy. */
+    if (cr->data->svc.name == &cr->data->name) {
+        data->svc.name = &data->name;
+    }
+    data->name.lookup = NULL;
+    data->svc.protocol.lookup = NULL;
+
+    copy->data = data;
+    copy->domain = NULL;
+    copy->debugobj = NULL;
+
+    return copy;
+}
+
+struct cache_req_domain_slot {
+    struct tevent_req *req;
+    struct tevent_req *subreq;
+    struct cache_req *cr;
+    struct sss_domain_info *domain;
+    struct ldb_result *result;
+    errno_t ret;
+    bool finished;
+};
+
 struct cache_req_search_domains_state {
     /* input data */
     struct tevent_context *ev;
@@ -391,12 +436,33 @@ struct cache_req_search_domains_state {
     bool dp_success;
     bool bypass_cache;
     bool bypass_dp;
+
+    /* Concurrent search, one slot per domain in resolution order. The
+     * cache of each domain is searched first, one domain after another.
+     * Only the domains that are not answered from the cache are then
+     * looked up in the data provider concurrently. */
+    struct cache_req_domain_slot *slots;
+    size_t num_slots;
+    size_t cache_searched;
+    size_t started;
+    size_t resolved;
+    size_t active;
+    size_t concurrency;
 };
 
 static errno_t cache_req_search_domains_next(struct tevent_req *req);
 
 static void cache_req_search_domains_done(struct tevent_req *subreq);
 
+static errno_t
+cache_req_search_domains_parallel_setup(struct tevent_req *req);
+
+static errno_t
+cache_req_search_domains_parallel_cache(struct tevent_req *req);
+
+static errno_t
+cache_req_search_domains_parallel_next(struct tevent_req *req);
+
 struct tevent_req *
 cache_req_search_domains_send(TALLOC_CTX *mem_ctx,
                               struct tevent_context *ev,
@@ -426,7 +492,18 @@ cache_req_search_domains_send(TALLOC_CTX *mem_ctx,
     state->bypass_cache = bypass_cache;
     state->bypass_dp = bypass_dp;
 
-    ret = cache_req_search_domains_next(req);
+    /* Searching only the cache is fast, the domains are queried
+     * concurrently only if the data provider may be contacted. */
+    if (check_next && !bypass_dp && cr->rctx->domain_lookup_concurrency > 1) {
+        state->concurrency = cr->rctx->domain_lookup_concurrency;
+        ret = cache_req_search_domains_parallel_setup(req);
+        if (ret == EOK) {
+            ret = cache_req_search_domains_parallel_cache(req);
+        }
+    } else {
+        ret = cache_req_search_domains_next(req);
+    }
+
     if (ret == EAGAIN) {
         return req;
     }
@@ -441,46 +518,79 @@ cache_req_search_domains_send(TALLOC_CTX *mem_ctx,
     return req;
 }
 
+static bool
+cache_req_search_domains_skip(struct cache_req_search_domains_state *state,
+                              struct cache_req_domain *cr_domain)
+{
+    struct cache_req *cr = state->cr;
+
+    /* As the cr_domain list is a flatten version of the domains
+     * list, we have to ensure to only go through the subdomains in
+     * case it's specified in the plugin to do so.
+     */
+    if (cr->plugin->get_next_domain_flags == 0
+            && IS_SUBDOMAIN(cr_domain->domain)) {
+        return true;
+    }
+
+    /* Check if this domain is valid for this request. */
+    if (!cache_req_validate_domain(cr, cr_domain->domain)) {
+        return true;
+    }
+
+    /* If not specified otherwise, we skip domains that require fully
+     * qualified names on domain less search. We do not descend into
+     * subdomains here since those are implicitly qualified.
+     */
+    if (state->check_next && !cr->plugin->allow_missing_fqn
+            && cr_domain->fqnames) {
+        return true;
+    }
+
+    return false;
+}
+
+static errno_t
+cache_req_search_domains_not_found(struct cache_req_search_domains_state *state)
+{
+    /* If we've got some result from previous searches we want to return
+     * EOK here so the whole cache request is successfully finished. */
+    if (state->num_results > 0) {
+        return EOK;
+    }
+
+    /* We have searched all available domains and no result was found.
+     *
+     * If the plug-in uses a negative cache which is shared among all domains
+     * (e.g. unique identifiers such as user or group id or sid), we add it
+     * here and return object not found error.
+     *
+     * However, we can only set the negative cache if all data provider
+     * requests succeeded because only then we can be sure that it does
+     * not exist-
+     */
+    if (state->dp_success) {
+        cache_req_global_ncache_add(state->cr);
+    }
+
+    return ENOENT;
+}
+
 static errno_t cache_req_search_domains_next(struct tevent_req *req)
 {
     struct cache_req_search_domains_state *state;
     struct tevent_req *subreq;
     struct cache_req *cr;
     struct sss_domain_info *domain;
-    uint32_t next_domain_flag;
-    bool is_domain_valid;
-    bool allow_no_fqn;
     errno_t ret;
 
     state = tevent_req_data(req, struct cache_req_search_domains_state);
     cr = state->cr;
 
-    next_domain_flag = cr->plugin->get_next_domain_flags;
-    allow_no_fqn = cr->plugin->allow_missing_fqn;
-
     while (state->cr_domain != NULL) {
         domain = state->cr_domain->domain;
-        /* As the cr_domain list is a flatten version of the domains
-         * list, we have to ensure to only go through the subdomains in
-         * case it's specified in the plugin to do so.
-         */
-        if (next_domain_flag == 0 && IS_SUBDOMAIN(domain)) {
-            state->cr_domain = state->cr_domain->next;
-            continue;
-        }
-
-        /* Check if this domain is valid for this request. */
-        is_domain_valid = cache_req_validate_domain(cr, domain);
-        if (!is_domain_valid) {
-            state->cr_domain = state->cr_domain->next;
-            continue;
-        }
 
-        /* If not specified otherwise, we skip domains that require fully
-         * qualified names on domain less search. We do not descend into
-         * subdomains here since those are implicitly qualified.
-         */
-        if (state->check_next && !allow_no_fqn && state->cr_domain->fqnames) {
+        if (cache_req_search_domains_skip(state, state->cr_domain)) {
             state->cr_domain = state->cr_domain->next;
             continue;
         }
@@ -512,27 +622,341 @@ static errno_t cache_req_search_domains_next(struct tevent_req *req)
         return EAGAIN;
     }
 
-    /* If we've got some result from previous searches we want to return
-     * EOK here so the whole cache request is successfully finished. */
-    if (state->num_results > 0) {
-        return EOK;
+    return cache_req_search_domains_not_found(state);
+}
+
+static void cache_req_search_domains_parallel_done(struct tevent_req *subreq);
+
+static errno_t
+cache_req_search_domains_parallel_setup(struct tevent_req *req)
+{
+    struct cache_req_search_domains_state *state;
+    struct cache_req_domain *cr_domain;
+    size_t count;
+
+    state = tevent_req_data(req, struct cache_req_search_domains_state);
+
+    count = 0;
+    DLIST_FOR_EACH(cr_domain, state->cr_domain) {
+        if (cr_domain->domain == NULL) {
+            break;
+        }
+        count++;
     }
 
-    /* We have searched all available domains and no result was found.
-     *
-     * If the plug-in uses a negative cache which is shared among all domains
-     * (e.g. unique identifiers such as user or group id or sid), we add it
-     * here and return object not found error.
-     *
-     * However, we can only set the negative cache if all data provider
-     * requests succeeded because only then we can be sure that it does
-     * not exist-
-     */
-    if (state->dp_success) {
-        cache_req_global_ncache_add(cr);
+    state->slots = talloc_zero_array(state, struct cache_req_domain_slot,
+                                     count);
+    if (state->slots == NULL) {
+        return ENOMEM;
     }
 
-    return ENOENT;
+    DLIST_FOR_EACH(cr_domain, state->cr_domain) {
+        if (cr_domain->domain == NULL) {
+            break;
+        }
+
+        if (cache_req_search_domains_skip(state, cr_domain)) {
+            continue;
+        }
+
+        state->slots[state->num_slots].req = req;
+        state->slots[state->num_slots].domain = cr_domain->domain;
+        state->num_slots++;
+    }
+
+    CACHE_REQ_DEBUG(SSSDBG_TRACE_FUNC, state->cr,
+                    "Searching %zu domains, at most %zu at once\n",
+                    state->num_slots, state->concurrency);
+
+    return EOK;
+}
+
+static void cache_req_search_domains_cache_done(struct tevent_req *subreq);
+
+/* Searches the cache of the next domain. The data provider is contacted
+ * here only to refresh an expired object that was found in the cache. */
+static errno_t
+cache_req_search_domains_parallel_cache(struct tevent_req *req)
+{
+    struct cache_req_search_domains_state *state;
+    struct cache_req_domain_slot *slot;
+    struct tevent_req *subreq;
+    errno_t ret;
+
+    state = tevent_req_data(req, struct cache_req_search_domains_state);
+
+    if (state->bypass_cache) {
+        state->cache_searched = state->num_slots;
+    }
+
+    if (state->cache_searched == state->num_slots) {
+        /* Look up the domains that missed in the data provider. */
+        return cache_req_search_domains_parallel_next(req);
+    }
+
+    slot = &state->slots[state->cache_searched];
+
+    slot->cr = cache_req_copy_for_domain(state, state->cr);
+    if (slot->cr == NULL) {
+        return ENOMEM;
+    }
+
+    ret = cache_req_set_domain(slot->cr, slot->domain);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    subreq = cache_req_search_send(state, state->ev, slot->cr, false, true);
+    if (subreq == NULL) {
+        return ENOMEM;
+    }
+
+    tevent_req_set_callback(subreq, cache_req_search_domains_cache_done, slot);
+
+    return EAGAIN;
+}
+
+static void cache_req_search_domains_cache_done(struct tevent_req *subreq)
+{
+    struct cache_req_search_domains_state *state;
+    struct cache_req_domain_slot *slot;
+    struct tevent_req *req;
+    bool dp_success;
+    errno_t ret;
+
+    slot = tevent_req_callback_data(subreq, struct cache_req_domain_slot);
+    req = slot->req;
+    state = tevent_req_data(req, struct cache_req_search_domains_state);
+
+    ret = cache_req_search_recv(slot->cr, subreq, &slot->result,
+                                &dp_success);
+    talloc_zfree(subreq);
+
+    /* Remember if any DP request fails. */
+    state->dp_success = !dp_success ? false : state->dp_success;
+
+    state->cache_searched++;
+
+    switch (ret) {
+    case EOK:
+        slot->ret = EOK;
+        slot->finished = true;
+
+        if (!state->cr->plugin->search_all_domains) {
+            /* A data provider lookup is only needed in the domains that
+             * precede this one in the resolution order. */
+            state->num_slots = state->cache_searched;
+        }
+        ret = cache_req_search_domains_parallel_cache(req);
+        break;
+    case ENOENT:
+        ret = cache_req_search_domains_parallel_cache(req);
+        break;
+    default:
+        break;
+    }
+
+    if (ret == ENOENT && state->results != NULL) {
+        /* We have at least one result. */
+        ret = EOK;
+    }
+
+    switch (ret) {
+    case EOK:
+        tevent_req_done(req);
+        break;
+    case EAGAIN:
+        break;
+    default:
+        tevent_req_error(req, ret);
+        break;
+    }
+}
+
+static void
+cache_req_search_domains_parallel_cancel(
+                               struct cache_req_search_domains_state *state)
+{
+    size_t i;
+
+    for (i = state->resolved; i < state->started; i++) {
+        if (state->slots[i].subreq != NULL) {
+            CACHE_REQ_DEBUG(SSSDBG_TRACE_INTERNAL, state->cr,
+                            "Cancelling search in domain [%s]\n",
+                            state->slots[i].domain->name);
+            talloc_zfree(state->slots[i].subreq);
+            state->active--;
+        }
+    }
+}
+
+/* Process the finished searches in domain resolution order, so the first
+ * match is always taken from the first domain that has the object. */
+static errno_t
+cache_req_search_domains_parallel_resolve(struct tevent_req *req)
+{
+    struct cache_req_search_domains_state *state;
+    struct cache_req_domain_slot *slot;
+    errno_t ret;
+
+    state = tevent_req_data(req, struct cache_req_search_domains_state);
+
+    while (state->resolved < state->started) {
+        slot = &state->slots[state->resolved];
+        if (!slot->finished) {
+            return EAGAIN;
+        }
+
+        state->resolved++;
+        state->selected_domain = slot->domain;
+
+        switch (slot->ret) {
+        case EOK:
+            ret = cache_req_create_and_add_result(state,
+                                                  slot->cr,
+                                                  slot->domain,
+                                                  slot->result,
+                                                  slot->cr->data->name.lookup,
+                                                  &state->results,
+                                                  &state->num_results);
+            if (ret != EOK) {
+                return ret;
+            }
+
+            if (!state->cr->plugin->search_all_domains) {
+                /* We are not interested in more results. */
+                return EOK;
+            }
+            break;
+        case ENOENT:
+            break;
+        default:
+            return slot->ret;
+        }
+
+        talloc_zfree(slot->cr);
+    }
+
+    if (state->resolved < state->num_slots) {
+        return EAGAIN;
+    }
+
+    if (state->num_slots > 0 && state->num_results == 0) {
+        /* Keep the same request state as a sequential search would have. */
+        ret = cache_req_set_domain(state->cr,
+                                   state->slots[state->num_slots - 1].domain);
+        if (ret != EOK) {
+            return ret;
+        }
+    }
+
+    return cache_req_search_domains_not_found(state);
+}
+
+static errno_t
+cache_req_search_domains_parallel_next(struct tevent_req *req)
+{
+    struct cache_req_search_domains_state *state;
+    struct cache_req_domain_slot *slot;
+    errno_t ret;
+
+    state = tevent_req_data(req, struct cache_req_search_domains_state);
+
+again:
+    ret = cache_req_search_domains_parallel_resolve(req);
+    if (ret != EAGAIN) {
+        cache_req_search_domains_parallel_cancel(state);
+        return ret;
+    }
+
+    while (state->active < state->concurrency
+            && state->started < state->num_slots) {
+        slot = &state->slots[state->started];
+
+        if (slot->finished) {
+            /* Answered from the cache. */
+            state->started++;
+            continue;
+        }
+
+        if (slot->cr == NULL) {
+            slot->cr = cache_req_copy_for_domain(state, state->cr);
+            if (slot->cr == NULL) {
+                ret = ENOMEM;
+                goto fail;
+            }
+
+            ret = cache_req_set_domain(slot->cr, slot->domain);
+            if (ret != EOK) {
+                goto fail;
+            }
+        }
+
+        /* The cache was already searched, go to the data provider. */
+        slot->subreq = cache_req_search_send(state, state->ev, slot->cr,
+                                             true, false);
+        if (slot->subreq == NULL) {
+            ret = ENOMEM;
+            goto fail;
+        }
+
+        tevent_req_set_callback(slot->subreq,
+                                cache_req_search_domains_parallel_done, slot);
+        state->started++;
+        state->active++;
+    }
+
+    if (state->active == 0) {
+        /* Only answers from the cache are left, nothing will call us. */
+        goto again;
+    }
+
+    return EAGAIN;
+
+fail:
+    cache_req_search_domains_parallel_cancel(state);
+    return ret;
+}
+
+static void cache_req_search_domains_parallel_done(struct tevent_req *subreq)
+{
+    struct cache_req_search_domains_state *state;
+    struct cache_req_domain_slot *slot;
+    struct tevent_req *req;
+    bool dp_success;
+    errno_t ret;
+
+    slot = tevent_req_callback_data(subreq, struct cache_req_domain_slot);
+    req = slot->req;
+    state = tevent_req_data(req, struct cache_req_search_domains_state);
+
+    slot->ret = cache_req_search_recv(slot->cr, subreq, &slot->result,
+                                      &dp_success);
+    talloc_zfree(subreq);
+    slot->subreq = NULL;
+    slot->finished = true;
+    state->active--;
+
+    /* Remember if any DP request fails. */
+    state->dp_success = !dp_success ? false : state->dp_success;
+
+    ret = cache_req_search_domains_parallel_next(req);
+
+    if (ret == ENOENT && state->results != NULL) {
+        /* We have at least one result. */
+        ret = EOK;
+    }
+
+    switch (ret) {
+    case EOK:
+        tevent_req_done(req);
+        break;
+    case EAGAIN:
+        break;
+    default:
+        tevent_req_error(req, ret);
+        break;
+    }
 }
 
 static void cache_req_search_domains_done(struct tevent_req *subreq)
@@ -691,6 +1115,7 @@ struct cache_req_state {
     struct cache_req_result **results;
     size_t num_results;
     bool first_iteration;
+    uint64_t stats_start;
 };
 
 static errno_t cache_req_process_input(TALLOC_CTX *mem_ctx,
@@ -740,6 +1165,7 @@ struct tevent_req *cache_req_send(TALLOC_CTX *mem_ctx,
         return NULL;
     }
 
+    state->stats_start = sss_stats_now();
     state->ev = ev;
     state->cr = cr = cache_req_create(state, rctx, data,
                                       ncache, midpoint, req_dom_type);
@@ -750,6 +1176,7 @@ struct tevent_req *cache_req_send(TALLOC_CTX *mem_ctx,
     state->first_iteration = true;
 
     CACHE_REQ_DEBUG(SSSDBG_TRACE_FUNC, cr, "New request '%s'\n", cr->reqname);
+    PROBE(CACHE_REQ_SEND, cr->reqid, cr->reqname, PROBE_SAFE_STR(domain));
 
     ret = cache_req_is_well_known_object(state, cr, &result);
     if (ret == EOK) {
@@ -769,6 +1196,14 @@ struct tevent_req *cache_req_send(TALLOC_CTX *mem_ctx,
     ret = cache_req_select_domains(req, state->domain_name);
 
 done:
+    if (ret != EAGAIN) {
+        sss_stats_record(SSS_STATS_CACHE_REQ, state->stats_start,
+                         ret != EOK && ret != ENOENT);
+        if (state->cr != NULL) {
+            PROBE(CACHE_REQ_DONE, state->cr->reqid, state->cr->reqname, ret);
+        }
+    }
+
     if (ret == EOK) {
         tevent_req_done(req);
         tevent_req_post(req, ev);
@@ -1001,6 +1436,26 @@ cache_req_search_domains(struct tevent_req *req,
     return EAGAIN;
 }
 
+static void cache_req_record_access(struct cache_req *cr,
+                                    struct cache_req_result **results)
+{
+    int i;
+
+    /* Enumerations would make every entry look like it is in use */
+    if (cr->plugin->require_enumeration) {
+        return;
+    }
+
+    for (i = 0; results != NULL && results[i] != NULL; i++) {
+        if (results[i]->well_known_object) {
+            continue;
+        }
+
+        resp_access_record(cr->rctx, results[i]->domain,
+                           results[i]->msgs, results[i]->count);
+    }
+}
+
 static void cache_req_done(struct tevent_req *subreq)
 {
     struct cache_req_state *state;
@@ -1035,8 +1490,15 @@ static void cache_req_done(struct tevent_req *subreq)
         }
     }
 
+    if (ret != EAGAIN) {
+        sss_stats_record(SSS_STATS_CACHE_REQ, state->stats_start,
+                         ret != EOK && ret != ENOENT);
+        PROBE(CACHE_REQ_DONE, state->cr->reqid, state->cr->reqname, ret);
+    }
+
     switch (ret) {
     case EOK:
+        cache_req_record_access(state->cr, state->results);
         CACHE_REQ_DEBUG(SSSDBG_TRACE_FUNC, state->cr, "Finished: Success\n");
         tevent_req_done(req);
         break;
@@ -165,4 +165,8 @@ bool
 cache_req_common_dp_recv(struct tevent_req *subreq,
                          struct cache_req *cr);
 
+/* DP_* flags of a data provider request, @result is the cached object */
+uint32_t
+cache_req_common_dp_flags(struct ldb_result *result);
+
 #endif /* _CACHE_REQ_PRIVATE_H_ */
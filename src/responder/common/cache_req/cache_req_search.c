@@ -23,11 +23,14 @@
 #include <tevent.h>
 
 #include "util/util.h"
+#include "util/sss_stats.h"
+#include "util/probes.h"
 #include "responder/common/cache_req/cache_req_private.h"
 #include "responder/common/cache_req/cache_req_plugin.h"
 
 static errno_t cache_req_search_ncache(struct cache_req *cr)
 {
+    uint64_t start;
     errno_t ret;
 
     if (cr->plugin->ncache_check_fn == NULL) {
@@ -40,8 +43,16 @@ static errno_t cache_req_search_ncache(struct cache_req *cr)
                     "Checking negative cache for [%s]\n",
                     cr->debugobj);
 
+    PROBE(CACHE_REQ_SEARCH_NCACHE_PRE, cr->reqid, cr->debugobj,
+          cr->domain->name);
+    start = sss_stats_now();
     ret = cr->plugin->ncache_check_fn(cr->ncache, cr->domain, cr->data);
+    sss_stats_record(SSS_STATS_CACHE_REQ_NCACHE, start,
+                     ret != EOK && ret != ENOENT && ret != EEXIST);
+    PROBE(CACHE_REQ_SEARCH_NCACHE_POST, cr->reqid, cr->debugobj,
+          cr->domain->name, ret);
     if (ret == EEXIST) {
+        sss_stats_count(SSS_STATS_NCACHE_HIT);
         CACHE_REQ_DEBUG(SSSDBG_TRACE_FUNC, cr,
                         "[%s] does not exist (negative cache)\n",
                         cr->debugobj);
@@ -168,6 +179,7 @@ static errno_t cache_req_search_cache(TALLOC_CTX *mem_ctx,
                                       struct ldb_result **_result)
 {
     struct ldb_result *result = NULL;
+    uint64_t start;
     errno_t ret;
 
     if (cr->plugin->lookup_fn == NULL) {
@@ -180,10 +192,17 @@ static errno_t cache_req_search_cache(TALLOC_CTX *mem_ctx,
                     "Looking up [%s] in cache\n",
                     cr->debugobj);
 
+    PROBE(CACHE_REQ_SEARCH_SYSDB_PRE, cr->reqid, cr->debugobj,
+          cr->domain->name);
+    start = sss_stats_now();
     ret = cr->plugin->lookup_fn(mem_ctx, cr, cr->data, cr->domain, &result);
     if (ret == EOK && (result == NULL || result->count == 0)) {
         ret = ENOENT;
     }
+    sss_stats_record(SSS_STATS_CACHE_REQ_SYSDB, start,
+                     ret != EOK && ret != ENOENT);
+    PROBE(CACHE_REQ_SEARCH_SYSDB_POST, cr->reqid, cr->debugobj,
+          cr->domain->name, ret);
 
     switch (ret) {
     case EOK:
@@ -250,6 +269,8 @@ struct cache_req_search_state {
     /* output data */
     struct ldb_result *result;
     bool dp_success;
+
+    uint64_t dp_start;
 };
 
 static errno_t cache_req_search_dp(struct tevent_req *req,
@@ -303,6 +324,7 @@ cache_req_search_send(TALLOC_CTX *mem_ctx,
 
         status = cache_req_expiration_status(cr, state->result);
         if (status == CACHE_OBJECT_VALID) {
+            sss_stats_count(SSS_STATS_CACHE_VALID);
             CACHE_REQ_DEBUG(SSSDBG_TRACE_FUNC, cr,
                             "Returning [%s] from cache\n", cr->debugobj);
             ret = EOK;
@@ -356,6 +378,9 @@ static errno_t cache_req_search_dp(struct tevent_req *req,
 
     state = tevent_req_data(req, struct cache_req_search_state);
 
+    PROBE(CACHE_REQ_SEARCH_DP_SEND, state->cr->reqid, state->cr->debugobj,
+          state->cr->domain->name, status);
+
     switch (status) {
     case CACHE_OBJECT_MIDPOINT:
         /* Out of band update. The calling function will return the cached
@@ -365,6 +390,7 @@ static errno_t cache_req_search_dp(struct tevent_req *req,
         CACHE_REQ_DEBUG(SSSDBG_TRACE_FUNC, state->cr,
                         "Performing midpoint cache update of [%s]\n",
                         state->cr->debugobj);
+        sss_stats_count(SSS_STATS_CACHE_MIDPOINT);
 
         subreq = state->cr->plugin->dp_send_fn(state->rctx, state->cr,
                                                state->cr->data,
@@ -385,6 +411,8 @@ static errno_t cache_req_search_dp(struct tevent_req *req,
         CACHE_REQ_DEBUG(SSSDBG_TRACE_FUNC, state->cr,
                         "Looking up [%s] in data provider\n",
                         state->cr->debugobj);
+        sss_stats_count(SSS_STATS_CACHE_EXPIRED);
+        state->dp_start = sss_stats_now();
 
         subreq = state->cr->plugin->dp_send_fn(state->cr, state->cr,
                                                state->cr->data,
@@ -431,6 +459,11 @@ static void cache_req_search_done(struct tevent_req *subreq)
     state->dp_success = state->cr->plugin->dp_recv_fn(subreq, state->cr);
     talloc_zfree(subreq);
 
+    sss_stats_record(SSS_STATS_CACHE_REQ_DP, state->dp_start,
+                     !state->dp_success);
+    PROBE(CACHE_REQ_SEARCH_DP_RECV, state->cr->reqid, state->cr->debugobj,
+          state->cr->domain->name, state->dp_success);
+
     /* Get result from cache again. */
     ret = cache_req_search_cache(state, state->cr, &state->result);
     if (ret != EOK) {
@@ -24,6 +24,7 @@
 #include "db/sysdb.h"
 #include "util/util.h"
 #include "providers/data_provider.h"
+#include "providers/data_provider/dp_flags.h"
 #include "responder/common/cache_req/cache_req_plugin.h"
 
 static struct ldb_message *
@@ -147,3 +148,15 @@ done:
     talloc_free(err_msg);
     return bret;
 }
+
+uint32_t
+cache_req_common_dp_flags(struct ldb_result *result)
+{
+    /* The cached object is returned if the data provider is offline. If
+     * there is one, the request can also be refused under load. */
+    if (result != NULL && result->count > 0) {
+        return DP_FAST_REPLY | DP_CACHED;
+    }
+
+    return DP_FAST_REPLY;
+}
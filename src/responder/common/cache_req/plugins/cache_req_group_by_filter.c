@@ -106,7 +106,8 @@ cache_req_group_by_filter_dp_send(TALLOC_CTX *mem_ctx,
                                   struct sss_domain_info *domain,
                                   struct ldb_result *result)
 {
-    return sss_dp_get_account_send(mem_ctx, cr->rctx, domain, true,
+    return sss_dp_get_account_send(mem_ctx, cr->rctx, domain,
+                                   cache_req_common_dp_flags(result),
                                    SSS_DP_WILDCARD_GROUP,
                                    cr->data->name.lookup, cr->data->id, NULL);
 }
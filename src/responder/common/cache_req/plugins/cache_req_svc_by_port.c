@@ -100,7 +100,8 @@ cache_req_svc_by_port_dp_send(TALLOC_CTX *mem_ctx,
                               struct sss_domain_info *domain,
                               struct ldb_result *result)
 {
-    return sss_dp_get_account_send(mem_ctx, cr->rctx, domain, true,
+    return sss_dp_get_account_send(mem_ctx, cr->rctx, domain,
+                                   cache_req_common_dp_flags(result),
                                    SSS_DP_SERVICES, NULL, cr->data->svc.port,
                                    cr->data->svc.protocol.lookup);
 }
@@ -128,7 +128,8 @@ cache_req_user_by_id_dp_send(TALLOC_CTX *mem_ctx,
         return NULL;
     }
 
-    return sss_dp_get_account_send(mem_ctx, cr->rctx, domain, true,
+    return sss_dp_get_account_send(mem_ctx, cr->rctx, domain,
+                                   cache_req_common_dp_flags(result),
                                    SSS_DP_USER, string, id, flag);
 }
 
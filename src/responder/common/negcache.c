@@ -24,6 +24,7 @@
 #include "responder/common/negcache_files.h"
 #include "responder/common/responder.h"
 #include "responder/common/negcache.h"
+#include "util/probes.h"
 #include <fcntl.h>
 #include <time.h>
 #include "tdb.h"
@@ -138,6 +139,7 @@ done:
         ret = ENOENT;
     }
 
+    PROBE(NEGCACHE_CHECK, str, ret);
     free(data.dptr);
     return ret;
 }
@@ -176,6 +178,7 @@ static int sss_ncache_set_str(struct sss_nc_ctx *ctx, char *str,
 
     DEBUG(SSSDBG_TRACE_FUNC, "Adding [%s] to negative cache%s\n",
               str, permanent?" permanently":"");
+    PROBE(NEGCACHE_SET, str, permanent);
 
     ret = tdb_store(ctx->tdb, key, data, TDB_REPLACE);
     if (ret != 0) {
@@ -120,6 +120,9 @@ struct resp_ctx {
     time_t last_request_time;
     int idle_timeout;
     struct tevent_timer *idle;
+    /* If set, called to terminate an idle responder instead of exiting
+     * right away */
+    void (*idle_shutdown_fn)(struct resp_ctx *rctx);
 
     struct sss_cmd_table *sss_cmds;
     const char *sss_pipe_name;
@@ -137,12 +140,15 @@ struct resp_ctx {
 
     uint32_t cache_req_num;
 
+    struct resp_access_ctx *access_ctx;
+
     void *pvt_ctx;
 
     bool shutting_down;
     bool socket_activated;
     bool dbus_activated;
     bool cache_first;
+    int domain_lookup_concurrency;
 };
 
 struct cli_creds;
@@ -312,11 +318,12 @@ enum sss_dp_acct_type {
     SSS_DP_WILDCARD_GROUP,
 };
 
+/* @dp_flags are the DP_* flags from providers/data_provider/dp_flags.h */
 struct tevent_req *
 sss_dp_get_account_send(TALLOC_CTX *mem_ctx,
                         struct resp_ctx *rctx,
                         struct sss_domain_info *dom,
-                        bool fast_reply,
+                        uint32_t dp_flags,
                         enum sss_dp_acct_type type,
                         const char *opt_name,
                         uint32_t opt_id,
@@ -428,4 +435,13 @@ int resp_resolve_group_names_recv(TALLOC_CTX *mem_ctx,
                                   struct tevent_req *req,
                                   struct ldb_result **_initgr_named_res);
 
+/* Remember that @msgs of @domain were looked up. The lookups are written
+ * to the cache once in a while, the background refresh of the data provider
+ * uses them to decide which entries are worth refreshing.
+ */
+void resp_access_record(struct resp_ctx *rctx,
+                        struct sss_domain_info *domain,
+                        struct ldb_message **msgs,
+                        unsigned int count);
+
 #endif /* __SSS_RESPONDER_H__ */
@@ -0,0 +1,293 @@
+/*
+    SSSD
+
+    Recording of cache entry lookups for the background refresh
+
+    Copyright (C) 2017 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <tevent.h>
+#include <dhash.h>
+
+#include "util/util.h"
+#include "db/sysdb.h"
+#include "responder/common/responder.h"
+
+/*
+ * Writing to the cache on every lookup would be far more expensive than
+ * the lookup itself, so the lookups are counted in memory and written to
+ * the cache in a single transaction per cache file once in a while.
+ */
+
+#define RESP_ACCESS_FLUSH_INTERVAL 60
+
+struct resp_access_ctx {
+    struct resp_ctx *rctx;
+    /* linearized DN -> struct resp_access_entry allocated on @mem */
+    hash_table_t *entries;
+    TALLOC_CTX *mem;
+    struct tevent_timer *flush_timer;
+};
+
+struct resp_access_entry {
+    const char *domain;
+    const char *dn;
+    uint32_t count;
+    time_t last_access;
+};
+
+static void resp_access_flush(struct tevent_context *ev,
+                              struct tevent_timer *te,
+                              struct timeval tv,
+                              void *pvt);
+
+static errno_t resp_access_reset(struct resp_access_ctx *ctx)
+{
+    talloc_zfree(ctx->mem);
+
+    ctx->mem = talloc_new(ctx);
+    if (ctx->mem == NULL) {
+        return ENOMEM;
+    }
+
+    return sss_hash_create(ctx->mem, 1024, &ctx->entries);
+}
+
+static struct resp_access_ctx *resp_access_get_ctx(struct resp_ctx *rctx)
+{
+    struct resp_access_ctx *ctx;
+    errno_t ret;
+
+    if (rctx->access_ctx != NULL) {
+        return rctx->access_ctx;
+    }
+
+    ctx = talloc_zero(rctx, struct resp_access_ctx);
+    if (ctx == NULL) {
+        return NULL;
+    }
+    ctx->rctx = rctx;
+
+    ret = resp_access_reset(ctx);
+    if (ret != EOK) {
+        talloc_free(ctx);
+        return NULL;
+    }
+
+    rctx->access_ctx = ctx;
+    return ctx;
+}
+
+static errno_t resp_access_add(struct resp_access_ctx *ctx,
+                               struct sss_domain_info *domain,
+                               struct ldb_dn *dn,
+                               time_t now)
+{
+    struct resp_access_entry *entry;
+    hash_key_t key;
+    hash_value_t value;
+    int hret;
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(ldb_dn_get_linearized(dn));
+    if (key.str == NULL) {
+        return EINVAL;
+    }
+
+    hret = hash_lookup(ctx->entries, &key, &value);
+    if (hret == HASH_SUCCESS) {
+        entry = talloc_get_type(value.ptr, struct resp_access_entry);
+        if (entry->count < UINT32_MAX) {
+            entry->count++;
+        }
+        entry->last_access = now;
+        return EOK;
+    } else if (hret != HASH_ERROR_KEY_NOT_FOUND) {
+        return EIO;
+    }
+
+    entry = talloc_zero(ctx->mem, struct resp_access_entry);
+    if (entry == NULL) {
+        return ENOMEM;
+    }
+
+    entry->domain = talloc_strdup(entry, domain->name);
+    entry->dn = talloc_strdup(entry, key.str);
+    if (entry->domain == NULL || entry->dn == NULL) {
+        talloc_free(entry);
+        return ENOMEM;
+    }
+    entry->count = 1;
+    entry->last_access = now;
+
+    value.type = HASH_VALUE_PTR;
+    value.ptr = entry;
+    hret = hash_enter(ctx->entries, &key, &value);
+    if (hret != HASH_SUCCESS) {
+        talloc_free(entry);
+        return EIO;
+    }
+
+    return EOK;
+}
+
+void resp_access_record(struct resp_ctx *rctx,
+                        struct sss_domain_info *domain,
+                        struct ldb_message **msgs,
+                        unsigned int count)
+{
+    struct resp_access_ctx *ctx;
+    struct timeval tv;
+    time_t now;
+    unsigned int i;
+    errno_t ret;
+
+    if (domain == NULL || count == 0) {
+        return;
+    }
+
+    ctx = resp_access_get_ctx(rctx);
+    if (ctx == NULL) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unable to record cache access\n");
+        return;
+    }
+
+    now = time(NULL);
+    for (i = 0; i < count; i++) {
+        ret = resp_access_add(ctx, domain, msgs[i]->dn, now);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "Unable to record access to [%s] [%d]: %s\n",
+                  ldb_dn_get_linearized(msgs[i]->dn), ret, sss_strerror(ret));
+            return;
+        }
+    }
+
+    if (ctx->flush_timer == NULL) {
+        tv = tevent_timeval_current_ofs(RESP_ACCESS_FLUSH_INTERVAL, 0);
+        ctx->flush_timer = tevent_add_timer(rctx->ev, ctx, tv,
+                                            resp_access_flush, ctx);
+        if (ctx->flush_timer == NULL) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "Unable to schedule writing of cache access\n");
+        }
+    }
+}
+
+static errno_t resp_access_write(struct sysdb_ctx *sysdb,
+                                 struct resp_access_entry *entry)
+{
+    struct ldb_dn *dn;
+    errno_t ret;
+
+    dn = ldb_dn_new(NULL, sysdb_ctx_get_ldb(sysdb), entry->dn);
+    if (dn == NULL) {
+        return ENOMEM;
+    }
+
+    ret = sysdb_add_entry_access(sysdb, dn, entry->count,
+                                 entry->last_access);
+    talloc_free(dn);
+    if (ret == ENOENT) {
+        /* The entry was removed from the cache in the meantime */
+        ret = EOK;
+    }
+
+    return ret;
+}
+
+static void resp_access_flush(struct tevent_context *ev,
+                              struct tevent_timer *te,
+                              struct timeval tv,
+                              void *pvt)
+{
+    struct resp_access_ctx *ctx;
+    struct resp_access_entry *entry;
+    struct sss_domain_info *dom;
+    struct sss_domain_info *entry_dom;
+    hash_value_t *values;
+    unsigned long count;
+    unsigned long i;
+    bool in_transaction;
+    errno_t ret;
+    int hret;
+
+    ctx = talloc_get_type(pvt, struct resp_access_ctx);
+    ctx->flush_timer = NULL;
+
+    hret = hash_values(ctx->entries, &count, &values);
+    if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unable to get recorded cache access\n");
+        return;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Writing access to %lu cache entries\n", count);
+
+    /* Subdomains share the cache file with their parent domain */
+    for (dom = ctx->rctx->domains; dom != NULL; dom = get_next_domain(dom, 0)) {
+        if (dom->sysdb == NULL) {
+            continue;
+        }
+
+        in_transaction = false;
+        for (i = 0; i < count; i++) {
+            entry = talloc_get_type(values[i].ptr, struct resp_access_entry);
+
+            entry_dom = find_domain_by_name(ctx->rctx->domains,
+                                            entry->domain, true);
+            if (entry_dom == NULL || entry_dom->sysdb != dom->sysdb) {
+                continue;
+            }
+
+            if (!in_transaction) {
+                ret = sysdb_transaction_start(dom->sysdb);
+                if (ret != EOK) {
+                    DEBUG(SSSDBG_MINOR_FAILURE,
+                          "Unable to start transaction [%d]: %s\n",
+                          ret, sss_strerror(ret));
+                    break;
+                }
+                in_transaction = true;
+            }
+
+            ret = resp_access_write(dom->sysdb, entry);
+            if (ret != EOK) {
+                DEBUG(SSSDBG_MINOR_FAILURE,
+                      "Unable to write access to [%s] [%d]: %s\n",
+                      entry->dn, ret, sss_strerror(ret));
+            }
+        }
+
+        if (in_transaction) {
+            ret = sysdb_transaction_commit(dom->sysdb);
+            if (ret != EOK) {
+                DEBUG(SSSDBG_MINOR_FAILURE,
+                      "Unable to commit transaction [%d]: %s\n",
+                      ret, sss_strerror(ret));
+                sysdb_transaction_cancel(dom->sysdb);
+            }
+        }
+    }
+
+    /* Entries of domains that are gone are dropped as well */
+    ret = resp_access_reset(ctx);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to create hash table\n");
+        ctx->rctx->access_ctx = NULL;
+        talloc_free(ctx);
+    }
+}
@@ -45,6 +45,7 @@
 #include "monitor/monitor_interfaces.h"
 #include "sbus/sbus_client.h"
 #include "util/util_creds.h"
+#include "util/probes.h"
 
 #ifdef HAVE_SYSTEMD
 #include <systemd/sd-daemon.h>
@@ -269,6 +270,8 @@ static void client_send(struct cli_ctx *cctx)
     }
 
     /* ok all sent */
+    PROBE(RESPONDER_CLIENT_SEND, cctx->cfd,
+          sss_packet_get_cmd(pctx->creq->out));
     TEVENT_FD_NOT_WRITEABLE(cctx->cfde);
     TEVENT_FD_READABLE(cctx->cfde);
     talloc_zfree(pctx->creq);
@@ -282,6 +285,7 @@ static int client_cmd_execute(struct cli_ctx *cctx, struct sss_cmd_table *sss_cm
 
     pctx = talloc_get_type(cctx->protocol_ctx, struct cli_protocol);
     cmd = sss_packet_get_cmd(pctx->creq->in);
+    PROBE(RESPONDER_CLIENT_RECV, cctx->cfd, cmd);
     return sss_cmd_execute(cctx, cmd, sss_cmds);
 }
 
@@ -376,6 +380,13 @@ static void responder_idle_handler(struct tevent_context *ev,
         DEBUG(SSSDBG_TRACE_INTERNAL,
               "Terminating idle responder [%p]\n", rctx);
 
+        if (rctx->idle_shutdown_fn != NULL) {
+            /* The timer is freed by tevent once this handler returns */
+            rctx->idle = NULL;
+            rctx->idle_shutdown_fn(rctx);
+            return;
+        }
+
         talloc_free(rctx);
 
         orderly_shutdown(0);
@@ -1131,6 +1142,22 @@ int sss_process_init(TALLOC_CTX *mem_ctx,
               ret, sss_strerror(ret));
     }
 
+    ret = confdb_get_int(rctx->cdb, rctx->confdb_service_path,
+                         CONFDB_RESPONDER_DOMAIN_LOOKUP_CONCURRENCY,
+                         CONFDB_RESPONDER_DOMAIN_LOOKUP_CONCURRENCY_DEFAULT,
+                         &rctx->domain_lookup_concurrency);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Cannot get \"domain_lookup_concurrency\" option, "
+              "domains will be searched sequentially [%d]: %s.\n",
+              ret, sss_strerror(ret));
+        rctx->domain_lookup_concurrency = 1;
+    }
+
+    if (rctx->domain_lookup_concurrency < 1) {
+        rctx->domain_lookup_concurrency = 1;
+    }
+
     ret = confdb_get_int(rctx->cdb, rctx->confdb_service_path,
                          CONFDB_RESPONDER_GET_DOMAINS_TIMEOUT,
                          GET_DOMAINS_DEFAULT_TIMEOUT, &rctx->domains_timeout);
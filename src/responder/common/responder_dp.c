@@ -28,6 +28,7 @@
 #include "providers/data_provider.h"
 #include "providers/data_provider/dp_responder_iface.h"
 #include "sbus/sbus_client.h"
+#include "util/probes.h"
 
 struct sss_dp_req;
 
@@ -327,12 +328,14 @@ sss_dp_issue_request(TALLOC_CTX *mem_ctx, struct resp_ctx *rctx,
         /* Request already in progress */
         DEBUG(SSSDBG_TRACE_FUNC,
               "Identical request in progress: [%s]\n", key->str);
+        PROBE(DP_ISSUE_REQUEST, key->str, dom->name, 1);
         break;
 
     case HASH_ERROR_KEY_NOT_FOUND:
         /* No such request in progress
          * Create a new request
          */
+        PROBE(DP_ISSUE_REQUEST, key->str, dom->name, 0);
         msg = msg_create(pvt);
         if (!msg) {
             DEBUG(SSSDBG_CRIT_FAILURE, "Cannot create D-Bus message\n");
@@ -471,7 +474,7 @@ static int sss_dp_account_files_params(struct sss_domain_info *dom,
 struct sss_dp_account_info {
     struct sss_domain_info *dom;
 
-    bool fast_reply;
+    uint32_t dp_flags;
     enum sss_dp_acct_type type;
     const char *opt_name;
     const char *extra;
@@ -482,7 +485,7 @@ struct tevent_req *
 sss_dp_get_account_send(TALLOC_CTX *mem_ctx,
                         struct resp_ctx *rctx,
                         struct sss_domain_info *dom,
-                        bool fast_reply,
+                        uint32_t dp_flags,
                         enum sss_dp_acct_type type,
                         const char *opt_name,
                         uint32_t opt_id,
@@ -536,7 +539,7 @@ sss_dp_get_account_send(TALLOC_CTX *mem_ctx,
     }
 
     info = talloc_zero(state, struct sss_dp_account_info);
-    info->fast_reply = fast_reply;
+    info->dp_flags = dp_flags;
     info->type = type;
     info->opt_name = opt_name;
     info->opt_id = opt_id;
@@ -672,7 +675,7 @@ sss_dp_get_account_msg(void *pvt)
             break;
     }
 
-    dp_flags = info->fast_reply ? DP_FAST_REPLY : 0;
+    dp_flags = info->dp_flags;
 
     if (info->opt_name) {
         if (info->type == SSS_DP_SECID) {
@@ -884,6 +887,9 @@ static void sss_dp_internal_get_done(DBusPendingCall *pending, void *ptr)
         }
     }
 
+    PROBE(DP_ISSUE_REQUEST_DONE, sdp_req->key->str,
+          sdp_req->dp_err, sdp_req->dp_ret);
+
     /* Check whether we need to issue any callbacks */
     while ((cb = sdp_req->cb_list) != NULL) {
         cb_state = tevent_req_data(cb->req, struct sss_dp_req_state);
@@ -98,21 +98,14 @@ int sss_packet_new(TALLOC_CTX *mem_ctx, size_t size,
     return EOK;
 }
 
-/* grows a packet size only in SSSSRV_PACKET_MEM_SIZE chunks */
-int sss_packet_grow(struct sss_packet *packet, size_t size)
+/* makes sure the packet buffer can hold at least len bytes, the buffer
+ * grows only in SSSSRV_PACKET_MEM_SIZE chunks */
+static int sss_packet_alloc_len(struct sss_packet *packet, size_t len)
 {
-    size_t totlen, len;
+    size_t totlen;
     uint8_t *newmem;
-    uint32_t packet_len;
-
-    if (size == 0) {
-        return EOK;
-    }
 
     totlen = packet->memsize;
-    packet_len = sss_packet_get_len(packet);
-
-    len = packet_len + size;
 
     /* make sure we do not overflow */
     if (totlen < len) {
@@ -137,13 +130,44 @@ int sss_packet_grow(struct sss_packet *packet, size_t size)
         }
     }
 
+    return EOK;
+}
+
+/* grows a packet size only in SSSSRV_PACKET_MEM_SIZE chunks */
+int sss_packet_grow(struct sss_packet *packet, size_t size)
+{
+    uint32_t packet_len;
+    int ret;
+
+    if (size == 0) {
+        return EOK;
+    }
+
+    packet_len = sss_packet_get_len(packet);
+
+    ret = sss_packet_alloc_len(packet, packet_len + size);
+    if (ret != EOK) {
+        return ret;
+    }
+
     packet_len += size;
     sss_packet_set_len(packet, packet_len);
 
-
     return 0;
 }
 
+/* makes room for at least size more bytes without changing the packet
+ * length, so that following sss_packet_grow() calls up to that size do
+ * not need to reallocate (and possibly move) the buffer */
+int sss_packet_reserve(struct sss_packet *packet, size_t size)
+{
+    if (size == 0) {
+        return EOK;
+    }
+
+    return sss_packet_alloc_len(packet, sss_packet_get_len(packet) + size);
+}
+
 /* reclaim backet previously resrved space in the packet
  * usually done in functione recovering from not fatal erros */
 int sss_packet_shrink(struct sss_packet *packet, size_t size)
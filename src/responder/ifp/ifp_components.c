@@ -466,6 +466,9 @@ void ifp_component_get_debug_level(struct sbus_request *dbus_req,
         return;
     }
 
+    /* The debug level might have been changed by sss_debuglevel */
+    confdb_refresh_snapshot(ctx->rctx->cdb);
+
     ret = confdb_get_int(ctx->rctx->cdb, confdb_path,
                          CONFDB_SERVICE_DEBUG_LEVEL, SSSDBG_DEFAULT, &level);
     if (ret != EOK) {
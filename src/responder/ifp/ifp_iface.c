@@ -26,6 +26,7 @@
 #include "responder/ifp/ifp_components.h"
 #include "responder/ifp/ifp_users.h"
 #include "responder/ifp/ifp_groups.h"
+#include "responder/ifp/ifp_statistics.h"
 
 struct iface_ifp iface_ifp = {
     { &iface_ifp_meta, 0 },
@@ -56,6 +57,16 @@ struct iface_ifp_components iface_ifp_components = {
     .get_providers = ifp_backend_get_providers
 };
 
+struct iface_ifp_statistics iface_ifp_statistics = {
+    { &iface_ifp_statistics_meta, 0 },
+    .ListProcesses = ifp_statistics_list_processes,
+    .ListHistograms = ifp_statistics_list_histograms,
+    .ListCounters = ifp_statistics_list_counters,
+    .GetHistogram = ifp_statistics_get_histogram,
+    .GetCounter = ifp_statistics_get_counter,
+    .GetPrometheus = ifp_statistics_get_prometheus
+};
+
 struct iface_ifp_domains iface_ifp_domains = {
     { &iface_ifp_domains_meta, 0 },
     .get_name = ifp_dom_get_name,
@@ -157,6 +168,7 @@ static struct sbus_iface_map iface_map[] = {
     { IFP_PATH_DOMAINS_TREE, &iface_ifp_domains.vtable },
     { IFP_PATH_DOMAINS_TREE, &iface_ifp_domains_domain.vtable },
     { IFP_PATH_COMPONENTS_TREE, &iface_ifp_components.vtable },
+    { IFP_PATH_STATISTICS, &iface_ifp_statistics.vtable },
     { IFP_PATH_USERS, &iface_ifp_users.vtable },
     { IFP_PATH_USERS, &iface_ifp_cache_user.vtable },
     { IFP_PATH_USERS_TREE, &iface_ifp_users_user.vtable },
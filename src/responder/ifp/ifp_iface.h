@@ -31,6 +31,8 @@
 #define IFP_PATH_COMPONENTS IFP_PATH "/Components"
 #define IFP_PATH_COMPONENTS_TREE IFP_PATH_COMPONENTS SBUS_SUBTREE_SUFFIX
 
+#define IFP_PATH_STATISTICS IFP_PATH "/Statistics"
+
 #define IFP_PATH_GROUPS IFP_PATH "/Groups"
 #define IFP_PATH_GROUPS_TREE IFP_PATH_GROUPS SBUS_SUBTREE_SUFFIX
 
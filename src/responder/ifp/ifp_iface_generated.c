@@ -1221,6 +1221,166 @@ const struct sbus_interface_meta iface_ifp_groups_group_meta = {
     sbus_invoke_get_all, /* GetAll invoker */
 };
 
+/* arguments for org.freedesktop.sssd.infopipe.Statistics.ListProcesses */
+const struct sbus_arg_meta iface_ifp_statistics_ListProcesses__out[] = {
+    { "processes", "as" },
+    { NULL, }
+};
+
+int iface_ifp_statistics_ListProcesses_finish(struct sbus_request *req, const char *arg_processes[], int len_processes)
+{
+   return sbus_request_return_and_finish(req,
+                                         DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &arg_processes, len_processes,
+                                         DBUS_TYPE_INVALID);
+}
+
+/* arguments for org.freedesktop.sssd.infopipe.Statistics.ListHistograms */
+const struct sbus_arg_meta iface_ifp_statistics_ListHistograms__out[] = {
+    { "histograms", "as" },
+    { NULL, }
+};
+
+int iface_ifp_statistics_ListHistograms_finish(struct sbus_request *req, const char *arg_histograms[], int len_histograms)
+{
+   return sbus_request_return_and_finish(req,
+                                         DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &arg_histograms, len_histograms,
+                                         DBUS_TYPE_INVALID);
+}
+
+/* arguments for org.freedesktop.sssd.infopipe.Statistics.ListCounters */
+const struct sbus_arg_meta iface_ifp_statistics_ListCounters__out[] = {
+    { "counters", "as" },
+    { NULL, }
+};
+
+int iface_ifp_statistics_ListCounters_finish(struct sbus_request *req, const char *arg_counters[], int len_counters)
+{
+   return sbus_request_return_and_finish(req,
+                                         DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &arg_counters, len_counters,
+                                         DBUS_TYPE_INVALID);
+}
+
+/* arguments for org.freedesktop.sssd.infopipe.Statistics.GetHistogram */
+const struct sbus_arg_meta iface_ifp_statistics_GetHistogram__in[] = {
+    { "process", "s" },
+    { "histogram", "s" },
+    { NULL, }
+};
+
+/* arguments for org.freedesktop.sssd.infopipe.Statistics.GetHistogram */
+const struct sbus_arg_meta iface_ifp_statistics_GetHistogram__out[] = {
+    { "count", "t" },
+    { "errors", "t" },
+    { "sum", "t" },
+    { "min", "t" },
+    { "max", "t" },
+    { "upper_bounds", "at" },
+    { "counts", "at" },
+    { NULL, }
+};
+
+int iface_ifp_statistics_GetHistogram_finish(struct sbus_request *req, uint64_t arg_count, uint64_t arg_errors, uint64_t arg_sum, uint64_t arg_min, uint64_t arg_max, uint64_t arg_upper_bounds[], int len_upper_bounds, uint64_t arg_counts[], int len_counts)
+{
+   return sbus_request_return_and_finish(req,
+                                         DBUS_TYPE_UINT64, &arg_count,
+                                         DBUS_TYPE_UINT64, &arg_errors,
+                                         DBUS_TYPE_UINT64, &arg_sum,
+                                         DBUS_TYPE_UINT64, &arg_min,
+                                         DBUS_TYPE_UINT64, &arg_max,
+                                         DBUS_TYPE_ARRAY, DBUS_TYPE_UINT64, &arg_upper_bounds, len_upper_bounds,
+                                         DBUS_TYPE_ARRAY, DBUS_TYPE_UINT64, &arg_counts, len_counts,
+                                         DBUS_TYPE_INVALID);
+}
+
+/* arguments for org.freedesktop.sssd.infopipe.Statistics.GetCounter */
+const struct sbus_arg_meta iface_ifp_statistics_GetCounter__in[] = {
+    { "process", "s" },
+    { "counter", "s" },
+    { NULL, }
+};
+
+/* arguments for org.freedesktop.sssd.infopipe.Statistics.GetCounter */
+const struct sbus_arg_meta iface_ifp_statistics_GetCounter__out[] = {
+    { "value", "t" },
+    { NULL, }
+};
+
+int iface_ifp_statistics_GetCounter_finish(struct sbus_request *req, uint64_t arg_value)
+{
+   return sbus_request_return_and_finish(req,
+                                         DBUS_TYPE_UINT64, &arg_value,
+                                         DBUS_TYPE_INVALID);
+}
+
+/* arguments for org.freedesktop.sssd.infopipe.Statistics.GetPrometheus */
+const struct sbus_arg_meta iface_ifp_statistics_GetPrometheus__out[] = {
+    { "text", "s" },
+    { NULL, }
+};
+
+int iface_ifp_statistics_GetPrometheus_finish(struct sbus_request *req, const char *arg_text)
+{
+   return sbus_request_return_and_finish(req,
+                                         DBUS_TYPE_STRING, &arg_text,
+                                         DBUS_TYPE_INVALID);
+}
+
+/* methods for org.freedesktop.sssd.infopipe.Statistics */
+const struct sbus_method_meta iface_ifp_statistics__methods[] = {
+    {
+        "ListProcesses", /* name */
+        NULL, /* no in_args */
+        iface_ifp_statistics_ListProcesses__out,
+        offsetof(struct iface_ifp_statistics, ListProcesses),
+        NULL, /* no invoker */
+    },
+    {
+        "ListHistograms", /* name */
+        NULL, /* no in_args */
+        iface_ifp_statistics_ListHistograms__out,
+        offsetof(struct iface_ifp_statistics, ListHistograms),
+        NULL, /* no invoker */
+    },
+    {
+        "ListCounters", /* name */
+        NULL, /* no in_args */
+        iface_ifp_statistics_ListCounters__out,
+        offsetof(struct iface_ifp_statistics, ListCounters),
+        NULL, /* no invoker */
+    },
+    {
+        "GetHistogram", /* name */
+        iface_ifp_statistics_GetHistogram__in,
+        iface_ifp_statistics_GetHistogram__out,
+        offsetof(struct iface_ifp_statistics, GetHistogram),
+        invoke_ss_method,
+    },
+    {
+        "GetCounter", /* name */
+        iface_ifp_statistics_GetCounter__in,
+        iface_ifp_statistics_GetCounter__out,
+        offsetof(struct iface_ifp_statistics, GetCounter),
+        invoke_ss_method,
+    },
+    {
+        "GetPrometheus", /* name */
+        NULL, /* no in_args */
+        iface_ifp_statistics_GetPrometheus__out,
+        offsetof(struct iface_ifp_statistics, GetPrometheus),
+        NULL, /* no invoker */
+    },
+    { NULL, }
+};
+
+/* interface info for org.freedesktop.sssd.infopipe.Statistics */
+const struct sbus_interface_meta iface_ifp_statistics_meta = {
+    "org.freedesktop.sssd.infopipe.Statistics", /* name */
+    iface_ifp_statistics__methods,
+    NULL, /* no signals */
+    NULL, /* no properties */
+    sbus_invoke_get_all, /* GetAll invoker */
+};
+
 /* invokes a handler with a 'ss' DBus signature */
 static int invoke_ss_method(struct sbus_request *dbus_req, void *function_ptr)
 {
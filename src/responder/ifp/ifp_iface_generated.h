@@ -109,6 +109,15 @@
 #define IFACE_IFP_GROUPS_GROUP_USERS "users"
 #define IFACE_IFP_GROUPS_GROUP_GROUPS "groups"
 
+/* constants for org.freedesktop.sssd.infopipe.Statistics */
+#define IFACE_IFP_STATISTICS "org.freedesktop.sssd.infopipe.Statistics"
+#define IFACE_IFP_STATISTICS_LISTPROCESSES "ListProcesses"
+#define IFACE_IFP_STATISTICS_LISTHISTOGRAMS "ListHistograms"
+#define IFACE_IFP_STATISTICS_LISTCOUNTERS "ListCounters"
+#define IFACE_IFP_STATISTICS_GETHISTOGRAM "GetHistogram"
+#define IFACE_IFP_STATISTICS_GETCOUNTER "GetCounter"
+#define IFACE_IFP_STATISTICS_GETPROMETHEUS "GetPrometheus"
+
 /* ------------------------------------------------------------------------
  * DBus handlers
  *
@@ -334,6 +343,35 @@ struct iface_ifp_groups_group {
 /* finish function for UpdateMemberList */
 int iface_ifp_groups_group_UpdateMemberList_finish(struct sbus_request *req);
 
+/* vtable for org.freedesktop.sssd.infopipe.Statistics */
+struct iface_ifp_statistics {
+    struct sbus_vtable vtable; /* derive from sbus_vtable */
+    int (*ListProcesses)(struct sbus_request *req, void *data);
+    int (*ListHistograms)(struct sbus_request *req, void *data);
+    int (*ListCounters)(struct sbus_request *req, void *data);
+    int (*GetHistogram)(struct sbus_request *req, void *data, const char *arg_process, const char *arg_histogram);
+    int (*GetCounter)(struct sbus_request *req, void *data, const char *arg_process, const char *arg_counter);
+    int (*GetPrometheus)(struct sbus_request *req, void *data);
+};
+
+/* finish function for ListProcesses */
+int iface_ifp_statistics_ListProcesses_finish(struct sbus_request *req, const char *arg_processes[], int len_processes);
+
+/* finish function for ListHistograms */
+int iface_ifp_statistics_ListHistograms_finish(struct sbus_request *req, const char *arg_histograms[], int len_histograms);
+
+/* finish function for ListCounters */
+int iface_ifp_statistics_ListCounters_finish(struct sbus_request *req, const char *arg_counters[], int len_counters);
+
+/* finish function for GetHistogram */
+int iface_ifp_statistics_GetHistogram_finish(struct sbus_request *req, uint64_t arg_count, uint64_t arg_errors, uint64_t arg_sum, uint64_t arg_min, uint64_t arg_max, uint64_t arg_upper_bounds[], int len_upper_bounds, uint64_t arg_counts[], int len_counts);
+
+/* finish function for GetCounter */
+int iface_ifp_statistics_GetCounter_finish(struct sbus_request *req, uint64_t arg_value);
+
+/* finish function for GetPrometheus */
+int iface_ifp_statistics_GetPrometheus_finish(struct sbus_request *req, const char *arg_text);
+
 /* ------------------------------------------------------------------------
  * DBus Interface Metadata
  *
@@ -374,4 +412,7 @@ extern const struct sbus_interface_meta iface_ifp_groups_meta;
 /* interface info for org.freedesktop.sssd.infopipe.Groups.Group */
 extern const struct sbus_interface_meta iface_ifp_groups_group_meta;
 
+/* interface info for org.freedesktop.sssd.infopipe.Statistics */
+extern const struct sbus_interface_meta iface_ifp_statistics_meta;
+
 #endif /* __IFP_IFACE_XML__ */
@@ -28,7 +28,8 @@
 static const char **
 nodes_ifp(TALLOC_CTX *mem_ctx, const char *path, void *data)
 {
-    static const char *nodes[] = {"Users", "Groups", "Domains", NULL};
+    static const char *nodes[] = {"Users", "Groups", "Domains",
+                                  "Statistics", NULL};
 
     return nodes;
 }
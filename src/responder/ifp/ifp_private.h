@@ -96,8 +96,25 @@ struct ifp_list_ctx {
 
     const char **paths;
     size_t path_count;
+
+    /* Domains searched concurrently by the list calls. The results are
+     * kept per domain and copied in domain order once all are finished. */
+    struct sss_domain_info **doms;
+    struct ldb_result **dom_results;
+    size_t dom_count;
+    size_t dom_started;
+    size_t dom_pending;
+};
+
+struct ifp_list_domain_req {
+    struct ifp_list_ctx *list_ctx;
+    size_t idx;
 };
 
+typedef struct tevent_req *
+(*ifp_list_domain_send_fn)(struct ifp_list_ctx *list_ctx,
+                           struct sss_domain_info *dom);
+
 struct ifp_list_ctx *ifp_list_ctx_new(struct sbus_request *sbus_req,
                                       struct ifp_ctx *ctx,
                                       const char *filter,
@@ -106,6 +123,18 @@ struct ifp_list_ctx *ifp_list_ctx_new(struct sbus_request *sbus_req,
 size_t ifp_list_ctx_remaining_capacity(struct ifp_list_ctx *list_ctx,
                                        size_t entries);
 
+/* Starts searches in the domains which were not searched yet, at most
+ * domain_lookup_concurrency at a time. done_fn receives a
+ * struct ifp_list_domain_req as callback data. */
+errno_t ifp_list_ctx_search_domains(struct ifp_list_ctx *list_ctx,
+                                    ifp_list_domain_send_fn send_fn,
+                                    tevent_req_fn done_fn);
+
+/* Stores the result of a finished domain search, returns true if all
+ * domains were searched. */
+bool ifp_list_ctx_domain_done(struct ifp_list_domain_req *dom_req,
+                              struct ldb_result *result);
+
 errno_t ifp_ldb_el_output_name(struct resp_ctx *rctx,
                                struct ldb_message *msg,
                                const char *el_name,
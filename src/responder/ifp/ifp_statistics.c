@@ -0,0 +1,241 @@
+/*
+    SSSD
+
+    InfoPipe: latency histograms and counters
+
+    Copyright (C) 2017 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+
+#include "util/util.h"
+#include "util/sss_stats.h"
+#include "sbus/sssd_dbus_errors.h"
+#include "responder/ifp/ifp_statistics.h"
+
+/* The statistics are read from the files the processes keep in the
+ * database directory, see util/sss_stats.h */
+
+static int ifp_statistics_read_error(struct sbus_request *sbus_req,
+                                     errno_t ret)
+{
+    DBusError *error;
+
+    error = sbus_error_new(sbus_req, DBUS_ERROR_FAILED,
+                           "Unable to read statistics [%d]: %s",
+                           ret, sss_strerror(ret));
+    return sbus_request_fail_and_finish(sbus_req, error);
+}
+
+static struct sss_stats_process *
+ifp_statistics_find_process(struct sss_stats_process **procs,
+                            const char *name)
+{
+    size_t i;
+
+    for (i = 0; procs[i] != NULL; i++) {
+        if (procs[i]->running && strcmp(procs[i]->name, name) == 0) {
+            return procs[i];
+        }
+    }
+
+    return NULL;
+}
+
+int ifp_statistics_list_processes(struct sbus_request *sbus_req,
+                                  void *data)
+{
+    struct sss_stats_process **procs;
+    const char **names;
+    int num = 0;
+    errno_t ret;
+    size_t i;
+
+    ret = sss_stats_read(sbus_req, DB_PATH, &procs);
+    if (ret != EOK) {
+        return ifp_statistics_read_error(sbus_req, ret);
+    }
+
+    for (i = 0; procs[i] != NULL; i++);
+
+    names = talloc_zero_array(sbus_req, const char *, i + 1);
+    if (names == NULL) {
+        return ifp_statistics_read_error(sbus_req, ENOMEM);
+    }
+
+    for (i = 0; procs[i] != NULL; i++) {
+        if (procs[i]->running) {
+            names[num] = procs[i]->name;
+            num++;
+        }
+    }
+
+    return iface_ifp_statistics_ListProcesses_finish(sbus_req, names, num);
+}
+
+int ifp_statistics_list_histograms(struct sbus_request *sbus_req,
+                                   void *data)
+{
+    const char *names[SSS_STATS_HIST_SENTINEL];
+    int id;
+
+    for (id = 0; id < SSS_STATS_HIST_SENTINEL; id++) {
+        names[id] = sss_stats_hist_name(id);
+    }
+
+    return iface_ifp_statistics_ListHistograms_finish(sbus_req, names,
+                                                      SSS_STATS_HIST_SENTINEL);
+}
+
+int ifp_statistics_list_counters(struct sbus_request *sbus_req,
+                                 void *data)
+{
+    const char *names[SSS_STATS_COUNTER_SENTINEL];
+    int id;
+
+    for (id = 0; id < SSS_STATS_COUNTER_SENTINEL; id++) {
+        names[id] = sss_stats_counter_name(id);
+    }
+
+    return iface_ifp_statistics_ListCounters_finish(sbus_req, names,
+                                                    SSS_STATS_COUNTER_SENTINEL);
+}
+
+int ifp_statistics_get_histogram(struct sbus_request *sbus_req,
+                                 void *data,
+                                 const char *process,
+                                 const char *histogram)
+{
+    struct sss_stats_process **procs;
+    struct sss_stats_process *proc;
+    const struct sss_stats_hist *hist = NULL;
+    uint64_t *upper_bounds;
+    uint64_t *counts;
+    int num = 0;
+    errno_t ret;
+    int id;
+    int i;
+
+    for (id = 0; id < SSS_STATS_HIST_SENTINEL; id++) {
+        if (strcmp(sss_stats_hist_name(id), histogram) == 0) {
+            break;
+        }
+    }
+
+    if (id == SSS_STATS_HIST_SENTINEL) {
+        sbus_request_reply_error(sbus_req, SBUS_ERROR_NOT_FOUND,
+                                 "Unknown histogram");
+        return EOK;
+    }
+
+    ret = sss_stats_read(sbus_req, DB_PATH, &procs);
+    if (ret != EOK) {
+        return ifp_statistics_read_error(sbus_req, ret);
+    }
+
+    proc = ifp_statistics_find_process(procs, process);
+    if (proc == NULL) {
+        sbus_request_reply_error(sbus_req, SBUS_ERROR_NOT_FOUND,
+                                 "Unknown process");
+        return EOK;
+    }
+
+    hist = &proc->data.hists[id];
+
+    /* Only the buckets that hold a value are returned */
+    upper_bounds = talloc_zero_array(sbus_req, uint64_t, SSS_STATS_BUCKETS);
+    counts = talloc_zero_array(sbus_req, uint64_t, SSS_STATS_BUCKETS);
+    if (upper_bounds == NULL || counts == NULL) {
+        return ifp_statistics_read_error(sbus_req, ENOMEM);
+    }
+
+    for (i = 0; i < SSS_STATS_BUCKETS; i++) {
+        if (hist->buckets[i] == 0) {
+            continue;
+        }
+
+        upper_bounds[num] = sss_stats_bucket_upper(i);
+        counts[num] = hist->buckets[i];
+        num++;
+    }
+
+    return iface_ifp_statistics_GetHistogram_finish(sbus_req,
+                                                    hist->count,
+                                                    hist->errors,
+                                                    hist->sum,
+                                                    hist->min,
+                                                    hist->max,
+                                                    upper_bounds, num,
+                                                    counts, num);
+}
+
+int ifp_statistics_get_counter(struct sbus_request *sbus_req,
+                               void *data,
+                               const char *process,
+                               const char *counter)
+{
+    struct sss_stats_process **procs;
+    struct sss_stats_process *proc;
+    errno_t ret;
+    int id;
+
+    for (id = 0; id < SSS_STATS_COUNTER_SENTINEL; id++) {
+        if (strcmp(sss_stats_counter_name(id), counter) == 0) {
+            break;
+        }
+    }
+
+    if (id == SSS_STATS_COUNTER_SENTINEL) {
+        sbus_request_reply_error(sbus_req, SBUS_ERROR_NOT_FOUND,
+                                 "Unknown counter");
+        return EOK;
+    }
+
+    ret = sss_stats_read(sbus_req, DB_PATH, &procs);
+    if (ret != EOK) {
+        return ifp_statistics_read_error(sbus_req, ret);
+    }
+
+    proc = ifp_statistics_find_process(procs, process);
+    if (proc == NULL) {
+        sbus_request_reply_error(sbus_req, SBUS_ERROR_NOT_FOUND,
+                                 "Unknown process");
+        return EOK;
+    }
+
+    return iface_ifp_statistics_GetCounter_finish(sbus_req,
+                                                  proc->data.counters[id]);
+}
+
+int ifp_statistics_get_prometheus(struct sbus_request *sbus_req,
+                                  void *data)
+{
+    struct sss_stats_process **procs;
+    const char *text;
+    errno_t ret;
+
+    ret = sss_stats_read(sbus_req, DB_PATH, &procs);
+    if (ret != EOK) {
+        return ifp_statistics_read_error(sbus_req, ret);
+    }
+
+    text = sss_stats_prometheus(sbus_req, procs);
+    if (text == NULL) {
+        return ifp_statistics_read_error(sbus_req, ENOMEM);
+    }
+
+    return iface_ifp_statistics_GetPrometheus_finish(sbus_req, text);
+}
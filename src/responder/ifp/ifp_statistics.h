@@ -0,0 +1,51 @@
+/*
+    SSSD
+
+    InfoPipe: latency histograms and counters
+
+    Copyright (C) 2017 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IFP_STATISTICS_H_
+#define IFP_STATISTICS_H_
+
+#include "responder/ifp/ifp_iface.h"
+
+/* org.freedesktop.sssd.infopipe.Statistics */
+
+int ifp_statistics_list_processes(struct sbus_request *sbus_req,
+                                  void *data);
+
+int ifp_statistics_list_histograms(struct sbus_request *sbus_req,
+                                   void *data);
+
+int ifp_statistics_list_counters(struct sbus_request *sbus_req,
+                                 void *data);
+
+int ifp_statistics_get_histogram(struct sbus_request *sbus_req,
+                                 void *data,
+                                 const char *process,
+                                 const char *histogram);
+
+int ifp_statistics_get_counter(struct sbus_request *sbus_req,
+                               void *data,
+                               const char *process,
+                               const char *counter);
+
+int ifp_statistics_get_prometheus(struct sbus_request *sbus_req,
+                                  void *data);
+
+#endif /* IFP_STATISTICS_H_ */
@@ -751,7 +751,9 @@ static void ifp_users_find_by_name_and_cert_reply(
     return;
 }
 
-static int ifp_users_list_by_name_step(struct ifp_list_ctx *list_ctx);
+static struct tevent_req *
+ifp_users_list_by_name_send(struct ifp_list_ctx *list_ctx,
+                            struct sss_domain_info *dom);
 static void ifp_users_list_by_name_done(struct tevent_req *req);
 static void ifp_users_list_by_name_reply(struct ifp_list_ctx *list_ctx);
 
@@ -762,6 +764,7 @@ int ifp_users_list_by_name(struct sbus_request *sbus_req,
 {
     struct ifp_ctx *ctx;
     struct ifp_list_ctx *list_ctx;
+    errno_t ret;
 
     ctx = talloc_get_type(data, struct ifp_ctx);
     if (ctx == NULL) {
@@ -774,70 +777,87 @@ int ifp_users_list_by_name(struct sbus_request *sbus_req,
         return ENOMEM;
     }
 
-    return ifp_users_list_by_name_step(list_ctx);
-}
-
-static int ifp_users_list_by_name_step(struct ifp_list_ctx *list_ctx)
-{
-    struct tevent_req *req;
+    ret = ifp_list_ctx_search_domains(list_ctx, ifp_users_list_by_name_send,
+                                      ifp_users_list_by_name_done);
+    if (ret != EOK) {
+        return ret;
+    }
 
-    req = cache_req_user_by_filter_send(list_ctx,
-                                        list_ctx->ctx->rctx->ev,
-                                        list_ctx->ctx->rctx,
-                                        CACHE_REQ_ANY_DOM,
-                                        list_ctx->dom->name,
-                                        list_ctx->filter);
-    if (req == NULL) {
-        return ENOMEM;
+    if (list_ctx->dom_count == 0) {
+        ifp_users_list_by_name_reply(list_ctx);
     }
-    tevent_req_set_callback(req,
-                            ifp_users_list_by_name_done, list_ctx);
 
     return EOK;
 }
 
+static struct tevent_req *
+ifp_users_list_by_name_send(struct ifp_list_ctx *list_ctx,
+                            struct sss_domain_info *dom)
+{
+    return cache_req_user_by_filter_send(list_ctx,
+                                         list_ctx->ctx->rctx->ev,
+                                         list_ctx->ctx->rctx,
+                                         CACHE_REQ_ANY_DOM,
+                                         dom->name,
+                                         list_ctx->filter);
+}
+
 static void ifp_users_list_by_name_done(struct tevent_req *req)
 {
     DBusError *error;
+    struct ifp_list_domain_req *dom_req;
     struct ifp_list_ctx *list_ctx;
     struct sbus_request *sbus_req;
     struct cache_req_result *result = NULL;
+    bool finished;
+    size_t i;
     errno_t ret;
 
-    list_ctx = tevent_req_callback_data(req, struct ifp_list_ctx);
+    dom_req = tevent_req_callback_data(req, struct ifp_list_domain_req);
+    list_ctx = dom_req->list_ctx;
     sbus_req = list_ctx->sbus_req;
 
     ret = cache_req_user_by_name_recv(sbus_req, req, &result);
-    talloc_zfree(req);
     if (ret != EOK && ret != ENOENT) {
+        talloc_zfree(req);
         error = sbus_error_new(sbus_req, DBUS_ERROR_FAILED, "Failed to fetch "
                                "users by filter [%d]: %s\n", ret, sss_strerror(ret));
         sbus_request_fail_and_finish(sbus_req, error);
         return;
     }
 
-    if (ret == EOK) {
-        ret = ifp_users_list_copy(list_ctx, result->ldb_result);
+    finished = ifp_list_ctx_domain_done(dom_req,
+                                        ret == EOK ? result->ldb_result : NULL);
+    talloc_zfree(req);
+
+    if (!finished) {
+        ret = ifp_list_ctx_search_domains(list_ctx,
+                                          ifp_users_list_by_name_send,
+                                          ifp_users_list_by_name_done);
         if (ret != EOK) {
             error = sbus_error_new(sbus_req, SBUS_ERROR_INTERNAL,
-                                "Failed to copy domain result");
+                                   "Failed to start next-domain search");
             sbus_request_fail_and_finish(sbus_req, error);
-            return;
         }
+        return;
     }
 
-    list_ctx->dom = get_next_domain(list_ctx->dom, SSS_GND_DESCEND);
-    if (list_ctx->dom == NULL) {
-        return ifp_users_list_by_name_reply(list_ctx);
-    }
+    for (i = 0; i < list_ctx->dom_count; i++) {
+        if (list_ctx->dom_results[i] == NULL) {
+            continue;
+        }
 
-    ret = ifp_users_list_by_name_step(list_ctx);
-    if (ret != EOK) {
-        error = sbus_error_new(sbus_req, SBUS_ERROR_INTERNAL,
-                               "Failed to start next-domain search");
-        sbus_request_fail_and_finish(sbus_req, error);
-        return;
+        list_ctx->dom = list_ctx->doms[i];
+        ret = ifp_users_list_copy(list_ctx, list_ctx->dom_results[i]);
+        if (ret != EOK) {
+            error = sbus_error_new(sbus_req, SBUS_ERROR_INTERNAL,
+                                "Failed to copy domain result");
+            sbus_request_fail_and_finish(sbus_req, error);
+            return;
+        }
     }
+
+    return ifp_users_list_by_name_reply(list_ctx);
 }
 
 static void ifp_users_list_by_name_reply(struct ifp_list_ctx *list_ctx)
@@ -381,6 +381,97 @@ struct ifp_list_ctx *ifp_list_ctx_new(struct sbus_request *sbus_req,
     return list_ctx;
 }
 
+static errno_t ifp_list_ctx_init_domains(struct ifp_list_ctx *list_ctx)
+{
+    struct sss_domain_info *dom;
+    size_t count;
+
+    count = 0;
+    for (dom = list_ctx->ctx->rctx->domains; dom != NULL;
+            dom = get_next_domain(dom, SSS_GND_DESCEND)) {
+        count++;
+    }
+
+    list_ctx->doms = talloc_zero_array(list_ctx, struct sss_domain_info *,
+                                       count + 1);
+    list_ctx->dom_results = talloc_zero_array(list_ctx, struct ldb_result *,
+                                              count + 1);
+    if (list_ctx->doms == NULL || list_ctx->dom_results == NULL) {
+        return ENOMEM;
+    }
+
+    count = 0;
+    for (dom = list_ctx->ctx->rctx->domains; dom != NULL;
+            dom = get_next_domain(dom, SSS_GND_DESCEND)) {
+        list_ctx->doms[count] = dom;
+        count++;
+    }
+
+    list_ctx->dom_count = count;
+
+    return EOK;
+}
+
+errno_t ifp_list_ctx_search_domains(struct ifp_list_ctx *list_ctx,
+                                    ifp_list_domain_send_fn send_fn,
+                                    tevent_req_fn done_fn)
+{
+    struct ifp_list_domain_req *dom_req;
+    struct tevent_req *req;
+    size_t concurrency;
+    errno_t ret;
+
+    if (list_ctx->doms == NULL) {
+        ret = ifp_list_ctx_init_domains(list_ctx);
+        if (ret != EOK) {
+            return ret;
+        }
+    }
+
+    concurrency = list_ctx->ctx->rctx->domain_lookup_concurrency;
+    if (concurrency < 1) {
+        concurrency = 1;
+    }
+
+    while (list_ctx->dom_pending < concurrency
+            && list_ctx->dom_started < list_ctx->dom_count) {
+        dom_req = talloc_zero(list_ctx, struct ifp_list_domain_req);
+        if (dom_req == NULL) {
+            return ENOMEM;
+        }
+
+        dom_req->list_ctx = list_ctx;
+        dom_req->idx = list_ctx->dom_started;
+
+        req = send_fn(list_ctx, list_ctx->doms[dom_req->idx]);
+        if (req == NULL) {
+            talloc_free(dom_req);
+            return ENOMEM;
+        }
+
+        talloc_steal(req, dom_req);
+        tevent_req_set_callback(req, done_fn, dom_req);
+
+        list_ctx->dom_started++;
+        list_ctx->dom_pending++;
+    }
+
+    return EOK;
+}
+
+bool ifp_list_ctx_domain_done(struct ifp_list_domain_req *dom_req,
+                              struct ldb_result *result)
+{
+    struct ifp_list_ctx *list_ctx = dom_req->list_ctx;
+
+    list_ctx->dom_results[dom_req->idx] = talloc_steal(list_ctx->dom_results,
+                                                       result);
+    list_ctx->dom_pending--;
+
+    return list_ctx->dom_pending == 0
+                && list_ctx->dom_started == list_ctx->dom_count;
+}
+
 size_t ifp_list_ctx_remaining_capacity(struct ifp_list_ctx *list_ctx,
                                        size_t entries)
 {
@@ -30,6 +30,11 @@
 #include "util/util.h"
 
 #define DEFAULT_KCM_FD_LIMIT 2048
+#define DEFAULT_KCM_CACHE_TIMEOUT 300
+#define DEFAULT_KCM_WRITEBACK_DELAY 1
+#define DEFAULT_KCM_MAX_UID_CCACHES 64
+#define DEFAULT_KCM_MAX_UID_CREDENTIALS 1024
+#define DEFAULT_KCM_MAX_PAYLOAD_SIZE 64
 
 #ifndef SSS_KCM_SOCKET_NAME
 #define SSS_KCM_SOCKET_NAME DEFAULT_KCM_SOCKET_PATH
@@ -72,12 +77,74 @@ static errno_t kcm_get_ccdb_be(struct kcm_ctx *kctx)
     } else if (strcasecmp(str_db, "secrets") == 0) {
         kctx->cc_be = CCDB_BE_SECRETS;
         return EOK;
+    } else if (strcasecmp(str_db, "tdb") == 0) {
+        kctx->cc_be = CCDB_BE_TDB;
+        return EOK;
     }
 
     DEBUG(SSSDBG_FATAL_FAILURE, "Unexpected KCM database type %s\n", str_db);
     return EOK;
 }
 
+/* Only the tdb storage is limited by the KCM service, sssd-secrets has
+ * its own limits */
+static errno_t kcm_get_limits(struct kcm_ctx *kctx)
+{
+    int max_uid_ccaches;
+    int max_uid_creds;
+    int max_payload_size;
+    errno_t ret;
+
+    ret = confdb_get_int(kctx->rctx->cdb,
+                         kctx->rctx->confdb_service_path,
+                         CONFDB_KCM_MAX_UID_CCACHES,
+                         DEFAULT_KCM_MAX_UID_CCACHES,
+                         &max_uid_ccaches);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Cannot get the maximum number of ccaches [%d]: %s\n",
+               ret, strerror(ret));
+        return ret;
+    }
+
+    ret = confdb_get_int(kctx->rctx->cdb,
+                         kctx->rctx->confdb_service_path,
+                         CONFDB_KCM_MAX_UID_CREDENTIALS,
+                         DEFAULT_KCM_MAX_UID_CREDENTIALS,
+                         &max_uid_creds);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Cannot get the maximum number of credentials [%d]: %s\n",
+               ret, strerror(ret));
+        return ret;
+    }
+
+    ret = confdb_get_int(kctx->rctx->cdb,
+                         kctx->rctx->confdb_service_path,
+                         CONFDB_KCM_MAX_PAYLOAD_SIZE,
+                         DEFAULT_KCM_MAX_PAYLOAD_SIZE,
+                         &max_payload_size);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Cannot get the maximum payload size [%d]: %s\n",
+               ret, strerror(ret));
+        return ret;
+    }
+
+    if (max_uid_ccaches < 0 || max_uid_creds < 0 || max_payload_size < 0
+            || max_payload_size > UINT32_MAX / 1024) {
+        DEBUG(SSSDBG_FATAL_FAILURE, "Invalid KCM ccache limits\n");
+        return EINVAL;
+    }
+
+    kctx->limits.max_uid_ccaches = max_uid_ccaches;
+    kctx->limits.max_uid_creds = max_uid_creds;
+    /* In kilobytes like the max_payload_size option of sssd-secrets */
+    kctx->limits.max_payload_size = max_payload_size * 1024;
+
+    return EOK;
+}
+
 static int kcm_get_config(struct kcm_ctx *kctx)
 {
     int ret;
@@ -133,6 +200,39 @@ static int kcm_get_config(struct kcm_ctx *kctx)
         goto done;
     }
 
+    ret = confdb_get_int(kctx->rctx->cdb,
+                         kctx->rctx->confdb_service_path,
+                         CONFDB_KCM_CACHE_TIMEOUT,
+                         DEFAULT_KCM_CACHE_TIMEOUT,
+                         &kctx->cache_timeout);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Cannot get the ccache cache timeout [%d]: %s\n",
+               ret, strerror(ret));
+        goto done;
+    }
+
+    ret = confdb_get_int(kctx->rctx->cdb,
+                         kctx->rctx->confdb_service_path,
+                         CONFDB_KCM_WRITEBACK_DELAY,
+                         DEFAULT_KCM_WRITEBACK_DELAY,
+                         &kctx->writeback_delay);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Cannot get the ccache write-back delay [%d]: %s\n",
+               ret, strerror(ret));
+        goto done;
+    }
+
+    if (kctx->writeback_delay < 0) {
+        kctx->writeback_delay = 0;
+    }
+
+    ret = kcm_get_limits(kctx);
+    if (ret != EOK) {
+        goto done;
+    }
+
     if (kctx->cc_be == CCDB_BE_SECRETS) {
         ret = responder_setup_idle_timeout_config(kctx->rctx);
         if (ret != EOK) {
@@ -166,10 +266,11 @@ static int kcm_data_destructor(void *ptr)
 
 static struct kcm_resp_ctx *kcm_data_setup(TALLOC_CTX *mem_ctx,
                                            struct tevent_context *ev,
-                                           enum kcm_ccdb_be cc_be)
+                                           struct kcm_ctx *kctx)
 {
     struct kcm_resp_ctx *kcm_data;
     krb5_error_code kret;
+    errno_t ret;
 
     kcm_data = talloc_zero(mem_ctx, struct kcm_resp_ctx);
     if (kcm_data == NULL) {
@@ -177,12 +278,30 @@ static struct kcm_resp_ctx *kcm_data_setup(TALLOC_CTX *mem_ctx,
         return NULL;
     }
 
-    kcm_data->db = kcm_ccdb_init(kcm_data, ev, cc_be);
+    kcm_data->db = kcm_ccdb_init(kcm_data, ev, kctx->cc_be);
     if (kcm_data->db == NULL) {
         talloc_free(kcm_data);
         return NULL;
     }
 
+    if (kctx->cc_be == CCDB_BE_TDB) {
+        kcm_ccdb_set_limits(kcm_data->db, &kctx->limits);
+    }
+
+    /* Caching the memory back end would only duplicate it */
+    if (kctx->cc_be != CCDB_BE_MEMORY && kctx->cache_timeout > 0) {
+        ret = kcm_ccdb_wb_setup(kcm_data->db,
+                                kctx->writeback_delay,
+                                kctx->cache_timeout);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_FATAL_FAILURE,
+                  "Cannot set up the ccache cache [%d]: %s\n",
+                  ret, sss_strerror(ret));
+            talloc_free(kcm_data);
+            return NULL;
+        }
+    }
+
     kret = krb5_init_context(&kcm_data->k5c);
     if (kret != EOK) {
         talloc_free(kcm_data);
@@ -193,15 +312,69 @@ static struct kcm_resp_ctx *kcm_data_setup(TALLOC_CTX *mem_ctx,
     return kcm_data;
 }
 
-static int kcm_process_init(TALLOC_CTX *mem_ctx,
+static void kcm_shutdown_done(struct tevent_req *req);
+
+/* Exits once the modified ccaches are written back */
+static void kcm_shutdown(struct resp_ctx *rctx)
+{
+    struct kcm_ctx *kctx = talloc_get_type(rctx->pvt_ctx, struct kcm_ctx);
+    struct tevent_req *req;
+
+    if (kctx->exiting) {
+        return;
+    }
+    kctx->exiting = true;
+
+    req = kcm_ccdb_wb_shutdown_send(kctx, rctx->ev, kctx->kcm_data->db);
+    if (req == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Cannot write back the cached ccaches, exiting anyway\n");
+        talloc_free(rctx);
+        orderly_shutdown(0);
+        return;
+    }
+    tevent_req_set_callback(req, kcm_shutdown_done, rctx);
+}
+
+static void kcm_shutdown_done(struct tevent_req *req)
+{
+    struct resp_ctx *rctx = tevent_req_callback_data(req, struct resp_ctx);
+    errno_t ret;
+
+    ret = kcm_ccdb_wb_shutdown_recv(req);
+    talloc_free(req);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Not all cached ccaches were written back [%d]: %s\n",
+              ret, sss_strerror(ret));
+    }
+
+    talloc_free(rctx);
+    orderly_shutdown(0);
+}
+
+static void kcm_sigterm(struct tevent_context *ev,
+                        struct tevent_signal *se,
+                        int signum,
+                        int count,
+                        void *siginfo,
+                        void *private_data)
+{
+    struct resp_ctx *rctx = talloc_get_type(private_data, struct resp_ctx);
+
+    kcm_shutdown(rctx);
+}
+
+static int kcm_process_init(struct main_context *main_ctx,
                             struct tevent_context *ev,
                             struct confdb_ctx *cdb)
 {
+    struct tevent_signal *sige;
     struct resp_ctx *rctx;
     struct kcm_ctx *kctx;
     int ret;
 
-    rctx = talloc_zero(mem_ctx, struct resp_ctx);
+    rctx = talloc_zero(main_ctx, struct resp_ctx);
     if (rctx == NULL) {
         DEBUG(SSSDBG_FATAL_FAILURE, "fatal error initializing resp_ctx\n");
         return ENOMEM;
@@ -231,7 +404,7 @@ static int kcm_process_init(TALLOC_CTX *mem_ctx,
         goto fail;
     }
 
-    kctx->kcm_data = kcm_data_setup(kctx, ev, kctx->cc_be);
+    kctx->kcm_data = kcm_data_setup(kctx, ev, kctx);
     if (kctx->kcm_data == NULL) {
         DEBUG(SSSDBG_FATAL_FAILURE,
               "fatal error initializing responder data\n");
@@ -239,6 +412,17 @@ static int kcm_process_init(TALLOC_CTX *mem_ctx,
         goto fail;
     }
 
+    /* Replace the default SIGTERM handler so that the ccaches are written
+     * back before exiting, the same is done when the responder is idle */
+    sige = tevent_add_signal(ev, rctx, SIGTERM, 0, kcm_sigterm, rctx);
+    if (sige == NULL) {
+        DEBUG(SSSDBG_FATAL_FAILURE, "tevent_add_signal failed.\n");
+        ret = ENOMEM;
+        goto fail;
+    }
+    talloc_zfree(main_ctx->sigterm);
+    rctx->idle_shutdown_fn = kcm_shutdown;
+
     /* Set up file descriptor limits */
     responder_set_fd_limit(kctx->fd_limit);
 
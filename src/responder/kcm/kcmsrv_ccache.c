@@ -246,6 +246,10 @@ struct kcm_ccdb *kcm_ccdb_init(TALLOC_CTX *mem_ctx,
         DEBUG(SSSDBG_FUNC_DATA, "KCM back end: sssd-secrets\n");
         ccdb->ops = &ccdb_sec_ops;
         break;
+    case CCDB_BE_TDB:
+        DEBUG(SSSDBG_FUNC_DATA, "KCM back end: tdb\n");
+        ccdb->ops = &ccdb_tdb_ops;
+        break;
     default:
         DEBUG(SSSDBG_CRIT_FAILURE, "Unknown ccache database\n");
         break;
@@ -267,6 +271,57 @@ struct kcm_ccdb *kcm_ccdb_init(TALLOC_CTX *mem_ctx,
     return ccdb;
 }
 
+void kcm_ccdb_set_limits(struct kcm_ccdb *db,
+                         const struct kcm_ccdb_limits *limits)
+{
+    db->limits = *limits;
+
+    DEBUG(SSSDBG_CONF_SETTINGS,
+          "KCM ccache limits: %"PRIu32" ccaches, %"PRIu32" credentials "
+          "per UID, %"PRIu32" bytes per credential\n",
+          limits->max_uid_ccaches, limits->max_uid_creds,
+          limits->max_payload_size);
+}
+
+errno_t kcm_ccdb_check_quota(const struct kcm_ccdb_limits *limits,
+                             size_t num_ccaches,
+                             size_t num_creds)
+{
+    if (limits->max_uid_ccaches != 0
+            && num_ccaches > limits->max_uid_ccaches) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Cannot store more than %"PRIu32" ccaches per UID\n",
+              limits->max_uid_ccaches);
+        return EDQUOT;
+    }
+
+    if (limits->max_uid_creds != 0
+            && num_creds > limits->max_uid_creds) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Cannot store more than %"PRIu32" credentials per UID\n",
+              limits->max_uid_creds);
+        return EDQUOT;
+    }
+
+    return EOK;
+}
+
+errno_t kcm_ccdb_check_payload(const struct kcm_ccdb_limits *limits,
+                               struct sss_iobuf *cred_blob)
+{
+    size_t size;
+
+    size = sss_iobuf_get_size(cred_blob);
+    if (limits->max_payload_size != 0 && size > limits->max_payload_size) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "The credential is %zu bytes, the limit is %"PRIu32"\n",
+              size, limits->max_payload_size);
+        return ERR_KCM_PAYLOAD_TOO_LARGE;
+    }
+
+    return EOK;
+}
+
 struct kcm_ccdb_nextid_state {
     char *next_cc;
     struct kcm_ccdb *db;
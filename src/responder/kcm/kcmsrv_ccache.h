@@ -124,6 +124,34 @@ struct kcm_ccdb *kcm_ccdb_init(TALLOC_CTX *mem_ctx,
                                struct tevent_context *ev,
                                enum kcm_ccdb_be cc_be);
 
+/*
+ * Set the limits of the ccache database. Must be called before
+ * kcm_ccdb_wb_setup() so that the cache enforces them as well.
+ */
+void kcm_ccdb_set_limits(struct kcm_ccdb *db,
+                         const struct kcm_ccdb_limits *limits);
+
+/*
+ * Put an in-memory cache in front of the ccache database. Reads are then
+ * served from memory and modifications are written back to the original
+ * database writeback_delay seconds later, coalesced per UID. The ccaches
+ * of a UID are dropped from memory after idle_timeout seconds of inactivity.
+ */
+errno_t kcm_ccdb_wb_setup(struct kcm_ccdb *db,
+                          uint32_t writeback_delay,
+                          uint32_t idle_timeout);
+
+/*
+ * Write back all modified ccaches right away, to be used before the
+ * responder exits. Finishes with EOK also if db is not cached, ETIMEDOUT
+ * if the write-back did not finish in time and EIO if it failed.
+ */
+struct tevent_req *kcm_ccdb_wb_shutdown_send(TALLOC_CTX *mem_ctx,
+                                             struct tevent_context *ev,
+                                             struct kcm_ccdb *db);
+
+errno_t kcm_ccdb_wb_shutdown_recv(struct tevent_req *req);
+
 /*
  * In KCM, each ccache name is usually in the form of "UID:<num>
  *
@@ -348,4 +376,24 @@ errno_t kcm_ccache_to_sec_input(TALLOC_CTX *mem_ctx,
                                 const char **_url,
                                 struct sss_iobuf **_payload);
 
+/*
+ * ccache marshalling to and from the binary format used by the tdb back
+ * end. The binary header contains the ccache properties and the UUIDs of
+ * the credentials, the credentials themselves are stored separately.
+ */
+errno_t kcm_ccache_to_binary(TALLOC_CTX *mem_ctx,
+                             struct kcm_ccache *cc,
+                             struct sss_iobuf **_payload);
+
+/*
+ * The returned ccache contains no credentials, the UUIDs of the
+ * credentials are returned in _cred_uuids instead.
+ */
+errno_t kcm_binary_to_ccache(TALLOC_CTX *mem_ctx,
+                             const uint8_t *data,
+                             size_t len,
+                             struct kcm_ccache **_cc,
+                             uuid_t **_cred_uuids,
+                             size_t *_num_creds);
+
 #endif /* _KCMSRV_CCACHE_H_ */
@@ -199,7 +199,24 @@ struct kcm_ccdb_ops {
     ccdb_delete_recv_fn delete_recv;
 };
 
+/*
+ * Returns EDQUOT if a UID with num_ccaches ccaches that hold num_creds
+ * credentials in total is over the limits. The back ends call it with the
+ * numbers the UID would have after the change, before writing anything.
+ */
+errno_t kcm_ccdb_check_quota(const struct kcm_ccdb_limits *limits,
+                             size_t num_ccaches,
+                             size_t num_creds);
+
+/*
+ * Returns ERR_KCM_PAYLOAD_TOO_LARGE if a single credential is over the
+ * limits
+ */
+errno_t kcm_ccdb_check_payload(const struct kcm_ccdb_limits *limits,
+                               struct sss_iobuf *cred_blob);
+
 extern const struct kcm_ccdb_ops ccdb_mem_ops;
 extern const struct kcm_ccdb_ops ccdb_sec_ops;
+extern const struct kcm_ccdb_ops ccdb_tdb_ops;
 
 #endif /* _KCMSRV_CCACHE_BE_ */
@@ -0,0 +1,427 @@
+/*
+   SSSD
+
+   KCM Server - ccache binary (de)serialization
+
+   Copyright (C) Red Hat, 2017
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <talloc.h>
+
+#include "util/util.h"
+#include "util/util_creds.h"
+#include "responder/kcm/kcmsrv_ccache_pvt.h"
+
+/* The version of the binary ccache header format */
+#define KCM_BINARY_VERSION 1
+
+/* Sanity limits for decoding, a ccache header is never that big */
+#define KCM_BINARY_MAX_COMPONENTS 64
+#define KCM_BINARY_MAX_CREDS      65536
+
+/*
+ * The binary ccache header contains all ccache properties but the
+ * credentials themselves. Only the UUIDs of the credentials are listed, the
+ * credentials are stored separately, so that adding a credential doesn't
+ * require rewriting the others. All numbers are in host byte order:
+ *
+ *      uint32_t version
+ *      uuid     uuid
+ *      string   name
+ *      uint32_t owner uid
+ *      uint32_t owner gid
+ *      int32_t  kdc_offset
+ *      uint32_t has_principal
+ *      [
+ *          int32_t  principal type
+ *          string   realm
+ *          uint32_t number of components
+ *          string   component[number of components]
+ *      ]
+ *      uint32_t number of credentials
+ *      uuid     credential uuid[number of credentials]
+ *
+ * A string is an uint32_t length followed by the data without the
+ * terminating NUL.
+ */
+
+static errno_t kcm_bin_write_data(struct sss_iobuf *buf,
+                                  const char *data,
+                                  uint32_t len)
+{
+    errno_t ret;
+
+    ret = sss_iobuf_write_uint32(buf, len);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    if (len == 0) {
+        return EOK;
+    }
+
+    return sss_iobuf_write_len(buf, discard_const(data), len);
+}
+
+/* The result is always NUL-terminated */
+static errno_t kcm_bin_read_data(TALLOC_CTX *mem_ctx,
+                                 struct sss_iobuf *buf,
+                                 char **_data,
+                                 uint32_t *_len)
+{
+    uint32_t len;
+    char *data;
+    errno_t ret;
+
+    ret = sss_iobuf_read_uint32(buf, &len);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    if (len > sss_iobuf_get_size(buf) - sss_iobuf_get_len(buf)) {
+        return EINVAL;
+    }
+
+    data = talloc_size(mem_ctx, len + 1);
+    if (data == NULL) {
+        return ENOMEM;
+    }
+
+    ret = sss_iobuf_read_len(buf, len, (uint8_t *) data);
+    if (ret != EOK) {
+        talloc_free(data);
+        return ret;
+    }
+    data[len] = '\0';
+
+    *_data = data;
+    if (_len != NULL) {
+        *_len = len;
+    }
+    return EOK;
+}
+
+static errno_t kcm_bin_write_princ(struct sss_iobuf *buf,
+                                   krb5_principal princ)
+{
+    errno_t ret;
+    krb5_int32 i;
+
+    ret = sss_iobuf_write_uint32(buf, princ == NULL ? 0 : 1);
+    if (ret != EOK || princ == NULL) {
+        return ret;
+    }
+
+    ret = sss_iobuf_write_int32(buf, princ->type);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    ret = kcm_bin_write_data(buf, princ->realm.data, princ->realm.length);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    ret = sss_iobuf_write_uint32(buf, princ->length);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    for (i = 0; i < princ->length; i++) {
+        ret = kcm_bin_write_data(buf, princ->data[i].data,
+                                 princ->data[i].length);
+        if (ret != EOK) {
+            return ret;
+        }
+    }
+
+    return EOK;
+}
+
+static errno_t kcm_bin_read_princ(TALLOC_CTX *mem_ctx,
+                                  struct sss_iobuf *buf,
+                                  krb5_principal *_princ)
+{
+    krb5_principal princ;
+    uint32_t has_princ;
+    uint32_t num_components;
+    uint32_t i;
+    errno_t ret;
+
+    ret = sss_iobuf_read_uint32(buf, &has_princ);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    if (has_princ == 0) {
+        *_princ = NULL;
+        return EOK;
+    }
+
+    princ = talloc_zero(mem_ctx, struct krb5_principal_data);
+    if (princ == NULL) {
+        return ENOMEM;
+    }
+    princ->magic = KV5M_PRINCIPAL;
+
+    ret = sss_iobuf_read_int32(buf, &princ->type);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = kcm_bin_read_data(princ, buf, &princ->realm.data,
+                            &princ->realm.length);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = sss_iobuf_read_uint32(buf, &num_components);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    if (num_components > KCM_BINARY_MAX_COMPONENTS) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Too many principal components: %"PRIu32"\n", num_components);
+        ret = EINVAL;
+        goto done;
+    }
+
+    princ->data = talloc_zero_array(princ, krb5_data, num_components);
+    if (princ->data == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+    princ->length = num_components;
+
+    for (i = 0; i < num_components; i++) {
+        ret = kcm_bin_read_data(princ->data, buf, &princ->data[i].data,
+                                &princ->data[i].length);
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
+    *_princ = princ;
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        talloc_free(princ);
+    }
+    return ret;
+}
+
+errno_t kcm_ccache_to_binary(TALLOC_CTX *mem_ctx,
+                             struct kcm_ccache *cc,
+                             struct sss_iobuf **_payload)
+{
+    struct sss_iobuf *buf;
+    struct kcm_cred *crd;
+    uint32_t num_creds = 0;
+    errno_t ret;
+
+    if (cc == NULL || cc->name == NULL) {
+        return EINVAL;
+    }
+
+    buf = sss_iobuf_init_empty(mem_ctx, sizeof(uint32_t), 0);
+    if (buf == NULL) {
+        return ENOMEM;
+    }
+
+    ret = sss_iobuf_write_uint32(buf, KCM_BINARY_VERSION);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = sss_iobuf_write_len(buf, cc->uuid, UUID_BYTES);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = kcm_bin_write_data(buf, cc->name, strlen(cc->name));
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = sss_iobuf_write_uint32(buf, cc->owner.uid);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = sss_iobuf_write_uint32(buf, cc->owner.gid);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = sss_iobuf_write_int32(buf, cc->kdc_offset);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = kcm_bin_write_princ(buf, cc->client);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    DLIST_FOR_EACH(crd, cc->creds) {
+        num_creds++;
+    }
+
+    ret = sss_iobuf_write_uint32(buf, num_creds);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    DLIST_FOR_EACH(crd, cc->creds) {
+        ret = sss_iobuf_write_len(buf, crd->uuid, UUID_BYTES);
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
+    *_payload = buf;
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Cannot serialize ccache [%d]: %s\n", ret, sss_strerror(ret));
+        talloc_free(buf);
+    }
+    return ret;
+}
+
+errno_t kcm_binary_to_ccache(TALLOC_CTX *mem_ctx,
+                             const uint8_t *data,
+                             size_t len,
+                             struct kcm_ccache **_cc,
+                             uuid_t **_cred_uuids,
+                             size_t *_num_creds)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sss_iobuf *buf;
+    struct kcm_ccache *cc;
+    uuid_t *cred_uuids;
+    uint32_t version;
+    uint32_t num_creds;
+    uint32_t i;
+    char *name;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    buf = sss_iobuf_init_readonly(tmp_ctx, data, len);
+    if (buf == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = sss_iobuf_read_uint32(buf, &version);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    if (version != KCM_BINARY_VERSION) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Expected version %d, received version %"PRIu32"\n",
+              KCM_BINARY_VERSION, version);
+        ret = EINVAL;
+        goto done;
+    }
+
+    cc = talloc_zero(tmp_ctx, struct kcm_ccache);
+    if (cc == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = sss_iobuf_read_len(buf, UUID_BYTES, cc->uuid);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = kcm_bin_read_data(cc, buf, &name, NULL);
+    if (ret != EOK) {
+        goto done;
+    }
+    cc->name = name;
+
+    ret = sss_iobuf_read_uint32(buf, &cc->owner.uid);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = sss_iobuf_read_uint32(buf, &cc->owner.gid);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = sss_iobuf_read_int32(buf, &cc->kdc_offset);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = kcm_bin_read_princ(cc, buf, &cc->client);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = sss_iobuf_read_uint32(buf, &num_creds);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    if (num_creds > KCM_BINARY_MAX_CREDS) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Too many credentials: %"PRIu32"\n", num_creds);
+        ret = EINVAL;
+        goto done;
+    }
+
+    cred_uuids = talloc_zero_array(tmp_ctx, uuid_t, num_creds);
+    if (cred_uuids == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    for (i = 0; i < num_creds; i++) {
+        ret = sss_iobuf_read_len(buf, UUID_BYTES, cred_uuids[i]);
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
+    *_cc = talloc_steal(mem_ctx, cc);
+    *_cred_uuids = talloc_steal(mem_ctx, cred_uuids);
+    *_num_creds = num_creds;
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Cannot deserialize ccache [%d]: %s\n", ret, sss_strerror(ret));
+    }
+    talloc_free(tmp_ctx);
+    return ret;
+}
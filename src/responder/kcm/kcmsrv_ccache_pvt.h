@@ -46,6 +46,8 @@ struct kcm_ccdb {
 
     void *db_handle;
     const struct kcm_ccdb_ops *ops;
+
+    struct kcm_ccdb_limits limits;
 };
 
 struct kcm_ccache {
@@ -0,0 +1,1590 @@
+/*
+   SSSD
+
+   KCM Server - ccache storage in a local encrypted TDB file
+
+   Copyright (C) Red Hat, 2017
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <talloc.h>
+#include <tdb.h>
+
+#include "util/util.h"
+#include "util/crypto/sss_crypto.h"
+#include "responder/kcm/kcmsrv_ccache_pvt.h"
+#include "responder/kcm/kcmsrv_ccache_be.h"
+
+#ifdef UNIT_TESTING
+#ifdef TEST_DB_PATH
+#define KCM_TDB_DIR         TEST_DB_PATH
+#else
+#error "TEST_DB_PATH must be defined when unit testing kcmsrv_ccache_tdb.c!"
+#endif /* TEST_DB_PATH */
+#else
+#define KCM_TDB_DIR         SECRETS_DB_PATH
+#endif /* UNIT_TESTING */
+
+#define KCM_TDB_PATH        KCM_TDB_DIR"/kcm.tdb"
+#define KCM_TDB_MKEY_PATH   KCM_TDB_DIR"/.kcm.mkey"
+#define KCM_TDB_MKEY_SIZE   (256 / 8)
+
+#define KCM_TDB_MAX_CC_NUM  99999
+
+/*
+ * The ccaches are stored in a TDB file owned by sssd_kcm. Each client UID
+ * has its own key space:
+ *
+ *      list/<uid>                      UUIDs of all the ccaches of the UID
+ *      default/<uid>                   UUID of the default ccache
+ *      nextid/<uid>                    the next ccache number to try
+ *      name/<uid>/<name>               UUID of the ccache called <name>
+ *      ccache/<uid>/<uuid>             the binary ccache header
+ *      cred/<uid>/<uuid>/<cred_uuid>   a single credential
+ *
+ * The ccache headers and the credentials are encrypted with a master
+ * key, the other records only contain UUIDs and counters.
+ *
+ * Because each credential is a separate record, storing a credential only
+ * writes the credential and the (small) ccache header.
+ */
+struct ccdb_tdb {
+    struct tdb_context *tdb;
+
+    uint8_t *mkey;
+    size_t mkey_len;
+};
+
+/* All the operations are synchronous, so we don't need any state in
+ * most requests
+ */
+struct ccdb_tdb_dummy_state {
+};
+
+static TDB_DATA ccdb_tdb_key(const char *key)
+{
+    TDB_DATA tkey;
+
+    tkey.dptr = (uint8_t *) discard_const(key);
+    tkey.dsize = strlen(key);
+
+    return tkey;
+}
+
+static const char *ccdb_tdb_uid_key(TALLOC_CTX *mem_ctx,
+                                    const char *prefix,
+                                    struct cli_creds *client)
+{
+    return talloc_asprintf(mem_ctx, "%s/%"SPRIuid,
+                           prefix, cli_creds_get_uid(client));
+}
+
+static const char *ccdb_tdb_name_key(TALLOC_CTX *mem_ctx,
+                                     struct cli_creds *client,
+                                     const char *name)
+{
+    return talloc_asprintf(mem_ctx, "name/%"SPRIuid"/%s",
+                           cli_creds_get_uid(client), name);
+}
+
+static const char *ccdb_tdb_cc_key(TALLOC_CTX *mem_ctx,
+                                   struct cli_creds *client,
+                                   uuid_t uuid)
+{
+    char uuid_str[UUID_STR_SIZE];
+
+    uuid_unparse(uuid, uuid_str);
+    return talloc_asprintf(mem_ctx, "ccache/%"SPRIuid"/%s",
+                           cli_creds_get_uid(client), uuid_str);
+}
+
+static const char *ccdb_tdb_cred_key(TALLOC_CTX *mem_ctx,
+                                     struct cli_creds *client,
+                                     uuid_t cc_uuid,
+                                     uuid_t cred_uuid)
+{
+    char cc_uuid_str[UUID_STR_SIZE];
+    char cred_uuid_str[UUID_STR_SIZE];
+
+    uuid_unparse(cc_uuid, cc_uuid_str);
+    uuid_unparse(cred_uuid, cred_uuid_str);
+    return talloc_asprintf(mem_ctx, "cred/%"SPRIuid"/%s/%s",
+                           cli_creds_get_uid(client),
+                           cc_uuid_str, cred_uuid_str);
+}
+
+/* Returns ENOENT if the key does not exist */
+static errno_t ccdb_tdb_fetch(TALLOC_CTX *mem_ctx,
+                              struct ccdb_tdb *tdb_db,
+                              const char *key,
+                              uint8_t **_data,
+                              size_t *_len)
+{
+    TDB_DATA data;
+    uint8_t *out;
+
+    if (key == NULL) {
+        return ENOMEM;
+    }
+
+    data = tdb_fetch(tdb_db->tdb, ccdb_tdb_key(key));
+    if (data.dptr == NULL) {
+        if (tdb_error(tdb_db->tdb) == TDB_ERR_NOEXIST) {
+            return ENOENT;
+        }
+
+        DEBUG(SSSDBG_OP_FAILURE, "Cannot fetch %s: %s\n",
+              key, tdb_errorstr(tdb_db->tdb));
+        return EIO;
+    }
+
+    out = talloc_memdup(mem_ctx, data.dptr, data.dsize);
+    safezero(data.dptr, data.dsize);
+    free(data.dptr);
+    if (out == NULL) {
+        return ENOMEM;
+    }
+
+    *_data = out;
+    *_len = data.dsize;
+    return EOK;
+}
+
+static errno_t ccdb_tdb_store(struct ccdb_tdb *tdb_db,
+                              const char *key,
+                              const uint8_t *data,
+                              size_t len)
+{
+    TDB_DATA tdata;
+    int tret;
+
+    if (key == NULL) {
+        return ENOMEM;
+    }
+
+    tdata.dptr = (uint8_t *) discard_const(data);
+    tdata.dsize = len;
+
+    tret = tdb_store(tdb_db->tdb, ccdb_tdb_key(key), tdata, TDB_REPLACE);
+    if (tret != 0) {
+        DEBUG(SSSDBG_OP_FAILURE, "Cannot store %s: %s\n",
+              key, tdb_errorstr(tdb_db->tdb));
+        return EIO;
+    }
+
+    return EOK;
+}
+
+/* Deleting a key that does not exist is not an error */
+static errno_t ccdb_tdb_delete(struct ccdb_tdb *tdb_db,
+                               const char *key)
+{
+    int tret;
+
+    if (key == NULL) {
+        return ENOMEM;
+    }
+
+    tret = tdb_delete(tdb_db->tdb, ccdb_tdb_key(key));
+    if (tret != 0 && tdb_error(tdb_db->tdb) != TDB_ERR_NOEXIST) {
+        DEBUG(SSSDBG_OP_FAILURE, "Cannot delete %s: %s\n",
+              key, tdb_errorstr(tdb_db->tdb));
+        return EIO;
+    }
+
+    return EOK;
+}
+
+static errno_t ccdb_tdb_fetch_enc(TALLOC_CTX *mem_ctx,
+                                  struct ccdb_tdb *tdb_db,
+                                  const char *key,
+                                  uint8_t **_data,
+                                  size_t *_len)
+{
+    uint8_t *enc_data;
+    size_t enc_len;
+    errno_t ret;
+
+    ret = ccdb_tdb_fetch(mem_ctx, tdb_db, key, &enc_data, &enc_len);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    ret = sss_decrypt(mem_ctx, AES256CBC_HMAC_SHA256,
+                      tdb_db->mkey, tdb_db->mkey_len,
+                      enc_data, enc_len,
+                      _data, _len);
+    talloc_free(enc_data);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Cannot decrypt %s [%d]: %s\n", key, ret, sss_strerror(ret));
+        return ret;
+    }
+
+    return EOK;
+}
+
+static errno_t ccdb_tdb_store_enc(struct ccdb_tdb *tdb_db,
+                                  const char *key,
+                                  const uint8_t *data,
+                                  size_t len)
+{
+    uint8_t *enc_data;
+    size_t enc_len;
+    errno_t ret;
+
+    ret = sss_encrypt(tdb_db, AES256CBC_HMAC_SHA256,
+                      tdb_db->mkey, tdb_db->mkey_len,
+                      data, len,
+                      &enc_data, &enc_len);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Cannot encrypt %s [%d]: %s\n", key, ret, sss_strerror(ret));
+        return ret;
+    }
+
+    ret = ccdb_tdb_store(tdb_db, key, enc_data, enc_len);
+    talloc_free(enc_data);
+    return ret;
+}
+
+static errno_t ccdb_tdb_transaction_start(struct ccdb_tdb *tdb_db)
+{
+    if (tdb_transaction_start(tdb_db->tdb) != 0) {
+        DEBUG(SSSDBG_OP_FAILURE, "Cannot start a transaction: %s\n",
+              tdb_errorstr(tdb_db->tdb));
+        return EIO;
+    }
+
+    return EOK;
+}
+
+static errno_t ccdb_tdb_transaction_commit(struct ccdb_tdb *tdb_db)
+{
+    if (tdb_transaction_commit(tdb_db->tdb) != 0) {
+        DEBUG(SSSDBG_OP_FAILURE, "Cannot commit a transaction: %s\n",
+              tdb_errorstr(tdb_db->tdb));
+        return EIO;
+    }
+
+    return EOK;
+}
+
+static void ccdb_tdb_transaction_cancel(struct ccdb_tdb *tdb_db)
+{
+    if (tdb_transaction_cancel(tdb_db->tdb) != 0) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Cannot cancel a transaction: %s\n",
+              tdb_errorstr(tdb_db->tdb));
+    }
+}
+
+/* Reads the ccache header. If load_creds is false, the credentials in
+ * the returned ccache only contain their UUIDs, which is enough to write
+ * the header back. Returns ERR_KCM_CC_END if there is no such ccache.
+ */
+static errno_t ccdb_tdb_get_cc(TALLOC_CTX *mem_ctx,
+                               struct ccdb_tdb *tdb_db,
+                               struct cli_creds *client,
+                               uuid_t uuid,
+                               bool load_creds,
+                               struct kcm_ccache **_cc)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct kcm_ccache *cc;
+    struct kcm_cred *crd;
+    struct sss_iobuf *cred_blob;
+    uuid_t *cred_uuids;
+    size_t num_creds;
+    uint8_t *data;
+    size_t len;
+    size_t i;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    ret = ccdb_tdb_fetch_enc(tmp_ctx, tdb_db,
+                             ccdb_tdb_cc_key(tmp_ctx, client, uuid),
+                             &data, &len);
+    if (ret == ENOENT) {
+        ret = ERR_KCM_CC_END;
+        goto done;
+    } else if (ret != EOK) {
+        goto done;
+    }
+
+    ret = kcm_binary_to_ccache(tmp_ctx, data, len,
+                               &cc, &cred_uuids, &num_creds);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    /* The header lists the newest credential first, kcm_cc_store_creds()
+     * prepends, so go backwards to keep the order */
+    for (i = num_creds; i > 0; i--) {
+        cred_blob = NULL;
+
+        if (load_creds) {
+            ret = ccdb_tdb_fetch_enc(tmp_ctx, tdb_db,
+                                     ccdb_tdb_cred_key(tmp_ctx, client, uuid,
+                                                       cred_uuids[i - 1]),
+                                     &data, &len);
+            if (ret == ENOENT) {
+                DEBUG(SSSDBG_MINOR_FAILURE,
+                      "A credential of ccache %s is missing, skipping\n",
+                      cc->name);
+                continue;
+            } else if (ret != EOK) {
+                goto done;
+            }
+
+            cred_blob = sss_iobuf_init_readonly(tmp_ctx, data, len);
+            safezero(data, len);
+            talloc_free(data);
+            if (cred_blob == NULL) {
+                ret = ENOMEM;
+                goto done;
+            }
+        }
+
+        crd = kcm_cred_new(cc, cred_uuids[i - 1], cred_blob);
+        if (crd == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        ret = kcm_cc_store_creds(cc, crd);
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
+    *_cc = talloc_steal(mem_ctx, cc);
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static errno_t ccdb_tdb_put_cc(struct ccdb_tdb *tdb_db,
+                               struct cli_creds *client,
+                               struct kcm_ccache *cc)
+{
+    struct sss_iobuf *payload;
+    errno_t ret;
+
+    ret = kcm_ccache_to_binary(tdb_db, cc, &payload);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    ret = ccdb_tdb_store_enc(tdb_db,
+                             ccdb_tdb_cc_key(payload, client, cc->uuid),
+                             sss_iobuf_get_data(payload),
+                             sss_iobuf_get_len(payload));
+    talloc_free(payload);
+    return ret;
+}
+
+static errno_t ccdb_tdb_put_cred(struct ccdb_tdb *tdb_db,
+                                 struct cli_creds *client,
+                                 struct kcm_ccache *cc,
+                                 struct kcm_cred *crd)
+{
+    const char *key;
+    errno_t ret;
+
+    key = ccdb_tdb_cred_key(tdb_db, client, cc->uuid, crd->uuid);
+    ret = ccdb_tdb_store_enc(tdb_db, key,
+                             sss_iobuf_get_data(crd->cred_blob),
+                             sss_iobuf_get_size(crd->cred_blob));
+    talloc_free(discard_const(key));
+    return ret;
+}
+
+static errno_t ccdb_tdb_get_uuid_list(TALLOC_CTX *mem_ctx,
+                                      struct ccdb_tdb *tdb_db,
+                                      struct cli_creds *client,
+                                      uuid_t **_uuids,
+                                      size_t *_num_uuids)
+{
+    TALLOC_CTX *tmp_ctx;
+    uint8_t *data = NULL;
+    size_t len = 0;
+    uuid_t *uuids;
+    size_t num_uuids;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    ret = ccdb_tdb_fetch(tmp_ctx, tdb_db,
+                         ccdb_tdb_uid_key(tmp_ctx, "list", client),
+                         &data, &len);
+    if (ret == ENOENT) {
+        len = 0;
+    } else if (ret != EOK) {
+        goto done;
+    }
+
+    if (len % UUID_BYTES != 0) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Malformed ccache list\n");
+        ret = EINVAL;
+        goto done;
+    }
+    num_uuids = len / UUID_BYTES;
+
+    /* The list is returned NULL-UUID terminated */
+    uuids = talloc_zero_array(mem_ctx, uuid_t, num_uuids + 1);
+    if (uuids == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    if (len > 0) {
+        memcpy(uuids, data, len);
+    }
+    uuid_clear(uuids[num_uuids]);
+
+    *_uuids = uuids;
+    *_num_uuids = num_uuids;
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static errno_t ccdb_tdb_put_uuid_list(struct ccdb_tdb *tdb_db,
+                                      struct cli_creds *client,
+                                      uuid_t *uuids,
+                                      size_t num_uuids)
+{
+    const char *key;
+    errno_t ret;
+
+    key = ccdb_tdb_uid_key(tdb_db, "list", client);
+    if (num_uuids == 0) {
+        ret = ccdb_tdb_delete(tdb_db, key);
+    } else {
+        ret = ccdb_tdb_store(tdb_db, key, (const uint8_t *) uuids,
+                             num_uuids * UUID_BYTES);
+    }
+    talloc_free(discard_const(key));
+    return ret;
+}
+
+static int ccdb_tdb_destructor(struct ccdb_tdb *tdb_db)
+{
+    if (tdb_db->tdb != NULL) {
+        tdb_close(tdb_db->tdb);
+        tdb_db->tdb = NULL;
+    }
+
+    if (tdb_db->mkey != NULL) {
+        safezero(tdb_db->mkey, tdb_db->mkey_len);
+    }
+
+    return 0;
+}
+
+static errno_t ccdb_tdb_generate_mkey(const char *filename, size_t size)
+{
+    uint8_t buf[size];
+    ssize_t wsize;
+    errno_t ret;
+    int fd;
+
+    ret = generate_csprng_buffer(buf, size);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "generate_csprng_buffer failed [%d]: %s\n",
+              ret, sss_strerror(ret));
+        return ret;
+    }
+
+    fd = open(filename, O_CREAT|O_EXCL|O_WRONLY, 0600);
+    if (fd == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_OP_FAILURE,
+              "open(%s) failed [%d]: %s\n", filename, ret, strerror(ret));
+        safezero(buf, size);
+        return ret;
+    }
+
+    wsize = sss_atomic_write_s(fd, buf, size);
+    close(fd);
+    safezero(buf, size);
+    if (wsize != size) {
+        DEBUG(SSSDBG_OP_FAILURE, "Cannot write the KCM master key\n");
+        if (unlink(filename) != 0) {
+            ret = errno;
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "Failed to remove file: %s - %d [%s]!\n",
+                  filename, ret, sss_strerror(ret));
+        }
+        return EIO;
+    }
+
+    return EOK;
+}
+
+static errno_t ccdb_tdb_read_mkey(struct ccdb_tdb *tdb_db)
+{
+    ssize_t size;
+    errno_t ret;
+    int fd;
+
+    tdb_db->mkey = talloc_size(tdb_db, KCM_TDB_MKEY_SIZE);
+    if (tdb_db->mkey == NULL) {
+        return ENOMEM;
+    }
+    tdb_db->mkey_len = KCM_TDB_MKEY_SIZE;
+
+    ret = check_and_open_readonly(KCM_TDB_MKEY_PATH, &fd, geteuid(), getegid(),
+                                  S_IFREG|S_IRUSR|S_IWUSR, 0);
+    if (ret == ENOENT) {
+        DEBUG(SSSDBG_TRACE_FUNC, "No KCM master key, generating a new one\n");
+
+        ret = ccdb_tdb_generate_mkey(KCM_TDB_MKEY_PATH, KCM_TDB_MKEY_SIZE);
+        if (ret != EOK) {
+            return ret;
+        }
+
+        ret = check_and_open_readonly(KCM_TDB_MKEY_PATH, &fd,
+                                      geteuid(), getegid(),
+                                      S_IFREG|S_IRUSR|S_IWUSR, 0);
+    }
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Cannot open the KCM master key [%d]: %s\n",
+              ret, sss_strerror(ret));
+        return ret;
+    }
+
+    size = sss_atomic_read_s(fd, tdb_db->mkey, tdb_db->mkey_len);
+    close(fd);
+    if (size < 0 || size != tdb_db->mkey_len) {
+        DEBUG(SSSDBG_OP_FAILURE, "Cannot read the KCM master key\n");
+        return EIO;
+    }
+
+    return EOK;
+}
+
+static errno_t ccdb_tdb_init(struct kcm_ccdb *db)
+{
+    struct ccdb_tdb *tdb_db;
+    errno_t ret;
+
+    tdb_db = talloc_zero(db, struct ccdb_tdb);
+    if (tdb_db == NULL) {
+        return ENOMEM;
+    }
+    talloc_set_destructor(tdb_db, ccdb_tdb_destructor);
+
+    ret = ccdb_tdb_read_mkey(tdb_db);
+    if (ret != EOK) {
+        talloc_free(tdb_db);
+        return ret;
+    }
+
+    tdb_db->tdb = tdb_open(KCM_TDB_PATH, 0, TDB_DEFAULT,
+                           O_RDWR|O_CREAT, 0600);
+    if (tdb_db->tdb == NULL) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, "Cannot open %s [%d]: %s\n",
+              KCM_TDB_PATH, ret, sss_strerror(ret));
+        talloc_free(tdb_db);
+        return ret != EOK ? ret : EIO;
+    }
+
+    db->db_handle = tdb_db;
+    return EOK;
+}
+
+struct ccdb_tdb_nextid_state {
+    unsigned int nextid;
+};
+
+static struct tevent_req *ccdb_tdb_nextid_send(TALLOC_CTX *mem_ctx,
+                                               struct tevent_context *ev,
+                                               struct kcm_ccdb *db,
+                                               struct cli_creds *client)
+{
+    struct tevent_req *req = NULL;
+    struct ccdb_tdb_nextid_state *state = NULL;
+    struct ccdb_tdb *tdb_db = talloc_get_type(db->db_handle, struct ccdb_tdb);
+    const char *key;
+    const char *name;
+    uint8_t *data;
+    size_t len;
+    uint32_t nextid = 0;
+    unsigned int i;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct ccdb_tdb_nextid_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    key = ccdb_tdb_uid_key(state, "nextid", client);
+    ret = ccdb_tdb_fetch(state, tdb_db, key, &data, &len);
+    if (ret == EOK && len == sizeof(uint32_t)) {
+        memcpy(&nextid, data, sizeof(uint32_t));
+    } else if (ret != EOK && ret != ENOENT) {
+        goto immediate;
+    }
+
+    /* Skip over names that are already taken, for example by ccaches
+     * created by root on behalf of the user */
+    for (i = 0; i < KCM_TDB_MAX_CC_NUM; i++) {
+        nextid %= KCM_TDB_MAX_CC_NUM;
+
+        name = talloc_asprintf(state, "%"SPRIuid":%u",
+                               cli_creds_get_uid(client), nextid);
+        ret = ccdb_tdb_fetch(state, tdb_db,
+                             ccdb_tdb_name_key(state, client, name),
+                             &data, &len);
+        if (ret == ENOENT) {
+            break;
+        } else if (ret != EOK) {
+            goto immediate;
+        }
+
+        nextid++;
+    }
+
+    if (i == KCM_TDB_MAX_CC_NUM) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "No free ccache number left\n");
+        ret = EBUSY;
+        goto immediate;
+    }
+
+    state->nextid = nextid;
+
+    nextid++;
+    ret = ccdb_tdb_store(tdb_db, key, (const uint8_t *) &nextid,
+                         sizeof(uint32_t));
+    if (ret != EOK) {
+        goto immediate;
+    }
+
+    ret = EOK;
+immediate:
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+    return req;
+}
+
+static errno_t ccdb_tdb_nextid_recv(struct tevent_req *req,
+                                    unsigned int *_nextid)
+{
+    struct ccdb_tdb_nextid_state *state = tevent_req_data(req,
+                                                struct ccdb_tdb_nextid_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+    *_nextid = state->nextid;
+    return EOK;
+}
+
+struct ccdb_tdb_list_state {
+    uuid_t *uuid_list;
+};
+
+static struct tevent_req *ccdb_tdb_list_send(TALLOC_CTX *mem_ctx,
+                                             struct tevent_context *ev,
+                                             struct kcm_ccdb *db,
+                                             struct cli_creds *client)
+{
+    struct tevent_req *req = NULL;
+    struct ccdb_tdb_list_state *state = NULL;
+    struct ccdb_tdb *tdb_db = talloc_get_type(db->db_handle, struct ccdb_tdb);
+    size_t num_uuids;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct ccdb_tdb_list_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    ret = ccdb_tdb_get_uuid_list(state, tdb_db, client,
+                                 &state->uuid_list, &num_uuids);
+    if (ret != EOK) {
+        goto immediate;
+    }
+
+    ret = EOK;
+immediate:
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+    return req;
+}
+
+static errno_t ccdb_tdb_list_recv(struct tevent_req *req,
+                                  TALLOC_CTX *mem_ctx,
+                                  uuid_t **_uuid_list)
+{
+    struct ccdb_tdb_list_state *state = tevent_req_data(req,
+                                                struct ccdb_tdb_list_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+    *_uuid_list = talloc_steal(mem_ctx, state->uuid_list);
+    return EOK;
+}
+
+static struct tevent_req *ccdb_tdb_set_default_send(TALLOC_CTX *mem_ctx,
+                                                    struct tevent_context *ev,
+                                                    struct kcm_ccdb *db,
+                                                    struct cli_creds *client,
+                                                    uuid_t uuid)
+{
+    struct tevent_req *req = NULL;
+    struct ccdb_tdb_dummy_state *state = NULL;
+    struct ccdb_tdb *tdb_db = talloc_get_type(db->db_handle, struct ccdb_tdb);
+    const char *key;
+    uint8_t *data;
+    size_t len;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct ccdb_tdb_dummy_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    key = ccdb_tdb_uid_key(state, "default", client);
+
+    /* Passing a null UUID or an UUID of a ccache that does not exist
+     * just resets the default */
+    ret = ENOENT;
+    if (uuid_is_null(uuid) == false) {
+        ret = ccdb_tdb_fetch(state, tdb_db,
+                             ccdb_tdb_cc_key(state, client, uuid),
+                             &data, &len);
+    }
+
+    if (ret == ENOENT) {
+        ret = ccdb_tdb_delete(tdb_db, key);
+    } else if (ret == EOK) {
+        ret = ccdb_tdb_store(tdb_db, key, uuid, UUID_BYTES);
+    }
+
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+    return req;
+}
+
+static errno_t ccdb_tdb_set_default_recv(struct tevent_req *req)
+{
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+    return EOK;
+}
+
+struct ccdb_tdb_get_default_state {
+    uuid_t dfl_uuid;
+};
+
+static struct tevent_req *ccdb_tdb_get_default_send(TALLOC_CTX *mem_ctx,
+                                                    struct tevent_context *ev,
+                                                    struct kcm_ccdb *db,
+                                                    struct cli_creds *client)
+{
+    struct tevent_req *req = NULL;
+    struct ccdb_tdb_get_default_state *state = NULL;
+    struct ccdb_tdb *tdb_db = talloc_get_type(db->db_handle, struct ccdb_tdb);
+    uint8_t *data;
+    size_t len;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct ccdb_tdb_get_default_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    ret = ccdb_tdb_fetch(state, tdb_db,
+                         ccdb_tdb_uid_key(state, "default", client),
+                         &data, &len);
+    if (ret == EOK && len == UUID_BYTES) {
+        uuid_copy(state->dfl_uuid, data);
+    } else if (ret == EOK || ret == ENOENT) {
+        DEBUG(SSSDBG_TRACE_FUNC,
+              "No ccache marked as default, returning null ccache\n");
+        uuid_clear(state->dfl_uuid);
+        ret = EOK;
+    }
+
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+    return req;
+}
+
+static errno_t ccdb_tdb_get_default_recv(struct tevent_req *req,
+                                         uuid_t dfl)
+{
+    struct ccdb_tdb_get_default_state *state = tevent_req_data(req,
+                                                struct ccdb_tdb_get_default_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    uuid_copy(dfl, state->dfl_uuid);
+    return EOK;
+}
+
+struct ccdb_tdb_getbyuuid_state {
+    struct kcm_ccache *cc;
+};
+
+static struct tevent_req *ccdb_tdb_getbyuuid_send(TALLOC_CTX *mem_ctx,
+                                                  struct tevent_context *ev,
+                                                  struct kcm_ccdb *db,
+                                                  struct cli_creds *client,
+                                                  uuid_t uuid)
+{
+    struct tevent_req *req = NULL;
+    struct ccdb_tdb_getbyuuid_state *state = NULL;
+    struct ccdb_tdb *tdb_db = talloc_get_type(db->db_handle, struct ccdb_tdb);
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct ccdb_tdb_getbyuuid_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    ret = ccdb_tdb_get_cc(state, tdb_db, client, uuid, true, &state->cc);
+    if (ret == ERR_KCM_CC_END) {
+        /* Not found is not an error, the caller checks for NULL */
+        state->cc = NULL;
+        ret = EOK;
+    }
+
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+    return req;
+}
+
+static errno_t ccdb_tdb_getbyuuid_recv(struct tevent_req *req,
+                                       TALLOC_CTX *mem_ctx,
+                                       struct kcm_ccache **_cc)
+{
+    struct ccdb_tdb_getbyuuid_state *state = tevent_req_data(req,
+                                                struct ccdb_tdb_getbyuuid_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+    *_cc = talloc_steal(mem_ctx, state->cc);
+    return EOK;
+}
+
+/* Returns ERR_KCM_CC_END if there is no ccache called name */
+static errno_t ccdb_tdb_uuid_by_name(struct ccdb_tdb *tdb_db,
+                                     struct cli_creds *client,
+                                     const char *name,
+                                     uuid_t _uuid)
+{
+    TALLOC_CTX *tmp_ctx;
+    uint8_t *data;
+    size_t len;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    ret = ccdb_tdb_fetch(tmp_ctx, tdb_db,
+                         ccdb_tdb_name_key(tmp_ctx, client, name),
+                         &data, &len);
+    if (ret == ENOENT) {
+        ret = ERR_KCM_CC_END;
+        goto done;
+    } else if (ret != EOK) {
+        goto done;
+    }
+
+    if (len != UUID_BYTES) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Malformed UUID of ccache %s\n", name);
+        ret = EINVAL;
+        goto done;
+    }
+
+    uuid_copy(_uuid, data);
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+struct ccdb_tdb_getbyname_state {
+    struct kcm_ccache *cc;
+};
+
+static struct tevent_req *ccdb_tdb_getbyname_send(TALLOC_CTX *mem_ctx,
+                                                  struct tevent_context *ev,
+                                                  struct kcm_ccdb *db,
+                                                  struct cli_creds *client,
+                                                  const char *name)
+{
+    struct tevent_req *req = NULL;
+    struct ccdb_tdb_getbyname_state *state = NULL;
+    struct ccdb_tdb *tdb_db = talloc_get_type(db->db_handle, struct ccdb_tdb);
+    uuid_t uuid;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct ccdb_tdb_getbyname_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    ret = ccdb_tdb_uuid_by_name(tdb_db, client, name, uuid);
+    if (ret == EOK) {
+        ret = ccdb_tdb_get_cc(state, tdb_db, client, uuid, true, &state->cc);
+    }
+
+    if (ret == ERR_KCM_CC_END) {
+        /* Not found is not an error, the caller checks for NULL */
+        state->cc = NULL;
+        ret = EOK;
+    }
+
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+    return req;
+}
+
+static errno_t ccdb_tdb_getbyname_recv(struct tevent_req *req,
+                                       TALLOC_CTX *mem_ctx,
+                                       struct kcm_ccache **_cc)
+{
+    struct ccdb_tdb_getbyname_state *state = tevent_req_data(req,
+                                                struct ccdb_tdb_getbyname_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+    *_cc = talloc_steal(mem_ctx, state->cc);
+    return EOK;
+}
+
+struct ccdb_tdb_name_by_uuid_state {
+    const char *name;
+};
+
+static struct tevent_req *ccdb_tdb_name_by_uuid_send(TALLOC_CTX *mem_ctx,
+                                                     struct tevent_context *ev,
+                                                     struct kcm_ccdb *db,
+                                                     struct cli_creds *client,
+                                                     uuid_t uuid)
+{
+    struct tevent_req *req = NULL;
+    struct ccdb_tdb_name_by_uuid_state *state = NULL;
+    struct ccdb_tdb *tdb_db = talloc_get_type(db->db_handle, struct ccdb_tdb);
+    struct kcm_ccache *cc;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct ccdb_tdb_name_by_uuid_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    ret = ccdb_tdb_get_cc(state, tdb_db, client, uuid, false, &cc);
+    if (ret != EOK) {
+        goto immediate;
+    }
+
+    state->name = talloc_steal(state, cc->name);
+    talloc_free(cc);
+
+    ret = EOK;
+immediate:
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+    return req;
+}
+
+static errno_t ccdb_tdb_name_by_uuid_recv(struct tevent_req *req,
+                                          TALLOC_CTX *mem_ctx,
+                                          const char **_name)
+{
+    struct ccdb_tdb_name_by_uuid_state *state = tevent_req_data(req,
+                                                struct ccdb_tdb_name_by_uuid_state);
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+    *_name = talloc_steal(mem_ctx, state->name);
+    return EOK;
+}
+
+struct ccdb_tdb_uuid_by_name_state {
+    uuid_t uuid;
+};
+
+static struct tevent_req *ccdb_tdb_uuid_by_name_send(TALLOC_CTX *mem_ctx,
+                                                     struct tevent_context *ev,
+                                                     struct kcm_ccdb *db,
+                                                     struct cli_creds *client,
+                                                     const char *name)
+{
+    struct tevent_req *req = NULL;
+    struct ccdb_tdb_uuid_by_name_state *state = NULL;
+    struct ccdb_tdb *tdb_db = talloc_get_type(db->db_handle, struct ccdb_tdb);
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct ccdb_tdb_uuid_by_name_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    ret = ccdb_tdb_uuid_by_name(tdb_db, client, name, state->uuid);
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+    return req;
+}
+
+static errno_t ccdb_tdb_uuid_by_name_recv(struct tevent_req *req,
+                                          TALLOC_CTX *mem_ctx,
+                                          uuid_t _uuid)
+{
+    struct ccdb_tdb_uuid_by_name_state *state = tevent_req_data(req,
+                                                struct ccdb_tdb_uuid_by_name_state);
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+    uuid_copy(_uuid, state->uuid);
+    return EOK;
+}
+
+/* Only reads the ccache headers, and only if the number of credentials
+ * is limited at all */
+static errno_t ccdb_tdb_count_creds(struct ccdb_tdb *tdb_db,
+                                    const struct kcm_ccdb_limits *limits,
+                                    struct cli_creds *client,
+                                    uuid_t *uuids,
+                                    size_t num_uuids,
+                                    size_t *_num_creds)
+{
+    struct kcm_ccache *cc;
+    struct kcm_cred *crd;
+    size_t num_creds = 0;
+    size_t i;
+    errno_t ret;
+
+    if (limits->max_uid_creds == 0) {
+        *_num_creds = 0;
+        return EOK;
+    }
+
+    for (i = 0; i < num_uuids; i++) {
+        ret = ccdb_tdb_get_cc(tdb_db, tdb_db, client, uuids[i], false, &cc);
+        if (ret == ERR_KCM_CC_END) {
+            continue;
+        } else if (ret != EOK) {
+            return ret;
+        }
+
+        DLIST_FOR_EACH(crd, cc->creds) {
+            num_creds++;
+        }
+        talloc_free(cc);
+    }
+
+    *_num_creds = num_creds;
+    return EOK;
+}
+
+static errno_t ccdb_tdb_create(struct ccdb_tdb *tdb_db,
+                               const struct kcm_ccdb_limits *limits,
+                               struct cli_creds *client,
+                               struct kcm_ccache *cc)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct kcm_cred *crd;
+    uuid_t *uuids;
+    uuid_t *new_uuids;
+    size_t num_uuids;
+    size_t num_creds;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    ret = ccdb_tdb_get_uuid_list(tmp_ctx, tdb_db, client, &uuids, &num_uuids);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = ccdb_tdb_count_creds(tdb_db, limits, client, uuids, num_uuids,
+                               &num_creds);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    DLIST_FOR_EACH(crd, cc->creds) {
+        ret = kcm_ccdb_check_payload(limits, crd->cred_blob);
+        if (ret != EOK) {
+            goto done;
+        }
+        num_creds++;
+    }
+
+    ret = kcm_ccdb_check_quota(limits, num_uuids + 1, num_creds);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    /* The newest ccache goes first, like with the memory back end */
+    new_uuids = talloc_zero_array(tmp_ctx, uuid_t, num_uuids + 1);
+    if (new_uuids == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+    uuid_copy(new_uuids[0], cc->uuid);
+    memcpy(new_uuids + 1, uuids, num_uuids * UUID_BYTES);
+
+    DLIST_FOR_EACH(crd, cc->creds) {
+        ret = ccdb_tdb_put_cred(tdb_db, client, cc, crd);
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
+    ret = ccdb_tdb_put_cc(tdb_db, client, cc);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = ccdb_tdb_store(tdb_db, ccdb_tdb_name_key(tmp_ctx, client, cc->name),
+                         cc->uuid, UUID_BYTES);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = ccdb_tdb_put_uuid_list(tdb_db, client, new_uuids, num_uuids + 1);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = EOK;
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static struct tevent_req *ccdb_tdb_create_send(TALLOC_CTX *mem_ctx,
+                                               struct tevent_context *ev,
+                                               struct kcm_ccdb *db,
+                                               struct cli_creds *client,
+                                               struct kcm_ccache *cc)
+{
+    struct tevent_req *req = NULL;
+    struct ccdb_tdb_dummy_state *state = NULL;
+    struct ccdb_tdb *tdb_db = talloc_get_type(db->db_handle, struct ccdb_tdb);
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct ccdb_tdb_dummy_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    ret = ccdb_tdb_transaction_start(tdb_db);
+    if (ret != EOK) {
+        goto immediate;
+    }
+
+    ret = ccdb_tdb_create(tdb_db, &db->limits, client, cc);
+    if (ret != EOK) {
+        ccdb_tdb_transaction_cancel(tdb_db);
+        goto immediate;
+    }
+
+    ret = ccdb_tdb_transaction_commit(tdb_db);
+immediate:
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+    return req;
+}
+
+static errno_t ccdb_tdb_create_recv(struct tevent_req *req)
+{
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+    return EOK;
+}
+
+static struct tevent_req *ccdb_tdb_mod_send(TALLOC_CTX *mem_ctx,
+                                            struct tevent_context *ev,
+                                            struct kcm_ccdb *db,
+                                            struct cli_creds *client,
+                                            uuid_t uuid,
+                                            struct kcm_mod_ctx *mod_cc)
+{
+    struct tevent_req *req = NULL;
+    struct ccdb_tdb_dummy_state *state = NULL;
+    struct ccdb_tdb *tdb_db = talloc_get_type(db->db_handle, struct ccdb_tdb);
+    struct kcm_ccache *cc;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct ccdb_tdb_dummy_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    /* Only the header changes, the credentials are left alone */
+    ret = ccdb_tdb_get_cc(state, tdb_db, client, uuid, false, &cc);
+    if (ret != EOK) {
+        goto immediate;
+    }
+
+    kcm_mod_cc(cc, mod_cc);
+
+    ret = ccdb_tdb_put_cc(tdb_db, client, cc);
+immediate:
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+    return req;
+}
+
+static errno_t ccdb_tdb_mod_recv(struct tevent_req *req)
+{
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+    return EOK;
+}
+
+static errno_t ccdb_tdb_store_cred(struct ccdb_tdb *tdb_db,
+                                   const struct kcm_ccdb_limits *limits,
+                                   struct cli_creds *client,
+                                   uuid_t uuid,
+                                   struct sss_iobuf *cred_blob)
+{
+    struct kcm_ccache *cc;
+    struct sss_iobuf *blob_copy;
+    uuid_t *uuids;
+    size_t num_uuids;
+    size_t num_creds;
+    errno_t ret;
+
+    ret = kcm_ccdb_check_payload(limits, cred_blob);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    ret = ccdb_tdb_get_cc(tdb_db, tdb_db, client, uuid, false, &cc);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    ret = ccdb_tdb_get_uuid_list(cc, tdb_db, client, &uuids, &num_uuids);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = ccdb_tdb_count_creds(tdb_db, limits, client, uuids, num_uuids,
+                               &num_creds);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = kcm_ccdb_check_quota(limits, num_uuids, num_creds + 1);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    /* The ccache is freed once written, keep the caller's blob intact */
+    blob_copy = sss_iobuf_init_readonly(cc, sss_iobuf_get_data(cred_blob),
+                                        sss_iobuf_get_size(cred_blob));
+    if (blob_copy == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = kcm_cc_store_cred_blob(cc, blob_copy);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Cannot store credentials to ccache [%d]: %s\n",
+              ret, sss_strerror(ret));
+        goto done;
+    }
+
+    /* The new credential is at the head of the list */
+    ret = ccdb_tdb_put_cred(tdb_db, client, cc, kcm_cc_get_cred(cc));
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = ccdb_tdb_put_cc(tdb_db, client, cc);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = EOK;
+done:
+    talloc_free(cc);
+    return ret;
+}
+
+static struct tevent_req *ccdb_tdb_store_cred_send(TALLOC_CTX *mem_ctx,
+                                                   struct tevent_context *ev,
+                                                   struct kcm_ccdb *db,
+                                                   struct cli_creds *client,
+                                                   uuid_t uuid,
+                                                   struct sss_iobuf *cred_blob)
+{
+    struct tevent_req *req = NULL;
+    struct ccdb_tdb_dummy_state *state = NULL;
+    struct ccdb_tdb *tdb_db = talloc_get_type(db->db_handle, struct ccdb_tdb);
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct ccdb_tdb_dummy_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    ret = ccdb_tdb_transaction_start(tdb_db);
+    if (ret != EOK) {
+        goto immediate;
+    }
+
+    ret = ccdb_tdb_store_cred(tdb_db, &db->limits, client, uuid, cred_blob);
+    if (ret != EOK) {
+        ccdb_tdb_transaction_cancel(tdb_db);
+        goto immediate;
+    }
+
+    ret = ccdb_tdb_transaction_commit(tdb_db);
+immediate:
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+    return req;
+}
+
+static errno_t ccdb_tdb_store_cred_recv(struct tevent_req *req)
+{
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+    return EOK;
+}
+
+static errno_t ccdb_tdb_delete_cc(struct ccdb_tdb *tdb_db,
+                                  struct cli_creds *client,
+                                  uuid_t uuid)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct kcm_ccache *cc;
+    struct kcm_cred *crd;
+    uuid_t *uuids;
+    size_t num_uuids;
+    uint8_t *data;
+    size_t len;
+    size_t i;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    ret = ccdb_tdb_get_cc(tmp_ctx, tdb_db, client, uuid, false, &cc);
+    if (ret == ERR_KCM_CC_END) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "BUG: Attempting to free unknown ccache\n");
+        goto done;
+    } else if (ret != EOK) {
+        goto done;
+    }
+
+    DLIST_FOR_EACH(crd, cc->creds) {
+        ret = ccdb_tdb_delete(tdb_db, ccdb_tdb_cred_key(tmp_ctx, client,
+                                                        uuid, crd->uuid));
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
+    ret = ccdb_tdb_delete(tdb_db, ccdb_tdb_cc_key(tmp_ctx, client, uuid));
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = ccdb_tdb_delete(tdb_db, ccdb_tdb_name_key(tmp_ctx, client,
+                                                    cc->name));
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = ccdb_tdb_get_uuid_list(tmp_ctx, tdb_db, client, &uuids, &num_uuids);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    for (i = 0; i < num_uuids; i++) {
+        if (uuid_compare(uuids[i], uuid) == 0) {
+            memmove(uuids + i, uuids + i + 1,
+                    (num_uuids - i - 1) * UUID_BYTES);
+            num_uuids--;
+            break;
+        }
+    }
+
+    ret = ccdb_tdb_put_uuid_list(tdb_db, client, uuids, num_uuids);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    /* A deleted ccache can't remain the default one */
+    ret = ccdb_tdb_fetch(tmp_ctx, tdb_db,
+                         ccdb_tdb_uid_key(tmp_ctx, "default", client),
+                         &data, &len);
+    if (ret == EOK && len == UUID_BYTES && uuid_compare(data, uuid) == 0) {
+        ret = ccdb_tdb_delete(tdb_db,
+                              ccdb_tdb_uid_key(tmp_ctx, "default", client));
+    } else if (ret == ENOENT || ret == EOK) {
+        ret = EOK;
+    }
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static struct tevent_req *ccdb_tdb_delete_send(TALLOC_CTX *mem_ctx,
+                                               struct tevent_context *ev,
+                                               struct kcm_ccdb *db,
+                                               struct cli_creds *client,
+                                               uuid_t uuid)
+{
+    struct tevent_req *req = NULL;
+    struct ccdb_tdb_dummy_state *state = NULL;
+    struct ccdb_tdb *tdb_db = talloc_get_type(db->db_handle, struct ccdb_tdb);
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct ccdb_tdb_dummy_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    ret = ccdb_tdb_transaction_start(tdb_db);
+    if (ret != EOK) {
+        goto immediate;
+    }
+
+    ret = ccdb_tdb_delete_cc(tdb_db, client, uuid);
+    if (ret != EOK) {
+        ccdb_tdb_transaction_cancel(tdb_db);
+        goto immediate;
+    }
+
+    ret = ccdb_tdb_transaction_commit(tdb_db);
+immediate:
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+    return req;
+}
+
+static errno_t ccdb_tdb_delete_recv(struct tevent_req *req)
+{
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+    return EOK;
+}
+
+const struct kcm_ccdb_ops ccdb_tdb_ops = {
+    .init = ccdb_tdb_init,
+
+    .nextid_send = ccdb_tdb_nextid_send,
+    .nextid_recv = ccdb_tdb_nextid_recv,
+
+    .set_default_send = ccdb_tdb_set_default_send,
+    .set_default_recv = ccdb_tdb_set_default_recv,
+
+    .get_default_send = ccdb_tdb_get_default_send,
+    .get_default_recv = ccdb_tdb_get_default_recv,
+
+    .list_send = ccdb_tdb_list_send,
+    .list_recv = ccdb_tdb_list_recv,
+
+    .getbyname_send = ccdb_tdb_getbyname_send,
+    .getbyname_recv = ccdb_tdb_getbyname_recv,
+
+    .getbyuuid_send = ccdb_tdb_getbyuuid_send,
+    .getbyuuid_recv = ccdb_tdb_getbyuuid_recv,
+
+    .name_by_uuid_send = ccdb_tdb_name_by_uuid_send,
+    .name_by_uuid_recv = ccdb_tdb_name_by_uuid_recv,
+
+    .uuid_by_name_send = ccdb_tdb_uuid_by_name_send,
+    .uuid_by_name_recv = ccdb_tdb_uuid_by_name_recv,
+
+    .create_send = ccdb_tdb_create_send,
+    .create_recv = ccdb_tdb_create_recv,
+
+    .mod_send = ccdb_tdb_mod_send,
+    .mod_recv = ccdb_tdb_mod_recv,
+
+    .store_cred_send = ccdb_tdb_store_cred_send,
+    .store_cred_recv = ccdb_tdb_store_cred_recv,
+
+    .delete_send = ccdb_tdb_delete_send,
+    .delete_recv = ccdb_tdb_delete_recv,
+};
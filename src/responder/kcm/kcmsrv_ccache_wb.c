@@ -0,0 +1,2031 @@
+/*
+   SSSD
+
+   KCM Server - in-memory write-back cache in front of a ccache database
+
+   Copyright (C) Red Hat, 2017
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <talloc.h>
+#include <stdio.h>
+
+#include "util/util.h"
+#include "util/util_creds.h"
+#include "responder/kcm/kcmsrv_ccache_pvt.h"
+#include "responder/kcm/kcmsrv_ccache_be.h"
+
+#define CCDB_WB_HASH_SIZE       32
+/* How long to wait before retrying a failed write-back */
+#define CCDB_WB_RETRY_DELAY     5
+/* How many times to ask the back end for a name that is not taken */
+#define CCDB_WB_NEXTID_TRIES    16
+/* How long the final write-back on shutdown may take */
+#define CCDB_WB_SHUTDOWN_TIMEOUT 10
+
+/*
+ * The write-back cache keeps all ccaches of a UID in memory once any of
+ * them was accessed. Reads are served from memory. Writes only modify the
+ * in-memory copy, mark the ccache as dirty and schedule a write-back, so
+ * that a burst of modifications of a ccache (e.g. storing several service
+ * tickets) results in writing the ccache to the back end only once.
+ *
+ * The write-back of a dirty ccache deletes the back end copy and creates
+ * it anew with the current contents, this is what the secrets back end did
+ * for every single modification anyway. Write-backs of a UID are
+ * serialized, so the back end always sees the modifications in order.
+ *
+ * The cached data of a UID is dropped after it was not used for the idle
+ * timeout, but only once everything was written back.
+ *
+ * Before the responder exits, kcm_ccdb_wb_shutdown_send() writes back all
+ * dirty ccaches at once. tevent does not allow running a nested loop, so
+ * this can't be done from a destructor; the responder waits for the
+ * request instead.
+ */
+
+struct ccdb_wb;
+
+struct ccdb_wb_cc {
+    struct kcm_ccache *cc;
+    /* Modified since it was last written back */
+    bool dirty;
+    /* Exists in the back end and must be removed before re-creating */
+    bool stored;
+
+    struct ccdb_wb_cc *next;
+    struct ccdb_wb_cc *prev;
+};
+
+struct ccdb_wb_uuid {
+    uuid_t uuid;
+
+    struct ccdb_wb_uuid *next;
+    struct ccdb_wb_uuid *prev;
+};
+
+struct ccdb_wb_client {
+    struct ccdb_wb *wb;
+    uid_t uid;
+    /* Used to talk to the back end on behalf of the UID */
+    struct cli_creds client;
+
+    struct ccdb_wb_cc *ccaches;
+    /* ccaches deleted from the cache but still present in the back end */
+    struct ccdb_wb_uuid *deleted;
+
+    uuid_t dfl;
+    bool dfl_dirty;
+
+    struct tevent_timer *flush_te;
+    bool flushing;
+    bool flush_again;
+    /* The final write-back on shutdown failed, it is not retried */
+    bool flush_failed;
+
+    time_t last_used;
+    struct tevent_timer *idle_te;
+};
+
+struct ccdb_wb {
+    struct tevent_context *ev;
+    /* The database the cache writes to */
+    struct kcm_ccdb *be;
+
+    /* UID:ccdb_wb_client */
+    hash_table_t *clients;
+
+    uint32_t writeback_delay;
+    uint32_t idle_timeout;
+
+    /* Set once the final write-back started, no timers are used anymore */
+    bool shutting_down;
+    struct tevent_req *shutdown_req;
+};
+
+static void ccdb_wb_schedule_flush(struct ccdb_wb_client *wc,
+                                   uint32_t delay);
+static void ccdb_wb_shutdown_next(struct tevent_req *req);
+
+static int ccdb_wb_cc_destructor(struct ccdb_wb_cc *wcc)
+{
+    struct kcm_cred *crd;
+
+    if (wcc == NULL || wcc->cc == NULL) {
+        return 0;
+    }
+
+    DLIST_FOR_EACH(crd, wcc->cc->creds) {
+        safezero(sss_iobuf_get_data(crd->cred_blob),
+                 sss_iobuf_get_size(crd->cred_blob));
+    }
+
+    return 0;
+}
+
+static int ccdb_wb_client_destructor(struct ccdb_wb_client *wc)
+{
+    hash_key_t key;
+    int hret;
+
+    key.type = HASH_KEY_ULONG;
+    key.ul = wc->uid;
+
+    hret = hash_delete(wc->wb->clients, &key);
+    if (hret != HASH_SUCCESS && hret != HASH_ERROR_KEY_NOT_FOUND) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Cannot remove cached ccaches of %"SPRIuid"\n", wc->uid);
+    }
+
+    return 0;
+}
+
+static struct ccdb_wb_client *ccdb_wb_client_lookup(struct ccdb_wb *wb,
+                                                    uid_t uid)
+{
+    hash_key_t key;
+    hash_value_t value;
+    int hret;
+
+    key.type = HASH_KEY_ULONG;
+    key.ul = uid;
+
+    hret = hash_lookup(wb->clients, &key, &value);
+    if (hret != HASH_SUCCESS) {
+        return NULL;
+    }
+
+    return talloc_get_type(value.ptr, struct ccdb_wb_client);
+}
+
+static bool ccdb_wb_client_is_clean(struct ccdb_wb_client *wc)
+{
+    struct ccdb_wb_cc *wcc;
+
+    if (wc->flushing || wc->flush_te != NULL
+            || wc->dfl_dirty || wc->deleted != NULL) {
+        return false;
+    }
+
+    DLIST_FOR_EACH(wcc, wc->ccaches) {
+        if (wcc->dirty) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void ccdb_wb_idle_handler(struct tevent_context *ev,
+                                 struct tevent_timer *te,
+                                 struct timeval current_time,
+                                 void *pvt)
+{
+    struct ccdb_wb_client *wc = talloc_get_type(pvt, struct ccdb_wb_client);
+    struct timeval tv;
+    time_t idle;
+    time_t left;
+
+    wc->idle_te = NULL;
+
+    idle = time(NULL) - wc->last_used;
+    if (idle >= wc->wb->idle_timeout && ccdb_wb_client_is_clean(wc)) {
+        DEBUG(SSSDBG_TRACE_FUNC,
+              "Dropping cached ccaches of %"SPRIuid"\n", wc->uid);
+        talloc_free(wc);
+        return;
+    }
+
+    /* Either still in use or not written back yet, check again later */
+    left = wc->wb->idle_timeout - idle;
+    if (left <= 0) {
+        left = CCDB_WB_RETRY_DELAY;
+    }
+
+    tv = tevent_timeval_current_ofs(left, 0);
+    wc->idle_te = tevent_add_timer(ev, wc, tv, ccdb_wb_idle_handler, wc);
+    if (wc->idle_te == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Cannot schedule idle timer\n");
+    }
+}
+
+static struct ccdb_wb_cc *ccdb_wb_get_by_uuid(struct ccdb_wb_client *wc,
+                                              uuid_t uuid)
+{
+    struct ccdb_wb_cc *wcc;
+
+    DLIST_FOR_EACH(wcc, wc->ccaches) {
+        if (uuid_compare(wcc->cc->uuid, uuid) == 0) {
+            return wcc;
+        }
+    }
+
+    return NULL;
+}
+
+static struct ccdb_wb_cc *ccdb_wb_get_by_name(struct ccdb_wb_client *wc,
+                                              const char *name)
+{
+    struct ccdb_wb_cc *wcc;
+
+    DLIST_FOR_EACH(wcc, wc->ccaches) {
+        if (strcmp(wcc->cc->name, name) == 0) {
+            return wcc;
+        }
+    }
+
+    return NULL;
+}
+
+/* Callers own the ccaches they receive and the cached ccache must not
+ * change underneath the copy that is being written back, so ccaches are
+ * always handed out as deep copies
+ */
+static struct kcm_ccache *ccdb_wb_cc_dup(TALLOC_CTX *mem_ctx,
+                                         struct kcm_ccache *in)
+{
+    struct sss_iobuf *payload;
+    struct kcm_ccache *out;
+    struct kcm_cred *crd;
+    struct kcm_cred *crd_copy;
+    struct sss_iobuf *blob;
+    uuid_t *cred_uuids;
+    size_t num_creds;
+    errno_t ret;
+
+    ret = kcm_ccache_to_binary(NULL, in, &payload);
+    if (ret != EOK) {
+        return NULL;
+    }
+
+    ret = kcm_binary_to_ccache(mem_ctx,
+                               sss_iobuf_get_data(payload),
+                               sss_iobuf_get_len(payload),
+                               &out, &cred_uuids, &num_creds);
+    talloc_free(payload);
+    if (ret != EOK) {
+        return NULL;
+    }
+    talloc_free(cred_uuids);
+
+    DLIST_FOR_EACH(crd, in->creds) {
+        blob = sss_iobuf_init_readonly(NULL,
+                                       sss_iobuf_get_data(crd->cred_blob),
+                                       sss_iobuf_get_size(crd->cred_blob));
+        if (blob == NULL) {
+            talloc_free(out);
+            return NULL;
+        }
+
+        crd_copy = kcm_cred_new(out, crd->uuid, blob);
+        if (crd_copy == NULL) {
+            talloc_free(blob);
+            talloc_free(out);
+            return NULL;
+        }
+
+        /* Keep the order of the credentials */
+        DLIST_ADD_END(out->creds, crd_copy, struct kcm_cred *);
+    }
+
+    return out;
+}
+
+/*
+ * Ccaches loaded from the back end keep the order of the back end listing,
+ * new ccaches are added to the front like the memory back end does
+ */
+static errno_t ccdb_wb_add_cc(struct ccdb_wb_client *wc,
+                              struct kcm_ccache *cc,
+                              bool loaded)
+{
+    struct ccdb_wb_cc *wcc;
+
+    wcc = talloc_zero(wc, struct ccdb_wb_cc);
+    if (wcc == NULL) {
+        return ENOMEM;
+    }
+    wcc->cc = talloc_steal(wcc, cc);
+    wcc->stored = loaded;
+    wcc->dirty = !loaded;
+    talloc_set_destructor(wcc, ccdb_wb_cc_destructor);
+
+    if (loaded) {
+        DLIST_ADD_END(wc->ccaches, wcc, struct ccdb_wb_cc *);
+    } else {
+        DLIST_ADD(wc->ccaches, wcc);
+    }
+    return EOK;
+}
+
+static errno_t ccdb_wb_add_deleted(struct ccdb_wb_client *wc,
+                                   uuid_t uuid)
+{
+    struct ccdb_wb_uuid *wu;
+
+    wu = talloc_zero(wc, struct ccdb_wb_uuid);
+    if (wu == NULL) {
+        return ENOMEM;
+    }
+    uuid_copy(wu->uuid, uuid);
+
+    DLIST_ADD_END(wc->deleted, wu, struct ccdb_wb_uuid *);
+    return EOK;
+}
+
+/*
+ * Load all ccaches of a UID from the back end unless they are cached
+ * already
+ */
+struct ccdb_wb_load_state {
+    struct tevent_context *ev;
+    struct ccdb_wb *wb;
+    struct cli_creds *client;
+
+    uuid_t *uuid_list;
+    size_t uuid_idx;
+
+    struct ccdb_wb_client *wc;
+};
+
+static void ccdb_wb_load_list_done(struct tevent_req *subreq);
+static errno_t ccdb_wb_load_next(struct tevent_req *req);
+static void ccdb_wb_load_cc_done(struct tevent_req *subreq);
+static void ccdb_wb_load_default_done(struct tevent_req *subreq);
+
+static struct tevent_req *ccdb_wb_load_send(TALLOC_CTX *mem_ctx,
+                                            struct tevent_context *ev,
+                                            struct ccdb_wb *wb,
+                                            struct cli_creds *client)
+{
+    struct tevent_req *req = NULL;
+    struct tevent_req *subreq = NULL;
+    struct ccdb_wb_load_state *state = NULL;
+    uid_t uid = cli_creds_get_uid(client);
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct ccdb_wb_load_state);
+    if (req == NULL) {
+        return NULL;
+    }
+    state->ev = ev;
+    state->wb = wb;
+    state->client = client;
+
+    state->wc = ccdb_wb_client_lookup(wb, uid);
+    if (state->wc != NULL) {
+        ret = EOK;
+        goto immediate;
+    }
+
+    DEBUG(SSSDBG_TRACE_INTERNAL,
+          "Loading ccaches of %"SPRIuid" from the back end\n", uid);
+
+    state->wc = talloc_zero(state, struct ccdb_wb_client);
+    if (state->wc == NULL) {
+        ret = ENOMEM;
+        goto immediate;
+    }
+    state->wc->wb = wb;
+    state->wc->uid = uid;
+    /* The SELinux context belongs to the client connection, which
+     * might be long gone when the ccaches are written back
+     */
+    state->wc->client = *client;
+    state->wc->client.selinux_ctx = NULL;
+
+    subreq = wb->be->ops->list_send(state, ev, wb->be, client);
+    if (subreq == NULL) {
+        ret = ENOMEM;
+        goto immediate;
+    }
+    tevent_req_set_callback(subreq, ccdb_wb_load_list_done, req);
+    return req;
+
+immediate:
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+    return req;
+}
+
+static void ccdb_wb_load_list_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct ccdb_wb_load_state *state = tevent_req_data(req,
+                                                struct ccdb_wb_load_state);
+    errno_t ret;
+
+    ret = state->wb->be->ops->list_recv(subreq, state, &state->uuid_list);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Cannot list ccaches [%d]: %s\n", ret, sss_strerror(ret));
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    ret = ccdb_wb_load_next(req);
+    if (ret != EAGAIN) {
+        tevent_req_error(req, ret);
+        return;
+    }
+}
+
+static errno_t ccdb_wb_load_next(struct tevent_req *req)
+{
+    struct ccdb_wb_load_state *state = tevent_req_data(req,
+                                                struct ccdb_wb_load_state);
+    struct tevent_req *subreq;
+
+    if (state->uuid_list != NULL
+            && uuid_is_null(state->uuid_list[state->uuid_idx]) == false) {
+        subreq = state->wb->be->ops->getbyuuid_send(state, state->ev,
+                                        state->wb->be, state->client,
+                                        state->uuid_list[state->uuid_idx]);
+        if (subreq == NULL) {
+            return ENOMEM;
+        }
+        tevent_req_set_callback(subreq, ccdb_wb_load_cc_done, req);
+        return EAGAIN;
+    }
+
+    subreq = state->wb->be->ops->get_default_send(state, state->ev,
+                                                  state->wb->be,
+                                                  state->client);
+    if (subreq == NULL) {
+        return ENOMEM;
+    }
+    tevent_req_set_callback(subreq, ccdb_wb_load_default_done, req);
+    return EAGAIN;
+}
+
+static void ccdb_wb_load_cc_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct ccdb_wb_load_state *state = tevent_req_data(req,
+                                                struct ccdb_wb_load_state);
+    struct kcm_ccache *cc;
+    errno_t ret;
+
+    ret = state->wb->be->ops->getbyuuid_recv(subreq, state, &cc);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Cannot load ccache [%d]: %s\n", ret, sss_strerror(ret));
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    if (cc != NULL) {
+        ret = ccdb_wb_add_cc(state->wc, cc, true);
+        if (ret != EOK) {
+            tevent_req_error(req, ret);
+            return;
+        }
+    }
+
+    state->uuid_idx++;
+    ret = ccdb_wb_load_next(req);
+    if (ret != EAGAIN) {
+        tevent_req_error(req, ret);
+        return;
+    }
+}
+
+static void ccdb_wb_load_default_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct ccdb_wb_load_state *state = tevent_req_data(req,
+                                                struct ccdb_wb_load_state);
+    struct ccdb_wb_client *cached;
+    struct timeval tv;
+    hash_key_t key;
+    hash_value_t value;
+    errno_t ret;
+    int hret;
+
+    ret = state->wb->be->ops->get_default_recv(subreq, state->wc->dfl);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Cannot load the default ccache [%d]: %s\n",
+              ret, sss_strerror(ret));
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    /* Read-only operations run concurrently, so another request might
+     * have loaded the ccaches in the meantime. Nothing could have modified
+     * them, so just use the cached data.
+     */
+    cached = ccdb_wb_client_lookup(state->wb, state->wc->uid);
+    if (cached != NULL) {
+        talloc_zfree(state->wc);
+        state->wc = cached;
+        tevent_req_done(req);
+        return;
+    }
+
+    key.type = HASH_KEY_ULONG;
+    key.ul = state->wc->uid;
+    value.type = HASH_VALUE_PTR;
+    value.ptr = state->wc;
+
+    hret = hash_enter(state->wb->clients, &key, &value);
+    if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "hash_enter failed.\n");
+        tevent_req_error(req, EIO);
+        return;
+    }
+    talloc_steal(state->wb, state->wc);
+    talloc_set_destructor(state->wc, ccdb_wb_client_destructor);
+
+    state->wc->last_used = time(NULL);
+    tv = tevent_timeval_current_ofs(state->wb->idle_timeout, 0);
+    state->wc->idle_te = tevent_add_timer(state->ev, state->wc, tv,
+                                          ccdb_wb_idle_handler, state->wc);
+    if (state->wc->idle_te == NULL) {
+        /* Not fatal, the ccaches just stay cached */
+        DEBUG(SSSDBG_CRIT_FAILURE, "Cannot schedule idle timer\n");
+    }
+
+    tevent_req_done(req);
+}
+
+static errno_t ccdb_wb_load_recv(struct tevent_req *req,
+                                 struct ccdb_wb_client **_wc)
+{
+    struct ccdb_wb_load_state *state = tevent_req_data(req,
+                                                struct ccdb_wb_load_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+    *_wc = state->wc;
+    return EOK;
+}
+
+/*
+ * Write back all the modifications of a UID done since the last
+ * write-back. The list of steps is taken at the start, so modifications
+ * done while the write-back is running are handled by the next one.
+ */
+enum ccdb_wb_step_type {
+    CCDB_WB_STEP_DELETE,
+    CCDB_WB_STEP_CREATE,
+    CCDB_WB_STEP_SET_DEFAULT,
+};
+
+struct ccdb_wb_step {
+    enum ccdb_wb_step_type type;
+    uuid_t uuid;
+    struct kcm_ccache *cc;
+};
+
+struct ccdb_wb_flush_state {
+    struct tevent_context *ev;
+    struct ccdb_wb_client *wc;
+
+    struct ccdb_wb_step *steps;
+    size_t num_steps;
+    size_t step_idx;
+};
+
+static errno_t ccdb_wb_flush_step(struct tevent_req *req);
+static void ccdb_wb_flush_step_done(struct tevent_req *subreq);
+
+static struct tevent_req *ccdb_wb_flush_send(TALLOC_CTX *mem_ctx,
+                                             struct tevent_context *ev,
+                                             struct ccdb_wb_client *wc)
+{
+    struct tevent_req *req = NULL;
+    struct ccdb_wb_flush_state *state = NULL;
+    struct ccdb_wb_uuid *wu;
+    struct ccdb_wb_uuid *wu_next;
+    struct ccdb_wb_cc *wcc;
+    bool set_default;
+    size_t max_steps;
+    size_t n;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct ccdb_wb_flush_state);
+    if (req == NULL) {
+        return NULL;
+    }
+    state->ev = ev;
+    state->wc = wc;
+
+    /* Each dirty ccache takes two steps, plus setting the default */
+    max_steps = 1;
+    DLIST_FOR_EACH(wu, wc->deleted) {
+        max_steps++;
+    }
+    DLIST_FOR_EACH(wcc, wc->ccaches) {
+        max_steps += 2;
+    }
+
+    state->steps = talloc_zero_array(state, struct ccdb_wb_step, max_steps);
+    if (state->steps == NULL) {
+        ret = ENOMEM;
+        goto immediate;
+    }
+
+    /* The deleted ccaches are removed first because a ccache might have
+     * been deleted and then re-created with the same name
+     */
+    n = 0;
+    DLIST_FOR_EACH(wu, wc->deleted) {
+        state->steps[n].type = CCDB_WB_STEP_DELETE;
+        uuid_copy(state->steps[n].uuid, wu->uuid);
+        n++;
+    }
+
+    set_default = wc->dfl_dirty;
+    DLIST_FOR_EACH(wcc, wc->ccaches) {
+        if (wcc->dirty == false) {
+            continue;
+        }
+
+        if (wcc->stored) {
+            state->steps[n].type = CCDB_WB_STEP_DELETE;
+            uuid_copy(state->steps[n].uuid, wcc->cc->uuid);
+            n++;
+        }
+
+        state->steps[n].type = CCDB_WB_STEP_CREATE;
+        uuid_copy(state->steps[n].uuid, wcc->cc->uuid);
+        state->steps[n].cc = ccdb_wb_cc_dup(state->steps, wcc->cc);
+        if (state->steps[n].cc == NULL) {
+            ret = ENOMEM;
+            goto immediate;
+        }
+        n++;
+
+        /* Re-creating a ccache might reset the default in the back end */
+        if (uuid_compare(wcc->cc->uuid, wc->dfl) == 0) {
+            set_default = true;
+        }
+    }
+
+    if (set_default) {
+        state->steps[n].type = CCDB_WB_STEP_SET_DEFAULT;
+        uuid_copy(state->steps[n].uuid, wc->dfl);
+        n++;
+    }
+
+    /* Only now that nothing can fail the cache is marked as clean */
+    DLIST_FOR_EACH_SAFE(wu, wu_next, wc->deleted) {
+        DLIST_REMOVE(wc->deleted, wu);
+        talloc_free(wu);
+    }
+
+    DLIST_FOR_EACH(wcc, wc->ccaches) {
+        if (wcc->dirty) {
+            wcc->dirty = false;
+            wcc->stored = true;
+        }
+    }
+    wc->dfl_dirty = false;
+
+    state->num_steps = n;
+
+    DEBUG(SSSDBG_TRACE_INTERNAL,
+          "Writing back %zu changes of %"SPRIuid"\n", n, wc->uid);
+
+    ret = ccdb_wb_flush_step(req);
+    if (ret != EAGAIN) {
+        goto immediate;
+    }
+
+    return req;
+
+immediate:
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+    return req;
+}
+
+static errno_t ccdb_wb_flush_step(struct tevent_req *req)
+{
+    struct ccdb_wb_flush_state *state = tevent_req_data(req,
+                                                struct ccdb_wb_flush_state);
+    struct ccdb_wb_step *step;
+    struct kcm_ccdb *be = state->wc->wb->be;
+    struct tevent_req *subreq;
+
+    if (state->step_idx >= state->num_steps) {
+        return EOK;
+    }
+
+    step = &state->steps[state->step_idx];
+
+    switch (step->type) {
+    case CCDB_WB_STEP_DELETE:
+        subreq = be->ops->delete_send(state, state->ev, be,
+                                      &state->wc->client, step->uuid);
+        break;
+    case CCDB_WB_STEP_CREATE:
+        subreq = be->ops->create_send(state, state->ev, be,
+                                      &state->wc->client, step->cc);
+        break;
+    case CCDB_WB_STEP_SET_DEFAULT:
+        subreq = be->ops->set_default_send(state, state->ev, be,
+                                           &state->wc->client, step->uuid);
+        break;
+    default:
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unknown write-back step\n");
+        return EINVAL;
+    }
+
+    if (subreq == NULL) {
+        return ENOMEM;
+    }
+    tevent_req_set_callback(subreq, ccdb_wb_flush_step_done, req);
+    return EAGAIN;
+}
+
+static void ccdb_wb_flush_step_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct ccdb_wb_flush_state *state = tevent_req_data(req,
+                                                struct ccdb_wb_flush_state);
+    struct ccdb_wb_step *step;
+    struct kcm_ccdb *be = state->wc->wb->be;
+    errno_t ret;
+
+    step = &state->steps[state->step_idx];
+
+    switch (step->type) {
+    case CCDB_WB_STEP_DELETE:
+        ret = be->ops->delete_recv(subreq);
+        if (ret == ERR_KCM_CC_END) {
+            /* Already gone, fine */
+            ret = EOK;
+        }
+        break;
+    case CCDB_WB_STEP_CREATE:
+        ret = be->ops->create_recv(subreq);
+        break;
+    case CCDB_WB_STEP_SET_DEFAULT:
+        ret = be->ops->set_default_recv(subreq);
+        break;
+    default:
+        ret = EINVAL;
+        break;
+    }
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Write-back step %zu failed [%d]: %s\n",
+              state->step_idx, ret, sss_strerror(ret));
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    state->step_idx++;
+    ret = ccdb_wb_flush_step(req);
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else if (ret != EAGAIN) {
+        tevent_req_error(req, ret);
+    }
+}
+
+/* Put the steps that were not done back, the next write-back retries them */
+static void ccdb_wb_flush_requeue(struct tevent_req *req)
+{
+    struct ccdb_wb_flush_state *state = tevent_req_data(req,
+                                                struct ccdb_wb_flush_state);
+    struct ccdb_wb_client *wc = state->wc;
+    struct ccdb_wb_step *step;
+    struct ccdb_wb_cc *wcc;
+    size_t i;
+    errno_t ret;
+
+    for (i = state->step_idx; i < state->num_steps; i++) {
+        step = &state->steps[i];
+
+        switch (step->type) {
+        case CCDB_WB_STEP_DELETE:
+            wcc = ccdb_wb_get_by_uuid(wc, step->uuid);
+            if (wcc != NULL) {
+                /* Deleted to be re-created, handled by the create step */
+                break;
+            }
+            ret = ccdb_wb_add_deleted(wc, step->uuid);
+            if (ret != EOK) {
+                DEBUG(SSSDBG_CRIT_FAILURE,
+                      "Cannot requeue deleting a ccache, the back end "
+                      "might keep a stale ccache\n");
+            }
+            break;
+        case CCDB_WB_STEP_CREATE:
+            /* If the ccache was deleted in the meantime, deleting it from
+             * the back end was already queued
+             */
+            wcc = ccdb_wb_get_by_uuid(wc, step->uuid);
+            if (wcc != NULL) {
+                wcc->dirty = true;
+            }
+            break;
+        case CCDB_WB_STEP_SET_DEFAULT:
+            wc->dfl_dirty = true;
+            break;
+        }
+    }
+}
+
+static errno_t ccdb_wb_flush_recv(struct tevent_req *req)
+{
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+    return EOK;
+}
+
+static void ccdb_wb_flush_done(struct tevent_req *req)
+{
+    struct ccdb_wb_client *wc = tevent_req_callback_data(req,
+                                                struct ccdb_wb_client);
+    errno_t ret;
+
+    ret = ccdb_wb_flush_recv(req);
+    if (ret != EOK) {
+        ccdb_wb_flush_requeue(req);
+    }
+    talloc_free(req);
+    wc->flushing = false;
+
+    if (wc->wb->shutting_down) {
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "Cannot write back ccaches of %"SPRIuid" [%d]: %s\n",
+                  wc->uid, ret, sss_strerror(ret));
+            wc->flush_failed = true;
+        }
+
+        if (wc->wb->shutdown_req != NULL) {
+            ccdb_wb_shutdown_next(wc->wb->shutdown_req);
+        }
+        return;
+    }
+
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Cannot write back ccaches of %"SPRIuid" [%d]: %s, "
+              "will retry\n", wc->uid, ret, sss_strerror(ret));
+        ccdb_wb_schedule_flush(wc, CCDB_WB_RETRY_DELAY);
+        return;
+    }
+
+    DEBUG(SSSDBG_TRACE_INTERNAL,
+          "Ccaches of %"SPRIuid" written back\n", wc->uid);
+
+    if (wc->flush_again) {
+        wc->flush_again = false;
+        ccdb_wb_schedule_flush(wc, wc->wb->writeback_delay);
+    }
+}
+
+static errno_t ccdb_wb_flush_start(struct ccdb_wb_client *wc)
+{
+    struct tevent_req *req;
+
+    req = ccdb_wb_flush_send(wc, wc->wb->ev, wc);
+    if (req == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Cannot start write-back\n");
+        return ENOMEM;
+    }
+    tevent_req_set_callback(req, ccdb_wb_flush_done, wc);
+    wc->flushing = true;
+
+    return EOK;
+}
+
+static void ccdb_wb_flush_handler(struct tevent_context *ev,
+                                  struct tevent_timer *te,
+                                  struct timeval current_time,
+                                  void *pvt)
+{
+    struct ccdb_wb_client *wc = talloc_get_type(pvt, struct ccdb_wb_client);
+    errno_t ret;
+
+    wc->flush_te = NULL;
+
+    ret = ccdb_wb_flush_start(wc);
+    if (ret != EOK) {
+        ccdb_wb_schedule_flush(wc, CCDB_WB_RETRY_DELAY);
+    }
+}
+
+/*
+ * Modifications done before the write-back starts are coalesced into
+ * a single write-back
+ */
+static void ccdb_wb_schedule_flush(struct ccdb_wb_client *wc,
+                                   uint32_t delay)
+{
+    struct timeval tv;
+
+    if (wc->wb->shutting_down) {
+        /* The final write-back picks up the modification */
+        return;
+    }
+
+    if (wc->flushing) {
+        wc->flush_again = true;
+        return;
+    }
+
+    if (wc->flush_te != NULL) {
+        return;
+    }
+
+    tv = tevent_timeval_current_ofs(delay, 0);
+    wc->flush_te = tevent_add_timer(wc->wb->ev, wc, tv,
+                                    ccdb_wb_flush_handler, wc);
+    if (wc->flush_te == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Cannot schedule write-back for %"SPRIuid"\n", wc->uid);
+    }
+}
+
+/*
+ * All operations but nextid are synchronous once the ccaches of the UID
+ * are loaded. They all share the same request, the operation itself is
+ * a function that is called with the loaded ccaches.
+ */
+struct ccdb_wb_op_state;
+
+typedef errno_t (*ccdb_wb_op_fn)(struct ccdb_wb_client *wc,
+                                 struct ccdb_wb_op_state *state);
+
+struct ccdb_wb_op_state {
+    ccdb_wb_op_fn fn;
+
+    /* Input */
+    uuid_t uuid;
+    const char *name;
+    struct kcm_ccache *cc;
+    struct kcm_mod_ctx *mod_cc;
+    struct sss_iobuf *cred_blob;
+
+    /* Output */
+    uuid_t *uuid_list;
+    struct kcm_ccache *out_cc;
+    const char *out_name;
+    uuid_t out_uuid;
+};
+
+static void ccdb_wb_op_loaded(struct tevent_req *subreq);
+
+static struct tevent_req *ccdb_wb_op_send(TALLOC_CTX *mem_ctx,
+                                          struct tevent_context *ev,
+                                          struct kcm_ccdb *db,
+                                          struct cli_creds *client,
+                                          ccdb_wb_op_fn fn,
+                                          struct ccdb_wb_op_state **_state)
+{
+    struct tevent_req *req = NULL;
+    struct tevent_req *subreq = NULL;
+    struct ccdb_wb_op_state *state = NULL;
+    struct ccdb_wb *wb = talloc_get_type(db->db_handle, struct ccdb_wb);
+
+    req = tevent_req_create(mem_ctx, &state, struct ccdb_wb_op_state);
+    if (req == NULL) {
+        return NULL;
+    }
+    state->fn = fn;
+
+    /* Always completes in a later tevent tick, so the caller can fill in
+     * the input of the operation after this function returns
+     */
+    subreq = ccdb_wb_load_send(state, ev, wb, client);
+    if (subreq == NULL) {
+        talloc_free(req);
+        return NULL;
+    }
+    tevent_req_set_callback(subreq, ccdb_wb_op_loaded, req);
+
+    *_state = state;
+    return req;
+}
+
+static void ccdb_wb_op_loaded(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct ccdb_wb_op_state *state = tevent_req_data(req,
+                                                struct ccdb_wb_op_state);
+    struct ccdb_wb_client *wc;
+    errno_t ret;
+
+    ret = ccdb_wb_load_recv(subreq, &wc);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    wc->last_used = time(NULL);
+
+    ret = state->fn(wc, state);
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
+static errno_t ccdb_wb_op_recv(struct tevent_req *req)
+{
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+    return EOK;
+}
+
+static errno_t ccdb_wb_modified(struct ccdb_wb_client *wc,
+                                struct ccdb_wb_cc *wcc)
+{
+    if (wcc != NULL) {
+        wcc->dirty = true;
+    }
+
+    ccdb_wb_schedule_flush(wc, wc->wb->writeback_delay);
+    return EOK;
+}
+
+struct ccdb_wb_nextid_state {
+    struct tevent_context *ev;
+    struct ccdb_wb *wb;
+    struct cli_creds *client;
+
+    unsigned int nextid;
+    int tries;
+};
+
+static errno_t ccdb_wb_nextid_try(struct tevent_req *req);
+static void ccdb_wb_nextid_done(struct tevent_req *subreq);
+
+static struct tevent_req *ccdb_wb_nextid_send(TALLOC_CTX *mem_ctx,
+                                              struct tevent_context *ev,
+                                              struct kcm_ccdb *db,
+                                              struct cli_creds *client)
+{
+    struct tevent_req *req = NULL;
+    struct ccdb_wb_nextid_state *state = NULL;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct ccdb_wb_nextid_state);
+    if (req == NULL) {
+        return NULL;
+    }
+    state->ev = ev;
+    state->wb = talloc_get_type(db->db_handle, struct ccdb_wb);
+    state->client = client;
+
+    ret = ccdb_wb_nextid_try(req);
+    if (ret != EAGAIN) {
+        tevent_req_error(req, ret);
+        tevent_req_post(req, ev);
+        return req;
+    }
+
+    return req;
+}
+
+static errno_t ccdb_wb_nextid_try(struct tevent_req *req)
+{
+    struct ccdb_wb_nextid_state *state = tevent_req_data(req,
+                                                struct ccdb_wb_nextid_state);
+    struct tevent_req *subreq;
+
+    if (state->tries++ >= CCDB_WB_NEXTID_TRIES) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Failed to find a free ccache name in %d tries\n",
+              CCDB_WB_NEXTID_TRIES);
+        return EBUSY;
+    }
+
+    subreq = state->wb->be->ops->nextid_send(state, state->ev,
+                                             state->wb->be, state->client);
+    if (subreq == NULL) {
+        return ENOMEM;
+    }
+    tevent_req_set_callback(subreq, ccdb_wb_nextid_done, req);
+    return EAGAIN;
+}
+
+static void ccdb_wb_nextid_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct ccdb_wb_nextid_state *state = tevent_req_data(req,
+                                                struct ccdb_wb_nextid_state);
+    struct ccdb_wb_client *wc;
+    char *name;
+    errno_t ret;
+
+    ret = state->wb->be->ops->nextid_recv(subreq, &state->nextid);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    /* The back end does not know about ccaches that were not written
+     * back yet, make sure the name is not taken by one of them
+     */
+    wc = ccdb_wb_client_lookup(state->wb, cli_creds_get_uid(state->client));
+    if (wc == NULL) {
+        tevent_req_done(req);
+        return;
+    }
+
+    name = talloc_asprintf(state, "%"SPRIuid":%u",
+                           cli_creds_get_uid(state->client), state->nextid);
+    if (name == NULL) {
+        tevent_req_error(req, ENOMEM);
+        return;
+    }
+
+    if (ccdb_wb_get_by_name(wc, name) == NULL) {
+        talloc_free(name);
+        tevent_req_done(req);
+        return;
+    }
+    talloc_free(name);
+
+    ret = ccdb_wb_nextid_try(req);
+    if (ret != EAGAIN) {
+        tevent_req_error(req, ret);
+        return;
+    }
+}
+
+static errno_t ccdb_wb_nextid_recv(struct tevent_req *req,
+                                   unsigned int *_nextid)
+{
+    struct ccdb_wb_nextid_state *state = tevent_req_data(req,
+                                                struct ccdb_wb_nextid_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+    *_nextid = state->nextid;
+    return EOK;
+}
+
+static errno_t ccdb_wb_set_default_fn(struct ccdb_wb_client *wc,
+                                      struct ccdb_wb_op_state *state)
+{
+    if (uuid_compare(wc->dfl, state->uuid) == 0) {
+        return EOK;
+    }
+
+    uuid_copy(wc->dfl, state->uuid);
+    wc->dfl_dirty = true;
+    return ccdb_wb_modified(wc, NULL);
+}
+
+static struct tevent_req *ccdb_wb_set_default_send(TALLOC_CTX *mem_ctx,
+                                                   struct tevent_context *ev,
+                                                   struct kcm_ccdb *db,
+                                                   struct cli_creds *client,
+                                                   uuid_t uuid)
+{
+    struct tevent_req *req;
+    struct ccdb_wb_op_state *state;
+
+    req = ccdb_wb_op_send(mem_ctx, ev, db, client,
+                          ccdb_wb_set_default_fn, &state);
+    if (req == NULL) {
+        return NULL;
+    }
+    uuid_copy(state->uuid, uuid);
+
+    return req;
+}
+
+static errno_t ccdb_wb_set_default_recv(struct tevent_req *req)
+{
+    return ccdb_wb_op_recv(req);
+}
+
+static errno_t ccdb_wb_get_default_fn(struct ccdb_wb_client *wc,
+                                      struct ccdb_wb_op_state *state)
+{
+    uuid_copy(state->out_uuid, wc->dfl);
+    return EOK;
+}
+
+static struct tevent_req *ccdb_wb_get_default_send(TALLOC_CTX *mem_ctx,
+                                                   struct tevent_context *ev,
+                                                   struct kcm_ccdb *db,
+                                                   struct cli_creds *client)
+{
+    struct ccdb_wb_op_state *state;
+
+    return ccdb_wb_op_send(mem_ctx, ev, db, client,
+                           ccdb_wb_get_default_fn, &state);
+}
+
+static errno_t ccdb_wb_get_default_recv(struct tevent_req *req,
+                                        uuid_t dfl)
+{
+    struct ccdb_wb_op_state *state = tevent_req_data(req,
+                                                struct ccdb_wb_op_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+    uuid_copy(dfl, state->out_uuid);
+    return EOK;
+}
+
+static errno_t ccdb_wb_list_fn(struct ccdb_wb_client *wc,
+                               struct ccdb_wb_op_state *state)
+{
+    struct ccdb_wb_cc *wcc;
+    size_t num_ccaches = 0;
+    size_t i = 0;
+
+    DLIST_FOR_EACH(wcc, wc->ccaches) {
+        num_ccaches++;
+    }
+
+    state->uuid_list = talloc_zero_array(state, uuid_t, num_ccaches + 1);
+    if (state->uuid_list == NULL) {
+        return ENOMEM;
+    }
+
+    DLIST_FOR_EACH(wcc, wc->ccaches) {
+        uuid_copy(state->uuid_list[i], wcc->cc->uuid);
+        i++;
+    }
+    uuid_clear(state->uuid_list[num_ccaches]);
+
+    return EOK;
+}
+
+static struct tevent_req *ccdb_wb_list_send(TALLOC_CTX *mem_ctx,
+                                            struct tevent_context *ev,
+                                            struct kcm_ccdb *db,
+                                            struct cli_creds *client)
+{
+    struct ccdb_wb_op_state *state;
+
+    return ccdb_wb_op_send(mem_ctx, ev, db, client,
+                           ccdb_wb_list_fn, &state);
+}
+
+static errno_t ccdb_wb_list_recv(struct tevent_req *req,
+                                 TALLOC_CTX *mem_ctx,
+                                 uuid_t **_uuid_list)
+{
+    struct ccdb_wb_op_state *state = tevent_req_data(req,
+                                                struct ccdb_wb_op_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+    *_uuid_list = talloc_steal(mem_ctx, state->uuid_list);
+    return EOK;
+}
+
+static errno_t ccdb_wb_dup_found(struct ccdb_wb_cc *wcc,
+                                 struct ccdb_wb_op_state *state)
+{
+    if (wcc == NULL) {
+        state->out_cc = NULL;
+        return EOK;
+    }
+
+    state->out_cc = ccdb_wb_cc_dup(state, wcc->cc);
+    if (state->out_cc == NULL) {
+        return ENOMEM;
+    }
+
+    return EOK;
+}
+
+static errno_t ccdb_wb_getbyname_fn(struct ccdb_wb_client *wc,
+                                    struct ccdb_wb_op_state *state)
+{
+    return ccdb_wb_dup_found(ccdb_wb_get_by_name(wc, state->name), state);
+}
+
+static struct tevent_req *ccdb_wb_getbyname_send(TALLOC_CTX *mem_ctx,
+                                                 struct tevent_context *ev,
+                                                 struct kcm_ccdb *db,
+                                                 struct cli_creds *client,
+                                                 const char *name)
+{
+    struct tevent_req *req;
+    struct ccdb_wb_op_state *state;
+
+    req = ccdb_wb_op_send(mem_ctx, ev, db, client,
+                          ccdb_wb_getbyname_fn, &state);
+    if (req == NULL) {
+        return NULL;
+    }
+    state->name = name;
+
+    return req;
+}
+
+static errno_t ccdb_wb_getbyname_recv(struct tevent_req *req,
+                                      TALLOC_CTX *mem_ctx,
+                                      struct kcm_ccache **_cc)
+{
+    struct ccdb_wb_op_state *state = tevent_req_data(req,
+                                                struct ccdb_wb_op_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+    *_cc = talloc_steal(mem_ctx, state->out_cc);
+    return EOK;
+}
+
+static errno_t ccdb_wb_getbyuuid_fn(struct ccdb_wb_client *wc,
+                                    struct ccdb_wb_op_state *state)
+{
+    return ccdb_wb_dup_found(ccdb_wb_get_by_uuid(wc, state->uuid), state);
+}
+
+static struct tevent_req *ccdb_wb_getbyuuid_send(TALLOC_CTX *mem_ctx,
+                                                 struct tevent_context *ev,
+                                                 struct kcm_ccdb *db,
+                                                 struct cli_creds *client,
+                                                 uuid_t uuid)
+{
+    struct tevent_req *req;
+    struct ccdb_wb_op_state *state;
+
+    req = ccdb_wb_op_send(mem_ctx, ev, db, client,
+                          ccdb_wb_getbyuuid_fn, &state);
+    if (req == NULL) {
+        return NULL;
+    }
+    uuid_copy(state->uuid, uuid);
+
+    return req;
+}
+
+static errno_t ccdb_wb_getbyuuid_recv(struct tevent_req *req,
+                                      TALLOC_CTX *mem_ctx,
+                                      struct kcm_ccache **_cc)
+{
+    return ccdb_wb_getbyname_recv(req, mem_ctx, _cc);
+}
+
+static errno_t ccdb_wb_name_by_uuid_fn(struct ccdb_wb_client *wc,
+                                       struct ccdb_wb_op_state *state)
+{
+    struct ccdb_wb_cc *wcc;
+
+    wcc = ccdb_wb_get_by_uuid(wc, state->uuid);
+    if (wcc == NULL) {
+        return ERR_KCM_CC_END;
+    }
+
+    state->out_name = talloc_strdup(state, wcc->cc->name);
+    if (state->out_name == NULL) {
+        return ENOMEM;
+    }
+
+    return EOK;
+}
+
+static struct tevent_req *ccdb_wb_name_by_uuid_send(TALLOC_CTX *mem_ctx,
+                                                    struct tevent_context *ev,
+                                                    struct kcm_ccdb *db,
+                                                    struct cli_creds *client,
+                                                    uuid_t uuid)
+{
+    struct tevent_req *req;
+    struct ccdb_wb_op_state *state;
+
+    req = ccdb_wb_op_send(mem_ctx, ev, db, client,
+                          ccdb_wb_name_by_uuid_fn, &state);
+    if (req == NULL) {
+        return NULL;
+    }
+    uuid_copy(state->uuid, uuid);
+
+    return req;
+}
+
+static errno_t ccdb_wb_name_by_uuid_recv(struct tevent_req *req,
+                                         TALLOC_CTX *mem_ctx,
+                                         const char **_name)
+{
+    struct ccdb_wb_op_state *state = tevent_req_data(req,
+                                                struct ccdb_wb_op_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+    *_name = talloc_steal(mem_ctx, state->out_name);
+    return EOK;
+}
+
+static errno_t ccdb_wb_uuid_by_name_fn(struct ccdb_wb_client *wc,
+                                       struct ccdb_wb_op_state *state)
+{
+    struct ccdb_wb_cc *wcc;
+
+    wcc = ccdb_wb_get_by_name(wc, state->name);
+    if (wcc == NULL) {
+        return ERR_KCM_CC_END;
+    }
+
+    uuid_copy(state->out_uuid, wcc->cc->uuid);
+    return EOK;
+}
+
+static struct tevent_req *ccdb_wb_uuid_by_name_send(TALLOC_CTX *mem_ctx,
+                                                    struct tevent_context *ev,
+                                                    struct kcm_ccdb *db,
+                                                    struct cli_creds *client,
+                                                    const char *name)
+{
+    struct tevent_req *req;
+    struct ccdb_wb_op_state *state;
+
+    req = ccdb_wb_op_send(mem_ctx, ev, db, client,
+                          ccdb_wb_uuid_by_name_fn, &state);
+    if (req == NULL) {
+        return NULL;
+    }
+    state->name = name;
+
+    return req;
+}
+
+static errno_t ccdb_wb_uuid_by_name_recv(struct tevent_req *req,
+                                         TALLOC_CTX *mem_ctx,
+                                         uuid_t _uuid)
+{
+    struct ccdb_wb_op_state *state = tevent_req_data(req,
+                                                struct ccdb_wb_op_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+    uuid_copy(_uuid, state->out_uuid);
+    return EOK;
+}
+
+/* The back end would refuse the write-back, refuse the change right away
+ * so that the client gets the error */
+static errno_t ccdb_wb_check_quota(struct ccdb_wb_client *wc,
+                                   size_t new_ccaches,
+                                   size_t new_creds)
+{
+    struct ccdb_wb_cc *wcc;
+    struct kcm_cred *crd;
+    size_t num_ccaches = new_ccaches;
+    size_t num_creds = new_creds;
+
+    DLIST_FOR_EACH(wcc, wc->ccaches) {
+        num_ccaches++;
+        DLIST_FOR_EACH(crd, wcc->cc->creds) {
+            num_creds++;
+        }
+    }
+
+    return kcm_ccdb_check_quota(&wc->wb->be->limits, num_ccaches, num_creds);
+}
+
+static errno_t ccdb_wb_create_fn(struct ccdb_wb_client *wc,
+                                 struct ccdb_wb_op_state *state)
+{
+    struct kcm_ccache *cc;
+    struct kcm_cred *crd;
+    size_t num_creds = 0;
+    errno_t ret;
+
+    DLIST_FOR_EACH(crd, state->cc->creds) {
+        ret = kcm_ccdb_check_payload(&wc->wb->be->limits, crd->cred_blob);
+        if (ret != EOK) {
+            return ret;
+        }
+        num_creds++;
+    }
+
+    ret = ccdb_wb_check_quota(wc, 1, num_creds);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    /* The caller keeps using its ccache */
+    cc = ccdb_wb_cc_dup(wc, state->cc);
+    if (cc == NULL) {
+        return ENOMEM;
+    }
+
+    ret = ccdb_wb_add_cc(wc, cc, false);
+    if (ret != EOK) {
+        talloc_free(cc);
+        return ret;
+    }
+
+    return ccdb_wb_modified(wc, NULL);
+}
+
+static struct tevent_req *ccdb_wb_create_send(TALLOC_CTX *mem_ctx,
+                                              struct tevent_context *ev,
+                                              struct kcm_ccdb *db,
+                                              struct cli_creds *client,
+                                              struct kcm_ccache *cc)
+{
+    struct tevent_req *req;
+    struct ccdb_wb_op_state *state;
+
+    req = ccdb_wb_op_send(mem_ctx, ev, db, client,
+                          ccdb_wb_create_fn, &state);
+    if (req == NULL) {
+        return NULL;
+    }
+    state->cc = cc;
+
+    return req;
+}
+
+static errno_t ccdb_wb_create_recv(struct tevent_req *req)
+{
+    return ccdb_wb_op_recv(req);
+}
+
+static errno_t ccdb_wb_mod_fn(struct ccdb_wb_client *wc,
+                              struct ccdb_wb_op_state *state)
+{
+    struct ccdb_wb_cc *wcc;
+
+    wcc = ccdb_wb_get_by_uuid(wc, state->uuid);
+    if (wcc == NULL) {
+        return ERR_KCM_CC_END;
+    }
+
+    kcm_mod_cc(wcc->cc, state->mod_cc);
+    return ccdb_wb_modified(wc, wcc);
+}
+
+static struct tevent_req *ccdb_wb_mod_send(TALLOC_CTX *mem_ctx,
+                                           struct tevent_context *ev,
+                                           struct kcm_ccdb *db,
+                                           struct cli_creds *client,
+                                           uuid_t uuid,
+                                           struct kcm_mod_ctx *mod_cc)
+{
+    struct tevent_req *req;
+    struct ccdb_wb_op_state *state;
+
+    req = ccdb_wb_op_send(mem_ctx, ev, db, client,
+                          ccdb_wb_mod_fn, &state);
+    if (req == NULL) {
+        return NULL;
+    }
+    uuid_copy(state->uuid, uuid);
+    state->mod_cc = mod_cc;
+
+    return req;
+}
+
+static errno_t ccdb_wb_mod_recv(struct tevent_req *req)
+{
+    return ccdb_wb_op_recv(req);
+}
+
+static errno_t ccdb_wb_store_cred_fn(struct ccdb_wb_client *wc,
+                                     struct ccdb_wb_op_state *state)
+{
+    struct ccdb_wb_cc *wcc;
+    struct sss_iobuf *blob;
+    errno_t ret;
+
+    wcc = ccdb_wb_get_by_uuid(wc, state->uuid);
+    if (wcc == NULL) {
+        return ERR_KCM_CC_END;
+    }
+
+    ret = kcm_ccdb_check_payload(&wc->wb->be->limits, state->cred_blob);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    ret = ccdb_wb_check_quota(wc, 0, 1);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    blob = sss_iobuf_init_readonly(wcc->cc,
+                                   sss_iobuf_get_data(state->cred_blob),
+                                   sss_iobuf_get_size(state->cred_blob));
+    if (blob == NULL) {
+        return ENOMEM;
+    }
+
+    ret = kcm_cc_store_cred_blob(wcc->cc, blob);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Cannot store credentials to ccache [%d]: %s\n",
+              ret, sss_strerror(ret));
+        talloc_free(blob);
+        return ret;
+    }
+
+    return ccdb_wb_modified(wc, wcc);
+}
+
+static struct tevent_req *ccdb_wb_store_cred_send(TALLOC_CTX *mem_ctx,
+                                                  struct tevent_context *ev,
+                                                  struct kcm_ccdb *db,
+                                                  struct cli_creds *client,
+                                                  uuid_t uuid,
+                                                  struct sss_iobuf *cred_blob)
+{
+    struct tevent_req *req;
+    struct ccdb_wb_op_state *state;
+
+    req = ccdb_wb_op_send(mem_ctx, ev, db, client,
+                          ccdb_wb_store_cred_fn, &state);
+    if (req == NULL) {
+        return NULL;
+    }
+    uuid_copy(state->uuid, uuid);
+    state->cred_blob = cred_blob;
+
+    return req;
+}
+
+static errno_t ccdb_wb_store_cred_recv(struct tevent_req *req)
+{
+    return ccdb_wb_op_recv(req);
+}
+
+static errno_t ccdb_wb_delete_fn(struct ccdb_wb_client *wc,
+                                 struct ccdb_wb_op_state *state)
+{
+    struct ccdb_wb_cc *wcc;
+    errno_t ret;
+
+    wcc = ccdb_wb_get_by_uuid(wc, state->uuid);
+    if (wcc == NULL) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "BUG: Attempting to free unknown ccache\n");
+        return ERR_KCM_CC_END;
+    }
+
+    if (wcc->stored) {
+        ret = ccdb_wb_add_deleted(wc, state->uuid);
+        if (ret != EOK) {
+            return ret;
+        }
+    }
+
+    DLIST_REMOVE(wc->ccaches, wcc);
+    talloc_free(wcc);
+
+    return ccdb_wb_modified(wc, NULL);
+}
+
+static struct tevent_req *ccdb_wb_delete_send(TALLOC_CTX *mem_ctx,
+                                              struct tevent_context *ev,
+                                              struct kcm_ccdb *db,
+                                              struct cli_creds *client,
+                                              uuid_t uuid)
+{
+    struct tevent_req *req;
+    struct ccdb_wb_op_state *state;
+
+    req = ccdb_wb_op_send(mem_ctx, ev, db, client,
+                          ccdb_wb_delete_fn, &state);
+    if (req == NULL) {
+        return NULL;
+    }
+    uuid_copy(state->uuid, uuid);
+
+    return req;
+}
+
+static errno_t ccdb_wb_delete_recv(struct tevent_req *req)
+{
+    return ccdb_wb_op_recv(req);
+}
+
+/* The cache is not a standalone back end, it is set up on top of an
+ * initialized database with kcm_ccdb_wb_setup(), so there is no init
+ * function
+ */
+static const struct kcm_ccdb_ops ccdb_wb_ops = {
+    .nextid_send = ccdb_wb_nextid_send,
+    .nextid_recv = ccdb_wb_nextid_recv,
+
+    .set_default_send = ccdb_wb_set_default_send,
+    .set_default_recv = ccdb_wb_set_default_recv,
+
+    .get_default_send = ccdb_wb_get_default_send,
+    .get_default_recv = ccdb_wb_get_default_recv,
+
+    .list_send = ccdb_wb_list_send,
+    .list_recv = ccdb_wb_list_recv,
+
+    .getbyname_send = ccdb_wb_getbyname_send,
+    .getbyname_recv = ccdb_wb_getbyname_recv,
+
+    .getbyuuid_send = ccdb_wb_getbyuuid_send,
+    .getbyuuid_recv = ccdb_wb_getbyuuid_recv,
+
+    .name_by_uuid_send = ccdb_wb_name_by_uuid_send,
+    .name_by_uuid_recv = ccdb_wb_name_by_uuid_recv,
+
+    .uuid_by_name_send = ccdb_wb_uuid_by_name_send,
+    .uuid_by_name_recv = ccdb_wb_uuid_by_name_recv,
+
+    .create_send = ccdb_wb_create_send,
+    .create_recv = ccdb_wb_create_recv,
+
+    .mod_send = ccdb_wb_mod_send,
+    .mod_recv = ccdb_wb_mod_recv,
+
+    .store_cred_send = ccdb_wb_store_cred_send,
+    .store_cred_recv = ccdb_wb_store_cred_recv,
+
+    .delete_send = ccdb_wb_delete_send,
+    .delete_recv = ccdb_wb_delete_recv,
+};
+
+struct ccdb_wb_shutdown_state;
+static void ccdb_wb_shutdown_detach(struct tevent_req *req);
+
+static int ccdb_wb_destructor(struct ccdb_wb *wb)
+{
+    struct ccdb_wb_client *wc;
+    hash_value_t *values;
+    unsigned long count;
+    unsigned long i;
+    int hret;
+
+    if (wb->shutdown_req != NULL) {
+        ccdb_wb_shutdown_detach(wb->shutdown_req);
+    }
+
+    hret = hash_values(wb->clients, &count, &values);
+    if (hret != HASH_SUCCESS) {
+        return 0;
+    }
+
+    for (i = 0; i < count; i++) {
+        wc = talloc_get_type(values[i].ptr, struct ccdb_wb_client);
+        if (!ccdb_wb_client_is_clean(wc)) {
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "Modified ccaches of %"SPRIuid" were not written back\n",
+                  wc->uid);
+        }
+    }
+    talloc_free(values);
+
+    return 0;
+}
+
+errno_t kcm_ccdb_wb_setup(struct kcm_ccdb *db,
+                          uint32_t writeback_delay,
+                          uint32_t idle_timeout)
+{
+    struct ccdb_wb *wb;
+    errno_t ret;
+
+    if (db == NULL || db->ops == &ccdb_wb_ops) {
+        return EINVAL;
+    }
+
+    wb = talloc_zero(db, struct ccdb_wb);
+    if (wb == NULL) {
+        return ENOMEM;
+    }
+    wb->ev = db->ev;
+    wb->writeback_delay = writeback_delay;
+    wb->idle_timeout = idle_timeout;
+
+    ret = sss_hash_create(wb, CCDB_WB_HASH_SIZE, &wb->clients);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "sss_hash_create failed [%d]: %s\n", ret, sss_strerror(ret));
+        talloc_free(wb);
+        return ret;
+    }
+
+    /* The original database keeps its handle and operations and is only
+     * used by the cache from now on
+     */
+    wb->be = talloc_zero(wb, struct kcm_ccdb);
+    if (wb->be == NULL) {
+        talloc_free(wb);
+        return ENOMEM;
+    }
+    wb->be->cc_be_type = db->cc_be_type;
+    wb->be->ev = db->ev;
+    wb->be->db_handle = db->db_handle;
+    wb->be->ops = db->ops;
+    wb->be->limits = db->limits;
+
+    db->db_handle = wb;
+    db->ops = &ccdb_wb_ops;
+    talloc_set_destructor(wb, ccdb_wb_destructor);
+
+    DEBUG(SSSDBG_CONF_SETTINGS,
+          "KCM ccache cache: write-back delay %"PRIu32"s, "
+          "idle timeout %"PRIu32"s\n", writeback_delay, idle_timeout);
+    return EOK;
+}
+
+struct ccdb_wb_shutdown_state {
+    struct ccdb_wb *wb;
+    struct tevent_timer *timeout;
+};
+
+static int ccdb_wb_shutdown_state_destructor(struct ccdb_wb_shutdown_state *state)
+{
+    if (state->wb != NULL) {
+        state->wb->shutdown_req = NULL;
+    }
+
+    return 0;
+}
+
+static void ccdb_wb_shutdown_timeout(struct tevent_context *ev,
+                                     struct tevent_timer *te,
+                                     struct timeval current_time,
+                                     void *pvt);
+
+/* The cache is freed while the request is still pending */
+static void ccdb_wb_shutdown_detach(struct tevent_req *req)
+{
+    struct ccdb_wb_shutdown_state *state = tevent_req_data(req,
+                                                struct ccdb_wb_shutdown_state);
+
+    state->wb = NULL;
+}
+
+struct tevent_req *kcm_ccdb_wb_shutdown_send(TALLOC_CTX *mem_ctx,
+                                             struct tevent_context *ev,
+                                             struct kcm_ccdb *db)
+{
+    struct tevent_req *req = NULL;
+    struct ccdb_wb_shutdown_state *state = NULL;
+    struct timeval tv;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct ccdb_wb_shutdown_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    if (db->ops != &ccdb_wb_ops) {
+        /* Nothing is cached */
+        ret = EOK;
+        goto immediate;
+    }
+
+    state->wb = talloc_get_type(db->db_handle, struct ccdb_wb);
+    if (state->wb->shutdown_req != NULL) {
+        ret = EALREADY;
+        goto immediate;
+    }
+
+    tv = tevent_timeval_current_ofs(CCDB_WB_SHUTDOWN_TIMEOUT, 0);
+    state->timeout = tevent_add_timer(ev, state, tv,
+                                      ccdb_wb_shutdown_timeout, req);
+    if (state->timeout == NULL) {
+        ret = ENOMEM;
+        goto immediate;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Writing back all cached ccaches\n");
+
+    state->wb->shutting_down = true;
+    state->wb->shutdown_req = req;
+    talloc_set_destructor(state, ccdb_wb_shutdown_state_destructor);
+
+    ccdb_wb_shutdown_next(req);
+    if (!tevent_req_is_in_progress(req)) {
+        tevent_req_post(req, ev);
+    }
+    return req;
+
+immediate:
+    state->wb = NULL;
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+    return req;
+}
+
+/* Starts the write-back of every dirty UID that is not being written back
+ * yet, the request finishes once no write-back is running */
+static void ccdb_wb_shutdown_next(struct tevent_req *req)
+{
+    struct ccdb_wb_shutdown_state *state = tevent_req_data(req,
+                                                struct ccdb_wb_shutdown_state);
+    struct ccdb_wb_client *wc;
+    hash_value_t *values;
+    unsigned long count;
+    unsigned long i;
+    bool running = false;
+    bool failed = false;
+    errno_t ret;
+    int hret;
+
+    hret = hash_values(state->wb->clients, &count, &values);
+    if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to get values [%d]\n", hret);
+        tevent_req_error(req, EIO);
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        wc = talloc_get_type(values[i].ptr, struct ccdb_wb_client);
+
+        /* Retries are not waited for, the client is not dropped anymore */
+        talloc_zfree(wc->flush_te);
+        talloc_zfree(wc->idle_te);
+
+        if (wc->flushing) {
+            running = true;
+            continue;
+        }
+
+        if (wc->flush_failed) {
+            failed = true;
+            continue;
+        }
+
+        if (ccdb_wb_client_is_clean(wc)) {
+            continue;
+        }
+
+        ret = ccdb_wb_flush_start(wc);
+        if (ret != EOK) {
+            wc->flush_failed = true;
+            failed = true;
+            continue;
+        }
+        running = true;
+    }
+    talloc_free(values);
+
+    if (running) {
+        return;
+    }
+
+    /* Write-backs that finish later do not report here anymore */
+    state->wb->shutdown_req = NULL;
+    talloc_zfree(state->timeout);
+    if (failed) {
+        tevent_req_error(req, EIO);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
+static void ccdb_wb_shutdown_timeout(struct tevent_context *ev,
+                                     struct tevent_timer *te,
+                                     struct timeval current_time,
+                                     void *pvt)
+{
+    struct tevent_req *req = talloc_get_type(pvt, struct tevent_req);
+    struct ccdb_wb_shutdown_state *state = tevent_req_data(req,
+                                                struct ccdb_wb_shutdown_state);
+
+    state->timeout = NULL;
+    if (state->wb != NULL) {
+        state->wb->shutdown_req = NULL;
+    }
+
+    DEBUG(SSSDBG_CRIT_FAILURE,
+          "Writing back the cached ccaches timed out\n");
+    tevent_req_error(req, ETIMEDOUT);
+}
+
+errno_t kcm_ccdb_wb_shutdown_recv(struct tevent_req *req)
+{
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+    return EOK;
+}
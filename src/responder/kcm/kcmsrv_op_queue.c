@@ -30,6 +30,11 @@ struct kcm_ops_queue_entry {
 
     struct kcm_ops_queue *queue;
 
+    /* Read-only operations may run concurrently with one another */
+    bool readonly;
+    /* The request was already let through the queue */
+    bool running;
+
     struct kcm_ops_queue_entry *next;
     struct kcm_ops_queue_entry *prev;
 };
@@ -54,6 +59,12 @@ struct kcm_ops_queue_ctx {
  * hash table entry is kcm_ops_queue structure which in turn contains a
  * linked list of kcm_ops_queue_entry structures * which primarily hold the
  * tevent request being queued.
+ *
+ * The queue is a readers-writer queue. Any number of read-only requests
+ * at the head of the queue run concurrently, a request that modifies the
+ * ccaches only runs when it is alone at the head of the queue. A queued
+ * writer also blocks any readers that arrived after it, so the ordering of
+ * requests is kept wherever a write is involved and writers are not starved.
  */
 struct kcm_ops_queue_ctx *kcm_ops_queue_create(TALLOC_CTX *mem_ctx)
 {
@@ -113,22 +124,58 @@ void queue_removal_cb(struct tevent_context *ctx,
     talloc_free(kq);
 }
 
+/*
+ * Let through all the requests at the head of the queue that can run now,
+ * that is either a run of readers or a single writer.
+ *
+ * Marking a request as done invokes its callback which might in turn free
+ * another queue entry, so the queue is scanned from its head again after
+ * each activated request.
+ */
+static void kcm_op_queue_activate(struct kcm_ops_queue *kq)
+{
+    struct kcm_ops_queue_entry *entry;
+    bool activated;
+
+    do {
+        activated = false;
+
+        DLIST_FOR_EACH(entry, kq->head) {
+            if (entry->running) {
+                if (entry->readonly) {
+                    continue;
+                }
+                /* A writer is running, nobody else may */
+                break;
+            }
+
+            if (entry->readonly == false && entry != kq->head) {
+                /* A writer must wait until the readers before it finish */
+                break;
+            }
+
+            DEBUG(SSSDBG_TRACE_LIBS, "Running the next %s request for %"SPRIuid"\n",
+                  entry->readonly ? "read-only" : "read-write", kq->uid);
+            entry->running = true;
+            tevent_req_done(entry->req);
+            activated = true;
+            break;
+        }
+    } while (activated);
+}
+
 static int kcm_op_queue_entry_destructor(struct kcm_ops_queue_entry *entry)
 {
-    struct kcm_ops_queue_entry *next_entry;
     struct tevent_immediate *imm;
 
     if (entry == NULL) {
         return 1;
     }
 
-    /* Take the next entry from the queue */
-    next_entry = entry->next;
-
     /* Remove the current entry from the queue */
     DLIST_REMOVE(entry->queue->head, entry);
 
-    if (next_entry == NULL) {
+    if (entry->queue->head == NULL) {
         /* If there was no other entry, schedule removal of the queue. Do it
          * in another tevent tick to avoid issues with callbacks invoking
          * the descructor while another request is touching the queue
@@ -142,8 +189,8 @@ static int kcm_op_queue_entry_destructor(struct kcm_ops_queue_entry *entry)
         return 0;
     }
 
-    /* Otherwise, mark the current head as done to run the next request */
-    tevent_req_done(next_entry->req);
+    /* Otherwise, run the requests that were waiting for this one */
+    kcm_op_queue_activate(entry->queue);
     return 0;
 }
 
@@ -214,22 +261,26 @@ struct kcm_op_queue_state {
 };
 
 static errno_t kcm_op_queue_add_req(struct kcm_ops_queue *kq,
-                                    struct tevent_req *req);
+                                    struct tevent_req *req,
+                                    bool readonly);
 
 /*
  * Enqueue a request.
  *
  * If the request queue /for the given ID/ is empty, that is, if this
  * request is the first one in the queue, run the request immediatelly.
+ * A read-only request is also run immediatelly if the queue only contains
+ * other read-only requests that are already running.
  *
- * Otherwise just add it to the queue and wait until the previous request
- * finishes and only at that point mark the current request as done, which
+ * Otherwise just add it to the queue and wait until the previous requests
+ * finish and only at that point mark the current request as done, which
  * will trigger calling the recv function and allow the request to continue.
  */
 struct tevent_req *kcm_op_queue_send(TALLOC_CTX *mem_ctx,
                                      struct tevent_context *ev,
                                      struct kcm_ops_queue_ctx *qctx,
-                                     struct cli_creds *client)
+                                     struct cli_creds *client,
+                                     bool readonly)
 {
     errno_t ret;
     struct tevent_req *req;
@@ -255,10 +306,10 @@ struct tevent_req *kcm_op_queue_send(TALLOC_CTX *mem_ctx,
         goto immediate;
     }
 
-    ret = kcm_op_queue_add_req(kq, req);
+    ret = kcm_op_queue_add_req(kq, req, readonly);
     if (ret == EOK) {
         DEBUG(SSSDBG_TRACE_LIBS,
-              "Queue was empty, running the request immediately\n");
+              "Nothing to wait for, running the request immediately\n");
         goto immediate;
     } else if (ret != EAGAIN) {
         DEBUG(SSSDBG_OP_FAILURE,
@@ -280,8 +331,10 @@ immediate:
 }
 
 static errno_t kcm_op_queue_add_req(struct kcm_ops_queue *kq,
-                                    struct tevent_req *req)
+                                    struct tevent_req *req,
+                                    bool readonly)
 {
+    struct kcm_ops_queue_entry *entry;
     errno_t ret;
     struct kcm_op_queue_state *state = tevent_req_data(req,
                                                 struct kcm_op_queue_state);
@@ -292,16 +345,31 @@ static errno_t kcm_op_queue_add_req(struct kcm_ops_queue *kq,
     }
     state->entry->req = req;
     state->entry->queue = kq;
+    state->entry->readonly = readonly;
     talloc_set_destructor(state->entry, kcm_op_queue_entry_destructor);
 
     if (kq->head == NULL) {
         /* First entry, will run callback at once */
         ret = EOK;
+    } else if (readonly) {
+        /* Can join the readers unless there is a writer in the queue
+         * or another request already waiting */
+        ret = EOK;
+        DLIST_FOR_EACH(entry, kq->head) {
+            if (entry->readonly == false || entry->running == false) {
+                ret = EAGAIN;
+                break;
+            }
+        }
     } else {
         /* Will wait for the previous callbacks to finish */
         ret = EAGAIN;
     }
 
+    if (ret == EOK) {
+        state->entry->running = true;
+    }
+
     DLIST_ADD_END(kq->head, state->entry, struct kcm_ops_queue_entry *);
     return ret;
 }
@@ -54,6 +54,20 @@ struct kcm_resp_ctx {
 enum kcm_ccdb_be {
     CCDB_BE_MEMORY,
     CCDB_BE_SECRETS,
+    CCDB_BE_TDB,
+};
+
+/*
+ * How much a single UID can store in a ccache database. A value of 0
+ * means no limit.
+ */
+struct kcm_ccdb_limits {
+    /* ccaches of the UID */
+    uint32_t max_uid_ccaches;
+    /* credentials in all the ccaches of the UID */
+    uint32_t max_uid_creds;
+    /* size of a single credential in bytes */
+    uint32_t max_payload_size;
 };
 
 /*
@@ -66,7 +80,12 @@ struct kcm_ctx {
     int fd_limit;
     char *socket_path;
     enum kcm_ccdb_be cc_be;
+    int cache_timeout;
+    int writeback_delay;
+    struct kcm_ccdb_limits limits;
     struct kcm_ops_queue_ctx *qctx;
+    /* Waiting for the cached ccaches to be written back before exiting */
+    bool exiting;
 
     struct kcm_resp_ctx *kcm_data;
 };
@@ -92,7 +111,8 @@ struct kcm_ops_queue_ctx *kcm_ops_queue_create(TALLOC_CTX *mem_ctx);
 struct tevent_req *kcm_op_queue_send(TALLOC_CTX *mem_ctx,
                                      struct tevent_context *ev,
                                      struct kcm_ops_queue_ctx *qctx,
-                                     struct cli_creds *client);
+                                     struct cli_creds *client,
+                                     bool readonly);
 
 errno_t kcm_op_queue_recv(struct tevent_req *req,
                           TALLOC_CTX *mem_ctx,
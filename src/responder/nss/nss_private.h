@@ -144,4 +144,10 @@ const char *
 nss_get_pwfield(struct nss_ctx *nctx,
                 struct sss_domain_info *dom);
 
+errno_t
+nss_get_member_domain(struct resp_ctx *rctx,
+                      struct sss_domain_info *last_dom,
+                      const char *member_name,
+                      struct sss_domain_info **_dom);
+
 #endif /* _NSS_PRIVATE_H_ */
@@ -125,9 +125,12 @@ nss_protocol_fill_members(struct sss_packet *packet,
     struct resp_ctx *rctx = nss_ctx->rctx;
     struct ldb_message_element *members[2];
     struct ldb_message_element *el;
-    struct sized_string *name;
+    struct sss_domain_info *member_dom = NULL;
     const char *member_name;
+    char *output_name;
     uint32_t num_members;
+    size_t estimate;
+    size_t name_len;
     size_t body_len;
     uint8_t *body;
     errno_t ret;
@@ -138,12 +141,29 @@ nss_protocol_fill_members(struct sss_packet *packet,
         return ENOMEM;
     }
 
+    num_members = 0;
     members[0] = nss_get_group_members(domain, msg);
     members[1] = nss_get_group_ghosts(domain, msg, group_name);
 
-    sss_packet_get_body(packet, &body, &body_len);
+    /* Output names are usually about as long as the internal ones, reserve
+     * room for all of them at once so large groups do not keep reallocating
+     * the packet while it is filled. */
+    estimate = 0;
+    for (i = 0; i < sizeof(members) / sizeof(members[0]); i++) {
+        if (members[i] == NULL) {
+            continue;
+        }
+
+        for (j = 0; j < members[i]->num_values; j++) {
+            estimate += members[i]->values[j].length + 1;
+        }
+    }
+
+    ret = sss_packet_reserve(packet, estimate);
+    if (ret != EOK) {
+        goto done;
+    }
 
-    num_members = 0;
     for (i = 0; i < sizeof(members) / sizeof(members[0]); i++) {
         el = members[i];
         if (el == NULL) {
@@ -163,20 +183,32 @@ nss_protocol_fill_members(struct sss_packet *packet,
                 }
             }
 
-            ret = sized_domain_name(tmp_ctx, rctx, member_name, &name);
+            ret = nss_get_member_domain(rctx, member_dom, member_name,
+                                        &member_dom);
+            if (ret != EOK) {
+                DEBUG(SSSDBG_OP_FAILURE, "Unable to find domain of member "
+                      "[%s] [%d]: %s\n", member_name, ret, sss_strerror(ret));
+                goto done;
+            }
+
+            ret = sss_output_fqname(tmp_ctx, member_dom, member_name,
+                                    rctx->override_space, &output_name);
             if (ret != EOK) {
                 DEBUG(SSSDBG_OP_FAILURE, "Unable to get sized name [%d]: %s\n",
                       ret, sss_strerror(ret));
                 goto done;
             }
+            name_len = strlen(output_name) + 1;
 
-            ret = sss_packet_grow(packet, name->len);
+            /* Does not reallocate as long as the estimate holds. */
+            ret = sss_packet_grow(packet, name_len);
             if (ret != EOK) {
                 goto done;
             }
 
             sss_packet_get_body(packet, &body, &body_len);
-            SAFEALIGN_SET_STRING(&body[*_rp], name->str, name->len, _rp);
+            SAFEALIGN_SET_STRING(&body[*_rp], output_name, name_len, _rp);
+            talloc_free(output_name);
 
             num_members++;
         }
@@ -36,3 +36,35 @@ nss_get_pwfield(struct nss_ctx *nctx,
 
     return nctx->pwfield;
 }
+
+/* Most members of a group come from the same domain as the previous one,
+ * so check that first before walking the whole domain list. The errors
+ * are the same as the ones of sized_domain_name(). */
+errno_t
+nss_get_member_domain(struct resp_ctx *rctx,
+                      struct sss_domain_info *last_dom,
+                      const char *member_name,
+                      struct sss_domain_info **_dom)
+{
+    struct sss_domain_info *dom;
+    const char *domname;
+
+    domname = strrchr(member_name, '@');
+    if (domname == NULL || domname == member_name || domname[1] == '\0') {
+        return ERR_WRONG_NAME_FORMAT;
+    }
+    domname++;
+
+    if (last_dom != NULL && strcasecmp(last_dom->name, domname) == 0) {
+        *_dom = last_dom;
+        return EOK;
+    }
+
+    dom = find_domain_by_name(get_domains_head(rctx->domains), domname, true);
+    if (dom == NULL) {
+        return ERR_DOMAIN_NOT_FOUND;
+    }
+
+    *_dom = dom;
+    return EOK;
+}
@@ -24,6 +24,7 @@
 #include <sys/mman.h>
 #include <fcntl.h>
 #include "util/mmap_cache.h"
+#include "util/probes.h"
 #include "responder/nss/nss_private.h"
 #include "responder/nss/nsssrv_mmap_cache.h"
 
@@ -456,6 +457,7 @@ static errno_t sss_mc_find_free_slots(struct sss_mc_ctx *mcc,
             i += MC_SIZE_TO_SLOTS(rec->len) - 1;
 
             /* finally invalidate record completely */
+            PROBE(MMAP_CACHE_EVICT, mcc->name, cur + i);
             sss_mc_invalidate_rec(mcc, rec);
         }
     }
@@ -589,6 +591,8 @@ static errno_t sss_mc_get_record(struct sss_mc_ctx **_mcc,
 
     num_slots = MC_SIZE_TO_SLOTS(rec_len);
 
+    PROBE(MMAP_CACHE_STORE, mcc->name, key->str, rec_len);
+
     old_rec = sss_mc_find_record(mcc, key);
     if (old_rec) {
         old_slots = MC_SIZE_TO_SLOTS(old_rec->len);
@@ -674,6 +678,7 @@ static errno_t sss_mmap_cache_invalidate(struct sss_mc_ctx *mcc,
         return ENOENT;
     }
 
+    PROBE(MMAP_CACHE_INVALIDATE, mcc->name, key->str);
     sss_mc_invalidate_rec(mcc, rec);
 
     return EOK;
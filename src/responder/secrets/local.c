@@ -36,6 +36,7 @@ struct local_context {
     struct sec_data master_key;
     int containers_nest_level;
     int max_secrets;
+    int max_uid_secrets;
     int max_payload_size;
 };
 
@@ -410,27 +411,274 @@ static int local_db_check_containers_nest_level(struct local_context *lctx,
     return EOK;
 }
 
+/*
+ * The number of secrets below each hive and below each per-UID scope, as well
+ * as the number of children of each container, is kept in counter entries
+ * under cn=quota, so that the quotas can be checked without searching the
+ * whole tree. The counters are updated in the same transaction as the data
+ * they describe.
+ */
+#define QUOTA_BASEDN            "cn=quota"
+#define QUOTA_SECRET_COUNT      "secretCount"
+#define QUOTA_CHILD_COUNT       "childCount"
+
+/* cn=secrets */
+#define LOCAL_HIVE_COMPS        1
+/* cn=<uidnumber>,cn=users,cn=secrets */
+#define LOCAL_UID_SCOPE_COMPS   3
+
+static int local_db_ancestor_dn(TALLOC_CTX *mem_ctx,
+                                struct ldb_dn *dn,
+                                int num_comps,
+                                struct ldb_dn **_ancestor)
+{
+    struct ldb_dn *ancestor;
+    int comps;
+
+    comps = ldb_dn_get_comp_num(dn);
+    if (comps < num_comps) {
+        return ENOENT;
+    }
+
+    ancestor = ldb_dn_copy(mem_ctx, dn);
+    if (!ancestor) return ENOMEM;
+
+    if (!ldb_dn_remove_child_components(ancestor, comps - num_comps)) {
+        talloc_free(ancestor);
+        return EFAULT;
+    }
+
+    *_ancestor = ancestor;
+    return EOK;
+}
+
+static struct ldb_dn *local_db_counter_dn(TALLOC_CTX *mem_ctx,
+                                          struct ldb_dn *dn)
+{
+    struct ldb_dn *counter_dn;
+
+    counter_dn = ldb_dn_copy(mem_ctx, dn);
+    if (!counter_dn) return NULL;
+
+    if (!ldb_dn_add_base_fmt(counter_dn, "%s", QUOTA_BASEDN)) {
+        talloc_free(counter_dn);
+        return NULL;
+    }
+
+    return counter_dn;
+}
+
+static int local_db_counter_get(TALLOC_CTX *mem_ctx,
+                                struct local_context *lctx,
+                                struct ldb_dn *dn,
+                                const char *attr,
+                                int64_t *_value)
+{
+    TALLOC_CTX *tmp_ctx;
+    const char *attrs[] = { attr, NULL };
+    struct ldb_result *res;
+    struct ldb_dn *counter_dn;
+    int ret;
+
+    tmp_ctx = talloc_new(mem_ctx);
+    if (!tmp_ctx) return ENOMEM;
+
+    counter_dn = local_db_counter_dn(tmp_ctx, dn);
+    if (!counter_dn) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = ldb_search(lctx->ldb, tmp_ctx, &res, counter_dn, LDB_SCOPE_BASE,
+                     attrs, NULL);
+    if (ret == LDB_ERR_NO_SUCH_OBJECT) {
+        *_value = 0;
+        ret = EOK;
+        goto done;
+    } else if (ret != LDB_SUCCESS) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "ldb_search returned %d: %s\n", ret, ldb_strerror(ret));
+        ret = EIO;
+        goto done;
+    }
+
+    *_value = res->count == 1 ? ldb_msg_find_attr_as_int64(res->msgs[0],
+                                                           attr, 0)
+                              : 0;
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static int local_db_counter_add(TALLOC_CTX *mem_ctx,
+                                struct local_context *lctx,
+                                struct ldb_dn *dn,
+                                const char *attr,
+                                int delta)
+{
+    TALLOC_CTX *tmp_ctx;
+    const char *attrs[] = { attr, NULL };
+    struct ldb_result *res;
+    struct ldb_message *msg;
+    int64_t value;
+    int ret;
+
+    tmp_ctx = talloc_new(mem_ctx);
+    if (!tmp_ctx) return ENOMEM;
+
+    msg = ldb_msg_new(tmp_ctx);
+    if (!msg) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    msg->dn = local_db_counter_dn(msg, dn);
+    if (!msg->dn) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = ldb_search(lctx->ldb, tmp_ctx, &res, msg->dn, LDB_SCOPE_BASE,
+                     attrs, NULL);
+    if (ret != LDB_SUCCESS && ret != LDB_ERR_NO_SUCH_OBJECT) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "ldb_search returned %d: %s\n", ret, ldb_strerror(ret));
+        ret = EIO;
+        goto done;
+    }
+
+    if (ret == LDB_ERR_NO_SUCH_OBJECT || res->count == 0) {
+        if (delta <= 0) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "No %s counter for [%s]\n", attr, ldb_dn_get_linearized(dn));
+            ret = EOK;
+            goto done;
+        }
+
+        ret = ldb_msg_add_fmt(msg, attr, "%d", delta);
+        if (ret != LDB_SUCCESS) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        ret = ldb_add(lctx->ldb, msg);
+    } else {
+        value = ldb_msg_find_attr_as_int64(res->msgs[0], attr, 0) + delta;
+        if (value < 0) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "The %s counter for [%s] would drop below zero\n",
+                  attr, ldb_dn_get_linearized(dn));
+            value = 0;
+        }
+
+        ret = ldb_msg_add_empty(msg, attr, LDB_FLAG_MOD_REPLACE, NULL);
+        if (ret != LDB_SUCCESS) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        ret = ldb_msg_add_fmt(msg, attr, "%"PRId64, value);
+        if (ret != LDB_SUCCESS) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        ret = ldb_modify(lctx->ldb, msg);
+    }
+
+    if (ret != LDB_SUCCESS) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Failed to update the %s counter of [%s]: [%d]: %s\n",
+              attr, ldb_dn_get_linearized(dn), ret, ldb_strerror(ret));
+        ret = EIO;
+        goto done;
+    }
+
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+/* Accounts for an entry at dn being added (delta 1) or removed (delta -1) */
+static int local_db_account_entry(TALLOC_CTX *mem_ctx,
+                                  struct local_context *lctx,
+                                  struct ldb_dn *dn,
+                                  bool is_secret,
+                                  int delta)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct ldb_dn *scope_dn;
+    int comps;
+    int ret;
+
+    tmp_ctx = talloc_new(mem_ctx);
+    if (!tmp_ctx) return ENOMEM;
+
+    comps = ldb_dn_get_comp_num(dn);
+
+    if (is_secret) {
+        ret = local_db_ancestor_dn(tmp_ctx, dn, LOCAL_HIVE_COMPS, &scope_dn);
+        if (ret != EOK) goto done;
+
+        ret = local_db_counter_add(tmp_ctx, lctx, scope_dn,
+                                   QUOTA_SECRET_COUNT, delta);
+        if (ret != EOK) goto done;
+
+        if (comps > LOCAL_UID_SCOPE_COMPS) {
+            ret = local_db_ancestor_dn(tmp_ctx, dn, LOCAL_UID_SCOPE_COMPS,
+                                       &scope_dn);
+            if (ret != EOK) goto done;
+
+            ret = local_db_counter_add(tmp_ctx, lctx, scope_dn,
+                                       QUOTA_SECRET_COUNT, delta);
+            if (ret != EOK) goto done;
+        }
+    }
+
+    /* only real containers keep track of their children, the synthetic
+     * ones that constitute the base path do not */
+    if (comps - 1 > LOCAL_UID_SCOPE_COMPS) {
+        ret = local_db_ancestor_dn(tmp_ctx, dn, comps - 1, &scope_dn);
+        if (ret != EOK) goto done;
+
+        ret = local_db_counter_add(tmp_ctx, lctx, scope_dn,
+                                   QUOTA_CHILD_COUNT, delta);
+        if (ret != EOK) goto done;
+    }
+
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
 static int local_db_check_number_of_secrets(TALLOC_CTX *mem_ctx,
-                                            struct local_context *lctx)
+                                            struct local_context *lctx,
+                                            struct ldb_dn *leaf_dn)
 {
     TALLOC_CTX *tmp_ctx;
-    static const char *attrs[] = { NULL };
-    struct ldb_result *res = NULL;
     struct ldb_dn *dn;
+    int64_t count;
     int ret;
 
     tmp_ctx = talloc_new(mem_ctx);
     if (!tmp_ctx) return ENOMEM;
 
-    dn = ldb_dn_new(tmp_ctx, lctx->ldb, "cn=secrets");
+    dn = ldb_dn_new(tmp_ctx, lctx->ldb, SECRETS_BASEDN);
     if (!dn) {
         ret = ENOMEM;
         goto done;
     }
 
-    ret = ldb_search(lctx->ldb, tmp_ctx, &res, dn, LDB_SCOPE_SUBTREE,
-                     attrs, LOCAL_SIMPLE_FILTER);
-    if (res->count >= lctx->max_secrets) {
+    ret = local_db_counter_get(tmp_ctx, lctx, dn, QUOTA_SECRET_COUNT, &count);
+    if (ret != EOK) goto done;
+
+    if (count >= lctx->max_secrets) {
         DEBUG(SSSDBG_OP_FAILURE,
               "Cannot store any more secrets as the maximum allowed limit (%d) "
               "has been reached\n", lctx->max_secrets);
@@ -439,6 +687,26 @@ static int local_db_check_number_of_secrets(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
+    if (lctx->max_uid_secrets > 0) {
+        ret = local_db_ancestor_dn(tmp_ctx, leaf_dn, LOCAL_UID_SCOPE_COMPS,
+                                   &dn);
+        if (ret != EOK) goto done;
+
+        ret = local_db_counter_get(tmp_ctx, lctx, dn, QUOTA_SECRET_COUNT,
+                                   &count);
+        if (ret != EOK) goto done;
+
+        if (count >= lctx->max_uid_secrets) {
+            DEBUG(SSSDBG_OP_FAILURE,
+                  "Cannot store any more secrets for [%s] as the maximum "
+                  "allowed limit (%d) has been reached\n",
+                  ldb_dn_get_linearized(dn), lctx->max_uid_secrets);
+
+            ret = ERR_SEC_INVALID_TOO_MANY_SECRETS;
+            goto done;
+        }
+    }
+
     ret = EOK;
 
 done:
@@ -446,6 +714,120 @@ done:
     return ret;
 }
 
+/* Databases created before the counters were introduced, or by an older
+ * version, have no cn=quota entry; count what is stored there once. */
+static int local_db_init_counters(TALLOC_CTX *mem_ctx,
+                                  struct local_context *lctx)
+{
+    TALLOC_CTX *tmp_ctx;
+    static const char *attrs[] = { "type", NULL };
+    const char *hives[] = { SECRETS_BASEDN, KCM_BASEDN, NULL };
+    struct ldb_message *msg;
+    struct ldb_result *res;
+    struct ldb_dn *dn;
+    const char *type;
+    bool in_transaction = false;
+    int ret;
+
+    tmp_ctx = talloc_new(mem_ctx);
+    if (!tmp_ctx) return ENOMEM;
+
+    dn = ldb_dn_new(tmp_ctx, lctx->ldb, QUOTA_BASEDN);
+    if (!dn) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = ldb_search(lctx->ldb, tmp_ctx, &res, dn, LDB_SCOPE_BASE,
+                     attrs, NULL);
+    if (ret == LDB_SUCCESS && res->count == 1) {
+        ret = EOK;
+        goto done;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Initializing the quota counters\n");
+
+    ret = ldb_transaction_start(lctx->ldb);
+    if (ret != LDB_SUCCESS) {
+        ret = EIO;
+        goto done;
+    }
+    in_transaction = true;
+
+    for (int h = 0; hives[h] != NULL; h++) {
+        dn = ldb_dn_new(tmp_ctx, lctx->ldb, hives[h]);
+        if (!dn) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        ret = ldb_search(lctx->ldb, tmp_ctx, &res, dn, LDB_SCOPE_SUBTREE,
+                         attrs, "(|%s%s)",
+                         LOCAL_SIMPLE_FILTER, LOCAL_CONTAINER_FILTER);
+        if (ret == LDB_ERR_NO_SUCH_OBJECT) {
+            continue;
+        } else if (ret != LDB_SUCCESS) {
+            DEBUG(SSSDBG_OP_FAILURE,
+                  "ldb_search returned %d: %s\n", ret, ldb_strerror(ret));
+            ret = EIO;
+            goto done;
+        }
+
+        for (unsigned i = 0; i < res->count; i++) {
+            type = ldb_msg_find_attr_as_string(res->msgs[i], "type", NULL);
+
+            ret = local_db_account_entry(tmp_ctx, lctx, res->msgs[i]->dn,
+                                         type != NULL
+                                            && strcmp(type, "simple") == 0,
+                                         1);
+            if (ret != EOK) goto done;
+        }
+    }
+
+    msg = ldb_msg_new(tmp_ctx);
+    if (!msg) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    msg->dn = ldb_dn_new(msg, lctx->ldb, QUOTA_BASEDN);
+    if (!msg->dn) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = ldb_msg_add_string(msg, "type", "quota");
+    if (ret != LDB_SUCCESS) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = ldb_add(lctx->ldb, msg);
+    if (ret != LDB_SUCCESS) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Failed to add [%s]: [%d]: %s\n",
+              QUOTA_BASEDN, ret, ldb_strerror(ret));
+        ret = EIO;
+        goto done;
+    }
+
+    ret = ldb_transaction_commit(lctx->ldb);
+    if (ret != LDB_SUCCESS) {
+        ret = EIO;
+        goto done;
+    }
+    in_transaction = false;
+
+    ret = EOK;
+
+done:
+    if (in_transaction) {
+        ldb_transaction_cancel(lctx->ldb);
+    }
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
 static int local_check_max_payload_size(struct local_context *lctx,
                                         int payload_size)
 {
@@ -475,6 +857,7 @@ static int local_db_put_simple(TALLOC_CTX *mem_ctx,
     struct ldb_message *msg;
     const char *enctype = "masterkey";
     char *enc_secret;
+    bool in_transaction = false;
     int ret;
 
     DEBUG(SSSDBG_TRACE_FUNC, "Adding a secret to [%s]\n", lc_req->path);
@@ -486,6 +869,16 @@ static int local_db_put_simple(TALLOC_CTX *mem_ctx,
     }
     msg->dn = lc_req->basedn;
 
+    ret = ldb_transaction_start(lctx->ldb);
+    if (ret != LDB_SUCCESS) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Failed to start a transaction [%d]: %s\n",
+              ret, ldb_strerror(ret));
+        ret = EIO;
+        goto done;
+    }
+    in_transaction = true;
+
     /* make sure containers exist */
     ret = local_db_check_containers(msg, lctx, msg->dn);
     if (ret != EOK) {
@@ -495,7 +888,7 @@ static int local_db_put_simple(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
-    ret = local_db_check_number_of_secrets(msg, lctx);
+    ret = local_db_check_number_of_secrets(msg, lctx, msg->dn);
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE,
               "local_db_check_number_of_secrets failed [%d]: %s\n",
@@ -566,8 +959,24 @@ static int local_db_put_simple(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
+    ret = local_db_account_entry(msg, lctx, msg->dn, true, 1);
+    if (ret != EOK) goto done;
+
+    ret = ldb_transaction_commit(lctx->ldb);
+    if (ret != LDB_SUCCESS) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Failed to commit the transaction [%d]: %s\n",
+              ret, ldb_strerror(ret));
+        ret = EIO;
+        goto done;
+    }
+    in_transaction = false;
+
     ret = EOK;
 done:
+    if (in_transaction) {
+        ldb_transaction_cancel(lctx->ldb);
+    }
     talloc_free(msg);
     return ret;
 }
@@ -577,8 +986,13 @@ static int local_db_delete(TALLOC_CTX *mem_ctx,
                            struct local_db_req *lc_req)
 {
     TALLOC_CTX *tmp_ctx;
-    static const char *attrs[] = { NULL };
+    static const char *attrs[] = { "type", NULL };
     struct ldb_result *res;
+    struct ldb_dn *counter_dn;
+    const char *type;
+    bool is_container;
+    bool in_transaction = false;
+    int64_t children;
     int ret;
 
     DEBUG(SSSDBG_TRACE_FUNC, "Removing a secret from [%s]\n", lc_req->path);
@@ -586,30 +1000,44 @@ static int local_db_delete(TALLOC_CTX *mem_ctx,
     tmp_ctx = talloc_new(mem_ctx);
     if (!tmp_ctx) return ENOMEM;
 
+    ret = ldb_transaction_start(lctx->ldb);
+    if (ret != LDB_SUCCESS) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Failed to start a transaction [%d]: %s\n",
+              ret, ldb_strerror(ret));
+        ret = EIO;
+        goto done;
+    }
+    in_transaction = true;
+
     DEBUG(SSSDBG_TRACE_INTERNAL,
-          "Searching for [%s] at [%s] with scope=base\n",
-          LOCAL_CONTAINER_FILTER, ldb_dn_get_linearized(lc_req->basedn));
+          "Searching for [%s] with scope=base\n",
+          ldb_dn_get_linearized(lc_req->basedn));
 
     ret = ldb_search(lctx->ldb, tmp_ctx, &res, lc_req->basedn, LDB_SCOPE_BASE,
-                     attrs, LOCAL_CONTAINER_FILTER);
+                     attrs, NULL);
     if (ret != EOK) {
         DEBUG(SSSDBG_TRACE_LIBS,
               "ldb_search returned %d: %s\n", ret, ldb_strerror(ret));
+        ret = sysdb_error_to_errno(ret);
         goto done;
     }
 
-    if (res->count == 1) {
-        DEBUG(SSSDBG_TRACE_INTERNAL,
-              "Searching for children of [%s]\n", ldb_dn_get_linearized(lc_req->basedn));
-        ret = ldb_search(lctx->ldb, tmp_ctx, &res, lc_req->basedn, LDB_SCOPE_ONELEVEL,
-                         attrs, NULL);
-        if (ret != EOK) {
-            DEBUG(SSSDBG_TRACE_LIBS,
-                  "ldb_search returned %d: %s\n", ret, ldb_strerror(ret));
-            goto done;
-        }
+    if (res->count != 1) {
+        ret = ENOENT;
+        goto done;
+    }
+
+    type = ldb_msg_find_attr_as_string(res->msgs[0], "type", NULL);
+    is_container = type != NULL && strcmp(type, "container") == 0;
 
-        if (res->count > 0) {
+    if (is_container) {
+        /* the number of children is tracked by the quota counters */
+        ret = local_db_counter_get(tmp_ctx, lctx, lc_req->basedn,
+                                   QUOTA_CHILD_COUNT, &children);
+        if (ret != EOK) goto done;
+
+        if (children > 0) {
             ret = EEXIST;
             DEBUG(SSSDBG_OP_FAILURE,
                   "Failed to remove '%s': Container is not empty\n",
@@ -623,11 +1051,49 @@ static int local_db_delete(TALLOC_CTX *mem_ctx,
     if (ret != EOK) {
         DEBUG(SSSDBG_TRACE_LIBS,
               "ldb_delete returned %d: %s\n", ret, ldb_strerror(ret));
-        /* fallthrough */
+        ret = sysdb_error_to_errno(ret);
+        goto done;
     }
-    ret = sysdb_error_to_errno(ret);
+
+    ret = local_db_account_entry(tmp_ctx, lctx, lc_req->basedn,
+                                 type != NULL && strcmp(type, "simple") == 0,
+                                 -1);
+    if (ret != EOK) goto done;
+
+    if (is_container) {
+        counter_dn = local_db_counter_dn(tmp_ctx, lc_req->basedn);
+        if (!counter_dn) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        ret = ldb_delete(lctx->ldb, counter_dn);
+        if (ret != LDB_SUCCESS && ret != LDB_ERR_NO_SUCH_OBJECT) {
+            DEBUG(SSSDBG_OP_FAILURE,
+                  "Failed to remove the counters of [%s]: [%d]: %s\n",
+                  ldb_dn_get_linearized(lc_req->basedn),
+                  ret, ldb_strerror(ret));
+            ret = EIO;
+            goto done;
+        }
+    }
+
+    ret = ldb_transaction_commit(lctx->ldb);
+    if (ret != LDB_SUCCESS) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Failed to commit the transaction [%d]: %s\n",
+              ret, ldb_strerror(ret));
+        ret = EIO;
+        goto done;
+    }
+    in_transaction = false;
+
+    ret = EOK;
 
 done:
+    if (in_transaction) {
+        ldb_transaction_cancel(lctx->ldb);
+    }
     talloc_free(tmp_ctx);
     return ret;
 }
@@ -637,6 +1103,7 @@ static int local_db_create(TALLOC_CTX *mem_ctx,
                            struct local_db_req *lc_req)
 {
     struct ldb_message *msg;
+    bool in_transaction = false;
     int ret;
 
     DEBUG(SSSDBG_TRACE_FUNC, "Creating a container at [%s]\n", lc_req->path);
@@ -648,6 +1115,16 @@ static int local_db_create(TALLOC_CTX *mem_ctx,
     }
     msg->dn = lc_req->basedn;
 
+    ret = ldb_transaction_start(lctx->ldb);
+    if (ret != LDB_SUCCESS) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Failed to start a transaction [%d]: %s\n",
+              ret, ldb_strerror(ret));
+        ret = EIO;
+        goto done;
+    }
+    in_transaction = true;
+
     /* make sure containers exist */
     ret = local_db_check_containers(msg, lctx, msg->dn);
     if (ret != EOK) {
@@ -691,9 +1168,25 @@ static int local_db_create(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
+    ret = local_db_account_entry(msg, lctx, msg->dn, false, 1);
+    if (ret != EOK) goto done;
+
+    ret = ldb_transaction_commit(lctx->ldb);
+    if (ret != LDB_SUCCESS) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Failed to commit the transaction [%d]: %s\n",
+              ret, ldb_strerror(ret));
+        ret = EIO;
+        goto done;
+    }
+    in_transaction = false;
+
     ret = EOK;
 
 done:
+    if (in_transaction) {
+        ldb_transaction_cancel(lctx->ldb);
+    }
     talloc_free(msg);
     return ret;
 }
@@ -1021,8 +1514,17 @@ int local_secrets_provider_handle(struct sec_ctx *sctx,
 
     lctx->containers_nest_level = sctx->containers_nest_level;
     lctx->max_secrets = sctx->max_secrets;
+    lctx->max_uid_secrets = sctx->max_uid_secrets;
     lctx->max_payload_size = sctx->max_payload_size;
 
+    ret = local_db_init_counters(lctx, lctx);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Cannot initialize the quota counters [%d]: %s\n",
+              ret, sss_strerror(ret));
+        return ret;
+    }
+
     lctx->master_key.data = talloc_size(lctx, MKEY_SIZE);
     if (!lctx->master_key.data) return ENOMEM;
     lctx->master_key.length = MKEY_SIZE;
@@ -33,6 +33,10 @@
 typedef int errno_t;
 #endif
 
+/* number of times a lookup is restarted when the records it is reading are
+ * modified concurrently by the responder */
+#define SSS_NSS_MC_READ_RETRIES 5
+
 enum sss_mc_state {
     UNINITIALIZED = 0,
     INITIALIZED,
@@ -62,8 +66,12 @@ errno_t sss_nss_mc_get_ctx(const char *name, struct sss_cli_mc_ctx *ctx);
 errno_t sss_nss_check_header(struct sss_cli_mc_ctx *ctx);
 uint32_t sss_nss_mc_hash(struct sss_cli_mc_ctx *ctx,
                          const char *key, size_t len);
-errno_t sss_nss_mc_get_record(struct sss_cli_mc_ctx *ctx,
-                              uint32_t slot, struct sss_mc_rec **_rec);
+errno_t sss_nss_mc_get_record(struct sss_cli_mc_ctx *ctx, uint32_t slot,
+                              size_t data_size,
+                              struct sss_mc_rec **_rec, uint32_t *_barrier,
+                              uint32_t *_rec_len);
+bool sss_nss_mc_check_record(struct sss_mc_rec *rec, uint32_t barrier,
+                             uint32_t rec_len);
 errno_t sss_nss_str_ptr_from_buffer(char **str, void **cookie,
                                     char *buf, size_t len);
 uint32_t sss_nss_mc_next_slot_with_hash(struct sss_mc_rec *rec,
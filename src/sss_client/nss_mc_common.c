@@ -254,74 +254,80 @@ uint32_t sss_nss_mc_hash(struct sss_cli_mc_ctx *ctx,
     return murmurhash3(key, len, ctx->seed) % MC_HT_ELEMS(ctx->ht_size);
 }
 
-errno_t sss_nss_mc_get_record(struct sss_cli_mc_ctx *ctx,
-                              uint32_t slot, struct sss_mc_rec **_rec)
+/*
+ * Records are read in place, seqlock style: sss_nss_mc_get_record() waits
+ * for the record header to be consistent and returns a pointer into the
+ * mmapped data table together with the barrier value and the record length
+ * observed at that time. Callers may then inspect the record directly but
+ * must only trust what they read (and anything they copied out of it) after
+ * sss_nss_mc_check_record() confirmed that neither the barriers nor the
+ * record length moved meanwhile.
+ * The returned length is always within the data table and large enough for
+ * the data_size bytes of fixed fields of the record data, so neither those
+ * fields nor offsets bounded by the length read outside of the mapping even
+ * if the record is rewritten concurrently.
+ */
+errno_t sss_nss_mc_get_record(struct sss_cli_mc_ctx *ctx, uint32_t slot,
+                              size_t data_size,
+                              struct sss_mc_rec **_rec, uint32_t *_barrier,
+                              uint32_t *_rec_len)
 {
     struct sss_mc_rec *rec;
-    struct sss_mc_rec *copy_rec = NULL;
-    size_t buf_size = 0;
-    size_t rec_len;
+    uint32_t rec_len;
     uint32_t b1;
     uint32_t b2;
-    bool copy_ok;
     int count;
-    int ret;
+
+    rec = MC_SLOT_TO_PTR(ctx->data_table, slot, struct sss_mc_rec);
 
     /* try max 5 times */
     for (count = 5; count > 0; count--) {
-        rec = MC_SLOT_TO_PTR(ctx->data_table, slot, struct sss_mc_rec);
-
         /* fetch record length */
         b1 = rec->b1;
         __sync_synchronize();
         rec_len = rec->len;
         __sync_synchronize();
         b2 = rec->b2;
-        if (!MC_VALID_BARRIER(b1) || b1 != b2) {
-            /* record is inconsistent, retry */
-            continue;
-        }
-
-        if (!MC_CHECK_RECORD_LENGTH(ctx, rec)) {
-            /* record has invalid length */
-            free(copy_rec);
-            return EINVAL;
-        }
-
-        if (rec_len > buf_size) {
-            free(copy_rec);
-            copy_rec = malloc(rec_len);
-            if (!copy_rec) {
-                ret = ENOMEM;
-                goto done;
-            }
-            buf_size = rec_len;
-        }
-        /* we cannot access data directly, we must copy data and then
-         * access the copy */
-        MEMCPY_WITH_BARRIERS(copy_ok, copy_rec, rec, rec_len);
-
-        /* we must check data is consistent again after the copy */
-        if (copy_ok && b1 == copy_rec->b2) {
-            /* record is consistent, use it */
+        if (MC_VALID_BARRIER(b1) && b1 == b2) {
             break;
         }
+        /* record is inconsistent, retry */
     }
     if (count == 0) {
         /* couldn't successfully read header we have to give up */
-        ret = EIO;
-        goto done;
+        return EIO;
     }
 
-    *_rec = copy_rec;
-    ret = 0;
-
-done:
-    if (ret) {
-        free(copy_rec);
-        *_rec = NULL;
+    if (rec_len < MC_HEADER_SIZE
+            || rec_len < sizeof(struct sss_mc_rec) + data_size
+            || rec_len == MC_INVALID_VAL32
+            || rec_len > ctx->dt_size - MC_PTR_DIFF(rec, ctx->data_table)) {
+        /* record has invalid length */
+        return EINVAL;
     }
-    return ret;
+
+    *_rec = rec;
+    *_barrier = b1;
+    *_rec_len = rec_len;
+    return 0;
+}
+
+bool sss_nss_mc_check_record(struct sss_mc_rec *rec, uint32_t barrier,
+                             uint32_t rec_len)
+{
+    uint32_t b1;
+    uint32_t len;
+
+    /* make sure all reads from the record completed before
+     * checking it was not modified meanwhile */
+    __sync_synchronize();
+    b1 = rec->b1;
+    len = rec->len;
+    __sync_synchronize();
+
+    /* the writer raises b2 before touching the record and lowers b1
+     * after it is done, b2 is read last */
+    return b1 == barrier && len == rec_len && rec->b2 == barrier;
 }
 
 /*
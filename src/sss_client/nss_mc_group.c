@@ -33,39 +33,61 @@ struct sss_cli_mc_ctx gr_mc_ctx = { UNINITIALIZED, -1, 0, NULL, 0, NULL, 0,
                                     NULL, 0, 0 };
 
 static errno_t sss_nss_mc_parse_result(struct sss_mc_rec *rec,
+                                       uint32_t barrier, uint32_t rec_len,
                                        struct group *result,
                                        char *buffer, size_t buflen)
 {
+    const size_t strs_offset = offsetof(struct sss_mc_grp_data, strs);
     struct sss_mc_grp_data *data;
     time_t expire;
+    uint32_t gid;
+    uint32_t members;
+    uint32_t strs_len;
     void *cookie;
     char *membuf;
     size_t memsize;
     int ret;
     int i;
 
-    /* additional checks before filling result*/
+    data = (struct sss_mc_grp_data *)rec->data;
+
+    /* snapshot the fixed fields, they can be trusted only once we know
+     * the record was not modified while reading them */
     expire = rec->expire;
+    gid = data->gid;
+    members = data->members;
+    strs_len = data->strs_len;
+    if (!sss_nss_mc_check_record(rec, barrier, rec_len)) {
+        return EAGAIN;
+    }
+
+    /* additional checks before filling result*/
     if (expire < time(NULL)) {
         /* entry is now invalid */
         return EINVAL;
     }
 
-    data = (struct sss_mc_grp_data *)rec->data;
+    /* all strings must be within the record */
+    if (strs_len > rec_len - sizeof(struct sss_mc_rec) - strs_offset) {
+        return EINVAL;
+    }
 
-    memsize = (data->members + 1) * sizeof(char *);
-    if (data->strs_len + memsize > buflen) {
+    memsize = (members + 1) * sizeof(char *);
+    if (strs_len + memsize > buflen) {
         return ERANGE;
     }
 
     /* fill in glibc provided structs */
 
-    /* copy in buffer */
+    /* copy in buffer straight from the mmapped record */
     membuf = buffer + memsize;
-    memcpy(membuf, data->strs, data->strs_len);
+    memcpy(membuf, data->strs, strs_len);
+    if (!sss_nss_mc_check_record(rec, barrier, rec_len)) {
+        return EAGAIN;
+    }
 
     /* fill in group */
-    result->gr_gid = data->gid;
+    result->gr_gid = gid;
 
     /* The address &buffer[0] must be aligned to sizeof(char *) */
     if (!IS_ALIGNED(buffer, char *)) {
@@ -74,23 +96,23 @@ static errno_t sss_nss_mc_parse_result(struct sss_mc_rec *rec,
     }
 
     result->gr_mem = DISCARD_ALIGN(buffer, char **);
-    result->gr_mem[data->members] = NULL;
+    result->gr_mem[members] = NULL;
 
     cookie = NULL;
     ret = sss_nss_str_ptr_from_buffer(&result->gr_name, &cookie,
-                                      membuf, data->strs_len);
+                                      membuf, strs_len);
     if (ret) {
         return ret;
     }
     ret = sss_nss_str_ptr_from_buffer(&result->gr_passwd, &cookie,
-                                      membuf, data->strs_len);
+                                      membuf, strs_len);
     if (ret) {
         return ret;
     }
 
-    for (i = 0; i < data->members; i++) {
+    for (i = 0; i < members; i++) {
         ret = sss_nss_str_ptr_from_buffer(&result->gr_mem[i], &cookie,
-                                          membuf, data->strs_len);
+                                          membuf, strs_len);
         if (ret) {
             return ret;
         }
@@ -109,8 +131,16 @@ errno_t sss_nss_mc_getgrnam(const char *name, size_t name_len,
     struct sss_mc_rec *rec = NULL;
     struct sss_mc_grp_data *data;
     char *rec_name;
+    uint32_t rec_len;
+    uint32_t barrier;
+    uint32_t name_ptr;
+    uint32_t strs_len;
     uint32_t hash;
     uint32_t slot;
+    uint32_t next_slot;
+    bool corrupted;
+    bool match;
+    int attempts = 0;
     int ret;
     const size_t strs_offset = offsetof(struct sss_mc_grp_data, strs);
     size_t data_size;
@@ -125,48 +155,63 @@ errno_t sss_nss_mc_getgrnam(const char *name, size_t name_len,
 
     /* hashes are calculated including the NULL terminator */
     hash = sss_nss_mc_hash(&gr_mc_ctx, name, name_len + 1);
+
+restart:
+    if (attempts++ == SSS_NSS_MC_READ_RETRIES) {
+        ret = EIO;
+        goto done;
+    }
     slot = gr_mc_ctx.hash_table[hash];
 
     /* If slot is not within the bounds of mmaped region and
      * it's value is not MC_INVALID_VAL, then the cache is
      * probbably corrupted. */
     while (MC_SLOT_WITHIN_BOUNDS(slot, data_size)) {
-        /* free record from previous iteration */
-        free(rec);
-        rec = NULL;
-
-        ret = sss_nss_mc_get_record(&gr_mc_ctx, slot, &rec);
+        ret = sss_nss_mc_get_record(&gr_mc_ctx, slot,
+                                    sizeof(struct sss_mc_grp_data),
+                                    &rec, &barrier, &rec_len);
         if (ret) {
             goto done;
         }
 
-        /* check record matches what we are searching for */
-        if (hash != rec->hash1) {
-            /* if name hash does not match we can skip this immediately */
-            slot = sss_nss_mc_next_slot_with_hash(rec, hash);
-            continue;
+        /* check record matches what we are searching for,
+         * if name hash does not match we can skip this immediately */
+        corrupted = false;
+        match = false;
+        if (hash == rec->hash1) {
+            data = (struct sss_mc_grp_data *)rec->data;
+            name_ptr = data->name;
+            strs_len = data->strs_len;
+            /* Integrity check
+             * - name_len cannot be longer than all strings
+             * - data->name cannot point outside strings
+             * - all strings must be within the record */
+            if (name_len > strs_len
+                || (name_ptr + name_len) >= (strs_offset + strs_len)
+                || strs_len > rec_len - sizeof(struct sss_mc_rec)
+                                      - strs_offset) {
+                corrupted = true;
+            } else {
+                /* compare in place, including the NULL terminator */
+                rec_name = (char *)data + name_ptr;
+                match = (memcmp(name, rec_name, name_len + 1) == 0);
+            }
         }
+        next_slot = sss_nss_mc_next_slot_with_hash(rec, hash);
 
-        data = (struct sss_mc_grp_data *)rec->data;
-        /* Integrity check
-         * - name_len cannot be longer than all strings
-         * - data->name cannot point outside strings
-         * - all strings must be within copy of record
-         * - size of record must be lower that data table size */
-        if (name_len > data->strs_len
-            || (data->name + name_len) > (strs_offset + data->strs_len)
-            || data->strs_len > rec->len
-            || rec->len > data_size) {
+        if (!sss_nss_mc_check_record(rec, barrier, rec_len)) {
+            /* the record changed while we were looking at it */
+            goto restart;
+        }
+        if (corrupted) {
             ret = ENOENT;
             goto done;
         }
-
-        rec_name = (char *)data + data->name;
-        if (strcmp(name, rec_name) == 0) {
+        if (match) {
             break;
         }
 
-        slot = sss_nss_mc_next_slot_with_hash(rec, hash);
+        slot = next_slot;
     }
 
     if (!MC_SLOT_WITHIN_BOUNDS(slot, data_size)) {
@@ -174,10 +219,13 @@ errno_t sss_nss_mc_getgrnam(const char *name, size_t name_len,
         goto done;
     }
 
-    ret = sss_nss_mc_parse_result(rec, result, buffer, buflen);
+    ret = sss_nss_mc_parse_result(rec, barrier, rec_len,
+                                  result, buffer, buflen);
+    if (ret == EAGAIN) {
+        goto restart;
+    }
 
 done:
-    free(rec);
     __sync_sub_and_fetch(&gr_mc_ctx.active_threads, 1);
     return ret;
 }
@@ -189,8 +237,13 @@ errno_t sss_nss_mc_getgrgid(gid_t gid,
     struct sss_mc_rec *rec = NULL;
     struct sss_mc_grp_data *data;
     char gidstr[11];
+    uint32_t rec_len;
+    uint32_t barrier;
     uint32_t hash;
     uint32_t slot;
+    uint32_t next_slot;
+    bool match;
+    int attempts = 0;
     int len;
     int ret;
 
@@ -207,34 +260,43 @@ errno_t sss_nss_mc_getgrgid(gid_t gid,
 
     /* hashes are calculated including the NULL terminator */
     hash = sss_nss_mc_hash(&gr_mc_ctx, gidstr, len+1);
+
+restart:
+    if (attempts++ == SSS_NSS_MC_READ_RETRIES) {
+        ret = EIO;
+        goto done;
+    }
     slot = gr_mc_ctx.hash_table[hash];
 
     /* If slot is not within the bounds of mmaped region and
      * it's value is not MC_INVALID_VAL, then the cache is
      * probbably corrupted. */
     while (MC_SLOT_WITHIN_BOUNDS(slot, gr_mc_ctx.dt_size)) {
-        /* free record from previous iteration */
-        free(rec);
-        rec = NULL;
-
-        ret = sss_nss_mc_get_record(&gr_mc_ctx, slot, &rec);
+        ret = sss_nss_mc_get_record(&gr_mc_ctx, slot,
+                                    sizeof(struct sss_mc_grp_data),
+                                    &rec, &barrier, &rec_len);
         if (ret) {
             goto done;
         }
 
-        /* check record matches what we are searching for */
-        if (hash != rec->hash2) {
-            /* if uid hash does not match we can skip this immediately */
-            slot = sss_nss_mc_next_slot_with_hash(rec, hash);
-            continue;
+        /* check record matches what we are searching for,
+         * if uid hash does not match we can skip this immediately */
+        match = false;
+        if (hash == rec->hash2) {
+            data = (struct sss_mc_grp_data *)rec->data;
+            match = (gid == data->gid);
         }
+        next_slot = sss_nss_mc_next_slot_with_hash(rec, hash);
 
-        data = (struct sss_mc_grp_data *)rec->data;
-        if (gid == data->gid) {
+        if (!sss_nss_mc_check_record(rec, barrier, rec_len)) {
+            /* the record changed while we were looking at it */
+            goto restart;
+        }
+        if (match) {
             break;
         }
 
-        slot = sss_nss_mc_next_slot_with_hash(rec, hash);
+        slot = next_slot;
     }
 
     if (!MC_SLOT_WITHIN_BOUNDS(slot, gr_mc_ctx.dt_size)) {
@@ -242,11 +304,13 @@ errno_t sss_nss_mc_getgrgid(gid_t gid,
         goto done;
     }
 
-    ret = sss_nss_mc_parse_result(rec, result, buffer, buflen);
+    ret = sss_nss_mc_parse_result(rec, barrier, rec_len,
+                                  result, buffer, buflen);
+    if (ret == EAGAIN) {
+        goto restart;
+    }
 
 done:
-    free(rec);
     __sync_sub_and_fetch(&gr_mc_ctx.active_threads, 1);
     return ret;
 }
-
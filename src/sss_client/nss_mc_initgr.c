@@ -36,24 +36,40 @@ struct sss_cli_mc_ctx initgr_mc_ctx = { UNINITIALIZED, -1, 0, NULL, 0, NULL, 0,
                                         NULL, 0, 0 };
 
 static errno_t sss_nss_mc_parse_result(struct sss_mc_rec *rec,
+                                       uint32_t barrier, uint32_t rec_len,
                                        long int *start, long int *size,
                                        gid_t **groups, long int limit)
 {
+    const size_t data_offset = offsetof(struct sss_mc_initgr_data, gids);
     struct sss_mc_initgr_data *data;
     time_t expire;
     long int i;
+    long int orig_start;
     uint32_t num_groups;
     long int max_ret;
 
-    /* additional checks before filling result*/
+    data = (struct sss_mc_initgr_data *)rec->data;
+
+    /* snapshot the fixed fields, they can be trusted only once we know
+     * the record was not modified while reading them */
     expire = rec->expire;
+    num_groups = data->num_groups;
+    if (!sss_nss_mc_check_record(rec, barrier, rec_len)) {
+        return EAGAIN;
+    }
+
+    /* additional checks before filling result*/
     if (expire < time(NULL)) {
         /* entry is now invalid */
         return EINVAL;
     }
 
-    data = (struct sss_mc_initgr_data *)rec->data;
-    num_groups = data->num_groups;
+    /* all gids must be within the record */
+    if (num_groups > (rec_len - sizeof(struct sss_mc_rec) - data_offset)
+                                                    / sizeof(uint32_t)) {
+        return EINVAL;
+    }
+
     max_ret = num_groups;
 
     /* check we have enough space in the buffer */
@@ -75,11 +91,19 @@ static errno_t sss_nss_mc_parse_result(struct sss_mc_rec *rec,
         *size = newsize;
     }
 
+    /* copy straight from the mmapped record */
+    orig_start = *start;
     for (i = 0; i < max_ret; i++) {
         SAFEALIGN_COPY_UINT32(&(*groups)[*start], data->gids + i, NULL);
         *start += 1;
     }
 
+    if (!sss_nss_mc_check_record(rec, barrier, rec_len)) {
+        /* drop what we copied, the lookup will be restarted */
+        *start = orig_start;
+        return EAGAIN;
+    }
+
     return 0;
 }
 
@@ -90,8 +114,18 @@ errno_t sss_nss_mc_initgroups_dyn(const char *name, size_t name_len,
     struct sss_mc_rec *rec = NULL;
     struct sss_mc_initgr_data *data;
     char *rec_name;
+    uint32_t rec_len;
+    uint32_t barrier;
+    uint32_t name_ptr;
+    uint32_t strs_ptr;
+    uint32_t strs_len;
+    uint32_t data_len;
     uint32_t hash;
     uint32_t slot;
+    uint32_t next_slot;
+    bool corrupted;
+    bool match;
+    int attempts = 0;
     int ret;
     const size_t data_offset = offsetof(struct sss_mc_initgr_data, gids);
     size_t data_size;
@@ -106,49 +140,68 @@ errno_t sss_nss_mc_initgroups_dyn(const char *name, size_t name_len,
 
     /* hashes are calculated including the NULL terminator */
     hash = sss_nss_mc_hash(&initgr_mc_ctx, name, name_len + 1);
+
+restart:
+    if (attempts++ == SSS_NSS_MC_READ_RETRIES) {
+        ret = EIO;
+        goto done;
+    }
     slot = initgr_mc_ctx.hash_table[hash];
 
     /* If slot is not within the bounds of mmaped region and
      * it's value is not MC_INVALID_VAL, then the cache is
      * probbably corrupted. */
     while (MC_SLOT_WITHIN_BOUNDS(slot, data_size)) {
-        /* free record from previous iteration */
-        free(rec);
-        rec = NULL;
-
-        ret = sss_nss_mc_get_record(&initgr_mc_ctx, slot, &rec);
+        ret = sss_nss_mc_get_record(&initgr_mc_ctx, slot,
+                                    sizeof(struct sss_mc_initgr_data),
+                                    &rec, &barrier, &rec_len);
         if (ret) {
             goto done;
         }
 
-        /* check record matches what we are searching for */
-        if (hash != rec->hash1) {
-            /* if name hash does not match we can skip this immediately */
-            slot = sss_nss_mc_next_slot_with_hash(rec, hash);
-            continue;
+        /* check record matches what we are searching for,
+         * if name hash does not match we can skip this immediately */
+        corrupted = false;
+        match = false;
+        if (hash == rec->hash1) {
+            data = (struct sss_mc_initgr_data *)rec->data;
+            name_ptr = data->name;
+            strs_ptr = data->strs;
+            strs_len = data->strs_len;
+            data_len = data->data_len;
+            /* Integrity check
+             * - name_len cannot be longer than all strings or data
+             * - all data must be within the record
+             * - data->strs and data->name cannot point outside strings */
+            if (name_len > strs_len
+                || strs_len > data_len
+                || data_len > rec_len - sizeof(struct sss_mc_rec)
+                                      - data_offset
+                || (strs_ptr + name_len) > (data_offset + data_len)
+                || name_ptr < strs_ptr
+                || (name_ptr + name_len) >= (data_offset + data_len)) {
+                corrupted = true;
+            } else {
+                /* compare in place, including the NULL terminator */
+                rec_name = (char *)data + name_ptr;
+                match = (memcmp(name, rec_name, name_len + 1) == 0);
+            }
         }
+        next_slot = sss_nss_mc_next_slot_with_hash(rec, hash);
 
-        data = (struct sss_mc_initgr_data *)rec->data;
-        rec_name = (char *)data + data->name;
-        /* Integrity check
-         * - name_len cannot be longer than all strings or data
-         * - all data must be within copy of record
-         * - size of record must be lower that data table size
-         * - data->strs cannot point outside strings */
-        if (name_len > data->strs_len
-            || data->strs_len > data->data_len
-            || data->data_len > rec->len
-            || rec->len > data_size
-            || (data->strs + name_len) > (data_offset + data->data_len)) {
+        if (!sss_nss_mc_check_record(rec, barrier, rec_len)) {
+            /* the record changed while we were looking at it */
+            goto restart;
+        }
+        if (corrupted) {
             ret = ENOENT;
             goto done;
         }
-
-        if (strcmp(name, rec_name) == 0) {
+        if (match) {
             break;
         }
 
-        slot = sss_nss_mc_next_slot_with_hash(rec, hash);
+        slot = next_slot;
     }
 
     if (!MC_SLOT_WITHIN_BOUNDS(slot, data_size)) {
@@ -156,10 +209,13 @@ errno_t sss_nss_mc_initgroups_dyn(const char *name, size_t name_len,
         goto done;
     }
 
-    ret = sss_nss_mc_parse_result(rec, start, size, groups, limit);
+    ret = sss_nss_mc_parse_result(rec, barrier, rec_len,
+                                  start, size, groups, limit);
+    if (ret == EAGAIN) {
+        goto restart;
+    }
 
 done:
-    free(rec);
     __sync_sub_and_fetch(&initgr_mc_ctx.active_threads, 1);
     return ret;
 }
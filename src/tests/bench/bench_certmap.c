@@ -0,0 +1,232 @@
+/*
+    SSSD
+
+    bench_certmap - Micro-benchmark of the certificate mapping library
+
+    Copyright (C) 2017 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tests/bench/sss_bench.h"
+#include "tests/cmocka/test_certmap_certs.h"
+#include "lib/certmap/sss_certmap.h"
+#include "lib/certmap/sss_certmap_int.h"
+
+#ifdef HAVE_NSS
+#include "util/crypto/nss/nss_util.h"
+#endif
+
+/*
+ * The data set is "size" rules of which only the one with the lowest
+ * priority matches test_cert_der. The other rules are rejected either by
+ * their issuer regular expression, by the exact issuer prefilter or by the
+ * key usage prefilter. The prefilters are checked before any regular
+ * expression.
+ *
+ * The certificate content is cached per context. The "uncached" operations
+ * cycle through copies of test_cert_der that differ in the serial number,
+ * more than the cache holds, so every call decodes the certificate.
+ */
+
+#define NUM_VARIANTS (4 * CERT_CONTENT_CACHE_SIZE)
+/* Offset of the one byte serial number of test_cert_der */
+#define SERIAL_OFFSET 15
+
+struct bench_certmap {
+    struct sss_certmap_ctx *regex_ctx;
+    struct sss_certmap_ctx *issuer_ctx;
+    struct sss_certmap_ctx *ku_ctx;
+    uint8_t *variants[NUM_VARIANTS];
+};
+
+static struct sss_certmap_ctx *bench_ctx(TALLOC_CTX *mem_ctx,
+                                         uint64_t num,
+                                         const char *reject_fmt)
+{
+    struct sss_certmap_ctx *ctx;
+    char *rule;
+    uint64_t i;
+    int ret;
+
+    ret = sss_certmap_init(mem_ctx, NULL, NULL, &ctx);
+    sss_bench_assert(ret == 0);
+
+    for (i = 0; i + 1 < num; i++) {
+        rule = talloc_asprintf(ctx, reject_fmt, i);
+        sss_bench_assert(rule != NULL);
+
+        ret = sss_certmap_add_rule(ctx, i, rule, "LDAP:(cn={subject_dn})",
+                                   NULL);
+        sss_bench_assert(ret == 0);
+        talloc_free(rule);
+    }
+
+    ret = sss_certmap_add_rule(ctx, num,
+                            "KRB5:<ISSUER>CN=Certificate Authority,O=IPA.DEVEL",
+                            "LDAP:(cn={subject_dn})", NULL);
+    sss_bench_assert(ret == 0);
+
+    return ctx;
+}
+
+static void bench_match(struct sss_certmap_ctx *ctx,
+                        const uint8_t *der, size_t der_size,
+                        int expected)
+{
+    int ret;
+
+    ret = sss_certmap_match_cert(ctx, discard_const(der), der_size);
+    sss_bench_assert(ret == expected);
+}
+
+static void bench_match_regex_cached(void *pvt, uint64_t i)
+{
+    struct bench_certmap *b = pvt;
+
+    bench_match(b->regex_ctx, test_cert_der, sizeof(test_cert_der), 0);
+}
+
+static void bench_match_regex_uncached(void *pvt, uint64_t i)
+{
+    struct bench_certmap *b = pvt;
+
+    bench_match(b->regex_ctx, b->variants[i % NUM_VARIANTS],
+                sizeof(test_cert_der), 0);
+}
+
+static void bench_match_issuer_uncached(void *pvt, uint64_t i)
+{
+    struct bench_certmap *b = pvt;
+
+    bench_match(b->issuer_ctx, b->variants[i % NUM_VARIANTS],
+                sizeof(test_cert_der), 0);
+}
+
+static void bench_match_ku_uncached(void *pvt, uint64_t i)
+{
+    struct bench_certmap *b = pvt;
+
+    bench_match(b->ku_ctx, b->variants[i % NUM_VARIANTS],
+                sizeof(test_cert_der), 0);
+}
+
+static void bench_match_no_rule(void *pvt, uint64_t i)
+{
+    struct bench_certmap *b = pvt;
+
+    bench_match(b->regex_ctx, test_cert2_der, sizeof(test_cert2_der),
+                ENOENT);
+}
+
+static void bench_search_filter(struct sss_certmap_ctx *ctx,
+                                const uint8_t *der, size_t der_size)
+{
+    char *filter;
+    char **domains;
+    int ret;
+
+    ret = sss_certmap_get_search_filter(ctx, discard_const(der), der_size,
+                                        &filter, &domains);
+    sss_bench_assert(ret == 0 && filter != NULL);
+    sss_certmap_free_filter_and_domains(filter, domains);
+}
+
+static void bench_search_filter_cached(void *pvt, uint64_t i)
+{
+    struct bench_certmap *b = pvt;
+
+    bench_search_filter(b->regex_ctx, test_cert_der, sizeof(test_cert_der));
+}
+
+static void bench_search_filter_uncached(void *pvt, uint64_t i)
+{
+    struct bench_certmap *b = pvt;
+
+    bench_search_filter(b->regex_ctx, b->variants[i % NUM_VARIANTS],
+                        sizeof(test_cert_der));
+}
+
+static void bench_cert_get_content(void *pvt, uint64_t i)
+{
+    struct sss_cert_content *content;
+    int ret;
+
+    ret = sss_cert_get_content(NULL, test_cert_der, sizeof(test_cert_der),
+                               &content);
+    sss_bench_assert(ret == 0);
+    talloc_free(content);
+}
+
+int main(int argc, const char *argv[])
+{
+    struct sss_bench_opts opts = { .size = 100, .iterations = 10000 };
+    struct bench_certmap *b;
+    size_t i;
+    errno_t ret;
+
+    ret = sss_bench_init(argc, argv, &opts);
+    if (ret != EOK) {
+        return 1;
+    }
+
+#ifdef HAVE_NSS
+    nspr_nss_init();
+#endif
+
+    b = talloc_zero(NULL, struct bench_certmap);
+    sss_bench_assert(b != NULL);
+
+    for (i = 0; i < NUM_VARIANTS; i++) {
+        b->variants[i] = talloc_memdup(b, test_cert_der,
+                                       sizeof(test_cert_der));
+        sss_bench_assert(b->variants[i] != NULL);
+        b->variants[i][SERIAL_OFFSET] = 0x10 + i;
+    }
+
+    /* Rejected by the issuer after the prefilter passed */
+    b->regex_ctx = bench_ctx(b, opts.size,
+                             "KRB5:<ISSUER>^CN=Other.Authority %"PRIu64"$");
+    /* Rejected by the exact issuer prefilter */
+    b->issuer_ctx = bench_ctx(b, opts.size,
+                              "KRB5:<ISSUER>^CN=Other Authority %"PRIu64"$");
+    /* Rejected by the key usage prefilter */
+    b->ku_ctx = bench_ctx(b, opts.size,
+                          "KRB5:<KU>cRLSign<ISSUER>^CN=Other %"PRIu64"$");
+
+    sss_bench_run("cert_get_content", opts.iterations,
+                  bench_cert_get_content, b);
+    sss_bench_run("certmap_match_cached", opts.iterations,
+                  bench_match_regex_cached, b);
+    sss_bench_run("certmap_match_uncached_regex_reject", opts.iterations,
+                  bench_match_regex_uncached, b);
+    sss_bench_run("certmap_match_uncached_issuer_reject", opts.iterations,
+                  bench_match_issuer_uncached, b);
+    sss_bench_run("certmap_match_uncached_prefilter_reject", opts.iterations,
+                  bench_match_ku_uncached, b);
+    sss_bench_run("certmap_match_no_rule", opts.iterations,
+                  bench_match_no_rule, b);
+    sss_bench_run("certmap_search_filter_cached", opts.iterations,
+                  bench_search_filter_cached, b);
+    sss_bench_run("certmap_search_filter_uncached", opts.iterations,
+                  bench_search_filter_uncached, b);
+
+    talloc_free(b);
+
+#ifdef HAVE_NSS
+    nspr_nss_cleanup();
+#endif
+
+    return 0;
+}
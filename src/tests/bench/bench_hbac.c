@@ -0,0 +1,208 @@
+/*
+    SSSD
+
+    bench_hbac - Micro-benchmark of the HBAC rule evaluator
+
+    Copyright (C) 2017 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tests/bench/sss_bench.h"
+#include "lib/ipa_hbac/ipa_hbac.h"
+
+/*
+ * The data set is "size" rules. Rule N allows user N and the members of
+ * group N to use service N on all hosts. The requesting user is a member
+ * of REQ_GROUPS groups, like a user in a typical IPA deployment.
+ */
+
+#define REQ_GROUPS 32
+
+struct bench_hbac {
+    struct hbac_rule **rules;
+    struct hbac_eval_req *allow_first;
+    struct hbac_eval_req *allow_last;
+    struct hbac_eval_req *deny;
+};
+
+static struct hbac_rule_element *
+bench_rule_element(TALLOC_CTX *mem_ctx, const char *name, const char *group)
+{
+    struct hbac_rule_element *el;
+
+    el = talloc_zero(mem_ctx, struct hbac_rule_element);
+    sss_bench_assert(el != NULL);
+
+    if (name == NULL && group == NULL) {
+        el->category = HBAC_CATEGORY_ALL;
+        return el;
+    }
+
+    el->category = HBAC_CATEGORY_NULL;
+    el->names = talloc_zero_array(el, const char *, 2);
+    el->groups = talloc_zero_array(el, const char *, 2);
+    sss_bench_assert(el->names != NULL && el->groups != NULL);
+    el->names[0] = name;
+    el->groups[0] = group;
+
+    return el;
+}
+
+static struct hbac_rule **bench_rules(TALLOC_CTX *mem_ctx, uint64_t num)
+{
+    struct hbac_rule **rules;
+    struct hbac_rule *rule;
+    uint64_t i;
+
+    rules = talloc_zero_array(mem_ctx, struct hbac_rule *, num + 1);
+    sss_bench_assert(rules != NULL);
+
+    for (i = 0; i < num; i++) {
+        rule = talloc_zero(rules, struct hbac_rule);
+        sss_bench_assert(rule != NULL);
+
+        rule->name = talloc_asprintf(rule, "rule%"PRIu64, i);
+        rule->enabled = true;
+        rule->users = bench_rule_element(rule,
+                          talloc_asprintf(rule, "user%"PRIu64, i),
+                          talloc_asprintf(rule, "group%"PRIu64, i));
+        rule->services = bench_rule_element(rule,
+                             talloc_asprintf(rule, "svc%"PRIu64, i),
+                             talloc_asprintf(rule, "svcgroup%"PRIu64, i));
+        rule->targethosts = bench_rule_element(rule, NULL, NULL);
+        rule->srchosts = bench_rule_element(rule, NULL, NULL);
+
+        rules[i] = rule;
+    }
+
+    return rules;
+}
+
+static struct hbac_request_element *
+bench_req_element(TALLOC_CTX *mem_ctx, const char *name,
+                  const char *group_fmt, uint64_t first, uint64_t num)
+{
+    struct hbac_request_element *el;
+    uint64_t i;
+
+    el = talloc_zero(mem_ctx, struct hbac_request_element);
+    sss_bench_assert(el != NULL);
+
+    el->name = name;
+    el->groups = talloc_zero_array(el, const char *, num + 1);
+    sss_bench_assert(el->groups != NULL);
+
+    for (i = 0; i < num; i++) {
+        el->groups[i] = talloc_asprintf(el, group_fmt, first + i);
+        sss_bench_assert(el->groups[i] != NULL);
+    }
+
+    return el;
+}
+
+/* A request of a user that is a member of the groups first to
+ * first + REQ_GROUPS - 1 for the given service */
+static struct hbac_eval_req *
+bench_request(TALLOC_CTX *mem_ctx, uint64_t first, const char *service)
+{
+    struct hbac_eval_req *req;
+
+    req = talloc_zero(mem_ctx, struct hbac_eval_req);
+    sss_bench_assert(req != NULL);
+
+    req->user = bench_req_element(req, "bench_user", "group%"PRIu64,
+                                  first, REQ_GROUPS);
+    req->service = bench_req_element(req, service, "svcgroup%"PRIu64, 0, 0);
+    req->targethost = bench_req_element(req, "host.bench.dom",
+                                        "hostgroup%"PRIu64, 0, 0);
+    req->srchost = bench_req_element(req, "client.bench.dom",
+                                     "hostgroup%"PRIu64, 0, 0);
+    req->request_time = time(NULL);
+
+    return req;
+}
+
+static void bench_evaluate(struct hbac_rule **rules,
+                           struct hbac_eval_req *req,
+                           enum hbac_eval_result expected)
+{
+    struct hbac_info *info = NULL;
+    enum hbac_eval_result result;
+
+    result = hbac_evaluate(rules, req, &info);
+    sss_bench_assert(result == expected);
+    hbac_free_info(info);
+}
+
+static void bench_allow_first(void *pvt, uint64_t i)
+{
+    struct bench_hbac *b = pvt;
+
+    bench_evaluate(b->rules, b->allow_first, HBAC_EVAL_ALLOW);
+}
+
+static void bench_allow_last(void *pvt, uint64_t i)
+{
+    struct bench_hbac *b = pvt;
+
+    bench_evaluate(b->rules, b->allow_last, HBAC_EVAL_ALLOW);
+}
+
+static void bench_deny(void *pvt, uint64_t i)
+{
+    struct bench_hbac *b = pvt;
+
+    bench_evaluate(b->rules, b->deny, HBAC_EVAL_DENY);
+}
+
+int main(int argc, const char *argv[])
+{
+    struct sss_bench_opts opts = { .size = 1000, .iterations = 10000 };
+    struct bench_hbac *b;
+    char *last_svc;
+    uint64_t last_first;
+    errno_t ret;
+
+    ret = sss_bench_init(argc, argv, &opts);
+    if (ret != EOK) {
+        return 1;
+    }
+
+    b = talloc_zero(NULL, struct bench_hbac);
+    sss_bench_assert(b != NULL);
+
+    b->rules = bench_rules(b, opts.size);
+
+    last_svc = talloc_asprintf(b, "svc%"PRIu64, opts.size - 1);
+    sss_bench_assert(last_svc != NULL);
+    last_first = opts.size > REQ_GROUPS ? opts.size - REQ_GROUPS : 0;
+
+    /* Matched by the first rule */
+    b->allow_first = bench_request(b, 0, "svc0");
+    /* Matched only by the last rule, all rules are evaluated */
+    b->allow_last = bench_request(b, last_first, last_svc);
+    /* Not matched by any rule */
+    b->deny = bench_request(b, 0, "no_such_service");
+
+    sss_bench_run("hbac_evaluate_allow_first_rule", opts.iterations,
+                  bench_allow_first, b);
+    sss_bench_run("hbac_evaluate_allow_last_rule", opts.iterations,
+                  bench_allow_last, b);
+    sss_bench_run("hbac_evaluate_deny", opts.iterations,
+                  bench_deny, b);
+
+    talloc_free(b);
+    return 0;
+}
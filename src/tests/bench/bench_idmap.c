@@ -0,0 +1,167 @@
+/*
+    SSSD
+
+    bench_idmap - Micro-benchmark of the SID to POSIX ID mapping
+
+    Copyright (C) 2017 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tests/bench/sss_bench.h"
+#include "lib/idmap/sss_idmap.h"
+
+/*
+ * The data set is "size" domains with a range of RANGE_SIZE IDs each, as
+ * in a forest with many trusted domains. Lookups are spread over all
+ * domains.
+ */
+
+#define RANGE_MIN 100000
+#define RANGE_SIZE 10000
+#define DOM_SID_FMT "S-1-5-21-2000-3000-%"PRIu64
+#define RIDS_PER_DOMAIN 1000
+
+struct bench_idmap {
+    struct sss_idmap_ctx *idmap_ctx;
+    uint64_t size;
+    char **sids;
+    char **foreign_sids;
+};
+
+static void *bench_idmap_talloc(size_t size, void *pvt)
+{
+    return talloc_size(pvt, size);
+}
+
+static void bench_idmap_free(void *ptr, void *pvt)
+{
+    talloc_free(ptr);
+}
+
+/* Lookup i hits domain i % size and RID i / size % RIDS_PER_DOMAIN */
+static uint64_t bench_dom(struct bench_idmap *b, uint64_t i)
+{
+    return i % b->size;
+}
+
+static uint32_t bench_rid(struct bench_idmap *b, uint64_t i)
+{
+    return (i / b->size) % RIDS_PER_DOMAIN;
+}
+
+static void bench_sid_to_unix(void *pvt, uint64_t i)
+{
+    struct bench_idmap *b = pvt;
+    enum idmap_error_code err;
+    uint32_t id;
+
+    err = sss_idmap_sid_to_unix(b->idmap_ctx,
+                                b->sids[i % (b->size * RIDS_PER_DOMAIN)],
+                                &id);
+    sss_bench_assert(err == IDMAP_SUCCESS);
+}
+
+static void bench_unix_to_sid(void *pvt, uint64_t i)
+{
+    struct bench_idmap *b = pvt;
+    enum idmap_error_code err;
+    char *sid;
+
+    err = sss_idmap_unix_to_sid(b->idmap_ctx,
+                                RANGE_MIN + bench_dom(b, i) * RANGE_SIZE
+                                          + bench_rid(b, i),
+                                &sid);
+    sss_bench_assert(err == IDMAP_SUCCESS);
+    sss_idmap_free_sid(b->idmap_ctx, sid);
+}
+
+static void bench_sid_to_unix_no_domain(void *pvt, uint64_t i)
+{
+    struct bench_idmap *b = pvt;
+    enum idmap_error_code err;
+    uint32_t id;
+
+    err = sss_idmap_sid_to_unix(b->idmap_ctx,
+                                b->foreign_sids[i % b->size], &id);
+    sss_bench_assert(err == IDMAP_NO_DOMAIN);
+}
+
+int main(int argc, const char *argv[])
+{
+    struct sss_bench_opts opts = { .size = 100, .iterations = 1000000 };
+    struct sss_idmap_range range;
+    enum idmap_error_code err;
+    struct bench_idmap *b;
+    char *dom_sid;
+    char *dom_name;
+    uint64_t i;
+    errno_t ret;
+
+    ret = sss_bench_init(argc, argv, &opts);
+    if (ret != EOK) {
+        return 1;
+    }
+
+    if (RANGE_MIN + opts.size * RANGE_SIZE > UINT32_MAX) {
+        fprintf(stderr, "Too many domains\n");
+        return 1;
+    }
+
+    b = talloc_zero(NULL, struct bench_idmap);
+    sss_bench_assert(b != NULL);
+    b->size = opts.size;
+
+    err = sss_idmap_init(bench_idmap_talloc, b, bench_idmap_free,
+                         &b->idmap_ctx);
+    sss_bench_assert(err == IDMAP_SUCCESS);
+
+    b->sids = talloc_array(b, char *, b->size * RIDS_PER_DOMAIN);
+    b->foreign_sids = talloc_array(b, char *, b->size);
+    sss_bench_assert(b->sids != NULL && b->foreign_sids != NULL);
+
+    for (i = 0; i < b->size; i++) {
+        dom_sid = talloc_asprintf(b, DOM_SID_FMT, i);
+        dom_name = talloc_asprintf(b, "dom%"PRIu64".bench", i);
+        sss_bench_assert(dom_sid != NULL && dom_name != NULL);
+
+        range.min = RANGE_MIN + i * RANGE_SIZE;
+        range.max = range.min + RANGE_SIZE - 1;
+
+        err = sss_idmap_add_domain(b->idmap_ctx, dom_name, dom_sid, &range);
+        sss_bench_assert(err == IDMAP_SUCCESS);
+
+        b->foreign_sids[i] = talloc_asprintf(b->foreign_sids,
+                                             "S-1-5-21-4000-5000-%"PRIu64"-1",
+                                             i);
+        sss_bench_assert(b->foreign_sids[i] != NULL);
+    }
+
+    /* Ordered like the lookups in bench_unix_to_sid() */
+    for (i = 0; i < b->size * RIDS_PER_DOMAIN; i++) {
+        b->sids[i] = talloc_asprintf(b->sids, DOM_SID_FMT"-%"PRIu32,
+                                     bench_dom(b, i), bench_rid(b, i));
+        sss_bench_assert(b->sids[i] != NULL);
+    }
+
+    sss_bench_run("idmap_sid_to_unix", opts.iterations,
+                  bench_sid_to_unix, b);
+    sss_bench_run("idmap_unix_to_sid", opts.iterations,
+                  bench_unix_to_sid, b);
+    sss_bench_run("idmap_sid_to_unix_no_domain", opts.iterations,
+                  bench_sid_to_unix_no_domain, b);
+
+    talloc_free(b);
+    return 0;
+}
@@ -0,0 +1,166 @@
+/*
+    SSSD
+
+    bench_memberof - Micro-benchmark of group membership in the cache
+
+    Copyright (C) 2017 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tests/bench/sss_bench.h"
+#include "tests/common.h"
+#include "db/sysdb.h"
+
+/*
+ * Every membership change goes through the memberof ldb module, which
+ * keeps the memberOf attributes of all direct and indirect members up to
+ * date. The data set is "size" users spread over size / 10 groups.
+ */
+
+#define TESTS_PATH "tp_" BASE_FILE_STEM
+#define TEST_CONF_DB "bench_memberof_conf.ldb"
+#define TEST_DOM_NAME "bench_memberof"
+#define TEST_ID_PROVIDER "ldap"
+
+#define USERS_PER_GROUP 10
+
+struct bench_memberof {
+    struct sss_test_ctx *tctx;
+    uint64_t num_users;
+    uint64_t num_groups;
+    char **users;
+    char **groups;
+};
+
+static void bench_add_user(void *pvt, uint64_t i)
+{
+    struct bench_memberof *b = pvt;
+    errno_t ret;
+
+    ret = sysdb_add_user(b->tctx->dom, b->users[i], 10000 + i, 10000 + i,
+                         NULL, "/home/bench", "/bin/bash", NULL, NULL,
+                         3600, 0);
+    sss_bench_assert(ret == EOK);
+}
+
+static void bench_add_group(void *pvt, uint64_t i)
+{
+    struct bench_memberof *b = pvt;
+    errno_t ret;
+
+    ret = sysdb_add_group(b->tctx->dom, b->groups[i], 20000 + i,
+                          NULL, 3600, 0);
+    sss_bench_assert(ret == EOK);
+}
+
+static void bench_add_user_member(void *pvt, uint64_t i)
+{
+    struct bench_memberof *b = pvt;
+    errno_t ret;
+
+    ret = sysdb_add_group_member(b->tctx->dom, b->groups[i % b->num_groups],
+                                 b->users[i], SYSDB_MEMBER_USER, false);
+    sss_bench_assert(ret == EOK);
+}
+
+/* Builds a chain, every group is a member of the next one. Each step
+ * updates the memberOf attribute of all members below it. */
+static void bench_add_nested_group(void *pvt, uint64_t i)
+{
+    struct bench_memberof *b = pvt;
+    errno_t ret;
+
+    ret = sysdb_add_group_member(b->tctx->dom, b->groups[i + 1],
+                                 b->groups[i], SYSDB_MEMBER_GROUP, false);
+    sss_bench_assert(ret == EOK);
+}
+
+static void bench_initgroups(void *pvt, uint64_t i)
+{
+    struct bench_memberof *b = pvt;
+    struct ldb_result *res;
+    errno_t ret;
+
+    ret = sysdb_initgroups(b, b->tctx->dom, b->users[i % b->num_users], &res);
+    sss_bench_assert(ret == EOK);
+    talloc_free(res);
+}
+
+static void bench_remove_user_member(void *pvt, uint64_t i)
+{
+    struct bench_memberof *b = pvt;
+    errno_t ret;
+
+    ret = sysdb_remove_group_member(b->tctx->dom,
+                                    b->groups[i % b->num_groups],
+                                    b->users[i], SYSDB_MEMBER_USER, false);
+    sss_bench_assert(ret == EOK);
+}
+
+int main(int argc, const char *argv[])
+{
+    struct sss_bench_opts opts = { .size = 1000, .iterations = 10000 };
+    struct bench_memberof *b;
+    uint64_t i;
+    errno_t ret;
+
+    ret = sss_bench_init(argc, argv, &opts);
+    if (ret != EOK) {
+        return 1;
+    }
+
+    tests_set_cwd();
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    test_dom_suite_setup(TESTS_PATH);
+
+    b = talloc_zero(NULL, struct bench_memberof);
+    sss_bench_assert(b != NULL);
+
+    b->tctx = create_dom_test_ctx(b, TESTS_PATH, TEST_CONF_DB,
+                                  TEST_DOM_NAME, TEST_ID_PROVIDER, NULL);
+    sss_bench_assert(b->tctx != NULL);
+
+    b->num_users = opts.size;
+    b->num_groups = MAX(opts.size / USERS_PER_GROUP, 2);
+
+    b->users = talloc_array(b, char *, b->num_users);
+    b->groups = talloc_array(b, char *, b->num_groups);
+    sss_bench_assert(b->users != NULL && b->groups != NULL);
+    for (i = 0; i < b->num_users; i++) {
+        b->users[i] = talloc_asprintf(b->users, "user%"PRIu64"@%s",
+                                      i, TEST_DOM_NAME);
+        sss_bench_assert(b->users[i] != NULL);
+    }
+    for (i = 0; i < b->num_groups; i++) {
+        b->groups[i] = talloc_asprintf(b->groups, "group%"PRIu64"@%s",
+                                       i, TEST_DOM_NAME);
+        sss_bench_assert(b->groups[i] != NULL);
+    }
+
+    sss_bench_run("sysdb_add_user", b->num_users, bench_add_user, b);
+    sss_bench_run("sysdb_add_group", b->num_groups, bench_add_group, b);
+    sss_bench_run("memberof_add_user_member", b->num_users,
+                  bench_add_user_member, b);
+    sss_bench_run("memberof_add_nested_group", b->num_groups - 1,
+                  bench_add_nested_group, b);
+    sss_bench_run("sysdb_initgroups_nested", opts.iterations,
+                  bench_initgroups, b);
+    sss_bench_run("memberof_remove_user_member", b->num_users,
+                  bench_remove_user_member, b);
+
+    talloc_free(b);
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    return 0;
+}
@@ -0,0 +1,168 @@
+/*
+    SSSD
+
+    bench_mmap_cache - Micro-benchmark of the fast in-memory cache
+
+    Copyright (C) 2017 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <pwd.h>
+#include <sys/stat.h>
+
+#include "tests/bench/sss_bench.h"
+#include "responder/nss/nsssrv_mmap_cache.h"
+#include "sss_client/nss_mc.h"
+
+/* Both the responder and the client side are built with
+ * SSS_NSS_MCACHE_DIR pointing to a directory in the build tree,
+ * see Makefile.am */
+
+struct bench_mmap_cache {
+    struct sss_mc_ctx *mcc;
+    uint64_t size;
+    char **names;
+    struct sized_string *sized_names;
+    char buffer[1024];
+};
+
+/* The client code expects the locks of the NSS module, the benchmark is
+ * single threaded */
+void sss_nss_mc_lock(void)
+{
+    return;
+}
+
+void sss_nss_mc_unlock(void)
+{
+    return;
+}
+
+static void bench_pw_store(void *pvt, uint64_t i)
+{
+    struct bench_mmap_cache *b = pvt;
+    struct sized_string pw;
+    struct sized_string gecos;
+    struct sized_string homedir;
+    struct sized_string shell;
+    uint64_t n = i % b->size;
+    errno_t ret;
+
+    to_sized_string(&pw, "*");
+    to_sized_string(&gecos, "Benchmark User");
+    to_sized_string(&homedir, "/home/bench");
+    to_sized_string(&shell, "/bin/bash");
+
+    ret = sss_mmap_cache_pw_store(&b->mcc, &b->sized_names[n], &pw,
+                                  10000 + n, 10000 + n,
+                                  &gecos, &homedir, &shell);
+    sss_bench_assert(ret == EOK);
+}
+
+static void bench_getpwnam_hit(void *pvt, uint64_t i)
+{
+    struct bench_mmap_cache *b = pvt;
+    struct passwd result;
+    uint64_t n = i % b->size;
+    errno_t ret;
+
+    ret = sss_nss_mc_getpwnam(b->names[n], b->sized_names[n].len - 1,
+                              &result, b->buffer, sizeof(b->buffer));
+    sss_bench_assert(ret == EOK);
+}
+
+static void bench_getpwuid_hit(void *pvt, uint64_t i)
+{
+    struct bench_mmap_cache *b = pvt;
+    struct passwd result;
+    errno_t ret;
+
+    ret = sss_nss_mc_getpwuid(10000 + i % b->size,
+                              &result, b->buffer, sizeof(b->buffer));
+    sss_bench_assert(ret == EOK);
+}
+
+static void bench_getpwnam_miss(void *pvt, uint64_t i)
+{
+    struct bench_mmap_cache *b = pvt;
+    struct passwd result;
+    char name[64];
+    int len;
+    errno_t ret;
+
+    len = snprintf(name, sizeof(name), "missing%"PRIu64, i % b->size);
+    ret = sss_nss_mc_getpwnam(name, len,
+                              &result, b->buffer, sizeof(b->buffer));
+    sss_bench_assert(ret == ENOENT);
+}
+
+static void bench_pw_invalidate(void *pvt, uint64_t i)
+{
+    struct bench_mmap_cache *b = pvt;
+    errno_t ret;
+
+    ret = sss_mmap_cache_pw_invalidate(b->mcc, &b->sized_names[i % b->size]);
+    sss_bench_assert(ret == EOK || ret == ENOENT);
+}
+
+int main(int argc, const char *argv[])
+{
+    struct sss_bench_opts opts = { .size = 10000, .iterations = 1000000 };
+    struct bench_mmap_cache *b;
+    uint64_t i;
+    errno_t ret;
+
+    ret = sss_bench_init(argc, argv, &opts);
+    if (ret != EOK) {
+        return 1;
+    }
+
+    ret = mkdir(SSS_NSS_MCACHE_DIR, 0755);
+    sss_bench_assert(ret == 0 || errno == EEXIST);
+
+    b = talloc_zero(NULL, struct bench_mmap_cache);
+    sss_bench_assert(b != NULL);
+    b->size = opts.size;
+
+    b->names = talloc_array(b, char *, b->size);
+    b->sized_names = talloc_array(b, struct sized_string, b->size);
+    sss_bench_assert(b->names != NULL && b->sized_names != NULL);
+    for (i = 0; i < b->size; i++) {
+        b->names[i] = talloc_asprintf(b->names, "user%"PRIu64, i);
+        sss_bench_assert(b->names[i] != NULL);
+        to_sized_string(&b->sized_names[i], b->names[i]);
+    }
+
+    /* Large enough for all users, nothing is evicted while storing */
+    ret = sss_mmap_cache_init(b, "passwd", SSS_MC_PASSWD, b->size,
+                              3600, &b->mcc);
+    sss_bench_assert(ret == EOK);
+
+    sss_bench_run("mmap_cache_pw_store", opts.iterations,
+                  bench_pw_store, b);
+    sss_bench_run("mmap_cache_getpwnam_hit", opts.iterations,
+                  bench_getpwnam_hit, b);
+    sss_bench_run("mmap_cache_getpwuid_hit", opts.iterations,
+                  bench_getpwuid_hit, b);
+    sss_bench_run("mmap_cache_getpwnam_miss", opts.iterations,
+                  bench_getpwnam_miss, b);
+    sss_bench_run("mmap_cache_pw_invalidate", opts.iterations,
+                  bench_pw_invalidate, b);
+
+    talloc_free(b);
+    unlink(SSS_NSS_MCACHE_DIR"/passwd");
+    rmdir(SSS_NSS_MCACHE_DIR);
+    return 0;
+}
@@ -0,0 +1,162 @@
+/*
+    SSSD
+
+    bench_negcache - Micro-benchmark of the negative cache
+
+    Copyright (C) 2017 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tests/bench/sss_bench.h"
+#include "responder/common/negcache.h"
+
+#define BENCH_DOM_NAME "bench.dom"
+
+struct bench_negcache {
+    struct sss_nc_ctx *ncache;
+    struct sss_domain_info *dom;
+    uint64_t size;
+    char **names;
+    char **missing;
+};
+
+static void bench_set_user(void *pvt, uint64_t i)
+{
+    struct bench_negcache *b = pvt;
+    int ret;
+
+    ret = sss_ncache_set_user(b->ncache, false, b->dom,
+                              b->names[i % b->size]);
+    sss_bench_assert(ret == EOK);
+}
+
+static void bench_check_user_hit(void *pvt, uint64_t i)
+{
+    struct bench_negcache *b = pvt;
+    int ret;
+
+    ret = sss_ncache_check_user(b->ncache, b->dom, b->names[i % b->size]);
+    sss_bench_assert(ret == EEXIST);
+}
+
+static void bench_check_user_miss(void *pvt, uint64_t i)
+{
+    struct bench_negcache *b = pvt;
+    int ret;
+
+    ret = sss_ncache_check_user(b->ncache, b->dom, b->missing[i % b->size]);
+    sss_bench_assert(ret == ENOENT);
+}
+
+static void bench_set_uid(void *pvt, uint64_t i)
+{
+    struct bench_negcache *b = pvt;
+    int ret;
+
+    ret = sss_ncache_set_uid(b->ncache, false, b->dom, 10000 + i % b->size);
+    sss_bench_assert(ret == EOK);
+}
+
+static void bench_check_uid_hit(void *pvt, uint64_t i)
+{
+    struct bench_negcache *b = pvt;
+    int ret;
+
+    ret = sss_ncache_check_uid(b->ncache, b->dom, 10000 + i % b->size);
+    sss_bench_assert(ret == EEXIST);
+}
+
+static void bench_check_uid_miss(void *pvt, uint64_t i)
+{
+    struct bench_negcache *b = pvt;
+    int ret;
+
+    ret = sss_ncache_check_uid(b->ncache, b->dom,
+                               10000 + b->size + i % b->size);
+    sss_bench_assert(ret == ENOENT);
+}
+
+static void bench_reset_users(void *pvt, uint64_t i)
+{
+    struct bench_negcache *b = pvt;
+    uint64_t n;
+    int ret;
+
+    for (n = 0; n < b->size; n++) {
+        ret = sss_ncache_set_user(b->ncache, false, b->dom, b->names[n]);
+        sss_bench_assert(ret == EOK);
+    }
+
+    ret = sss_ncache_reset_users(b->ncache);
+    sss_bench_assert(ret == EOK);
+}
+
+int main(int argc, const char *argv[])
+{
+    struct sss_bench_opts opts = { .size = 10000, .iterations = 1000000 };
+    struct bench_negcache *b;
+    uint64_t i;
+    errno_t ret;
+
+    ret = sss_bench_init(argc, argv, &opts);
+    if (ret != EOK) {
+        return 1;
+    }
+
+    b = talloc_zero(NULL, struct bench_negcache);
+    sss_bench_assert(b != NULL);
+    b->size = opts.size;
+
+    b->dom = talloc_zero(b, struct sss_domain_info);
+    sss_bench_assert(b->dom != NULL);
+    b->dom->name = talloc_strdup(b->dom, BENCH_DOM_NAME);
+    sss_bench_assert(b->dom->name != NULL);
+    b->dom->case_sensitive = false;
+
+    b->names = talloc_array(b, char *, b->size);
+    b->missing = talloc_array(b, char *, b->size);
+    sss_bench_assert(b->names != NULL && b->missing != NULL);
+    for (i = 0; i < b->size; i++) {
+        b->names[i] = talloc_asprintf(b->names, "user%"PRIu64"@%s",
+                                      i, BENCH_DOM_NAME);
+        b->missing[i] = talloc_asprintf(b->missing, "missing%"PRIu64"@%s",
+                                        i, BENCH_DOM_NAME);
+        sss_bench_assert(b->names[i] != NULL && b->missing[i] != NULL);
+    }
+
+    ret = sss_ncache_init(b, 3600, 0, &b->ncache);
+    sss_bench_assert(ret == EOK);
+
+    sss_bench_run("negcache_set_user", opts.iterations,
+                  bench_set_user, b);
+    sss_bench_run("negcache_check_user_hit", opts.iterations,
+                  bench_check_user_hit, b);
+    sss_bench_run("negcache_check_user_miss", opts.iterations,
+                  bench_check_user_miss, b);
+    sss_bench_run("negcache_set_uid", opts.iterations,
+                  bench_set_uid, b);
+    sss_bench_run("negcache_check_uid_hit", opts.iterations,
+                  bench_check_uid_hit, b);
+    sss_bench_run("negcache_check_uid_miss", opts.iterations,
+                  bench_check_uid_miss, b);
+
+    /* Every iteration refills the whole cache */
+    sss_bench_run("negcache_fill_and_reset_users",
+                  opts.iterations > b->size ? opts.iterations / b->size : 1,
+                  bench_reset_users, b);
+
+    talloc_free(b);
+    return 0;
+}
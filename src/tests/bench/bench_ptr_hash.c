@@ -0,0 +1,124 @@
+/*
+    SSSD
+
+    bench_ptr_hash - Micro-benchmark of the talloc pointer hash table
+
+    Copyright (C) 2017 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tests/bench/sss_bench.h"
+#include "util/sss_ptr_hash.h"
+
+/*
+ * The data set is "size" keys. Every value is a talloc pointer that
+ * removes itself from the table when freed, which is how the responders
+ * and the data provider use the table.
+ */
+
+struct bench_value {
+    uint64_t n;
+};
+
+struct bench_ptr_hash {
+    hash_table_t *table;
+    uint64_t size;
+    char **keys;
+    char **missing;
+    struct bench_value **values;
+};
+
+static void bench_add(void *pvt, uint64_t i)
+{
+    struct bench_ptr_hash *b = pvt;
+    errno_t ret;
+
+    b->values[i] = talloc_zero(b, struct bench_value);
+    sss_bench_assert(b->values[i] != NULL);
+    b->values[i]->n = i;
+
+    ret = sss_ptr_hash_add(b->table, b->keys[i], b->values[i],
+                           struct bench_value);
+    sss_bench_assert(ret == EOK);
+}
+
+static void bench_lookup_hit(void *pvt, uint64_t i)
+{
+    struct bench_ptr_hash *b = pvt;
+    struct bench_value *value;
+
+    value = sss_ptr_hash_lookup(b->table, b->keys[i % b->size],
+                                struct bench_value);
+    sss_bench_assert(value != NULL);
+}
+
+static void bench_lookup_miss(void *pvt, uint64_t i)
+{
+    struct bench_ptr_hash *b = pvt;
+    struct bench_value *value;
+
+    value = sss_ptr_hash_lookup(b->table, b->missing[i % b->size],
+                                struct bench_value);
+    sss_bench_assert(value == NULL);
+}
+
+/* Freeing the value removes the key through the talloc destructor */
+static void bench_free_value(void *pvt, uint64_t i)
+{
+    struct bench_ptr_hash *b = pvt;
+
+    talloc_zfree(b->values[i]);
+}
+
+int main(int argc, const char *argv[])
+{
+    struct sss_bench_opts opts = { .size = 100000, .iterations = 1000000 };
+    struct bench_ptr_hash *b;
+    uint64_t i;
+    errno_t ret;
+
+    ret = sss_bench_init(argc, argv, &opts);
+    if (ret != EOK) {
+        return 1;
+    }
+
+    b = talloc_zero(NULL, struct bench_ptr_hash);
+    sss_bench_assert(b != NULL);
+    b->size = opts.size;
+
+    b->table = sss_ptr_hash_create(b, NULL, NULL);
+    b->keys = talloc_array(b, char *, b->size);
+    b->missing = talloc_array(b, char *, b->size);
+    b->values = talloc_zero_array(b, struct bench_value *, b->size);
+    sss_bench_assert(b->table != NULL && b->keys != NULL
+                     && b->missing != NULL && b->values != NULL);
+
+    for (i = 0; i < b->size; i++) {
+        b->keys[i] = talloc_asprintf(b->keys, "user%"PRIu64"@bench", i);
+        b->missing[i] = talloc_asprintf(b->missing, "missing%"PRIu64"@bench",
+                                        i);
+        sss_bench_assert(b->keys[i] != NULL && b->missing[i] != NULL);
+    }
+
+    sss_bench_run("ptr_hash_add", b->size, bench_add, b);
+    sss_bench_run("ptr_hash_lookup_hit", opts.iterations,
+                  bench_lookup_hit, b);
+    sss_bench_run("ptr_hash_lookup_miss", opts.iterations,
+                  bench_lookup_miss, b);
+    sss_bench_run("ptr_hash_free_value", b->size, bench_free_value, b);
+
+    talloc_free(b);
+    return 0;
+}
@@ -0,0 +1,151 @@
+/*
+    SSSD
+
+    Micro-benchmark harness
+
+    Copyright (C) 2017 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <popt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "tests/bench/sss_bench.h"
+
+/* Allocation counting. The benchmarks are single threaded and the counter
+ * is only read between two operations. The __libc_* entry points are
+ * glibc specific, like the rest of SSSD. */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static uint64_t sss_bench_allocs;
+
+void *malloc(size_t size)
+{
+    sss_bench_allocs++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    sss_bench_allocs++;
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    sss_bench_allocs++;
+    return __libc_realloc(ptr, size);
+}
+
+static uint64_t sss_bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static long sss_bench_maxrss_kb(void)
+{
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1;
+    }
+
+    return usage.ru_maxrss;
+}
+
+errno_t sss_bench_init(int argc, const char *argv[],
+                       struct sss_bench_opts *opts)
+{
+    poptContext pc;
+    long size = opts->size;
+    long iterations = opts->iterations;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        { "size", 's', POPT_ARG_LONG, &size, 0,
+          "Size of the data set", NULL },
+        { "iterations", 'n', POPT_ARG_LONG, &iterations, 0,
+          "Number of times each operation is run", NULL },
+        POPT_TABLEEND
+    };
+
+    /* Set debug level to invalid value so we can decide if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while ((opt = poptGetNextOpt(pc)) != -1) {
+        switch (opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            poptFreeContext(pc);
+            return EINVAL;
+        }
+    }
+    poptFreeContext(pc);
+
+    if (size < 1 || iterations < 1) {
+        fprintf(stderr, "Size and iterations must be positive\n");
+        return EINVAL;
+    }
+
+    DEBUG_CLI_INIT(debug_level);
+
+    opts->size = size;
+    opts->iterations = iterations;
+
+    printf("# size %"PRIu64"\n", opts->size);
+    printf("# %-38s %10s %12s %10s %10s\n",
+           "operation", "iterations", "ns/op", "allocs/op", "maxrss KiB");
+
+    return EOK;
+}
+
+void sss_bench_run(const char *name, uint64_t iterations,
+                   sss_bench_fn fn, void *pvt)
+{
+    uint64_t allocs;
+    uint64_t start;
+    uint64_t end;
+    uint64_t i;
+
+    allocs = sss_bench_allocs;
+    start = sss_bench_now_ns();
+
+    for (i = 0; i < iterations; i++) {
+        fn(pvt, i);
+    }
+
+    end = sss_bench_now_ns();
+    allocs = sss_bench_allocs - allocs;
+
+    printf("%-40s %10"PRIu64" %12.1f %10.2f %10ld\n",
+           name, iterations,
+           (double) (end - start) / iterations,
+           (double) allocs / iterations,
+           sss_bench_maxrss_kb());
+    fflush(stdout);
+}
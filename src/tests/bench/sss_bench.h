@@ -0,0 +1,75 @@
+/*
+    SSSD
+
+    Micro-benchmark harness
+
+    Copyright (C) 2017 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SSS_BENCH_H__
+#define __SSS_BENCH_H__
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <talloc.h>
+
+#include "util/util.h"
+
+/*
+ * Every benchmark binary drives one component in-process. It prepares a
+ * data set of a given size and then calls sss_bench_run() for each
+ * operation it measures. The harness prints one line per operation:
+ *
+ *   name  iterations  ns/op  allocs/op  maxrss
+ *
+ * Allocations are counted by interposing malloc(), calloc() and realloc()
+ * of the whole process, so they include the allocations made by talloc,
+ * ldb, tdb and dhash. The maximum resident set size is the peak of the
+ * process so far as reported by getrusage().
+ */
+
+struct sss_bench_opts {
+    /* size of the data set, e.g. number of users */
+    uint64_t size;
+    /* number of times each operation is run */
+    uint64_t iterations;
+};
+
+/* The operation is called with i going from 0 to iterations - 1 */
+typedef void (*sss_bench_fn)(void *pvt, uint64_t i);
+
+/* Parse the common command line options, the defaults are taken from
+ * opts. Returns EOK or an errno code if the options are invalid. */
+errno_t sss_bench_init(int argc, const char *argv[],
+                       struct sss_bench_opts *opts);
+
+void sss_bench_run(const char *name, uint64_t iterations,
+                   sss_bench_fn fn, void *pvt);
+
+/* Abort the benchmark if an operation failed, results of a benchmark
+ * that does not do what it claims are worthless */
+#define sss_bench_assert(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: assertion failed: %s\n", \
+                __FILE__, __LINE__, #cond); \
+        abort(); \
+    } \
+} while (0)
+
+#endif /* __SSS_BENCH_H__ */
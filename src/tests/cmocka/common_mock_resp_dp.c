@@ -31,7 +31,7 @@ struct tevent_req *
 sss_dp_get_account_send(TALLOC_CTX *mem_ctx,
                         struct resp_ctx *rctx,
                         struct sss_domain_info *dom,
-                        bool fast_reply,
+                        uint32_t dp_flags,
                         enum sss_dp_acct_type type,
                         const char *opt_name,
                         uint32_t opt_id,
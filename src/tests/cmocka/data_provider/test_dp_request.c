@@ -408,6 +408,314 @@ static void test_fast_reply(void **state)
     talloc_free(md);
 }
 
+#define SCHED_MAX_REQS 8
+
+static struct {
+    uid_t executed[SCHED_MAX_REQS];
+    unsigned int num_executed;
+    unsigned int num_running;
+    unsigned int max_running;
+} sched_result;
+
+static void sched_handler_done(struct tevent_context *ev,
+                               struct tevent_timer *tt,
+                               struct timeval tv,
+                               void *pvt);
+
+static struct tevent_req *
+sched_handler_send(TALLOC_CTX *mem_ctx,
+                   struct method_data *md,
+                   struct req_data *req_data,
+                   struct dp_req_params *params)
+{
+    struct tevent_req *req;
+    struct test_state *state;
+    struct tevent_timer *tt;
+
+    req = tevent_req_create(mem_ctx, &state, struct test_state);
+    if (req == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_req_create failed.\n");
+        return NULL;
+    }
+
+    state->uid = req_data->uid;
+
+    assert_true(sched_result.num_executed < SCHED_MAX_REQS);
+    sched_result.executed[sched_result.num_executed++] = req_data->uid;
+    sched_result.num_running++;
+    sched_result.max_running = MAX(sched_result.max_running,
+                                   sched_result.num_running);
+
+    tt = tevent_add_timer(params->ev, req, tevent_timeval_current(),
+                          sched_handler_done, req);
+    if (tt == NULL) {
+        return NULL;
+    }
+
+    return req;
+}
+
+static void sched_handler_done(struct tevent_context *ev,
+                               struct tevent_timer *tt,
+                               struct timeval tv,
+                               void *pvt)
+{
+    struct tevent_req *req;
+
+    req = talloc_get_type(pvt, struct tevent_req);
+
+    sched_result.num_running--;
+    tevent_req_done(req);
+}
+
+static errno_t
+sched_handler_recv(TALLOC_CTX *mem_ctx,
+                   struct tevent_req *req,
+                   struct recv_data *recv_data)
+{
+    struct test_state *state;
+
+    state = tevent_req_data(req, struct test_state);
+
+    recv_data->name = talloc_asprintf(recv_data, "%"SPRIuid, state->uid);
+    if (recv_data->name == NULL) {
+        return ENOMEM;
+    }
+
+    return EOK;
+}
+
+static void sched_set_method(struct test_ctx *test_ctx,
+                             struct method_data *md,
+                             enum dp_targets target,
+                             enum dp_methods method)
+{
+    struct dp_method *methods;
+
+    methods = mock_dp_get_methods(test_ctx->provider, target);
+
+    dp_set_method(methods, method,
+                  sched_handler_send, sched_handler_recv,
+                  md,
+                  struct method_data, struct req_data, struct recv_data);
+}
+
+static struct tevent_req *sched_send(struct test_ctx *test_ctx,
+                                     struct dp_client *dp_cli,
+                                     enum dp_targets target,
+                                     enum dp_methods method,
+                                     uint32_t dp_flags,
+                                     uid_t uid)
+{
+    struct tevent_req *req;
+    struct req_data *req_data;
+
+    req_data = talloc_zero(test_ctx, struct req_data);
+    assert_non_null(req_data);
+    req_data->uid = uid;
+
+    /* req_data is stolen by the request */
+    req = dp_req_send(test_ctx, test_ctx->provider, dp_cli, NULL, REQ_NAME,
+                      target, method, dp_flags, req_data, NULL);
+    assert_non_null(req);
+
+    return req;
+}
+
+static void sched_check(struct test_ctx *test_ctx,
+                        struct tevent_req **reqs,
+                        errno_t *expected_ret,
+                        unsigned int num_reqs)
+{
+    struct recv_data *recv_data;
+    unsigned int i;
+    errno_t ret;
+
+    for (i = 0; i < num_reqs; i++) {
+        ret = dp_req_recv_ptr(test_ctx, reqs[i], struct recv_data, &recv_data);
+        assert_int_equal(ret, expected_ret == NULL ? EOK : expected_ret[i]);
+        if (ret == EOK) {
+            talloc_free(recv_data);
+        }
+        talloc_free(reqs[i]);
+    }
+}
+
+static void sched_reset(struct test_ctx *test_ctx,
+                        uint32_t max_active,
+                        uint32_t max_queued)
+{
+    memset(&sched_result, 0, sizeof(sched_result));
+    test_ctx->provider->requests.sched.max_active = max_active;
+    test_ctx->provider->requests.sched.max_queued = max_queued;
+}
+
+static void test_sched_max_active(void **state)
+{
+    struct test_ctx *test_ctx;
+    struct tevent_req *reqs[6];
+    struct method_data *md;
+    unsigned int i;
+
+    test_ctx = talloc_get_type(*state, struct test_ctx);
+
+    md = talloc(test_ctx, struct method_data);
+    assert_non_null(md);
+    sched_set_method(test_ctx, md, DPT_ID, DPM_ACCOUNT_HANDLER);
+
+    /* Identity lookups may use three quarters of the requests */
+    sched_reset(test_ctx, 4, 0);
+
+    for (i = 0; i < 6; i++) {
+        reqs[i] = sched_send(test_ctx, NULL, DPT_ID, DPM_ACCOUNT_HANDLER,
+                             0, i);
+    }
+
+    assert_int_equal(sched_result.num_executed, 3);
+
+    tevent_loop_wait(test_ctx->tctx->ev);
+
+    assert_int_equal(sched_result.num_executed, 6);
+    assert_int_equal(sched_result.max_running, 3);
+    for (i = 0; i < 6; i++) {
+        assert_int_equal(sched_result.executed[i], i);
+    }
+
+    assert_int_equal(test_ctx->provider->requests.sched.num_running, 0);
+    assert_int_equal(test_ctx->provider->requests.sched.queued[DP_REQ_CLASS_ID],
+                     0);
+
+    sched_check(test_ctx, reqs, NULL, 6);
+    talloc_free(md);
+}
+
+static void test_sched_priority(void **state)
+{
+    struct test_ctx *test_ctx;
+    struct tevent_req *reqs[5];
+    struct method_data *md;
+
+    test_ctx = talloc_get_type(*state, struct test_ctx);
+
+    md = talloc(test_ctx, struct method_data);
+    assert_non_null(md);
+    sched_set_method(test_ctx, md, DPT_ID, DPM_ACCOUNT_HANDLER);
+    sched_set_method(test_ctx, md, DPT_AUTH, DPM_AUTH_HANDLER);
+    sched_set_method(test_ctx, md, DPT_ACCESS, DPM_ACCESS_HANDLER);
+    sched_set_method(test_ctx, md, DPT_SUBDOMAINS, DPM_DOMAINS_HANDLER);
+
+    sched_reset(test_ctx, 1, 0);
+
+    reqs[0] = sched_send(test_ctx, NULL, DPT_ID, DPM_ACCOUNT_HANDLER, 0, 1);
+    reqs[1] = sched_send(test_ctx, NULL, DPT_ID, DPM_ACCOUNT_HANDLER, 0, 2);
+    reqs[2] = sched_send(test_ctx, NULL, DPT_SUBDOMAINS, DPM_DOMAINS_HANDLER,
+                         0, 3);
+    reqs[3] = sched_send(test_ctx, NULL, DPT_ACCESS, DPM_ACCESS_HANDLER, 0, 4);
+    reqs[4] = sched_send(test_ctx, NULL, DPT_AUTH, DPM_AUTH_HANDLER, 0, 5);
+
+    tevent_loop_wait(test_ctx->tctx->ev);
+
+    assert_int_equal(sched_result.num_executed, 5);
+    assert_int_equal(sched_result.max_running, 1);
+    assert_int_equal(sched_result.executed[0], 1);
+    assert_int_equal(sched_result.executed[1], 5);
+    assert_int_equal(sched_result.executed[2], 4);
+    assert_int_equal(sched_result.executed[3], 2);
+    assert_int_equal(sched_result.executed[4], 3);
+
+    sched_check(test_ctx, reqs, NULL, 5);
+    talloc_free(md);
+}
+
+static void test_sched_fairness(void **state)
+{
+    struct test_ctx *test_ctx;
+    struct tevent_req *reqs[5];
+    struct method_data *md;
+    struct dp_client *nss;
+    struct dp_client *ifp;
+
+    test_ctx = talloc_get_type(*state, struct test_ctx);
+
+    md = talloc(test_ctx, struct method_data);
+    assert_non_null(md);
+    sched_set_method(test_ctx, md, DPT_ID, DPM_ACCOUNT_HANDLER);
+
+    /* The scheduler only compares the client pointers */
+    nss = (struct dp_client *)talloc_new(test_ctx);
+    ifp = (struct dp_client *)talloc_new(test_ctx);
+    assert_non_null(nss);
+    assert_non_null(ifp);
+    test_ctx->provider->clients[DPC_NSS] = nss;
+    test_ctx->provider->clients[DPC_IFP] = ifp;
+
+    sched_reset(test_ctx, 1, 0);
+
+    reqs[0] = sched_send(test_ctx, nss, DPT_ID, DPM_ACCOUNT_HANDLER, 0, 1);
+    reqs[1] = sched_send(test_ctx, nss, DPT_ID, DPM_ACCOUNT_HANDLER, 0, 2);
+    reqs[2] = sched_send(test_ctx, nss, DPT_ID, DPM_ACCOUNT_HANDLER, 0, 3);
+    reqs[3] = sched_send(test_ctx, ifp, DPT_ID, DPM_ACCOUNT_HANDLER, 0, 4);
+    reqs[4] = sched_send(test_ctx, ifp, DPT_ID, DPM_ACCOUNT_HANDLER, 0, 5);
+
+    tevent_loop_wait(test_ctx->tctx->ev);
+
+    /* Clients take turns */
+    assert_int_equal(sched_result.num_executed, 5);
+    assert_int_equal(sched_result.executed[0], 1);
+    assert_int_equal(sched_result.executed[1], 2);
+    assert_int_equal(sched_result.executed[2], 4);
+    assert_int_equal(sched_result.executed[3], 3);
+    assert_int_equal(sched_result.executed[4], 5);
+
+    sched_check(test_ctx, reqs, NULL, 5);
+
+    test_ctx->provider->clients[DPC_NSS] = NULL;
+    test_ctx->provider->clients[DPC_IFP] = NULL;
+    talloc_free(nss);
+    talloc_free(ifp);
+    talloc_free(md);
+}
+
+static void test_sched_shed(void **state)
+{
+    struct test_ctx *test_ctx;
+    struct tevent_req *reqs[5];
+    errno_t expected_ret[] = { EOK, EOK, ERR_OFFLINE, EOK, EOK };
+    struct method_data *md;
+
+    test_ctx = talloc_get_type(*state, struct test_ctx);
+
+    md = talloc(test_ctx, struct method_data);
+    assert_non_null(md);
+    sched_set_method(test_ctx, md, DPT_ID, DPM_ACCOUNT_HANDLER);
+
+    sched_reset(test_ctx, 1, 1);
+
+    reqs[0] = sched_send(test_ctx, NULL, DPT_ID, DPM_ACCOUNT_HANDLER,
+                         DP_FAST_REPLY | DP_CACHED, 1);
+    reqs[1] = sched_send(test_ctx, NULL, DPT_ID, DPM_ACCOUNT_HANDLER,
+                         DP_FAST_REPLY | DP_CACHED, 2);
+    /* The queue is full, the responder has a cached record */
+    reqs[2] = sched_send(test_ctx, NULL, DPT_ID, DPM_ACCOUNT_HANDLER,
+                         DP_FAST_REPLY | DP_CACHED, 3);
+    /* The responder has nothing to return, the request must wait even
+     * though a fast reply was requested */
+    reqs[3] = sched_send(test_ctx, NULL, DPT_ID, DPM_ACCOUNT_HANDLER,
+                         DP_FAST_REPLY, 4);
+    reqs[4] = sched_send(test_ctx, NULL, DPT_ID, DPM_ACCOUNT_HANDLER, 0, 5);
+
+    tevent_loop_wait(test_ctx->tctx->ev);
+
+    assert_int_equal(sched_result.num_executed, 4);
+    assert_int_equal(sched_result.executed[0], 1);
+    assert_int_equal(sched_result.executed[1], 2);
+    assert_int_equal(sched_result.executed[2], 4);
+    assert_int_equal(sched_result.executed[3], 5);
+
+    sched_check(test_ctx, reqs, expected_ret, 5);
+    talloc_free(md);
+}
+
 int main(int argc, const char *argv[])
 {
     poptContext pc;
@@ -435,6 +743,18 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_nonexist_dom,
                                         test_setup,
                                         test_teardown),
+        cmocka_unit_test_setup_teardown(test_sched_max_active,
+                                        test_setup,
+                                        test_teardown),
+        cmocka_unit_test_setup_teardown(test_sched_priority,
+                                        test_setup,
+                                        test_teardown),
+        cmocka_unit_test_setup_teardown(test_sched_fairness,
+                                        test_setup,
+                                        test_teardown),
+        cmocka_unit_test_setup_teardown(test_sched_shed,
+                                        test_setup,
+                                        test_teardown),
     };
 
     /* Set debug level to invalid value so we can deside if -d 0 was used. */
@@ -0,0 +1,389 @@
+/*
+    SSSD
+
+    test_confdb_snapshot - Tests for the compiled confdb snapshot
+
+    Copyright (C) 2017 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <popt.h>
+#include <unistd.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "confdb/confdb.h"
+#include "confdb/confdb_private.h"
+
+#define TESTS_PATH "tp_" BASE_FILE_STEM
+#define TEST_CONF_DB "test_confdb_snapshot_conf.ldb"
+#define TEST_DOM_NAME "snapshot_test"
+#define TEST_DOM_SECTION "config/domain/" TEST_DOM_NAME
+
+struct snapshot_test_ctx {
+    char *conf_db;
+    char *snapshot;
+    struct confdb_ctx *cdb;
+};
+
+static void reopen_confdb(struct snapshot_test_ctx *test_ctx)
+{
+    errno_t ret;
+
+    talloc_zfree(test_ctx->cdb);
+    ret = confdb_init(test_ctx, &test_ctx->cdb, test_ctx->conf_db);
+    assert_int_equal(ret, EOK);
+}
+
+static int snapshot_test_setup(void **state)
+{
+    struct snapshot_test_ctx *test_ctx;
+    const char *val[2] = { NULL, NULL };
+    const char *multi[] = { "first", "second", NULL };
+    errno_t ret;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context, struct snapshot_test_ctx);
+    assert_non_null(test_ctx);
+
+    test_ctx->conf_db = talloc_asprintf(test_ctx, "%s/%s",
+                                        TESTS_PATH, TEST_CONF_DB);
+    assert_non_null(test_ctx->conf_db);
+
+    test_ctx->snapshot = talloc_asprintf(test_ctx, "%s/%s",
+                                         TESTS_PATH, CONFDB_SNAPSHOT_FILE);
+    assert_non_null(test_ctx->snapshot);
+
+    ret = confdb_init(test_ctx, &test_ctx->cdb, test_ctx->conf_db);
+    assert_int_equal(ret, EOK);
+
+    val[0] = "bar";
+    ret = confdb_add_param(test_ctx->cdb, true, TEST_DOM_SECTION, "foo", val);
+    assert_int_equal(ret, EOK);
+
+    val[0] = "42";
+    ret = confdb_add_param(test_ctx->cdb, true, TEST_DOM_SECTION,
+                           "answer", val);
+    assert_int_equal(ret, EOK);
+
+    ret = confdb_add_param(test_ctx->cdb, true, TEST_DOM_SECTION,
+                           "multi", multi);
+    assert_int_equal(ret, EOK);
+
+    val[0] = "TRUE";
+    ret = confdb_add_param(test_ctx->cdb, true, "config/nss", "flag", val);
+    assert_int_equal(ret, EOK);
+
+    val[0] = "ldap";
+    ret = confdb_add_param(test_ctx->cdb, true, TEST_DOM_SECTION,
+                           CONFDB_DOMAIN_ID_PROVIDER, val);
+    assert_int_equal(ret, EOK);
+
+    val[0] = TEST_DOM_NAME;
+    ret = confdb_add_param(test_ctx->cdb, true, CONFDB_MONITOR_CONF_ENTRY,
+                           CONFDB_MONITOR_ACTIVE_DOMAINS, val);
+    assert_int_equal(ret, EOK);
+
+    ret = confdb_snapshot_write(test_ctx->cdb, test_ctx->snapshot);
+    assert_int_equal(ret, EOK);
+
+    check_leaks_push(test_ctx);
+    *state = test_ctx;
+    return 0;
+}
+
+static int snapshot_test_teardown(void **state)
+{
+    struct snapshot_test_ctx *test_ctx;
+
+    test_ctx = talloc_get_type(*state, struct snapshot_test_ctx);
+
+    assert_true(check_leaks_pop(test_ctx));
+
+    unlink(test_ctx->snapshot);
+    unlink(test_ctx->conf_db);
+    talloc_free(test_ctx);
+
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+static void test_snapshot_read(void **state)
+{
+    struct snapshot_test_ctx *test_ctx;
+    char **values;
+    char *str;
+    bool flag;
+    int num;
+    errno_t ret;
+
+    test_ctx = talloc_get_type(*state, struct snapshot_test_ctx);
+
+    reopen_confdb(test_ctx);
+    assert_non_null(test_ctx->cdb->snapshot);
+
+    ret = confdb_get_string(test_ctx->cdb, test_ctx, TEST_DOM_SECTION,
+                            "foo", NULL, &str);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(str, "bar");
+    talloc_free(str);
+
+    /* attribute names are case insensitive like in ldb */
+    ret = confdb_get_int(test_ctx->cdb, TEST_DOM_SECTION, "ANSWER", 0, &num);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(num, 42);
+
+    ret = confdb_get_bool(test_ctx->cdb, "config/nss", "flag", false, &flag);
+    assert_int_equal(ret, EOK);
+    assert_true(flag);
+
+    ret = confdb_get_param(test_ctx->cdb, test_ctx, TEST_DOM_SECTION,
+                           "multi", &values);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(values[0], "first");
+    assert_string_equal(values[1], "second");
+    assert_null(values[2]);
+    talloc_free(values);
+
+    /* missing options and sections give the default */
+    ret = confdb_get_int(test_ctx->cdb, TEST_DOM_SECTION, "missing", 7, &num);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(num, 7);
+
+    ret = confdb_get_string(test_ctx->cdb, test_ctx, "config/pam",
+                            "foo", "default", &str);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(str, "default");
+    talloc_free(str);
+
+    /* the snapshot is still in use, nothing fell back to the confdb */
+    assert_non_null(test_ctx->cdb->snapshot);
+    talloc_zfree(test_ctx->cdb);
+}
+
+static void test_snapshot_stale(void **state)
+{
+    struct snapshot_test_ctx *test_ctx;
+    const char *val[2] = { "changed", NULL };
+    char *str;
+    errno_t ret;
+
+    test_ctx = talloc_get_type(*state, struct snapshot_test_ctx);
+
+    /* modified after the snapshot was written */
+    ret = confdb_add_param(test_ctx->cdb, true, TEST_DOM_SECTION, "foo", val);
+    assert_int_equal(ret, EOK);
+
+    reopen_confdb(test_ctx);
+    assert_null(test_ctx->cdb->snapshot);
+
+    ret = confdb_get_string(test_ctx->cdb, test_ctx, TEST_DOM_SECTION,
+                            "foo", NULL, &str);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(str, "changed");
+    talloc_free(str);
+
+    talloc_zfree(test_ctx->cdb);
+}
+
+static void test_snapshot_own_write(void **state)
+{
+    struct snapshot_test_ctx *test_ctx;
+    char *str;
+    errno_t ret;
+
+    test_ctx = talloc_get_type(*state, struct snapshot_test_ctx);
+
+    reopen_confdb(test_ctx);
+    assert_non_null(test_ctx->cdb->snapshot);
+
+    ret = confdb_set_string(test_ctx->cdb, TEST_DOM_SECTION, "foo", "mine");
+    assert_int_equal(ret, EOK);
+    assert_null(test_ctx->cdb->snapshot);
+
+    ret = confdb_get_string(test_ctx->cdb, test_ctx, TEST_DOM_SECTION,
+                            "foo", NULL, &str);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(str, "mine");
+    talloc_free(str);
+
+    talloc_zfree(test_ctx->cdb);
+}
+
+static void test_snapshot_foreign_write(void **state)
+{
+    struct snapshot_test_ctx *test_ctx;
+    struct confdb_ctx *other;
+    char *str;
+    errno_t ret;
+
+    test_ctx = talloc_get_type(*state, struct snapshot_test_ctx);
+
+    reopen_confdb(test_ctx);
+    assert_non_null(test_ctx->cdb->snapshot);
+
+    /* e.g. sss_debuglevel changing the confdb of a running process */
+    ret = confdb_init(test_ctx, &other, test_ctx->conf_db);
+    assert_int_equal(ret, EOK);
+
+    ret = confdb_set_string(other, TEST_DOM_SECTION, "foo", "theirs");
+    assert_int_equal(ret, EOK);
+    talloc_free(other);
+
+    /* the writer removes the file */
+    assert_int_equal(access(test_ctx->snapshot, F_OK), -1);
+
+    /* the confdb is not checked again until the snapshot is refreshed */
+    ret = confdb_get_string(test_ctx->cdb, test_ctx, TEST_DOM_SECTION,
+                            "foo", NULL, &str);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(str, "bar");
+    talloc_free(str);
+
+    confdb_refresh_snapshot(test_ctx->cdb);
+    assert_null(test_ctx->cdb->snapshot);
+
+    ret = confdb_get_string(test_ctx->cdb, test_ctx, TEST_DOM_SECTION,
+                            "foo", NULL, &str);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(str, "theirs");
+    talloc_free(str);
+
+    /* the monitor writes a new snapshot on SIGHUP */
+    ret = confdb_snapshot_write(test_ctx->cdb, test_ctx->snapshot);
+    assert_int_equal(ret, EOK);
+
+    confdb_refresh_snapshot(test_ctx->cdb);
+    assert_non_null(test_ctx->cdb->snapshot);
+
+    ret = confdb_get_string(test_ctx->cdb, test_ctx, TEST_DOM_SECTION,
+                            "foo", NULL, &str);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(str, "theirs");
+    talloc_free(str);
+
+    talloc_zfree(test_ctx->cdb);
+}
+
+static void test_snapshot_domain(void **state)
+{
+    struct snapshot_test_ctx *test_ctx;
+    struct sss_domain_info *dom;
+    struct confdb_ctx *other;
+    errno_t ret;
+
+    test_ctx = talloc_get_type(*state, struct snapshot_test_ctx);
+
+    reopen_confdb(test_ctx);
+    assert_non_null(test_ctx->cdb->snapshot);
+
+    /* only visible in the confdb, the domain must come from the snapshot */
+    ret = confdb_init(test_ctx, &other, test_ctx->conf_db);
+    assert_int_equal(ret, EOK);
+
+    ret = confdb_set_string(other, TEST_DOM_SECTION,
+                            CONFDB_DOMAIN_ID_PROVIDER, "proxy");
+    assert_int_equal(ret, EOK);
+    talloc_free(other);
+
+    ret = confdb_get_domain(test_ctx->cdb, TEST_DOM_NAME, &dom);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(dom->name, TEST_DOM_NAME);
+    assert_string_equal(dom->provider, "ldap");
+    assert_non_null(test_ctx->cdb->snapshot);
+
+    talloc_zfree(test_ctx->cdb);
+}
+
+static void test_snapshot_damaged(void **state)
+{
+    struct snapshot_test_ctx *test_ctx;
+    FILE *f;
+
+    test_ctx = talloc_get_type(*state, struct snapshot_test_ctx);
+
+    f = fopen(test_ctx->snapshot, "w");
+    assert_non_null(f);
+    fputs("not a snapshot", f);
+    fclose(f);
+
+    reopen_confdb(test_ctx);
+    assert_null(test_ctx->cdb->snapshot);
+
+    talloc_zfree(test_ctx->cdb);
+}
+
+int main(int argc, const char *argv[])
+{
+    poptContext pc;
+    int opt;
+    int rv;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_snapshot_read,
+                                        snapshot_test_setup,
+                                        snapshot_test_teardown),
+        cmocka_unit_test_setup_teardown(test_snapshot_stale,
+                                        snapshot_test_setup,
+                                        snapshot_test_teardown),
+        cmocka_unit_test_setup_teardown(test_snapshot_own_write,
+                                        snapshot_test_setup,
+                                        snapshot_test_teardown),
+        cmocka_unit_test_setup_teardown(test_snapshot_foreign_write,
+                                        snapshot_test_setup,
+                                        snapshot_test_teardown),
+        cmocka_unit_test_setup_teardown(test_snapshot_domain,
+                                        snapshot_test_setup,
+                                        snapshot_test_teardown),
+        cmocka_unit_test_setup_teardown(test_snapshot_damaged,
+                                        snapshot_test_setup,
+                                        snapshot_test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    /* Even though normally the tests should clean up after themselves
+     * they might not after a failed run. Remove the old db to be sure */
+    tests_set_cwd();
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    test_dom_suite_setup(TESTS_PATH);
+
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+    if (rv == 0) {
+        test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    }
+    return rv;
+}
@@ -29,6 +29,7 @@
 #include <sys/types.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <sys/time.h>
 
 #include "providers/fail_over_srv.h"
 #include "tests/cmocka/common_mock.h"
@@ -38,6 +39,8 @@
 #define TEST_FO_TIMEOUT     3000
 #define TEST_SRV_TTL        500
 #define TEST_SRV_SHORT_TTL  2
+#define TEST_RACE_DELAY     10
+#define TEST_RESOLV_PENDING 4
 
 static TALLOC_CTX *global_mock_context = NULL;
 
@@ -55,19 +58,110 @@ int resolv_init(TALLOC_CTX *mem_ctx, struct tevent_context *ev_ctx,
     return EOK;
 }
 
+/* Host names are resolved right away unless the test made them slow with
+ * test_resolv_slow(), those are only resolved by test_resolv_finish() */
+struct test_resolv_host {
+    const char *name;
+    bool slow;
+    struct tevent_req *req;
+};
+
+static struct test_resolv_host test_resolv_hosts[TEST_RESOLV_PENDING];
+static const char *test_resolv_requested[TEST_RESOLV_PENDING];
+static int test_resolv_num_requested;
+
+static void test_resolv_reset(void)
+{
+    memset(test_resolv_hosts, 0, sizeof(test_resolv_hosts));
+    memset(test_resolv_requested, 0, sizeof(test_resolv_requested));
+    test_resolv_num_requested = 0;
+}
+
+static struct test_resolv_host *test_resolv_find(const char *name)
+{
+    int i;
+
+    for (i = 0; i < TEST_RESOLV_PENDING; i++) {
+        if (test_resolv_hosts[i].name != NULL
+                && strcmp(test_resolv_hosts[i].name, name) == 0) {
+            return &test_resolv_hosts[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void test_resolv_slow(const char *name)
+{
+    int i;
+
+    for (i = 0; i < TEST_RESOLV_PENDING; i++) {
+        if (test_resolv_hosts[i].name == NULL) {
+            test_resolv_hosts[i].name = name;
+            test_resolv_hosts[i].slow = true;
+            return;
+        }
+    }
+
+    fail_msg("Too many slow hosts");
+}
+
+static void test_resolv_finish(const char *name, errno_t ret)
+{
+    struct test_resolv_host *host;
+    struct tevent_req *req;
+
+    host = test_resolv_find(name);
+    assert_non_null(host);
+    assert_non_null(host->req);
+
+    req = host->req;
+    host->req = NULL;
+    host->slow = false;
+
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+}
+
 struct tevent_req *
 resolv_gethostbyname_send(TALLOC_CTX *mem_ctx, struct tevent_context *ev,
                           struct resolv_ctx *ctx, const char *name,
                           enum restrict_family family_order,
                           enum host_database *db)
 {
-    return test_req_succeed_send(mem_ctx, ev);
+    struct test_resolv_host *host;
+    struct tevent_req *req;
+    int *state;
+
+    if (test_resolv_num_requested < TEST_RESOLV_PENDING) {
+        test_resolv_requested[test_resolv_num_requested] = name;
+    }
+    test_resolv_num_requested++;
+
+    host = test_resolv_find(name);
+    if (host == NULL || !host->slow) {
+        return test_req_succeed_send(mem_ctx, ev);
+    }
+
+    assert_null(host->req);
+    req = tevent_req_create(mem_ctx, &state, int);
+    assert_non_null(req);
+    host->req = req;
+
+    return req;
 }
 
 int resolv_gethostbyname_recv(struct tevent_req *req, TALLOC_CTX *mem_ctx,
                               int *status, int *timeouts,
                               struct resolv_hostent **rhostent)
 {
+    if (status != NULL) {
+        *status = 0;
+    }
+
     return test_request_recv(req);
 }
 
@@ -193,6 +287,31 @@ errno_t resolv_get_domain_recv(TALLOC_CTX *mem_ctx,
     return test_request_recv(req);
 }
 
+/* Fail over measures the latency of the servers with gettimeofday(), the
+ * tests move its clock forward instead of sleeping */
+static struct timeval test_clock_offset;
+
+int __real_gettimeofday(struct timeval *tv, void *tz);
+
+int __wrap_gettimeofday(struct timeval *tv, void *tz)
+{
+    int ret;
+
+    ret = __real_gettimeofday(tv, tz);
+    if (ret == 0) {
+        timeradd(tv, &test_clock_offset, tv);
+    }
+
+    return ret;
+}
+
+static void test_clock_advance(int ms)
+{
+    struct timeval tv = { ms / 1000, (ms % 1000) * 1000 };
+
+    timeradd(&test_clock_offset, &tv, &test_clock_offset);
+}
+
 /* The unit test */
 struct test_fo_ctx {
     struct resolv_ctx *resolv;
@@ -212,7 +331,7 @@ int test_fo_srv_data_cmp(void *ud1, void *ud2)
     return strcasecmp((char*) ud1, (char*) ud2);
 }
 
-static int test_fo_setup(void **state)
+static int test_fo_setup_common(void **state, int race_servers)
 {
     struct test_fo_ctx *test_ctx;
     errno_t ret;
@@ -236,6 +355,12 @@ static int test_fo_setup(void **state)
     memset(&fopts, 0, sizeof(fopts));
     fopts.retry_timeout = TEST_FO_TIMEOUT;
     fopts.family_order  = IPV4_FIRST;
+    fopts.service_resolv_timeout = TEST_RESOLV_TIMEOUT;
+    fopts.race_servers = race_servers;
+    fopts.race_delay = TEST_RACE_DELAY;
+
+    test_resolv_reset();
+    timerclear(&test_clock_offset);
 
     test_ctx->fo_ctx = fo_context_init(test_ctx, &fopts);
     assert_non_null(test_ctx->fo_ctx);
@@ -249,6 +374,16 @@ static int test_fo_setup(void **state)
     return 0;
 }
 
+static int test_fo_setup(void **state)
+{
+    return test_fo_setup_common(state, 0);
+}
+
+static int test_fo_race_setup(void **state)
+{
+    return test_fo_setup_common(state, 3);
+}
+
 static int test_fo_teardown(void **state)
 {
     struct test_fo_ctx *test_ctx =
@@ -693,6 +828,243 @@ static void test_fo_hostlist(void **state)
     assert_int_equal(ret, ERR_OK);
 }
 
+static void test_fo_resolve_done(struct tevent_req *req)
+{
+    struct test_fo_ctx *test_ctx = \
+        tevent_req_callback_data(req, struct test_fo_ctx);
+    errno_t ret;
+
+    ret = fo_resolve_service_recv(req, test_ctx, &test_ctx->srv);
+    talloc_zfree(req);
+
+    test_ctx->ctx->error = ret;
+    test_ctx->ctx->done = true;
+}
+
+static void test_fo_resolve_send(struct test_fo_ctx *test_ctx)
+{
+    struct tevent_req *req;
+
+    test_ctx->ctx->done = false;
+    test_ctx->ctx->error = ERR_OK;
+    test_ctx->srv = NULL;
+
+    req = fo_resolve_service_send(test_ctx, test_ctx->ctx->ev,
+                                  test_ctx->resolv, test_ctx->fo_ctx,
+                                  test_ctx->fo_svc);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_fo_resolve_done, test_ctx);
+}
+
+static struct fo_server *test_fo_resolve(struct test_fo_ctx *test_ctx)
+{
+    errno_t ret;
+
+    test_fo_resolve_send(test_ctx);
+
+    ret = test_ev_loop(test_ctx->ctx);
+    assert_int_equal(ret, ERR_OK);
+
+    return test_ctx->srv;
+}
+
+static void test_fo_add_servers(struct test_fo_ctx *test_ctx, int num)
+{
+    char *name;
+    errno_t ret;
+    int i;
+
+    for (i = 1; i <= num; i++) {
+        name = talloc_asprintf(test_ctx, "ldap%d.sssd.com", i);
+        assert_non_null(name);
+
+        ret = fo_add_server(test_ctx->fo_svc, name, 389, test_ctx, true);
+        assert_int_equal(ret, ERR_OK);
+    }
+}
+
+/* Resolve the service, report the server as working after ms milliseconds
+ * and move on to the next server */
+static void test_fo_connect(struct test_fo_ctx *test_ctx,
+                            const char *expected, int ms)
+{
+    struct fo_server *srv;
+
+    srv = test_fo_resolve(test_ctx);
+    check_server(test_ctx, srv, 389, expected);
+
+    test_clock_advance(ms);
+    fo_set_port_status(srv, PORT_WORKING);
+    fo_try_next_server(test_ctx->fo_svc);
+}
+
+/* Test that a considerably faster server of the same tier is preferred
+ * over the one that would be tried otherwise */
+static void test_fo_latency(void **state)
+{
+    struct fo_server *srv;
+    struct test_fo_ctx *test_ctx =
+        talloc_get_type(*state, struct test_fo_ctx);
+
+    test_fo_add_servers(test_ctx, 2);
+
+    /* Servers without latency data are tried in the configured order */
+    test_fo_connect(test_ctx, "ldap1.sssd.com", 100);
+    test_fo_connect(test_ctx, "ldap2.sssd.com", 120);
+
+    /* ldap2 was tried last and ldap1 is not 25% faster */
+    fo_reset_servers(test_ctx->fo_svc);
+    test_fo_connect(test_ctx, "ldap2.sssd.com", 1000);
+
+    /* The average latency of ldap2 grew to 230ms, ldap1 is preferred */
+    fo_reset_servers(test_ctx->fo_svc);
+    srv = test_fo_resolve(test_ctx);
+    check_server(test_ctx, srv, 389, "ldap1.sssd.com");
+
+    /* Failures count as well, ldap2 is preferred over a failing ldap1 */
+    fo_set_port_status(srv, PORT_NOT_WORKING);
+    fo_reset_servers(test_ctx->fo_svc);
+
+    srv = test_fo_resolve(test_ctx);
+    check_server(test_ctx, srv, 389, "ldap2.sssd.com");
+}
+
+static void test_fo_race_wait_requested(struct test_fo_ctx *test_ctx,
+                                        int num)
+{
+    while (test_resolv_num_requested < num && !test_ctx->ctx->done) {
+        tevent_loop_once(test_ctx->ctx->ev);
+    }
+
+    assert_int_equal(test_resolv_num_requested, num);
+}
+
+static void test_fo_race_timer(struct tevent_context *ev,
+                               struct tevent_timer *te,
+                               struct timeval tv, void *pvt)
+{
+    bool *fired = pvt;
+
+    *fired = true;
+}
+
+/* Run the event loop long enough for the race to try another server */
+static void test_fo_race_idle(struct test_fo_ctx *test_ctx)
+{
+    struct tevent_timer *te;
+    struct timeval tv;
+    bool fired = false;
+
+    tv = tevent_timeval_current_ofs(0, 3 * TEST_RACE_DELAY * 1000);
+    te = tevent_add_timer(test_ctx->ctx->ev, test_ctx, tv,
+                          test_fo_race_timer, &fired);
+    assert_non_null(te);
+
+    while (!fired) {
+        tevent_loop_once(test_ctx->ctx->ev);
+    }
+}
+
+/* Test that a slow name resolution is raced with the next server of the
+ * same priority and that the server resolved first is returned */
+static void test_fo_race(void **state)
+{
+    errno_t ret;
+    struct fo_server *srv;
+    struct test_fo_ctx *test_ctx =
+        talloc_get_type(*state, struct test_fo_ctx);
+
+    test_fo_add_servers(test_ctx, 4);
+    test_resolv_slow("ldap1.sssd.com");
+    test_resolv_slow("ldap2.sssd.com");
+
+    test_fo_resolve_send(test_ctx);
+
+    /* ldap1 does not resolve in time, ldap2 is tried as well */
+    test_fo_race_wait_requested(test_ctx, 2);
+    assert_string_equal(test_resolv_requested[0], "ldap1.sssd.com");
+    assert_string_equal(test_resolv_requested[1], "ldap2.sssd.com");
+    assert_false(test_ctx->ctx->done);
+
+    test_resolv_finish("ldap2.sssd.com", EOK);
+
+    ret = test_ev_loop(test_ctx->ctx);
+    assert_int_equal(ret, ERR_OK);
+    check_server(test_ctx, test_ctx->srv, 389, "ldap2.sssd.com");
+
+    /* The race is over, ldap3 is not tried */
+    test_fo_race_idle(test_ctx);
+    assert_int_equal(test_resolv_num_requested, 2);
+
+    /* ldap1 finishes in the background */
+    test_resolv_finish("ldap1.sssd.com", EIO);
+    test_fo_race_idle(test_ctx);
+
+    /* ldap2 is used from now on */
+    srv = test_fo_resolve(test_ctx);
+    check_server(test_ctx, srv, 389, "ldap2.sssd.com");
+    assert_int_equal(test_resolv_num_requested, 2);
+}
+
+/* Test that the race is limited to failover_race_servers servers and
+ * that the originally selected server wins when it resolves first */
+static void test_fo_race_first_wins(void **state)
+{
+    errno_t ret;
+    struct test_fo_ctx *test_ctx =
+        talloc_get_type(*state, struct test_fo_ctx);
+
+    test_fo_add_servers(test_ctx, 4);
+    test_resolv_slow("ldap1.sssd.com");
+    test_resolv_slow("ldap2.sssd.com");
+    test_resolv_slow("ldap3.sssd.com");
+
+    test_fo_resolve_send(test_ctx);
+
+    test_fo_race_wait_requested(test_ctx, 3);
+    assert_string_equal(test_resolv_requested[2], "ldap3.sssd.com");
+
+    /* No more than three servers are raced */
+    test_fo_race_idle(test_ctx);
+    assert_int_equal(test_resolv_num_requested, 3);
+    assert_false(test_ctx->ctx->done);
+
+    test_resolv_finish("ldap1.sssd.com", EOK);
+
+    ret = test_ev_loop(test_ctx->ctx);
+    assert_int_equal(ret, ERR_OK);
+    check_server(test_ctx, test_ctx->srv, 389, "ldap1.sssd.com");
+
+    test_resolv_finish("ldap3.sssd.com", EOK);
+    test_resolv_finish("ldap2.sssd.com", EOK);
+    test_fo_race_idle(test_ctx);
+}
+
+/* Test that the error of the originally selected server is returned when
+ * none of the raced servers resolves */
+static void test_fo_race_fail(void **state)
+{
+    errno_t ret;
+    struct test_fo_ctx *test_ctx =
+        talloc_get_type(*state, struct test_fo_ctx);
+
+    test_fo_add_servers(test_ctx, 2);
+    test_resolv_slow("ldap1.sssd.com");
+    test_resolv_slow("ldap2.sssd.com");
+
+    test_fo_resolve_send(test_ctx);
+    test_fo_race_wait_requested(test_ctx, 2);
+
+    test_resolv_finish("ldap2.sssd.com", ENOENT);
+    test_fo_race_idle(test_ctx);
+    assert_false(test_ctx->ctx->done);
+
+    test_resolv_finish("ldap1.sssd.com", EIO);
+
+    ret = test_ev_loop(test_ctx->ctx);
+    assert_int_equal(ret, EIO);
+}
+
 static void test_fo_srv_dup_done(struct tevent_req *req);
 
 /* Test that running two parallel SRV queries doesn't return an error.
@@ -778,6 +1150,18 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_fo_srv_ttl_zero,
                                         test_fo_srv_setup,
                                         test_fo_srv_teardown),
+        cmocka_unit_test_setup_teardown(test_fo_latency,
+                                        test_fo_setup,
+                                        test_fo_teardown),
+        cmocka_unit_test_setup_teardown(test_fo_race,
+                                        test_fo_race_setup,
+                                        test_fo_teardown),
+        cmocka_unit_test_setup_teardown(test_fo_race_first_wins,
+                                        test_fo_race_setup,
+                                        test_fo_teardown),
+        cmocka_unit_test_setup_teardown(test_fo_race_fail,
+                                        test_fo_race_setup,
+                                        test_fo_teardown),
         cmocka_unit_test_setup_teardown(test_fo_srv_duplicates,
                                         test_fo_srv_setup,
                                         test_fo_srv_teardown),
@@ -0,0 +1,312 @@
+/*
+    Copyright (C) 2017 Red Hat
+
+    SSSD tests: Test KCM binary marshalling
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <popt.h>
+
+#include "util/util_creds.h"
+#include "responder/kcm/kcmsrv_ccache.h"
+#include "responder/kcm/kcmsrv_ccache_be.h"
+#include "tests/cmocka/common_mock.h"
+
+#define TEST_REALM                "TESTREALM"
+#define TEST_PRINC_COMPONENT      "PRINC_NAME"
+#define TEST_PRINC_INSTANCE       "host.example.com"
+
+#define TEST_CREDS                "TESTCREDS"
+#define TEST_CREDS2               "TESTCREDS2"
+
+const struct kcm_ccdb_ops ccdb_mem_ops;
+const struct kcm_ccdb_ops ccdb_sec_ops;
+const struct kcm_ccdb_ops ccdb_tdb_ops;
+
+struct kcm_marshalling_test_ctx {
+    krb5_context kctx;
+    krb5_principal princ;
+    struct cli_creds owner;
+};
+
+static int setup_kcm_marshalling(void **state)
+{
+    struct kcm_marshalling_test_ctx *test_ctx;
+    krb5_error_code kerr;
+
+    test_ctx = talloc_zero(NULL, struct kcm_marshalling_test_ctx);
+    assert_non_null(test_ctx);
+
+    kerr = krb5_init_context(&test_ctx->kctx);
+    assert_int_equal(kerr, 0);
+
+    kerr = krb5_build_principal(test_ctx->kctx,
+                                &test_ctx->princ,
+                                sizeof(TEST_REALM)-1, TEST_REALM,
+                                TEST_PRINC_COMPONENT, TEST_PRINC_INSTANCE,
+                                NULL);
+    assert_int_equal(kerr, 0);
+
+    test_ctx->owner.ucred.uid = getuid();
+    test_ctx->owner.ucred.gid = getgid();
+
+    *state = test_ctx;
+    return 0;
+}
+
+static int teardown_kcm_marshalling(void **state)
+{
+    struct kcm_marshalling_test_ctx *test_ctx = talloc_get_type(*state,
+                                        struct kcm_marshalling_test_ctx);
+    assert_non_null(test_ctx);
+
+    krb5_free_principal(test_ctx->kctx, test_ctx->princ);
+    krb5_free_context(test_ctx->kctx);
+    talloc_free(test_ctx);
+    return 0;
+}
+
+static struct kcm_ccache *create_test_ccache(struct kcm_marshalling_test_ctx *test_ctx)
+{
+    struct kcm_ccache *cc;
+    const char *name;
+    errno_t ret;
+
+    name = talloc_asprintf(test_ctx, "%"SPRIuid, getuid());
+    assert_non_null(name);
+
+    ret = kcm_cc_new(test_ctx,
+                     test_ctx->kctx,
+                     &test_ctx->owner,
+                     name,
+                     test_ctx->princ,
+                     &cc);
+    assert_int_equal(ret, EOK);
+
+    return cc;
+}
+
+static void store_test_cred(struct kcm_ccache *cc, const char *data)
+{
+    struct sss_iobuf *cred_blob;
+    errno_t ret;
+
+    cred_blob = sss_iobuf_init_readonly(cc, (const uint8_t *) data,
+                                        strlen(data) + 1);
+    assert_non_null(cred_blob);
+
+    ret = kcm_cc_store_cred_blob(cc, cred_blob);
+    assert_int_equal(ret, EOK);
+}
+
+static void assert_cc_equal(struct kcm_ccache *cc1,
+                            struct kcm_ccache *cc2)
+{
+    uuid_t u1, u2;
+    char *name1;
+    char *name2;
+    krb5_error_code kerr;
+    errno_t ret;
+
+    assert_string_equal(kcm_cc_get_name(cc1), kcm_cc_get_name(cc2));
+
+    ret = kcm_cc_get_uuid(cc1, u1);
+    assert_int_equal(ret, EOK);
+    ret = kcm_cc_get_uuid(cc2, u2);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(uuid_compare(u1, u2), 0);
+
+    kerr = krb5_unparse_name(NULL, kcm_cc_get_client_principal(cc1), &name1);
+    assert_int_equal(kerr, 0);
+    kerr = krb5_unparse_name(NULL, kcm_cc_get_client_principal(cc2), &name2);
+    assert_int_equal(kerr, 0);
+    assert_string_equal(name1, name2);
+    krb5_free_unparsed_name(NULL, name1);
+    krb5_free_unparsed_name(NULL, name2);
+
+    assert_int_equal(kcm_cc_get_offset(cc1), kcm_cc_get_offset(cc2));
+}
+
+static void test_kcm_ccache_binary_no_creds(void **state)
+{
+    struct kcm_marshalling_test_ctx *test_ctx = talloc_get_type(*state,
+                                        struct kcm_marshalling_test_ctx);
+    struct kcm_ccache *cc;
+    struct kcm_ccache *cc2;
+    struct sss_iobuf *payload;
+    uuid_t *cred_uuids;
+    size_t num_creds;
+    errno_t ret;
+
+    cc = create_test_ccache(test_ctx);
+
+    ret = kcm_ccache_to_binary(test_ctx, cc, &payload);
+    assert_int_equal(ret, EOK);
+
+    ret = kcm_binary_to_ccache(test_ctx,
+                               sss_iobuf_get_data(payload),
+                               sss_iobuf_get_len(payload),
+                               &cc2, &cred_uuids, &num_creds);
+    assert_int_equal(ret, EOK);
+
+    assert_cc_equal(cc, cc2);
+    assert_int_equal(num_creds, 0);
+    assert_null(kcm_cc_get_cred(cc2));
+
+    talloc_free(cc);
+    talloc_free(cc2);
+    talloc_free(payload);
+}
+
+static void test_kcm_ccache_binary_creds(void **state)
+{
+    struct kcm_marshalling_test_ctx *test_ctx = talloc_get_type(*state,
+                                        struct kcm_marshalling_test_ctx);
+    struct kcm_ccache *cc;
+    struct kcm_ccache *cc2;
+    struct kcm_cred *crd;
+    struct kcm_mod_ctx mod_ctx;
+    struct sss_iobuf *payload;
+    uuid_t *cred_uuids;
+    uuid_t cred_uuid;
+    size_t num_creds;
+    size_t i;
+    errno_t ret;
+
+    cc = create_test_ccache(test_ctx);
+    store_test_cred(cc, TEST_CREDS);
+    store_test_cred(cc, TEST_CREDS2);
+
+    kcm_mod_ctx_clear(&mod_ctx);
+    mod_ctx.kdc_offset = 42;
+    kcm_mod_cc(cc, &mod_ctx);
+
+    ret = kcm_ccache_to_binary(test_ctx, cc, &payload);
+    assert_int_equal(ret, EOK);
+
+    ret = kcm_binary_to_ccache(test_ctx,
+                               sss_iobuf_get_data(payload),
+                               sss_iobuf_get_len(payload),
+                               &cc2, &cred_uuids, &num_creds);
+    assert_int_equal(ret, EOK);
+
+    assert_cc_equal(cc, cc2);
+    assert_int_equal(kcm_cc_get_offset(cc2), 42);
+
+    /* Only the UUIDs of the credentials are stored in the header, in
+     * the same order as in the ccache */
+    assert_int_equal(num_creds, 2);
+    for (crd = kcm_cc_get_cred(cc), i = 0;
+         crd != NULL;
+         crd = kcm_cc_next_cred(crd), i++) {
+        ret = kcm_cred_get_uuid(crd, cred_uuid);
+        assert_int_equal(ret, EOK);
+        assert_int_equal(uuid_compare(cred_uuid, cred_uuids[i]), 0);
+    }
+    assert_int_equal(i, 2);
+    assert_null(kcm_cc_get_cred(cc2));
+
+    talloc_free(cc);
+    talloc_free(cc2);
+    talloc_free(payload);
+}
+
+static void test_kcm_ccache_binary_malformed(void **state)
+{
+    struct kcm_marshalling_test_ctx *test_ctx = talloc_get_type(*state,
+                                        struct kcm_marshalling_test_ctx);
+    struct kcm_ccache *cc;
+    struct kcm_ccache *cc2 = NULL;
+    struct sss_iobuf *payload;
+    uuid_t *cred_uuids;
+    size_t num_creds;
+    uint8_t *data;
+    size_t len;
+    errno_t ret;
+
+    cc = create_test_ccache(test_ctx);
+    store_test_cred(cc, TEST_CREDS);
+
+    ret = kcm_ccache_to_binary(test_ctx, cc, &payload);
+    assert_int_equal(ret, EOK);
+    data = sss_iobuf_get_data(payload);
+    len = sss_iobuf_get_len(payload);
+
+    /* A truncated header must be refused */
+    ret = kcm_binary_to_ccache(test_ctx, data, len - 1,
+                               &cc2, &cred_uuids, &num_creds);
+    assert_int_not_equal(ret, EOK);
+    assert_null(cc2);
+
+    /* And so must be an unknown version */
+    data[0] ^= 0xff;
+    ret = kcm_binary_to_ccache(test_ctx, data, len,
+                               &cc2, &cred_uuids, &num_creds);
+    assert_int_equal(ret, EINVAL);
+    assert_null(cc2);
+
+    talloc_free(cc);
+    talloc_free(payload);
+}
+
+int main(int argc, const char *argv[])
+{
+    poptContext pc;
+    int opt;
+    int rv;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_kcm_ccache_binary_no_creds,
+                                        setup_kcm_marshalling,
+                                        teardown_kcm_marshalling),
+        cmocka_unit_test_setup_teardown(test_kcm_ccache_binary_creds,
+                                        setup_kcm_marshalling,
+                                        teardown_kcm_marshalling),
+        cmocka_unit_test_setup_teardown(test_kcm_ccache_binary_malformed,
+                                        setup_kcm_marshalling,
+                                        teardown_kcm_marshalling),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    tests_set_cwd();
+
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+
+    return rv;
+}
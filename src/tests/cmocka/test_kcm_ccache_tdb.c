@@ -0,0 +1,317 @@
+/*
+    Copyright (C) 2017 Red Hat
+
+    SSSD tests: Tests of the KCM tdb ccache back end
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <popt.h>
+#include <sys/stat.h>
+
+#include "util/util_creds.h"
+#include "tests/cmocka/common_mock.h"
+
+/* The tests call the synchronous functions of the back end directly */
+#include "responder/kcm/kcmsrv_ccache_tdb.c"
+
+#define TEST_REALM            "TESTREALM"
+#define TEST_PRINC_COMPONENT  "PRINC_NAME"
+#define TEST_CREDS            "TESTCREDS"
+
+/* Only the tdb back end is linked in */
+const struct kcm_ccdb_ops ccdb_mem_ops;
+const struct kcm_ccdb_ops ccdb_sec_ops;
+
+struct tdb_test_ctx {
+    krb5_context kctx;
+    krb5_principal princ;
+    struct cli_creds client;
+
+    struct kcm_ccdb *db;
+    struct ccdb_tdb *tdb_db;
+    struct sss_iobuf *blob;
+};
+
+static int tdb_test_setup(void **state)
+{
+    struct tdb_test_ctx *test_ctx;
+    krb5_error_code kerr;
+    errno_t ret;
+
+    assert_true(leak_check_setup());
+
+    ret = mkdir(TEST_DB_PATH, 0700);
+    assert_true(ret == 0 || errno == EEXIST);
+
+    test_ctx = talloc_zero(global_talloc_context, struct tdb_test_ctx);
+    assert_non_null(test_ctx);
+
+    kerr = krb5_init_context(&test_ctx->kctx);
+    assert_int_equal(kerr, 0);
+
+    kerr = krb5_build_principal(test_ctx->kctx,
+                                &test_ctx->princ,
+                                sizeof(TEST_REALM)-1, TEST_REALM,
+                                TEST_PRINC_COMPONENT, NULL);
+    assert_int_equal(kerr, 0);
+
+    test_ctx->client.ucred.uid = getuid();
+    test_ctx->client.ucred.gid = getgid();
+
+    test_ctx->db = talloc_zero(test_ctx, struct kcm_ccdb);
+    assert_non_null(test_ctx->db);
+
+    ret = ccdb_tdb_init(test_ctx->db);
+    assert_int_equal(ret, EOK);
+    test_ctx->tdb_db = talloc_get_type(test_ctx->db->db_handle,
+                                       struct ccdb_tdb);
+
+    test_ctx->blob = sss_iobuf_init_readonly(test_ctx,
+                                             (const uint8_t *) TEST_CREDS,
+                                             sizeof(TEST_CREDS));
+    assert_non_null(test_ctx->blob);
+
+    *state = test_ctx;
+    return 0;
+}
+
+static int tdb_test_teardown(void **state)
+{
+    struct tdb_test_ctx *test_ctx = talloc_get_type(*state,
+                                                    struct tdb_test_ctx);
+
+    talloc_zfree(test_ctx->db);
+    krb5_free_principal(test_ctx->kctx, test_ctx->princ);
+    krb5_free_context(test_ctx->kctx);
+    talloc_free(test_ctx);
+
+    unlink(KCM_TDB_PATH);
+    unlink(KCM_TDB_MKEY_PATH);
+    rmdir(TEST_DB_PATH);
+
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+static void tdb_test_set_limits(struct tdb_test_ctx *test_ctx,
+                                uint32_t max_uid_ccaches,
+                                uint32_t max_uid_creds,
+                                uint32_t max_payload_size)
+{
+    struct kcm_ccdb_limits limits;
+
+    limits.max_uid_ccaches = max_uid_ccaches;
+    limits.max_uid_creds = max_uid_creds;
+    limits.max_payload_size = max_payload_size;
+
+    kcm_ccdb_set_limits(test_ctx->db, &limits);
+}
+
+static errno_t tdb_test_create_cc(struct tdb_test_ctx *test_ctx,
+                                  const char *suffix,
+                                  size_t num_creds,
+                                  uuid_t _uuid)
+{
+    struct kcm_ccache *cc;
+    struct sss_iobuf *blob;
+    const char *name;
+    size_t i;
+    errno_t ret;
+
+    name = talloc_asprintf(test_ctx, "%"SPRIuid"%s", getuid(), suffix);
+    assert_non_null(name);
+
+    ret = kcm_cc_new(test_ctx, test_ctx->kctx, &test_ctx->client,
+                     name, test_ctx->princ, &cc);
+    assert_int_equal(ret, EOK);
+
+    for (i = 0; i < num_creds; i++) {
+        blob = sss_iobuf_init_readonly(cc, (const uint8_t *) TEST_CREDS,
+                                       sizeof(TEST_CREDS));
+        assert_non_null(blob);
+
+        ret = kcm_cc_store_cred_blob(cc, blob);
+        assert_int_equal(ret, EOK);
+    }
+
+    ret = kcm_cc_get_uuid(cc, _uuid);
+    assert_int_equal(ret, EOK);
+
+    ret = ccdb_tdb_create(test_ctx->tdb_db, &test_ctx->db->limits,
+                          &test_ctx->client, cc);
+
+    talloc_free(cc);
+    talloc_free(discard_const(name));
+    return ret;
+}
+
+static size_t tdb_test_num_ccaches(struct tdb_test_ctx *test_ctx)
+{
+    uuid_t *uuids;
+    size_t num_uuids;
+    errno_t ret;
+
+    ret = ccdb_tdb_get_uuid_list(test_ctx, test_ctx->tdb_db,
+                                 &test_ctx->client, &uuids, &num_uuids);
+    assert_int_equal(ret, EOK);
+    talloc_free(uuids);
+
+    return num_uuids;
+}
+
+static void test_tdb_max_uid_ccaches(void **state)
+{
+    struct tdb_test_ctx *test_ctx = talloc_get_type(*state,
+                                                    struct tdb_test_ctx);
+    struct cli_creds other;
+    uuid_t uuid;
+    errno_t ret;
+
+    tdb_test_set_limits(test_ctx, 2, 0, 0);
+
+    ret = tdb_test_create_cc(test_ctx, "", 0, uuid);
+    assert_int_equal(ret, EOK);
+    ret = tdb_test_create_cc(test_ctx, ":1", 0, uuid);
+    assert_int_equal(ret, EOK);
+
+    ret = tdb_test_create_cc(test_ctx, ":2", 0, uuid);
+    assert_int_equal(ret, EDQUOT);
+    assert_int_equal(tdb_test_num_ccaches(test_ctx), 2);
+
+    /* The limit is per UID */
+    other = test_ctx->client;
+    test_ctx->client.ucred.uid++;
+    ret = tdb_test_create_cc(test_ctx, "", 0, uuid);
+    assert_int_equal(ret, EOK);
+    test_ctx->client = other;
+}
+
+static void test_tdb_max_uid_creds(void **state)
+{
+    struct tdb_test_ctx *test_ctx = talloc_get_type(*state,
+                                                    struct tdb_test_ctx);
+    struct kcm_ccache *cc;
+    struct kcm_cred *crd;
+    size_t num_creds;
+    uuid_t uuid;
+    uuid_t uuid2;
+    errno_t ret;
+
+    tdb_test_set_limits(test_ctx, 0, 3, 0);
+
+    ret = tdb_test_create_cc(test_ctx, "", 2, uuid);
+    assert_int_equal(ret, EOK);
+
+    ret = ccdb_tdb_store_cred(test_ctx->tdb_db, &test_ctx->db->limits,
+                              &test_ctx->client, uuid, test_ctx->blob);
+    assert_int_equal(ret, EOK);
+
+    ret = ccdb_tdb_store_cred(test_ctx->tdb_db, &test_ctx->db->limits,
+                              &test_ctx->client, uuid, test_ctx->blob);
+    assert_int_equal(ret, EDQUOT);
+
+    /* The credentials of all ccaches of the UID count */
+    ret = tdb_test_create_cc(test_ctx, ":1", 1, uuid2);
+    assert_int_equal(ret, EDQUOT);
+    assert_int_equal(tdb_test_num_ccaches(test_ctx), 1);
+
+    ret = ccdb_tdb_get_cc(test_ctx, test_ctx->tdb_db, &test_ctx->client,
+                          uuid, true, &cc);
+    assert_int_equal(ret, EOK);
+
+    num_creds = 0;
+    for (crd = kcm_cc_get_cred(cc); crd != NULL; crd = kcm_cc_next_cred(crd)) {
+        num_creds++;
+    }
+    assert_int_equal(num_creds, 3);
+    talloc_free(cc);
+}
+
+static void test_tdb_max_payload_size(void **state)
+{
+    struct tdb_test_ctx *test_ctx = talloc_get_type(*state,
+                                                    struct tdb_test_ctx);
+    uuid_t uuid;
+    errno_t ret;
+
+    tdb_test_set_limits(test_ctx, 0, 0, sizeof(TEST_CREDS) - 1);
+
+    ret = tdb_test_create_cc(test_ctx, "", 1, uuid);
+    assert_int_equal(ret, ERR_KCM_PAYLOAD_TOO_LARGE);
+    assert_int_equal(tdb_test_num_ccaches(test_ctx), 0);
+
+    ret = tdb_test_create_cc(test_ctx, "", 0, uuid);
+    assert_int_equal(ret, EOK);
+
+    ret = ccdb_tdb_store_cred(test_ctx->tdb_db, &test_ctx->db->limits,
+                              &test_ctx->client, uuid, test_ctx->blob);
+    assert_int_equal(ret, ERR_KCM_PAYLOAD_TOO_LARGE);
+
+    tdb_test_set_limits(test_ctx, 0, 0, sizeof(TEST_CREDS));
+
+    ret = ccdb_tdb_store_cred(test_ctx->tdb_db, &test_ctx->db->limits,
+                              &test_ctx->client, uuid, test_ctx->blob);
+    assert_int_equal(ret, EOK);
+}
+
+int main(int argc, const char *argv[])
+{
+    poptContext pc;
+    int opt;
+    int rv;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_tdb_max_uid_ccaches,
+                                        tdb_test_setup,
+                                        tdb_test_teardown),
+        cmocka_unit_test_setup_teardown(test_tdb_max_uid_creds,
+                                        tdb_test_setup,
+                                        tdb_test_teardown),
+        cmocka_unit_test_setup_teardown(test_tdb_max_payload_size,
+                                        tdb_test_setup,
+                                        tdb_test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    tests_set_cwd();
+
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+
+    return rv;
+}
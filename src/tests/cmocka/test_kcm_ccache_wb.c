@@ -0,0 +1,632 @@
+/*
+    Copyright (C) 2017 Red Hat
+
+    SSSD tests: Tests of the KCM write-back ccache cache
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <popt.h>
+
+#include "util/util_creds.h"
+#include "responder/kcm/kcmsrv_ccache.h"
+#include "responder/kcm/kcmsrv_ccache_be.h"
+#include "responder/kcm/kcmsrv_ccache_pvt.h"
+#include "tests/cmocka/common_mock.h"
+
+#define TEST_REALM            "TESTREALM"
+#define TEST_PRINC_COMPONENT  "PRINC_NAME"
+#define TEST_CREDS            "TESTCREDS"
+
+/* Must match the delays of kcmsrv_ccache_wb.c */
+#define TEST_RETRY_DELAY      5
+
+#define TEST_WRITEBACK_DELAY  1
+#define TEST_IDLE_TIMEOUT     300
+
+/* Only the memory back end is linked in */
+const struct kcm_ccdb_ops ccdb_sec_ops;
+const struct kcm_ccdb_ops ccdb_tdb_ops;
+
+struct wb_test_ctx {
+    struct sss_test_ctx *tctx;
+    krb5_context kctx;
+    krb5_principal princ;
+    struct cli_creds client;
+
+    /* The cached database and a view of the memory back end below it */
+    struct kcm_ccdb *db;
+    struct kcm_ccdb be;
+
+    errno_t (*recv_fn)(struct tevent_req *req);
+    struct kcm_ccache *found;
+
+    int num_create;
+    bool fail_create;
+};
+
+/* The back end operations do not carry any private data */
+static struct wb_test_ctx *wb_test;
+static struct kcm_ccdb_ops wb_test_ops;
+
+struct wb_test_create_state {
+    int dummy;
+};
+
+static void wb_test_create_done(struct tevent_req *subreq);
+
+static struct tevent_req *wb_test_create_send(TALLOC_CTX *mem_ctx,
+                                              struct tevent_context *ev,
+                                              struct kcm_ccdb *db,
+                                              struct cli_creds *client,
+                                              struct kcm_ccache *cc)
+{
+    struct tevent_req *req;
+    struct tevent_req *subreq;
+    struct wb_test_create_state *state;
+
+    req = tevent_req_create(mem_ctx, &state, struct wb_test_create_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    wb_test->num_create++;
+    if (wb_test->fail_create) {
+        tevent_req_error(req, EIO);
+        tevent_req_post(req, ev);
+        return req;
+    }
+
+    subreq = ccdb_mem_ops.create_send(state, ev, db, client, cc);
+    if (subreq == NULL) {
+        talloc_free(req);
+        return NULL;
+    }
+    tevent_req_set_callback(subreq, wb_test_create_done, req);
+
+    return req;
+}
+
+static void wb_test_create_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    errno_t ret;
+
+    ret = ccdb_mem_ops.create_recv(subreq);
+    talloc_free(subreq);
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
+static errno_t wb_test_create_recv(struct tevent_req *req)
+{
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+    return EOK;
+}
+
+static int wb_test_setup_delay(void **state,
+                               uint32_t writeback_delay,
+                               const struct kcm_ccdb_limits *limits)
+{
+    struct wb_test_ctx *test_ctx;
+    krb5_error_code kerr;
+    errno_t ret;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context, struct wb_test_ctx);
+    assert_non_null(test_ctx);
+
+    test_ctx->tctx = create_ev_test_ctx(test_ctx);
+    assert_non_null(test_ctx->tctx);
+
+    kerr = krb5_init_context(&test_ctx->kctx);
+    assert_int_equal(kerr, 0);
+
+    kerr = krb5_build_principal(test_ctx->kctx,
+                                &test_ctx->princ,
+                                sizeof(TEST_REALM)-1, TEST_REALM,
+                                TEST_PRINC_COMPONENT, NULL);
+    assert_int_equal(kerr, 0);
+
+    test_ctx->client.ucred.uid = getuid();
+    test_ctx->client.ucred.gid = getgid();
+
+    test_ctx->db = kcm_ccdb_init(test_ctx, test_ctx->tctx->ev,
+                                 CCDB_BE_MEMORY);
+    assert_non_null(test_ctx->db);
+
+    /* Count and fail the write-backs of the memory back end */
+    wb_test_ops = ccdb_mem_ops;
+    wb_test_ops.create_send = wb_test_create_send;
+    wb_test_ops.create_recv = wb_test_create_recv;
+    test_ctx->db->ops = &wb_test_ops;
+
+    if (limits != NULL) {
+        kcm_ccdb_set_limits(test_ctx->db, limits);
+    }
+
+    test_ctx->be = *test_ctx->db;
+
+    ret = kcm_ccdb_wb_setup(test_ctx->db, writeback_delay, TEST_IDLE_TIMEOUT);
+    assert_int_equal(ret, EOK);
+
+    wb_test = test_ctx;
+    *state = test_ctx;
+    return 0;
+}
+
+static int wb_test_setup(void **state)
+{
+    return wb_test_setup_delay(state, TEST_WRITEBACK_DELAY, NULL);
+}
+
+static int wb_test_setup_long_delay(void **state)
+{
+    /* Only the final write-back on shutdown happens during the test */
+    return wb_test_setup_delay(state, TEST_IDLE_TIMEOUT, NULL);
+}
+
+static int wb_test_setup_limits(void **state)
+{
+    struct kcm_ccdb_limits limits;
+
+    limits.max_uid_ccaches = 1;
+    limits.max_uid_creds = 2;
+    limits.max_payload_size = sizeof(TEST_CREDS);
+
+    return wb_test_setup_delay(state, TEST_WRITEBACK_DELAY, &limits);
+}
+
+static int wb_test_teardown(void **state)
+{
+    struct wb_test_ctx *test_ctx = talloc_get_type(*state,
+                                                   struct wb_test_ctx);
+
+    wb_test = NULL;
+
+    talloc_zfree(test_ctx->db);
+    krb5_free_principal(test_ctx->kctx, test_ctx->princ);
+    krb5_free_context(test_ctx->kctx);
+    talloc_free(test_ctx);
+
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+static void wb_test_op_done(struct tevent_req *req)
+{
+    struct wb_test_ctx *test_ctx = tevent_req_callback_data(req,
+                                                         struct wb_test_ctx);
+    errno_t ret;
+
+    ret = test_ctx->recv_fn(req);
+    talloc_free(req);
+    test_ev_done(test_ctx->tctx, ret);
+}
+
+static errno_t wb_test_run(struct wb_test_ctx *test_ctx,
+                           struct tevent_req *req,
+                           errno_t (*recv_fn)(struct tevent_req *req))
+{
+    assert_non_null(req);
+
+    test_ctx->recv_fn = recv_fn;
+    test_ctx->tctx->done = false;
+    tevent_req_set_callback(req, wb_test_op_done, test_ctx);
+
+    return test_ev_loop(test_ctx->tctx);
+}
+
+static void wb_test_wait_done(struct tevent_context *ev,
+                              struct tevent_timer *te,
+                              struct timeval current_time,
+                              void *pvt)
+{
+    struct wb_test_ctx *test_ctx = talloc_get_type(pvt, struct wb_test_ctx);
+
+    test_ev_done(test_ctx->tctx, EOK);
+}
+
+/* Runs the event loop, so that the timers of the cache fire */
+static void wb_test_wait(struct wb_test_ctx *test_ctx, uint32_t seconds)
+{
+    struct tevent_timer *te;
+    struct timeval tv;
+    errno_t ret;
+
+    tv = tevent_timeval_current_ofs(seconds, 0);
+    te = tevent_add_timer(test_ctx->tctx->ev, test_ctx, tv,
+                          wb_test_wait_done, test_ctx);
+    assert_non_null(te);
+
+    test_ctx->tctx->done = false;
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+}
+
+static errno_t wb_test_try_create_cc(struct wb_test_ctx *test_ctx,
+                                     const char *suffix,
+                                     uuid_t _uuid)
+{
+    struct kcm_ccache *cc;
+    struct tevent_req *req;
+    const char *name;
+    errno_t ret;
+
+    name = talloc_asprintf(test_ctx, "%"SPRIuid"%s", getuid(), suffix);
+    assert_non_null(name);
+
+    ret = kcm_cc_new(test_ctx, test_ctx->kctx, &test_ctx->client,
+                     name, test_ctx->princ, &cc);
+    assert_int_equal(ret, EOK);
+
+    ret = kcm_cc_get_uuid(cc, _uuid);
+    assert_int_equal(ret, EOK);
+
+    req = kcm_ccdb_create_cc_send(test_ctx, test_ctx->tctx->ev,
+                                  test_ctx->db, &test_ctx->client, cc);
+    ret = wb_test_run(test_ctx, req, kcm_ccdb_create_cc_recv);
+
+    talloc_free(cc);
+    talloc_free(discard_const(name));
+    return ret;
+}
+
+static void wb_test_create_cc(struct wb_test_ctx *test_ctx,
+                              const char *suffix,
+                              uuid_t _uuid)
+{
+    errno_t ret;
+
+    ret = wb_test_try_create_cc(test_ctx, suffix, _uuid);
+    assert_int_equal(ret, EOK);
+}
+
+static void wb_test_be_get_done(struct tevent_req *req)
+{
+    struct wb_test_ctx *test_ctx = tevent_req_callback_data(req,
+                                                         struct wb_test_ctx);
+    errno_t ret;
+
+    ret = kcm_ccdb_getbyuuid_recv(req, test_ctx, &test_ctx->found);
+    talloc_free(req);
+    test_ev_done(test_ctx->tctx, ret);
+}
+
+/* Looks the ccache up in the back end, bypassing the cache */
+static struct kcm_ccache *wb_test_be_get(struct wb_test_ctx *test_ctx,
+                                         uuid_t uuid)
+{
+    struct tevent_req *req;
+    errno_t ret;
+
+    test_ctx->found = NULL;
+
+    req = kcm_ccdb_getbyuuid_send(test_ctx, test_ctx->tctx->ev,
+                                  &test_ctx->be, &test_ctx->client, uuid);
+    assert_non_null(req);
+    tevent_req_set_callback(req, wb_test_be_get_done, test_ctx);
+
+    test_ctx->tctx->done = false;
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+
+    return test_ctx->found;
+}
+
+static size_t wb_test_num_creds(struct kcm_ccache *cc)
+{
+    struct kcm_cred *crd;
+    size_t num = 0;
+
+    for (crd = kcm_cc_get_cred(cc); crd != NULL; crd = kcm_cc_next_cred(crd)) {
+        num++;
+    }
+
+    return num;
+}
+
+static errno_t wb_test_shutdown(struct wb_test_ctx *test_ctx)
+{
+    struct tevent_req *req;
+
+    req = kcm_ccdb_wb_shutdown_send(test_ctx, test_ctx->tctx->ev,
+                                    test_ctx->db);
+    return wb_test_run(test_ctx, req, kcm_ccdb_wb_shutdown_recv);
+}
+
+static void test_wb_delayed_flush(void **state)
+{
+    struct wb_test_ctx *test_ctx = talloc_get_type(*state,
+                                                   struct wb_test_ctx);
+    struct kcm_ccache *cc;
+    uuid_t uuid;
+
+    wb_test_create_cc(test_ctx, "", uuid);
+
+    /* Only the cache knows the ccache until the write-back */
+    assert_int_equal(test_ctx->num_create, 0);
+    cc = wb_test_be_get(test_ctx, uuid);
+    assert_null(cc);
+
+    wb_test_wait(test_ctx, TEST_WRITEBACK_DELAY + 1);
+
+    assert_int_equal(test_ctx->num_create, 1);
+    cc = wb_test_be_get(test_ctx, uuid);
+    assert_non_null(cc);
+    talloc_free(cc);
+}
+
+static void test_wb_coalesce(void **state)
+{
+    struct wb_test_ctx *test_ctx = talloc_get_type(*state,
+                                                   struct wb_test_ctx);
+    struct kcm_mod_ctx mod_ctx;
+    struct sss_iobuf *blob;
+    struct tevent_req *req;
+    struct kcm_ccache *cc;
+    uuid_t uuid;
+    errno_t ret;
+    int i;
+
+    wb_test_create_cc(test_ctx, "", uuid);
+
+    blob = sss_iobuf_init_readonly(test_ctx, (const uint8_t *) TEST_CREDS,
+                                   sizeof(TEST_CREDS));
+    assert_non_null(blob);
+
+    for (i = 0; i < 3; i++) {
+        req = kcm_ccdb_store_cred_blob_send(test_ctx, test_ctx->tctx->ev,
+                                            test_ctx->db, &test_ctx->client,
+                                            uuid, blob);
+        ret = wb_test_run(test_ctx, req, kcm_ccdb_store_cred_blob_recv);
+        assert_int_equal(ret, EOK);
+    }
+
+    kcm_mod_ctx_clear(&mod_ctx);
+    mod_ctx.kdc_offset = 42;
+    req = kcm_ccdb_mod_cc_send(test_ctx, test_ctx->tctx->ev,
+                               test_ctx->db, &test_ctx->client,
+                               uuid, &mod_ctx);
+    ret = wb_test_run(test_ctx, req, kcm_ccdb_mod_cc_recv);
+    assert_int_equal(ret, EOK);
+
+    assert_int_equal(test_ctx->num_create, 0);
+
+    wb_test_wait(test_ctx, TEST_WRITEBACK_DELAY + 1);
+
+    /* All modifications were written back at once */
+    assert_int_equal(test_ctx->num_create, 1);
+    cc = wb_test_be_get(test_ctx, uuid);
+    assert_non_null(cc);
+    assert_int_equal(wb_test_num_creds(cc), 3);
+    assert_int_equal(kcm_cc_get_offset(cc), 42);
+    talloc_free(cc);
+
+    talloc_free(blob);
+}
+
+static void test_wb_retry(void **state)
+{
+    struct wb_test_ctx *test_ctx = talloc_get_type(*state,
+                                                   struct wb_test_ctx);
+    struct kcm_ccache *cc;
+    uuid_t uuid;
+
+    test_ctx->fail_create = true;
+    wb_test_create_cc(test_ctx, "", uuid);
+
+    wb_test_wait(test_ctx, TEST_WRITEBACK_DELAY + 1);
+
+    assert_int_equal(test_ctx->num_create, 1);
+    cc = wb_test_be_get(test_ctx, uuid);
+    assert_null(cc);
+
+    /* The failed write-back is retried later */
+    test_ctx->fail_create = false;
+    wb_test_wait(test_ctx, TEST_RETRY_DELAY + 1);
+
+    assert_int_equal(test_ctx->num_create, 2);
+    cc = wb_test_be_get(test_ctx, uuid);
+    assert_non_null(cc);
+    talloc_free(cc);
+}
+
+static void test_wb_shutdown(void **state)
+{
+    struct wb_test_ctx *test_ctx = talloc_get_type(*state,
+                                                   struct wb_test_ctx);
+    struct kcm_ccache *cc;
+    uuid_t uuid1;
+    uuid_t uuid2;
+    errno_t ret;
+
+    wb_test_create_cc(test_ctx, ":1", uuid1);
+    wb_test_create_cc(test_ctx, ":2", uuid2);
+    assert_int_equal(test_ctx->num_create, 0);
+
+    /* The write-back does not wait for the delay */
+    ret = wb_test_shutdown(test_ctx);
+    assert_int_equal(ret, EOK);
+
+    assert_int_equal(test_ctx->num_create, 2);
+    cc = wb_test_be_get(test_ctx, uuid1);
+    assert_non_null(cc);
+    talloc_free(cc);
+    cc = wb_test_be_get(test_ctx, uuid2);
+    assert_non_null(cc);
+    talloc_free(cc);
+
+    /* Nothing is left to write */
+    ret = wb_test_shutdown(test_ctx);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(test_ctx->num_create, 2);
+}
+
+static void test_wb_shutdown_fail(void **state)
+{
+    struct wb_test_ctx *test_ctx = talloc_get_type(*state,
+                                                   struct wb_test_ctx);
+    struct kcm_ccache *cc;
+    uuid_t uuid;
+    errno_t ret;
+
+    test_ctx->fail_create = true;
+    wb_test_create_cc(test_ctx, "", uuid);
+
+    /* A failed write-back is not retried when shutting down */
+    ret = wb_test_shutdown(test_ctx);
+    assert_int_equal(ret, EIO);
+
+    assert_int_equal(test_ctx->num_create, 1);
+    cc = wb_test_be_get(test_ctx, uuid);
+    assert_null(cc);
+}
+
+static void test_wb_shutdown_uncached(void **state)
+{
+    struct wb_test_ctx *test_ctx = talloc_get_type(*state,
+                                                   struct wb_test_ctx);
+    errno_t ret;
+
+    talloc_zfree(test_ctx->db);
+    test_ctx->db = kcm_ccdb_init(test_ctx, test_ctx->tctx->ev,
+                                 CCDB_BE_MEMORY);
+    assert_non_null(test_ctx->db);
+
+    ret = wb_test_shutdown(test_ctx);
+    assert_int_equal(ret, EOK);
+}
+
+static void test_wb_limits(void **state)
+{
+    struct wb_test_ctx *test_ctx = talloc_get_type(*state,
+                                                   struct wb_test_ctx);
+    struct sss_iobuf *blob;
+    struct tevent_req *req;
+    struct kcm_ccache *cc;
+    uuid_t uuid;
+    uuid_t uuid2;
+    errno_t ret;
+    int i;
+
+    wb_test_create_cc(test_ctx, "", uuid);
+
+    /* The limits are enforced before anything is cached */
+    ret = wb_test_try_create_cc(test_ctx, ":1", uuid2);
+    assert_int_equal(ret, EDQUOT);
+
+    blob = sss_iobuf_init_readonly(test_ctx, (const uint8_t *) TEST_CREDS,
+                                   sizeof(TEST_CREDS));
+    assert_non_null(blob);
+
+    for (i = 0; i < 3; i++) {
+        req = kcm_ccdb_store_cred_blob_send(test_ctx, test_ctx->tctx->ev,
+                                            test_ctx->db, &test_ctx->client,
+                                            uuid, blob);
+        ret = wb_test_run(test_ctx, req, kcm_ccdb_store_cred_blob_recv);
+        assert_int_equal(ret, i < 2 ? EOK : EDQUOT);
+    }
+    talloc_free(blob);
+
+    blob = sss_iobuf_init_readonly(test_ctx, (const uint8_t *) TEST_CREDS "X",
+                                   sizeof(TEST_CREDS) + 1);
+    assert_non_null(blob);
+
+    req = kcm_ccdb_store_cred_blob_send(test_ctx, test_ctx->tctx->ev,
+                                        test_ctx->db, &test_ctx->client,
+                                        uuid, blob);
+    ret = wb_test_run(test_ctx, req, kcm_ccdb_store_cred_blob_recv);
+    assert_int_equal(ret, ERR_KCM_PAYLOAD_TOO_LARGE);
+    talloc_free(blob);
+
+    wb_test_wait(test_ctx, TEST_WRITEBACK_DELAY + 1);
+
+    assert_int_equal(test_ctx->num_create, 1);
+    cc = wb_test_be_get(test_ctx, uuid);
+    assert_non_null(cc);
+    assert_int_equal(wb_test_num_creds(cc), 2);
+    talloc_free(cc);
+
+    cc = wb_test_be_get(test_ctx, uuid2);
+    assert_null(cc);
+}
+
+int main(int argc, const char *argv[])
+{
+    poptContext pc;
+    int opt;
+    int rv;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_wb_delayed_flush,
+                                        wb_test_setup,
+                                        wb_test_teardown),
+        cmocka_unit_test_setup_teardown(test_wb_coalesce,
+                                        wb_test_setup,
+                                        wb_test_teardown),
+        cmocka_unit_test_setup_teardown(test_wb_retry,
+                                        wb_test_setup,
+                                        wb_test_teardown),
+        cmocka_unit_test_setup_teardown(test_wb_shutdown,
+                                        wb_test_setup_long_delay,
+                                        wb_test_teardown),
+        cmocka_unit_test_setup_teardown(test_wb_shutdown_fail,
+                                        wb_test_setup_long_delay,
+                                        wb_test_teardown),
+        cmocka_unit_test_setup_teardown(test_wb_shutdown_uncached,
+                                        wb_test_setup,
+                                        wb_test_teardown),
+        cmocka_unit_test_setup_teardown(test_wb_limits,
+                                        wb_test_setup_limits,
+                                        wb_test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    tests_set_cwd();
+
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+
+    return rv;
+}
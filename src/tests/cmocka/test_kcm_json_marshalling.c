@@ -40,6 +40,7 @@
 
 const struct kcm_ccdb_ops ccdb_mem_ops;
 const struct kcm_ccdb_ops ccdb_sec_ops;
+const struct kcm_ccdb_ops ccdb_tdb_ops;
 
 struct kcm_marshalling_test_ctx {
     krb5_context kctx;
@@ -30,6 +30,7 @@
 #define INVALID_ID      -1
 #define FAST_REQ_ID     0
 #define SLOW_REQ_ID     1
+#define FAST_REQ2_ID    2
 
 #define FAST_REQ_DELAY  1
 #define SLOW_REQ_DELAY  2
@@ -40,6 +41,7 @@ struct timed_request_state {
     struct cli_creds *client;
     int delay;
     int req_id;
+    bool readonly;
 
     struct kcm_ops_queue_entry *queue_entry;
 };
@@ -55,7 +57,8 @@ static struct tevent_req *timed_request_send(TALLOC_CTX *mem_ctx,
                                              struct kcm_ops_queue_ctx *qctx,
                                              struct cli_creds *client,
                                              int delay,
-                                             int req_id)
+                                             int req_id,
+                                             bool readonly)
 {
     struct tevent_req *req;
     struct tevent_req *subreq;
@@ -70,10 +73,11 @@ static struct tevent_req *timed_request_send(TALLOC_CTX *mem_ctx,
     state->client = client;
     state->delay = delay;
     state->req_id = req_id;
+    state->readonly = readonly;
 
     DEBUG(SSSDBG_TRACE_ALL, "Request %p with delay %d\n", req, delay);
 
-    subreq = kcm_op_queue_send(state, ev, qctx, client);
+    subreq = kcm_op_queue_send(state, ev, qctx, client, readonly);
     if (subreq == NULL) {
         return NULL;
     }
@@ -211,7 +215,7 @@ static void test_kcm_queue_single(void **state)
     req = timed_request_send(test_ctx,
                              test_ctx->ev,
                              test_ctx->qctx,
-                             &client, 1, 0);
+                             &client, 1, 0, false);
     assert_non_null(req);
     tevent_req_set_callback(req, test_kcm_queue_done, test_ctx);
 
@@ -245,7 +249,8 @@ static void test_kcm_queue_multi_same_id(void **state)
                              test_ctx->qctx,
                              &client,
                              SLOW_REQ_DELAY,
-                             SLOW_REQ_ID);
+                             SLOW_REQ_ID,
+                             false);
     assert_non_null(req);
     tevent_req_set_callback(req, test_kcm_queue_done, test_ctx);
 
@@ -254,7 +259,8 @@ static void test_kcm_queue_multi_same_id(void **state)
                              test_ctx->qctx,
                              &client,
                              FAST_REQ_DELAY,
-                             FAST_REQ_ID);
+                             FAST_REQ_ID,
+                             false);
     assert_non_null(req);
     tevent_req_set_callback(req, test_kcm_queue_done, test_ctx);
 
@@ -290,7 +296,8 @@ static void test_kcm_queue_multi_different_id(void **state)
                              test_ctx->qctx,
                              &client,
                              SLOW_REQ_DELAY,
-                             SLOW_REQ_ID);
+                             SLOW_REQ_ID,
+                             false);
     assert_non_null(req);
     tevent_req_set_callback(req, test_kcm_queue_done, test_ctx);
 
@@ -302,7 +309,8 @@ static void test_kcm_queue_multi_different_id(void **state)
                              test_ctx->qctx,
                              &client,
                              FAST_REQ_DELAY,
-                             FAST_REQ_ID);
+                             FAST_REQ_ID,
+                             false);
     assert_non_null(req);
     tevent_req_set_callback(req, test_kcm_queue_done, test_ctx);
 
@@ -315,6 +323,105 @@ static void test_kcm_queue_multi_different_id(void **state)
     assert_int_equal(test_ctx->error, EOK);
 }
 
+/*
+ * Test that read-only requests from the same ID run concurrently
+ */
+static void test_kcm_queue_multi_readers(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type(*state, struct test_ctx);
+    struct tevent_req *req;
+    struct cli_creds client;
+    /* Both requests only read, so the fast one finishes first */
+    static int req_ids[] = { FAST_REQ_ID, SLOW_REQ_ID };
+
+    client.ucred.uid = getuid();
+    client.ucred.gid = getgid();
+
+    req = timed_request_send(test_ctx,
+                             test_ctx->ev,
+                             test_ctx->qctx,
+                             &client,
+                             SLOW_REQ_DELAY,
+                             SLOW_REQ_ID,
+                             true);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_kcm_queue_done, test_ctx);
+
+    req = timed_request_send(test_ctx,
+                             test_ctx->ev,
+                             test_ctx->qctx,
+                             &client,
+                             FAST_REQ_DELAY,
+                             FAST_REQ_ID,
+                             true);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_kcm_queue_done, test_ctx);
+
+    test_ctx->num_requests = 2;
+    test_ctx->req_ids = req_ids;
+
+    while (test_ctx->done == false) {
+        tevent_loop_once(test_ctx->ev);
+    }
+    assert_int_equal(test_ctx->error, EOK);
+}
+
+/*
+ * Test that a writer waits for the readers before it and that the readers
+ * queued after a writer wait for the writer
+ */
+static void test_kcm_queue_reader_writer(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type(*state, struct test_ctx);
+    struct tevent_req *req;
+    struct cli_creds client;
+    /* The fast writer must wait for the slow reader and the fast reader
+     * queued after the writer must wait for the writer
+     */
+    static int req_ids[] = { SLOW_REQ_ID, FAST_REQ_ID, FAST_REQ2_ID };
+
+    client.ucred.uid = getuid();
+    client.ucred.gid = getgid();
+
+    req = timed_request_send(test_ctx,
+                             test_ctx->ev,
+                             test_ctx->qctx,
+                             &client,
+                             SLOW_REQ_DELAY,
+                             SLOW_REQ_ID,
+                             true);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_kcm_queue_done, test_ctx);
+
+    req = timed_request_send(test_ctx,
+                             test_ctx->ev,
+                             test_ctx->qctx,
+                             &client,
+                             FAST_REQ_DELAY,
+                             FAST_REQ_ID,
+                             false);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_kcm_queue_done, test_ctx);
+
+    req = timed_request_send(test_ctx,
+                             test_ctx->ev,
+                             test_ctx->qctx,
+                             &client,
+                             FAST_REQ_DELAY,
+                             FAST_REQ2_ID,
+                             true);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_kcm_queue_done, test_ctx);
+
+    test_ctx->num_requests = 3;
+    test_ctx->req_ids = req_ids;
+
+    while (test_ctx->done == false) {
+        tevent_loop_once(test_ctx->ev);
+    }
+    assert_int_equal(test_ctx->error, EOK);
+}
+
 int main(int argc, const char *argv[])
 {
     poptContext pc;
@@ -336,6 +443,12 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_kcm_queue_multi_different_id,
                                         setup_kcm_queue,
                                         teardown_kcm_queue),
+        cmocka_unit_test_setup_teardown(test_kcm_queue_multi_readers,
+                                        setup_kcm_queue,
+                                        teardown_kcm_queue),
+        cmocka_unit_test_setup_teardown(test_kcm_queue_reader_writer,
+                                        setup_kcm_queue,
+                                        teardown_kcm_queue),
     };
 
     /* Set debug level to invalid value so we can deside if -d 0 was used. */
@@ -32,6 +32,15 @@
 #include "providers/ldap/ldap_auth.h"
 #include "tests/cmocka/test_expire_common.h"
 
+/* Tests the static authentication connection pool */
+#include "providers/ldap/ldap_auth.c"
+#include "providers/ldap/ldap_opts.h"
+
+#define TEST_URI "ldap://ldap.test"
+#define TEST_URI2 "ldap://ldap2.test"
+#define TEST_BIND_DN "cn=service,dc=test"
+#define TEST_BIND_PW "service_password"
+
 struct check_pwexpire_policy_wrap_indata {
     enum pwexpire type;
     void *time_fmt;
@@ -90,12 +99,394 @@ static void test_pwexpire_krb(void **state)
     assert_int_equal(ret, ERR_PASSWORD_EXPIRED);
 }
 
+/* ==Authentication-Connection-Pool======================================= */
+
+struct test_pool_ctx {
+    struct tevent_context *ev;
+    struct sdap_auth_ctx *auth_ctx;
+
+    /* expected bind identity, NULL for an anonymous bind */
+    const char *bind_dn;
+    const char *bind_pw;
+    errno_t bind_result;
+    int binds;
+};
+
+static struct test_pool_ctx *test_pool;
+
+struct tevent_req *__wrap_sdap_auth_send(TALLOC_CTX *memctx,
+                                         struct tevent_context *ev,
+                                         struct sdap_handle *sh,
+                                         const char *sasl_mech,
+                                         const char *sasl_user,
+                                         const char *user_dn,
+                                         struct sss_auth_token *authtok,
+                                         int simple_bind_timeout)
+{
+    struct tevent_req *req;
+    const char *password;
+    size_t len;
+    int *state;
+    errno_t ret;
+
+    req = tevent_req_create(memctx, &state, int);
+    assert_non_null(req);
+
+    test_pool->binds++;
+    assert_null(sasl_mech);
+
+    if (test_pool->bind_dn == NULL) {
+        assert_null(user_dn);
+        assert_null(authtok);
+    } else {
+        assert_string_equal(user_dn, test_pool->bind_dn);
+        ret = sss_authtok_get_password(authtok, &password, &len);
+        assert_int_equal(ret, EOK);
+        assert_string_equal(password, test_pool->bind_pw);
+    }
+
+    if (test_pool->bind_result == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, test_pool->bind_result);
+    }
+
+    return tevent_req_post(req, ev);
+}
+
+errno_t __wrap_sdap_auth_recv(struct tevent_req *req,
+                              TALLOC_CTX *memctx,
+                              struct sdap_ppolicy_data **ppolicy)
+{
+    if (ppolicy != NULL) {
+        *ppolicy = NULL;
+    }
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    return EOK;
+}
+
+static int test_pool_setup(void **state)
+{
+    struct test_pool_ctx *test_ctx;
+    struct sdap_options *opts;
+    struct dp_opt_blob blob;
+    errno_t ret;
+
+    test_ctx = talloc_zero(NULL, struct test_pool_ctx);
+    assert_non_null(test_ctx);
+
+    test_ctx->ev = tevent_context_init(test_ctx);
+    assert_non_null(test_ctx->ev);
+
+    opts = talloc_zero(test_ctx, struct sdap_options);
+    assert_non_null(opts);
+    ret = dp_copy_defaults(opts, default_basic_opts, SDAP_OPTS_BASIC,
+                           &opts->basic);
+    assert_int_equal(ret, EOK);
+
+    ret = dp_opt_set_int(opts->basic, SDAP_AUTH_CONNECTION_POOL_SIZE, 2);
+    assert_int_equal(ret, EOK);
+    ret = dp_opt_set_string(opts->basic, SDAP_DEFAULT_BIND_DN, TEST_BIND_DN);
+    assert_int_equal(ret, EOK);
+    blob.data = discard_const(TEST_BIND_PW);
+    blob.length = strlen(TEST_BIND_PW);
+    ret = dp_opt_set_blob(opts->basic, SDAP_DEFAULT_AUTHTOK, blob);
+    assert_int_equal(ret, EOK);
+
+    test_ctx->auth_ctx = talloc_zero(test_ctx, struct sdap_auth_ctx);
+    assert_non_null(test_ctx->auth_ctx);
+    test_ctx->auth_ctx->be = talloc_zero(test_ctx, struct be_ctx);
+    assert_non_null(test_ctx->auth_ctx->be);
+    test_ctx->auth_ctx->be->ev = test_ctx->ev;
+    test_ctx->auth_ctx->opts = opts;
+
+    test_ctx->bind_dn = TEST_BIND_DN;
+    test_ctx->bind_pw = TEST_BIND_PW;
+    test_ctx->bind_result = EOK;
+
+    test_pool = test_ctx;
+    *state = test_ctx;
+    return 0;
+}
+
+static int test_pool_teardown(void **state)
+{
+    struct test_pool_ctx *test_ctx;
+
+    test_ctx = talloc_get_type_abort(*state, struct test_pool_ctx);
+
+    /* the pool is freed before the event context */
+    talloc_zfree(test_ctx->auth_ctx);
+    talloc_free(test_ctx);
+    test_pool = NULL;
+    return 0;
+}
+
+/* The handles have no destructor, so they can be freed without a real
+ * LDAP connection */
+static struct sdap_handle *test_pool_handle(TALLOC_CTX *mem_ctx)
+{
+    struct sdap_handle *sh;
+
+    sh = talloc_zero(mem_ctx, struct sdap_handle);
+    assert_non_null(sh);
+
+    sh->connected = true;
+    sh->ldap = (LDAP *) sh;
+
+    return sh;
+}
+
+static void test_pool_wait_reset(struct test_pool_ctx *test_ctx)
+{
+    struct sdap_auth_conn *conn;
+    bool resetting;
+    int ret;
+
+    do {
+        resetting = false;
+        for (conn = test_ctx->auth_ctx->conn_pool->conns;
+             conn != NULL; conn = conn->next) {
+            resetting |= conn->resetting;
+        }
+
+        if (resetting) {
+            ret = tevent_loop_once(test_ctx->ev);
+            assert_int_equal(ret, 0);
+        }
+    } while (resetting);
+}
+
+static void test_pool_cycle(struct test_pool_ctx *test_ctx)
+{
+    struct sdap_handle *sh;
+    struct sdap_handle *taken;
+    TALLOC_CTX *req_ctx;
+
+    req_ctx = talloc_new(test_ctx);
+    assert_non_null(req_ctx);
+
+    /* Nothing to check out yet */
+    taken = sdap_auth_conn_pool_take(req_ctx, test_ctx->auth_ctx, TEST_URI);
+    assert_null(taken);
+
+    sh = test_pool_handle(req_ctx);
+
+    /* Return the handle, it is reset before it can be checked out */
+    sdap_auth_conn_pool_release(test_ctx->auth_ctx, TEST_URI, sh);
+    assert_int_equal(test_ctx->binds, 1);
+    assert_int_equal(test_ctx->auth_ctx->conn_pool->num_conns, 1);
+
+    taken = sdap_auth_conn_pool_take(req_ctx, test_ctx->auth_ctx, TEST_URI);
+    assert_null(taken);
+
+    test_pool_wait_reset(test_ctx);
+
+    /* Only a request to the same server gets it */
+    taken = sdap_auth_conn_pool_take(req_ctx, test_ctx->auth_ctx, TEST_URI2);
+    assert_null(taken);
+
+    taken = sdap_auth_conn_pool_take(req_ctx, test_ctx->auth_ctx, TEST_URI);
+    assert_ptr_equal(taken, sh);
+    assert_ptr_equal(talloc_parent(taken), req_ctx);
+    assert_int_equal(test_ctx->auth_ctx->conn_pool->num_conns, 0);
+
+    /* And again */
+    sdap_auth_conn_pool_release(test_ctx->auth_ctx, TEST_URI, sh);
+    assert_int_equal(test_ctx->binds, 2);
+    test_pool_wait_reset(test_ctx);
+
+    taken = sdap_auth_conn_pool_take(req_ctx, test_ctx->auth_ctx, TEST_URI);
+    assert_ptr_equal(taken, sh);
+
+    talloc_free(req_ctx);
+}
+
+static void test_pool_reset_default_bind_dn(void **state)
+{
+    struct test_pool_ctx *test_ctx;
+
+    test_ctx = talloc_get_type_abort(*state, struct test_pool_ctx);
+
+    test_pool_cycle(test_ctx);
+}
+
+static void test_pool_reset_anonymous(void **state)
+{
+    struct test_pool_ctx *test_ctx;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct test_pool_ctx);
+
+    /* Without a default bind DN the ID connections are anonymous */
+    ret = dp_opt_set_string(test_ctx->auth_ctx->opts->basic,
+                            SDAP_DEFAULT_BIND_DN, NULL);
+    assert_int_equal(ret, EOK);
+    test_ctx->bind_dn = NULL;
+    test_ctx->bind_pw = NULL;
+
+    test_pool_cycle(test_ctx);
+}
+
+static void test_pool_reset_failed(void **state)
+{
+    struct test_pool_ctx *test_ctx;
+    struct sdap_handle *sh;
+    struct sdap_handle *taken;
+    TALLOC_CTX *req_ctx;
+
+    test_ctx = talloc_get_type_abort(*state, struct test_pool_ctx);
+
+    req_ctx = talloc_new(test_ctx);
+    assert_non_null(req_ctx);
+
+    /* e.g. the server refuses the bind */
+    test_ctx->bind_result = ERR_AUTH_FAILED;
+
+    sh = test_pool_handle(req_ctx);
+    sdap_auth_conn_pool_release(test_ctx->auth_ctx, TEST_URI, sh);
+    assert_int_equal(test_ctx->binds, 1);
+    assert_int_equal(test_ctx->auth_ctx->conn_pool->num_conns, 1);
+
+    test_pool_wait_reset(test_ctx);
+
+    /* The connection was closed instead of being handed out */
+    assert_int_equal(test_ctx->auth_ctx->conn_pool->num_conns, 0);
+    taken = sdap_auth_conn_pool_take(req_ctx, test_ctx->auth_ctx, TEST_URI);
+    assert_null(taken);
+
+    /* The next connection that can be reset is kept again */
+    test_ctx->bind_result = EOK;
+    sh = test_pool_handle(req_ctx);
+    sdap_auth_conn_pool_release(test_ctx->auth_ctx, TEST_URI, sh);
+    test_pool_wait_reset(test_ctx);
+
+    taken = sdap_auth_conn_pool_take(req_ctx, test_ctx->auth_ctx, TEST_URI);
+    assert_ptr_equal(taken, sh);
+
+    talloc_free(req_ctx);
+}
+
+static void test_pool_reset_invalid_authtok(void **state)
+{
+    struct test_pool_ctx *test_ctx;
+    struct sdap_handle *sh;
+    TALLOC_CTX *req_ctx;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct test_pool_ctx);
+
+    req_ctx = talloc_new(test_ctx);
+    assert_non_null(req_ctx);
+
+    ret = dp_opt_set_string(test_ctx->auth_ctx->opts->basic,
+                            SDAP_DEFAULT_AUTHTOK_TYPE, "obfuscated_password");
+    assert_int_equal(ret, EOK);
+
+    /* The connection cannot be reset and is closed right away */
+    sh = test_pool_handle(req_ctx);
+    sdap_auth_conn_pool_release(test_ctx->auth_ctx, TEST_URI, sh);
+    assert_int_equal(test_ctx->binds, 0);
+    assert_int_equal(test_ctx->auth_ctx->conn_pool->num_conns, 0);
+
+    talloc_free(req_ctx);
+}
+
+static void test_pool_limits(void **state)
+{
+    struct test_pool_ctx *test_ctx;
+    struct sdap_handle *sh[4];
+    struct sdap_handle *taken;
+    TALLOC_CTX *req_ctx;
+    int i;
+
+    test_ctx = talloc_get_type_abort(*state, struct test_pool_ctx);
+
+    req_ctx = talloc_new(test_ctx);
+    assert_non_null(req_ctx);
+
+    for (i = 0; i < 4; i++) {
+        sh[i] = test_pool_handle(req_ctx);
+    }
+
+    /* Disconnected handles are not kept */
+    sh[0]->connected = false;
+    sdap_auth_conn_pool_release(test_ctx->auth_ctx, TEST_URI, sh[0]);
+    assert_int_equal(test_ctx->binds, 0);
+    assert_int_equal(test_ctx->auth_ctx->conn_pool->num_conns, 0);
+
+    /* At most ldap_auth_connection_pool_size handles are kept */
+    for (i = 1; i < 4; i++) {
+        sdap_auth_conn_pool_release(test_ctx->auth_ctx, TEST_URI, sh[i]);
+    }
+    assert_int_equal(test_ctx->binds, 2);
+    assert_int_equal(test_ctx->auth_ctx->conn_pool->num_conns, 2);
+    test_pool_wait_reset(test_ctx);
+
+    /* A handle closed by the server while idle is not handed out */
+    sh[2]->connected = false;
+    taken = sdap_auth_conn_pool_take(req_ctx, test_ctx->auth_ctx, TEST_URI);
+    assert_ptr_equal(taken, sh[1]);
+    assert_int_equal(test_ctx->auth_ctx->conn_pool->num_conns, 0);
+
+    talloc_free(req_ctx);
+}
+
+static void test_pool_idle_timeout(void **state)
+{
+    struct test_pool_ctx *test_ctx;
+    struct sdap_handle *sh;
+    TALLOC_CTX *req_ctx;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct test_pool_ctx);
+
+    req_ctx = talloc_new(test_ctx);
+    assert_non_null(req_ctx);
+
+    ret = dp_opt_set_int(test_ctx->auth_ctx->opts->basic,
+                         SDAP_AUTH_CONNECTION_IDLE_TIMEOUT, 0);
+    assert_int_equal(ret, EOK);
+
+    sh = test_pool_handle(req_ctx);
+    sdap_auth_conn_pool_release(test_ctx->auth_ctx, TEST_URI, sh);
+    test_pool_wait_reset(test_ctx);
+    assert_int_equal(test_ctx->auth_ctx->conn_pool->num_conns, 1);
+
+    while (test_ctx->auth_ctx->conn_pool->num_conns > 0) {
+        ret = tevent_loop_once(test_ctx->ev);
+        assert_int_equal(ret, 0);
+    }
+
+    talloc_free(req_ctx);
+}
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test_setup_teardown(test_pwexpire_krb,
                                         expire_test_setup,
                                         expire_test_teardown),
+        cmocka_unit_test_setup_teardown(test_pool_reset_default_bind_dn,
+                                        test_pool_setup,
+                                        test_pool_teardown),
+        cmocka_unit_test_setup_teardown(test_pool_reset_anonymous,
+                                        test_pool_setup,
+                                        test_pool_teardown),
+        cmocka_unit_test_setup_teardown(test_pool_reset_failed,
+                                        test_pool_setup,
+                                        test_pool_teardown),
+        cmocka_unit_test_setup_teardown(test_pool_reset_invalid_authtok,
+                                        test_pool_setup,
+                                        test_pool_teardown),
+        cmocka_unit_test_setup_teardown(test_pool_limits,
+                                        test_pool_setup,
+                                        test_pool_teardown),
+        cmocka_unit_test_setup_teardown(test_pool_idle_timeout,
+                                        test_pool_setup,
+                                        test_pool_teardown),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
@@ -0,0 +1,564 @@
+/*
+    SSSD
+
+    test_nss_mc - Tests for the client side of the fast in-memory cache
+
+    Copyright (C) 2017 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <popt.h>
+#include <pwd.h>
+#include <grp.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "responder/nss/nsssrv_mmap_cache.h"
+#include "sss_client/nss_mc.h"
+
+/* Both the responder and the client side are built with
+ * SSS_NSS_MCACHE_DIR pointing to a directory in the build tree,
+ * see Makefile.am */
+
+#define TEST_MC_ELEMS 1024
+#define TEST_MC_TIMEOUT 300
+
+/* A writer raises b2 to the next barrier before it modifies a record */
+#define TEST_NEXT_BARRIER(val) ((((val) + 1) & 0x00ffffff) | 0xf0000000)
+
+extern struct sss_cli_mc_ctx pw_mc_ctx;
+extern struct sss_cli_mc_ctx gr_mc_ctx;
+extern struct sss_cli_mc_ctx initgr_mc_ctx;
+
+struct test_mc_file {
+    struct sss_mc_ctx *mcc;
+    uint8_t *base;
+    size_t size;
+};
+
+struct test_nss_mc_ctx {
+    struct test_mc_file passwd;
+    struct test_mc_file group;
+    struct test_mc_file initgr;
+
+    char buffer[1024];
+};
+
+/* The client code expects the locks of the NSS module, the test is
+ * single threaded */
+void sss_nss_mc_lock(void)
+{
+    return;
+}
+
+void sss_nss_mc_unlock(void)
+{
+    return;
+}
+
+static void test_mc_file_init(TALLOC_CTX *mem_ctx,
+                              struct test_mc_file *file,
+                              const char *name,
+                              enum sss_mc_type type)
+{
+    struct stat st;
+    char *path;
+    int fd;
+    int ret;
+
+    ret = sss_mmap_cache_init(mem_ctx, name, type, TEST_MC_ELEMS,
+                              TEST_MC_TIMEOUT, &file->mcc);
+    assert_int_equal(ret, EOK);
+
+    /* A second writable mapping of the file lets the tests modify records
+     * the way a concurrent writer would */
+    path = talloc_asprintf(mem_ctx, "%s/%s", SSS_NSS_MCACHE_DIR, name);
+    assert_non_null(path);
+
+    fd = open(path, O_RDWR);
+    assert_true(fd != -1);
+
+    ret = fstat(fd, &st);
+    assert_int_equal(ret, 0);
+    file->size = st.st_size;
+
+    file->base = mmap(NULL, file->size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd, 0);
+    assert_true(file->base != MAP_FAILED);
+    close(fd);
+    talloc_free(path);
+}
+
+static void test_mc_file_free(struct test_mc_file *file, const char *name)
+{
+    char *path;
+
+    munmap(file->base, file->size);
+    talloc_zfree(file->mcc);
+
+    path = talloc_asprintf(NULL, "%s/%s", SSS_NSS_MCACHE_DIR, name);
+    assert_non_null(path);
+    unlink(path);
+    talloc_free(path);
+}
+
+static int test_nss_mc_setup(void **state)
+{
+    struct test_nss_mc_ctx *test_ctx;
+    int ret;
+
+    ret = mkdir(SSS_NSS_MCACHE_DIR, 0755);
+    assert_true(ret == 0 || errno == EEXIST);
+
+    test_ctx = talloc_zero(NULL, struct test_nss_mc_ctx);
+    assert_non_null(test_ctx);
+
+    test_mc_file_init(test_ctx, &test_ctx->passwd, "passwd", SSS_MC_PASSWD);
+    test_mc_file_init(test_ctx, &test_ctx->group, "group", SSS_MC_GROUP);
+    test_mc_file_init(test_ctx, &test_ctx->initgr, "initgroups",
+                      SSS_MC_INITGROUPS);
+
+    *state = test_ctx;
+    return 0;
+}
+
+static int test_nss_mc_teardown(void **state)
+{
+    struct test_nss_mc_ctx *test_ctx;
+
+    test_ctx = talloc_get_type_abort(*state, struct test_nss_mc_ctx);
+
+    test_mc_file_free(&test_ctx->passwd, "passwd");
+    test_mc_file_free(&test_ctx->group, "group");
+    test_mc_file_free(&test_ctx->initgr, "initgroups");
+    rmdir(SSS_NSS_MCACHE_DIR);
+
+    talloc_free(test_ctx);
+    return 0;
+}
+
+/* Returns the slot of the first record in the chain of key, the client
+ * must have mapped the cache already */
+static uint32_t test_mc_find_slot(struct sss_cli_mc_ctx *cli_ctx,
+                                  const char *key)
+{
+    struct sss_mc_rec *rec;
+    uint32_t hash;
+    uint32_t slot;
+
+    hash = sss_nss_mc_hash(cli_ctx, key, strlen(key) + 1);
+    slot = cli_ctx->hash_table[hash];
+
+    while (MC_SLOT_WITHIN_BOUNDS(slot, cli_ctx->dt_size)) {
+        rec = MC_SLOT_TO_PTR(cli_ctx->data_table, slot, struct sss_mc_rec);
+        if (rec->hash1 == hash || rec->hash2 == hash) {
+            return slot;
+        }
+        slot = sss_nss_mc_next_slot_with_hash(rec, hash);
+    }
+
+    fail_msg("No record for %s", key);
+    return MC_INVALID_VAL;
+}
+
+/* Returns the record of key in the writable mapping */
+static struct sss_mc_rec *test_mc_find_rec(struct test_mc_file *file,
+                                           struct sss_cli_mc_ctx *cli_ctx,
+                                           const char *key)
+{
+    struct sss_mc_rec *rec;
+    uint32_t slot;
+
+    slot = test_mc_find_slot(cli_ctx, key);
+    rec = MC_SLOT_TO_PTR(cli_ctx->data_table, slot, struct sss_mc_rec);
+
+    return (struct sss_mc_rec *)(file->base
+                                 + MC_PTR_DIFF(rec, cli_ctx->mmap_base));
+}
+
+static void test_pw_store(struct test_nss_mc_ctx *test_ctx,
+                          const char *name, uid_t uid)
+{
+    struct sized_string sname;
+    struct sized_string pw;
+    struct sized_string gecos;
+    struct sized_string homedir;
+    struct sized_string shell;
+    errno_t ret;
+
+    to_sized_string(&sname, name);
+    to_sized_string(&pw, "*");
+    to_sized_string(&gecos, "Test User");
+    to_sized_string(&homedir, "/home/test");
+    to_sized_string(&shell, "/bin/sh");
+
+    ret = sss_mmap_cache_pw_store(&test_ctx->passwd.mcc, &sname, &pw,
+                                  uid, uid, &gecos, &homedir, &shell);
+    assert_int_equal(ret, EOK);
+}
+
+static errno_t test_getpwnam(struct test_nss_mc_ctx *test_ctx,
+                             const char *name, struct passwd *pwd)
+{
+    return sss_nss_mc_getpwnam(name, strlen(name), pwd,
+                               test_ctx->buffer, sizeof(test_ctx->buffer));
+}
+
+static errno_t test_getpwuid(struct test_nss_mc_ctx *test_ctx,
+                             uid_t uid, struct passwd *pwd)
+{
+    return sss_nss_mc_getpwuid(uid, pwd,
+                               test_ctx->buffer, sizeof(test_ctx->buffer));
+}
+
+static void test_nss_mc_getpw(void **state)
+{
+    struct test_nss_mc_ctx *test_ctx;
+    struct passwd pwd;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct test_nss_mc_ctx);
+
+    test_pw_store(test_ctx, "testuser", 10001);
+
+    ret = test_getpwnam(test_ctx, "testuser", &pwd);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(pwd.pw_name, "testuser");
+    assert_int_equal(pwd.pw_uid, 10001);
+    assert_string_equal(pwd.pw_gecos, "Test User");
+    assert_string_equal(pwd.pw_shell, "/bin/sh");
+
+    ret = test_getpwuid(test_ctx, 10001, &pwd);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(pwd.pw_name, "testuser");
+
+    ret = test_getpwnam(test_ctx, "nosuchuser", &pwd);
+    assert_int_equal(ret, ENOENT);
+
+    ret = sss_nss_mc_getpwnam("testuser", strlen("testuser"), &pwd,
+                              test_ctx->buffer, 8);
+    assert_int_equal(ret, ERANGE);
+}
+
+static void test_nss_mc_check_record(void **state)
+{
+    struct test_nss_mc_ctx *test_ctx;
+    struct sss_mc_rec *wrec;
+    struct sss_mc_rec *rec;
+    struct passwd pwd;
+    uint32_t rec_len;
+    uint32_t barrier;
+    uint32_t slot;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct test_nss_mc_ctx);
+
+    test_pw_store(test_ctx, "checkuser", 10002);
+    ret = test_getpwnam(test_ctx, "checkuser", &pwd);
+    assert_int_equal(ret, EOK);
+
+    slot = test_mc_find_slot(&pw_mc_ctx, "checkuser");
+    wrec = test_mc_find_rec(&test_ctx->passwd, &pw_mc_ctx, "checkuser");
+
+    ret = sss_nss_mc_get_record(&pw_mc_ctx, slot,
+                                sizeof(struct sss_mc_pwd_data),
+                                &rec, &barrier, &rec_len);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(rec_len, wrec->len);
+    assert_int_equal(barrier, wrec->b1);
+    assert_true(sss_nss_mc_check_record(rec, barrier, rec_len));
+
+    /* a writer started to modify the record */
+    wrec->b2 = TEST_NEXT_BARRIER(barrier);
+    assert_false(sss_nss_mc_check_record(rec, barrier, rec_len));
+
+    /* and finished meanwhile */
+    wrec->b1 = wrec->b2;
+    assert_false(sss_nss_mc_check_record(rec, barrier, rec_len));
+    wrec->b1 = barrier;
+    wrec->b2 = barrier;
+    assert_true(sss_nss_mc_check_record(rec, barrier, rec_len));
+
+    /* the length changed although the barriers look untouched */
+    wrec->len = rec_len - MC_SLOT_SIZE;
+    assert_false(sss_nss_mc_check_record(rec, barrier, rec_len));
+    wrec->len = rec_len;
+
+    /* the record is too short for the fixed fields */
+    ret = sss_nss_mc_get_record(&pw_mc_ctx, slot,
+                                rec_len - sizeof(struct sss_mc_rec) + 1,
+                                &rec, &barrier, &rec_len);
+    assert_int_equal(ret, EINVAL);
+}
+
+static void test_nss_mc_getpw_rewritten(void **state)
+{
+    struct test_nss_mc_ctx *test_ctx;
+    struct sss_mc_pwd_data *data;
+    struct sss_mc_rec *wrec;
+    struct passwd pwd;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct test_nss_mc_ctx);
+
+    test_pw_store(test_ctx, "rewrittenuser", 10003);
+    ret = test_getpwnam(test_ctx, "rewrittenuser", &pwd);
+    assert_int_equal(ret, EOK);
+
+    wrec = test_mc_find_rec(&test_ctx->passwd, &pw_mc_ctx, "rewrittenuser");
+    data = (struct sss_mc_pwd_data *)wrec->data;
+
+    /* The record is being rewritten, the reader gives up instead of
+     * returning what is there */
+    wrec->b2 = TEST_NEXT_BARRIER(wrec->b1);
+    data->uid = 10004;
+
+    ret = test_getpwnam(test_ctx, "rewrittenuser", &pwd);
+    assert_int_equal(ret, EIO);
+
+    /* Once the writer is done, the new content is returned */
+    wrec->b1 = wrec->b2;
+
+    ret = test_getpwnam(test_ctx, "rewrittenuser", &pwd);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(pwd.pw_uid, 10004);
+    assert_string_equal(pwd.pw_name, "rewrittenuser");
+}
+
+static void test_nss_mc_getpw_truncated(void **state)
+{
+    struct test_nss_mc_ctx *test_ctx;
+    struct sss_mc_rec *wrec;
+    struct passwd pwd;
+    uint32_t len;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct test_nss_mc_ctx);
+
+    test_pw_store(test_ctx, "truncateduser", 10005);
+    ret = test_getpwnam(test_ctx, "truncateduser", &pwd);
+    assert_int_equal(ret, EOK);
+
+    wrec = test_mc_find_rec(&test_ctx->passwd, &pw_mc_ctx, "truncateduser");
+    len = wrec->len;
+
+    /* The strings do not fit in the record any more */
+    wrec->len = MC_HEADER_SIZE;
+
+    ret = test_getpwnam(test_ctx, "truncateduser", &pwd);
+    assert_int_equal(ret, ENOENT);
+    ret = test_getpwuid(test_ctx, 10005, &pwd);
+    assert_int_equal(ret, EINVAL);
+
+    /* Shorter than a record header */
+    wrec->len = sizeof(struct sss_mc_rec);
+
+    ret = test_getpwnam(test_ctx, "truncateduser", &pwd);
+    assert_int_equal(ret, EINVAL);
+
+    /* Beyond the end of the data table */
+    wrec->len = pw_mc_ctx.dt_size + 1;
+
+    ret = test_getpwuid(test_ctx, 10005, &pwd);
+    assert_int_equal(ret, EINVAL);
+
+    wrec->len = len;
+    ret = test_getpwuid(test_ctx, 10005, &pwd);
+    assert_int_equal(ret, EOK);
+}
+
+static void test_nss_mc_getpw_corrupted(void **state)
+{
+    struct test_nss_mc_ctx *test_ctx;
+    struct sss_mc_pwd_data *data;
+    struct sss_mc_rec *wrec;
+    struct passwd pwd;
+    uint32_t strs_len;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct test_nss_mc_ctx);
+
+    test_pw_store(test_ctx, "corrupteduser", 10006);
+    ret = test_getpwnam(test_ctx, "corrupteduser", &pwd);
+    assert_int_equal(ret, EOK);
+
+    wrec = test_mc_find_rec(&test_ctx->passwd, &pw_mc_ctx, "corrupteduser");
+    data = (struct sss_mc_pwd_data *)wrec->data;
+    strs_len = data->strs_len;
+
+    /* The strings would extend beyond the record */
+    data->strs_len = wrec->len;
+
+    ret = test_getpwnam(test_ctx, "corrupteduser", &pwd);
+    assert_int_equal(ret, ENOENT);
+    ret = test_getpwuid(test_ctx, 10006, &pwd);
+    assert_int_equal(ret, EINVAL);
+
+    /* The strings are not terminated within strs_len */
+    data->strs_len = strs_len - 1;
+
+    ret = test_getpwuid(test_ctx, 10006, &pwd);
+    assert_int_equal(ret, EINVAL);
+    data->strs_len = strs_len;
+
+    /* The name points outside of the strings */
+    data->name = wrec->len;
+
+    ret = test_getpwnam(test_ctx, "corrupteduser", &pwd);
+    assert_int_equal(ret, ENOENT);
+}
+
+static void test_nss_mc_getgr_corrupted(void **state)
+{
+    struct test_nss_mc_ctx *test_ctx;
+    struct sss_mc_grp_data *data;
+    struct sss_mc_rec *wrec;
+    struct sized_string name;
+    struct sized_string pw;
+    struct group grp;
+    char members[] = "member1\0member2";
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct test_nss_mc_ctx);
+
+    to_sized_string(&name, "corruptedgroup");
+    to_sized_string(&pw, "*");
+    ret = sss_mmap_cache_gr_store(&test_ctx->group.mcc, &name, &pw, 20001,
+                                  2, members, sizeof(members));
+    assert_int_equal(ret, EOK);
+
+    ret = sss_nss_mc_getgrgid(20001, &grp,
+                              test_ctx->buffer, sizeof(test_ctx->buffer));
+    assert_int_equal(ret, EOK);
+    assert_string_equal(grp.gr_name, "corruptedgroup");
+    assert_string_equal(grp.gr_mem[1], "member2");
+    assert_null(grp.gr_mem[2]);
+
+    wrec = test_mc_find_rec(&test_ctx->group, &gr_mc_ctx, "corruptedgroup");
+    data = (struct sss_mc_grp_data *)wrec->data;
+
+    /* The strings would extend beyond the record */
+    data->strs_len = wrec->len;
+
+    ret = sss_nss_mc_getgrnam("corruptedgroup", strlen("corruptedgroup"),
+                              &grp,
+                              test_ctx->buffer, sizeof(test_ctx->buffer));
+    assert_int_equal(ret, ENOENT);
+    ret = sss_nss_mc_getgrgid(20001, &grp,
+                              test_ctx->buffer, sizeof(test_ctx->buffer));
+    assert_int_equal(ret, EINVAL);
+
+    /* The record is shorter than a group header */
+    wrec->len = sizeof(struct sss_mc_rec);
+
+    ret = sss_nss_mc_getgrgid(20001, &grp,
+                              test_ctx->buffer, sizeof(test_ctx->buffer));
+    assert_int_equal(ret, EINVAL);
+}
+
+static void test_nss_mc_initgr_corrupted(void **state)
+{
+    struct test_nss_mc_ctx *test_ctx;
+    struct sss_mc_initgr_data *data;
+    struct sss_mc_rec *wrec;
+    struct sized_string name;
+    struct sized_string unique_name;
+    uint32_t gids[] = { 30001, 30002, 30003 };
+    gid_t *groups = NULL;
+    long int start = 0;
+    long int size = 0;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct test_nss_mc_ctx);
+
+    to_sized_string(&name, "corruptedinit");
+    to_sized_string(&unique_name, "corruptedinit@test");
+    ret = sss_mmap_cache_initgr_store(&test_ctx->initgr.mcc, &name,
+                                      &unique_name, 3, (uint8_t *)gids);
+    assert_int_equal(ret, EOK);
+
+    ret = sss_nss_mc_initgroups_dyn("corruptedinit", strlen("corruptedinit"),
+                                    0, &start, &size, &groups, 0);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(start, 3);
+    assert_int_equal(groups[2], 30003);
+
+    wrec = test_mc_find_rec(&test_ctx->initgr, &initgr_mc_ctx,
+                            "corruptedinit");
+    data = (struct sss_mc_initgr_data *)wrec->data;
+
+    /* The gids would extend beyond the record, nothing is returned */
+    data->num_groups = wrec->len;
+
+    ret = sss_nss_mc_initgroups_dyn("corruptedinit", strlen("corruptedinit"),
+                                    0, &start, &size, &groups, 0);
+    assert_int_equal(ret, EINVAL);
+    assert_int_equal(start, 3);
+
+    /* The data does not fit in the record any more */
+    wrec->len = MC_HEADER_SIZE;
+
+    ret = sss_nss_mc_initgroups_dyn("corruptedinit", strlen("corruptedinit"),
+                                    0, &start, &size, &groups, 0);
+    assert_int_equal(ret, ENOENT);
+    assert_int_equal(start, 3);
+
+    free(groups);
+}
+
+int main(int argc, const char *argv[])
+{
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_nss_mc_getpw),
+        cmocka_unit_test(test_nss_mc_check_record),
+        cmocka_unit_test(test_nss_mc_getpw_rewritten),
+        cmocka_unit_test(test_nss_mc_getpw_truncated),
+        cmocka_unit_test(test_nss_mc_getpw_corrupted),
+        cmocka_unit_test(test_nss_mc_getgr_corrupted),
+        cmocka_unit_test(test_nss_mc_initgr_corrupted),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    /* The records are shared by all tests, each uses its own entries */
+    return cmocka_run_group_tests(tests, test_nss_mc_setup,
+                                  test_nss_mc_teardown);
+}
@@ -1699,6 +1699,38 @@ void test_nss_getgrnam_members_subdom(void **state)
     assert_int_equal(ret, EOK);
 }
 
+void test_nss_get_member_domain(void **state)
+{
+    struct resp_ctx *rctx = nss_test_ctx->rctx;
+    struct sss_domain_info *dom;
+    errno_t ret;
+
+    ret = nss_get_member_domain(rctx, NULL, "member@"TEST_DOM_NAME, &dom);
+    assert_int_equal(ret, EOK);
+    assert_ptr_equal(dom, nss_test_ctx->tctx->dom);
+
+    ret = nss_get_member_domain(rctx, dom, "member@"TEST_SUBDOM_NAME, &dom);
+    assert_int_equal(ret, EOK);
+    assert_ptr_equal(dom, nss_test_ctx->subdom);
+
+    /* the domain of the previous member is reused */
+    ret = nss_get_member_domain(rctx, dom, "other@"TEST_SUBDOM_NAME, &dom);
+    assert_int_equal(ret, EOK);
+    assert_ptr_equal(dom, nss_test_ctx->subdom);
+
+    dom = NULL;
+    ret = nss_get_member_domain(rctx, NULL, "member", &dom);
+    assert_int_equal(ret, ERR_WRONG_NAME_FORMAT);
+    assert_null(dom);
+
+    ret = nss_get_member_domain(rctx, NULL, "member@", &dom);
+    assert_int_equal(ret, ERR_WRONG_NAME_FORMAT);
+
+    ret = nss_get_member_domain(rctx, NULL, "member@unknown.domain", &dom);
+    assert_int_equal(ret, ERR_DOMAIN_NOT_FOUND);
+    assert_null(dom);
+}
+
 void test_nss_getgrnam_members_subdom_nonfqnames(void **state)
 {
     errno_t ret;
@@ -4196,6 +4228,9 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_nss_getgrnam_members_subdom,
                                         nss_subdom_test_setup,
                                         nss_subdom_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nss_get_member_domain,
+                                        nss_subdom_test_setup,
+                                        nss_subdom_test_teardown),
         cmocka_unit_test_setup_teardown(test_nss_getgrnam_members_subdom_nonfqnames,
                                         nss_subdom_test_setup_nonfqnames,
                                         nss_subdom_test_teardown),
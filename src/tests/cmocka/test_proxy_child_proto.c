@@ -0,0 +1,457 @@
+/*
+    SSSD
+
+    test_proxy_child_proto - Tests of the messages exchanged with proxy_child
+
+    Copyright (C) 2017 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <popt.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "util/child_common.h"
+#include "providers/data_provider.h"
+#include "providers/proxy/proxy.h"
+
+#define TEST_USER "proxyuser"
+#define TEST_DOMAIN "proxy.test"
+#define TEST_SERVICE "login"
+#define TEST_TTY "/dev/pts/1"
+#define TEST_RUSER "remoteuser"
+#define TEST_PASSWORD "Passw0rd"
+#define TEST_NEW_PASSWORD "NewPassw0rd"
+#define TEST_CLI_PID 4242
+
+#define TEST_RESP1 "first message"
+#define TEST_RESP2 "second message"
+
+struct proto_test_ctx {
+    struct pam_data *pd;
+};
+
+static int proto_test_setup(void **state)
+{
+    struct proto_test_ctx *test_ctx;
+    struct pam_data *pd;
+    errno_t ret;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context, struct proto_test_ctx);
+    assert_non_null(test_ctx);
+
+    pd = create_pam_data(test_ctx);
+    assert_non_null(pd);
+
+    pd->cmd = SSS_PAM_CHAUTHTOK;
+    pd->user = talloc_strdup(pd, TEST_USER);
+    pd->domain = talloc_strdup(pd, TEST_DOMAIN);
+    pd->service = talloc_strdup(pd, TEST_SERVICE);
+    pd->tty = talloc_strdup(pd, TEST_TTY);
+    pd->ruser = talloc_strdup(pd, TEST_RUSER);
+    /* rhost is left unset on purpose */
+    pd->priv = 1;
+    pd->cli_pid = TEST_CLI_PID;
+    assert_non_null(pd->user);
+    assert_non_null(pd->domain);
+    assert_non_null(pd->service);
+    assert_non_null(pd->tty);
+    assert_non_null(pd->ruser);
+
+    ret = sss_authtok_set_password(pd->authtok, TEST_PASSWORD, 0);
+    assert_int_equal(ret, EOK);
+    ret = sss_authtok_set_password(pd->newauthtok, TEST_NEW_PASSWORD, 0);
+    assert_int_equal(ret, EOK);
+
+    test_ctx->pd = pd;
+
+    check_leaks_push(test_ctx);
+    *state = test_ctx;
+    return 0;
+}
+
+static int proto_test_teardown(void **state)
+{
+    struct proto_test_ctx *test_ctx;
+
+    test_ctx = talloc_get_type(*state, struct proto_test_ctx);
+
+    assert_true(check_leaks_pop(test_ctx));
+    talloc_free(test_ctx);
+
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+static uint32_t frame_payload_size(struct io_buffer *buf)
+{
+    uint32_t len;
+
+    assert_true(buf->size >= sizeof(uint32_t));
+    memcpy(&len, buf->data, sizeof(uint32_t));
+    assert_int_equal(len, buf->size - sizeof(uint32_t));
+
+    return len;
+}
+
+static void check_authtok(struct sss_auth_token *tok, const char *password)
+{
+    const char *str;
+    size_t len;
+    errno_t ret;
+
+    ret = sss_authtok_get_password(tok, &str, &len);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(len, strlen(password));
+    assert_string_equal(str, password);
+}
+
+static void test_proto_request(void **state)
+{
+    struct proto_test_ctx *test_ctx;
+    struct io_buffer *buf;
+    struct pam_data *pd;
+    uint32_t size;
+    errno_t ret;
+
+    test_ctx = talloc_get_type(*state, struct proto_test_ctx);
+
+    ret = proxy_child_pack_request(test_ctx, test_ctx->pd, &buf);
+    assert_int_equal(ret, EOK);
+    size = frame_payload_size(buf);
+
+    ret = proxy_child_unpack_request(test_ctx, buf->data + sizeof(uint32_t),
+                                     size, &pd);
+    assert_int_equal(ret, EOK);
+
+    assert_int_equal(pd->cmd, SSS_PAM_CHAUTHTOK);
+    assert_string_equal(pd->user, TEST_USER);
+    assert_string_equal(pd->domain, TEST_DOMAIN);
+    assert_string_equal(pd->service, TEST_SERVICE);
+    assert_string_equal(pd->tty, TEST_TTY);
+    assert_string_equal(pd->ruser, TEST_RUSER);
+    /* an unset string is received empty */
+    assert_string_equal(pd->rhost, "");
+    assert_int_equal(pd->priv, 1);
+    assert_int_equal(pd->cli_pid, TEST_CLI_PID);
+    check_authtok(pd->authtok, TEST_PASSWORD);
+    check_authtok(pd->newauthtok, TEST_NEW_PASSWORD);
+
+    talloc_free(pd);
+    talloc_free(buf);
+}
+
+static void test_proto_request_truncated(void **state)
+{
+    struct proto_test_ctx *test_ctx;
+    struct io_buffer *buf;
+    struct pam_data *pd;
+    uint32_t size;
+    uint32_t i;
+    errno_t ret;
+
+    test_ctx = talloc_get_type(*state, struct proto_test_ctx);
+
+    ret = proxy_child_pack_request(test_ctx, test_ctx->pd, &buf);
+    assert_int_equal(ret, EOK);
+    size = frame_payload_size(buf);
+
+    /* Every prefix of the message is rejected without leaking memory */
+    for (i = 0; i < size; i++) {
+        pd = NULL;
+        ret = proxy_child_unpack_request(test_ctx,
+                                         buf->data + sizeof(uint32_t),
+                                         i, &pd);
+        assert_int_equal(ret, EINVAL);
+        assert_null(pd);
+    }
+
+    talloc_free(buf);
+}
+
+static void test_proto_request_bad_length(void **state)
+{
+    struct proto_test_ctx *test_ctx;
+    struct io_buffer *buf;
+    struct pam_data *pd = NULL;
+    uint32_t size;
+    uint32_t len = UINT32_MAX;
+    errno_t ret;
+
+    test_ctx = talloc_get_type(*state, struct proto_test_ctx);
+
+    ret = proxy_child_pack_request(test_ctx, test_ctx->pd, &buf);
+    assert_int_equal(ret, EOK);
+    size = frame_payload_size(buf);
+
+    /* The length of the user name, following the command */
+    memcpy(buf->data + 2 * sizeof(uint32_t), &len, sizeof(uint32_t));
+
+    ret = proxy_child_unpack_request(test_ctx, buf->data + sizeof(uint32_t),
+                                     size, &pd);
+    assert_int_equal(ret, EINVAL);
+    assert_null(pd);
+
+    talloc_free(buf);
+}
+
+static void test_proto_request_too_large(void **state)
+{
+    struct proto_test_ctx *test_ctx;
+    struct io_buffer *buf = NULL;
+    char *user;
+    errno_t ret;
+
+    test_ctx = talloc_get_type(*state, struct proto_test_ctx);
+
+    user = talloc_zero_size(test_ctx->pd, PROXY_CHILD_MAX_FRAME + 1);
+    assert_non_null(user);
+    memset(user, 'a', PROXY_CHILD_MAX_FRAME);
+    talloc_free(test_ctx->pd->user);
+    test_ctx->pd->user = user;
+
+    ret = proxy_child_pack_request(test_ctx, test_ctx->pd, &buf);
+    assert_int_equal(ret, EMSGSIZE);
+    assert_null(buf);
+}
+
+static void add_test_responses(struct pam_data *pd)
+{
+    errno_t ret;
+
+    /* pam_add_response() prepends, the list is RESP1, RESP2 */
+    ret = pam_add_response(pd, SSS_PAM_ENV_ITEM, sizeof(TEST_RESP2),
+                           (const uint8_t *) TEST_RESP2);
+    assert_int_equal(ret, EOK);
+
+    ret = pam_add_response(pd, SSS_PAM_USER_INFO, sizeof(TEST_RESP1),
+                           (const uint8_t *) TEST_RESP1);
+    assert_int_equal(ret, EOK);
+}
+
+static void test_proto_response(void **state)
+{
+    struct proto_test_ctx *test_ctx;
+    struct response_data *resp;
+    struct io_buffer *buf;
+    struct pam_data *pd;
+    uint32_t size;
+    errno_t ret;
+
+    test_ctx = talloc_get_type(*state, struct proto_test_ctx);
+
+    test_ctx->pd->pam_status = PAM_NEW_AUTHTOK_REQD;
+    test_ctx->pd->account_locked = 1;
+    add_test_responses(test_ctx->pd);
+
+    ret = proxy_child_pack_response(test_ctx, test_ctx->pd, &buf);
+    assert_int_equal(ret, EOK);
+    size = frame_payload_size(buf);
+
+    pd = create_pam_data(test_ctx);
+    assert_non_null(pd);
+
+    ret = proxy_child_unpack_response(buf->data + sizeof(uint32_t), size, pd);
+    assert_int_equal(ret, EOK);
+
+    assert_int_equal(pd->pam_status, PAM_NEW_AUTHTOK_REQD);
+    assert_int_equal(pd->account_locked, 1);
+
+    /* The order of the responses is kept */
+    resp = pd->resp_list;
+    assert_non_null(resp);
+    assert_int_equal(resp->type, SSS_PAM_USER_INFO);
+    assert_int_equal(resp->len, sizeof(TEST_RESP1));
+    assert_memory_equal(resp->data, TEST_RESP1, sizeof(TEST_RESP1));
+
+    resp = resp->next;
+    assert_non_null(resp);
+    assert_int_equal(resp->type, SSS_PAM_ENV_ITEM);
+    assert_int_equal(resp->len, sizeof(TEST_RESP2));
+    assert_memory_equal(resp->data, TEST_RESP2, sizeof(TEST_RESP2));
+
+    assert_null(resp->next);
+
+    talloc_free(pd);
+    talloc_free(buf);
+}
+
+static void test_proto_response_empty(void **state)
+{
+    struct proto_test_ctx *test_ctx;
+    struct io_buffer *buf;
+    struct pam_data *pd;
+    uint32_t size;
+    errno_t ret;
+
+    test_ctx = talloc_get_type(*state, struct proto_test_ctx);
+
+    test_ctx->pd->pam_status = PAM_SUCCESS;
+
+    ret = proxy_child_pack_response(test_ctx, test_ctx->pd, &buf);
+    assert_int_equal(ret, EOK);
+    size = frame_payload_size(buf);
+    assert_int_equal(size, 3 * sizeof(uint32_t));
+
+    pd = create_pam_data(test_ctx);
+    assert_non_null(pd);
+    pd->pam_status = PAM_SYSTEM_ERR;
+
+    ret = proxy_child_unpack_response(buf->data + sizeof(uint32_t), size, pd);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(pd->pam_status, PAM_SUCCESS);
+    assert_null(pd->resp_list);
+
+    talloc_free(pd);
+    talloc_free(buf);
+}
+
+static void test_proto_response_truncated(void **state)
+{
+    struct proto_test_ctx *test_ctx;
+    struct io_buffer *buf;
+    struct pam_data *pd;
+    uint32_t size;
+    uint32_t i;
+    errno_t ret;
+
+    test_ctx = talloc_get_type(*state, struct proto_test_ctx);
+
+    test_ctx->pd->pam_status = PAM_SUCCESS;
+    add_test_responses(test_ctx->pd);
+
+    ret = proxy_child_pack_response(test_ctx, test_ctx->pd, &buf);
+    assert_int_equal(ret, EOK);
+    size = frame_payload_size(buf);
+
+    /* A truncated response never reports the status of the child */
+    for (i = 0; i < size; i++) {
+        pd = create_pam_data(test_ctx);
+        assert_non_null(pd);
+        pd->pam_status = PAM_SYSTEM_ERR;
+
+        ret = proxy_child_unpack_response(buf->data + sizeof(uint32_t), i, pd);
+        assert_int_equal(ret, EINVAL);
+        assert_int_equal(pd->pam_status, PAM_SYSTEM_ERR);
+
+        talloc_free(pd);
+    }
+
+    talloc_free(buf);
+}
+
+/* A truncated response leaves the responses the caller already had alone
+ * and adds none of the child's */
+static void test_proto_response_truncated_keeps_old(void **state)
+{
+    struct proto_test_ctx *test_ctx;
+    struct response_data *old;
+    struct io_buffer *buf;
+    struct pam_data *pd;
+    uint32_t size;
+    uint32_t i;
+    errno_t ret;
+
+    test_ctx = talloc_get_type(*state, struct proto_test_ctx);
+
+    test_ctx->pd->pam_status = PAM_SUCCESS;
+    add_test_responses(test_ctx->pd);
+
+    ret = proxy_child_pack_response(test_ctx, test_ctx->pd, &buf);
+    assert_int_equal(ret, EOK);
+    size = frame_payload_size(buf);
+
+    pd = create_pam_data(test_ctx);
+    assert_non_null(pd);
+    ret = pam_add_response(pd, SSS_PAM_DOMAIN_NAME, sizeof(TEST_DOMAIN),
+                           (const uint8_t *) TEST_DOMAIN);
+    assert_int_equal(ret, EOK);
+    old = pd->resp_list;
+
+    check_leaks_push(pd);
+    for (i = 3 * sizeof(uint32_t); i < size; i++) {
+        ret = proxy_child_unpack_response(buf->data + sizeof(uint32_t), i, pd);
+        assert_int_equal(ret, EINVAL);
+
+        assert_ptr_equal(pd->resp_list, old);
+        assert_null(old->next);
+        assert_int_equal(old->type, SSS_PAM_DOMAIN_NAME);
+        assert_memory_equal(old->data, TEST_DOMAIN, sizeof(TEST_DOMAIN));
+    }
+    /* the half parsed responses were freed */
+    assert_true(check_leaks_pop(pd));
+
+    talloc_free(pd);
+    talloc_free(buf);
+}
+
+int main(int argc, const char *argv[])
+{
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_proto_request,
+                                        proto_test_setup,
+                                        proto_test_teardown),
+        cmocka_unit_test_setup_teardown(test_proto_request_truncated,
+                                        proto_test_setup,
+                                        proto_test_teardown),
+        cmocka_unit_test_setup_teardown(test_proto_request_bad_length,
+                                        proto_test_setup,
+                                        proto_test_teardown),
+        cmocka_unit_test_setup_teardown(test_proto_request_too_large,
+                                        proto_test_setup,
+                                        proto_test_teardown),
+        cmocka_unit_test_setup_teardown(test_proto_response,
+                                        proto_test_setup,
+                                        proto_test_teardown),
+        cmocka_unit_test_setup_teardown(test_proto_response_empty,
+                                        proto_test_setup,
+                                        proto_test_teardown),
+        cmocka_unit_test_setup_teardown(test_proto_response_truncated,
+                                        proto_test_setup,
+                                        proto_test_teardown),
+        cmocka_unit_test_setup_teardown(test_proto_response_truncated_keeps_old,
+                                        proto_test_setup,
+                                        proto_test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
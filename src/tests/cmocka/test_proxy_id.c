@@ -0,0 +1,923 @@
+/*
+    Copyright (C) 2017 Red Hat
+
+    SSSD tests: Tests of the proxy identity lookups and their worker threads
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <talloc.h>
+#include <tevent.h>
+#include <errno.h>
+#include <popt.h>
+#include <pthread.h>
+#include <pwd.h>
+#include <grp.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "tests/cmocka/common_mock_be.h"
+#include "providers/proxy/proxy.h"
+
+#define TESTS_PATH "tp_" BASE_FILE_STEM
+#define TEST_CONF_DB "test_proxy_id_conf.ldb"
+#define TEST_DOM_NAME "proxy_id_test"
+#define TEST_ID_PROVIDER "proxy"
+
+/* Must match PROXY_THREAD_SHUTDOWN_TIMEOUT of proxy_threads.c */
+#define TEST_SHUTDOWN_TIMEOUT 5
+
+/* =Stub-NSS-module=======================================================*/
+
+struct stub_user {
+    const char *name;
+    uid_t uid;
+    gid_t gid;
+    /* supplementary groups */
+    gid_t groups[2];
+};
+
+struct stub_group {
+    const char *name;
+    gid_t gid;
+    const char *members[3];
+};
+
+static const struct stub_user stub_users[] = {
+    { "user1", 10001, 10001, { 20000, 0 } },
+    { "user2", 10002, 10002, { 20000, 20001 } },
+    { NULL, 0, 0, { 0, 0 } },
+};
+
+static const struct stub_group stub_groups[] = {
+    { "group1", 10001, { NULL } },
+    { "group2", 10002, { NULL } },
+    { "shared", 20000, { "user1", "user2", NULL } },
+    { "other", 20001, { "user2", NULL } },
+    { NULL, 0, { NULL } },
+};
+
+/* Read and written with proxy_nss_ent_lock held */
+static size_t stub_pwent_idx;
+static size_t stub_grent_idx;
+
+/* The thread the last getpwnam_r() call was made from */
+static pthread_t stub_getpwnam_thread;
+
+static char *stub_copy(char **_pos, char *end, const char *str)
+{
+    char *copy = *_pos;
+    size_t len = strlen(str) + 1;
+
+    if (copy + len > end) {
+        return NULL;
+    }
+
+    memcpy(copy, str, len);
+    *_pos += len;
+    return copy;
+}
+
+static enum nss_status stub_fill_pwd(const struct stub_user *user,
+                                     struct passwd *result,
+                                     char *buffer, size_t buflen,
+                                     int *errnop)
+{
+    char *end = buffer + buflen;
+    char *pos = buffer;
+
+    result->pw_name = stub_copy(&pos, end, user->name);
+    result->pw_passwd = stub_copy(&pos, end, "*");
+    result->pw_gecos = stub_copy(&pos, end, user->name);
+    result->pw_dir = stub_copy(&pos, end, "/home/test");
+    result->pw_shell = stub_copy(&pos, end, "/bin/sh");
+    if (result->pw_shell == NULL) {
+        *errnop = ERANGE;
+        return NSS_STATUS_TRYAGAIN;
+    }
+    result->pw_uid = user->uid;
+    result->pw_gid = user->gid;
+
+    return NSS_STATUS_SUCCESS;
+}
+
+static enum nss_status stub_fill_grp(const struct stub_group *group,
+                                     struct group *result,
+                                     char *buffer, size_t buflen,
+                                     int *errnop)
+{
+    char *end = buffer + buflen;
+    char **members = (char **) buffer;
+    char *pos;
+    size_t i;
+
+    pos = buffer + sizeof(group->members);
+    if (pos > end) {
+        *errnop = ERANGE;
+        return NSS_STATUS_TRYAGAIN;
+    }
+
+    result->gr_name = stub_copy(&pos, end, group->name);
+    result->gr_passwd = stub_copy(&pos, end, "*");
+    if (result->gr_passwd == NULL) {
+        *errnop = ERANGE;
+        return NSS_STATUS_TRYAGAIN;
+    }
+    for (i = 0; group->members[i] != NULL; i++) {
+        members[i] = stub_copy(&pos, end, group->members[i]);
+        if (members[i] == NULL) {
+            *errnop = ERANGE;
+            return NSS_STATUS_TRYAGAIN;
+        }
+    }
+    members[i] = NULL;
+    result->gr_mem = members;
+    result->gr_gid = group->gid;
+
+    return NSS_STATUS_SUCCESS;
+}
+
+static enum nss_status stub_getpwnam_r(const char *name,
+                                       struct passwd *result,
+                                       char *buffer, size_t buflen,
+                                       int *errnop)
+{
+    size_t i;
+
+    stub_getpwnam_thread = pthread_self();
+
+    for (i = 0; stub_users[i].name != NULL; i++) {
+        if (strcmp(stub_users[i].name, name) == 0) {
+            return stub_fill_pwd(&stub_users[i], result, buffer, buflen,
+                                 errnop);
+        }
+    }
+
+    return NSS_STATUS_NOTFOUND;
+}
+
+static enum nss_status stub_getpwuid_r(uid_t uid,
+                                       struct passwd *result,
+                                       char *buffer, size_t buflen,
+                                       int *errnop)
+{
+    size_t i;
+
+    for (i = 0; stub_users[i].name != NULL; i++) {
+        if (stub_users[i].uid == uid) {
+            return stub_fill_pwd(&stub_users[i], result, buffer, buflen,
+                                 errnop);
+        }
+    }
+
+    return NSS_STATUS_NOTFOUND;
+}
+
+static enum nss_status stub_setpwent(void)
+{
+    stub_pwent_idx = 0;
+    return NSS_STATUS_SUCCESS;
+}
+
+static enum nss_status stub_getpwent_r(struct passwd *result,
+                                       char *buffer, size_t buflen,
+                                       int *errnop)
+{
+    enum nss_status status;
+
+    if (stub_users[stub_pwent_idx].name == NULL) {
+        return NSS_STATUS_NOTFOUND;
+    }
+
+    status = stub_fill_pwd(&stub_users[stub_pwent_idx], result,
+                           buffer, buflen, errnop);
+    if (status == NSS_STATUS_SUCCESS) {
+        stub_pwent_idx++;
+    }
+    return status;
+}
+
+static enum nss_status stub_endpwent(void)
+{
+    return NSS_STATUS_SUCCESS;
+}
+
+static enum nss_status stub_getgrnam_r(const char *name,
+                                       struct group *result,
+                                       char *buffer, size_t buflen,
+                                       int *errnop)
+{
+    size_t i;
+
+    for (i = 0; stub_groups[i].name != NULL; i++) {
+        if (strcmp(stub_groups[i].name, name) == 0) {
+            return stub_fill_grp(&stub_groups[i], result, buffer, buflen,
+                                 errnop);
+        }
+    }
+
+    return NSS_STATUS_NOTFOUND;
+}
+
+static enum nss_status stub_getgrgid_r(gid_t gid,
+                                       struct group *result,
+                                       char *buffer, size_t buflen,
+                                       int *errnop)
+{
+    size_t i;
+
+    for (i = 0; stub_groups[i].name != NULL; i++) {
+        if (stub_groups[i].gid == gid) {
+            return stub_fill_grp(&stub_groups[i], result, buffer, buflen,
+                                 errnop);
+        }
+    }
+
+    return NSS_STATUS_NOTFOUND;
+}
+
+static enum nss_status stub_setgrent(void)
+{
+    stub_grent_idx = 0;
+    return NSS_STATUS_SUCCESS;
+}
+
+static enum nss_status stub_getgrent_r(struct group *result,
+                                       char *buffer, size_t buflen,
+                                       int *errnop)
+{
+    enum nss_status status;
+
+    if (stub_groups[stub_grent_idx].name == NULL) {
+        return NSS_STATUS_NOTFOUND;
+    }
+
+    status = stub_fill_grp(&stub_groups[stub_grent_idx], result,
+                           buffer, buflen, errnop);
+    if (status == NSS_STATUS_SUCCESS) {
+        stub_grent_idx++;
+    }
+    return status;
+}
+
+static enum nss_status stub_endgrent(void)
+{
+    return NSS_STATUS_SUCCESS;
+}
+
+static enum nss_status stub_initgroups_dyn(const char *user, gid_t group,
+                                           long int *start, long int *size,
+                                           gid_t **groups, long int limit,
+                                           int *errnop)
+{
+    size_t i;
+    size_t j;
+
+    for (i = 0; stub_users[i].name != NULL; i++) {
+        if (strcmp(stub_users[i].name, user) != 0) {
+            continue;
+        }
+
+        for (j = 0; j < 2 && stub_users[i].groups[j] != 0; j++) {
+            if (*start == *size) {
+                *errnop = ERANGE;
+                return NSS_STATUS_TRYAGAIN;
+            }
+            (*groups)[*start] = stub_users[i].groups[j];
+            (*start)++;
+        }
+
+        return NSS_STATUS_SUCCESS;
+    }
+
+    return NSS_STATUS_NOTFOUND;
+}
+
+/* =Setup/Teardown========================================================*/
+
+struct proxy_id_test_ctx {
+    struct sss_test_ctx *tctx;
+    struct be_ctx *be_ctx;
+    struct proxy_id_ctx *id_ctx;
+    struct dp_reply_std reply;
+};
+
+static int test_proxy_id_setup(void **state, int max_threads)
+{
+    struct proxy_id_test_ctx *test_ctx;
+    struct proxy_nss_ops *ops;
+    errno_t ret;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context, struct proxy_id_test_ctx);
+    assert_non_null(test_ctx);
+
+    test_ctx->tctx = create_dom_test_ctx(test_ctx, TESTS_PATH, TEST_CONF_DB,
+                                         TEST_DOM_NAME, TEST_ID_PROVIDER,
+                                         NULL);
+    assert_non_null(test_ctx->tctx);
+
+    test_ctx->be_ctx = mock_be_ctx(test_ctx, test_ctx->tctx);
+    assert_non_null(test_ctx->be_ctx);
+
+    test_ctx->id_ctx = talloc_zero(test_ctx, struct proxy_id_ctx);
+    assert_non_null(test_ctx->id_ctx);
+    test_ctx->id_ctx->be = test_ctx->be_ctx;
+
+    ops = &test_ctx->id_ctx->ops;
+    ops->getpwnam_r = stub_getpwnam_r;
+    ops->getpwuid_r = stub_getpwuid_r;
+    ops->setpwent = stub_setpwent;
+    ops->getpwent_r = stub_getpwent_r;
+    ops->endpwent = stub_endpwent;
+    ops->getgrnam_r = stub_getgrnam_r;
+    ops->getgrgid_r = stub_getgrgid_r;
+    ops->setgrent = stub_setgrent;
+    ops->getgrent_r = stub_getgrent_r;
+    ops->endgrent = stub_endgrent;
+    ops->initgroups_dyn = stub_initgroups_dyn;
+
+    ret = proxy_thread_pool_init(test_ctx->id_ctx, test_ctx->tctx->ev,
+                                 max_threads, &test_ctx->id_ctx->threads);
+    assert_int_equal(ret, EOK);
+
+    check_leaks_push(test_ctx);
+    *state = test_ctx;
+    return 0;
+}
+
+static int test_proxy_id_setup_inline(void **state)
+{
+    return test_proxy_id_setup(state, 0);
+}
+
+static int test_proxy_id_setup_threads(void **state)
+{
+    return test_proxy_id_setup(state, 2);
+}
+
+static int test_proxy_id_teardown(void **state)
+{
+    struct proxy_id_test_ctx *test_ctx;
+
+    test_ctx = talloc_get_type_abort(*state, struct proxy_id_test_ctx);
+
+    assert_true(check_leaks_pop(test_ctx));
+    talloc_zfree(test_ctx);
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+/* =Job-queue-tests=======================================================*/
+
+struct test_job {
+    int calls;
+    /* if set, the job reports it has started and then hangs until a byte
+     * can be read from block_fd */
+    int started_fd;
+    int block_fd;
+};
+
+/* Runs in a worker thread */
+static void test_job_fn(void *pvt)
+{
+    struct test_job *job = pvt;
+    ssize_t len;
+    char c;
+
+    if (job->block_fd != -1) {
+        do {
+            len = write(job->started_fd, "", 1);
+        } while (len == -1 && errno == EINTR);
+
+        do {
+            len = read(job->block_fd, &c, 1);
+        } while (len == -1 && errno == EINTR);
+    }
+
+    job->calls++;
+}
+
+struct test_job_result {
+    struct sss_test_ctx *tctx;
+    struct test_job *job;
+    int pending;
+    int done;
+    int cancelled;
+};
+
+static void test_job_done(struct tevent_req *req)
+{
+    struct test_job_result *result;
+    void *pvt = NULL;
+    errno_t ret;
+
+    result = tevent_req_callback_data(req, struct test_job_result);
+
+    ret = proxy_thread_job_recv(result, req, &pvt);
+    talloc_free(req);
+
+    if (ret == EOK) {
+        result->job = talloc_get_type(pvt, struct test_job);
+        assert_non_null(result->job);
+        assert_int_equal(result->job->calls, 1);
+        result->done++;
+    } else {
+        assert_int_equal(ret, ECANCELED);
+        result->cancelled++;
+    }
+
+    result->pending--;
+    if (result->pending == 0) {
+        test_ev_done(result->tctx, EOK);
+    }
+}
+
+static struct tevent_req *test_job_send(struct proxy_id_test_ctx *test_ctx,
+                                        struct test_job_result *result,
+                                        int started_fd,
+                                        int block_fd,
+                                        struct test_job **_job)
+{
+    struct tevent_req *req;
+    struct test_job *job;
+
+    job = talloc_zero(result, struct test_job);
+    assert_non_null(job);
+    job->started_fd = started_fd;
+    job->block_fd = block_fd;
+    if (_job != NULL) {
+        *_job = job;
+    }
+
+    req = proxy_thread_job_send(test_ctx, test_ctx->tctx->ev,
+                                test_ctx->id_ctx->threads,
+                                test_job_fn, job);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_job_done, result);
+    result->pending++;
+
+    return req;
+}
+
+void test_thread_job_inline(void **state)
+{
+    struct proxy_id_test_ctx *test_ctx;
+    struct test_job_result *result;
+    struct test_job *job;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct proxy_id_test_ctx);
+
+    result = talloc_zero(test_ctx, struct test_job_result);
+    assert_non_null(result);
+    result->tctx = test_ctx->tctx;
+
+    test_job_send(test_ctx, result, -1, -1, &job);
+
+    /* Without worker threads the job is run right away, the request
+     * finishes from the event loop */
+    assert_int_equal(job->calls, 1);
+    assert_int_equal(result->done, 0);
+
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(result->done, 1);
+    assert_int_equal(result->job->calls, 1);
+
+    talloc_free(result);
+}
+
+void test_thread_job_queue(void **state)
+{
+    struct proxy_id_test_ctx *test_ctx;
+    struct test_job_result *result;
+    int i;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct proxy_id_test_ctx);
+
+    result = talloc_zero(test_ctx, struct test_job_result);
+    assert_non_null(result);
+    result->tctx = test_ctx->tctx;
+
+    /* More jobs than threads, the rest waits in the queue */
+    for (i = 0; i < 8; i++) {
+        test_job_send(test_ctx, result, -1, -1, NULL);
+    }
+
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(result->done, 8);
+    assert_int_equal(result->cancelled, 0);
+
+    talloc_free(result);
+}
+
+void test_thread_job_abandoned(void **state)
+{
+    struct proxy_id_test_ctx *test_ctx;
+    struct test_job_result *result;
+    struct tevent_req *req;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct proxy_id_test_ctx);
+
+    result = talloc_zero(test_ctx, struct test_job_result);
+    assert_non_null(result);
+    result->tctx = test_ctx->tctx;
+
+    /* The caller is gone, the job is still finished and freed */
+    req = test_job_send(test_ctx, result, -1, -1, NULL);
+    talloc_free(req);
+    result->pending--;
+
+    test_job_send(test_ctx, result, -1, -1, NULL);
+
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(result->done, 1);
+
+    talloc_free(result);
+}
+
+void test_thread_pool_shutdown(void **state)
+{
+    struct proxy_id_test_ctx *test_ctx;
+    struct test_job_result *result;
+    struct tevent_req *blocked[2];
+    time_t start;
+    ssize_t len;
+    char buf[2];
+    int started[2];
+    int block[2];
+    int ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct proxy_id_test_ctx);
+
+    result = talloc_zero(test_ctx, struct test_job_result);
+    assert_non_null(result);
+    result->tctx = test_ctx->tctx;
+
+    ret = pipe(started);
+    assert_int_equal(ret, 0);
+    ret = pipe(block);
+    assert_int_equal(ret, 0);
+
+    /* Both workers hang in the NSS module, the third job is queued */
+    blocked[0] = test_job_send(test_ctx, result, started[1], block[0], NULL);
+    blocked[1] = test_job_send(test_ctx, result, started[1], block[0], NULL);
+    test_job_send(test_ctx, result, -1, -1, NULL);
+
+    len = read(started[0], buf, 1);
+    assert_int_equal(len, 1);
+    len = read(started[0], buf, 1);
+    assert_int_equal(len, 1);
+
+    start = time(NULL);
+    talloc_zfree(test_ctx->id_ctx->threads);
+
+    /* The shutdown does not wait for the hanging workers forever */
+    assert_true(time(NULL) - start >= TEST_SHUTDOWN_TIMEOUT - 1);
+    assert_true(time(NULL) - start <= TEST_SHUTDOWN_TIMEOUT + 1);
+
+    /* The queued job was cancelled */
+    assert_int_equal(result->cancelled, 1);
+    assert_int_equal(result->done, 0);
+
+    /* The requests of the hanging jobs never finish, release them and
+     * let the workers go */
+    talloc_free(blocked[0]);
+    talloc_free(blocked[1]);
+    talloc_free(result);
+
+    len = write(block[1], "xx", 2);
+    assert_int_equal(len, 2);
+
+    close(started[0]);
+    close(started[1]);
+    close(block[1]);
+}
+
+/* =Lookup-tests==========================================================*/
+
+static void test_account_info_done(struct tevent_req *req)
+{
+    struct proxy_id_test_ctx *test_ctx;
+    errno_t ret;
+
+    test_ctx = tevent_req_callback_data(req, struct proxy_id_test_ctx);
+
+    ret = proxy_account_info_handler_recv(test_ctx, req, &test_ctx->reply);
+    talloc_free(req);
+    assert_int_equal(ret, EOK);
+
+    test_ev_done(test_ctx->tctx, test_ctx->reply.error);
+}
+
+static errno_t test_account_info(struct proxy_id_test_ctx *test_ctx,
+                                 uint32_t entry_type,
+                                 uint32_t filter_type,
+                                 const char *filter_value)
+{
+    struct dp_req_params params;
+    struct dp_id_data data;
+    struct tevent_req *req;
+    char *fqname = NULL;
+    errno_t ret;
+
+    memset(&params, 0, sizeof(params));
+    params.ev = test_ctx->tctx->ev;
+    params.be_ctx = test_ctx->be_ctx;
+    params.domain = test_ctx->tctx->dom;
+    params.target = DPT_ID;
+    params.method = DPM_ACCOUNT_HANDLER;
+
+    if (filter_type == BE_FILTER_NAME) {
+        fqname = sss_create_internal_fqname(test_ctx, filter_value,
+                                            test_ctx->tctx->dom->name);
+        assert_non_null(fqname);
+        filter_value = fqname;
+    }
+
+    memset(&data, 0, sizeof(data));
+    data.entry_type = entry_type;
+    data.filter_type = filter_type;
+    data.filter_value = filter_value;
+    data.domain = test_ctx->tctx->dom->name;
+
+    test_ctx->tctx->done = false;
+    req = proxy_account_info_handler_send(test_ctx, test_ctx->id_ctx,
+                                          &data, &params);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_account_info_done, test_ctx);
+
+    ret = test_ev_loop(test_ctx->tctx);
+    talloc_free(fqname);
+    return ret;
+}
+
+static void assert_user_cached(struct proxy_id_test_ctx *test_ctx,
+                               const char *name, uid_t uid)
+{
+    struct ldb_result *res;
+    char *fqname;
+    errno_t ret;
+
+    fqname = sss_create_internal_fqname(test_ctx, name,
+                                        test_ctx->tctx->dom->name);
+    assert_non_null(fqname);
+
+    ret = sysdb_getpwnam(test_ctx, test_ctx->tctx->dom, fqname, &res);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(res->count, 1);
+    assert_int_equal(ldb_msg_find_attr_as_uint(res->msgs[0],
+                                               SYSDB_UIDNUM, 0), uid);
+
+    talloc_free(res);
+    talloc_free(fqname);
+}
+
+void test_getpwnam(void **state)
+{
+    struct proxy_id_test_ctx *test_ctx;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct proxy_id_test_ctx);
+
+    ret = test_account_info(test_ctx, BE_REQ_USER, BE_FILTER_NAME, "user1");
+    assert_int_equal(ret, EOK);
+    assert_int_equal(test_ctx->reply.dp_error, DP_ERR_OK);
+
+    assert_user_cached(test_ctx, "user1", 10001);
+}
+
+void test_getpwnam_inline(void **state)
+{
+    test_getpwnam(state);
+
+    /* Without worker threads the module is called from the main thread */
+    assert_true(pthread_equal(stub_getpwnam_thread, pthread_self()));
+}
+
+void test_getpwnam_threads(void **state)
+{
+    test_getpwnam(state);
+
+    assert_false(pthread_equal(stub_getpwnam_thread, pthread_self()));
+}
+
+void test_getpwnam_missing(void **state)
+{
+    struct proxy_id_test_ctx *test_ctx;
+    struct ldb_result *res;
+    char *fqname;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct proxy_id_test_ctx);
+
+    ret = test_account_info(test_ctx, BE_REQ_USER, BE_FILTER_NAME, "nouser");
+    assert_int_equal(ret, EOK);
+    assert_int_equal(test_ctx->reply.dp_error, DP_ERR_OK);
+
+    fqname = sss_create_internal_fqname(test_ctx, "nouser",
+                                        test_ctx->tctx->dom->name);
+    assert_non_null(fqname);
+    ret = sysdb_getpwnam(test_ctx, test_ctx->tctx->dom, fqname, &res);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(res->count, 0);
+
+    talloc_free(res);
+    talloc_free(fqname);
+}
+
+void test_getpwuid(void **state)
+{
+    struct proxy_id_test_ctx *test_ctx;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct proxy_id_test_ctx);
+
+    ret = test_account_info(test_ctx, BE_REQ_USER, BE_FILTER_IDNUM, "10002");
+    assert_int_equal(ret, EOK);
+    assert_int_equal(test_ctx->reply.dp_error, DP_ERR_OK);
+
+    assert_user_cached(test_ctx, "user2", 10002);
+}
+
+void test_enum_users(void **state)
+{
+    struct proxy_id_test_ctx *test_ctx;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct proxy_id_test_ctx);
+
+    ret = test_account_info(test_ctx, BE_REQ_USER, BE_FILTER_ENUM, NULL);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(test_ctx->reply.dp_error, DP_ERR_OK);
+
+    assert_user_cached(test_ctx, "user1", 10001);
+    assert_user_cached(test_ctx, "user2", 10002);
+}
+
+void test_enum_groups(void **state)
+{
+    struct proxy_id_test_ctx *test_ctx;
+    struct ldb_result *res;
+    char *fqname;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct proxy_id_test_ctx);
+
+    ret = test_account_info(test_ctx, BE_REQ_GROUP, BE_FILTER_ENUM, NULL);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(test_ctx->reply.dp_error, DP_ERR_OK);
+
+    fqname = sss_create_internal_fqname(test_ctx, "shared",
+                                        test_ctx->tctx->dom->name);
+    assert_non_null(fqname);
+    ret = sysdb_getgrnam(test_ctx, test_ctx->tctx->dom, fqname, &res);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(res->count, 1);
+    assert_int_equal(ldb_msg_find_attr_as_uint(res->msgs[0],
+                                               SYSDB_GIDNUM, 0), 20000);
+    talloc_free(res);
+    talloc_free(fqname);
+
+    ret = sysdb_getgrgid(test_ctx, test_ctx->tctx->dom, 20001, &res);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(res->count, 1);
+    talloc_free(res);
+}
+
+void test_initgroups(void **state)
+{
+    struct proxy_id_test_ctx *test_ctx;
+    struct ldb_result *res;
+    char *fqname;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct proxy_id_test_ctx);
+
+    ret = test_account_info(test_ctx, BE_REQ_INITGROUPS, BE_FILTER_NAME,
+                            "user2");
+    assert_int_equal(ret, EOK);
+    assert_int_equal(test_ctx->reply.dp_error, DP_ERR_OK);
+
+    fqname = sss_create_internal_fqname(test_ctx, "user2",
+                                        test_ctx->tctx->dom->name);
+    assert_non_null(fqname);
+
+    /* The user and both groups that list it as a member */
+    ret = sysdb_initgroups(test_ctx, test_ctx->tctx->dom, fqname, &res);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(res->count, 3);
+    talloc_free(res);
+    talloc_free(fqname);
+
+    /* The primary group is looked up as well */
+    ret = sysdb_getgrgid(test_ctx, test_ctx->tctx->dom, 10002, &res);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(res->count, 1);
+    talloc_free(res);
+}
+
+int main(int argc, const char *argv[])
+{
+    poptContext pc;
+    int opt;
+    int rv;
+    int no_cleanup = 0;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        {"no-cleanup", 'n', POPT_ARG_NONE, &no_cleanup, 0,
+         _("Do not delete the test database after a test run"), NULL },
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_thread_job_inline,
+                                        test_proxy_id_setup_inline,
+                                        test_proxy_id_teardown),
+        cmocka_unit_test_setup_teardown(test_thread_job_queue,
+                                        test_proxy_id_setup_threads,
+                                        test_proxy_id_teardown),
+        cmocka_unit_test_setup_teardown(test_thread_job_abandoned,
+                                        test_proxy_id_setup_threads,
+                                        test_proxy_id_teardown),
+        cmocka_unit_test_setup_teardown(test_getpwnam_inline,
+                                        test_proxy_id_setup_inline,
+                                        test_proxy_id_teardown),
+        cmocka_unit_test_setup_teardown(test_getpwnam_threads,
+                                        test_proxy_id_setup_threads,
+                                        test_proxy_id_teardown),
+        cmocka_unit_test_setup_teardown(test_getpwnam_missing,
+                                        test_proxy_id_setup_threads,
+                                        test_proxy_id_teardown),
+        cmocka_unit_test_setup_teardown(test_getpwuid,
+                                        test_proxy_id_setup_threads,
+                                        test_proxy_id_teardown),
+        cmocka_unit_test_setup_teardown(test_enum_users,
+                                        test_proxy_id_setup_inline,
+                                        test_proxy_id_teardown),
+        cmocka_unit_test_setup_teardown(test_enum_users,
+                                        test_proxy_id_setup_threads,
+                                        test_proxy_id_teardown),
+        cmocka_unit_test_setup_teardown(test_enum_groups,
+                                        test_proxy_id_setup_threads,
+                                        test_proxy_id_teardown),
+        cmocka_unit_test_setup_teardown(test_initgroups,
+                                        test_proxy_id_setup_inline,
+                                        test_proxy_id_teardown),
+        cmocka_unit_test_setup_teardown(test_initgroups,
+                                        test_proxy_id_setup_threads,
+                                        test_proxy_id_teardown),
+        /* Leaves two workers behind, keep it last */
+        cmocka_unit_test_setup_teardown(test_thread_pool_shutdown,
+                                        test_proxy_id_setup_threads,
+                                        test_proxy_id_teardown),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    /* Even though normally the tests should clean up after themselves
+     * they might not after a failed run. Remove the old db to be sure */
+    tests_set_cwd();
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    test_dom_suite_setup(TESTS_PATH);
+
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+    if (rv == 0 && !no_cleanup) {
+        test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    }
+    return rv;
+}
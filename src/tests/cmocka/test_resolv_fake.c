@@ -258,6 +258,25 @@ static int test_resolv_fake_teardown(void **state)
     return 0;
 }
 
+static void check_srv_replies(struct ares_srv_reply *srv_replies)
+{
+    assert_non_null(srv_replies);
+    assert_int_equal(srv_replies->priority, 1);
+    assert_int_equal(srv_replies->weight, 40);
+    assert_int_equal(srv_replies->port, 389);
+    assert_string_equal(srv_replies->host, "ldap.sssd.com");
+
+    srv_replies = srv_replies->next;
+    assert_non_null(srv_replies);
+    assert_int_equal(srv_replies->priority, 1);
+    assert_int_equal(srv_replies->weight, 60);
+    assert_int_equal(srv_replies->port, 389);
+    assert_string_equal(srv_replies->host, "ldap2.sssd.com");
+
+    srv_replies = srv_replies->next;
+    assert_null(srv_replies);
+}
+
 void test_resolv_fake_srv_done(struct tevent_req *req)
 {
     errno_t ret;
@@ -275,29 +294,78 @@ void test_resolv_fake_srv_done(struct tevent_req *req)
                              &srv_replies, &ttl);
     assert_int_equal(ret, EOK);
 
-    assert_non_null(srv_replies);
-    assert_int_equal(srv_replies->priority, 1);
-    assert_int_equal(srv_replies->weight, 40);
-    assert_int_equal(srv_replies->port, 389);
-    assert_string_equal(srv_replies->host, "ldap.sssd.com");
+    check_srv_replies(srv_replies);
+    assert_int_equal(ttl, 500);
 
-    srv_replies = srv_replies->next;
-    assert_non_null(srv_replies);
-    assert_int_equal(srv_replies->priority, 1);
-    assert_int_equal(srv_replies->weight, 60);
-    assert_int_equal(srv_replies->port, 389);
-    assert_string_equal(srv_replies->host, "ldap2.sssd.com");
+    talloc_free(tmp_ctx);
+    test_ev_done(test_ctx->ctx, EOK);
+}
 
-    srv_replies = srv_replies->next;
-    assert_null(srv_replies);
+void test_resolv_fake_srv(void **state)
+{
+    int ret;
+    struct tevent_req *req;
+    struct resolv_fake_ctx *test_ctx =
+        talloc_get_type(*state, struct resolv_fake_ctx);
 
-    assert_int_equal(ttl, 500);
+    unsigned char *buf;
+    size_t buflen;
+
+    struct srv_rrdata rr[2];
+
+    rr[0].prio = 1;
+    rr[0].port = 389;
+    rr[0].weight = 40;
+    rr[0].ttl = 600;
+    rr[0].hostname = "ldap.sssd.com";
+
+    rr[1].prio = 1;
+    rr[1].port = 389;
+    rr[1].weight = 60;
+    rr[1].ttl = 500;
+    rr[1].hostname = "ldap2.sssd.com";
+
+    buf = create_srv_buffer(test_ctx, TEST_SRV_QUERY, rr, 2, &buflen);
+    assert_non_null(buf);
+    mock_ares_query(0, 0, buf, buflen);
+
+    req = resolv_getsrv_send(test_ctx, test_ctx->ctx->ev,
+                             test_ctx->resolv, TEST_SRV_QUERY);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_resolv_fake_srv_done, test_ctx);
+
+    ret = test_ev_loop(test_ctx->ctx);
+    assert_int_equal(ret, ERR_OK);
+}
+
+void test_resolv_fake_srv_cached_done(struct tevent_req *req)
+{
+    errno_t ret;
+    TALLOC_CTX *tmp_ctx;
+    int status;
+    uint32_t ttl;
+    struct ares_srv_reply *srv_replies = NULL;
+    struct resolv_fake_ctx *test_ctx =
+        tevent_req_callback_data(req, struct resolv_fake_ctx);
+
+    tmp_ctx = talloc_new(test_ctx);
+    assert_non_null(tmp_ctx);
+
+    ret = resolv_getsrv_recv(tmp_ctx, req, &status, NULL,
+                             &srv_replies, &ttl);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(status, ARES_SUCCESS);
+
+    check_srv_replies(srv_replies);
+    /* The remaining TTL of the cached answer is returned */
+    assert_true(ttl <= 500);
+    assert_true(ttl >= 498);
 
     talloc_free(tmp_ctx);
     test_ev_done(test_ctx->ctx, EOK);
 }
 
-void test_resolv_fake_srv(void **state)
+void test_resolv_fake_srv_cached(void **state)
 {
     int ret;
     struct tevent_req *req;
@@ -309,6 +377,9 @@ void test_resolv_fake_srv(void **state)
 
     struct srv_rrdata rr[2];
 
+    resolv_set_cache(test_ctx->resolv, true, RESOLV_DEFAULT_NEGATIVE_TTL,
+                     RESOLV_DEFAULT_STALE_TIME);
+
     rr[0].prio = 1;
     rr[0].port = 389;
     rr[0].weight = 40;
@@ -323,6 +394,7 @@ void test_resolv_fake_srv(void **state)
 
     buf = create_srv_buffer(test_ctx, TEST_SRV_QUERY, rr, 2, &buflen);
     assert_non_null(buf);
+    /* Only the first lookup reaches the DNS library */
     mock_ares_query(0, 0, buf, buflen);
 
     req = resolv_getsrv_send(test_ctx, test_ctx->ctx->ev,
@@ -332,6 +404,49 @@ void test_resolv_fake_srv(void **state)
 
     ret = test_ev_loop(test_ctx->ctx);
     assert_int_equal(ret, ERR_OK);
+
+    test_ctx->ctx->done = false;
+
+    req = resolv_getsrv_send(test_ctx, test_ctx->ctx->ev,
+                             test_ctx->resolv, TEST_SRV_QUERY);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_resolv_fake_srv_cached_done, test_ctx);
+
+    ret = test_ev_loop(test_ctx->ctx);
+    assert_int_equal(ret, ERR_OK);
+}
+
+void test_resolv_fake_srv_negative_cached(void **state)
+{
+    int ret;
+    struct tevent_req *req;
+    struct resolv_fake_ctx *test_ctx =
+        talloc_get_type(*state, struct resolv_fake_ctx);
+    int status;
+
+    resolv_set_cache(test_ctx->resolv, true, RESOLV_DEFAULT_NEGATIVE_TTL,
+                     RESOLV_DEFAULT_STALE_TIME);
+
+    /* Only the first lookup reaches the DNS library */
+    mock_ares_query(ARES_ENOTFOUND, 0, NULL, 0);
+
+    req = resolv_getsrv_send(test_ctx, test_ctx->ctx->ev,
+                             test_ctx->resolv, TEST_SRV_QUERY);
+    assert_non_null(req);
+    tevent_loop_once(test_ctx->ctx->ev);
+    ret = resolv_getsrv_recv(test_ctx, req, &status, NULL, NULL, NULL);
+    assert_int_equal(ret, EIO);
+    assert_int_equal(status, ARES_ENOTFOUND);
+    talloc_free(req);
+
+    req = resolv_getsrv_send(test_ctx, test_ctx->ctx->ev,
+                             test_ctx->resolv, TEST_SRV_QUERY);
+    assert_non_null(req);
+    tevent_loop_once(test_ctx->ctx->ev);
+    ret = resolv_getsrv_recv(test_ctx, req, &status, NULL, NULL, NULL);
+    assert_int_equal(ret, EIO);
+    assert_int_equal(status, ARES_ENOTFOUND);
+    talloc_free(req);
 }
 
 void test_resolv_is_address(void **state)
@@ -372,6 +487,12 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_resolv_fake_srv,
                                         test_resolv_fake_setup,
                                         test_resolv_fake_teardown),
+        cmocka_unit_test_setup_teardown(test_resolv_fake_srv_cached,
+                                        test_resolv_fake_setup,
+                                        test_resolv_fake_teardown),
+        cmocka_unit_test_setup_teardown(test_resolv_fake_srv_negative_cached,
+                                        test_resolv_fake_setup,
+                                        test_resolv_fake_teardown),
         cmocka_unit_test(test_resolv_is_address),
     };
 
@@ -26,6 +26,7 @@
 #include "tests/cmocka/common_mock.h"
 #include "tests/cmocka/common_mock_resp.h"
 #include "db/sysdb.h"
+#include "providers/data_provider/dp_flags.h"
 #include "responder/common/cache_req/cache_req.h"
 
 #define TESTS_PATH "tp_" BASE_FILE_STEM
@@ -113,6 +114,8 @@ struct cache_req_test_ctx {
 
     struct cache_req_result *result;
     bool dp_called;
+    int dp_calls;
+    uint32_t dp_flags;
 
     /* NOTE: Please, instead of adding new create_[user|group] bool,
      * use bitshift. */
@@ -421,7 +424,7 @@ struct tevent_req *
 __wrap_sss_dp_get_account_send(TALLOC_CTX *mem_ctx,
                                struct resp_ctx *rctx,
                                struct sss_domain_info *dom,
-                               bool fast_reply,
+                               uint32_t dp_flags,
                                enum sss_dp_acct_type type,
                                const char *opt_name,
                                uint32_t opt_id,
@@ -431,6 +434,8 @@ __wrap_sss_dp_get_account_send(TALLOC_CTX *mem_ctx,
 
     ctx = sss_mock_ptr_type(struct cache_req_test_ctx*);
     ctx->dp_called = true;
+    ctx->dp_calls++;
+    ctx->dp_flags = dp_flags;
 
     if (ctx->create_user1) {
         prepare_user(ctx->tctx->dom, &users[0], 1000, time(NULL));
@@ -583,6 +588,121 @@ void test_user_by_name_multiple_domains_notfound(void **state)
     assert_true(test_ctx->dp_called);
 }
 
+void test_user_by_name_multiple_domains_concurrent(void **state)
+{
+    struct cache_req_test_ctx *test_ctx = NULL;
+    struct sss_domain_info *domain_b = NULL;
+    struct sss_domain_info *domain_d = NULL;
+
+    test_ctx = talloc_get_type_abort(*state, struct cache_req_test_ctx);
+    test_ctx->rctx->domain_lookup_concurrency = 3;
+
+    /* Setup the same user in two domains, the first one in the resolution
+     * order must win even if the searches run at the same time. */
+    domain_b = find_domain_by_name(test_ctx->tctx->dom,
+                                   "responder_cache_req_test_b", true);
+    assert_non_null(domain_b);
+    domain_d = find_domain_by_name(test_ctx->tctx->dom,
+                                   "responder_cache_req_test_d", true);
+    assert_non_null(domain_d);
+
+    prepare_user(domain_d, &users[0], 1000, time(NULL));
+    prepare_user(domain_b, &users[0], 1000, time(NULL));
+
+    /* Mock values. */
+    will_return_always(__wrap_sss_dp_get_account_send, test_ctx);
+    will_return_always(sss_dp_req_recv, 0);
+    mock_parse_inp(users[0].short_name, NULL, ERR_OK);
+
+    /* Test. */
+    run_user_by_name(test_ctx, NULL, 0, ERR_OK);
+    check_user(test_ctx, &users[0], domain_b);
+
+    /* Only the domain that precedes the first cache hit is looked up */
+    assert_int_equal(test_ctx->dp_calls, 1);
+}
+
+void test_user_by_name_multiple_domains_concurrent_cached(void **state)
+{
+    struct cache_req_test_ctx *test_ctx = NULL;
+    struct sss_domain_info *domain_a = NULL;
+    struct sss_domain_info *domain_c = NULL;
+
+    test_ctx = talloc_get_type_abort(*state, struct cache_req_test_ctx);
+    test_ctx->rctx->domain_lookup_concurrency = 4;
+
+    domain_a = find_domain_by_name(test_ctx->tctx->dom,
+                                   "responder_cache_req_test_a", true);
+    assert_non_null(domain_a);
+    domain_c = find_domain_by_name(test_ctx->tctx->dom,
+                                   "responder_cache_req_test_c", true);
+    assert_non_null(domain_c);
+
+    prepare_user(domain_c, &users[0], 1000, time(NULL));
+    prepare_user(domain_a, &users[0], 1000, time(NULL));
+
+    /* Mock values. */
+    mock_parse_inp(users[0].short_name, NULL, ERR_OK);
+
+    /* Test. */
+    run_user_by_name(test_ctx, NULL, 0, ERR_OK);
+    check_user(test_ctx, &users[0], domain_a);
+
+    /* A hit in the cache of the first domain needs no data provider */
+    assert_false(test_ctx->dp_called);
+    assert_int_equal(test_ctx->dp_calls, 0);
+}
+
+void test_user_by_name_multiple_domains_concurrent_dp_wins(void **state)
+{
+    struct cache_req_test_ctx *test_ctx = NULL;
+    struct sss_domain_info *domain_c = NULL;
+
+    test_ctx = talloc_get_type_abort(*state, struct cache_req_test_ctx);
+    test_ctx->rctx->domain_lookup_concurrency = 4;
+
+    /* The user is cached in the third domain, but the data provider of
+     * the first domain knows it as well. */
+    domain_c = find_domain_by_name(test_ctx->tctx->dom,
+                                   "responder_cache_req_test_c", true);
+    assert_non_null(domain_c);
+
+    prepare_user(domain_c, &users[0], 1000, time(NULL));
+    test_ctx->create_user1 = true;
+
+    /* Mock values. */
+    will_return_always(__wrap_sss_dp_get_account_send, test_ctx);
+    will_return_always(sss_dp_req_recv, 0);
+    mock_parse_inp(users[0].short_name, NULL, ERR_OK);
+
+    /* Test. */
+    run_user_by_name(test_ctx, NULL, 0, ERR_OK);
+
+    /* The first domain wins as in a sequential search, the two domains
+     * before the cache hit were looked up and the rest was not */
+    check_user(test_ctx, &users[0], test_ctx->tctx->dom);
+    assert_int_equal(test_ctx->dp_calls, 2);
+}
+
+void test_user_by_name_multiple_domains_concurrent_notfound(void **state)
+{
+    struct cache_req_test_ctx *test_ctx = NULL;
+
+    test_ctx = talloc_get_type_abort(*state, struct cache_req_test_ctx);
+    test_ctx->rctx->domain_lookup_concurrency = 2;
+
+    /* Mock values. */
+    will_return_always(__wrap_sss_dp_get_account_send, test_ctx);
+    will_return_always(sss_dp_req_recv, 0);
+    mock_parse_inp(users[0].short_name, NULL, ERR_OK);
+
+    /* Test. */
+    run_user_by_name(test_ctx, NULL, 0, ENOENT);
+
+    /* Every domain missed the cache and was looked up once */
+    assert_int_equal(test_ctx->dp_calls, 4);
+}
+
 void test_user_by_name_multiple_domains_parse(void **state)
 {
     struct cache_req_test_ctx *test_ctx = NULL;
@@ -684,6 +804,8 @@ void test_user_by_name_cache_expired(void **state)
     /* Test. */
     run_user_by_name(test_ctx, test_ctx->tctx->dom, 0, ERR_OK);
     assert_true(test_ctx->dp_called);
+    /* The cached user is returned if the request is refused */
+    assert_int_equal(test_ctx->dp_flags, DP_FAST_REPLY | DP_CACHED);
     check_user(test_ctx, &users[0], test_ctx->tctx->dom);
 }
 
@@ -745,6 +867,8 @@ void test_user_by_name_missing_found(void **state)
     /* Test. */
     run_user_by_name(test_ctx, test_ctx->tctx->dom, 0, ERR_OK);
     assert_true(test_ctx->dp_called);
+    /* There is nothing to return, the request must not be refused */
+    assert_int_equal(test_ctx->dp_flags, DP_FAST_REPLY);
     check_user(test_ctx, &users[0], test_ctx->tctx->dom);
 }
 
@@ -2151,6 +2275,10 @@ int main(int argc, const char *argv[])
         new_single_domain_test(user_by_name_missing_notfound),
         new_multi_domain_test(user_by_name_multiple_domains_found),
         new_multi_domain_test(user_by_name_multiple_domains_notfound),
+        new_multi_domain_test(user_by_name_multiple_domains_concurrent),
+        new_multi_domain_test(user_by_name_multiple_domains_concurrent_cached),
+        new_multi_domain_test(user_by_name_multiple_domains_concurrent_dp_wins),
+        new_multi_domain_test(user_by_name_multiple_domains_concurrent_notfound),
         new_multi_domain_test(user_by_name_multiple_domains_parse),
 
         new_single_domain_test(user_by_upn_cache_valid),
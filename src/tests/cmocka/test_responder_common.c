@@ -27,6 +27,7 @@
 
 #include "tests/cmocka/common_mock.h"
 #include "tests/cmocka/common_mock_resp.h"
+#include "responder/common/responder_packet.h"
 
 #define TESTS_PATH "tp_" BASE_FILE_STEM
 #define TEST_CONF_DB "test_responder_conf.ldb"
@@ -316,6 +317,56 @@ void test_schedule_get_domains_task(void **state)
     talloc_free(dummy_ncache_ptr);
 }
 
+void test_sss_packet_reserve(void **state)
+{
+    TALLOC_CTX *mem_ctx;
+    struct sss_packet *packet;
+    uint8_t *reserved;
+    uint8_t *body;
+    size_t blen;
+    errno_t ret;
+    int i;
+
+    mem_ctx = talloc_new(NULL);
+    assert_non_null(mem_ctx);
+
+    ret = sss_packet_new(mem_ctx, 0, SSS_NSS_GETGRNAM, &packet);
+    assert_int_equal(ret, EOK);
+
+    ret = sss_packet_reserve(packet, 0);
+    assert_int_equal(ret, EOK);
+
+    /* reserving space does not change the packet length */
+    ret = sss_packet_reserve(packet, 4000);
+    assert_int_equal(ret, EOK);
+    sss_packet_get_body(packet, &reserved, &blen);
+    assert_int_equal(blen, 0);
+
+    /* growing within the reserved space does not move the buffer */
+    for (i = 0; i < 40; i++) {
+        ret = sss_packet_grow(packet, 100);
+        assert_int_equal(ret, EOK);
+
+        sss_packet_get_body(packet, &body, &blen);
+        assert_ptr_equal(body, reserved);
+        assert_int_equal(blen, (i + 1) * 100);
+    }
+
+    /* the reserved space is counted from the current length */
+    ret = sss_packet_reserve(packet, 4000);
+    assert_int_equal(ret, EOK);
+    sss_packet_get_body(packet, &reserved, &blen);
+    assert_int_equal(blen, 4000);
+
+    ret = sss_packet_grow(packet, 4000);
+    assert_int_equal(ret, EOK);
+    sss_packet_get_body(packet, &body, &blen);
+    assert_ptr_equal(body, reserved);
+    assert_int_equal(blen, 8000);
+
+    talloc_free(mem_ctx);
+}
+
 int main(int argc, const char *argv[])
 {
     int rv;
@@ -346,6 +397,7 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_schedule_get_domains_task,
                                         parse_inp_test_setup,
                                         parse_inp_test_teardown),
+        cmocka_unit_test(test_sss_packet_reserve),
     };
 
     /* Set debug level to invalid value so we can deside if -d 0 was used. */
@@ -0,0 +1,497 @@
+/*
+    SSSD
+
+    test_sdap_ad_resolve_sids - Tests for the batched lookup of group SIDs
+
+    Copyright (C) 2017 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <tevent.h>
+#include <popt.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "providers/ldap/ldap_opts.h"
+
+/* Tests the static functions of the tokenGroups initgroups code */
+#include "providers/ldap/sdap_async_initgroups_ad.c"
+
+#define TEST_DOM1_NAME "domain.test.com"
+#define TEST_DOM1_SID "S-1-5-21-1111111111-2222222222-3333333333"
+#define TEST_DOM2_NAME "subdom.domain.test.com"
+#define TEST_DOM2_SID "S-1-5-21-4444444444-5555555555-6666666666"
+#define TEST_UNKNOWN_SID "S-1-5-21-7777777777-8888888888-9999999999-1000"
+
+#define TEST_MAX_BATCHES 16
+
+/* A search started by sdap_ad_resolve_sids_send(), it is finished by the
+ * test with test_batch_finish() */
+struct test_batch {
+    struct sdap_domain *sdom;
+    const char **sids;
+    size_t num_sids;
+
+    struct tevent_req *req;
+    bool cancelled;
+};
+
+struct test_resolve_sids_ctx {
+    struct tevent_context *ev;
+    struct sdap_options *opts;
+    struct sdap_id_ctx *id_ctx;
+    struct sdap_id_conn_ctx *conn;
+    struct sss_domain_info *dom1;
+    struct sss_domain_info *dom2;
+    struct sdap_domain *sdom1;
+    struct sdap_domain *sdom2;
+
+    struct test_batch batches[TEST_MAX_BATCHES];
+    size_t num_batches;
+
+    bool done;
+    errno_t error;
+};
+
+static struct test_resolve_sids_ctx *test_ctx_global;
+
+struct test_groups_get_sids_state {
+    struct test_batch *batch;
+    int dp_error;
+    int sdap_ret;
+};
+
+static int test_groups_get_sids_destructor(struct test_groups_get_sids_state *state)
+{
+    if (state->batch->req != NULL) {
+        /* freed before the test finished it */
+        state->batch->cancelled = true;
+        state->batch->req = NULL;
+    }
+
+    return 0;
+}
+
+struct tevent_req *__wrap_groups_get_sids_send(TALLOC_CTX *memctx,
+                                               struct tevent_context *ev,
+                                               struct sdap_id_ctx *ctx,
+                                               struct sdap_domain *sdom,
+                                               struct sdap_id_conn_ctx *conn,
+                                               const char **sids,
+                                               size_t num_sids)
+{
+    struct test_groups_get_sids_state *state;
+    struct test_batch *batch;
+    struct tevent_req *req;
+
+    assert_true(test_ctx_global->num_batches < TEST_MAX_BATCHES);
+    assert_ptr_equal(ctx, test_ctx_global->id_ctx);
+    assert_ptr_equal(conn, test_ctx_global->conn);
+
+    req = tevent_req_create(memctx, &state,
+                            struct test_groups_get_sids_state);
+    assert_non_null(req);
+
+    batch = &test_ctx_global->batches[test_ctx_global->num_batches];
+    test_ctx_global->num_batches++;
+
+    batch->sdom = sdom;
+    batch->sids = sids;
+    batch->num_sids = num_sids;
+    batch->req = req;
+
+    state->batch = batch;
+    talloc_set_destructor(state, test_groups_get_sids_destructor);
+
+    return req;
+}
+
+int __wrap_groups_get_recv(struct tevent_req *req,
+                           int *dp_error_out,
+                           int *sdap_ret)
+{
+    struct test_groups_get_sids_state *state;
+
+    state = tevent_req_data(req, struct test_groups_get_sids_state);
+
+    if (dp_error_out != NULL) {
+        *dp_error_out = state->dp_error;
+    }
+
+    if (sdap_ret != NULL) {
+        *sdap_ret = state->sdap_ret;
+    }
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    return EOK;
+}
+
+static void test_batch_finish(struct test_resolve_sids_ctx *test_ctx,
+                              size_t idx, errno_t ret,
+                              int dp_error, int sdap_ret)
+{
+    struct test_groups_get_sids_state *state;
+    struct tevent_req *req;
+
+    assert_true(idx < test_ctx->num_batches);
+    req = test_ctx->batches[idx].req;
+    assert_non_null(req);
+    test_ctx->batches[idx].req = NULL;
+
+    state = tevent_req_data(req, struct test_groups_get_sids_state);
+    state->dp_error = dp_error;
+    state->sdap_ret = sdap_ret;
+
+    /* The callback runs right away and may start further batches */
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+}
+
+static void test_batch_found(struct test_resolve_sids_ctx *test_ctx,
+                             size_t idx)
+{
+    test_batch_finish(test_ctx, idx, EOK, DP_ERR_OK, EOK);
+}
+
+static void check_batch(struct test_resolve_sids_ctx *test_ctx, size_t idx,
+                        struct sdap_domain *sdom, size_t num_sids)
+{
+    struct test_batch *batch;
+
+    assert_true(idx < test_ctx->num_batches);
+    batch = &test_ctx->batches[idx];
+
+    assert_ptr_equal(batch->sdom, sdom);
+    assert_int_equal(batch->num_sids, num_sids);
+}
+
+static struct sss_domain_info *test_domain(TALLOC_CTX *mem_ctx,
+                                           const char *name,
+                                           const char *sid)
+{
+    struct sss_domain_info *dom;
+
+    dom = talloc_zero(mem_ctx, struct sss_domain_info);
+    assert_non_null(dom);
+
+    dom->name = talloc_strdup(dom, name);
+    assert_non_null(dom->name);
+    dom->provider = talloc_strdup(dom, "ad");
+    assert_non_null(dom->provider);
+    dom->domain_id = talloc_strdup(dom, sid);
+    assert_non_null(dom->domain_id);
+
+    return dom;
+}
+
+static int test_resolve_sids_setup(void **state)
+{
+    struct test_resolve_sids_ctx *test_ctx;
+    errno_t ret;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context,
+                           struct test_resolve_sids_ctx);
+    assert_non_null(test_ctx);
+
+    test_ctx->ev = tevent_context_init(test_ctx);
+    assert_non_null(test_ctx->ev);
+
+    test_ctx->opts = talloc_zero(test_ctx, struct sdap_options);
+    assert_non_null(test_ctx->opts);
+    ret = dp_copy_defaults(test_ctx->opts, default_basic_opts,
+                           SDAP_OPTS_BASIC, &test_ctx->opts->basic);
+    assert_int_equal(ret, EOK);
+
+    test_ctx->id_ctx = talloc_zero(test_ctx, struct sdap_id_ctx);
+    assert_non_null(test_ctx->id_ctx);
+    test_ctx->id_ctx->opts = test_ctx->opts;
+
+    test_ctx->conn = talloc_zero(test_ctx->id_ctx, struct sdap_id_conn_ctx);
+    assert_non_null(test_ctx->conn);
+    test_ctx->conn->id_ctx = test_ctx->id_ctx;
+
+    /* A forest root with one child domain */
+    test_ctx->dom1 = test_domain(test_ctx, TEST_DOM1_NAME, TEST_DOM1_SID);
+    test_ctx->dom2 = test_domain(test_ctx, TEST_DOM2_NAME, TEST_DOM2_SID);
+    test_ctx->dom1->subdomains = test_ctx->dom2;
+    test_ctx->dom2->parent = test_ctx->dom1;
+
+    ret = sdap_domain_add(test_ctx->opts, test_ctx->dom1, &test_ctx->sdom1);
+    assert_int_equal(ret, EOK);
+    ret = sdap_domain_add(test_ctx->opts, test_ctx->dom2, &test_ctx->sdom2);
+    assert_int_equal(ret, EOK);
+
+    check_leaks_push(test_ctx);
+
+    test_ctx_global = test_ctx;
+    *state = test_ctx;
+    return 0;
+}
+
+static int test_resolve_sids_teardown(void **state)
+{
+    struct test_resolve_sids_ctx *test_ctx;
+
+    test_ctx = talloc_get_type_abort(*state, struct test_resolve_sids_ctx);
+
+    assert_true(check_leaks_pop(test_ctx));
+
+    talloc_free(test_ctx);
+    test_ctx_global = NULL;
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+/* Returns num1 SIDs of the first domain followed by num2 SIDs of the
+ * second domain and one SID of an unknown domain */
+static char **test_sids(TALLOC_CTX *mem_ctx, size_t num1, size_t num2)
+{
+    char **sids;
+    size_t i;
+
+    sids = talloc_zero_array(mem_ctx, char *, num1 + num2 + 2);
+    assert_non_null(sids);
+
+    for (i = 0; i < num1 + num2; i++) {
+        sids[i] = talloc_asprintf(sids, "%s-%zu",
+                                  i < num1 ? TEST_DOM1_SID : TEST_DOM2_SID,
+                                  1000 + i);
+        assert_non_null(sids[i]);
+    }
+
+    sids[i] = talloc_strdup(sids, TEST_UNKNOWN_SID);
+    assert_non_null(sids[i]);
+
+    return sids;
+}
+
+static void test_resolve_sids_done(struct tevent_req *req)
+{
+    struct test_resolve_sids_ctx *test_ctx;
+
+    test_ctx = tevent_req_callback_data(req, struct test_resolve_sids_ctx);
+
+    test_ctx->error = sdap_ad_resolve_sids_recv(req);
+    talloc_zfree(req);
+
+    test_ctx->done = true;
+}
+
+static void test_resolve_sids_send(struct test_resolve_sids_ctx *test_ctx,
+                                   char **sids)
+{
+    struct tevent_req *req;
+
+    req = sdap_ad_resolve_sids_send(test_ctx, test_ctx->ev, test_ctx->id_ctx,
+                                    test_ctx->conn, test_ctx->opts,
+                                    test_ctx->dom2, sids);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_resolve_sids_done, test_ctx);
+}
+
+/* Test that the SIDs are split into batches per domain, that no more than
+ * SDAP_AD_RESOLVE_SIDS_PARALLEL batches run at the same time and that
+ * missing groups do not stop the lookup */
+static void test_resolve_sids_batches(void **state)
+{
+    struct test_resolve_sids_ctx *test_ctx;
+    char **sids;
+    size_t found;
+    size_t i;
+    size_t j;
+
+    test_ctx = talloc_get_type_abort(*state, struct test_resolve_sids_ctx);
+
+    sids = test_sids(test_ctx, 4 * SDAP_AD_RESOLVE_SIDS_BATCH_SIZE + 20, 10);
+    test_resolve_sids_send(test_ctx, sids);
+
+    assert_int_equal(test_ctx->num_batches, SDAP_AD_RESOLVE_SIDS_PARALLEL);
+    for (i = 0; i < SDAP_AD_RESOLVE_SIDS_PARALLEL; i++) {
+        check_batch(test_ctx, i, test_ctx->sdom1,
+                    SDAP_AD_RESOLVE_SIDS_BATCH_SIZE);
+    }
+
+    /* Each finished batch starts the next one */
+    test_batch_found(test_ctx, 0);
+    assert_int_equal(test_ctx->num_batches, 5);
+    check_batch(test_ctx, 4, test_ctx->sdom1, 20);
+
+    /* None of the groups of this batch exist */
+    test_batch_finish(test_ctx, 2, EOK, DP_ERR_OK, ENOENT);
+    assert_int_equal(test_ctx->num_batches, 6);
+    check_batch(test_ctx, 5, test_ctx->sdom2, 10);
+
+    test_batch_found(test_ctx, 5);
+    test_batch_found(test_ctx, 1);
+    test_batch_found(test_ctx, 4);
+    assert_false(test_ctx->done);
+
+    /* Every SID of a known domain is looked up exactly once, in order */
+    found = 0;
+    for (i = 0; i < test_ctx->num_batches; i++) {
+        for (j = 0; j < test_ctx->batches[i].num_sids; j++) {
+            assert_string_equal(test_ctx->batches[i].sids[j],
+                                sids[found]);
+            found++;
+        }
+    }
+    assert_int_equal(found, 4 * SDAP_AD_RESOLVE_SIDS_BATCH_SIZE + 30);
+
+    test_batch_found(test_ctx, 3);
+    assert_int_equal(test_ctx->num_batches, 6);
+
+    assert_true(test_ctx->done);
+    assert_int_equal(test_ctx->error, EOK);
+
+    talloc_free(sids);
+}
+
+/* Test that a batch does not exceed ldap_search_wildcard_limit */
+static void test_resolve_sids_wildcard_limit(void **state)
+{
+    struct test_resolve_sids_ctx *test_ctx;
+    char **sids;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct test_resolve_sids_ctx);
+
+    ret = dp_opt_set_int(test_ctx->opts->basic, SDAP_WILDCARD_LIMIT, 7);
+    assert_int_equal(ret, EOK);
+
+    sids = test_sids(test_ctx, 20, 3);
+    test_resolve_sids_send(test_ctx, sids);
+
+    assert_int_equal(test_ctx->num_batches, 4);
+    check_batch(test_ctx, 0, test_ctx->sdom1, 7);
+    check_batch(test_ctx, 1, test_ctx->sdom1, 7);
+    check_batch(test_ctx, 2, test_ctx->sdom1, 6);
+    check_batch(test_ctx, 3, test_ctx->sdom2, 3);
+
+    test_batch_found(test_ctx, 0);
+    test_batch_found(test_ctx, 1);
+    test_batch_found(test_ctx, 2);
+    test_batch_found(test_ctx, 3);
+
+    assert_true(test_ctx->done);
+    assert_int_equal(test_ctx->error, EOK);
+
+    talloc_free(sids);
+}
+
+/* Test that a failed batch fails the whole lookup, that no further batch
+ * is started and that the batches still running are stopped */
+static void test_resolve_sids_batch_fails(void **state)
+{
+    struct test_resolve_sids_ctx *test_ctx;
+    char **sids;
+    size_t i;
+
+    test_ctx = talloc_get_type_abort(*state, struct test_resolve_sids_ctx);
+
+    sids = test_sids(test_ctx, 5 * SDAP_AD_RESOLVE_SIDS_BATCH_SIZE, 0);
+    test_resolve_sids_send(test_ctx, sids);
+    assert_int_equal(test_ctx->num_batches, SDAP_AD_RESOLVE_SIDS_PARALLEL);
+
+    test_batch_found(test_ctx, 0);
+    assert_int_equal(test_ctx->num_batches, 5);
+
+    /* The server was reachable but the search failed */
+    test_batch_finish(test_ctx, 2, EOK, DP_ERR_OK, EIO);
+
+    assert_true(test_ctx->done);
+    assert_int_equal(test_ctx->error, EIO);
+    assert_int_equal(test_ctx->num_batches, 5);
+
+    for (i = 0; i < test_ctx->num_batches; i++) {
+        assert_null(test_ctx->batches[i].req);
+        assert_int_equal(test_ctx->batches[i].cancelled,
+                         i == 1 || i == 3 || i == 4);
+    }
+
+    talloc_free(sids);
+}
+
+/* Test that the error of a batch that could not be searched at all is
+ * returned */
+static void test_resolve_sids_batch_offline(void **state)
+{
+    struct test_resolve_sids_ctx *test_ctx;
+    char **sids;
+
+    test_ctx = talloc_get_type_abort(*state, struct test_resolve_sids_ctx);
+
+    sids = test_sids(test_ctx, 2 * SDAP_AD_RESOLVE_SIDS_BATCH_SIZE, 0);
+    test_resolve_sids_send(test_ctx, sids);
+    assert_int_equal(test_ctx->num_batches, 2);
+
+    test_batch_finish(test_ctx, 1, ETIMEDOUT, DP_ERR_OFFLINE, EOK);
+
+    assert_true(test_ctx->done);
+    assert_int_equal(test_ctx->error, ETIMEDOUT);
+    assert_true(test_ctx->batches[0].cancelled);
+
+    talloc_free(sids);
+}
+
+int main(int argc, const char *argv[])
+{
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_resolve_sids_batches,
+                                        test_resolve_sids_setup,
+                                        test_resolve_sids_teardown),
+        cmocka_unit_test_setup_teardown(test_resolve_sids_wildcard_limit,
+                                        test_resolve_sids_setup,
+                                        test_resolve_sids_teardown),
+        cmocka_unit_test_setup_teardown(test_resolve_sids_batch_fails,
+                                        test_resolve_sids_setup,
+                                        test_resolve_sids_teardown),
+        cmocka_unit_test_setup_teardown(test_resolve_sids_batch_offline,
+                                        test_resolve_sids_setup,
+                                        test_resolve_sids_teardown),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,552 @@
+/*
+    SSSD
+
+    test_sdap_id_op - Tests for the LDAP identity connection pool
+
+    Copyright (C) 2017 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <tevent.h>
+#include <popt.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "providers/ldap/ldap_opts.h"
+
+/* Tests the static functions of the connection cache */
+#include "providers/ldap/sdap_id_op.c"
+
+#define TEST_OPS 8
+
+struct test_id_op_ctx {
+    struct tevent_context *ev;
+    struct be_ctx *be;
+    struct sdap_id_conn_ctx *id_conn;
+    struct sdap_id_conn_cache *conn_cache;
+
+    /* result of the next connection attempts */
+    errno_t connect_result;
+    bool can_retry;
+    /* sh->expire_time of new connections */
+    time_t expire_time;
+
+    int connects;
+
+    struct sdap_id_op *ops[TEST_OPS];
+};
+
+static struct test_id_op_ctx *test_ctx_global;
+
+struct test_cli_connect_state {
+    struct sdap_handle *sh;
+    bool can_retry;
+};
+
+struct tevent_req *
+__wrap_sdap_cli_connect_send(TALLOC_CTX *memctx,
+                             struct tevent_context *ev,
+                             struct sdap_options *opts,
+                             struct be_ctx *be,
+                             struct sdap_service *service,
+                             bool skip_rootdse,
+                             enum connect_tls force_tls,
+                             bool skip_auth)
+{
+    struct test_cli_connect_state *state;
+    struct tevent_req *req;
+
+    req = tevent_req_create(memctx, &state, struct test_cli_connect_state);
+    assert_non_null(req);
+
+    test_ctx_global->connects++;
+    state->can_retry = test_ctx_global->can_retry;
+
+    if (test_ctx_global->connect_result != EOK) {
+        tevent_req_error(req, test_ctx_global->connect_result);
+        return tevent_req_post(req, ev);
+    }
+
+    /* No destructor, the handle can be freed without a real connection */
+    state->sh = talloc_zero(state, struct sdap_handle);
+    assert_non_null(state->sh);
+    state->sh->connected = true;
+    state->sh->expire_time = test_ctx_global->expire_time;
+
+    tevent_req_done(req);
+    return tevent_req_post(req, ev);
+}
+
+int __wrap_sdap_cli_connect_recv(struct tevent_req *req,
+                                 TALLOC_CTX *memctx,
+                                 bool *can_retry,
+                                 struct sdap_handle **gsh,
+                                 struct sdap_server_opts **srv_opts)
+{
+    struct test_cli_connect_state *state;
+
+    state = tevent_req_data(req, struct test_cli_connect_state);
+
+    if (can_retry != NULL) {
+        *can_retry = state->can_retry;
+    }
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    *gsh = talloc_steal(memctx, state->sh);
+    if (srv_opts != NULL) {
+        *srv_opts = NULL;
+    }
+
+    return EOK;
+}
+
+static int test_id_op_setup(void **state)
+{
+    struct test_id_op_ctx *test_ctx;
+    struct sdap_id_ctx *id_ctx;
+    struct sdap_options *opts;
+    errno_t ret;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context, struct test_id_op_ctx);
+    assert_non_null(test_ctx);
+
+    test_ctx->ev = tevent_context_init(test_ctx);
+    assert_non_null(test_ctx->ev);
+
+    test_ctx->be = talloc_zero(test_ctx, struct be_ctx);
+    assert_non_null(test_ctx->be);
+    test_ctx->be->ev = test_ctx->ev;
+
+    opts = talloc_zero(test_ctx, struct sdap_options);
+    assert_non_null(opts);
+    ret = dp_copy_defaults(opts, default_basic_opts, SDAP_OPTS_BASIC,
+                           &opts->basic);
+    assert_int_equal(ret, EOK);
+
+    id_ctx = talloc_zero(test_ctx, struct sdap_id_ctx);
+    assert_non_null(id_ctx);
+    id_ctx->be = test_ctx->be;
+    id_ctx->opts = opts;
+
+    test_ctx->id_conn = talloc_zero(id_ctx, struct sdap_id_conn_ctx);
+    assert_non_null(test_ctx->id_conn);
+    test_ctx->id_conn->id_ctx = id_ctx;
+    test_ctx->id_conn->service = talloc_zero(test_ctx->id_conn,
+                                             struct sdap_service);
+    assert_non_null(test_ctx->id_conn->service);
+    test_ctx->id_conn->service->name = discard_const("LDAP");
+
+    check_leaks_push(test_ctx);
+    ret = sdap_id_conn_cache_create(test_ctx->id_conn, test_ctx->id_conn,
+                                    &test_ctx->conn_cache);
+    assert_int_equal(ret, EOK);
+    test_ctx->id_conn->conn_cache = test_ctx->conn_cache;
+
+    test_ctx->connect_result = EOK;
+    test_ctx->can_retry = true;
+
+    test_ctx_global = test_ctx;
+    *state = test_ctx;
+    return 0;
+}
+
+static int test_id_op_teardown(void **state)
+{
+    struct test_id_op_ctx *test_ctx;
+    int i;
+
+    test_ctx = talloc_get_type_abort(*state, struct test_id_op_ctx);
+
+    for (i = 0; i < TEST_OPS; i++) {
+        talloc_zfree(test_ctx->ops[i]);
+    }
+    talloc_zfree(test_ctx->conn_cache);
+    assert_true(check_leaks_pop(test_ctx));
+
+    talloc_free(test_ctx);
+    test_ctx_global = NULL;
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+static void test_id_op_set_int(struct test_id_op_ctx *test_ctx,
+                               int opt, int value)
+{
+    errno_t ret;
+
+    ret = dp_opt_set_int(test_ctx->id_conn->id_ctx->opts->basic, opt, value);
+    assert_int_equal(ret, EOK);
+}
+
+static void test_id_op_connect_done(struct tevent_req *req)
+{
+    int *_dp_error = tevent_req_callback_data_void(req);
+    int dp_error;
+    errno_t ret;
+
+    ret = sdap_id_op_connect_recv(req, &dp_error);
+    talloc_free(req);
+
+    *_dp_error = ret == EOK ? dp_error : -1;
+}
+
+/* Connect operation @i and wait until it is connected */
+static struct sdap_id_conn_data *test_id_op_connect(struct test_id_op_ctx *test_ctx,
+                                                    int i,
+                                                    int expected_dp_error)
+{
+    struct tevent_req *req;
+    int dp_error = -2;
+    errno_t ret;
+
+    test_ctx->ops[i] = sdap_id_op_create(test_ctx, test_ctx->conn_cache);
+    assert_non_null(test_ctx->ops[i]);
+
+    req = sdap_id_op_connect_send(test_ctx->ops[i], test_ctx, &ret);
+    assert_int_equal(ret, EOK);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_id_op_connect_done, &dp_error);
+
+    while (dp_error == -2) {
+        ret = tevent_loop_once(test_ctx->ev);
+        assert_int_equal(ret, 0);
+    }
+
+    assert_int_equal(dp_error, expected_dp_error);
+    return test_ctx->ops[i]->conn_data;
+}
+
+static void test_id_op_release(struct test_id_op_ctx *test_ctx,
+                               int i, errno_t result)
+{
+    int dp_error;
+
+    sdap_id_op_done(test_ctx->ops[i], result, &dp_error);
+    talloc_zfree(test_ctx->ops[i]);
+}
+
+/* Run the event loop until no connection is being established */
+static void test_id_op_settle(struct test_id_op_ctx *test_ctx)
+{
+    struct sdap_id_conn_data *conn_data;
+    bool connecting;
+    int ret;
+
+    do {
+        connecting = false;
+        DLIST_FOR_EACH(conn_data, test_ctx->conn_cache->connections) {
+            connecting |= conn_data->connect_req != NULL;
+        }
+
+        if (connecting) {
+            ret = tevent_loop_once(test_ctx->ev);
+            assert_int_equal(ret, 0);
+        }
+    } while (connecting);
+}
+
+static int test_id_op_num_connections(struct test_id_op_ctx *test_ctx)
+{
+    struct sdap_id_conn_data *conn_data;
+    int num = 0;
+
+    DLIST_FOR_EACH(conn_data, test_ctx->conn_cache->connections) {
+        num++;
+    }
+
+    return num;
+}
+
+static void test_id_op_reuse(void **state)
+{
+    struct test_id_op_ctx *test_ctx;
+    struct sdap_id_conn_data *conn1;
+    struct sdap_id_conn_data *conn;
+    int i;
+
+    test_ctx = talloc_get_type_abort(*state, struct test_id_op_ctx);
+
+    /* The default pool of one connection is shared by all operations */
+    conn1 = test_id_op_connect(test_ctx, 0, DP_ERR_OK);
+    assert_non_null(conn1);
+    assert_true(conn1->pooled);
+    assert_int_equal(test_ctx->connects, 1);
+
+    for (i = 1; i < TEST_OPS; i++) {
+        conn = test_id_op_connect(test_ctx, i, DP_ERR_OK);
+        assert_ptr_equal(conn, conn1);
+    }
+    assert_int_equal(conn1->num_ops, TEST_OPS);
+
+    for (i = 0; i < TEST_OPS; i++) {
+        test_id_op_release(test_ctx, i, EOK);
+    }
+
+    /* The idle connection is kept for the next operation */
+    assert_int_equal(test_id_op_num_connections(test_ctx), 1);
+    conn = test_id_op_connect(test_ctx, 0, DP_ERR_OK);
+    assert_ptr_equal(conn, conn1);
+    assert_int_equal(test_ctx->connects, 1);
+    assert_int_equal(test_ctx->conn_cache->pool_count, 1);
+}
+
+static void test_id_op_growth(void **state)
+{
+    struct test_id_op_ctx *test_ctx;
+    struct sdap_id_conn_data *conn[TEST_OPS];
+    int i;
+
+    test_ctx = talloc_get_type_abort(*state, struct test_id_op_ctx);
+
+    test_id_op_set_int(test_ctx, SDAP_CONNECTION_POOL_SIZE, 3);
+
+    conn[0] = test_id_op_connect(test_ctx, 0, DP_ERR_OK);
+    test_id_op_settle(test_ctx);
+    assert_int_equal(test_ctx->connects, 1);
+
+    /* The second operation shares the connection, another one is opened
+     * in the background for the next operation */
+    conn[1] = test_id_op_connect(test_ctx, 1, DP_ERR_OK);
+    assert_ptr_equal(conn[1], conn[0]);
+    test_id_op_settle(test_ctx);
+    assert_int_equal(test_ctx->connects, 2);
+    assert_int_equal(test_ctx->conn_cache->pool_count, 2);
+
+    /* and used by it */
+    conn[2] = test_id_op_connect(test_ctx, 2, DP_ERR_OK);
+    assert_ptr_not_equal(conn[2], conn[0]);
+    assert_int_equal(conn[2]->num_ops, 1);
+    assert_int_equal(test_ctx->connects, 2);
+
+    /* Operations go to the connection with the fewest operations and the
+     * pool grows up to ldap_connection_pool_size */
+    for (i = 3; i < TEST_OPS; i++) {
+        conn[i] = test_id_op_connect(test_ctx, i, DP_ERR_OK);
+        test_id_op_settle(test_ctx);
+    }
+
+    assert_int_equal(test_ctx->connects, 3);
+    assert_int_equal(test_ctx->conn_cache->pool_count, 3);
+    assert_int_equal(test_id_op_num_connections(test_ctx), 3);
+
+    for (i = 0; i < TEST_OPS; i++) {
+        assert_true(conn[i]->num_ops <= 3);
+    }
+
+    /* Finished operations do not close pooled connections */
+    for (i = 0; i < TEST_OPS; i++) {
+        test_id_op_release(test_ctx, i, EOK);
+    }
+    assert_int_equal(test_id_op_num_connections(test_ctx), 3);
+    assert_int_equal(test_ctx->conn_cache->pool_count, 3);
+}
+
+static void test_id_op_standby(void **state)
+{
+    struct test_id_op_ctx *test_ctx;
+    struct sdap_id_conn_data *conn1;
+    struct sdap_id_conn_data *conn2;
+    struct timeval tv = { 0, 0 };
+
+    test_ctx = talloc_get_type_abort(*state, struct test_id_op_ctx);
+
+    test_id_op_set_int(test_ctx, SDAP_CONNECTION_POOL_SIZE, 2);
+    test_id_op_set_int(test_ctx, SDAP_CONNECTION_POOL_STANDBY, 1);
+
+    /* An idle connection is opened in advance */
+    conn1 = test_id_op_connect(test_ctx, 0, DP_ERR_OK);
+    test_id_op_settle(test_ctx);
+    assert_int_equal(test_ctx->connects, 2);
+
+    conn2 = test_id_op_connect(test_ctx, 1, DP_ERR_OK);
+    assert_ptr_not_equal(conn2, conn1);
+    assert_int_equal(test_ctx->connects, 2);
+    test_id_op_release(test_ctx, 0, EOK);
+
+    /* An expiring idle connection is replaced by a standby connection, one
+     * that fails is dropped without going offline */
+    test_ctx->connect_result = ETIMEDOUT;
+    test_ctx->can_retry = false;
+    sdap_id_conn_data_expire_handler(test_ctx->ev, NULL, tv, conn1);
+    assert_int_equal(test_ctx->connects, 3);
+    test_id_op_settle(test_ctx);
+
+    assert_false(be_is_offline(test_ctx->be));
+    assert_int_equal(test_id_op_num_connections(test_ctx), 1);
+    assert_ptr_equal(test_ctx->conn_cache->connections, conn2);
+    assert_int_equal(test_ctx->conn_cache->pool_count, 1);
+
+    test_id_op_release(test_ctx, 1, EOK);
+}
+
+static void test_id_op_offline(void **state)
+{
+    struct test_id_op_ctx *test_ctx;
+    struct sdap_id_conn_data *busy;
+    struct sdap_id_conn_data *conn;
+
+    test_ctx = talloc_get_type_abort(*state, struct test_id_op_ctx);
+
+    test_id_op_set_int(test_ctx, SDAP_CONNECTION_POOL_SIZE, 2);
+
+    busy = test_id_op_connect(test_ctx, 0, DP_ERR_OK);
+    test_id_op_connect(test_ctx, 1, DP_ERR_OK);
+    test_id_op_settle(test_ctx);
+    test_id_op_release(test_ctx, 1, EOK);
+    assert_int_equal(test_id_op_num_connections(test_ctx), 2);
+    assert_int_equal(test_ctx->conn_cache->pool_count, 2);
+
+    /* Going offline releases all pooled connections, a connection that
+     * is still in use is closed when its operation finishes */
+    test_ctx->be->offstat.offline = true;
+    be_run_offline_cb(test_ctx->be);
+
+    assert_int_equal(test_ctx->conn_cache->pool_count, 0);
+    assert_int_equal(test_id_op_num_connections(test_ctx), 1);
+    assert_ptr_equal(test_ctx->ops[0]->conn_data, busy);
+    assert_false(busy->pooled);
+
+    test_id_op_release(test_ctx, 0, EOK);
+    assert_int_equal(test_id_op_num_connections(test_ctx), 0);
+
+    /* Back online, a new connection is opened */
+    test_ctx->be->offstat.offline = false;
+    conn = test_id_op_connect(test_ctx, 0, DP_ERR_OK);
+    assert_non_null(conn);
+    assert_int_equal(test_ctx->connects, 3);
+    assert_int_equal(test_ctx->conn_cache->pool_count, 1);
+}
+
+static void test_id_op_expired(void **state)
+{
+    struct test_id_op_ctx *test_ctx;
+    struct sdap_id_conn_data *conn1;
+    struct sdap_id_conn_data *conn2;
+    int timeout;
+
+    test_ctx = talloc_get_type_abort(*state, struct test_id_op_ctx);
+
+    test_id_op_set_int(test_ctx, SDAP_CONNECTION_POOL_SIZE, 2);
+
+    conn1 = test_id_op_connect(test_ctx, 0, DP_ERR_OK);
+    test_id_op_release(test_ctx, 0, EOK);
+    assert_int_equal(test_ctx->connects, 1);
+
+    /* A connection that expires within ldap_opt_timeout is not reused */
+    timeout = dp_opt_get_int(test_ctx->id_conn->id_ctx->opts->basic,
+                             SDAP_OPT_TIMEOUT);
+    conn1->sh->expire_time = time(NULL) + timeout - 1;
+
+    conn2 = test_id_op_connect(test_ctx, 0, DP_ERR_OK);
+    assert_int_equal(test_ctx->connects, 2);
+    assert_int_equal(test_id_op_num_connections(test_ctx), 1);
+    assert_ptr_equal(test_ctx->conn_cache->connections, conn2);
+    assert_int_equal(test_ctx->conn_cache->pool_count, 1);
+    test_id_op_release(test_ctx, 0, EOK);
+
+    /* Neither is a connection the server closed */
+    conn2->sh->connected = false;
+    test_id_op_connect(test_ctx, 0, DP_ERR_OK);
+    assert_int_equal(test_ctx->connects, 3);
+    assert_int_equal(test_id_op_num_connections(test_ctx), 1);
+    assert_int_equal(test_ctx->conn_cache->pool_count, 1);
+}
+
+static void test_id_op_communication_error(void **state)
+{
+    struct test_id_op_ctx *test_ctx;
+    struct sdap_id_conn_data *conn1;
+    struct sdap_id_conn_data *conn2;
+    struct sdap_id_conn_data *conn;
+
+    test_ctx = talloc_get_type_abort(*state, struct test_id_op_ctx);
+
+    test_id_op_set_int(test_ctx, SDAP_CONNECTION_POOL_SIZE, 2);
+
+    conn1 = test_id_op_connect(test_ctx, 0, DP_ERR_OK);
+    test_id_op_connect(test_ctx, 1, DP_ERR_OK);
+    test_id_op_settle(test_ctx);
+    conn2 = test_id_op_connect(test_ctx, 2, DP_ERR_OK);
+    assert_ptr_not_equal(conn1, conn2);
+    assert_int_equal(test_ctx->connects, 2);
+
+    /* A communication error stops reuse of all connections to the server */
+    test_id_op_release(test_ctx, 0, EIO);
+    assert_int_equal(test_ctx->conn_cache->pool_count, 1);
+    assert_true(conn2->disconnecting);
+
+    test_id_op_release(test_ctx, 1, EOK);
+    test_id_op_release(test_ctx, 2, EOK);
+
+    conn = test_id_op_connect(test_ctx, 0, DP_ERR_OK);
+    assert_int_equal(test_ctx->connects, 3);
+    assert_ptr_equal(test_ctx->conn_cache->connections, conn);
+    assert_int_equal(test_id_op_num_connections(test_ctx), 1);
+    assert_int_equal(test_ctx->conn_cache->pool_count, 1);
+}
+
+int main(int argc, const char *argv[])
+{
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_id_op_reuse,
+                                        test_id_op_setup,
+                                        test_id_op_teardown),
+        cmocka_unit_test_setup_teardown(test_id_op_growth,
+                                        test_id_op_setup,
+                                        test_id_op_teardown),
+        cmocka_unit_test_setup_teardown(test_id_op_standby,
+                                        test_id_op_setup,
+                                        test_id_op_teardown),
+        cmocka_unit_test_setup_teardown(test_id_op_offline,
+                                        test_id_op_setup,
+                                        test_id_op_teardown),
+        cmocka_unit_test_setup_teardown(test_id_op_expired,
+                                        test_id_op_setup,
+                                        test_id_op_teardown),
+        cmocka_unit_test_setup_teardown(test_id_op_communication_error,
+                                        test_id_op_setup,
+                                        test_id_op_teardown),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,340 @@
+/*
+    SSSD
+
+    test_sss_stats - Tests for the latency histograms and counters
+
+    Copyright (C) 2017 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <popt.h>
+#include <sys/wait.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "util/sss_stats.h"
+
+#define TESTS_PATH "tp_" BASE_FILE_STEM
+#define TEST_CONF_DB "test_sss_stats_conf.ldb"
+#define TEST_DOM_NAME "stats_test"
+#define TEST_PROCESS "sssd[be[stats.test]]"
+#define TEST_STATS_FILE TESTS_PATH "/" SSS_STATS_FILE_PREFIX "be_stats.test"
+#define TEST_STATS_FILE_PID(ctx, pid) \
+    talloc_asprintf(ctx, TEST_STATS_FILE ".%d", (int)(pid))
+#define TEST_BROKEN_FILE TESTS_PATH "/" SSS_STATS_FILE_PREFIX "broken"
+
+static void test_stats_buckets(void **state)
+{
+    unsigned int idx;
+    uint64_t value;
+
+    /* small values are exact */
+    for (value = 0; value < SSS_STATS_SUB_BUCKETS; value++) {
+        assert_int_equal(sss_stats_bucket(value), value);
+        assert_int_equal(sss_stats_bucket_upper(value), value);
+    }
+
+    assert_int_equal(sss_stats_bucket(16), 16);
+    assert_int_equal(sss_stats_bucket(17), 16);
+    assert_int_equal(sss_stats_bucket(18), 17);
+    assert_int_equal(sss_stats_bucket_upper(16), 17);
+
+    /* every value falls into the bucket whose range contains it */
+    for (value = 1; value < 1000000; value = value * 3 / 2 + 1) {
+        idx = sss_stats_bucket(value);
+        assert_true(idx < SSS_STATS_BUCKETS);
+        assert_true(sss_stats_bucket_upper(idx) >= value);
+        assert_true(sss_stats_bucket_upper(idx - 1) < value);
+        /* precision is 1/8 of the value */
+        assert_true(sss_stats_bucket_upper(idx) - value <= value / 8);
+    }
+
+    assert_int_equal(sss_stats_bucket(UINT64_MAX), SSS_STATS_BUCKETS - 1);
+    assert_int_equal(sss_stats_bucket(1ULL << SSS_STATS_MAX_EXP),
+                     SSS_STATS_BUCKETS - 1);
+    assert_int_equal(sss_stats_bucket((1ULL << SSS_STATS_MAX_EXP) - 1),
+                     SSS_STATS_BUCKETS - 1);
+    assert_int_equal(sss_stats_bucket(1ULL << (SSS_STATS_MAX_EXP - 1)),
+                     SSS_STATS_BUCKETS - SSS_STATS_SUB_BUCKETS);
+}
+
+static void test_stats_percentile(void **state)
+{
+    struct sss_stats_hist hist = { 0 };
+    uint64_t value;
+    uint64_t p;
+
+    assert_int_equal(sss_stats_percentile(&hist, 50), 0);
+
+    for (value = 1; value <= 100; value++) {
+        hist.buckets[sss_stats_bucket(value)]++;
+        hist.count++;
+        hist.sum += value;
+    }
+    hist.min = 1;
+    hist.max = 100;
+
+    assert_int_equal(sss_stats_percentile(&hist, 0), 1);
+    assert_int_equal(sss_stats_percentile(&hist, 100), 100);
+
+    p = sss_stats_percentile(&hist, 50);
+    assert_true(p >= 50 && p <= 50 + 50 / 8);
+
+    p = sss_stats_percentile(&hist, 99);
+    assert_true(p >= 99 && p <= 100);
+}
+
+struct test_stats_child {
+    pid_t pid;
+    int to_child;
+};
+
+/* Start a process that records @hits negative cache hits under
+ * TEST_PROCESS and then waits for a byte: 'e' exits cleanly, anything else
+ * exits without running the exit handlers */
+static void test_stats_child_start(struct test_stats_child *child,
+                                   unsigned int hits)
+{
+    int to_child[2];
+    int from_child[2];
+    unsigned int i;
+    char c;
+    int ret;
+
+    ret = pipe(to_child);
+    assert_int_equal(ret, 0);
+    ret = pipe(from_child);
+    assert_int_equal(ret, 0);
+
+    child->pid = fork();
+    assert_true(child->pid >= 0);
+
+    if (child->pid == 0) {
+        close(to_child[1]);
+        close(from_child[0]);
+
+        ret = sss_stats_init(TESTS_PATH, TEST_PROCESS);
+        for (i = 0; i < hits; i++) {
+            sss_stats_count(SSS_STATS_NCACHE_HIT);
+        }
+
+        c = ret == EOK ? 'r' : 'f';
+        sss_atomic_write_s(from_child[1], &c, 1);
+
+        if (sss_atomic_read_s(to_child[0], &c, 1) == 1 && c == 'e') {
+            exit(0);
+        }
+        _exit(0);
+    }
+
+    close(to_child[0]);
+    close(from_child[1]);
+
+    ret = sss_atomic_read_s(from_child[0], &c, 1);
+    assert_int_equal(ret, 1);
+    assert_int_equal(c, 'r');
+    close(from_child[0]);
+
+    child->to_child = to_child[1];
+}
+
+static void test_stats_child_stop(struct test_stats_child *child, char how)
+{
+    int status;
+    int ret;
+
+    ret = sss_atomic_write_s(child->to_child, &how, 1);
+    assert_int_equal(ret, 1);
+    close(child->to_child);
+
+    ret = waitpid(child->pid, &status, 0);
+    assert_int_equal(ret, child->pid);
+    assert_true(WIFEXITED(status));
+}
+
+/* Must run before sss_stats_init() is called in this process */
+static void test_stats_processes(void **state)
+{
+    struct sss_stats_process **procs;
+    struct test_stats_child child1;
+    struct test_stats_child child2;
+    TALLOC_CTX *tmp_ctx;
+    struct stat sb;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    assert_non_null(tmp_ctx);
+
+    test_stats_child_start(&child1, 1);
+    test_stats_child_start(&child2, 2);
+
+    /* Each process has its own file, they are summed up by name */
+    ret = stat(TEST_STATS_FILE_PID(tmp_ctx, child1.pid), &sb);
+    assert_int_equal(ret, 0);
+    ret = stat(TEST_STATS_FILE_PID(tmp_ctx, child2.pid), &sb);
+    assert_int_equal(ret, 0);
+
+    ret = sss_stats_read(tmp_ctx, TESTS_PATH, &procs);
+    assert_int_equal(ret, EOK);
+    assert_non_null(procs[0]);
+    assert_null(procs[1]);
+
+    assert_string_equal(procs[0]->name, "be[stats.test]");
+    assert_true(procs[0]->running);
+    assert_int_equal(procs[0]->num_processes, 2);
+    assert_int_equal(procs[0]->data.counters[SSS_STATS_NCACHE_HIT], 3);
+    talloc_zfree(procs);
+
+    /* A clean exit removes the file */
+    test_stats_child_stop(&child1, 'e');
+    ret = stat(TEST_STATS_FILE_PID(tmp_ctx, child1.pid), &sb);
+    assert_int_equal(ret, -1);
+    assert_int_equal(errno, ENOENT);
+
+    /* A crashed process is reported as not running */
+    test_stats_child_stop(&child2, 'k');
+    ret = stat(TEST_STATS_FILE_PID(tmp_ctx, child2.pid), &sb);
+    assert_int_equal(ret, 0);
+
+    ret = sss_stats_read(tmp_ctx, TESTS_PATH, &procs);
+    assert_int_equal(ret, EOK);
+    assert_non_null(procs[0]);
+    assert_null(procs[1]);
+
+    assert_false(procs[0]->running);
+    assert_int_equal(procs[0]->num_processes, 1);
+    assert_int_equal(procs[0]->pid, child2.pid);
+    assert_int_equal(procs[0]->data.counters[SSS_STATS_NCACHE_HIT], 2);
+
+    /* and its file is removed by the next process with the same name,
+     * see test_stats_shared_file() */
+    talloc_free(tmp_ctx);
+}
+
+static void test_stats_shared_file(void **state)
+{
+    struct sss_stats_process **procs;
+    struct sss_stats_hist *hist;
+    TALLOC_CTX *tmp_ctx;
+    char *prom;
+    FILE *f;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    assert_non_null(tmp_ctx);
+
+    /* A file that is not a statistics file is skipped */
+    f = fopen(TEST_BROKEN_FILE, "w");
+    assert_non_null(f);
+    fputs("garbage", f);
+    fclose(f);
+
+    /* Recorded before the file exists and kept when it is created */
+    sss_stats_record(SSS_STATS_SYSDB_TRANSACTION, sss_stats_now() - 1000,
+                     false);
+    sss_stats_count(SSS_STATS_NCACHE_HIT);
+
+    ret = sss_stats_init(TESTS_PATH, TEST_PROCESS);
+    assert_int_equal(ret, EOK);
+
+    sss_stats_record(SSS_STATS_SYSDB_TRANSACTION, sss_stats_now() - 3000,
+                     true);
+
+    ret = sss_stats_read(tmp_ctx, TESTS_PATH, &procs);
+    assert_int_equal(ret, EOK);
+    assert_non_null(procs[0]);
+    assert_null(procs[1]);
+
+    assert_string_equal(procs[0]->name, "be[stats.test]");
+    assert_int_equal(procs[0]->pid, getpid());
+    assert_int_equal(procs[0]->num_processes, 1);
+    assert_true(procs[0]->running);
+
+    hist = &procs[0]->data.hists[SSS_STATS_SYSDB_TRANSACTION];
+    assert_int_equal(hist->count, 2);
+    assert_int_equal(hist->errors, 1);
+    assert_true(hist->min >= 1000 && hist->min < 3000);
+    assert_true(hist->max >= 3000);
+    assert_int_equal(procs[0]->data.hists[SSS_STATS_CACHE_REQ].count, 0);
+    assert_int_equal(procs[0]->data.counters[SSS_STATS_NCACHE_HIT], 1);
+
+    prom = sss_stats_prometheus(tmp_ctx, procs);
+    assert_non_null(prom);
+
+    assert_non_null(strstr(prom, "sssd_sysdb_transaction_seconds_count"
+                                 "{process=\"be[stats.test]\"} 2\n"));
+    assert_non_null(strstr(prom, "# TYPE sssd_sysdb_transaction_seconds "
+                                 "histogram\n"));
+    assert_non_null(strstr(prom, "sssd_sysdb_transaction_seconds_bucket"
+                                 "{process=\"be[stats.test]\",le=\"0.000016\"}"
+                                 " 0\n"));
+    assert_non_null(strstr(prom, "sssd_sysdb_transaction_seconds_bucket"
+                                 "{process=\"be[stats.test]\",le=\"+Inf\"}"
+                                 " 2\n"));
+    assert_non_null(strstr(prom, "sssd_sysdb_transaction_errors_total"
+                                 "{process=\"be[stats.test]\"} 1\n"));
+    assert_non_null(strstr(prom, "sssd_ncache_hit_total"
+                                 "{process=\"be[stats.test]\"} 1\n"));
+
+    unlink(TEST_STATS_FILE_PID(tmp_ctx, getpid()));
+    unlink(TEST_BROKEN_FILE);
+    talloc_free(tmp_ctx);
+}
+
+int main(int argc, const char *argv[])
+{
+    poptContext pc;
+    int opt;
+    int rv;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_stats_buckets),
+        cmocka_unit_test(test_stats_percentile),
+        cmocka_unit_test(test_stats_processes),
+        cmocka_unit_test(test_stats_shared_file),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    tests_set_cwd();
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    test_dom_suite_setup(TESTS_PATH);
+
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+    if (rv == 0) {
+        test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    }
+    return rv;
+}
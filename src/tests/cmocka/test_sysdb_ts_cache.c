@@ -1411,6 +1411,84 @@ static void test_sysdb_zero_now(void **state)
     assert_true(cache_expire_ts > TEST_CACHE_TIMEOUT);
 }
 
+static void test_sysdb_entry_access(void **state)
+{
+    int ret;
+    struct sysdb_ts_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                     struct sysdb_ts_test_ctx);
+    const char *attrs[] = { SYSDB_LAST_ACCESS, SYSDB_ACCESS_COUNT, NULL };
+    struct ldb_result *res = NULL;
+    struct ldb_message **msgs = NULL;
+    struct ldb_dn *dn;
+    size_t msg_count;
+
+    ret = sysdb_store_user(test_ctx->tctx->dom, TEST_USER_NAME, NULL,
+                           TEST_USER_UID, TEST_USER_GID, TEST_USER_NAME,
+                           "/home/"TEST_USER_NAME, "/bin/bash", NULL,
+                           NULL, NULL, TEST_CACHE_TIMEOUT,
+                           TEST_NOW_1);
+    assert_int_equal(ret, EOK);
+
+    dn = sysdb_user_dn(test_ctx, test_ctx->tctx->dom, TEST_USER_NAME);
+    assert_non_null(dn);
+
+    ret = sysdb_add_entry_access(test_ctx->tctx->sysdb, dn, 3, TEST_NOW_1);
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_add_entry_access(test_ctx->tctx->sysdb, dn, 2, TEST_NOW_2);
+    assert_int_equal(ret, EOK);
+
+    /* The statistics are kept in the timestamp cache only */
+    ret = sysdb_search_ts_entry(test_ctx, test_ctx->tctx->sysdb, dn,
+                                LDB_SCOPE_BASE, NULL, attrs,
+                                &msg_count, &msgs);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(msg_count, 1);
+    assert_int_equal(ldb_msg_find_attr_as_uint64(msgs[0], SYSDB_LAST_ACCESS,
+                                                 0), TEST_NOW_2);
+    assert_int_equal(ldb_msg_find_attr_as_uint(msgs[0], SYSDB_ACCESS_COUNT,
+                                               0), 5);
+    talloc_zfree(msgs);
+
+    ret = ldb_search(sysdb_ctx_get_ldb(test_ctx->tctx->sysdb), test_ctx, &res,
+                     dn, LDB_SCOPE_BASE, attrs, NULL);
+    assert_int_equal(ret, LDB_SUCCESS);
+    assert_int_equal(res->count, 1);
+    assert_null(ldb_msg_find_element(res->msgs[0], SYSDB_LAST_ACCESS));
+    assert_null(ldb_msg_find_element(res->msgs[0], SYSDB_ACCESS_COUNT));
+    talloc_zfree(res);
+
+    /* A late write of an older access does not move the last access back
+     * and the count decays with time */
+    ret = sysdb_add_entry_access(test_ctx->tctx->sysdb, dn, 1, TEST_NOW_1);
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_add_entry_access(test_ctx->tctx->sysdb, dn, 1,
+                                 TEST_NOW_2 + 2 * SYSDB_ACCESS_HALF_LIFE);
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_search_ts_entry(test_ctx, test_ctx->tctx->sysdb, dn,
+                                LDB_SCOPE_BASE, NULL, attrs,
+                                &msg_count, &msgs);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(msg_count, 1);
+    assert_int_equal(ldb_msg_find_attr_as_uint64(msgs[0], SYSDB_LAST_ACCESS,
+                                                 0),
+                     TEST_NOW_2 + 2 * SYSDB_ACCESS_HALF_LIFE);
+    assert_int_equal(ldb_msg_find_attr_as_uint(msgs[0], SYSDB_ACCESS_COUNT,
+                                               0), 6 / 4 + 1);
+    talloc_zfree(msgs);
+
+    assert_int_equal(sysdb_decay_access_count(8, TEST_NOW_1, TEST_NOW_1), 8);
+    assert_int_equal(sysdb_decay_access_count(8, TEST_NOW_2, TEST_NOW_1), 8);
+    assert_int_equal(sysdb_decay_access_count(8, TEST_NOW_1,
+                         TEST_NOW_1 + 3 * SYSDB_ACCESS_HALF_LIFE), 1);
+    assert_int_equal(sysdb_decay_access_count(UINT32_MAX, TEST_NOW_1,
+                         TEST_NOW_1 + 40 * SYSDB_ACCESS_HALF_LIFE), 0);
+
+    talloc_free(dn);
+}
+
 int main(int argc, const char *argv[])
 {
     int rv;
@@ -1462,6 +1540,9 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_sysdb_zero_now,
                                         test_sysdb_ts_setup,
                                         test_sysdb_ts_teardown),
+        cmocka_unit_test_setup_teardown(test_sysdb_entry_access,
+                                        test_sysdb_ts_setup,
+                                        test_sysdb_ts_teardown),
     };
 
     /* Set debug level to invalid value so we can deside if -d 0 was used. */
@@ -215,6 +215,209 @@ static void test_sysdb_store_override(void **state)
 
 }
 
+static void test_sysdb_store_override_merged(void **state)
+{
+    int ret;
+    struct ldb_message *msg;
+    struct ldb_result *res;
+    struct ldb_dn *override_dn;
+    struct sysdb_attrs *attrs;
+    char *name;
+    const char override_dn_str[] = SYSDB_OVERRIDE_ANCHOR_UUID "=" \
+                       TEST_ANCHOR_PREFIX TEST_USER_SID "," TEST_VIEW_CONTAINER;
+
+    struct sysdb_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                         struct sysdb_test_ctx);
+
+    test_ctx->domain->mpg = false;
+    test_ctx->domain->view_name = TEST_VIEW_NAME;
+    name = sss_create_internal_fqname(test_ctx, TEST_USER_NAME,
+                                      test_ctx->domain->name);
+    assert_non_null(name);
+
+    ret = sysdb_store_user(test_ctx->domain, name, NULL,
+                           TEST_USER_UID, TEST_USER_GID, TEST_USER_GECOS,
+                           TEST_USER_HOMEDIR, TEST_USER_SHELL, NULL, NULL, NULL,
+                           0,0);
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_search_user_by_name(test_ctx, test_ctx->domain, name,
+                                    NULL, &msg);
+    assert_int_equal(ret, EOK);
+
+    attrs = sysdb_new_attrs(test_ctx);
+    assert_non_null(attrs);
+    ret = sysdb_attrs_add_string(attrs, SYSDB_OVERRIDE_ANCHOR_UUID,
+                                 TEST_ANCHOR_PREFIX TEST_USER_SID);
+    assert_int_equal(ret, EOK);
+    ret = sysdb_attrs_add_string(attrs, SYSDB_GECOS, "OVERRIDEGECOS");
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_store_override(test_ctx->domain, TEST_VIEW_NAME,
+                               SYSDB_MEMBER_USER, attrs, msg->dn);
+    assert_int_equal(ret, EOK);
+
+    /* The override data is stored with the original object.. */
+    ret = sysdb_getpwnam(test_ctx, test_ctx->domain, name, &res);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(res->count, 1);
+    assert_string_equal(override_dn_str,
+                        ldb_msg_find_attr_as_string(res->msgs[0],
+                                                    SYSDB_OVERRIDE_MERGED_DN,
+                                                    NULL));
+    assert_string_equal("OVERRIDEGECOS",
+                        ldb_msg_find_attr_as_string(res->msgs[0],
+                                                    OVERRIDE_PREFIX SYSDB_GECOS,
+                                                    NULL));
+
+    /* ..so the override object is not read during the lookup */
+    override_dn = ldb_dn_new(test_ctx, test_ctx->domain->sysdb->ldb,
+                             override_dn_str);
+    assert_non_null(override_dn);
+    ret = ldb_delete(test_ctx->domain->sysdb->ldb, override_dn);
+    assert_int_equal(ret, LDB_SUCCESS);
+
+    ret = sysdb_getpwnam_with_views(test_ctx, test_ctx->domain, name, &res);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(res->count, 1);
+    assert_string_equal("OVERRIDEGECOS",
+                        ldb_msg_find_attr_as_string(res->msgs[0],
+                                                    OVERRIDE_PREFIX SYSDB_GECOS,
+                                                    NULL));
+
+    /* Storing the override again replaces the stored data */
+    ret = sysdb_attrs_replace_name(attrs, SYSDB_GECOS, SYSDB_SHELL);
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_store_override(test_ctx->domain, TEST_VIEW_NAME,
+                               SYSDB_MEMBER_USER, attrs, msg->dn);
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_getpwnam_with_views(test_ctx, test_ctx->domain, name, &res);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(res->count, 1);
+    assert_null(ldb_msg_find_attr_as_string(res->msgs[0],
+                                            OVERRIDE_PREFIX SYSDB_GECOS,
+                                            NULL));
+    assert_string_equal("OVERRIDEGECOS",
+                        ldb_msg_find_attr_as_string(res->msgs[0],
+                                                    OVERRIDE_PREFIX SYSDB_SHELL,
+                                                    NULL));
+
+    /* And invalidating the overrides removes it */
+    ret = sysdb_invalidate_overrides(test_ctx->domain->sysdb);
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_getpwnam(test_ctx, test_ctx->domain, name, &res);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(res->count, 1);
+    assert_null(ldb_msg_find_attr_as_string(res->msgs[0],
+                                            SYSDB_OVERRIDE_MERGED_DN, NULL));
+    assert_null(ldb_msg_find_attr_as_string(res->msgs[0],
+                                            OVERRIDE_PREFIX SYSDB_SHELL,
+                                            NULL));
+}
+
+static void test_sysdb_delete_override_merged(void **state)
+{
+    int ret;
+    struct ldb_message *msg;
+    struct ldb_message *mod_msg;
+    struct ldb_result *res;
+    struct ldb_dn *override_dn;
+    struct sysdb_attrs *attrs;
+    struct ldb_context *ldb;
+    char *name;
+    const char override_dn_str[] = SYSDB_OVERRIDE_ANCHOR_UUID "=" \
+                       TEST_ANCHOR_PREFIX TEST_USER_SID "," TEST_VIEW_CONTAINER;
+
+    struct sysdb_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                         struct sysdb_test_ctx);
+
+    ldb = test_ctx->domain->sysdb->ldb;
+    test_ctx->domain->mpg = false;
+    test_ctx->domain->view_name = TEST_VIEW_NAME;
+    name = sss_create_internal_fqname(test_ctx, TEST_USER_NAME,
+                                      test_ctx->domain->name);
+    assert_non_null(name);
+
+    ret = sysdb_store_user(test_ctx->domain, name, NULL,
+                           TEST_USER_UID, TEST_USER_GID, TEST_USER_GECOS,
+                           TEST_USER_HOMEDIR, TEST_USER_SHELL, NULL, NULL, NULL,
+                           0,0);
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_search_user_by_name(test_ctx, test_ctx->domain, name,
+                                    NULL, &msg);
+    assert_int_equal(ret, EOK);
+
+    attrs = sysdb_new_attrs(test_ctx);
+    assert_non_null(attrs);
+    ret = sysdb_attrs_add_string(attrs, SYSDB_OVERRIDE_ANCHOR_UUID,
+                                 TEST_ANCHOR_PREFIX TEST_USER_SID);
+    assert_int_equal(ret, EOK);
+    ret = sysdb_attrs_add_string(attrs, SYSDB_GECOS, "OVERRIDEGECOS");
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_store_override(test_ctx->domain, TEST_VIEW_NAME,
+                               SYSDB_MEMBER_USER, attrs, msg->dn);
+    assert_int_equal(ret, EOK);
+
+    /* Delete the override the way sss_override user-del does */
+    override_dn = ldb_dn_new(test_ctx, ldb, override_dn_str);
+    assert_non_null(override_dn);
+    ret = sysdb_delete_entry(test_ctx->domain->sysdb, override_dn, true);
+    assert_int_equal(ret, EOK);
+
+    mod_msg = ldb_msg_new(test_ctx);
+    assert_non_null(mod_msg);
+    mod_msg->dn = msg->dn;
+    ret = ldb_msg_add_empty(mod_msg, SYSDB_OVERRIDE_DN, LDB_FLAG_MOD_DELETE,
+                            NULL);
+    assert_int_equal(ret, LDB_SUCCESS);
+    ret = sysdb_add_merged_overrides(mod_msg, NULL, NULL);
+    assert_int_equal(ret, EOK);
+    ret = ldb_modify(ldb, mod_msg);
+    assert_int_equal(ret, LDB_SUCCESS);
+
+    ret = sysdb_getpwnam(test_ctx, test_ctx->domain, name, &res);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(res->count, 1);
+    assert_null(ldb_msg_find_attr_as_string(res->msgs[0],
+                                            SYSDB_OVERRIDE_MERGED_DN, NULL));
+    assert_null(ldb_msg_find_attr_as_string(res->msgs[0],
+                                            OVERRIDE_PREFIX SYSDB_GECOS,
+                                            NULL));
+
+    /* Stored override data left behind without overrideDN is not used */
+    ret = sysdb_store_override(test_ctx->domain, TEST_VIEW_NAME,
+                               SYSDB_MEMBER_USER, attrs, msg->dn);
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_delete_entry(test_ctx->domain->sysdb, override_dn, true);
+    assert_int_equal(ret, EOK);
+
+    mod_msg = ldb_msg_new(test_ctx);
+    assert_non_null(mod_msg);
+    mod_msg->dn = msg->dn;
+    ret = ldb_msg_add_empty(mod_msg, SYSDB_OVERRIDE_DN, LDB_FLAG_MOD_DELETE,
+                            NULL);
+    assert_int_equal(ret, LDB_SUCCESS);
+    ret = ldb_modify(ldb, mod_msg);
+    assert_int_equal(ret, LDB_SUCCESS);
+
+    test_ctx->domain->view_name = discard_const(SYSDB_LOCAL_VIEW_NAME);
+    ret = sysdb_getpwnam_with_views(test_ctx, test_ctx->domain, name, &res);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(res->count, 1);
+    assert_null(ldb_msg_find_attr_as_string(res->msgs[0],
+                                            OVERRIDE_PREFIX SYSDB_GECOS,
+                                            NULL));
+    assert_string_equal(TEST_USER_GECOS,
+                        ldb_msg_find_attr_as_string(res->msgs[0],
+                                                    SYSDB_GECOS, NULL));
+}
+
 void test_sysdb_add_overrides_to_object(void **state)
 {
     int ret;
@@ -1030,6 +1233,10 @@ int main(int argc, const char *argv[])
     const struct CMUnitTest tests[] = {
         cmocka_unit_test_setup_teardown(test_sysdb_store_override,
                                         test_sysdb_setup, test_sysdb_teardown),
+        cmocka_unit_test_setup_teardown(test_sysdb_store_override_merged,
+                                        test_sysdb_setup, test_sysdb_teardown),
+        cmocka_unit_test_setup_teardown(test_sysdb_delete_override_merged,
+                                        test_sysdb_setup, test_sysdb_teardown),
         cmocka_unit_test_setup_teardown(test_sysdb_add_overrides_to_object,
                                         test_sysdb_setup, test_sysdb_teardown),
         cmocka_unit_test_setup_teardown(test_sysdb_add_overrides_to_object_local,
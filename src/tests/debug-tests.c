@@ -651,6 +651,79 @@ START_TEST(test_debug_is_set_false)
 }
 END_TEST
 
+static void test_helper_debug_log(int level, const char *body)
+{
+    DEBUG(level, "%s\n", body);
+}
+
+START_TEST(test_debug_flight_recorder)
+{
+    char filename[24] = {'\0'};
+    char msg[1024];
+    const char *expected;
+    mode_t old_umask;
+    FILE *file;
+    size_t len;
+    int fd;
+    int ret;
+
+    strncpy(filename, "sssd_debug_tests.XXXXXX", 24);
+
+    old_umask = umask(SSS_DFL_UMASK);
+    fd = mkstemp(filename);
+    umask(old_umask);
+    fail_if(fd == -1, "mkstemp failed");
+
+    file = fdopen(fd, "r");
+    fail_if(file == NULL, "fdopen failed");
+
+    ret = set_debug_file_from_fd(fd);
+    fail_unless(ret == EOK, "set_debug_file_from_fd failed");
+
+    debug_timestamps = 0;
+    debug_microseconds = 0;
+    debug_to_file = 1;
+    debug_prg_name = "sssd";
+    debug_level = SSSDBG_FATAL_FAILURE | SSSDBG_CRIT_FAILURE |
+                  SSSDBG_OP_FAILURE;
+
+    ret = debug_init_flight_recorder(1024);
+    fail_unless(ret == EOK, "debug_init_flight_recorder failed");
+    fail_unless(DEBUG_IS_SET(SSSDBG_TRACE_ALL),
+                "Recorded level is not set");
+    fail_if(DEBUG_IS_LOGGED(SSSDBG_TRACE_ALL),
+            "Recorded level should not be logged");
+
+    test_helper_debug_log(SSSDBG_TRACE_FUNC, "trace message");
+
+    fseek(file, 0, SEEK_END);
+    fail_unless(ftell(file) == 0, "Recorded message was logged");
+
+    test_helper_debug_log(SSSDBG_OP_FAILURE, "some error");
+
+    fseek(file, 0, SEEK_END);
+    len = ftell(file);
+    fail_if(len >= sizeof(msg), "Unexpected log size");
+    rewind(file);
+    fail_unless(fread(msg, 1, len, file) == len, "fread failed");
+    msg[len] = '\0';
+
+    expected = "***** Begin of flight recorder messages *****\n"
+               "[sssd] [test_helper_debug_log] (0x0400): trace message\n"
+               "***** End of flight recorder messages *****\n"
+               "[sssd] [test_helper_debug_log] (0x0040): some error\n";
+    fail_unless(strcmp(msg, expected) == 0,
+                "Unexpected log content [%s]", msg);
+
+    ret = debug_init_flight_recorder(0);
+    fail_unless(ret == EOK, "debug_init_flight_recorder failed");
+    fail_if(DEBUG_IS_SET(SSSDBG_TRACE_ALL), "Recorder was not disabled");
+
+    fclose(file);
+    remove(filename);
+}
+END_TEST
+
 Suite *debug_suite(void)
 {
     Suite *s = suite_create("debug");
@@ -667,6 +740,7 @@ Suite *debug_suite(void)
     tcase_add_test(tc_debug, test_debug_is_notset_timestamp_microseconds);
     tcase_add_test(tc_debug, test_debug_is_set_true);
     tcase_add_test(tc_debug, test_debug_is_set_false);
+    tcase_add_test(tc_debug, test_debug_flight_recorder);
     tcase_set_timeout(tc_debug, 60);
 
     suite_add_tcase(s, tc_debug);
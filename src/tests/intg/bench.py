@@ -0,0 +1,460 @@
+#
+# SSSD end-to-end benchmark
+#
+# Copyright (c) 2017 Red Hat, Inc.
+#
+# This is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by
+# the Free Software Foundation; version 2 only
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+"""
+Measure the throughput and latency of SSSD against a synthetic directory.
+
+The benchmark runs in the same environment as the integration tests: a
+private slapd instance, nss_wrapper pointing to the installed NSS module
+and uid_wrapper making SSSD believe it runs as root. It is started by
+"make bench" which writes the report to bench.json in the build directory.
+
+Every operation is measured in up to three states of the caches:
+
+    cold    SSSD was just started with empty caches, every request goes
+            to the directory server.
+    warm    The same requests again, served from the cache database.
+    mmap    Served by the fast in-memory cache in the client, only for
+            the NSS operations.
+"""
+
+import argparse
+import ctypes
+import grp
+import json
+import os
+import pwd
+import signal
+import socket
+import stat
+import struct
+import subprocess
+import sys
+import time
+
+import config
+import ds_openldap
+import bench_dir
+from util import unindent
+
+LDAP_BASE_DN = "dc=example,dc=com"
+LDAP_PORT = 10389
+DOMAIN = "LDAP"
+
+timer = getattr(time, "perf_counter", time.time)
+
+# src/sss_client/sss_cli.h
+SSS_GET_VERSION = 0x0001
+SSS_PAM_AUTHENTICATE = 0x00F1
+SSS_PAM_PROTOCOL_VERSION = 3
+SSS_START_OF_PAM_REQUEST = 0x4d415049
+SSS_END_OF_PAM_REQUEST = 0x4950414d
+SSS_PAM_ITEM_USER = 0x0001
+SSS_PAM_ITEM_SERVICE = 0x0002
+SSS_PAM_ITEM_AUTHTOK = 0x0006
+SSS_PAM_ITEM_CLI_PID = 0x0009
+SSS_AUTHTOK_TYPE_PASSWORD = 0x0001
+SSS_NSS_HEADER = struct.Struct("=IIII")
+PAM_SUCCESS = 0
+
+
+class Sample(object):
+    """Latencies of one operation in one cache state."""
+
+    def __init__(self, op, cache):
+        self.op = op
+        self.cache = cache
+        self.latencies = []
+        self.errors = 0
+        self.elapsed = 0.0
+
+    def run(self, fn, keys):
+        """Call fn for every key and record how long each call took."""
+        start = timer()
+        for key in keys:
+            before = timer()
+            try:
+                ok = fn(key)
+            except (KeyError, EnvironmentError):
+                ok = False
+            self.latencies.append(timer() - before)
+            if not ok:
+                self.errors += 1
+        self.elapsed = timer() - start
+        return self
+
+    @staticmethod
+    def percentile(values, pct):
+        if not values:
+            return 0.0
+        index = int(round(pct / 100.0 * (len(values) - 1)))
+        return values[index]
+
+    def report(self):
+        """Return the sample as a dictionary for the report."""
+        values = sorted(self.latencies)
+        usec = lambda secs: round(secs * 1000000.0, 1)
+        return dict(
+            op=self.op,
+            cache=self.cache,
+            ops=len(values),
+            errors=self.errors,
+            ops_per_sec=round(len(values) / self.elapsed, 1)
+            if self.elapsed > 0 else 0.0,
+            latency_usec=dict(
+                mean=usec(sum(values) / len(values)) if values else 0.0,
+                p50=usec(self.percentile(values, 50)),
+                p90=usec(self.percentile(values, 90)),
+                p99=usec(self.percentile(values, 99)),
+                max=usec(values[-1]) if values else 0.0,
+            ),
+        )
+
+
+class PamClient(object):
+    """Minimal client of the PAM responder protocol, see pam_message.c."""
+
+    def __init__(self, pipe_path):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.connect(os.path.join(pipe_path, "pam"))
+        self._call(SSS_GET_VERSION,
+                   struct.pack("=I", SSS_PAM_PROTOCOL_VERSION))
+
+    def close(self):
+        self.sock.close()
+
+    def _recv(self, size):
+        data = b""
+        while len(data) < size:
+            chunk = self.sock.recv(size - len(data))
+            if not chunk:
+                raise EnvironmentError("PAM responder closed the connection")
+            data += chunk
+        return data
+
+    def _call(self, cmd, body):
+        self.sock.sendall(SSS_NSS_HEADER.pack(SSS_NSS_HEADER.size + len(body),
+                                              cmd, 0, 0) + body)
+        length, cmd, status, _ = SSS_NSS_HEADER.unpack(
+            self._recv(SSS_NSS_HEADER.size))
+        body = self._recv(length - SSS_NSS_HEADER.size)
+        return status, body
+
+    @staticmethod
+    def _item(item_type, data):
+        return struct.pack("=II", item_type, len(data)) + data
+
+    def authenticate(self, user, password, service="bench"):
+        """Run a PAM authentication, return True on success."""
+        authtok = struct.pack("=I", SSS_AUTHTOK_TYPE_PASSWORD) + \
+            password.encode("utf-8")
+        body = struct.pack("=I", SSS_START_OF_PAM_REQUEST) + \
+            self._item(SSS_PAM_ITEM_USER, user.encode("utf-8") + b"\0") + \
+            self._item(SSS_PAM_ITEM_SERVICE,
+                       service.encode("utf-8") + b"\0") + \
+            self._item(SSS_PAM_ITEM_AUTHTOK, authtok) + \
+            self._item(SSS_PAM_ITEM_CLI_PID,
+                       struct.pack("=I", os.getpid())) + \
+            struct.pack("=I", SSS_END_OF_PAM_REQUEST)
+
+        status, body = self._call(SSS_PAM_AUTHENTICATE, body)
+        if status != 0 or len(body) < 4:
+            return False
+        return struct.unpack("=I", body[:4])[0] == PAM_SUCCESS
+
+
+class SudoResult(ctypes.Structure):
+    _fields_ = [("num_rules", ctypes.c_uint),
+                ("rules", ctypes.c_void_p)]
+
+
+class SudoClient(object):
+    """Fetch sudo rules through the installed libsss_sudo."""
+
+    def __init__(self, path):
+        self.lib = ctypes.CDLL(path)
+        self.lib.sss_sudo_send_recv.argtypes = [
+            ctypes.c_uint, ctypes.c_char_p, ctypes.c_char_p,
+            ctypes.POINTER(ctypes.c_uint32),
+            ctypes.POINTER(ctypes.POINTER(SudoResult))]
+        self.lib.sss_sudo_free_result.argtypes = [
+            ctypes.POINTER(SudoResult)]
+
+    def rules(self, uid, user):
+        """Fetch the rules of a user, return True on success."""
+        error = ctypes.c_uint32(0)
+        result = ctypes.POINTER(SudoResult)()
+        ret = self.lib.sss_sudo_send_recv(uid, user.encode("utf-8"),
+                                          DOMAIN.encode("utf-8"),
+                                          ctypes.byref(error),
+                                          ctypes.byref(result))
+        if ret != 0 or error.value != 0:
+            return False
+        self.lib.sss_sudo_free_result(result)
+        return True
+
+
+class IfpClient(object):
+    """Look up users through the InfoPipe responder on the system bus."""
+
+    def __init__(self):
+        import dbus
+        bus = dbus.SystemBus()
+        obj = bus.get_object("org.freedesktop.sssd.infopipe",
+                             "/org/freedesktop/sssd/infopipe")
+        self.iface = dbus.Interface(obj, "org.freedesktop.sssd.infopipe")
+
+    def user_attr(self, user):
+        attrs = self.iface.GetUserAttr(user, ["uidNumber"])
+        return "uidNumber" in attrs
+
+
+def getgrouplist(user):
+    """Return the number of groups of a user through the libc."""
+    libc = ctypes.CDLL(None)
+    ngroups = ctypes.c_int(1024)
+    groups = (ctypes.c_uint * ngroups.value)()
+    ret = libc.getgrouplist(user.encode("utf-8"), ctypes.c_uint(0),
+                            groups, ctypes.byref(ngroups))
+    return ret >= 0 and ngroups.value > 1
+
+
+def format_conf(ds_inst, memcache_timeout, ifp):
+    services = "nss, pam, sudo" + (", ifp" if ifp else "")
+    return unindent("""\
+        [sssd]
+        domains             = {DOMAIN}
+        services            = {services}
+
+        [nss]
+        memcache_timeout    = {memcache_timeout}
+
+        [pam]
+
+        [sudo]
+
+        [domain/{DOMAIN}]
+        ldap_auth_disable_tls_never_use_in_production = true
+        id_provider         = ldap
+        auth_provider       = ldap
+        sudo_provider       = ldap
+        ldap_schema         = rfc2307bis
+        ldap_group_object_class = groupOfNames
+        ldap_uri            = {ds_inst.ldap_url}
+        ldap_search_base    = {ds_inst.base_dn}
+        ldap_sudo_search_base = ou={sudo_ou},{ds_inst.base_dn}
+        entry_cache_timeout = 5400
+    """).format(DOMAIN=DOMAIN, sudo_ou=bench_dir.SUDO_OU, **locals())
+
+
+def start_sssd(conf, pipe_path):
+    """Write the configuration, start SSSD and wait for the responders."""
+    with open(config.CONF_PATH, "w") as conf_file:
+        conf_file.write(conf)
+    os.chmod(config.CONF_PATH, stat.S_IRUSR | stat.S_IWUSR)
+
+    if subprocess.call(["sssd", "-D", "-f"]) != 0:
+        raise Exception("sssd start failed")
+
+    for attempt in range(30):
+        if all(os.path.exists(os.path.join(pipe_path, name))
+               for name in ("nss", "pam", "sudo")):
+            return
+        time.sleep(1)
+    raise Exception("sssd responders did not start")
+
+
+def stop_sssd():
+    """Stop SSSD and remove all caches."""
+    try:
+        with open(config.PIDFILE_PATH, "r") as pid_file:
+            pid = int(pid_file.read())
+        os.kill(pid, signal.SIGTERM)
+        while True:
+            try:
+                os.kill(pid, signal.SIGCONT)
+            except OSError:
+                break
+            time.sleep(0.1)
+    except (IOError, OSError, ValueError):
+        pass
+    for path in os.listdir(config.DB_PATH):
+        os.unlink(os.path.join(config.DB_PATH, path))
+    for path in os.listdir(config.MCACHE_PATH):
+        os.unlink(os.path.join(config.MCACHE_PATH, path))
+    if os.path.lexists(config.CONF_PATH):
+        os.unlink(config.CONF_PATH)
+
+
+def spread(count, limit):
+    """Return up to limit indexes evenly spread over range(count)."""
+    if count <= limit:
+        return list(range(count))
+    step = float(count) / limit
+    return [int(i * step) for i in range(limit)]
+
+
+def run(args):
+    shape = bench_dir.Shape(users=args.users,
+                            groups=args.groups,
+                            group_size=args.group_size,
+                            nesting=args.nesting,
+                            sudo_rules=args.sudo_rules)
+    users = spread(shape.users, args.lookups)
+    groups = spread(shape.groups, args.lookups)
+    user_names = [bench_dir.user_name(i) for i in users]
+    group_names = [bench_dir.group_name(i) for i in groups]
+
+    getpwnam = lambda name: pwd.getpwnam(name) is not None
+    getgrnam = lambda name: grp.getgrnam(name) is not None
+    samples = []
+
+    ds_inst = ds_openldap.DSOpenLDAP(config.PREFIX, LDAP_PORT, LDAP_BASE_DN,
+                                     "cn=admin", "Secret123")
+    try:
+        ds_inst.setup()
+        bench_dir.prepare(ds_inst)
+
+        start = timer()
+        bench_dir.load(ds_inst, bench_dir.generate(ds_inst.base_dn, shape))
+        sys.stderr.write("Loaded directory in {0:.1f}s\n".format(
+            timer() - start))
+
+        # Without the fast cache every lookup reaches the responder
+        try:
+            start_sssd(format_conf(ds_inst, 0, args.ifp), args.pipe_path)
+            for cache in ("cold", "warm"):
+                samples.append(Sample("getpwnam", cache).run(getpwnam,
+                                                             user_names))
+                samples.append(Sample("getgrnam", cache).run(getgrnam,
+                                                             group_names))
+                samples.append(Sample("initgroups", cache).run(getgrouplist,
+                                                               user_names))
+
+            if args.sudo_lib and not os.path.exists(args.sudo_lib):
+                sys.stderr.write("{0} not found, sudo is not measured\n"
+                                 .format(args.sudo_lib))
+            elif args.sudo_lib:
+                sudo = SudoClient(args.sudo_lib)
+                sudo_rules = lambda i: sudo.rules(bench_dir.UID_BASE + i,
+                                                  bench_dir.user_name(i))
+                for cache in ("cold", "warm"):
+                    samples.append(Sample("sudo", cache).run(sudo_rules,
+                                                             users))
+
+            pam = PamClient(args.pipe_path)
+            pam_auth = lambda i: pam.authenticate(
+                bench_dir.user_name(i),
+                "Password" + str(bench_dir.UID_BASE + i))
+            try:
+                for cache in ("cold", "warm"):
+                    samples.append(Sample("pam_auth", cache).run(pam_auth,
+                                                                 users))
+            finally:
+                pam.close()
+
+            if args.ifp:
+                # The users are in the cache after the NSS lookups
+                ifp = IfpClient()
+                samples.append(Sample("ifp_user_attr", "warm").run(
+                    ifp.user_attr, user_names))
+        finally:
+            stop_sssd()
+
+        # Prime the fast cache, then measure lookups served from it
+        try:
+            start_sssd(format_conf(ds_inst, 300, False), args.pipe_path)
+            for name in user_names:
+                getpwnam(name)
+                getgrouplist(name)
+            for name in group_names:
+                getgrnam(name)
+
+            samples.append(Sample("getpwnam", "mmap").run(getpwnam,
+                                                          user_names))
+            samples.append(Sample("getgrnam", "mmap").run(getgrnam,
+                                                          group_names))
+            samples.append(Sample("initgroups", "mmap").run(getgrouplist,
+                                                            user_names))
+        finally:
+            stop_sssd()
+    finally:
+        ds_inst.teardown()
+
+    try:
+        version = subprocess.check_output(["sssd", "--version"]).strip()
+        version = version.decode("utf-8")
+    except (OSError, subprocess.CalledProcessError):
+        version = "unknown"
+
+    return dict(
+        sssd_version=version,
+        timestamp=time.strftime("%Y-%m-%dT%H:%M:%SZ", time.gmtime()),
+        shape=shape.as_dict(),
+        lookups=len(users),
+        results=[sample.report() for sample in samples],
+    )
+
+
+def print_summary(report, out):
+    out.write("{0:<14} {1:<5} {2:>7} {3:>6} {4:>10} {5:>10} {6:>10}\n".format(
+        "op", "cache", "ops", "errors", "ops/s", "p50 us", "p99 us"))
+    for res in report["results"]:
+        out.write("{0:<14} {1:<5} {2:>7} {3:>6} {4:>10} {5:>10} {6:>10}\n"
+                  .format(res["op"], res["cache"], res["ops"], res["errors"],
+                          res["ops_per_sec"], res["latency_usec"]["p50"],
+                          res["latency_usec"]["p99"]))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().split(
+        "\n")[0])
+    parser.add_argument("--users", type=int, default=1000)
+    parser.add_argument("--groups", type=int, default=100)
+    parser.add_argument("--group-size", type=int, default=50)
+    parser.add_argument("--nesting", type=int, default=0,
+                        help="depth of group nesting")
+    parser.add_argument("--sudo-rules", type=int, default=100)
+    parser.add_argument("--lookups", type=int, default=1000,
+                        help="maximum number of distinct users and groups "
+                             "looked up by every operation")
+    parser.add_argument("--pipe-path", required=True,
+                        help="directory with the responder sockets")
+    parser.add_argument("--sudo-lib",
+                        help="path to libsss_sudo.so, sudo is not measured "
+                             "without it")
+    parser.add_argument("--ifp", action="store_true",
+                        help="also measure InfoPipe, needs a system bus")
+    parser.add_argument("--output", help="write the JSON report here "
+                                         "instead of the standard output")
+    args = parser.parse_args()
+
+    report = run(args)
+    print_summary(report, sys.stderr)
+
+    if args.output:
+        with open(args.output, "w") as out:
+            json.dump(report, out, indent=4, sort_keys=True)
+            out.write("\n")
+    else:
+        json.dump(report, sys.stdout, indent=4, sort_keys=True)
+        sys.stdout.write("\n")
+
+
+if __name__ == "__main__":
+    main()
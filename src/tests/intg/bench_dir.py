@@ -0,0 +1,191 @@
+#
+# Synthetic directory generator for the SSSD benchmark
+#
+# Copyright (c) 2017 Red Hat, Inc.
+#
+# This is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by
+# the Free Software Foundation; version 2 only
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+import ldap
+
+import ldap_ent
+
+USER_NAME = "bench_user{0}"
+GROUP_NAME = "bench_group{0}"
+SUDO_RULE_NAME = "bench_rule{0}"
+
+UID_BASE = 100000
+GID_BASE = 200000
+
+SUDO_OU = "SUDOers"
+
+# The sudoRole schema shipped with sudo, without the attributes SSSD
+# does not need for the benchmark
+SUDO_SCHEMA = [
+    ("objectClass", [b"olcSchemaConfig"]),
+    ("cn", [b"sudo"]),
+    ("olcAttributeTypes", [
+        b"( 1.3.6.1.4.1.15953.9.1.1 NAME 'sudoUser' "
+        b"EQUALITY caseExactIA5Match SUBSTR caseExactIA5SubstringsMatch "
+        b"SYNTAX 1.3.6.1.4.1.1466.115.121.1.26 )",
+        b"( 1.3.6.1.4.1.15953.9.1.2 NAME 'sudoHost' "
+        b"EQUALITY caseExactIA5Match SUBSTR caseExactIA5SubstringsMatch "
+        b"SYNTAX 1.3.6.1.4.1.1466.115.121.1.26 )",
+        b"( 1.3.6.1.4.1.15953.9.1.3 NAME 'sudoCommand' "
+        b"EQUALITY caseExactIA5Match "
+        b"SYNTAX 1.3.6.1.4.1.1466.115.121.1.26 )",
+        b"( 1.3.6.1.4.1.15953.9.1.5 NAME 'sudoOption' "
+        b"EQUALITY caseExactIA5Match "
+        b"SYNTAX 1.3.6.1.4.1.1466.115.121.1.26 )",
+        b"( 1.3.6.1.4.1.15953.9.1.6 NAME 'sudoRunAsUser' "
+        b"EQUALITY caseExactIA5Match "
+        b"SYNTAX 1.3.6.1.4.1.1466.115.121.1.26 )",
+        b"( 1.3.6.1.4.1.15953.9.1.10 NAME 'sudoOrder' "
+        b"EQUALITY integerMatch ORDERING integerOrderingMatch "
+        b"SYNTAX 1.3.6.1.4.1.1466.115.121.1.27 )",
+    ]),
+    ("olcObjectClasses", [
+        b"( 1.3.6.1.4.1.15953.9.2.1 NAME 'sudoRole' SUP top STRUCTURAL "
+        b"MUST cn MAY ( sudoUser $ sudoHost $ sudoCommand $ sudoOption $ "
+        b"sudoRunAsUser $ sudoOrder $ description ) )",
+    ]),
+]
+
+
+class Shape(object):
+    """Shape of a synthetic directory."""
+
+    def __init__(self, users=1000, groups=100, group_size=50,
+                 nesting=0, sudo_rules=100):
+        """
+            Initialize the shape.
+
+            Arguments:
+            users       Number of users.
+            groups      Number of groups.
+            group_size  Number of direct user members of every group.
+            nesting     Depth of group nesting. With a depth of N every
+                        group is a member of the next N groups, so a user
+                        is a transitive member of up to N more groups.
+            sudo_rules  Number of sudo rules.
+        """
+        self.users = users
+        self.groups = groups
+        self.group_size = min(group_size, users)
+        self.nesting = min(nesting, max(groups - 1, 0))
+        self.sudo_rules = sudo_rules
+
+    def as_dict(self):
+        """Return the shape as a dictionary for the report."""
+        return dict(users=self.users,
+                    groups=self.groups,
+                    group_size=self.group_size,
+                    nesting=self.nesting,
+                    sudo_rules=self.sudo_rules)
+
+
+def user_name(i):
+    return USER_NAME.format(i)
+
+
+def group_name(i):
+    return GROUP_NAME.format(i)
+
+
+def group_members(shape, i):
+    """Return the indexes of the direct user members of group i."""
+    if shape.users == 0:
+        return []
+    start = (i * shape.group_size) % shape.users
+    return [(start + j) % shape.users for j in range(shape.group_size)]
+
+
+def sudo_rule(base_dn, cn, users, commands, order):
+    """Generate a sudoRole add-modlist for passing to ldap.add*."""
+    attr_list = [
+        ("objectClass", [b"top", b"sudoRole"]),
+        ("cn", [cn.encode("utf-8")]),
+        ("sudoHost", [b"ALL"]),
+        ("sudoRunAsUser", [b"ALL"]),
+        ("sudoOption", [b"!authenticate"]),
+        ("sudoOrder", [str(order).encode("utf-8")]),
+    ]
+    attr_list.append(("sudoUser", [u.encode("utf-8") for u in users]))
+    attr_list.append(("sudoCommand", [c.encode("utf-8") for c in commands]))
+    return ("cn=" + cn + ",ou=" + SUDO_OU + "," + base_dn, attr_list)
+
+
+def generate(base_dn, shape):
+    """
+        Generate the entries of a directory of the given shape, return an
+        ldap_ent.List. Groups use the RFC2307bis schema so that they can
+        be nested. The result only depends on the shape.
+    """
+    ent_list = ldap_ent.List(base_dn)
+
+    for i in range(shape.users):
+        ent_list.add_user(user_name(i), UID_BASE + i,
+                          GID_BASE + (i % max(shape.groups, 1)))
+
+    for i in range(shape.groups):
+        member_uids = [user_name(u) for u in group_members(shape, i)]
+        member_gids = [group_name(i - d) for d in range(1, shape.nesting + 1)
+                       if i - d >= 0]
+        ent_list.add_group_bis(group_name(i), GID_BASE + i,
+                               member_uids, member_gids)
+
+    for i in range(shape.sudo_rules):
+        users = []
+        if shape.users > 0:
+            users.append(user_name(i % shape.users))
+        if shape.groups > 0:
+            users.append("%" + group_name(i % shape.groups))
+        commands = ["/usr/bin/bench_cmd{0}".format(i),
+                    "/usr/sbin/bench_cmd{0}".format(i)]
+        ent_list.append(sudo_rule(base_dn, SUDO_RULE_NAME.format(i),
+                                  users, commands, i + 1))
+
+    return ent_list
+
+
+def prepare(ds_inst):
+    """
+        Prepare a directory server instance for a synthetic directory:
+        load the sudo schema, create the sudo container and lift the
+        size limit so that large searches are not truncated.
+    """
+    conn = ds_inst.config_bind()
+    try:
+        conn.add_s("cn=sudo,cn=schema,cn=config", SUDO_SCHEMA)
+        conn.modify_s("olcDatabase={-1}frontend,cn=config",
+                      [(ldap.MOD_REPLACE, "olcSizeLimit", [b"unlimited"])])
+    finally:
+        conn.unbind_s()
+
+    conn = ds_inst.bind()
+    try:
+        conn.add_s("ou=" + SUDO_OU + "," + ds_inst.base_dn, [
+            ("objectClass", [b"top", b"organizationalUnit"]),
+        ])
+    finally:
+        conn.unbind_s()
+
+
+def load(ds_inst, ent_list):
+    """Add the generated entries to the directory server instance."""
+    conn = ds_inst.bind()
+    try:
+        for entry in ent_list:
+            conn.add_s(entry[0], entry[1])
+    finally:
+        conn.unbind_s()
@@ -185,10 +185,22 @@ class DSOpenLDAP(DS):
         db_config_file.write(db_config)
         db_config_file.close()
 
+    def _ldapi_url(self):
+        """Return the URL of the local socket of the instance."""
+        return "ldapi://" + url_quote(self.run_dir + "/ldapi", "")
+
+    def config_bind(self):
+        """
+            Connect to the server over the local socket and bind as the
+            cn=config administrator, return connection.
+        """
+        conn = ldap.initialize(self._ldapi_url())
+        conn.simple_bind_s(self.admin_rdn + ",cn=config", self.admin_pw)
+        return conn
+
     def setup(self):
         """Setup the instance."""
-        ldapi_socket = self.run_dir + "/ldapi"
-        ldapi_url = "ldapi://" + url_quote(ldapi_socket, "")
+        ldapi_url = self._ldapi_url()
         url_list = ldapi_url + " " + self.ldap_url
 
         os.makedirs(self.conf_slapd_d_dir)
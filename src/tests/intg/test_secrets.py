@@ -25,6 +25,7 @@ import signal
 import subprocess
 import time
 import socket
+import re
 import pytest
 from requests import HTTPError
 
@@ -107,6 +108,29 @@ def setup_for_secrets(request):
     return None
 
 
+@pytest.fixture
+def setup_for_uid_limit(request):
+    """
+    Same as setup_for_secrets but with a per-UID limit of stored secrets
+    """
+    conf = unindent("""\
+        [sssd]
+        domains = local
+        services = nss
+
+        [domain/local]
+        id_provider = local
+
+        [secrets]
+        max_secrets = 10
+        max_uid_secrets = 3
+    """).format(**locals())
+
+    create_conf_fixture(request, conf)
+    create_sssd_secrets_fixture(request)
+    return None
+
+
 def get_secrets_socket():
     return os.path.join(config.RUNSTATEDIR, "secrets.socket")
 
@@ -303,6 +327,34 @@ def test_curlwrap_crd_ops(setup_for_secrets,
     assert "foo_under_cont" in output
 
 
+def test_curlwrap_reuse_connection(setup_for_secrets,
+                                   curlwrap_tool):
+    """
+    Requests sent one after another through the same tcurl context
+    reuse the connection to the responder
+    """
+    if not curlwrap_tool:
+        pytest.skip("The tcurl tool is not available, skipping test")
+    sock_path = get_secrets_socket()
+
+    run_curlwrap_tool([curlwrap_tool, '-p',
+                       '-v', '-s', sock_path,
+                       'http://localhost/secrets/foo',
+                       'bar'],
+                      200)
+
+    output = run_curlwrap_tool([curlwrap_tool,
+                                '-v', '--sequential', '-s', sock_path,
+                                'http://localhost/secrets/foo',
+                                'http://localhost/secrets/foo'],
+                               200)
+
+    stats = re.search(r"Connections: (\d+) new, (\d+) reused", output)
+    assert stats is not None
+    assert int(stats.group(1)) == 1
+    assert int(stats.group(2)) > 0
+
+
 def test_curlwrap_parallel(setup_for_secrets,
                            curlwrap_tool):
     """
@@ -385,3 +437,32 @@ def test_containers(setup_for_secrets, secrets_cli):
     with pytest.raises(HTTPError) as err406:
         cli.create_container(container)
     assert str(err406.value).startswith("406")
+
+
+def test_uid_limit(setup_for_uid_limit, secrets_cli):
+    """
+    Test that the number of secrets stored by a single user is limited
+    and that the space is released again on deletion
+    """
+    cli = secrets_cli
+
+    MAX_UID_SECRETS = 3
+
+    cli.create_container("mycontainer/")
+    cli.set_secret("mycontainer/0", "value")
+    for x in range(1, MAX_UID_SECRETS):
+        cli.set_secret(str(x), "value")
+
+    with pytest.raises(HTTPError) as err507:
+        cli.set_secret(str(MAX_UID_SECRETS), "value")
+    assert str(err507.value).startswith("507")
+
+    # Containers do not count against the limit, but the secrets they
+    # hold do
+    with pytest.raises(HTTPError) as err409:
+        cli.del_secret("mycontainer/")
+    assert str(err409.value).startswith("409")
+
+    cli.del_secret("mycontainer/0")
+    cli.del_secret("mycontainer/")
+    cli.set_secret(str(MAX_UID_SECRETS), "value")
@@ -28,6 +28,7 @@
 
 struct tool_ctx {
     bool verbose;
+    bool sequential;
     bool done;
 
     size_t nreqs;
@@ -36,6 +37,7 @@ struct tool_ctx {
 struct tool_options {
     int debug;
     int verbose;
+    int sequential;
     int raw;
     int tls;
     int verify_peer;
@@ -242,8 +244,10 @@ run_requests(struct tool_ctx *tool_ctx,
 {
     TALLOC_CTX *tmp_ctx;
     struct tcurl_ctx *tcurl_ctx;
+    struct tcurl_stats stats;
     struct tevent_context *ev;
     struct tevent_req *req;
+    size_t pending;
     errno_t ret;
     int i;
 
@@ -281,12 +285,26 @@ run_requests(struct tool_ctx *tool_ctx,
         }
 
         tevent_req_set_callback(req, request_done, tool_ctx);
+
+        if (tool_ctx->sequential) {
+            /* Wait for the request to finish before sending the next one */
+            pending = tool_ctx->nreqs - 1;
+            while (tool_ctx->nreqs > pending) {
+                tevent_loop_once(ev);
+            }
+        }
     }
 
     while (tool_ctx->done == false) {
         tevent_loop_once(ev);
     }
 
+    if (tool_ctx->verbose) {
+        tcurl_get_stats(tcurl_ctx, &stats);
+        printf("Connections: %"PRIu64" new, %"PRIu64" reused\n",
+               stats.new_connections, stats.reused_connections);
+    }
+
     if (tool_ctx->nreqs > 0) {
         DEBUG(SSSDBG_FATAL_FAILURE,
               "The tool finished with some pending requests, fail!\n");
@@ -322,6 +340,7 @@ int main(int argc, const char *argv[])
 #endif
         { "raw", 'r', POPT_ARG_NONE, &opts.raw, '\0', "Print raw protocol output", NULL },
         { "verbose", 'v', POPT_ARG_NONE, &opts.verbose, '\0', "Print response code and body", NULL },
+        { "sequential", '\0', POPT_ARG_NONE, &opts.sequential, '\0', "Send the next request only after the previous one finished", NULL },
         /* TLS */
         { "tls", '\0', POPT_ARG_NONE, &opts.tls, '\0', "Enable TLS", NULL },
         { "verify-peer", '\0', POPT_ARG_NONE, &opts.verify_peer, '\0', "Verify peer when TLS is enabled", NULL },
@@ -355,6 +374,7 @@ int main(int argc, const char *argv[])
 
     DEBUG_CLI_INIT(opts.debug);
     tool_ctx->verbose = opts.verbose;
+    tool_ctx->sequential = opts.sequential;
 
     ret = prepare_requests(tool_ctx, pc, &opts, &requests, &tool_ctx->nreqs);
     if (ret != EOK) {
@@ -940,6 +940,13 @@ static errno_t override_object_del(struct sss_domain_info *domain,
         goto done;
     }
 
+    /* The override values are also stored with the object itself */
+    ret = sysdb_add_merged_overrides(msg, NULL, NULL);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "sysdb_add_merged_overrides() failed\n");
+        goto done;
+    }
+
     ret = ldb_modify(ldb, msg);
     if (ret != LDB_SUCCESS && ret != LDB_ERR_NO_SUCH_ATTRIBUTE) {
         DEBUG(SSSDBG_OP_FAILURE,
@@ -0,0 +1,155 @@
+/*
+    SSSD
+
+    sssctl: latency histograms and counters
+
+    Copyright (C) 2017 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <popt.h>
+#include <stdio.h>
+
+#include "util/util.h"
+#include "util/sss_stats.h"
+#include "tools/common/sss_tools.h"
+#include "tools/sssctl/sssctl.h"
+
+struct sssctl_stats_opts {
+    int prometheus;
+    const char *process;
+};
+
+static double sssctl_stats_ms(uint64_t usec)
+{
+    return (double)usec / 1000;
+}
+
+static void sssctl_stats_print(struct sss_stats_process *proc)
+{
+    const struct sss_stats_hist *hist;
+    int id;
+
+    if (proc->num_processes > 1) {
+        printf(_("%s (%u processes)%s\n"), proc->name, proc->num_processes,
+               proc->running ? "" : _(" - not running"));
+    } else {
+        printf(_("%s (pid %d)%s\n"), proc->name, (int)proc->pid,
+               proc->running ? "" : _(" - not running"));
+    }
+
+    printf("  %-24s %10s %8s %10s %10s %10s %10s %10s %10s\n",
+           _("Latency [ms]"), _("count"), _("errors"), _("mean"), _("min"),
+           _("p50"), _("p90"), _("p99"), _("max"));
+
+    for (id = 0; id < SSS_STATS_HIST_SENTINEL; id++) {
+        hist = &proc->data.hists[id];
+        if (hist->count == 0) {
+            continue;
+        }
+
+        printf("  %-24s %10"PRIu64" %8"PRIu64" %10.3f %10.3f %10.3f %10.3f "
+               "%10.3f %10.3f\n",
+               sss_stats_hist_name(id), hist->count, hist->errors,
+               sssctl_stats_ms(hist->sum / hist->count),
+               sssctl_stats_ms(hist->min),
+               sssctl_stats_ms(sss_stats_percentile(hist, 50)),
+               sssctl_stats_ms(sss_stats_percentile(hist, 90)),
+               sssctl_stats_ms(sss_stats_percentile(hist, 99)),
+               sssctl_stats_ms(hist->max));
+    }
+
+    for (id = 0; id < SSS_STATS_COUNTER_SENTINEL; id++) {
+        if (proc->data.counters[id] == 0) {
+            continue;
+        }
+
+        printf("  %-24s %10"PRIu64"\n",
+               sss_stats_counter_name(id), proc->data.counters[id]);
+    }
+
+    printf("\n");
+}
+
+errno_t sssctl_stats(struct sss_cmdline *cmdline,
+                     struct sss_tool_ctx *tool_ctx,
+                     void *pvt)
+{
+    struct sssctl_stats_opts opts = {0};
+    struct sss_stats_process **procs;
+    TALLOC_CTX *tmp_ctx;
+    char *prom;
+    bool found = false;
+    errno_t ret;
+    size_t i;
+
+    /* Parse command line. */
+    struct poptOption options[] = {
+        {"prometheus", 'p', POPT_ARG_NONE, &opts.prometheus, 0, _("Print statistics in the Prometheus text format"), NULL },
+        {"process", 'P', POPT_ARG_STRING, &opts.process, 0, _("Print statistics of this process only, e.g. nss or be[example.com]"), NULL },
+        POPT_TABLEEND
+    };
+
+    ret = sss_tool_popt(cmdline, options, SSS_TOOL_OPT_OPTIONAL, NULL, NULL);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to parse command arguments\n");
+        return ret;
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    ret = sss_stats_read(tmp_ctx, DB_PATH, &procs);
+    if (ret != EOK) {
+        fprintf(stderr, _("Unable to read statistics [%d]: %s\n"),
+                ret, sss_strerror(ret));
+        goto done;
+    }
+
+    if (opts.prometheus) {
+        prom = sss_stats_prometheus(tmp_ctx, procs);
+        if (prom == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        printf("%s", prom);
+        ret = EOK;
+        goto done;
+    }
+
+    for (i = 0; procs[i] != NULL; i++) {
+        if (opts.process != NULL && strcmp(opts.process, procs[i]->name) != 0) {
+            continue;
+        }
+
+        sssctl_stats_print(procs[i]);
+        found = true;
+    }
+
+    if (!found) {
+        fprintf(stderr, _("No statistics found\n"));
+        ret = ENOENT;
+        goto done;
+    }
+
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
@@ -33,6 +33,7 @@
 #include "util/find_uid.h"
 #include "db/sysdb.h"
 #include "util/child_common.h"
+#include "util/probes.h"
 
 struct sss_sigchild_ctx {
     struct tevent_context *ev;
@@ -133,6 +134,8 @@ errno_t sss_child_register(TALLOC_CTX *mem_ctx,
     child->pvt = pvt;
     child->sigchld_ctx = sigchld_ctx;
 
+    PROBE(CHILD_START, pid);
+
     key.type = HASH_KEY_ULONG;
     key.ul = pid;
 
@@ -221,6 +224,7 @@ static void sss_child_handler(struct tevent_context *ev,
         error = hash_lookup(sigchld_ctx->children, &key, &value);
         if (error == HASH_SUCCESS) {
             child_ctx = talloc_get_type(value.ptr, struct sss_child_ctx);
+            PROBE(CHILD_EXIT, pid, wait_status);
 
             imm = tevent_create_immediate(child_ctx);
             if (imm == NULL) {
@@ -282,6 +286,7 @@ int child_handler_setup(struct tevent_context *ev, int pid,
 
     DEBUG(SSSDBG_TRACE_INTERNAL,
           "Setting up signal handler up for pid [%d]\n", pid);
+    PROBE(CHILD_START, pid);
 
     child_ctx = talloc_zero(ev, struct sss_child_ctx_old);
     if (child_ctx == NULL) {
@@ -578,6 +583,8 @@ static void child_sig_handler(struct tevent_context *ev,
             return;
         }
 
+        PROBE(CHILD_EXIT, ret, child_ctx->child_status);
+
         /* Invoke the callback in a tevent_immediate handler
          * so that it is safe to free the tevent_signal *
          */
@@ -763,6 +770,7 @@ void exec_child_ex(TALLOC_CTX *mem_ctx,
         exit(EXIT_FAILURE);
     }
 
+    PROBE(CHILD_EXEC, binary);
     execv(binary, argv);
     err = errno;
     DEBUG(SSSDBG_OP_FAILURE, "execv failed [%d][%s].\n", err, strerror(err));
@@ -25,6 +25,9 @@
 #include <stdarg.h>
 #include <stdlib.h>
 #include <fcntl.h>
+#if HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -45,6 +48,46 @@ int debug_to_file = 0;
 int debug_to_stderr = 0;
 const char *debug_log_file = "sssd";
 FILE *debug_file = NULL;
+int debug_recorder_level = 0;
+
+/* Size of the stack buffer a message is formatted into, longer messages
+ * are written directly to the log (and truncated in the flight recorder) */
+#define DEBUG_LINE_SIZE 4096
+
+/* Size of the output buffer used when debug_init_buffering() was called */
+#define DEBUG_BUFFER_SIZE (64 * 1024)
+
+/* Messages at these levels are written out immediately, even when the
+ * output is buffered, and trigger a dump of the flight recorder */
+#define DEBUG_FAILURE_LEVELS (SSSDBG_FATAL_FAILURE | \
+                              SSSDBG_CRIT_FAILURE | \
+                              SSSDBG_OP_FAILURE)
+
+/* SSSD processes run a single thread, none of the state below is locked.
+ * The buffers are written out before fork() and emptied in the child. */
+
+/* Timestamp up to the second is formatted only when the second changes,
+ * calling localtime() for every message is expensive. */
+static struct {
+    time_t sec;
+    int year;
+    char datetime[20];
+} debug_time_cache = { -1, 0, "" };
+
+/* Buffered output, flushed when full, when a failure is logged and
+ * periodically from the main loop, see server_setup(). */
+static char *debug_buffer = NULL;
+static size_t debug_buffer_used = 0;
+
+/* The flight recorder keeps the most recent messages that are not logged
+ * because of debug_level in a ring and writes them to the log only when a
+ * failure is logged. */
+static struct {
+    char *buf;
+    size_t size;
+    size_t pos;
+    bool wrapped;
+} debug_recorder = { NULL, 0, 0, false };
 
 errno_t set_debug_file_from_fd(const int fd)
 {
@@ -143,6 +186,262 @@ static void debug_printf(const char *format, ...)
     va_end(ap);
 }
 
+void debug_flush(void)
+{
+    if (debug_buffer_used > 0) {
+        fwrite(debug_buffer, 1, debug_buffer_used,
+               debug_file ? debug_file : stderr);
+        debug_buffer_used = 0;
+    }
+
+    debug_fflush();
+}
+
+static void debug_write(const char *data, size_t len)
+{
+    if (debug_buffer == NULL) {
+        fwrite(data, 1, len, debug_file ? debug_file : stderr);
+        return;
+    }
+
+    if (len > DEBUG_BUFFER_SIZE - debug_buffer_used) {
+        debug_flush();
+    }
+
+    if (len > DEBUG_BUFFER_SIZE) {
+        fwrite(data, 1, len, debug_file ? debug_file : stderr);
+        return;
+    }
+
+    memcpy(debug_buffer + debug_buffer_used, data, len);
+    debug_buffer_used += len;
+}
+
+#if HAVE_PTHREAD
+static void debug_atfork_child(void)
+{
+    debug_buffer_used = 0;
+    debug_recorder.pos = 0;
+    debug_recorder.wrapped = false;
+}
+#endif
+
+static void debug_atexit(void)
+{
+    debug_flush();
+}
+
+static errno_t debug_register_handlers(void)
+{
+    static bool registered = false;
+    int ret;
+
+    if (registered) {
+        return EOK;
+    }
+
+    /* make sure nothing is written twice by a forked child or lost
+     * at exit */
+#if HAVE_PTHREAD
+    ret = pthread_atfork(debug_flush, NULL, debug_atfork_child);
+    if (ret != 0) {
+        return ret;
+    }
+#endif
+
+    ret = atexit(debug_atexit);
+    if (ret != 0) {
+        return EIO;
+    }
+
+    registered = true;
+    return EOK;
+}
+
+errno_t debug_init_buffering(void)
+{
+    errno_t ret;
+
+    if (debug_buffer != NULL) {
+        return EOK;
+    }
+
+    ret = debug_register_handlers();
+    if (ret != EOK) {
+        return ret;
+    }
+
+    debug_buffer = malloc(DEBUG_BUFFER_SIZE);
+    if (debug_buffer == NULL) {
+        return ENOMEM;
+    }
+    debug_buffer_used = 0;
+
+    return EOK;
+}
+
+void debug_stop_buffering(void)
+{
+    debug_flush();
+    free(debug_buffer);
+    debug_buffer = NULL;
+}
+
+errno_t debug_init_flight_recorder(size_t size)
+{
+    char *buf = NULL;
+    errno_t ret;
+
+    if (size > 0) {
+        ret = debug_register_handlers();
+        if (ret != EOK) {
+            return ret;
+        }
+
+        buf = malloc(size);
+        if (buf == NULL) {
+            return ENOMEM;
+        }
+    }
+
+    free(debug_recorder.buf);
+    debug_recorder.buf = buf;
+    debug_recorder.size = size;
+    debug_recorder.pos = 0;
+    debug_recorder.wrapped = false;
+
+    debug_recorder_level = (buf == NULL) ? 0 : SSSDBG_MASK_ALL;
+
+    return EOK;
+}
+
+static void debug_recorder_add(const char *data, size_t len)
+{
+    size_t n;
+
+    if (len > debug_recorder.size) {
+        data += len - debug_recorder.size;
+        len = debug_recorder.size;
+    }
+
+    n = debug_recorder.size - debug_recorder.pos;
+    if (n > len) {
+        n = len;
+    }
+    memcpy(debug_recorder.buf + debug_recorder.pos, data, n);
+    debug_recorder.pos += n;
+
+    if (n < len) {
+        memcpy(debug_recorder.buf, data + n, len - n);
+        debug_recorder.pos = len - n;
+        debug_recorder.wrapped = true;
+    } else if (debug_recorder.pos == debug_recorder.size) {
+        debug_recorder.pos = 0;
+        debug_recorder.wrapped = true;
+    }
+}
+
+#define DEBUG_RECORDER_BEGIN "***** Begin of flight recorder messages *****\n"
+#define DEBUG_RECORDER_END "***** End of flight recorder messages *****\n"
+
+static void debug_recorder_dump(void)
+{
+    char *buf = debug_recorder.buf;
+    size_t size = debug_recorder.size;
+    size_t pos = debug_recorder.pos;
+    char *start;
+
+    if (buf == NULL || (pos == 0 && !debug_recorder.wrapped)) {
+        return;
+    }
+
+    debug_write(DEBUG_RECORDER_BEGIN, sizeof(DEBUG_RECORDER_BEGIN) - 1);
+
+    if (debug_recorder.wrapped) {
+        /* the oldest message was partially overwritten, skip it */
+        start = memchr(buf + pos, '\n', size - pos);
+        if (start != NULL) {
+            start++;
+            debug_write(start, buf + size - start);
+            debug_write(buf, pos);
+        } else {
+            start = memchr(buf, '\n', pos);
+            if (start != NULL) {
+                start++;
+                debug_write(start, buf + pos - start);
+            }
+        }
+    } else {
+        debug_write(buf, pos);
+    }
+
+    debug_write(DEBUG_RECORDER_END, sizeof(DEBUG_RECORDER_END) - 1);
+
+    debug_recorder.pos = 0;
+    debug_recorder.wrapped = false;
+}
+
+/* same format as ctime() without the year, which is printed separately */
+static void debug_update_time_cache(time_t sec)
+{
+    static const char *days[] = { "Sun", "Mon", "Tue", "Wed",
+                                  "Thu", "Fri", "Sat" };
+    static const char *months[] = { "Jan", "Feb", "Mar", "Apr",
+                                    "May", "Jun", "Jul", "Aug",
+                                    "Sep", "Oct", "Nov", "Dec" };
+    struct tm *tm;
+
+    tm = localtime(&sec);
+    if (tm == NULL) {
+        return;
+    }
+
+    snprintf(debug_time_cache.datetime, sizeof(debug_time_cache.datetime),
+             "%.3s %.3s%3d %.2d:%.2d:%.2d",
+             days[tm->tm_wday], months[tm->tm_mon], tm->tm_mday,
+             tm->tm_hour, tm->tm_min, tm->tm_sec);
+    debug_time_cache.year = tm->tm_year + 1900;
+    debug_time_cache.sec = sec;
+}
+
+static size_t debug_format_prefix(char *buf, size_t size,
+                                  const char *function, int level)
+{
+    struct timeval tv;
+    int ret;
+
+    if (debug_timestamps) {
+        gettimeofday(&tv, NULL);
+        if (tv.tv_sec != debug_time_cache.sec) {
+            debug_update_time_cache(tv.tv_sec);
+        }
+
+        if (debug_microseconds) {
+            ret = snprintf(buf, size, "(%s:%.6ld %d) [%s] [%s] (%#.4x): ",
+                           debug_time_cache.datetime, (long)tv.tv_usec,
+                           debug_time_cache.year, debug_prg_name,
+                           function, level);
+        } else {
+            ret = snprintf(buf, size, "(%s %d) [%s] [%s] (%#.4x): ",
+                           debug_time_cache.datetime, debug_time_cache.year,
+                           debug_prg_name, function, level);
+        }
+    } else {
+        ret = snprintf(buf, size, "[%s] [%s] (%#.4x): ",
+                       debug_prg_name, function, level);
+    }
+
+    if (ret < 0) {
+        return 0;
+    }
+
+    if (ret >= size) {
+        return size - 1;
+    }
+
+    return ret;
+}
+
 #ifdef WITH_JOURNALD
 errno_t journal_send(const char *file,
         long line,
@@ -214,16 +513,28 @@ void sss_vdebug_fn(const char *file,
                    const char *format,
                    va_list ap)
 {
-    struct timeval tv;
-    struct tm *tm;
-    char datetime[20];
-    int year;
+    char msg[DEBUG_LINE_SIZE];
+    va_list ap_msg;
+    size_t len;
+    bool logged;
+    int ret;
 
 #ifdef WITH_JOURNALD
-    errno_t ret;
     va_list ap_fallback;
+#endif
+
+    /* Only messages that are here just because of the flight recorder are
+     * kept in memory, everything else is logged as it always was. */
+    logged = DEBUG_IS_LOGGED(level) || !(debug_recorder_level & level);
+
+    if (logged && (level & DEBUG_FAILURE_LEVELS)) {
+        /* show what led to the failure first */
+        debug_recorder_dump();
+        debug_flush();
+    }
 
-    if (!debug_file && !debug_to_stderr) {
+#ifdef WITH_JOURNALD
+    if (logged && !debug_file && !debug_to_stderr) {
         /* If we are not outputting logs to files, we should be sending them
          * to journald.
          * NOTE: on modern systems, this is where stdout/stderr will end up
@@ -243,33 +554,47 @@ void sss_vdebug_fn(const char *file,
     }
 #endif
 
-    if (debug_timestamps) {
-        gettimeofday(&tv, NULL);
-        tm = localtime(&tv.tv_sec);
-        year = tm->tm_year + 1900;
-        /* get date time without year */
-        memcpy(datetime, ctime(&tv.tv_sec), 19);
-        datetime[19] = '\0';
-        if (debug_microseconds) {
-            debug_printf("(%s:%.6ld %d) [%s] [%s] (%#.4x): ",
-                         datetime, tv.tv_usec,
-                         year, debug_prg_name,
-                         function, level);
-        } else {
-            debug_printf("(%s %d) [%s] [%s] (%#.4x): ",
-                         datetime, year,
-                         debug_prg_name, function, level);
+    len = debug_format_prefix(msg, sizeof(msg), function, level);
+
+    va_copy(ap_msg, ap);
+    ret = vsnprintf(msg + len, sizeof(msg) - len, format, ap_msg);
+    va_end(ap_msg);
+    if (ret < 0) {
+        return;
+    }
+
+    /* leave room for the line feed */
+    if ((size_t)ret >= sizeof(msg) - len - 1) {
+        if (logged) {
+            /* too long for the message buffer, write it directly */
+            debug_flush();
+            fwrite(msg, 1, len, debug_file ? debug_file : stderr);
+            debug_vprintf(format, ap);
+            if (flags & APPEND_LINE_FEED) {
+                debug_printf("\n");
+            }
+            debug_fflush();
+            return;
         }
+
+        len = sizeof(msg) - 1;
+        msg[len - 1] = '\n';
     } else {
-        debug_printf("[%s] [%s] (%#.4x): ",
-                     debug_prg_name, function, level);
+        len += ret;
+        if (flags & APPEND_LINE_FEED) {
+            msg[len++] = '\n';
+        }
     }
 
-    debug_vprintf(format, ap);
-    if (flags & APPEND_LINE_FEED) {
-        debug_printf("\n");
+    if (!logged) {
+        debug_recorder_add(msg, len);
+        return;
+    }
+
+    debug_write(msg, len);
+    if (debug_buffer == NULL || (level & DEBUG_FAILURE_LEVELS)) {
+        debug_flush();
     }
-    debug_fflush();
 }
 
 void sss_debug_fn(const char *file,
@@ -372,7 +697,10 @@ int open_debug_file_ex(const char *filename, FILE **filep, bool want_cloexec)
         return ENOMEM;
     }
 
-    if (debug_file && !filep) fclose(debug_file);
+    if (debug_file && !filep) {
+        debug_flush();
+        fclose(debug_file);
+    }
 
     old_umask = umask(SSS_DFL_UMASK);
     errno = 0;
@@ -418,6 +746,8 @@ int rotate_debug_files(void)
 
     if (!debug_to_file) return EOK;
 
+    debug_flush();
+
     do {
         error = 0;
         ret = fclose(debug_file);
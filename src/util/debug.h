@@ -38,6 +38,7 @@ extern int debug_microseconds;
 extern int debug_to_file;
 extern int debug_to_stderr;
 extern const char *debug_log_file;
+extern int debug_recorder_level;
 void sss_vdebug_fn(const char *file,
                    long line,
                    const char *function,
@@ -51,6 +52,17 @@ void sss_debug_fn(const char *file,
                   int level,
                   const char *format, ...) SSS_ATTRIBUTE_PRINTF(5, 6);
 int debug_convert_old_level(int old_level);
+
+/* Buffer debug output in memory, it is written when the buffer is full,
+ * when a failure is logged or when debug_flush() is called. */
+errno_t debug_init_buffering(void);
+void debug_stop_buffering(void);
+void debug_flush(void);
+
+/* Keep the last size bytes of messages which are not enabled by
+ * debug_level in memory and write them to the log when a failure
+ * (SSSDBG_OP_FAILURE or worse) is logged. 0 disables the recorder. */
+errno_t debug_init_flight_recorder(size_t size);
 errno_t set_debug_file_from_fd(const int fd);
 int get_fd_from_debug_file(void);
 
@@ -109,16 +121,25 @@ int get_fd_from_debug_file(void);
     } \
 } while (0)
 
-/** \def DEBUG_IS_SET(level)
+/** \def DEBUG_IS_LOGGED(level)
     \brief checks whether level is set in debug_level
 
     \param level the debug level, please use one of the SSSDBG*_ macros
 */
-#define DEBUG_IS_SET(level) (debug_level & (level) || \
+#define DEBUG_IS_LOGGED(level) (debug_level & (level) || \
                             (debug_level == SSSDBG_UNRESOLVED && \
                                             (level & (SSSDBG_FATAL_FAILURE | \
                                                       SSSDBG_CRIT_FAILURE))))
 
+/** \def DEBUG_IS_SET(level)
+    \brief checks whether messages of level are logged or kept by the
+           flight recorder
+
+    \param level the debug level, please use one of the SSSDBG*_ macros
+*/
+#define DEBUG_IS_SET(level) (DEBUG_IS_LOGGED(level) || \
+                             (debug_recorder_level & (level)))
+
 #define DEBUG_INIT(dbg_lvl) do { \
     if (dbg_lvl != SSSDBG_INVALID) { \
         debug_level = debug_convert_old_level(dbg_lvl); \
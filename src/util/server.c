@@ -31,6 +31,7 @@
 #include <signal.h>
 #include <ldb.h>
 #include "util/util.h"
+#include "util/sss_stats.h"
 #include "confdb/confdb.h"
 #include "monitor/monitor_interfaces.h"
 
@@ -397,6 +398,9 @@ errno_t server_common_rotate_logs(struct confdb_ctx *confdb,
         return ret;
     }
 
+    /* sss_debuglevel modifies the confdb before sending SIGHUP */
+    confdb_refresh_snapshot(confdb);
+
     /* Get new debug level from the confdb */
     ret = confdb_get_int(confdb, conf_path,
                          CONFDB_SERVICE_DEBUG_LEVEL,
@@ -444,6 +448,84 @@ static const char *get_pid_path(void)
 #endif
 }
 
+struct debug_flush_ctx {
+    int interval;
+};
+
+static void debug_flush_handler(struct tevent_context *ev,
+                                struct tevent_timer *te,
+                                struct timeval current_time,
+                                void *pvt)
+{
+    struct debug_flush_ctx *fctx;
+    struct timeval tv;
+
+    fctx = talloc_get_type(pvt, struct debug_flush_ctx);
+
+    debug_flush();
+
+    tv = tevent_timeval_current_ofs(fctx->interval, 0);
+    te = tevent_add_timer(ev, fctx, tv, debug_flush_handler, fctx);
+    if (te == NULL) {
+        /* flush after every message again rather than losing output */
+        debug_stop_buffering();
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to schedule debug flush, "
+              "debug output will not be buffered anymore\n");
+    }
+}
+
+static errno_t setup_debug_buffering(struct main_context *ctx,
+                                     const char *conf_entry)
+{
+    struct debug_flush_ctx *fctx;
+    struct tevent_timer *te;
+    struct timeval tv;
+    int recorder_size;
+    int interval;
+    errno_t ret;
+
+    ret = confdb_get_int(ctx->confdb_ctx, conf_entry,
+                         CONFDB_SERVICE_DEBUG_RECORDER_SIZE,
+                         0, &recorder_size);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    if (recorder_size > 0) {
+        /* the option is in KiB */
+        ret = debug_init_flight_recorder((size_t)recorder_size * 1024);
+        if (ret != EOK) {
+            return ret;
+        }
+    }
+
+    ret = confdb_get_int(ctx->confdb_ctx, conf_entry,
+                         CONFDB_SERVICE_DEBUG_FLUSH_INTERVAL,
+                         0, &interval);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    if (interval <= 0) {
+        return EOK;
+    }
+
+    fctx = talloc_zero(ctx, struct debug_flush_ctx);
+    if (fctx == NULL) {
+        return ENOMEM;
+    }
+    fctx->interval = interval;
+
+    tv = tevent_timeval_current_ofs(interval, 0);
+    te = tevent_add_timer(ctx->event_ctx, fctx, tv, debug_flush_handler, fctx);
+    if (te == NULL) {
+        talloc_free(fctx);
+        return ENOMEM;
+    }
+
+    return debug_init_buffering();
+}
+
 int server_setup(const char *name, int flags,
                  uid_t uid, gid_t gid,
                  const char *conf_entry,
@@ -549,13 +631,6 @@ int server_setup(const char *name, int flags,
         return EIO;
     }
 
-    /* Set up an event handler for a SIGTERM */
-    tes = tevent_add_signal(event_ctx, event_ctx, SIGTERM, 0,
-                            default_quit, NULL);
-    if (tes == NULL) {
-        return EIO;
-    }
-
     ctx = talloc(event_ctx, struct main_context);
     if (ctx == NULL) {
         DEBUG(SSSDBG_FATAL_FAILURE, "Out of memory, aborting!\n");
@@ -565,6 +640,13 @@ int server_setup(const char *name, int flags,
     ctx->parent_pid = getppid();
     ctx->event_ctx = event_ctx;
 
+    /* Set up an event handler for a SIGTERM */
+    ctx->sigterm = tevent_add_signal(event_ctx, event_ctx, SIGTERM, 0,
+                                     default_quit, NULL);
+    if (ctx->sigterm == NULL) {
+        return EIO;
+    }
+
     conf_db = talloc_asprintf(ctx, "%s/%s",
                               get_db_path(), CONFDB_FILE);
     if (conf_db == NULL) {
@@ -671,6 +753,13 @@ int server_setup(const char *name, int flags,
         }
     }
 
+    ret = setup_debug_buffering(ctx, conf_entry);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE, "Error setting up debug buffering (%d) "
+                                     "[%s]\n", ret, strerror(ret));
+        return ret;
+    }
+
     /* Setup the internal watchdog */
     ret = confdb_get_int(ctx->confdb_ctx, conf_entry,
                          CONFDB_DOMAIN_TIMEOUT,
@@ -689,6 +778,13 @@ int server_setup(const char *name, int flags,
         }
     }
 
+    /* Statistics are not essential, the process works without them */
+    ret = sss_stats_init(DB_PATH, name);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unable to set up statistics [%d]: %s\n",
+              ret, sss_strerror(ret));
+    }
+
     sss_log(SSS_LOG_INFO, "Starting up");
 
     DEBUG(SSSDBG_TRACE_FUNC, "CONFDB: %s\n", conf_db);
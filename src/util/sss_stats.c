@@ -0,0 +1,915 @@
+/*
+    SSSD
+
+    Latency histograms and counters
+
+    Copyright (C) 2017 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "util/util.h"
+#include "util/sss_stats.h"
+
+/*
+ * The file starts with a header followed by struct sss_stats_data. The
+ * file is only read by processes built from the same sources, all
+ * integers are in host byte order. Bump the version whenever a histogram
+ * or a counter is added.
+ */
+
+#define SSS_STATS_MAGIC 0x53535354 /* SSST */
+#define SSS_STATS_VERSION 2
+#define SSS_STATS_NAME_LEN 64
+
+#define SSS_STATS_SUB_BITS 3
+
+struct sss_stats_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t pid;
+    int64_t started;
+    char name[SSS_STATS_NAME_LEN];
+};
+
+struct sss_stats_file {
+    struct sss_stats_header hdr;
+    struct sss_stats_data data;
+};
+
+static const struct {
+    const char *name;
+    const char *description;
+} sss_stats_hists[] = {
+    { "cache_req", "Time to resolve a responder request" },
+    { "cache_req_ncache", "Time to check the negative cache" },
+    { "cache_req_sysdb", "Time to look up an object in the cache" },
+    { "cache_req_dp", "Time to refresh an object through the data provider" },
+    { "dp_req", "Time to process a data provider request" },
+    { "dp_req_queue", "Time a data provider request waited for execution" },
+    { "sdap_search", "Time of an LDAP search including all pages" },
+    { "sysdb_transaction", "Time a sysdb transaction was held open" },
+};
+
+static const struct {
+    const char *name;
+    const char *description;
+} sss_stats_counters[] = {
+    { "ncache_hit", "Lookups answered by the negative cache" },
+    { "cache_valid", "Lookups answered by a valid cache entry" },
+    { "cache_midpoint", "Lookups that triggered a midpoint refresh" },
+    { "cache_expired", "Lookups that required a data provider request" },
+    { "dp_req_shed", "Data provider requests refused because of overload" },
+};
+
+/* Values are recorded in process memory until sss_stats_init() is called */
+static struct sss_stats_data sss_stats_local;
+static struct sss_stats_data *sss_stats = &sss_stats_local;
+static struct sss_stats_file *sss_stats_map;
+
+uint64_t sss_stats_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+unsigned int sss_stats_bucket(uint64_t value)
+{
+    unsigned int exp;
+
+    if (value < SSS_STATS_SUB_BUCKETS) {
+        return value;
+    }
+
+    if ((value >> SSS_STATS_MAX_EXP) != 0) {
+        return SSS_STATS_BUCKETS - 1;
+    }
+
+    /* position of the highest bit, the next SSS_STATS_SUB_BITS bits
+     * select the bucket inside the power of two */
+    exp = 63 - __builtin_clzll(value);
+
+    return SSS_STATS_SUB_BUCKETS * (exp - SSS_STATS_SUB_BITS + 1)
+           + ((value >> (exp - SSS_STATS_SUB_BITS))
+              & (SSS_STATS_SUB_BUCKETS - 1));
+}
+
+uint64_t sss_stats_bucket_upper(unsigned int idx)
+{
+    unsigned int exp;
+    unsigned int sub;
+
+    if (idx < SSS_STATS_SUB_BUCKETS) {
+        return idx;
+    }
+
+    if (idx >= SSS_STATS_BUCKETS - 1) {
+        return UINT64_MAX;
+    }
+
+    exp = idx / SSS_STATS_SUB_BUCKETS + SSS_STATS_SUB_BITS - 1;
+    sub = idx % SSS_STATS_SUB_BUCKETS;
+
+    return ((uint64_t) (SSS_STATS_SUB_BUCKETS + sub + 1)
+            << (exp - SSS_STATS_SUB_BITS)) - 1;
+}
+
+void sss_stats_record(enum sss_stats_hist_id id, uint64_t start, bool failed)
+{
+    struct sss_stats_hist *hist;
+    uint64_t value;
+    uint64_t now;
+
+    if (id >= SSS_STATS_HIST_SENTINEL || start == 0) {
+        return;
+    }
+
+    now = sss_stats_now();
+    value = now > start ? now - start : 0;
+
+    hist = &sss_stats->hists[id];
+    if (hist->count == 0 || value < hist->min) {
+        hist->min = value;
+    }
+    if (value > hist->max) {
+        hist->max = value;
+    }
+    hist->count++;
+    hist->sum += value;
+    if (failed) {
+        hist->errors++;
+    }
+    hist->buckets[sss_stats_bucket(value)]++;
+}
+
+void sss_stats_count(enum sss_stats_counter_id id)
+{
+    if (id >= SSS_STATS_COUNTER_SENTINEL) {
+        return;
+    }
+
+    sss_stats->counters[id]++;
+}
+
+const char *sss_stats_hist_name(enum sss_stats_hist_id id)
+{
+    if (id >= SSS_STATS_HIST_SENTINEL) {
+        return NULL;
+    }
+
+    return sss_stats_hists[id].name;
+}
+
+const char *sss_stats_hist_description(enum sss_stats_hist_id id)
+{
+    if (id >= SSS_STATS_HIST_SENTINEL) {
+        return NULL;
+    }
+
+    return sss_stats_hists[id].description;
+}
+
+const char *sss_stats_counter_name(enum sss_stats_counter_id id)
+{
+    if (id >= SSS_STATS_COUNTER_SENTINEL) {
+        return NULL;
+    }
+
+    return sss_stats_counters[id].name;
+}
+
+const char *sss_stats_counter_description(enum sss_stats_counter_id id)
+{
+    if (id >= SSS_STATS_COUNTER_SENTINEL) {
+        return NULL;
+    }
+
+    return sss_stats_counters[id].description;
+}
+
+uint64_t sss_stats_percentile(const struct sss_stats_hist *hist,
+                              double percent)
+{
+    uint64_t target;
+    uint64_t seen;
+    uint64_t upper;
+    unsigned int i;
+
+    if (hist->count == 0) {
+        return 0;
+    }
+
+    if (percent <= 0) {
+        return hist->min;
+    }
+
+    target = (uint64_t) (hist->count * percent / 100.0 + 0.5);
+    if (target == 0) {
+        target = 1;
+    }
+
+    seen = 0;
+    for (i = 0; i < SSS_STATS_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= target) {
+            upper = sss_stats_bucket_upper(i);
+            return upper < hist->max ? upper : hist->max;
+        }
+    }
+
+    return hist->max;
+}
+
+/* "sssd[be[example.com]]" is stored as "be[example.com]" in a file
+ * named stats_be_example.com.<pid>. Several processes can run under the
+ * same name, e.g. the proxy children of one domain, so every process has
+ * its own file. */
+static const char *sss_stats_short_name(TALLOC_CTX *mem_ctx,
+                                        const char *name)
+{
+    size_t len;
+
+    if (strncmp(name, "sssd[", 5) != 0) {
+        return talloc_strdup(mem_ctx, name);
+    }
+
+    name += 5;
+    len = strlen(name);
+    if (len > 0 && name[len - 1] == ']') {
+        len--;
+    }
+
+    return talloc_strndup(mem_ctx, name, len);
+}
+
+/* The path without the pid suffix */
+static char *sss_stats_base_path(TALLOC_CTX *mem_ctx,
+                                 const char *dir,
+                                 const char *short_name)
+{
+    char *path;
+    char *p;
+
+    path = talloc_asprintf(mem_ctx, "%s/"SSS_STATS_FILE_PREFIX, dir);
+    if (path == NULL) {
+        return NULL;
+    }
+
+    for (; *short_name != '\0'; short_name++) {
+        switch (*short_name) {
+        case ']':
+            continue;
+        case '[':
+        case '/':
+            path = talloc_asprintf_append_buffer(path, "_");
+            break;
+        default:
+            path = talloc_asprintf_append_buffer(path, "%c", *short_name);
+            break;
+        }
+        if (path == NULL) {
+            return NULL;
+        }
+    }
+
+    p = strrchr(path, '/');
+    if (p == NULL || strcmp(p + 1, SSS_STATS_FILE_PREFIX) == 0) {
+        talloc_free(path);
+        return NULL;
+    }
+
+    return path;
+}
+
+static char *sss_stats_path(TALLOC_CTX *mem_ctx,
+                            const char *dir,
+                            const char *short_name,
+                            pid_t pid)
+{
+    char *base;
+    char *path;
+
+    base = sss_stats_base_path(mem_ctx, dir, short_name);
+    if (base == NULL) {
+        return NULL;
+    }
+
+    path = talloc_asprintf(mem_ctx, "%s.%d", base, (int)pid);
+    talloc_free(base);
+
+    return path;
+}
+
+static bool sss_stats_pid_running(pid_t pid)
+{
+    return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+/* Remove the files of processes with the same name that did not exit
+ * cleanly, otherwise they would pile up with every restart */
+static void sss_stats_remove_stale(const char *base_path)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct dirent *dent;
+    const char *base_name;
+    char *dir;
+    char *path;
+    char *endptr;
+    size_t len;
+    long pid;
+    DIR *d;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return;
+    }
+
+    base_name = strrchr(base_path, '/') + 1;
+    len = strlen(base_name);
+    dir = talloc_strndup(tmp_ctx, base_path, base_name - base_path - 1);
+    if (dir == NULL) {
+        goto done;
+    }
+
+    d = opendir(dir);
+    if (d == NULL) {
+        goto done;
+    }
+
+    while ((dent = readdir(d)) != NULL) {
+        if (strncmp(dent->d_name, base_name, len) != 0
+                || dent->d_name[len] != '.') {
+            continue;
+        }
+
+        errno = 0;
+        pid = strtol(dent->d_name + len + 1, &endptr, 10);
+        if (errno != 0 || *endptr != '\0' || pid <= 0
+                || pid == getpid() || sss_stats_pid_running(pid)) {
+            continue;
+        }
+
+        path = talloc_asprintf(tmp_ctx, "%s/%s", dir, dent->d_name);
+        if (path == NULL) {
+            break;
+        }
+
+        DEBUG(SSSDBG_TRACE_FUNC, "Removing stale [%s]\n", path);
+        unlink(path);
+        talloc_free(path);
+    }
+
+    closedir(d);
+
+done:
+    talloc_free(tmp_ctx);
+}
+
+/* Malloc'ed so that it outlives any talloc hierarchy freed before exit */
+static char *sss_stats_map_path;
+
+static void sss_stats_atexit(void)
+{
+    /* A forked child that did not exec inherits the handler but not
+     * the file */
+    if (sss_stats_map == NULL || sss_stats_map_path == NULL
+            || sss_stats_map->hdr.pid != getpid()) {
+        return;
+    }
+
+    unlink(sss_stats_map_path);
+}
+
+errno_t sss_stats_init(const char *dir, const char *name)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sss_stats_file *map = MAP_FAILED;
+    const char *short_name;
+    char *base_path;
+    char *tmp_path;
+    char *path;
+    char *map_path = NULL;
+    errno_t ret;
+    int fd = -1;
+
+    if (sss_stats_map != NULL) {
+        return EOK;
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    short_name = sss_stats_short_name(tmp_ctx, name);
+    if (short_name == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    if (strlen(short_name) >= SSS_STATS_NAME_LEN) {
+        ret = EINVAL;
+        goto done;
+    }
+
+    base_path = sss_stats_base_path(tmp_ctx, dir, short_name);
+    if (base_path == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    path = sss_stats_path(tmp_ctx, dir, short_name, getpid());
+    tmp_path = talloc_asprintf(tmp_ctx, "%s.XXXXXX", base_path);
+    if (path == NULL || tmp_path == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    map_path = strdup(path);
+    if (map_path == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    sss_stats_remove_stale(base_path);
+
+    fd = sss_unique_file(tmp_ctx, tmp_path, &ret);
+    if (fd == -1) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Cannot create [%s] [%d]: %s\n", tmp_path, ret, sss_strerror(ret));
+        goto done;
+    }
+
+    ret = ftruncate(fd, sizeof(struct sss_stats_file));
+    if (ret == -1) {
+        ret = errno;
+        goto done;
+    }
+
+    map = mmap(NULL, sizeof(struct sss_stats_file), PROT_READ | PROT_WRITE,
+               MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        ret = errno;
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Cannot map [%s] [%d]: %s\n", tmp_path, ret, sss_strerror(ret));
+        goto done;
+    }
+
+    map->hdr.magic = SSS_STATS_MAGIC;
+    map->hdr.version = SSS_STATS_VERSION;
+    map->hdr.size = sizeof(struct sss_stats_file);
+    map->hdr.pid = getpid();
+    map->hdr.started = time(NULL);
+    strncpy(map->hdr.name, short_name, SSS_STATS_NAME_LEN - 1);
+    map->data = sss_stats_local;
+
+    ret = fchmod(fd, 0640);
+    if (ret == -1) {
+        ret = errno;
+        goto done;
+    }
+
+    ret = rename(tmp_path, path);
+    if (ret == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Cannot rename [%s] [%d]: %s\n", tmp_path, ret, sss_strerror(ret));
+        goto done;
+    }
+
+    sss_stats_map = map;
+    sss_stats = &map->data;
+    sss_stats_map_path = map_path;
+    map_path = NULL;
+
+    if (atexit(sss_stats_atexit) != 0) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Cannot register exit handler, [%s] will not be removed\n",
+              path);
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Recording statistics in [%s]\n", path);
+    ret = EOK;
+
+done:
+    if (fd != -1) {
+        close(fd);
+    }
+    free(map_path);
+    if (ret != EOK) {
+        if (map != MAP_FAILED) {
+            munmap(map, sizeof(struct sss_stats_file));
+        }
+        if (fd != -1) {
+            unlink(tmp_path);
+        }
+    }
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+/* ==Reading statistics of other processes================================ */
+
+static errno_t sss_stats_read_file(TALLOC_CTX *mem_ctx,
+                                   const char *dir,
+                                   const char *filename,
+                                   struct sss_stats_process **_proc)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sss_stats_process *proc;
+    struct sss_stats_file *file;
+    struct stat stat_buf;
+    const char *expected;
+    char *path;
+    ssize_t len;
+    errno_t ret;
+    int fd = -1;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    path = talloc_asprintf(tmp_ctx, "%s/%s", dir, filename);
+    file = talloc_zero(tmp_ctx, struct sss_stats_file);
+    proc = talloc_zero(tmp_ctx, struct sss_stats_process);
+    if (path == NULL || file == NULL || proc == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        ret = errno;
+        goto done;
+    }
+
+    ret = fstat(fd, &stat_buf);
+    if (ret == -1) {
+        ret = errno;
+        goto done;
+    }
+
+    if (stat_buf.st_size != sizeof(struct sss_stats_file)) {
+        ret = EINVAL;
+        goto done;
+    }
+
+    len = sss_atomic_read_s(fd, file, sizeof(struct sss_stats_file));
+    if (len != sizeof(struct sss_stats_file)) {
+        ret = len == -1 ? errno : EINVAL;
+        goto done;
+    }
+
+    if (file->hdr.magic != SSS_STATS_MAGIC
+            || file->hdr.version != SSS_STATS_VERSION
+            || file->hdr.size != sizeof(struct sss_stats_file)
+            || file->hdr.name[SSS_STATS_NAME_LEN - 1] != '\0') {
+        ret = EINVAL;
+        goto done;
+    }
+
+    /* Skips files that are still being created */
+    expected = sss_stats_path(tmp_ctx, dir, file->hdr.name, file->hdr.pid);
+    if (expected == NULL || strcmp(expected, path) != 0) {
+        ret = EINVAL;
+        goto done;
+    }
+
+    proc->name = talloc_strdup(proc, file->hdr.name);
+    if (proc->name == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+    proc->pid = file->hdr.pid;
+    proc->num_processes = 1;
+    proc->started = file->hdr.started;
+    proc->running = sss_stats_pid_running(proc->pid);
+    proc->data = file->data;
+
+    *_proc = talloc_steal(mem_ctx, proc);
+    ret = EOK;
+
+done:
+    if (fd != -1) {
+        close(fd);
+    }
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static int sss_stats_process_cmp(const void *a, const void *b)
+{
+    const struct sss_stats_process *pa;
+    const struct sss_stats_process *pb;
+    int ret;
+
+    pa = *(struct sss_stats_process * const *) a;
+    pb = *(struct sss_stats_process * const *) b;
+
+    ret = strcmp(pa->name, pb->name);
+    if (ret != 0) {
+        return ret;
+    }
+
+    /* running processes first */
+    if (pa->running != pb->running) {
+        return pa->running ? -1 : 1;
+    }
+
+    return (int)pa->pid - (int)pb->pid;
+}
+
+static void sss_stats_merge_hist(struct sss_stats_hist *dst,
+                                 const struct sss_stats_hist *src)
+{
+    unsigned int i;
+
+    if (src->count == 0) {
+        return;
+    }
+
+    if (dst->count == 0 || src->min < dst->min) {
+        dst->min = src->min;
+    }
+    if (src->max > dst->max) {
+        dst->max = src->max;
+    }
+    dst->count += src->count;
+    dst->errors += src->errors;
+    dst->sum += src->sum;
+
+    for (i = 0; i < SSS_STATS_BUCKETS; i++) {
+        dst->buckets[i] += src->buckets[i];
+    }
+}
+
+static void sss_stats_merge(struct sss_stats_process *dst,
+                            const struct sss_stats_process *src)
+{
+    unsigned int i;
+
+    for (i = 0; i < SSS_STATS_HIST_SENTINEL; i++) {
+        sss_stats_merge_hist(&dst->data.hists[i], &src->data.hists[i]);
+    }
+
+    for (i = 0; i < SSS_STATS_COUNTER_SENTINEL; i++) {
+        dst->data.counters[i] += src->data.counters[i];
+    }
+
+    if (src->started < dst->started) {
+        dst->started = src->started;
+    }
+    dst->num_processes += src->num_processes;
+}
+
+/* Sum up the statistics of processes with the same name that are all
+ * running or all exited, @procs must be sorted */
+static size_t sss_stats_aggregate(struct sss_stats_process **procs,
+                                  size_t num)
+{
+    size_t out;
+    size_t i;
+
+    if (num == 0) {
+        return 0;
+    }
+
+    out = 0;
+    for (i = 1; i < num; i++) {
+        if (strcmp(procs[out]->name, procs[i]->name) == 0
+                && procs[out]->running == procs[i]->running) {
+            sss_stats_merge(procs[out], procs[i]);
+            talloc_free(procs[i]);
+            continue;
+        }
+
+        out++;
+        procs[out] = procs[i];
+    }
+
+    out++;
+    procs[out] = NULL;
+    return out;
+}
+
+errno_t sss_stats_read(TALLOC_CTX *mem_ctx,
+                       const char *dir,
+                       struct sss_stats_process ***_procs)
+{
+    struct sss_stats_process **procs;
+    struct sss_stats_process **tmp;
+    struct dirent *dent;
+    size_t num = 0;
+    errno_t ret;
+    DIR *d;
+
+    d = opendir(dir);
+    if (d == NULL) {
+        ret = errno;
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Cannot open [%s] [%d]: %s\n", dir, ret, sss_strerror(ret));
+        return ret;
+    }
+
+    procs = talloc_zero_array(mem_ctx, struct sss_stats_process *, 1);
+    if (procs == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    while ((dent = readdir(d)) != NULL) {
+        if (strncmp(dent->d_name, SSS_STATS_FILE_PREFIX,
+                    sizeof(SSS_STATS_FILE_PREFIX) - 1) != 0) {
+            continue;
+        }
+
+        tmp = talloc_realloc(mem_ctx, procs, struct sss_stats_process *,
+                             num + 2);
+        if (tmp == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+        procs = tmp;
+
+        ret = sss_stats_read_file(procs, dir, dent->d_name, &procs[num]);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_TRACE_FUNC, "Skipping [%s] [%d]: %s\n",
+                  dent->d_name, ret, sss_strerror(ret));
+            continue;
+        }
+
+        num++;
+        procs[num] = NULL;
+    }
+
+    qsort(procs, num, sizeof(struct sss_stats_process *),
+          sss_stats_process_cmp);
+    sss_stats_aggregate(procs, num);
+
+    *_procs = procs;
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        talloc_free(procs);
+    }
+    closedir(d);
+    return ret;
+}
+
+/* ==Prometheus text format=============================================== */
+
+/* Prometheus buckets are powers of four from 16 us to about 67 s, they
+ * coincide with bucket boundaries of the histograms */
+#define SSS_STATS_PROM_FIRST_EXP 4
+#define SSS_STATS_PROM_LAST_EXP 26
+#define SSS_STATS_PROM_STEP 2
+
+#define SSS_STATS_SECONDS_FMT "%"PRIu64".%06"PRIu64
+#define SSS_STATS_SECONDS(usec) (usec) / 1000000, (usec) % 1000000
+
+static char *sss_stats_prometheus_hist(char *out,
+                                       enum sss_stats_hist_id id,
+                                       struct sss_stats_process **procs)
+{
+    const struct sss_stats_hist *hist;
+    const char *name = sss_stats_hist_name(id);
+    uint64_t cumulative;
+    uint64_t limit;
+    unsigned int exp;
+    unsigned int b;
+    size_t i;
+
+    out = talloc_asprintf_append_buffer(out,
+                    "# HELP sssd_%s_seconds %s\n"
+                    "# TYPE sssd_%s_seconds histogram\n",
+                    name, sss_stats_hist_description(id), name);
+
+    for (i = 0; out != NULL && procs[i] != NULL; i++) {
+        if (!procs[i]->running) {
+            continue;
+        }
+
+        hist = &procs[i]->data.hists[id];
+        cumulative = 0;
+        b = 0;
+        for (exp = SSS_STATS_PROM_FIRST_EXP;
+             out != NULL && exp <= SSS_STATS_PROM_LAST_EXP;
+             exp += SSS_STATS_PROM_STEP) {
+            limit = 1ULL << exp;
+            for (; b < SSS_STATS_BUCKETS
+                   && sss_stats_bucket_upper(b) < limit; b++) {
+                cumulative += hist->buckets[b];
+            }
+
+            out = talloc_asprintf_append_buffer(out,
+                    "sssd_%s_seconds_bucket{process=\"%s\",le=\""
+                    SSS_STATS_SECONDS_FMT"\"} %"PRIu64"\n",
+                    name, procs[i]->name, SSS_STATS_SECONDS(limit),
+                    cumulative);
+        }
+
+        if (out == NULL) {
+            break;
+        }
+
+        out = talloc_asprintf_append_buffer(out,
+                "sssd_%s_seconds_bucket{process=\"%s\",le=\"+Inf\"} %"PRIu64"\n"
+                "sssd_%s_seconds_sum{process=\"%s\"} "SSS_STATS_SECONDS_FMT"\n"
+                "sssd_%s_seconds_count{process=\"%s\"} %"PRIu64"\n",
+                name, procs[i]->name, hist->count,
+                name, procs[i]->name, SSS_STATS_SECONDS(hist->sum),
+                name, procs[i]->name, hist->count);
+    }
+
+    if (out == NULL) {
+        return NULL;
+    }
+
+    out = talloc_asprintf_append_buffer(out,
+                    "# HELP sssd_%s_errors_total Failed operations\n"
+                    "# TYPE sssd_%s_errors_total counter\n",
+                    name, name);
+
+    for (i = 0; out != NULL && procs[i] != NULL; i++) {
+        if (!procs[i]->running) {
+            continue;
+        }
+
+        out = talloc_asprintf_append_buffer(out,
+                    "sssd_%s_errors_total{process=\"%s\"} %"PRIu64"\n",
+                    name, procs[i]->name, procs[i]->data.hists[id].errors);
+    }
+
+    return out;
+}
+
+static char *sss_stats_prometheus_counter(char *out,
+                                          enum sss_stats_counter_id id,
+                                          struct sss_stats_process **procs)
+{
+    const char *name = sss_stats_counter_name(id);
+    size_t i;
+
+    out = talloc_asprintf_append_buffer(out,
+                    "# HELP sssd_%s_total %s\n"
+                    "# TYPE sssd_%s_total counter\n",
+                    name, sss_stats_counter_description(id), name);
+
+    for (i = 0; out != NULL && procs[i] != NULL; i++) {
+        if (!procs[i]->running) {
+            continue;
+        }
+
+        out = talloc_asprintf_append_buffer(out,
+                    "sssd_%s_total{process=\"%s\"} %"PRIu64"\n",
+                    name, procs[i]->name, procs[i]->data.counters[id]);
+    }
+
+    return out;
+}
+
+char *sss_stats_prometheus(TALLOC_CTX *mem_ctx,
+                           struct sss_stats_process **procs)
+{
+    char *out;
+    int id;
+
+    out = talloc_strdup(mem_ctx, "");
+
+    for (id = 0; out != NULL && id < SSS_STATS_HIST_SENTINEL; id++) {
+        out = sss_stats_prometheus_hist(out, id, procs);
+    }
+
+    for (id = 0; out != NULL && id < SSS_STATS_COUNTER_SENTINEL; id++) {
+        out = sss_stats_prometheus_counter(out, id, procs);
+    }
+
+    return out;
+}
@@ -0,0 +1,156 @@
+/*
+    SSSD
+
+    Latency histograms and counters
+
+    Copyright (C) 2017 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _SSS_STATS_H_
+#define _SSS_STATS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/types.h>
+#include <talloc.h>
+
+#include "util/util_errors.h"
+
+/*
+ * Every SSSD process keeps its statistics in a file in the database
+ * directory that it maps into memory, so that recording a value is a few
+ * memory writes and the statistics can be read by other processes without
+ * asking the process itself.
+ *
+ * Latencies are recorded in microseconds into log-linear histograms: values
+ * below 8 have a bucket each, larger values are split into 8 buckets per
+ * power of two. The relative error of a reported percentile is therefore
+ * at most 12.5%.
+ */
+
+#define SSS_STATS_FILE_PREFIX "stats_"
+
+#define SSS_STATS_SUB_BUCKETS 8
+/* The last bucket also holds all values of 2^37 us (about 38 hours) and
+ * more */
+#define SSS_STATS_MAX_EXP 37
+#define SSS_STATS_BUCKETS \
+    (SSS_STATS_SUB_BUCKETS * (SSS_STATS_MAX_EXP - 2))
+
+enum sss_stats_hist_id {
+    /* responders */
+    SSS_STATS_CACHE_REQ,
+    SSS_STATS_CACHE_REQ_NCACHE,
+    SSS_STATS_CACHE_REQ_SYSDB,
+    SSS_STATS_CACHE_REQ_DP,
+    /* backends */
+    SSS_STATS_DP_REQ,
+    SSS_STATS_DP_REQ_QUEUE,
+    SSS_STATS_SDAP_SEARCH,
+    /* all processes */
+    SSS_STATS_SYSDB_TRANSACTION,
+
+    SSS_STATS_HIST_SENTINEL
+};
+
+enum sss_stats_counter_id {
+    SSS_STATS_NCACHE_HIT,
+    SSS_STATS_CACHE_VALID,
+    SSS_STATS_CACHE_MIDPOINT,
+    SSS_STATS_CACHE_EXPIRED,
+    SSS_STATS_DP_REQ_SHED,
+
+    SSS_STATS_COUNTER_SENTINEL
+};
+
+struct sss_stats_hist {
+    uint64_t count;
+    /* number of recorded operations that failed */
+    uint64_t errors;
+    /* sum, min and max of all recorded values in microseconds */
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t buckets[SSS_STATS_BUCKETS];
+};
+
+struct sss_stats_data {
+    struct sss_stats_hist hists[SSS_STATS_HIST_SENTINEL];
+    uint64_t counters[SSS_STATS_COUNTER_SENTINEL];
+};
+
+/* Statistics of all processes with the same name as read by
+ * sss_stats_read() */
+struct sss_stats_process {
+    const char *name;
+    /* pid of one of the processes */
+    pid_t pid;
+    unsigned int num_processes;
+    /* start of the earliest process */
+    time_t started;
+    /* false if the processes that wrote the statistics have exited */
+    bool running;
+    struct sss_stats_data data;
+};
+
+/* Monotonic time in microseconds, the start of a recorded operation */
+uint64_t sss_stats_now(void);
+
+/* Record the time elapsed since @start */
+void sss_stats_record(enum sss_stats_hist_id id, uint64_t start, bool failed);
+
+void sss_stats_count(enum sss_stats_counter_id id);
+
+/*
+ * Move the statistics of this process into a shared file in @dir that is
+ * removed when the process exits. @name is the name passed to
+ * server_setup(), e.g. "sssd[nss]".
+ *
+ * Until this is called, or if it fails, values are only recorded in
+ * process memory.
+ */
+errno_t sss_stats_init(const char *dir, const char *name);
+
+const char *sss_stats_hist_name(enum sss_stats_hist_id id);
+const char *sss_stats_hist_description(enum sss_stats_hist_id id);
+const char *sss_stats_counter_name(enum sss_stats_counter_id id);
+const char *sss_stats_counter_description(enum sss_stats_counter_id id);
+
+unsigned int sss_stats_bucket(uint64_t value);
+
+/* The largest value that falls into bucket @idx */
+uint64_t sss_stats_bucket_upper(unsigned int idx);
+
+/* Estimate of the @percent-th percentile in microseconds, 0 if empty */
+uint64_t sss_stats_percentile(const struct sss_stats_hist *hist,
+                              double percent);
+
+/*
+ * Read the statistics of all processes from @dir. Processes that share a
+ * name are summed up into one entry, separately for the running and the
+ * exited ones. The result is a NULL terminated array sorted by process
+ * name with the running processes first.
+ */
+errno_t sss_stats_read(TALLOC_CTX *mem_ctx,
+                       const char *dir,
+                       struct sss_stats_process ***_procs);
+
+/* Format the statistics in the Prometheus text exposition format */
+char *sss_stats_prometheus(TALLOC_CTX *mem_ctx,
+                           struct sss_stats_process **procs);
+
+#endif /* _SSS_STATS_H_ */
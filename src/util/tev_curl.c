@@ -37,6 +37,14 @@
 #define TCURL_IOBUF_CHUNK   1024
 #define TCURL_IOBUF_MAX     4096
 
+/* Connections are kept open in the multi handle's connection cache after
+ * a transfer finishes and reused by the next transfer to the same
+ * destination. These limit the size of the cache and the number of
+ * parallel connections to a single host; transfers above the limit are
+ * queued by libcurl until a connection becomes available. */
+#define TCURL_MAX_CONNECTS          16
+#define TCURL_MAX_HOST_CONNECTIONS  8
+
 static bool global_is_curl_initialized;
 
 /**
@@ -59,6 +67,14 @@ struct tcurl_ctx {
      * the transfer's private data
      */
     CURLM *multi_handle;
+
+    /* TLS sessions are cached per easy handle unless they are shared */
+    CURLSH *share_handle;
+
+    /* Requests added to the multi handle that did not finish yet */
+    struct tcurl_request *pending;
+
+    struct tcurl_stats stats;
 };
 
 /**
@@ -71,9 +87,14 @@ struct tcurl_sock {
     struct tevent_fd *fde;      /* tevent tracker of the fd events */
 };
 
+struct tcurl_request;
+
 static void tcurl_request_done(struct tevent_req *req,
                                errno_t process_error,
                                int response_code);
+static void tcurl_request_detach(struct tcurl_request *tcurl_req);
+static void tcurl_request_terminate(struct tcurl_ctx *tctx,
+                                    struct tcurl_request *tcurl_req);
 
 static errno_t curl_code2errno(CURLcode crv)
 {
@@ -159,6 +180,11 @@ static errno_t tcurl_global_init(void)
     return EOK;
 }
 
+void tcurl_get_stats(struct tcurl_ctx *tctx, struct tcurl_stats *_stats)
+{
+    *_stats = tctx->stats;
+}
+
 static int curl2tev_flags(int curlflags)
 {
     int flags = 0;
@@ -178,7 +204,32 @@ static int curl2tev_flags(int curlflags)
     return flags;
 }
 
-static void handle_curlmsg_done(CURLMsg *message)
+static void tcurl_account_connection(struct tcurl_ctx *tctx,
+                                     CURL *easy_handle)
+{
+    long num_connects;
+    CURLcode crv;
+
+    tctx->stats.requests++;
+
+    crv = curl_easy_getinfo(easy_handle, CURLINFO_NUM_CONNECTS, &num_connects);
+    if (crv != CURLE_OK) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Cannot get CURLINFO_NUM_CONNECTS "
+              "[%d]: %s\n", crv, curl_easy_strerror(crv));
+        return;
+    }
+
+    if (num_connects == 0) {
+        tctx->stats.reused_connections++;
+        DEBUG(SSSDBG_TRACE_INTERNAL, "Transfer reused an existing connection\n");
+    } else {
+        tctx->stats.new_connections += num_connects;
+        DEBUG(SSSDBG_TRACE_INTERNAL, "Transfer opened %ld new connection(s)\n",
+              num_connects);
+    }
+}
+
+static void handle_curlmsg_done(struct tcurl_ctx *tctx, CURLMsg *message)
 {
     CURL *easy_handle;
     CURLcode crv;
@@ -219,6 +270,8 @@ static void handle_curlmsg_done(CURLMsg *message)
         goto done;
     }
 
+    tcurl_account_connection(tctx, easy_handle);
+
     /* If there was no fatal error, let's read the response code
      * and mark the request as done */
     crv = curl_easy_getinfo(easy_handle, CURLINFO_RESPONSE_CODE, &response_code);
@@ -242,7 +295,7 @@ static void process_curl_activity(struct tcurl_ctx *tctx)
     while ((message = curl_multi_info_read(tctx->multi_handle, &pending))) {
         switch (message->msg) {
         case CURLMSG_DONE:
-            handle_curlmsg_done(message);
+            handle_curlmsg_done(tctx, message);
             break;
         default:
             DEBUG(SSSDBG_TRACE_LIBS,
@@ -455,11 +508,28 @@ static int schedule_fd_processing(CURLM *multi,
 
 static int tcurl_ctx_destroy(struct tcurl_ctx *ctx)
 {
+    CURLSHcode shret;
+
     if (ctx == NULL) {
         return 0;
     }
 
+    /* The easy handles of the pending requests still use the share
+     * handle, which cannot be released until they are detached. */
+    while (ctx->pending != NULL) {
+        tcurl_request_terminate(ctx, ctx->pending);
+    }
+
     curl_multi_cleanup(ctx->multi_handle);
+
+    if (ctx->share_handle != NULL) {
+        shret = curl_share_cleanup(ctx->share_handle);
+        if (shret != CURLSHE_OK) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "Cannot release the curl share handle [%d]: %s\n",
+                  shret, curl_share_strerror(shret));
+        }
+    }
     return 0;
 }
 
@@ -469,6 +539,7 @@ struct tcurl_ctx *tcurl_init(TALLOC_CTX *mem_ctx,
     errno_t ret;
     struct tcurl_ctx *tctx = NULL;
     CURLMcode cmret;
+    CURLSHcode shret;
 
     /* Per the manpage it is safe to call the initialization multiple
      * times, as long as this is done before any other curl calls to
@@ -535,6 +606,50 @@ struct tcurl_ctx *tcurl_init(TALLOC_CTX *mem_ctx,
               cmret, curl_multi_strerror(cmret));
     }
 
+    cmret = curl_multi_setopt(tctx->multi_handle, CURLMOPT_MAXCONNECTS,
+                              (long) TCURL_MAX_CONNECTS);
+    if (cmret != CURLM_OK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Cannot set CURLMOPT_MAXCONNECTS [%d]: %s\n",
+              cmret, curl_multi_strerror(cmret));
+    }
+
+    cmret = curl_multi_setopt(tctx->multi_handle, CURLMOPT_MAX_HOST_CONNECTIONS,
+                              (long) TCURL_MAX_HOST_CONNECTIONS);
+    if (cmret != CURLM_OK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Cannot set CURLMOPT_MAX_HOST_CONNECTIONS [%d]: %s\n",
+              cmret, curl_multi_strerror(cmret));
+    }
+
+#ifdef CURLPIPE_MULTIPLEX
+    /* Multiplex transfers over a single connection when the server speaks
+     * HTTP/2. HTTP/1.1 pipelining is not used as it is unreliable. */
+    cmret = curl_multi_setopt(tctx->multi_handle, CURLMOPT_PIPELINING,
+                              CURLPIPE_MULTIPLEX);
+    if (cmret != CURLM_OK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Cannot set CURLMOPT_PIPELINING [%d]: %s\n",
+              cmret, curl_multi_strerror(cmret));
+    }
+#endif
+
+    tctx->share_handle = curl_share_init();
+    if (tctx->share_handle == NULL) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Cannot create a curl share handle, "
+              "TLS sessions will not be reused\n");
+    } else {
+        shret = curl_share_setopt(tctx->share_handle, CURLSHOPT_SHARE,
+                                  CURL_LOCK_DATA_SSL_SESSION);
+        if (shret != CURLSHE_OK) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "Cannot share TLS sessions [%d]: %s\n",
+                  shret, curl_share_strerror(shret));
+            curl_share_cleanup(tctx->share_handle);
+            tctx->share_handle = NULL;
+        }
+    }
+
     return tctx;
 
 fail:
@@ -620,8 +735,49 @@ struct tcurl_request {
 
     /* Associated tcurl context if this request is in progress. */
     struct tcurl_ctx *tcurl_ctx;
+
+    struct tcurl_request *prev;
+    struct tcurl_request *next;
 };
 
+/* The connection itself stays in the multi handle's cache for reuse */
+static void tcurl_request_detach(struct tcurl_request *tcurl_req)
+{
+    curl_multi_remove_handle(tcurl_req->tcurl_ctx->multi_handle,
+                             tcurl_req->curl_easy_handle);
+
+    if (tcurl_req->tcurl_ctx->share_handle != NULL) {
+        curl_easy_setopt(tcurl_req->curl_easy_handle, CURLOPT_SHARE, NULL);
+    }
+
+    DLIST_REMOVE(tcurl_req->tcurl_ctx->pending, tcurl_req);
+
+    /* This request is no longer associated with tcurl context. */
+    tcurl_req->tcurl_ctx = NULL;
+}
+
+/* Fails a request that is still in progress when its tcurl context is
+ * being freed. The callback is deferred as the caller is a destructor. */
+static void tcurl_request_terminate(struct tcurl_ctx *tctx,
+                                    struct tcurl_request *tcurl_req)
+{
+    struct tevent_req *req = NULL;
+    CURLcode crv;
+
+    crv = curl_easy_getinfo(tcurl_req->curl_easy_handle, CURLINFO_PRIVATE,
+                            (void *) &req);
+    if (crv != CURLE_OK || req == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Cannot get the request of a pending "
+              "transfer, it will never finish\n");
+        tcurl_request_detach(tcurl_req);
+        return;
+    }
+
+    DEBUG(SSSDBG_MINOR_FAILURE, "Terminating a pending TCURL request\n");
+    tevent_req_defer_callback(req, tctx->ev);
+    tcurl_request_done(req, ERR_TERMINATED, 0);
+}
+
 struct tcurl_request_state {
     struct tcurl_request *tcurl_req;
     struct sss_iobuf *response;
@@ -668,6 +824,14 @@ tcurl_request_send(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
+    if (tcurl_ctx->share_handle != NULL) {
+        ret = tcurl_set_option(tcurl_req, CURLOPT_SHARE,
+                               tcurl_ctx->share_handle);
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
     ret = tcurl_set_option(tcurl_req, CURLOPT_WRITEFUNCTION, tcurl_write_data);
     if (ret != EOK) {
         goto done;
@@ -698,6 +862,7 @@ tcurl_request_send(TALLOC_CTX *mem_ctx,
     }
 
     tcurl_req->tcurl_ctx = tcurl_ctx;
+    DLIST_ADD(tcurl_ctx->pending, tcurl_req);
 
     ret = EAGAIN;
 
@@ -730,11 +895,7 @@ static void tcurl_request_done(struct tevent_req *req,
 
     state = tevent_req_data(req, struct tcurl_request_state);
 
-    curl_multi_remove_handle(state->tcurl_req->tcurl_ctx->multi_handle,
-                             state->tcurl_req->curl_easy_handle);
-
-    /* This request is no longer associated with tcurl context. */
-    state->tcurl_req->tcurl_ctx = NULL;
+    tcurl_request_detach(state->tcurl_req);
 
     if (process_error != EOK) {
         tevent_req_error(req, process_error);
@@ -824,8 +985,7 @@ tcurl_request_destructor(struct tcurl_request *tcurl_req)
 {
     if (tcurl_req->tcurl_ctx != NULL) {
         DEBUG(SSSDBG_MINOR_FAILURE, "Terminating TCURL request...\n");
-        curl_multi_remove_handle(tcurl_req->tcurl_ctx->multi_handle,
-                                 tcurl_req->curl_easy_handle);
+        tcurl_request_detach(tcurl_req);
     }
 
     if (tcurl_req->headers != NULL) {
@@ -909,7 +1069,22 @@ tcurl_request_create(TALLOC_CTX *mem_ctx,
         if (ret != EOK) {
             goto done;
         }
+    } else {
+        /* Detect dead peers on connections that are kept for reuse */
+        ret = tcurl_set_option(tcurl_req, CURLOPT_TCP_KEEPALIVE, 1L);
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
+#ifdef CURLPIPE_MULTIPLEX
+    /* Rather wait for a connection that can be multiplexed than open
+     * a new one */
+    ret = tcurl_set_option(tcurl_req, CURLOPT_PIPEWAIT, 1L);
+    if (ret != EOK) {
+        goto done;
     }
+#endif
 
     if (body != NULL) {
         /* Curl will tell the underlying protocol about incoming data length.
@@ -22,6 +22,7 @@
 #ifndef __TEV_CURL_H
 #define __TEV_CURL_H
 
+#include <stdint.h>
 #include <talloc.h>
 #include <tevent.h>
 
@@ -39,14 +40,37 @@ enum tcurl_http_method {
     TCURL_HTTP_DELETE,
 };
 
+/**
+ * @brief Connection usage counters of a tcurl context
+ */
+struct tcurl_stats {
+    /* Number of successfully finished transfers */
+    uint64_t requests;
+    /* Number of transfers that were sent over an already open connection */
+    uint64_t reused_connections;
+    /* Number of connections opened */
+    uint64_t new_connections;
+};
+
 /**
  * @brief Initialize the tcurl tevent wrapper.
  *
+ * Connections opened by requests sent through the same context are kept
+ * open and reused by subsequent requests to the same destination.
+ *
  * @returns the opaque context or NULL on error
  */
 struct tcurl_ctx *tcurl_init(TALLOC_CTX *mem_ctx,
                              struct tevent_context *ev);
 
+/**
+ * @brief Read the connection usage counters of the tcurl context.
+ *
+ * @param[in]  tctx     The context obtained with tcurl_init
+ * @param[out] _stats   The counters
+ */
+void tcurl_get_stats(struct tcurl_ctx *tctx, struct tcurl_stats *_stats);
+
 /**
  * @brief Run a single asynchronous TCURL request.
  *
@@ -170,6 +170,9 @@ struct main_context {
     struct tevent_context *event_ctx;
     struct confdb_ctx *confdb_ctx;
     pid_t parent_pid;
+    /* The default SIGTERM handler exits right away, a service that has to
+     * finish some work first can free it and install its own */
+    struct tevent_signal *sigterm;
 };
 
 errno_t server_common_rotate_logs(struct confdb_ctx *confdb,